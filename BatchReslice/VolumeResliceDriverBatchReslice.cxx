@@ -0,0 +1,234 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Regenerates the slices a driven slice view showed: reslices a volume at
+// every pose of a driver pose log and writes one MetaImage per pose.
+//
+// Usage: VolumeResliceDriverBatchReslice volume poselog outputPattern
+//          [--method position|orientation]
+//          [--orientation inplane|inplane90|transverse]
+//          [--size width height] [--fov x y]
+//          [--image-size width height] [--nearest] [--threads n]
+//          [--interpolation nearest|linear|cubic|lanczos]
+//          [--quantize 8|16] [--compress]
+//
+// outputPattern takes the pose index, e.g. slices/slice_%05d.mha. See
+// vtkDriverPoseLogReslicer for the log format; --image-size marks a log of
+// image driver frames of that size. --quantize reslices a reduced-precision
+// copy of the volume (brick-compressed with --compress) and releases the
+// volume read from the file; see vtkQuantizedImage. --nearest is short for
+// --interpolation nearest.
+
+// VolumeResliceDriver includes
+#include "vtkDriverPoseLogReslicer.h"
+#include "vtkQuantizedImage.h"
+#include "vtkSliceImageReslicer.h"
+#include "vtkSlicerVolumeResliceDriverLogic.h"
+
+// MRML includes
+#include <vtkMRMLScalarVolumeNode.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLVolumeArchetypeStorageNode.h>
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+
+
+namespace
+{
+
+void PrintUsage( const char* program )
+{
+  fprintf( stderr,
+           "Usage: %s volume poselog outputPattern\n"
+           "         [--method position|orientation]\n"
+           "         [--orientation inplane|inplane90|transverse]\n"
+           "         [--size width height] [--fov x y]\n"
+           "         [--image-size width height] [--nearest] [--threads n]\n"
+           "         [--interpolation nearest|linear|cubic|lanczos]\n"
+           "         [--quantize 8|16] [--compress]\n",
+           program );
+}
+
+} // namespace
+
+
+
+int main( int argc, char* argv[] )
+{
+  vtkSmartPointer< vtkDriverPoseLogReslicer > reslicer = vtkSmartPointer< vtkDriverPoseLogReslicer >::New();
+  const char* arguments[3] = { NULL, NULL, NULL };
+  int numberOfArguments = 0;
+  int quantizationBits = 0;
+  bool compressed = false;
+  for ( int i = 1; i < argc; ++ i )
+  {
+    if ( strcmp( argv[ i ], "--method" ) == 0 && i + 1 < argc )
+    {
+      ++ i;
+      reslicer->SetMethod( strcmp( argv[ i ], "position" ) == 0
+                           ? vtkSlicerVolumeResliceDriverLogic::METHOD_POSITION
+                           : vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION );
+    }
+    else if ( strcmp( argv[ i ], "--orientation" ) == 0 && i + 1 < argc )
+    {
+      ++ i;
+      int orientation = vtkSlicerVolumeResliceDriverLogic::ORIENTATION_INPLANE;
+      if ( strcmp( argv[ i ], "inplane90" ) == 0 )
+      {
+        orientation = vtkSlicerVolumeResliceDriverLogic::ORIENTATION_INPLANE90;
+      }
+      else if ( strcmp( argv[ i ], "transverse" ) == 0 )
+      {
+        orientation = vtkSlicerVolumeResliceDriverLogic::ORIENTATION_TRANSVERSE;
+      }
+      reslicer->SetOrientation( orientation );
+    }
+    else if ( strcmp( argv[ i ], "--size" ) == 0 && i + 2 < argc )
+    {
+      reslicer->SetSliceDimensions( atoi( argv[ i + 1 ] ), atoi( argv[ i + 2 ] ) );
+      i += 2;
+    }
+    else if ( strcmp( argv[ i ], "--fov" ) == 0 && i + 2 < argc )
+    {
+      reslicer->SetFieldOfView( atof( argv[ i + 1 ] ), atof( argv[ i + 2 ] ) );
+      i += 2;
+    }
+    else if ( strcmp( argv[ i ], "--image-size" ) == 0 && i + 2 < argc )
+    {
+      reslicer->SetImageDimensions( atoi( argv[ i + 1 ] ), atoi( argv[ i + 2 ] ) );
+      i += 2;
+    }
+    else if ( strcmp( argv[ i ], "--nearest" ) == 0 )
+    {
+      reslicer->SetInterpolationMode( vtkSliceImageReslicer::INTERPOLATION_NEAREST );
+    }
+    else if ( strcmp( argv[ i ], "--interpolation" ) == 0 && i + 1 < argc )
+    {
+      ++ i;
+      int interpolation = vtkSliceImageReslicer::INTERPOLATION_LINEAR;
+      if ( strcmp( argv[ i ], "nearest" ) == 0 )
+      {
+        interpolation = vtkSliceImageReslicer::INTERPOLATION_NEAREST;
+      }
+      else if ( strcmp( argv[ i ], "cubic" ) == 0 )
+      {
+        interpolation = vtkSliceImageReslicer::INTERPOLATION_CUBIC;
+      }
+      else if ( strcmp( argv[ i ], "lanczos" ) == 0 )
+      {
+        interpolation = vtkSliceImageReslicer::INTERPOLATION_LANCZOS;
+      }
+      reslicer->SetInterpolationMode( interpolation );
+    }
+    else if ( strcmp( argv[ i ], "--threads" ) == 0 && i + 1 < argc )
+    {
+      reslicer->SetNumberOfThreads( atoi( argv[ ++ i ] ) );
+    }
+    else if ( strcmp( argv[ i ], "--quantize" ) == 0 && i + 1 < argc )
+    {
+      quantizationBits = atoi( argv[ ++ i ] );
+    }
+    else if ( strcmp( argv[ i ], "--compress" ) == 0 )
+    {
+      compressed = true;
+    }
+    else if ( numberOfArguments < 3 && argv[ i ][0] != '-' )
+    {
+      arguments[ numberOfArguments ++ ] = argv[ i ];
+    }
+    else
+    {
+      PrintUsage( argv[0] );
+      return 1;
+    }
+  }
+  int* sliceDimensions = reslicer->GetSliceDimensions();
+  if (    numberOfArguments < 3 || sliceDimensions[0] <= 0 || sliceDimensions[1] <= 0
+       || ( quantizationBits != 0 && quantizationBits != 8 && quantizationBits != 16 )
+       || ( compressed && quantizationBits == 0 ) )
+  {
+    PrintUsage( argv[0] );
+    return 1;
+  }
+
+  vtkNew< vtkMRMLScene > scene;
+  vtkNew< vtkMRMLScalarVolumeNode > volumeNode;
+  vtkNew< vtkMRMLVolumeArchetypeStorageNode > storageNode;
+  scene->AddNode( volumeNode.GetPointer() );
+  scene->AddNode( storageNode.GetPointer() );
+  storageNode->SetFileName( arguments[0] );
+  if ( ! storageNode->ReadData( volumeNode.GetPointer() ) || volumeNode->GetImageData() == NULL )
+  {
+    fprintf( stderr, "Cannot read volume %s\n", arguments[0] );
+    return 1;
+  }
+  vtkNew< vtkMatrix4x4 > rasToIJK;
+  volumeNode->GetRASToIJKMatrix( rasToIJK.GetPointer() );
+  if ( quantizationBits > 0 )
+  {
+    vtkSmartPointer< vtkQuantizedImage > quantized = vtkSmartPointer< vtkQuantizedImage >::New();
+    if ( ! quantized->Build( volumeNode->GetImageData(), quantizationBits, compressed ) )
+    {
+      fprintf( stderr, "Cannot quantize volume %s\n", arguments[0] );
+      return 1;
+    }
+    printf( "Quantized to %.1f MiB from %.1f MiB, error up to %g\n",
+            quantized->GetMemorySize() / 1048576.0, quantized->GetSourceMemorySize() / 1048576.0,
+            quantized->GetMaximumError() );
+    reslicer->SetQuantizedInput( quantized, rasToIJK.GetPointer() );
+    volumeNode->SetAndObserveImageData( NULL );
+  }
+  else
+  {
+    reslicer->SetInput( volumeNode->GetImageData(), rasToIJK.GetPointer() );
+  }
+
+  std::ifstream log( arguments[1] );
+  if ( ! log )
+  {
+    fprintf( stderr, "Cannot open pose log %s\n", arguments[1] );
+    return 1;
+  }
+  reslicer->SetOutputFilePattern( arguments[2] );
+
+  double start = vtkTimerLog::GetUniversalTime();
+  int written = reslicer->Reslice( log );
+  if ( written < 0 )
+  {
+    return 1;
+  }
+  double elapsed = vtkTimerLog::GetUniversalTime() - start;
+  printf( "%d images written in %.2f s on %d threads", written, elapsed, reslicer->GetNumberOfThreads() );
+  if ( reslicer->GetNumberOfSkippedLines() > 0 )
+  {
+    printf( ", %d malformed log lines skipped", reslicer->GetNumberOfSkippedLines() );
+  }
+  printf( "\n" );
+  return 0;
+}
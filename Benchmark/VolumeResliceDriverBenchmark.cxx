@@ -0,0 +1,2112 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Timing harness for the VolumeResliceDriver logic.
+//
+// Usage: VolumeResliceDriverBenchmark [benchmark name [arguments ...]]
+// Runs all benchmarks with default arguments if no name is given.
+
+// VolumeResliceDriver includes
+#include "vtkAsyncSliceReslicer.h"
+#include "vtkDriverPoseLogReslicer.h"
+#include "vtkDriverPoseTable.h"
+#include "vtkLabelMapSliceReslicer.h"
+#include "vtkMemoryMappedImage.h"
+#include "vtkModelPlaneIntersector.h"
+#include "vtkMultiVolumeReslicer.h"
+#include "vtkQuantizedImage.h"
+#include "vtkResliceTaskScheduler.h"
+#include "vtkSharedMemoryPoseChannel.h"
+#include "vtkSliceImageReslicer.h"
+#include "vtkSlicerVolumeResliceDriverLogic.h"
+#include "vtkTimeSeriesSliceReslicer.h"
+#include "vtkVolumeResliceDriverTestingUtilities.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+#include <vtkMRMLScalarVolumeNode.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLSliceCompositeNode.h>
+#include <vtkMRMLSliceNode.h>
+
+// VTK includes
+#include <vtkCallbackCommand.h>
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkMultiThreader.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+
+
+using namespace vtkVolumeResliceDriverTestingUtilities;
+
+namespace
+{
+
+const int SliceSize = 512;
+const double SlicePixelSpacing = 0.5;
+
+
+// Deterministic noise, so runs are comparable across machines.
+class RandomSequence
+{
+public:
+  RandomSequence( unsigned int seed ) : State( seed ) {}
+  /// Uniform in [-1, 1).
+  double Next()
+  {
+    this->State = this->State * 1664525u + 1013904223u;
+    return ( this->State >> 8 ) / 8388608.0 - 1.0;
+  }
+private:
+  unsigned int State;
+};
+
+
+/// XYToRAS of an axial slice centered at the given point, as
+/// vtkMRMLSliceNode computes it after JumpSlice.
+void SetAxialXYToRAS( vtkMatrix4x4* xyToRAS, const double center[3] )
+{
+  xyToRAS->Identity();
+  xyToRAS->SetElement( 0, 0, -SlicePixelSpacing );
+  xyToRAS->SetElement( 1, 1, SlicePixelSpacing );
+  xyToRAS->SetElement( 2, 2, SlicePixelSpacing );
+  xyToRAS->SetElement( 0, 3, center[0] + SlicePixelSpacing * SliceSize / 2.0 );
+  xyToRAS->SetElement( 1, 3, center[1] - SlicePixelSpacing * SliceSize / 2.0 );
+  xyToRAS->SetElement( 2, 3, center[2] );
+}
+
+
+/// Slice centers along a tracked trajectory.
+///  "stage":    motorized in-plane steps of whole pixels, as in replay or stage scanning
+///  "sweep":    stepper moving back and forth over a few planes along the normal
+///  "freehand": smooth in-plane sweep with tracker jitter along the normal
+void CreateTrajectory( const char* name, int count, std::vector< double >& centers )
+{
+  RandomSequence random( 12345 );
+  centers.resize( 3 * count );
+  for ( int n = 0; n < count; ++ n )
+  {
+    double* c = &centers[ 3 * n ];
+    if ( strcmp( name, "stage" ) == 0 )
+    {
+      int step = n % 80 < 40 ? n % 40 : 40 - n % 40;
+      c[0] = step * SlicePixelSpacing;
+      c[1] = ( n / 80 ) * 2 * SlicePixelSpacing;
+      c[2] = 0.0;
+    }
+    else if ( strcmp( name, "sweep" ) == 0 )
+    {
+      // 5 planes 1 mm apart, sliding by a pixel every 3 frames.
+      int step = n % 8 < 4 ? n % 4 : 4 - n % 4;
+      c[0] = ( ( n / 3 ) % 3 - 1 ) * SlicePixelSpacing;
+      c[1] = 0.0;
+      c[2] = step * 1.0;
+    }
+    else
+    {
+      double t = n / 60.0;
+      c[0] = 30.0 * sin( 0.7 * t ) + 0.05 * random.Next();
+      c[1] = 20.0 * sin( 0.3 * t ) + 0.05 * random.Next();
+      c[2] = 0.05 * random.Next();
+    }
+  }
+}
+
+
+/// Reslice along a trajectory and return the mean time per frame in ms.
+double RunReslice( vtkSliceImageReslicer* reslicer, const std::vector< double >& centers )
+{
+  vtkSmartPointer< vtkMatrix4x4 > xyToRAS = vtkSmartPointer< vtkMatrix4x4 >::New();
+  int count = static_cast< int >( centers.size() / 3 );
+  double start = vtkTimerLog::GetUniversalTime();
+  for ( int n = 0; n < count; ++ n )
+  {
+    SetAxialXYToRAS( xyToRAS, &centers[ 3 * n ] );
+    reslicer->SetSliceGeometry( xyToRAS, SliceSize, SliceSize );
+    reslicer->Update();
+  }
+  return ( vtkTimerLog::GetUniversalTime() - start ) * 1000.0 / count;
+}
+
+
+//----------------------------------------------------------------------------
+int BenchmarkIncrementalReslice( int, char*[] )
+{
+  const int volumeSize = 256;
+  const int frames = 600;
+  vtkSmartPointer< vtkImageData > volume = CreateTestVolume( volumeSize );
+  vtkSmartPointer< vtkMatrix4x4 > rasToIJK = vtkSmartPointer< vtkMatrix4x4 >::New();
+  CreateRASToIJK( rasToIJK, volumeSize );
+
+  const char* trajectories[] = { "stage", "sweep", "freehand" };
+  // Tolerances: exact reuse only, and snapping to the previous pixel grid.
+  const double shiftTolerances[] = { 0.01, 0.5 };
+  const double normalTolerances[] = { 0.001, 0.1 };
+
+  printf( "%-10s %10s %10s %12s %12s %12s %12s %9s\n",
+          "trajectory", "shift tol", "normal tol", "full ms", "incr ms", "incremental", "neighbour", "speedup" );
+  for ( int t = 0; t < 3; ++ t )
+  {
+    std::vector< double > centers;
+    CreateTrajectory( trajectories[ t ], frames, centers );
+    for ( int s = 0; s < 2; ++ s )
+    {
+      vtkSmartPointer< vtkSliceImageReslicer > full = vtkSmartPointer< vtkSliceImageReslicer >::New();
+      full->SetInput( volume, rasToIJK );
+      full->IncrementalUpdateOff();
+      double fullTime = RunReslice( full, centers );
+
+      vtkSmartPointer< vtkSliceImageReslicer > incremental = vtkSmartPointer< vtkSliceImageReslicer >::New();
+      incremental->SetInput( volume, rasToIJK );
+      incremental->SetInPlaneShiftTolerance( shiftTolerances[ s ] );
+      incremental->SetNormalStepTolerance( normalTolerances[ s ] );
+      double incrementalTime = RunReslice( incremental, centers );
+
+      double fraction = static_cast< double >( incremental->GetNumberOfIncrementalUpdates() ) / frames;
+      double neighbourFraction = static_cast< double >( incremental->GetNumberOfNeighbourPlaneUpdates() ) / frames;
+      printf( "%-10s %10.2f %10.3f %12.3f %12.3f %11.1f%% %11.1f%% %8.2fx\n",
+              trajectories[ t ], shiftTolerances[ s ], normalTolerances[ s ],
+              fullTime, incrementalTime, fraction * 100.0, neighbourFraction * 100.0, fullTime / incrementalTime );
+    }
+  }
+  return 0;
+}
+
+
+/// Resident set size of this process in bytes, -1 where unknown.
+double GetProcessResidentBytes()
+{
+  double resident = -1.0;
+#ifndef _WIN32
+  FILE* statm = fopen( "/proc/self/statm", "r" );
+  if ( statm != NULL )
+  {
+    long size = 0;
+    long pages = 0;
+    if ( fscanf( statm, "%ld %ld", &size, &pages ) == 2 )
+    {
+      resident = static_cast< double >( pages ) * sysconf( _SC_PAGESIZE );
+    }
+    fclose( statm );
+  }
+#endif
+  return resident;
+}
+
+
+/// Evict the file from the page cache, so each pass starts cold.
+void DropFileCache( const char* fileName )
+{
+#if !defined( _WIN32 ) && !defined( __APPLE__ )
+  int fd = open( fileName, O_RDONLY );
+  if ( fd >= 0 )
+  {
+    posix_fadvise( fd, 0, 0, POSIX_FADV_DONTNEED );
+    close( fd );
+  }
+#else
+  (void)fileName;
+#endif
+}
+
+
+//----------------------------------------------------------------------------
+/// Arguments: [file nx ny nz] of a raw short volume. Without them an
+/// 8 GiB sparse file is created, which exercises the paging path but not
+/// the disk; use a real file larger than RAM for representative numbers.
+int BenchmarkMappedReslice( int argc, char* argv[] )
+{
+  const int frames = 300;
+  std::string fileName;
+  int dims[3] = { 2048, 2048, 1024 };
+  bool temporary = ( argc < 4 );
+  if ( temporary )
+  {
+    fileName = "VolumeResliceDriverBenchmark.raw";
+    FILE* file = fopen( fileName.c_str(), "wb" );
+    if ( file == NULL )
+    {
+      fprintf( stderr, "Cannot create %s\n", fileName.c_str() );
+      return 1;
+    }
+    vtkTypeInt64 size = static_cast< vtkTypeInt64 >( dims[0] ) * dims[1] * dims[2] * sizeof( short );
+#ifdef _WIN32
+    _fseeki64( file, size - 1, SEEK_SET );
+#else
+    fseeko( file, static_cast< off_t >( size - 1 ), SEEK_SET );
+#endif
+    fputc( 0, file );
+    fclose( file );
+  }
+  else
+  {
+    fileName = argv[0];
+    for ( int k = 0; k < 3; ++ k )
+    {
+      dims[ k ] = atoi( argv[ k + 1 ] );
+    }
+  }
+
+  vtkSmartPointer< vtkMemoryMappedImage > mapped = vtkSmartPointer< vtkMemoryMappedImage >::New();
+  mapped->SetFileName( fileName.c_str() );
+  mapped->SetDimensions( dims );
+  mapped->SetScalarType( VTK_SHORT );
+  if ( ! mapped->Open() )
+  {
+    return 1;
+  }
+
+  vtkSmartPointer< vtkMatrix4x4 > rasToIJK = vtkSmartPointer< vtkMatrix4x4 >::New();
+  rasToIJK->Identity();
+  for ( int k = 0; k < 3; ++ k )
+  {
+    rasToIJK->SetElement( k, 3, dims[ k ] / 2.0 );
+  }
+
+  // Freehand motion while sweeping through the whole volume along z.
+  std::vector< double > centers;
+  CreateTrajectory( "freehand", frames, centers );
+  for ( int n = 0; n < frames; ++ n )
+  {
+    centers[ 3 * n + 2 ] += dims[2] * ( 0.8 * n / ( frames - 1 ) - 0.4 );
+  }
+
+  printf( "%s: %d x %d x %d, %.1f GiB mapped\n", fileName.c_str(), dims[0], dims[1], dims[2],
+          mapped->GetMappedBytes() / 1073741824.0 );
+  printf( "%-10s %10s %10s %14s %14s\n", "readahead", "mean ms", "max ms", "mapped MiB", "process MiB" );
+  vtkSmartPointer< vtkMatrix4x4 > xyToRAS = vtkSmartPointer< vtkMatrix4x4 >::New();
+  for ( int readahead = 0; readahead < 2; ++ readahead )
+  {
+    DropFileCache( fileName.c_str() );
+    vtkSmartPointer< vtkSliceImageReslicer > reslicer = vtkSmartPointer< vtkSliceImageReslicer >::New();
+    reslicer->SetInput( mapped->GetOutput(), rasToIJK );
+    reslicer->SetReadaheadSource( readahead ? mapped.GetPointer() : NULL );
+
+    double total = 0.0;
+    double maximum = 0.0;
+    for ( int n = 0; n < frames; ++ n )
+    {
+      SetAxialXYToRAS( xyToRAS, &centers[ 3 * n ] );
+      double start = vtkTimerLog::GetUniversalTime();
+      reslicer->SetSliceGeometry( xyToRAS, SliceSize, SliceSize );
+      reslicer->Update();
+      double elapsed = ( vtkTimerLog::GetUniversalTime() - start ) * 1000.0;
+      total += elapsed;
+      maximum = elapsed > maximum ? elapsed : maximum;
+    }
+    printf( "%-10s %10.3f %10.3f %14.1f %14.1f\n", readahead ? "on" : "off", total / frames, maximum,
+            mapped->GetResidentBytes() / 1048576.0, GetProcessResidentBytes() / 1048576.0 );
+  }
+
+  mapped->Close();
+  if ( temporary )
+  {
+    remove( fileName.c_str() );
+  }
+  return 0;
+}
+
+
+/// XYToRAS of a benchmark slice in the plane of the pose, centered on its position.
+void SetPoseXYToRAS( vtkMatrix4x4* xyToRAS, vtkMatrix4x4* pose )
+{
+  vtkVolumeResliceDriverTestingUtilities::SetPoseXYToRAS( xyToRAS, pose, SliceSize, SlicePixelSpacing );
+}
+
+
+void CountCallback( vtkObject*, unsigned long, void* clientData, void* )
+{
+  ++ *static_cast< unsigned long* >( clientData );
+}
+
+
+//----------------------------------------------------------------------------
+/// Poses written to a shared-memory channel and polled by the logic, in
+/// one process: time per poll. Its behavior is checked by
+/// vtkSlicerVolumeResliceDriverLogicPoseChannelTest1.
+int BenchmarkPoseChannel( int, char*[] )
+{
+  const int numberOfDrivers = 8;
+  const int rounds = 2000;
+  const char* channelName = "VolumeResliceDriverBenchmark";
+
+  vtkSmartPointer< vtkMRMLScene > scene = vtkSmartPointer< vtkMRMLScene >::New();
+  vtkSmartPointer< vtkSlicerVolumeResliceDriverLogic > logic =
+    vtkSmartPointer< vtkSlicerVolumeResliceDriverLogic >::New();
+  logic->SetMRMLScene( scene );
+
+  std::vector< vtkSmartPointer< vtkMRMLLinearTransformNode > > drivers;
+  std::vector< vtkSmartPointer< vtkMRMLSliceNode > > slices;
+  for ( int d = 0; d < numberOfDrivers; ++ d )
+  {
+    vtkSmartPointer< vtkMRMLSliceNode > slice = vtkSmartPointer< vtkMRMLSliceNode >::New();
+    std::stringstream layoutName;
+    layoutName << "Slice" << d;
+    slice->SetLayoutName( layoutName.str().c_str() );
+    scene->AddNode( slice );
+    vtkSmartPointer< vtkMRMLLinearTransformNode > driver = vtkSmartPointer< vtkMRMLLinearTransformNode >::New();
+    scene->AddNode( driver );
+    logic->SetDriverForSlice( driver->GetID(), slice );
+    logic->SetMethodForSlice( vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION, slice );
+    drivers.push_back( driver );
+    slices.push_back( slice );
+  }
+
+  vtkSmartPointer< vtkSharedMemoryPoseChannel > writer = vtkSmartPointer< vtkSharedMemoryPoseChannel >::New();
+  if ( ! writer->Create( channelName, numberOfDrivers ) || ! logic->AttachPoseChannel( channelName ) )
+  {
+    printf( "Cannot create or attach the pose channel.\n" );
+    return 1;
+  }
+
+  vtkNew< vtkMatrix4x4 > pose;
+  double matrix[16];
+  unsigned long written = 0;
+  unsigned long applied = 0;
+  unsigned long repeated = 0;
+  double pollTime = 0.0;
+  for ( int n = 0; n < rounds; ++ n )
+  {
+    // Every round moves half of the drivers, alternating.
+    for ( int d = n % 2; d < numberOfDrivers; d += 2 )
+    {
+      SetStreamPose( pose.GetPointer(), n + 100 * d );
+      vtkMatrix4x4::DeepCopy( matrix, pose.GetPointer() );
+      writer->WritePose( d, drivers[ d ]->GetID(), vtkTimerLog::GetUniversalTime(), matrix, true );
+      ++ written;
+    }
+    double start = vtkTimerLog::GetUniversalTime();
+    applied += logic->PollPoseChannel();
+    repeated += logic->PollPoseChannel();
+    pollTime += vtkTimerLog::GetUniversalTime() - start;
+  }
+  logic->DetachPoseChannel();
+  writer->Detach();
+
+  printf( "%-10s %10s %10s %10s %14s\n", "drivers", "written", "applied", "repeated", "us/poll" );
+  printf( "%-10d %10lu %10lu %10lu %14.2f\n", numberOfDrivers, written, applied, repeated,
+          pollTime / ( 2 * rounds ) * 1.0e6 );
+  return 0;
+}
+
+
+//----------------------------------------------------------------------------
+/// Configure a 3x3 slice layout on three drivers, one setting at a time
+/// and in one batch.
+int BenchmarkBulkConfiguration( int, char*[] )
+{
+  const int numberOfDrivers = 3;
+  const int numberOfSlices = 9;
+
+  double elapsed[2];
+  unsigned long updates[2];
+  unsigned long notifications[2];
+  for ( int run = 0; run < 2; ++ run )
+  {
+    vtkSmartPointer< vtkMRMLScene > scene = vtkSmartPointer< vtkMRMLScene >::New();
+    vtkSmartPointer< vtkSlicerVolumeResliceDriverLogic > logic =
+      vtkSmartPointer< vtkSlicerVolumeResliceDriverLogic >::New();
+    logic->SetMRMLScene( scene );
+
+    std::vector< vtkSmartPointer< vtkMRMLLinearTransformNode > > drivers;
+    vtkNew< vtkMatrix4x4 > pose;
+    for ( int d = 0; d < numberOfDrivers; ++ d )
+    {
+      vtkSmartPointer< vtkMRMLLinearTransformNode > driver = vtkSmartPointer< vtkMRMLLinearTransformNode >::New();
+      scene->AddNode( driver );
+      SetStreamPose( pose.GetPointer(), 10 * d );
+      driver->GetMatrixTransformToParent()->DeepCopy( pose.GetPointer() );
+      drivers.push_back( driver );
+    }
+    std::vector< vtkMRMLSliceNode* > slices;
+    std::vector< vtkSmartPointer< vtkMRMLSliceNode > > sliceNodes;
+    for ( int s = 0; s < numberOfSlices; ++ s )
+    {
+      vtkSmartPointer< vtkMRMLSliceNode > slice = vtkSmartPointer< vtkMRMLSliceNode >::New();
+      std::ostringstream layoutName;
+      layoutName << "Slice" << s;
+      slice->SetLayoutName( layoutName.str().c_str() );
+      scene->AddNode( slice );
+      sliceNodes.push_back( slice );
+    }
+
+    vtkNew< vtkCallbackCommand > counter;
+    notifications[ run ] = 0;
+    counter->SetCallback( CountCallback );
+    counter->SetClientData( &notifications[ run ] );
+    logic->AddObserver( vtkCommand::ModifiedEvent, counter.GetPointer() );
+
+    double start = vtkTimerLog::GetUniversalTime();
+    if ( run == 0 )
+    {
+      for ( int s = 0; s < numberOfSlices; ++ s )
+      {
+        logic->SetDriverForSlice( drivers[ s / 3 ]->GetID(), sliceNodes[ s ] );
+        logic->SetMethodForSlice( vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION, sliceNodes[ s ] );
+        logic->SetOrientationForSlice( vtkSlicerVolumeResliceDriverLogic::ORIENTATION_INPLANE + s % 3, sliceNodes[ s ] );
+      }
+    }
+    else
+    {
+      std::vector< vtkSlicerVolumeResliceDriverLogic::SliceConfiguration > configurations( numberOfSlices );
+      for ( int s = 0; s < numberOfSlices; ++ s )
+      {
+        configurations[ s ].SliceNode = sliceNodes[ s ];
+        configurations[ s ].DriverID = drivers[ s / 3 ]->GetID();
+        configurations[ s ].Method = vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION;
+        configurations[ s ].Orientation = vtkSlicerVolumeResliceDriverLogic::ORIENTATION_INPLANE + s % 3;
+      }
+      logic->SetSliceConfigurations( configurations );
+    }
+    elapsed[ run ] = vtkTimerLog::GetUniversalTime() - start;
+    logic->RemoveObserver( counter.GetPointer() );
+
+    std::vector< vtkSlicerVolumeResliceDriverLogic::SlicePerformance > snapshot;
+    logic->GetPerformanceSnapshot( snapshot );
+    updates[ run ] = 0;
+    for ( unsigned int i = 0; i < snapshot.size(); ++ i )
+    {
+      updates[ run ] += snapshot[ i ].NumberOfUpdates;
+    }
+  }
+
+  const char* names[2] = { "per-setting", "batch" };
+  printf( "%-12s %10s %14s %14s\n", "mode", "ms", "slice updates", "notifications" );
+  for ( int run = 0; run < 2; ++ run )
+  {
+    printf( "%-12s %10.3f %14lu %14lu\n", names[ run ], elapsed[ run ] * 1000.0, updates[ run ], notifications[ run ] );
+  }
+  return 0;
+}
+
+
+//----------------------------------------------------------------------------
+/// Arguments: [--slices n] [--events n]
+///
+/// One driver moving many slices, each resampling a 128^3 volume, run on
+/// 1, 2, 4, ... threads up to the default thread count. Reports the time
+/// per pose event and the speedup over one thread. Only the resampling
+/// runs on the threads: the slice node writes stay serial, so the run
+/// without resampling gives the part of an event that does not scale,
+/// and the speedup it bounds.
+int BenchmarkParallelSlices( int argc, char* argv[] )
+{
+  int numberOfSlices = 24;
+  int numberOfEvents = 100;
+  for ( int a = 0; a < argc; ++ a )
+  {
+    if ( strcmp( argv[ a ], "--slices" ) == 0 && a + 1 < argc )
+    {
+      numberOfSlices = atoi( argv[ ++ a ] );
+    }
+    else if ( strcmp( argv[ a ], "--events" ) == 0 && a + 1 < argc )
+    {
+      numberOfEvents = atoi( argv[ ++ a ] );
+    }
+  }
+  const int volumeSize = 128;
+  vtkSmartPointer< vtkImageData > volume = CreateTestVolume( volumeSize );
+
+  int maximumThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  std::vector< int > threadCounts;
+  for ( int threads = 1; threads < maximumThreads; threads *= 2 )
+  {
+    threadCounts.push_back( threads );
+  }
+  threadCounts.push_back( maximumThreads );
+
+  // The last run leaves resampling off.
+  threadCounts.push_back( 1 );
+
+  printf( "%-8s %8s %12s %10s\n", "threads", "slices", "ms/event", "speedup" );
+  double serialTime = 0.0;
+  for ( unsigned int t = 0; t < threadCounts.size(); ++ t )
+  {
+    bool resample = ( t + 1 < threadCounts.size() );
+    vtkSmartPointer< vtkMRMLScene > scene = vtkSmartPointer< vtkMRMLScene >::New();
+    vtkSmartPointer< vtkSlicerVolumeResliceDriverLogic > logic =
+      vtkSmartPointer< vtkSlicerVolumeResliceDriverLogic >::New();
+    logic->SetMRMLScene( scene );
+    logic->SetNumberOfThreads( threadCounts[ t ] );
+    logic->SetResliceOutputEnabled( resample );
+
+    vtkNew< vtkMRMLScalarVolumeNode > volumeNode;
+    volumeNode->SetAndObserveImageData( volume );
+    volumeNode->SetOrigin( -volumeSize / 2.0, -volumeSize / 2.0, -volumeSize / 2.0 );
+    scene->AddNode( volumeNode.GetPointer() );
+    vtkNew< vtkMRMLLinearTransformNode > driver;
+    scene->AddNode( driver.GetPointer() );
+
+    std::vector< vtkSmartPointer< vtkMRMLSliceNode > > slices;
+    std::vector< vtkSlicerVolumeResliceDriverLogic::SliceConfiguration > configurations( numberOfSlices );
+    for ( int s = 0; s < numberOfSlices; ++ s )
+    {
+      std::ostringstream layoutName;
+      layoutName << "Slice" << s;
+      vtkSmartPointer< vtkMRMLSliceCompositeNode > composite = vtkSmartPointer< vtkMRMLSliceCompositeNode >::New();
+      composite->SetLayoutName( layoutName.str().c_str() );
+      composite->SetBackgroundVolumeID( volumeNode->GetID() );
+      scene->AddNode( composite );
+      vtkSmartPointer< vtkMRMLSliceNode > slice = vtkSmartPointer< vtkMRMLSliceNode >::New();
+      slice->SetLayoutName( layoutName.str().c_str() );
+      slice->SetDimensions( 256, 256, 1 );
+      scene->AddNode( slice );
+      slices.push_back( slice );
+      configurations[ s ].SliceNode = slice;
+      configurations[ s ].DriverID = driver->GetID();
+      configurations[ s ].Method = ( s % 4 == 3 ) ? vtkSlicerVolumeResliceDriverLogic::METHOD_POSITION
+                                                  : vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION;
+      configurations[ s ].Orientation = vtkSlicerVolumeResliceDriverLogic::ORIENTATION_INPLANE + s % 3;
+    }
+    logic->SetSliceConfigurations( configurations );
+
+    vtkNew< vtkMatrix4x4 > pose;
+    double start = vtkTimerLog::GetUniversalTime();
+    for ( int n = 0; n < numberOfEvents; ++ n )
+    {
+      SetStreamPose( pose.GetPointer(), n );
+      driver->GetMatrixTransformToParent()->DeepCopy( pose.GetPointer() );
+    }
+    double elapsed = ( vtkTimerLog::GetUniversalTime() - start ) / numberOfEvents;
+    if ( t == 0 )
+    {
+      serialTime = elapsed;
+    }
+    if ( resample )
+    {
+      printf( "%-8d %8d %12.3f %10.2f\n", threadCounts[ t ], numberOfSlices, elapsed * 1000.0,
+              elapsed > 0.0 ? serialTime / elapsed : 0.0 );
+    }
+    else
+    {
+      printf( "no resampling: %.3f ms/event, speedup at most %.2f\n", elapsed * 1000.0,
+              elapsed > 0.0 ? serialTime / elapsed : 0.0 );
+    }
+  }
+  return 0;
+}
+
+
+//----------------------------------------------------------------------------
+/// Arguments: [--poses n]
+///
+/// Reslices a pose log into MetaImage files on one thread and on all
+/// threads, reporting poses per second and the process size after each
+/// run.
+int BenchmarkBatchReslice( int argc, char* argv[] )
+{
+  int numberOfPoses = 400;
+  for ( int a = 0; a < argc; ++ a )
+  {
+    if ( strcmp( argv[ a ], "--poses" ) == 0 && a + 1 < argc )
+    {
+      numberOfPoses = atoi( argv[ ++ a ] );
+    }
+  }
+  const int volumeSize = 128;
+  vtkSmartPointer< vtkImageData > volume = CreateTestVolume( volumeSize );
+  vtkNew< vtkMatrix4x4 > rasToIJK;
+  CreateRASToIJK( rasToIJK.GetPointer(), volumeSize );
+
+  std::ostringstream log;
+  log.precision( 17 );
+  log << "# time, then the pose row by row\n";
+  vtkNew< vtkMatrix4x4 > pose;
+  for ( int n = 0; n < numberOfPoses; ++ n )
+  {
+    SetStreamPose( pose.GetPointer(), n );
+    log << 1000.0 + n * 0.01;
+    for ( int k = 0; k < 16; ++ k )
+    {
+      log << " " << pose->Element[ k / 4 ][ k % 4 ];
+    }
+    log << "\n";
+  }
+
+  const int threadCounts[2] = { 1, vtkMultiThreader::GetGlobalDefaultNumberOfThreads() };
+  const char* patterns[2] = { "VolumeResliceDriverBatchA_%05d.mha", "VolumeResliceDriverBatchB_%05d.mha" };
+  int written[2];
+  printf( "%-8s %8s %10s %10s %14s\n", "threads", "poses", "written", "poses/s", "process MiB" );
+  for ( int run = 0; run < 2; ++ run )
+  {
+    vtkSmartPointer< vtkDriverPoseLogReslicer > reslicer = vtkSmartPointer< vtkDriverPoseLogReslicer >::New();
+    reslicer->SetInput( volume, rasToIJK.GetPointer() );
+    reslicer->SetNumberOfThreads( threadCounts[ run ] );
+    reslicer->SetOutputFilePattern( patterns[ run ] );
+    std::istringstream input( log.str() );
+    double start = vtkTimerLog::GetUniversalTime();
+    written[ run ] = reslicer->Reslice( input );
+    double elapsed = vtkTimerLog::GetUniversalTime() - start;
+    printf( "%-8d %8d %10d %10.1f %14.1f\n", threadCounts[ run ], numberOfPoses, written[ run ],
+            elapsed > 0.0 ? written[ run ] / elapsed : 0.0, GetProcessResidentBytes() / 1048576.0 );
+  }
+
+  std::vector< char > fileName;
+  for ( int run = 0; run < 2; ++ run )
+  {
+    fileName.resize( strlen( patterns[ run ] ) + 16 );
+    for ( int n = 0; n < written[ run ]; ++ n )
+    {
+      sprintf( &fileName[0], patterns[ run ], n );
+      remove( &fileName[0] );
+    }
+  }
+  return 0;
+}
+
+
+//----------------------------------------------------------------------------
+/// Arguments: [--slices n]
+///
+/// Reslices oblique planes through a 256^3 float volume from its scalars
+/// and from 8 and 16-bit copies, plain and brick-compressed. Reports the
+/// memory of each copy, the time per slice and the error against the
+/// full-precision slices.
+int BenchmarkQuantizedReslice( int argc, char* argv[] )
+{
+  int numberOfSlices = 50;
+  for ( int a = 0; a < argc; ++ a )
+  {
+    if ( strcmp( argv[ a ], "--slices" ) == 0 && a + 1 < argc )
+    {
+      numberOfSlices = atoi( argv[ ++ a ] );
+    }
+  }
+  const int volumeSize = 256;
+  vtkNew< vtkMatrix4x4 > rasToIJK;
+  CreateRASToIJK( rasToIJK.GetPointer(), volumeSize );
+
+  // Float scalars with a fractional part, as left by filtering or resampling.
+  vtkSmartPointer< vtkImageData > volume = vtkSmartPointer< vtkImageData >::New();
+  {
+    vtkSmartPointer< vtkImageData > shortVolume = CreateTestVolume( volumeSize );
+    volume->SetExtent( shortVolume->GetExtent() );
+    volume->SetWholeExtent( shortVolume->GetExtent() );
+    volume->SetScalarTypeToFloat();
+    volume->SetNumberOfScalarComponents( 1 );
+    volume->AllocateScalars();
+    const short* in = static_cast< const short* >( shortVolume->GetScalarPointer() );
+    float* out = static_cast< float* >( volume->GetScalarPointer() );
+    vtkIdType count = static_cast< vtkIdType >( volumeSize ) * volumeSize * volumeSize;
+    for ( vtkIdType i = 0; i < count; ++ i )
+    {
+      out[ i ] = static_cast< float >( in[ i ] + 0.25 * sin( 0.1 * ( i % volumeSize ) ) );
+    }
+  }
+
+  // Full precision first, then the copies; each compressed copy follows
+  // the plain copy it must match.
+  const int NumberOfSources = 5;
+  const int bits[ NumberOfSources ] = { 0, 8, 8, 16, 16 };
+  const bool compressed[ NumberOfSources ] = { false, false, true, false, true };
+  vtkSmartPointer< vtkQuantizedImage > copies[ NumberOfSources ];
+  vtkSmartPointer< vtkSliceImageReslicer > reslicers[ NumberOfSources ];
+  double buildTime[ NumberOfSources ];
+  for ( int r = 0; r < NumberOfSources; ++ r )
+  {
+    reslicers[ r ] = vtkSmartPointer< vtkSliceImageReslicer >::New();
+    reslicers[ r ]->IncrementalUpdateOff();
+    buildTime[ r ] = 0.0;
+    if ( bits[ r ] == 0 )
+    {
+      reslicers[ r ]->SetInput( volume, rasToIJK.GetPointer() );
+      continue;
+    }
+    copies[ r ] = vtkSmartPointer< vtkQuantizedImage >::New();
+    double start = vtkTimerLog::GetUniversalTime();
+    copies[ r ]->Build( volume, bits[ r ], compressed[ r ] );
+    buildTime[ r ] = vtkTimerLog::GetUniversalTime() - start;
+    reslicers[ r ]->SetQuantizedInput( copies[ r ], rasToIJK.GetPointer() );
+  }
+
+  double resliceTime[ NumberOfSources ] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+  double errorSum[ NumberOfSources ] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+  double maximumError[ NumberOfSources ] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+  vtkIdType numberOfSampled = 0;
+  vtkNew< vtkMatrix4x4 > pose;
+  vtkNew< vtkMatrix4x4 > xyToRAS;
+  for ( int n = 0; n < numberOfSlices; ++ n )
+  {
+    SetStreamPose( pose.GetPointer(), 10 * n );
+    SetPoseXYToRAS( xyToRAS.GetPointer(), pose.GetPointer() );
+
+    for ( int r = 0; r < NumberOfSources; ++ r )
+    {
+      reslicers[ r ]->SetSliceGeometry( xyToRAS.GetPointer(), SliceSize, SliceSize );
+      double start = vtkTimerLog::GetUniversalTime();
+      reslicers[ r ]->Update();
+      resliceTime[ r ] += vtkTimerLog::GetUniversalTime() - start;
+    }
+
+    vtkIdType count = static_cast< vtkIdType >( SliceSize ) * SliceSize;
+    const float* full = static_cast< const float* >( reslicers[0]->GetOutput()->GetScalarPointer() );
+    for ( int r = 1; r < NumberOfSources; ++ r )
+    {
+      const float* quantized = static_cast< const float* >( reslicers[ r ]->GetOutput()->GetScalarPointer() );
+      for ( vtkIdType i = 0; i < count; ++ i )
+      {
+        double error = fabs( static_cast< double >( quantized[ i ] ) - full[ i ] );
+        errorSum[ r ] += error;
+        maximumError[ r ] = std::max( maximumError[ r ], error );
+      }
+    }
+    numberOfSampled += count;
+  }
+
+  printf( "%-16s %10s %8s %10s %10s %12s %12s %12s\n",
+          "source", "MiB", "saved", "build s", "ms/slice", "mean error", "max error", "error bound" );
+  for ( int r = 0; r < NumberOfSources; ++ r )
+  {
+    double sourceBytes = static_cast< double >( volumeSize ) * volumeSize * volumeSize * sizeof( float );
+    double bytes = ( bits[ r ] == 0 ) ? sourceBytes : static_cast< double >( copies[ r ]->GetMemorySize() );
+    // The float sums of the interpolation differ in the last bits.
+    double bound = ( bits[ r ] == 0 ) ? 0.0 : copies[ r ]->GetMaximumError() * 1.0001 + 1.0e-3;
+    std::ostringstream name;
+    if ( bits[ r ] == 0 )
+    {
+      name << "float";
+    }
+    else
+    {
+      name << bits[ r ] << "-bit" << ( compressed[ r ] ? " compressed" : "" );
+    }
+    printf( "%-16s %10.1f %7.1f%% %10.2f %10.3f %12.5f %12.5f %12.5f\n",
+            name.str().c_str(), bytes / 1048576.0, 100.0 * ( 1.0 - bytes / sourceBytes ), buildTime[ r ],
+            resliceTime[ r ] * 1000.0 / numberOfSlices, errorSum[ r ] / numberOfSampled,
+            maximumError[ r ], bound );
+  }
+  return 0;
+}
+
+
+//----------------------------------------------------------------------------
+/// Arguments: [--slices n]
+///
+/// A short CT, a float MR and a label map of different sizes and
+/// geometries, resliced along the same oblique planes by one reslicer each
+/// and by a single multi-volume pass. Reports the time per plane of both
+/// and how far the layers of the single pass are from their separate
+/// slices.
+int BenchmarkMultiVolumeReslice( int argc, char* argv[] )
+{
+  int numberOfSlices = 50;
+  for ( int a = 0; a < argc; ++ a )
+  {
+    if ( strcmp( argv[ a ], "--slices" ) == 0 && a + 1 < argc )
+    {
+      numberOfSlices = atoi( argv[ ++ a ] );
+    }
+  }
+
+  const int NumberOfLayers = 3;
+  const char* names[ NumberOfLayers ] = { "CT short", "MR float", "label uchar" };
+  vtkSmartPointer< vtkImageData > volumes[ NumberOfLayers ];
+  vtkSmartPointer< vtkMatrix4x4 > rasToIJK[ NumberOfLayers ];
+  volumes[0] = CreateTestVolume( 256 );
+  rasToIJK[0] = vtkSmartPointer< vtkMatrix4x4 >::New();
+  CreateRASToIJK( rasToIJK[0], 256 );
+
+  // MR and label: 128^3 at 2 mm, the MR tilted about its z axis.
+  vtkSmartPointer< vtkImageData > small = CreateTestVolume( 128 );
+  const short* in = static_cast< const short* >( small->GetScalarPointer() );
+  int types[2] = { VTK_FLOAT, VTK_UNSIGNED_CHAR };
+  for ( int l = 1; l < NumberOfLayers; ++ l )
+  {
+    volumes[ l ] = vtkSmartPointer< vtkImageData >::New();
+    volumes[ l ]->SetExtent( small->GetExtent() );
+    volumes[ l ]->SetWholeExtent( small->GetExtent() );
+    volumes[ l ]->SetScalarType( types[ l - 1 ] );
+    volumes[ l ]->SetNumberOfScalarComponents( 1 );
+    volumes[ l ]->AllocateScalars();
+    vtkIdType count = 128 * 128 * 128;
+    for ( vtkIdType i = 0; i < count; ++ i )
+    {
+      if ( l == 1 )
+      {
+        static_cast< float* >( volumes[ l ]->GetScalarPointer() )[ i ] = in[ i ] * 0.5f + 0.125f;
+      }
+      else
+      {
+        static_cast< unsigned char* >( volumes[ l ]->GetScalarPointer() )[ i ] =
+          static_cast< unsigned char >( ( in[ i ] / 200 ) & 7 );
+      }
+    }
+
+    rasToIJK[ l ] = vtkSmartPointer< vtkMatrix4x4 >::New();
+    double angle = ( l == 1 ) ? 0.2 : 0.0;
+    rasToIJK[ l ]->Element[0][0] = 0.5 * cos( angle );
+    rasToIJK[ l ]->Element[0][1] = 0.5 * sin( angle );
+    rasToIJK[ l ]->Element[1][0] = -0.5 * sin( angle );
+    rasToIJK[ l ]->Element[1][1] = 0.5 * cos( angle );
+    rasToIJK[ l ]->Element[2][2] = 0.5;
+    for ( int k = 0; k < 3; ++ k )
+    {
+      rasToIJK[ l ]->Element[ k ][ 3 ] = 64.0;
+    }
+  }
+
+  int numberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  vtkSmartPointer< vtkSliceImageReslicer > separate[ NumberOfLayers ];
+  vtkSmartPointer< vtkMultiVolumeReslicer > combined = vtkSmartPointer< vtkMultiVolumeReslicer >::New();
+  combined->SetNumberOfThreads( numberOfThreads );
+  combined->SetNumberOfLayers( NumberOfLayers );
+  for ( int l = 0; l < NumberOfLayers; ++ l )
+  {
+    int interpolation = ( l == 2 ) ? vtkSliceImageReslicer::INTERPOLATION_NEAREST
+                                   : vtkSliceImageReslicer::INTERPOLATION_LINEAR;
+    separate[ l ] = vtkSmartPointer< vtkSliceImageReslicer >::New();
+    separate[ l ]->SetInput( volumes[ l ], rasToIJK[ l ] );
+    separate[ l ]->SetInterpolationMode( interpolation );
+    separate[ l ]->SetNumberOfThreads( numberOfThreads );
+    separate[ l ]->IncrementalUpdateOff();
+    combined->SetLayer( l, volumes[ l ], rasToIJK[ l ], interpolation );
+  }
+
+  double separateTime = 0.0;
+  double combinedTime = 0.0;
+  double maximumDifference[ NumberOfLayers ] = { 0.0, 0.0, 0.0 };
+  vtkIdType differing[ NumberOfLayers ] = { 0, 0, 0 };
+  vtkNew< vtkMatrix4x4 > pose;
+  vtkNew< vtkMatrix4x4 > xyToRAS;
+  vtkIdType count = static_cast< vtkIdType >( SliceSize ) * SliceSize;
+  for ( int n = 0; n < numberOfSlices; ++ n )
+  {
+    SetStreamPose( pose.GetPointer(), 10 * n );
+    SetPoseXYToRAS( xyToRAS.GetPointer(), pose.GetPointer() );
+
+    double start = vtkTimerLog::GetUniversalTime();
+    for ( int l = 0; l < NumberOfLayers; ++ l )
+    {
+      separate[ l ]->SetSliceGeometry( xyToRAS.GetPointer(), SliceSize, SliceSize );
+      separate[ l ]->Update();
+    }
+    separateTime += vtkTimerLog::GetUniversalTime() - start;
+
+    start = vtkTimerLog::GetUniversalTime();
+    combined->SetSliceGeometry( xyToRAS.GetPointer(), SliceSize, SliceSize );
+    combined->Update();
+    combinedTime += vtkTimerLog::GetUniversalTime() - start;
+
+    for ( int l = 0; l < NumberOfLayers; ++ l )
+    {
+      vtkImageData* a = separate[ l ]->GetOutput();
+      vtkImageData* b = combined->GetOutput( l );
+      for ( vtkIdType i = 0; i < count; ++ i )
+      {
+        double difference = fabs( a->GetPointData()->GetScalars()->GetComponent( i, 0 )
+                                  - b->GetPointData()->GetScalars()->GetComponent( i, 0 ) );
+        if ( difference > 0.0 )
+        {
+          ++ differing[ l ];
+          maximumDifference[ l ] = std::max( maximumDifference[ l ], difference );
+        }
+      }
+    }
+  }
+
+  printf( "%-12s %14s %14s %9s\n", "layers", "separate ms", "one pass ms", "speedup" );
+  printf( "%-12d %14.3f %14.3f %8.2fx\n", NumberOfLayers, separateTime * 1000.0 / numberOfSlices,
+          combinedTime * 1000.0 / numberOfSlices, combinedTime > 0.0 ? separateTime / combinedTime : 0.0 );
+  printf( "%-12s %14s %14s\n", "layer", "differing", "max diff" );
+  for ( int l = 0; l < NumberOfLayers; ++ l )
+  {
+    double fraction = static_cast< double >( differing[ l ] ) / ( count * numberOfSlices );
+    printf( "%-12s %13.4f%% %14g\n", names[ l ], fraction * 100.0, maximumDifference[ l ] );
+  }
+  printf( "Output buffers allocated: %d\n", combined->GetNumberOfAllocatedOutputs() );
+  return 0;
+}
+
+
+//----------------------------------------------------------------------------
+/// Arguments: [--slices n]
+///
+/// A 256^3 label map of 60 nested, wavy labels, resliced along oblique
+/// planes with its outlines, and by the generic nearest-neighbor reslicer
+/// for comparison. Reports the time per plane of both against the 16.7 ms
+/// of a 60 Hz frame, and the labels and outline points per plane.
+int BenchmarkLabelContours( int argc, char* argv[] )
+{
+  int numberOfSlices = 120;
+  for ( int a = 0; a < argc; ++ a )
+  {
+    if ( strcmp( argv[ a ], "--slices" ) == 0 && a + 1 < argc )
+    {
+      numberOfSlices = atoi( argv[ ++ a ] );
+    }
+  }
+
+  const int volumeSize = 256;
+  const int numberOfLabels = 60;
+  vtkSmartPointer< vtkImageData > labelMap = vtkSmartPointer< vtkImageData >::New();
+  labelMap->SetExtent( 0, volumeSize - 1, 0, volumeSize - 1, 0, volumeSize - 1 );
+  labelMap->SetWholeExtent( 0, volumeSize - 1, 0, volumeSize - 1, 0, volumeSize - 1 );
+  labelMap->SetScalarTypeToUnsignedChar();
+  labelMap->SetNumberOfScalarComponents( 1 );
+  labelMap->AllocateScalars();
+  unsigned char* p = static_cast< unsigned char* >( labelMap->GetScalarPointer() );
+  double center = volumeSize / 2.0;
+  for ( int z = 0; z < volumeSize; ++ z )
+  {
+    for ( int y = 0; y < volumeSize; ++ y )
+    {
+      for ( int x = 0; x < volumeSize; ++ x )
+      {
+        double r = sqrt( ( x - center ) * ( x - center ) + ( y - center ) * ( y - center )
+                         + ( z - center ) * ( z - center ) );
+        int label = static_cast< int >( r / 2.0 + 3.0 * sin( 0.05 * x ) * cos( 0.07 * y ) );
+        *p ++ = static_cast< unsigned char >( ( label >= 1 && label <= numberOfLabels ) ? label : 0 );
+      }
+    }
+  }
+  vtkNew< vtkMatrix4x4 > rasToIJK;
+  CreateRASToIJK( rasToIJK.GetPointer(), volumeSize );
+
+  vtkSmartPointer< vtkSliceImageReslicer > generic = vtkSmartPointer< vtkSliceImageReslicer >::New();
+  generic->SetInput( labelMap, rasToIJK.GetPointer() );
+  generic->SetInterpolationMode( vtkSliceImageReslicer::INTERPOLATION_NEAREST );
+  generic->SetNumberOfThreads( 1 );
+  generic->IncrementalUpdateOff();
+  vtkSmartPointer< vtkLabelMapSliceReslicer > contoured = vtkSmartPointer< vtkLabelMapSliceReslicer >::New();
+  contoured->SetInput( labelMap, rasToIJK.GetPointer() );
+
+  double genericTime = 0.0;
+  double contouredTime = 0.0;
+  double slowest = 0.0;
+  int fewestLabels = numberOfLabels;
+  double labelSum = 0.0;
+  double pointSum = 0.0;
+  vtkNew< vtkMatrix4x4 > pose;
+  vtkNew< vtkMatrix4x4 > xyToRAS;
+  for ( int n = 0; n < numberOfSlices; ++ n )
+  {
+    SetStreamPose( pose.GetPointer(), 10 * n );
+    SetPoseXYToRAS( xyToRAS.GetPointer(), pose.GetPointer() );
+
+    double start = vtkTimerLog::GetUniversalTime();
+    generic->SetSliceGeometry( xyToRAS.GetPointer(), SliceSize, SliceSize );
+    generic->Update();
+    genericTime += vtkTimerLog::GetUniversalTime() - start;
+
+    start = vtkTimerLog::GetUniversalTime();
+    contoured->SetSliceGeometry( xyToRAS.GetPointer(), SliceSize, SliceSize );
+    contoured->Update();
+    double elapsed = vtkTimerLog::GetUniversalTime() - start;
+    contouredTime += elapsed;
+    slowest = std::max( slowest, elapsed );
+    fewestLabels = std::min( fewestLabels, contoured->GetNumberOfLabels() );
+    labelSum += contoured->GetNumberOfLabels();
+    pointSum += contoured->GetContourOutput()->GetNumberOfPoints();
+  }
+
+  double frameBudget = 1000.0 / 60.0;
+  double contouredMean = contouredTime * 1000.0 / numberOfSlices;
+  printf( "%-28s %10s %10s\n", "", "mean ms", "max ms" );
+  printf( "%-28s %10.3f %10s\n", "nearest reslice only", genericTime * 1000.0 / numberOfSlices, "" );
+  printf( "%-28s %10.3f %10.3f\n", "label reslice + outlines", contouredMean, slowest * 1000.0 );
+  printf( "Labels per slice: %.1f mean, %d fewest; outline points per slice: %.0f\n",
+          labelSum / numberOfSlices, fewestLabels, pointSum / numberOfSlices );
+  printf( "60 Hz frame budget %.1f ms: %s\n", frameBudget, contouredMean <= frameBudget ? "met" : "missed" );
+  return 0;
+}
+
+
+//----------------------------------------------------------------------------
+/// Arguments: [--segments n] [--slices n]
+///
+/// A sphere of radius 80 mm, tessellated into n segments around and n / 2
+/// rings, about n^2 triangles (a million by default), cut along oblique
+/// planes through the indexed intersector and by testing every triangle.
+/// Reports the index build time, the time per plane of both against the
+/// 16.7 ms of a 60 Hz frame, and the triangles tested per plane.
+int BenchmarkModelPlaneIntersection( int argc, char* argv[] )
+{
+  int numberOfSegments = 1000;
+  int numberOfSlices = 120;
+  for ( int a = 0; a < argc; ++ a )
+  {
+    if ( strcmp( argv[ a ], "--segments" ) == 0 && a + 1 < argc )
+    {
+      numberOfSegments = std::max( 8, atoi( argv[ ++ a ] ) );
+    }
+    else if ( strcmp( argv[ a ], "--slices" ) == 0 && a + 1 < argc )
+    {
+      numberOfSlices = atoi( argv[ ++ a ] );
+    }
+  }
+
+  // Quads between the rings, triangles at the poles.
+  const double radius = 80.0;
+  const int numberOfRings = numberOfSegments / 2;
+  vtkSmartPointer< vtkPoints > points = vtkSmartPointer< vtkPoints >::New();
+  vtkSmartPointer< vtkCellArray > polys = vtkSmartPointer< vtkCellArray >::New();
+  points->InsertNextPoint( 0.0, 0.0, radius );
+  for ( int j = 1; j < numberOfRings; ++ j )
+  {
+    double theta = vtkMath::Pi() * j / numberOfRings;
+    for ( int i = 0; i < numberOfSegments; ++ i )
+    {
+      double phi = 2.0 * vtkMath::Pi() * i / numberOfSegments;
+      points->InsertNextPoint( radius * sin( theta ) * cos( phi ), radius * sin( theta ) * sin( phi ),
+                               radius * cos( theta ) );
+    }
+  }
+  vtkIdType southPole = points->InsertNextPoint( 0.0, 0.0, -radius );
+  for ( int j = 0; j < numberOfRings; ++ j )
+  {
+    for ( int i = 0; i < numberOfSegments; ++ i )
+    {
+      vtkIdType above = 1 + ( j - 1 ) * numberOfSegments;
+      vtkIdType below = 1 + j * numberOfSegments;
+      vtkIdType next = ( i + 1 ) % numberOfSegments;
+      if ( j == 0 )
+      {
+        polys->InsertNextCell( 3 );
+        polys->InsertCellPoint( 0 );
+        polys->InsertCellPoint( below + i );
+        polys->InsertCellPoint( below + next );
+      }
+      else if ( j == numberOfRings - 1 )
+      {
+        polys->InsertNextCell( 3 );
+        polys->InsertCellPoint( southPole );
+        polys->InsertCellPoint( above + next );
+        polys->InsertCellPoint( above + i );
+      }
+      else
+      {
+        polys->InsertNextCell( 4 );
+        polys->InsertCellPoint( above + i );
+        polys->InsertCellPoint( below + i );
+        polys->InsertCellPoint( below + next );
+        polys->InsertCellPoint( above + next );
+      }
+    }
+  }
+  vtkSmartPointer< vtkPolyData > mesh = vtkSmartPointer< vtkPolyData >::New();
+  mesh->SetPoints( points );
+  mesh->SetPolys( polys );
+
+  vtkSmartPointer< vtkModelPlaneIntersector > indexed = vtkSmartPointer< vtkModelPlaneIntersector >::New();
+  indexed->SetInput( mesh );
+  double start = vtkTimerLog::GetUniversalTime();
+  indexed->UpdateIndex();
+  double buildTime = vtkTimerLog::GetUniversalTime() - start;
+  vtkSmartPointer< vtkModelPlaneIntersector > exhaustive = vtkSmartPointer< vtkModelPlaneIntersector >::New();
+  exhaustive->SetInput( mesh );
+  exhaustive->UseIndexOff();
+
+  vtkSmartPointer< vtkPolyData > indexedCut = vtkSmartPointer< vtkPolyData >::New();
+  vtkSmartPointer< vtkPolyData > exhaustiveCut = vtkSmartPointer< vtkPolyData >::New();
+  double indexedTime = 0.0;
+  double exhaustiveTime = 0.0;
+  double slowest = 0.0;
+  double testedSum = 0.0;
+  double pointSum = 0.0;
+  vtkNew< vtkMatrix4x4 > pose;
+  for ( int n = 0; n < numberOfSlices; ++ n )
+  {
+    SetStreamPose( pose.GetPointer(), 10 * n );
+    double origin[3];
+    double normal[3];
+    for ( int k = 0; k < 3; ++ k )
+    {
+      origin[ k ] = pose->Element[ k ][ 3 ];
+      normal[ k ] = pose->Element[ k ][ 2 ];
+    }
+
+    start = vtkTimerLog::GetUniversalTime();
+    indexed->Intersect( origin, normal, NULL, indexedCut );
+    double elapsed = vtkTimerLog::GetUniversalTime() - start;
+    indexedTime += elapsed;
+    slowest = std::max( slowest, elapsed );
+    testedSum += indexed->GetNumberOfTestedTriangles();
+    pointSum += indexedCut->GetNumberOfPoints();
+
+    start = vtkTimerLog::GetUniversalTime();
+    exhaustive->Intersect( origin, normal, NULL, exhaustiveCut );
+    exhaustiveTime += vtkTimerLog::GetUniversalTime() - start;
+  }
+
+  double frameBudget = 1000.0 / 60.0;
+  double indexedMean = indexedTime * 1000.0 / numberOfSlices;
+  printf( "Triangles: %lld, index built in %.1f ms\n",
+          static_cast< long long >( indexed->GetNumberOfTriangles() ), buildTime * 1000.0 );
+  printf( "%-28s %10s %10s\n", "", "mean ms", "max ms" );
+  printf( "%-28s %10.3f %10s\n", "every triangle tested", exhaustiveTime * 1000.0 / numberOfSlices, "" );
+  printf( "%-28s %10.3f %10.3f\n", "indexed", indexedMean, slowest * 1000.0 );
+  printf( "Triangles tested per slice: %.0f; cut points per slice: %.0f\n",
+          testedSum / numberOfSlices, pointSum / numberOfSlices );
+  printf( "60 Hz frame budget %.1f ms: %s\n", frameBudget, indexedMean <= frameBudget ? "met" : "missed" );
+  return 0;
+}
+
+
+//----------------------------------------------------------------------------
+/// Arguments: [--rows n]
+///
+/// Slice frames of 1, 16 and 256 drivers polled from the pose channel,
+/// half of them with scaled axes, computed pose by pose as MRML events do
+/// (ComputeSlicePlane) and as one batch of the pose table, as a poll does.
+/// Each driver count runs until n frames (a million by default) have been
+/// computed both ways. Reports the nanoseconds per driver of both.
+int BenchmarkPoseTable( int argc, char* argv[] )
+{
+  int numberOfRows = 1 << 20;
+  for ( int a = 0; a < argc; ++ a )
+  {
+    if ( strcmp( argv[ a ], "--rows" ) == 0 && a + 1 < argc )
+    {
+      numberOfRows = std::max( 256, atoi( argv[ ++ a ] ) );
+    }
+  }
+
+  const int numberOfVariants = 4;
+  const int driverCounts[3] = { 1, 16, 256 };
+  vtkNew< vtkMatrix4x4 > pose;
+  vtkSlicerVolumeResliceDriverLogic::SlicePlane plane;
+  vtkSlicerVolumeResliceDriverLogic::SlicePlane batchPlane;
+  printf( "%-10s %14s %14s %10s\n", "drivers", "scalar ns", "batch ns", "speedup" );
+  for ( int c = 0; c < 3; ++ c )
+  {
+    int numberOfDrivers = driverCounts[ c ];
+    int numberOfRounds = numberOfRows / numberOfDrivers;
+
+    // A few poses per driver, cycled as they stream; calibrated probes
+    // with a pixel spacing of their own.
+    std::vector< double > poses( 16 * numberOfDrivers * numberOfVariants );
+    for ( int v = 0; v < numberOfVariants; ++ v )
+    {
+      for ( int d = 0; d < numberOfDrivers; ++ d )
+      {
+        SetStreamPose( pose.GetPointer(), 37 * d + 11 * v );
+        if ( d % 2 == 1 )
+        {
+          double spacing = 0.3 + 0.01 * ( d % 50 );
+          for ( int k = 0; k < 3; ++ k )
+          {
+            pose->Element[ k ][0] *= spacing;
+            pose->Element[ k ][1] *= spacing;
+          }
+        }
+        memcpy( &poses[ 16 * ( v * numberOfDrivers + d ) ], pose->Element, 16 * sizeof( double ) );
+      }
+    }
+
+    vtkSmartPointer< vtkDriverPoseTable > table = vtkSmartPointer< vtkDriverPoseTable >::New();
+    table->SetNumberOfRows( numberOfDrivers );
+    double scalarTime = 0.0;
+    double batchTime = 0.0;
+    float checksum = 0.0f;
+    for ( int r = 0; r < numberOfRounds; ++ r )
+    {
+      const double* roundPoses = &poses[ 16 * numberOfDrivers * ( r % numberOfVariants ) ];
+
+      double start = vtkTimerLog::GetUniversalTime();
+      for ( int d = 0; d < numberOfDrivers; ++ d )
+      {
+        pose->DeepCopy( roundPoses + 16 * d );
+        vtkSlicerVolumeResliceDriverLogic::ComputeSlicePlane( pose.GetPointer(),
+                                                              vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION,
+                                                              vtkSlicerVolumeResliceDriverLogic::ORIENTATION_INPLANE,
+                                                              plane );
+        checksum += plane.Position[0];
+      }
+      scalarTime += vtkTimerLog::GetUniversalTime() - start;
+
+      start = vtkTimerLog::GetUniversalTime();
+      for ( int d = 0; d < numberOfDrivers; ++ d )
+      {
+        table->SetPose( d, roundPoses + 16 * d );
+      }
+      table->Update();
+      for ( int d = 0; d < numberOfDrivers; ++ d )
+      {
+        table->GetSliceFrame( d, true, batchPlane.Transverse, batchPlane.Normal, batchPlane.Position );
+        checksum -= batchPlane.Position[0];
+      }
+      batchTime += vtkTimerLog::GetUniversalTime() - start;
+    }
+
+    double rows = static_cast< double >( numberOfRounds ) * numberOfDrivers;
+    printf( "%-10d %14.1f %14.1f %9.1fx\n", numberOfDrivers, scalarTime * 1.0e9 / rows, batchTime * 1.0e9 / rows,
+            batchTime > 0.0 ? scalarTime / batchTime : 0.0 );
+    if ( checksum != checksum )
+    {
+      printf( "(checksum %f)\n", checksum );
+    }
+  }
+  return 0;
+}
+
+
+//----------------------------------------------------------------------------
+/// Keeps the calling thread busy for the given time, as rendering would.
+void SimulateDisplay( double milliseconds )
+{
+  double end = vtkTimerLog::GetUniversalTime() + milliseconds / 1000.0;
+  while ( vtkTimerLog::GetUniversalTime() < end )
+  {
+  }
+}
+
+
+/// Arguments: [--frames n] [--display-ms t] [--threads n]
+///
+/// A 256^3 volume resliced along a stream of oblique poses, one pose per
+/// display frame of t ms (8 by default) spent on the calling thread, as
+/// rendering would. Synchronously, each pose is resampled before its
+/// frame is shown; pipelined, it is submitted to vtkAsyncSliceReslicer
+/// with 2 and 3 buffers and the newest finished frame is shown. Reports
+/// the frames shown per second, the time each pose event blocks the
+/// caller, the pose-to-display latency (50th and 95th percentile) and the
+/// poses superseded and frames skipped.
+int BenchmarkAsyncReslice( int argc, char* argv[] )
+{
+  int numberOfFrames = 300;
+  double displayTime = 8.0;
+  int numberOfThreads = 1;
+  for ( int a = 0; a < argc; ++ a )
+  {
+    if ( strcmp( argv[ a ], "--frames" ) == 0 && a + 1 < argc )
+    {
+      numberOfFrames = std::max( 10, atoi( argv[ ++ a ] ) );
+    }
+    else if ( strcmp( argv[ a ], "--display-ms" ) == 0 && a + 1 < argc )
+    {
+      displayTime = std::max( 0.0, atof( argv[ ++ a ] ) );
+    }
+    else if ( strcmp( argv[ a ], "--threads" ) == 0 && a + 1 < argc )
+    {
+      numberOfThreads = std::max( 1, atoi( argv[ ++ a ] ) );
+    }
+  }
+
+  const int volumeSize = 256;
+  vtkSmartPointer< vtkImageData > volume = CreateTestVolume( volumeSize );
+  vtkNew< vtkMatrix4x4 > rasToIJK;
+  CreateRASToIJK( rasToIJK.GetPointer(), volumeSize );
+  vtkNew< vtkMatrix4x4 > pose;
+  vtkNew< vtkMatrix4x4 > xyToRAS;
+
+  printf( "%-12s %10s %12s %10s %10s %11s %8s\n",
+          "mode", "frames/s", "blocked ms", "p50 ms", "p95 ms", "superseded", "skipped" );
+  for ( int mode = 0; mode < 3; ++ mode )
+  {
+    // Mode 0 is synchronous, modes 1 and 2 pipelined with 2 and 3 buffers.
+    vtkSmartPointer< vtkSliceImageReslicer > reslicer = vtkSmartPointer< vtkSliceImageReslicer >::New();
+    reslicer->SetNumberOfThreads( numberOfThreads );
+    reslicer->SetInput( volume, rasToIJK.GetPointer() );
+    vtkSmartPointer< vtkAsyncSliceReslicer > pipeline = vtkSmartPointer< vtkAsyncSliceReslicer >::New();
+    pipeline->SetNumberOfBuffers( mode + 1 );
+    pipeline->SetNumberOfThreads( numberOfThreads );
+    pipeline->SetInput( volume, rasToIJK.GetPointer() );
+    pipeline->Start();
+
+    std::vector< double > latencies;
+    latencies.reserve( numberOfFrames );
+    double blockedTime = 0.0;
+    double start = vtkTimerLog::GetUniversalTime();
+    for ( int n = 0; n < numberOfFrames; ++ n )
+    {
+      double eventStart = vtkTimerLog::GetUniversalTime();
+      SetStreamPose( pose.GetPointer(), n );
+      SetPoseXYToRAS( xyToRAS.GetPointer(), pose.GetPointer() );
+      if ( mode == 0 )
+      {
+        reslicer->SetSliceGeometry( xyToRAS.GetPointer(), SliceSize, SliceSize );
+        reslicer->Update();
+        double now = vtkTimerLog::GetUniversalTime();
+        latencies.push_back( ( now - eventStart ) * 1000.0 );
+        blockedTime += now - eventStart;
+      }
+      else
+      {
+        if ( pipeline->CollectOutput() )
+        {
+          latencies.push_back( ( vtkTimerLog::GetUniversalTime() - pipeline->GetOutputSubmitTime() ) * 1000.0 );
+        }
+        pipeline->Submit( xyToRAS.GetPointer(), SliceSize, SliceSize );
+        blockedTime += vtkTimerLog::GetUniversalTime() - eventStart;
+      }
+      SimulateDisplay( displayTime );
+    }
+    double elapsed = vtkTimerLog::GetUniversalTime() - start;
+
+    double latency[2] = { 0.0, 0.0 };
+    std::sort( latencies.begin(), latencies.end() );
+    const double fractions[2] = { 0.50, 0.95 };
+    for ( int p = 0; p < 2 && ! latencies.empty(); ++ p )
+    {
+      latency[ p ] = latencies[ static_cast< size_t >( fractions[ p ] * ( latencies.size() - 1 ) + 0.5 ) ];
+    }
+    std::ostringstream name;
+    if ( mode == 0 )
+    {
+      name << "synchronous";
+    }
+    else
+    {
+      name << "pipelined/" << ( mode + 1 );
+    }
+    printf( "%-12s %10.1f %12.3f %10.2f %10.2f %11lu %8lu\n",
+            name.str().c_str(), latencies.size() / elapsed, blockedTime * 1000.0 / numberOfFrames,
+            latency[0], latency[1], pipeline->GetNumberOfSupersededRequests(),
+            pipeline->GetNumberOfSkippedFrames() );
+    if ( mode == 0 )
+    {
+      continue;
+    }
+
+    // Let the worker finish before it is stopped; with two buffers it may
+    // still wait for the frame before the last to be collected.
+    do
+    {
+      pipeline->Wait();
+    }
+    while ( pipeline->CollectOutput() );
+    pipeline->Stop();
+  }
+  return 0;
+}
+
+
+/// Slices of the task-scheduler benchmark, each resampled by one thread.
+struct StaticSliceWork
+{
+  std::vector< vtkSliceImageReslicer* > Reslicers;
+  vtkMultiVolumeReslicer* LayerReslicer;
+  std::vector< double > BusyTimes;
+};
+
+VTK_THREAD_RETURN_TYPE StaticSliceThread( void* arg )
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast< vtkMultiThreader::ThreadInfo* >( arg );
+  StaticSliceWork* work = static_cast< StaticSliceWork* >( info->UserData );
+  double start = vtkTimerLog::GetUniversalTime();
+  // The layer slice comes last, as one more slice.
+  int numberOfSlices = static_cast< int >( work->Reslicers.size() ) + 1;
+  for ( int i = info->ThreadID; i < numberOfSlices; i += info->NumberOfThreads )
+  {
+    if ( i < static_cast< int >( work->Reslicers.size() ) )
+    {
+      work->Reslicers[ i ]->Update();
+    }
+    else
+    {
+      work->LayerReslicer->Update();
+    }
+  }
+  work->BusyTimes[ info->ThreadID ] = vtkTimerLog::GetUniversalTime() - start;
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+
+/// Arguments: [--frames n] [--threads n] [--task-pixels n]
+///
+/// An uneven load: a 1024^2 oblique slice through a 256^3 volume, seven
+/// 128^2 slices through a 64^3 volume and a 256^2 slice through both as
+/// layers, all along a pose stream. Each frame is resampled with one
+/// thread per slice, the slices spread over the threads as UpdateSlices()
+/// does, and with vtkResliceTaskScheduler in bands of task-pixels (16384
+/// by default). Reports the time per frame, the load imbalance (busiest
+/// thread over the mean) and, for the scheduler, the tasks each thread ran
+/// and stole.
+int BenchmarkTaskScheduler( int argc, char* argv[] )
+{
+  int numberOfFrames = 50;
+  int numberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  int taskPixels = 16384;
+  for ( int a = 0; a < argc; ++ a )
+  {
+    if ( strcmp( argv[ a ], "--frames" ) == 0 && a + 1 < argc )
+    {
+      numberOfFrames = std::max( 1, atoi( argv[ ++ a ] ) );
+    }
+    else if ( strcmp( argv[ a ], "--threads" ) == 0 && a + 1 < argc )
+    {
+      numberOfThreads = std::max( 1, atoi( argv[ ++ a ] ) );
+    }
+    else if ( strcmp( argv[ a ], "--task-pixels" ) == 0 && a + 1 < argc )
+    {
+      taskPixels = atoi( argv[ ++ a ] );
+    }
+  }
+
+  const int largeSize = 256;
+  const int smallSize = 64;
+  const int numberOfSmallSlices = 7;
+  vtkSmartPointer< vtkImageData > largeVolume = CreateTestVolume( largeSize );
+  vtkSmartPointer< vtkImageData > smallVolume = CreateTestVolume( smallSize );
+  vtkNew< vtkMatrix4x4 > largeRASToIJK;
+  CreateRASToIJK( largeRASToIJK.GetPointer(), largeSize );
+  vtkNew< vtkMatrix4x4 > smallRASToIJK;
+  CreateRASToIJK( smallRASToIJK.GetPointer(), smallSize );
+
+  // Slice 0 is the large one; mode 0 splits by slice, mode 1 schedules.
+  const int sliceSizes[2] = { 1024, 128 };
+  std::vector< vtkSmartPointer< vtkSliceImageReslicer > > reslicers[2];
+  vtkSmartPointer< vtkMultiVolumeReslicer > layerReslicers[2];
+  StaticSliceWork work;
+  work.BusyTimes.assign( numberOfThreads, 0.0 );
+  for ( int mode = 0; mode < 2; ++ mode )
+  {
+    for ( int s = 0; s <= numberOfSmallSlices; ++ s )
+    {
+      vtkSmartPointer< vtkSliceImageReslicer > reslicer = vtkSmartPointer< vtkSliceImageReslicer >::New();
+      reslicer->SetNumberOfThreads( 1 );
+      reslicer->SetInterpolationMode( vtkSliceImageReslicer::INTERPOLATION_LINEAR );
+      if ( s == 0 )
+      {
+        reslicer->SetInput( largeVolume, largeRASToIJK.GetPointer() );
+      }
+      else
+      {
+        reslicer->SetInput( smallVolume, smallRASToIJK.GetPointer() );
+      }
+      reslicers[ mode ].push_back( reslicer );
+    }
+    layerReslicers[ mode ] = vtkSmartPointer< vtkMultiVolumeReslicer >::New();
+    layerReslicers[ mode ]->SetNumberOfThreads( 1 );
+    layerReslicers[ mode ]->SetNumberOfLayers( 2 );
+    layerReslicers[ mode ]->SetLayer( 0, largeVolume, largeRASToIJK.GetPointer(),
+                                      vtkSliceImageReslicer::INTERPOLATION_LINEAR );
+    layerReslicers[ mode ]->SetLayer( 1, smallVolume, smallRASToIJK.GetPointer(),
+                                      vtkSliceImageReslicer::INTERPOLATION_NEAREST );
+  }
+  for ( int s = 0; s <= numberOfSmallSlices; ++ s )
+  {
+    work.Reslicers.push_back( reslicers[0][ s ] );
+  }
+  work.LayerReslicer = layerReslicers[0];
+
+  vtkNew< vtkMultiThreader > threader;
+  threader->SetNumberOfThreads( numberOfThreads );
+  threader->SetSingleMethod( StaticSliceThread, &work );
+  vtkSmartPointer< vtkResliceTaskScheduler > scheduler = vtkSmartPointer< vtkResliceTaskScheduler >::New();
+  scheduler->SetNumberOfThreads( numberOfThreads );
+  scheduler->SetTaskPixels( taskPixels );
+
+  vtkNew< vtkMatrix4x4 > pose;
+  vtkNew< vtkMatrix4x4 > xyToRAS;
+  double times[2] = { 0.0, 0.0 };
+  double imbalance[2] = { 0.0, 0.0 };
+  std::vector< int > threadTasks( numberOfThreads, 0 );
+  std::vector< int > threadSteals( numberOfThreads, 0 );
+  for ( int n = 0; n < numberOfFrames; ++ n )
+  {
+    // Same plane size in mm for all slices, at their own pixel spacing.
+    for ( int mode = 0; mode < 2; ++ mode )
+    {
+      for ( int s = 0; s <= numberOfSmallSlices + 1; ++ s )
+      {
+        SetStreamPose( pose.GetPointer(), n + 10 * s );
+        SetPoseXYToRAS( xyToRAS.GetPointer(), pose.GetPointer() );
+        int size = ( s == 0 ) ? sliceSizes[0] : ( s <= numberOfSmallSlices ? sliceSizes[1] : 256 );
+        for ( int k = 0; k < 3; ++ k )
+        {
+          xyToRAS->Element[ k ][ 0 ] *= static_cast< double >( SliceSize ) / size;
+          xyToRAS->Element[ k ][ 1 ] *= static_cast< double >( SliceSize ) / size;
+        }
+        if ( s <= numberOfSmallSlices )
+        {
+          reslicers[ mode ][ s ]->SetSliceGeometry( xyToRAS.GetPointer(), size, size );
+        }
+        else
+        {
+          layerReslicers[ mode ]->SetSliceGeometry( xyToRAS.GetPointer(), size, size );
+        }
+      }
+    }
+
+    double start = vtkTimerLog::GetUniversalTime();
+    threader->SingleMethodExecute();
+    times[0] += vtkTimerLog::GetUniversalTime() - start;
+    double busiest = 0.0;
+    double total = 0.0;
+    for ( int t = 0; t < numberOfThreads; ++ t )
+    {
+      busiest = std::max( busiest, work.BusyTimes[ t ] );
+      total += work.BusyTimes[ t ];
+      work.BusyTimes[ t ] = 0.0;
+    }
+    imbalance[0] += ( total > 0.0 ) ? busiest * numberOfThreads / total : 1.0;
+
+    start = vtkTimerLog::GetUniversalTime();
+    for ( int s = 0; s <= numberOfSmallSlices; ++ s )
+    {
+      if ( reslicers[1][ s ]->BeginUpdate() > 0 )
+      {
+        reslicers[1][ s ]->AddTasks( scheduler, s );
+      }
+    }
+    if ( layerReslicers[1]->BeginUpdate() > 0 )
+    {
+      layerReslicers[1]->AddTasks( scheduler, numberOfSmallSlices + 1 );
+    }
+    scheduler->Run();
+    for ( int s = 0; s <= numberOfSmallSlices; ++ s )
+    {
+      reslicers[1][ s ]->EndUpdate();
+    }
+    layerReslicers[1]->EndUpdate();
+    times[1] += vtkTimerLog::GetUniversalTime() - start;
+    imbalance[1] += scheduler->GetLoadImbalance();
+
+    for ( int t = 0; t < numberOfThreads; ++ t )
+    {
+      threadTasks[ t ] += scheduler->GetThreadTaskCount( t );
+      threadSteals[ t ] += scheduler->GetThreadStealCount( t );
+    }
+  }
+
+  printf( "%-10s %8s %12s %10s %10s\n", "mode", "threads", "ms/frame", "speedup", "imbalance" );
+  const char* names[2] = { "per-slice", "scheduled" };
+  for ( int mode = 0; mode < 2; ++ mode )
+  {
+    printf( "%-10s %8d %12.3f %10.2f %10.2f\n", names[ mode ], numberOfThreads,
+            times[ mode ] * 1000.0 / numberOfFrames, times[ mode ] > 0.0 ? times[0] / times[ mode ] : 0.0,
+            imbalance[ mode ] / numberOfFrames );
+  }
+  printf( "%-10s %12s %12s\n", "thread", "tasks/frame", "stolen/frame" );
+  for ( int t = 0; t < numberOfThreads; ++ t )
+  {
+    printf( "%-10d %12.1f %12.1f\n", t, static_cast< double >( threadTasks[ t ] ) / numberOfFrames,
+            static_cast< double >( threadSteals[ t ] ) / numberOfFrames );
+  }
+  return 0;
+}
+
+
+//----------------------------------------------------------------------------
+/// Arguments: [--slices n] [--threads n]
+///
+/// Reslices oblique 512^2 planes through a 256^3 short volume with each
+/// interpolation mode and reports the time per slice and per megapixel.
+int BenchmarkInterpolationKernels( int argc, char* argv[] )
+{
+  int numberOfSlices = 20;
+  int numberOfThreads = 1;
+  for ( int a = 0; a < argc; ++ a )
+  {
+    if ( strcmp( argv[ a ], "--slices" ) == 0 && a + 1 < argc )
+    {
+      numberOfSlices = std::max( 1, atoi( argv[ ++ a ] ) );
+    }
+    else if ( strcmp( argv[ a ], "--threads" ) == 0 && a + 1 < argc )
+    {
+      numberOfThreads = std::max( 1, atoi( argv[ ++ a ] ) );
+    }
+  }
+  const int NumberOfModes = 4;
+  const char* modeNames[ NumberOfModes ] = { "nearest", "linear", "cubic", "lanczos" };
+  const int modes[ NumberOfModes ] = { vtkSliceImageReslicer::INTERPOLATION_NEAREST,
+                                       vtkSliceImageReslicer::INTERPOLATION_LINEAR,
+                                       vtkSliceImageReslicer::INTERPOLATION_CUBIC,
+                                       vtkSliceImageReslicer::INTERPOLATION_LANCZOS };
+
+  // Cost per kernel.
+  const int volumeSize = 256;
+  vtkSmartPointer< vtkImageData > volume = CreateTestVolume( volumeSize );
+  vtkNew< vtkMatrix4x4 > rasToIJK;
+  CreateRASToIJK( rasToIJK.GetPointer(), volumeSize );
+  vtkNew< vtkMatrix4x4 > pose;
+  vtkNew< vtkMatrix4x4 > xyToRAS;
+  double resliceTime[ NumberOfModes ];
+  for ( int m = 0; m < NumberOfModes; ++ m )
+  {
+    vtkSmartPointer< vtkSliceImageReslicer > reslicer = vtkSmartPointer< vtkSliceImageReslicer >::New();
+    reslicer->IncrementalUpdateOff();
+    reslicer->SetNumberOfThreads( numberOfThreads );
+    reslicer->SetInterpolationMode( modes[ m ] );
+    reslicer->SetInput( volume, rasToIJK.GetPointer() );
+    double start = vtkTimerLog::GetUniversalTime();
+    for ( int n = 0; n < numberOfSlices; ++ n )
+    {
+      SetStreamPose( pose.GetPointer(), 10 * n );
+      SetPoseXYToRAS( xyToRAS.GetPointer(), pose.GetPointer() );
+      reslicer->SetSliceGeometry( xyToRAS.GetPointer(), SliceSize, SliceSize );
+      reslicer->Update();
+    }
+    resliceTime[ m ] = ( vtkTimerLog::GetUniversalTime() - start ) * 1000.0 / numberOfSlices;
+  }
+  double megapixels = static_cast< double >( SliceSize ) * SliceSize / 1.0e6;
+  printf( "%d^3 short volume, %dx%d oblique slices, %d thread(s)\n", volumeSize, SliceSize, SliceSize,
+          numberOfThreads );
+  printf( "%-10s %12s %12s %12s\n", "kernel", "ms/slice", "ms/Mpixel", "vs linear" );
+  for ( int m = 0; m < NumberOfModes; ++ m )
+  {
+    printf( "%-10s %12.3f %12.3f %11.2fx\n", modeNames[ m ], resliceTime[ m ], resliceTime[ m ] / megapixels,
+            resliceTime[1] > 0.0 ? resliceTime[ m ] / resliceTime[1] : 0.0 );
+  }
+  return 0;
+}
+
+
+//----------------------------------------------------------------------------
+/// Arguments: [--frames n] [--time-points n] [--prefetch n] [--threads n]
+///
+/// Plays a 4D series of 192^3 short volumes at one time point per frame
+/// and reports the time per frame of the series reslicer, with the plane
+/// still, moving every fourth frame as with poses slower than playback,
+/// and moving every frame, against resampling each time point with
+/// vtkSliceImageReslicer. The prefetch worker is given the
+/// display interval between frames, outside the timed updates.
+int BenchmarkTimeSeriesReslice( int argc, char* argv[] )
+{
+  int numberOfFrames = 60;
+  int numberOfTimePoints = 10;
+  int prefetchCapacity = 4;
+  int numberOfThreads = 1;
+  for ( int a = 0; a < argc; ++ a )
+  {
+    if ( strcmp( argv[ a ], "--frames" ) == 0 && a + 1 < argc )
+    {
+      numberOfFrames = std::max( 1, atoi( argv[ ++ a ] ) );
+    }
+    else if ( strcmp( argv[ a ], "--time-points" ) == 0 && a + 1 < argc )
+    {
+      numberOfTimePoints = std::max( 2, atoi( argv[ ++ a ] ) );
+    }
+    else if ( strcmp( argv[ a ], "--prefetch" ) == 0 && a + 1 < argc )
+    {
+      prefetchCapacity = std::max( 0, atoi( argv[ ++ a ] ) );
+    }
+    else if ( strcmp( argv[ a ], "--threads" ) == 0 && a + 1 < argc )
+    {
+      numberOfThreads = std::max( 1, atoi( argv[ ++ a ] ) );
+    }
+  }
+
+  const int volumeSize = 192;
+  std::vector< vtkSmartPointer< vtkImageData > > timePoints;
+  std::vector< vtkImageData* > images;
+  std::vector< double > times;
+  CreateTimeSeries( volumeSize, numberOfTimePoints, timePoints, images, times );
+  vtkNew< vtkMatrix4x4 > rasToIJK;
+  CreateRASToIJK( rasToIJK.GetPointer(), volumeSize );
+  vtkNew< vtkMatrix4x4 > pose;
+  vtkNew< vtkMatrix4x4 > xyToRAS;
+
+  // Frames per pose of each scenario; the last one resamples each time
+  // point with vtkSliceImageReslicer along a moving plane.
+  const int NumberOfScenarios = 4;
+  const char* scenarioNames[ NumberOfScenarios ] = { "series, still plane", "series, pose / 4 frames",
+                                                     "series, pose / frame", "per time point" };
+  const int framesPerPose[ NumberOfScenarios ] = { numberOfFrames, 4, 1, 1 };
+  const int seriesScenarios = NumberOfScenarios - 1;
+  double frameTime[ NumberOfScenarios ];
+  unsigned long prefetchHits[ NumberOfScenarios ];
+  unsigned long plans[ NumberOfScenarios ];
+  for ( int scenario = 0; scenario < NumberOfScenarios; ++ scenario )
+  {
+    vtkSmartPointer< vtkTimeSeriesSliceReslicer > series = vtkSmartPointer< vtkTimeSeriesSliceReslicer >::New();
+    series->SetNumberOfThreads( numberOfThreads );
+    series->SetPrefetchCapacity( prefetchCapacity );
+    series->SetTimePoints( images, times );
+    series->SetRASToIJK( rasToIJK.GetPointer() );
+    vtkSmartPointer< vtkSliceImageReslicer > reslicer = vtkSmartPointer< vtkSliceImageReslicer >::New();
+    reslicer->IncrementalUpdateOff();
+    reslicer->SetNumberOfThreads( numberOfThreads );
+
+    double elapsed = 0.0;
+    for ( int n = 0; n < numberOfFrames; ++ n )
+    {
+      SetStreamPose( pose.GetPointer(), 10 * ( n / framesPerPose[ scenario ] ) );
+      SetPoseXYToRAS( xyToRAS.GetPointer(), pose.GetPointer() );
+      int timePoint = n % numberOfTimePoints;
+      double start = vtkTimerLog::GetUniversalTime();
+      if ( scenario < seriesScenarios )
+      {
+        series->SetSliceGeometry( xyToRAS.GetPointer(), SliceSize, SliceSize );
+        series->SetTime( times[ timePoint ] );
+        series->Update();
+      }
+      else
+      {
+        reslicer->SetInput( images[ timePoint ], rasToIJK.GetPointer() );
+        reslicer->SetSliceGeometry( xyToRAS.GetPointer(), SliceSize, SliceSize );
+        reslicer->Update();
+      }
+      elapsed += vtkTimerLog::GetUniversalTime() - start;
+      series->Wait();
+    }
+    frameTime[ scenario ] = elapsed * 1000.0 / numberOfFrames;
+    prefetchHits[ scenario ] = series->GetNumberOfPrefetchHits();
+    plans[ scenario ] = series->GetNumberOfPlans();
+  }
+  printf( "%d time points of %d^3 short, %dx%d oblique slices, %d frames, prefetch %d, %d thread(s)\n",
+          numberOfTimePoints, volumeSize, SliceSize, SliceSize, numberOfFrames, prefetchCapacity, numberOfThreads );
+  printf( "%-24s %12s %12s %8s\n", "scenario", "ms/frame", "prefetched", "plans" );
+  for ( int scenario = 0; scenario < NumberOfScenarios; ++ scenario )
+  {
+    if ( scenario < seriesScenarios )
+    {
+      printf( "%-24s %12.3f %12lu %8lu\n", scenarioNames[ scenario ], frameTime[ scenario ],
+              prefetchHits[ scenario ], plans[ scenario ] );
+    }
+    else
+    {
+      printf( "%-24s %12.3f %12s %8s\n", scenarioNames[ scenario ], frameTime[ scenario ], "-", "-" );
+    }
+  }
+  return 0;
+}
+
+
+/// Fixed pose-stream scenarios for the performance suite.
+struct PerformanceScenario
+{
+  const char* Name;
+  int NumberOfDrivers;
+  int SlicesPerDriver;
+  /// Pose events per second the scenario must sustain.
+  double TargetRate;
+  /// Drive with a scalar volume node whose image changes every frame.
+  bool ImageDriver;
+  int NumberOfEvents;
+};
+
+const PerformanceScenario PerformanceScenarios[] =
+{
+  { "1-driver-3-slices-200hz",    1, 3, 200.0, false, 4000 },
+  { "10-drivers-30-slices-200hz", 10, 3, 200.0, false, 4000 },
+  { "image-driver-3-slices-60fps", 1, 3, 60.0, true, 1200 },
+};
+
+
+struct PerformanceResult
+{
+  double Throughput;  // events per second
+  double Latency[3];  // 50th, 95th, 99th percentile, ms
+};
+
+
+/// Push the scenario's events through a fresh scene and logic, one
+/// driver after the other, back to back, timing each event.
+PerformanceResult RunPerformanceScenario( const PerformanceScenario& scenario )
+{
+  vtkSmartPointer< vtkMRMLScene > scene = vtkSmartPointer< vtkMRMLScene >::New();
+  vtkSmartPointer< vtkSlicerVolumeResliceDriverLogic > logic =
+    vtkSmartPointer< vtkSlicerVolumeResliceDriverLogic >::New();
+  logic->SetMRMLScene( scene );
+
+  std::vector< vtkSmartPointer< vtkMRMLLinearTransformNode > > transformDrivers;
+  std::vector< vtkSmartPointer< vtkMRMLScalarVolumeNode > > imageDrivers;
+  std::vector< vtkSmartPointer< vtkMRMLSliceNode > > slices;
+  vtkSmartPointer< vtkImageData > frame = vtkSmartPointer< vtkImageData >::New();
+  frame->SetDimensions( 256, 256, 1 );
+  frame->SetScalarTypeToUnsignedChar();
+  frame->AllocateScalars();
+
+  for ( int d = 0; d < scenario.NumberOfDrivers; ++ d )
+  {
+    const char* driverID = NULL;
+    if ( scenario.ImageDriver )
+    {
+      vtkSmartPointer< vtkMRMLScalarVolumeNode > driver = vtkSmartPointer< vtkMRMLScalarVolumeNode >::New();
+      driver->SetAndObserveImageData( frame );
+      scene->AddNode( driver );
+      imageDrivers.push_back( driver );
+      driverID = driver->GetID();
+    }
+    else
+    {
+      vtkSmartPointer< vtkMRMLLinearTransformNode > driver = vtkSmartPointer< vtkMRMLLinearTransformNode >::New();
+      scene->AddNode( driver );
+      transformDrivers.push_back( driver );
+      driverID = driver->GetID();
+    }
+    for ( int s = 0; s < scenario.SlicesPerDriver; ++ s )
+    {
+      vtkSmartPointer< vtkMRMLSliceNode > slice = vtkSmartPointer< vtkMRMLSliceNode >::New();
+      std::ostringstream layoutName;
+      layoutName << "Driver" << d << "Slice" << s;
+      slice->SetLayoutName( layoutName.str().c_str() );
+      scene->AddNode( slice );
+      logic->SetDriverForSlice( driverID, slice );
+      logic->SetMethodForSlice( vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION, slice );
+      logic->SetOrientationForSlice( vtkSlicerVolumeResliceDriverLogic::ORIENTATION_INPLANE + s % 3, slice );
+      slices.push_back( slice );
+    }
+  }
+
+  vtkSmartPointer< vtkMatrix4x4 > pose = vtkSmartPointer< vtkMatrix4x4 >::New();
+  std::vector< double > latencies( scenario.NumberOfEvents );
+  double start = vtkTimerLog::GetUniversalTime();
+  for ( int n = 0; n < scenario.NumberOfEvents; ++ n )
+  {
+    int d = n % scenario.NumberOfDrivers;
+    SetStreamPose( pose, n / scenario.NumberOfDrivers );
+    double eventStart = vtkTimerLog::GetUniversalTime();
+    if ( scenario.ImageDriver )
+    {
+      imageDrivers[ d ]->SetIJKToRASMatrix( pose );
+      frame->Modified();
+    }
+    else
+    {
+      transformDrivers[ d ]->GetMatrixTransformToParent()->DeepCopy( pose );
+    }
+    latencies[ n ] = ( vtkTimerLog::GetUniversalTime() - eventStart ) * 1000.0;
+  }
+  double elapsed = vtkTimerLog::GetUniversalTime() - start;
+
+  PerformanceResult result;
+  result.Throughput = elapsed > 0.0 ? scenario.NumberOfEvents / elapsed : 0.0;
+  std::sort( latencies.begin(), latencies.end() );
+  const double fractions[3] = { 0.50, 0.95, 0.99 };
+  for ( int p = 0; p < 3; ++ p )
+  {
+    result.Latency[ p ] = latencies[ static_cast< size_t >( fractions[ p ] * ( latencies.size() - 1 ) + 0.5 ) ];
+  }
+  return result;
+}
+
+
+//----------------------------------------------------------------------------
+/// Arguments: [--scenario name] [--baselines file] [--output file.json]
+///            [--tolerance fraction] [--update]
+///
+/// Runs the fixed scenarios, or the named one, and compares throughput and
+/// 95th percentile latency against the baselines file ("scenario throughput
+/// p95" per line, # for comments), failing if either is worse by more than
+/// the tolerance or the target rate is not sustained. The committed
+/// baselines are the floors the tests check on any machine; record machine
+/// specific ones with --update into another file to track a reference
+/// machine. Results are written as JSON for tracking over time.
+int BenchmarkPerformanceSuite( int argc, char* argv[] )
+{
+  std::string baselinesFile = "VolumeResliceDriverBaselines.txt";
+  std::string scenarioName;
+  std::string outputFile;
+  double tolerance = 0.25;
+  bool update = false;
+  for ( int a = 0; a < argc; ++ a )
+  {
+    if ( strcmp( argv[ a ], "--scenario" ) == 0 && a + 1 < argc )
+    {
+      scenarioName = argv[ ++ a ];
+    }
+    else if ( strcmp( argv[ a ], "--baselines" ) == 0 && a + 1 < argc )
+    {
+      baselinesFile = argv[ ++ a ];
+    }
+    else if ( strcmp( argv[ a ], "--output" ) == 0 && a + 1 < argc )
+    {
+      outputFile = argv[ ++ a ];
+    }
+    else if ( strcmp( argv[ a ], "--tolerance" ) == 0 && a + 1 < argc )
+    {
+      tolerance = atof( argv[ ++ a ] );
+    }
+    else if ( strcmp( argv[ a ], "--update" ) == 0 )
+    {
+      update = true;
+    }
+    else
+    {
+      fprintf( stderr, "Unknown argument %s\n", argv[ a ] );
+      return 1;
+    }
+  }
+
+  std::map< std::string, std::pair< double, double > > baselines;
+  std::ifstream baselinesIn( baselinesFile.c_str() );
+  std::string line;
+  while ( std::getline( baselinesIn, line ) )
+  {
+    std::istringstream fields( line );
+    std::string name;
+    double throughput = 0.0;
+    double latency = 0.0;
+    if ( line.empty() || line[0] == '#' || ! ( fields >> name >> throughput >> latency ) )
+    {
+      continue;
+    }
+    baselines[ name ] = std::make_pair( throughput, latency );
+  }
+
+  const int count = sizeof( PerformanceScenarios ) / sizeof( PerformanceScenarios[0] );
+  bool found = scenarioName.empty();
+  for ( int i = 0; i < count && ! found; ++ i )
+  {
+    found = ( scenarioName == PerformanceScenarios[ i ].Name );
+  }
+  if ( ! found )
+  {
+    fprintf( stderr, "Unknown scenario %s\n", scenarioName.c_str() );
+    return 1;
+  }
+
+  std::ostringstream json;
+  json << "{\"tolerance\":" << tolerance << ",\"scenarios\":[";
+  printf( "%-28s %12s %12s %9s %9s %9s  %s\n",
+          "scenario", "events/s", "base ev/s", "p50 ms", "p95 ms", "base p95", "status" );
+  int status = 0;
+  int reported = 0;
+  for ( int i = 0; i < count; ++ i )
+  {
+    const PerformanceScenario& scenario = PerformanceScenarios[ i ];
+    if ( ! scenarioName.empty() && scenarioName != scenario.Name )
+    {
+      continue;
+    }
+    PerformanceResult result = RunPerformanceScenario( scenario );
+
+    const char* verdict = "no baseline";
+    bool failed = result.Throughput < scenario.TargetRate;
+    std::map< std::string, std::pair< double, double > >::iterator baseline = baselines.find( scenario.Name );
+    double baseThroughput = 0.0;
+    double baseLatency = 0.0;
+    if ( baseline != baselines.end() )
+    {
+      baseThroughput = baseline->second.first;
+      baseLatency = baseline->second.second;
+      failed = failed
+               || result.Throughput < baseThroughput * ( 1.0 - tolerance )
+               || result.Latency[1] > baseLatency * ( 1.0 + tolerance );
+      verdict = "pass";
+    }
+    if ( failed )
+    {
+      verdict = "FAIL";
+      status = 1;
+    }
+    if ( update )
+    {
+      baselines[ scenario.Name ] = std::make_pair( result.Throughput, result.Latency[1] );
+    }
+
+    printf( "%-28s %12.0f %12.0f %9.3f %9.3f %9.3f  %s\n", scenario.Name, result.Throughput, baseThroughput,
+            result.Latency[0], result.Latency[1], baseLatency, verdict );
+    json << ( reported ++ > 0 ? "," : "" ) << "{\"name\":\"" << scenario.Name << "\""
+         << ",\"target_rate\":" << scenario.TargetRate
+         << ",\"events\":" << scenario.NumberOfEvents
+         << ",\"throughput\":" << result.Throughput
+         << ",\"latency_p50_ms\":" << result.Latency[0]
+         << ",\"latency_p95_ms\":" << result.Latency[1]
+         << ",\"latency_p99_ms\":" << result.Latency[2]
+         << ",\"baseline_throughput\":" << baseThroughput
+         << ",\"baseline_latency_p95_ms\":" << baseLatency
+         << ",\"status\":\"" << verdict << "\"}";
+  }
+  json << "]}";
+
+  if ( ! outputFile.empty() )
+  {
+    std::ofstream output( outputFile.c_str() );
+    output << json.str() << std::endl;
+  }
+  if ( update )
+  {
+    std::ofstream baselinesOut( baselinesFile.c_str() );
+    for ( std::map< std::string, std::pair< double, double > >::iterator it = baselines.begin();
+          it != baselines.end(); ++ it )
+    {
+      baselinesOut << it->first << " " << it->second.first << " " << it->second.second << std::endl;
+    }
+    printf( "Baselines written to %s\n", baselinesFile.c_str() );
+    return 0;
+  }
+  return status;
+}
+
+
+//----------------------------------------------------------------------------
+struct BenchmarkEntry
+{
+  const char* Name;
+  /// Receives the arguments following the benchmark name.
+  int (*Function)( int argc, char* argv[] );
+};
+
+const BenchmarkEntry Benchmarks[] =
+{
+  { "reslice-incremental", BenchmarkIncrementalReslice },
+  { "reslice-mapped", BenchmarkMappedReslice },
+  { "pose-channel", BenchmarkPoseChannel },
+  { "bulk-configuration", BenchmarkBulkConfiguration },
+  { "parallel-slices", BenchmarkParallelSlices },
+  { "batch-reslice", BenchmarkBatchReslice },
+  { "quantized-reslice", BenchmarkQuantizedReslice },
+  { "multi-volume-reslice", BenchmarkMultiVolumeReslice },
+  { "label-contours", BenchmarkLabelContours },
+  { "model-plane-intersection", BenchmarkModelPlaneIntersection },
+  { "pose-table", BenchmarkPoseTable },
+  { "async-reslice", BenchmarkAsyncReslice },
+  { "task-scheduler", BenchmarkTaskScheduler },
+  { "interpolation-kernels", BenchmarkInterpolationKernels },
+  { "time-series-reslice", BenchmarkTimeSeriesReslice },
+  { "perf-suite", BenchmarkPerformanceSuite },
+};
+
+const int NumberOfBenchmarks = sizeof( Benchmarks ) / sizeof( Benchmarks[0] );
+
+} // namespace
+
+
+
+int main( int argc, char* argv[] )
+{
+  int status = 0;
+  bool found = false;
+  for ( int i = 0; i < NumberOfBenchmarks; ++ i )
+  {
+    if ( argc >= 2 && strcmp( argv[1], Benchmarks[ i ].Name ) != 0 )
+    {
+      continue;
+    }
+    found = true;
+    printf( "== %s\n", Benchmarks[ i ].Name );
+    status |= ( argc >= 2 ) ? Benchmarks[ i ].Function( argc - 2, argv + 2 )
+                            : Benchmarks[ i ].Function( 0, argv + argc );
+    printf( "\n" );
+  }
+  if ( ! found )
+  {
+    fprintf( stderr, "Unknown benchmark %s\n", argv[1] );
+    return 1;
+  }
+  return status;
+}
@@ -0,0 +1,128 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Stand-in for an external tracker process: creates a shared-memory pose
+// channel and writes synthetic poses for the given driver node IDs.
+//
+// Usage: VolumeResliceDriverPoseWriter channel driverID [driverID ...]
+//          [--rate hz] [--duration seconds]
+// Writes until the duration elapses (default: forever, 100 Hz).
+
+// VolumeResliceDriver includes
+#include "vtkSharedMemoryPoseChannel.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+
+
+namespace
+{
+
+/// Pose n of driver d: each driver circles a different point in a tilted plane.
+void SetDriverPose( double matrix[16], int d, int n )
+{
+  double angle = 0.02 * n + 0.5 * d;
+  double c = cos( angle );
+  double s = sin( angle );
+  const double identity[16] = { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 };
+  memcpy( matrix, identity, sizeof( identity ) );
+  matrix[0] = c;
+  matrix[1] = -s;
+  matrix[4] = s;
+  matrix[5] = c;
+  matrix[3] = 20.0 * d + 30.0 * c;
+  matrix[7] = 30.0 * s;
+  matrix[11] = 10.0 * sin( 0.01 * n );
+}
+
+} // namespace
+
+
+
+int main( int argc, char* argv[] )
+{
+  const char* channelName = NULL;
+  std::vector< const char* > driverIDs;
+  double rate = 100.0;
+  double duration = -1.0;
+  for ( int i = 1; i < argc; ++ i )
+  {
+    if ( strcmp( argv[ i ], "--rate" ) == 0 && i + 1 < argc )
+    {
+      rate = atof( argv[ ++ i ] );
+    }
+    else if ( strcmp( argv[ i ], "--duration" ) == 0 && i + 1 < argc )
+    {
+      duration = atof( argv[ ++ i ] );
+    }
+    else if ( channelName == NULL )
+    {
+      channelName = argv[ i ];
+    }
+    else
+    {
+      driverIDs.push_back( argv[ i ] );
+    }
+  }
+  if ( channelName == NULL || driverIDs.empty() || rate <= 0.0 )
+  {
+    fprintf( stderr, "Usage: %s channel driverID [driverID ...] [--rate hz] [--duration seconds]\n", argv[0] );
+    return 1;
+  }
+
+  vtkSmartPointer< vtkSharedMemoryPoseChannel > channel = vtkSmartPointer< vtkSharedMemoryPoseChannel >::New();
+  if ( ! channel->Create( channelName, static_cast< int >( driverIDs.size() ) ) )
+  {
+    return 1;
+  }
+  printf( "Writing %d driver poses to %s at %g Hz\n", static_cast< int >( driverIDs.size() ), channelName, rate );
+
+  double matrix[16];
+  double start = vtkTimerLog::GetUniversalTime();
+  for ( int n = 0; ; ++ n )
+  {
+    double next = start + n / rate;
+    double now = vtkTimerLog::GetUniversalTime();
+    if ( duration >= 0.0 && now - start > duration )
+    {
+      break;
+    }
+    if ( next > now )
+    {
+      vtksys::SystemTools::Delay( static_cast< unsigned int >( ( next - now ) * 1000.0 ) );
+    }
+    now = vtkTimerLog::GetUniversalTime();
+    for ( unsigned int d = 0; d < driverIDs.size(); ++ d )
+    {
+      SetDriverPose( matrix, d, n );
+      channel->WritePose( d, driverIDs[ d ], now, matrix, true );
+    }
+  }
+
+  channel->Detach();
+  return 0;
+}
@@ -0,0 +1,550 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VolumeResliceDriver includes
+#include "vtkAsyncSliceReslicer.h"
+#include "vtkMemoryMappedImage.h"
+#include "vtkQuantizedImage.h"
+#include "vtkResliceImageCache.h"
+#include "vtkSliceImageReslicer.h"
+
+// VTK includes
+#include <vtkConditionVariable.h>
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <cstring>
+
+
+
+vtkStandardNewMacro(vtkAsyncSliceReslicer);
+
+
+
+vtkAsyncSliceReslicer
+::vtkAsyncSliceReslicer()
+{
+  this->NumberOfBuffers = 3;
+  this->NumberOfThreads = 1;
+  this->InterpolationMode = vtkSliceImageReslicer::INTERPOLATION_LINEAR;
+  this->Running = false;
+  this->ThreadID = -1;
+  this->ResampleRASToIJK = vtkSmartPointer< vtkMatrix4x4 >::New();
+
+  this->Next.VolumeMTime = 0;
+  vtkMatrix4x4::Identity( this->Next.RASToIJK );
+  vtkMatrix4x4::Identity( this->Next.XYToRAS );
+  this->Next.Size[0] = 0;
+  this->Next.Size[1] = 0;
+  this->Next.NumberOfThreads = 1;
+  this->Next.InterpolationMode = this->InterpolationMode;
+  this->Next.SubmitTime = 0.0;
+  this->Pending = this->Next;
+  this->PendingValid = false;
+  this->InputCopySource = NULL;
+  this->InputCopyMTime = 0;
+  this->NumberOfInputCopies = 0;
+
+  this->Front = -1;
+  this->Ready = -1;
+  this->Busy = -1;
+  this->NumberOfSubmittedRequests = 0;
+  this->NumberOfSupersededRequests = 0;
+  this->NumberOfFinishedFrames = 0;
+  this->NumberOfCachedFrames = 0;
+  this->NumberOfCollectedFrames = 0;
+  this->NumberOfSkippedFrames = 0;
+
+  this->Mutex = vtkMutexLock::New();
+  this->RequestPending = vtkConditionVariable::New();
+  this->WorkerIdle = vtkConditionVariable::New();
+  this->Threader = vtkMultiThreader::New();
+}
+
+
+
+vtkAsyncSliceReslicer
+::~vtkAsyncSliceReslicer()
+{
+  this->Stop();
+  this->Threader->Delete();
+  this->WorkerIdle->Delete();
+  this->RequestPending->Delete();
+  this->Mutex->Delete();
+}
+
+
+
+void vtkAsyncSliceReslicer
+::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf( os, indent );
+
+  os << indent << "NumberOfBuffers: " << this->NumberOfBuffers << std::endl;
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << std::endl;
+  os << indent << "InterpolationMode: " << this->InterpolationMode << std::endl;
+  os << indent << "Running: " << ( this->Running ? "Yes" : "No" ) << std::endl;
+  os << indent << "NumberOfInputCopies: " << this->NumberOfInputCopies << std::endl;
+  this->Mutex->Lock();
+  os << indent << "NumberOfSubmittedRequests: " << this->NumberOfSubmittedRequests << std::endl;
+  os << indent << "NumberOfSupersededRequests: " << this->NumberOfSupersededRequests << std::endl;
+  os << indent << "NumberOfFinishedFrames: " << this->NumberOfFinishedFrames << std::endl;
+  os << indent << "NumberOfCachedFrames: " << this->NumberOfCachedFrames << std::endl;
+  os << indent << "NumberOfCollectedFrames: " << this->NumberOfCollectedFrames << std::endl;
+  os << indent << "NumberOfSkippedFrames: " << this->NumberOfSkippedFrames << std::endl;
+  this->Mutex->Unlock();
+}
+
+
+
+void vtkAsyncSliceReslicer
+::SetCache( vtkResliceImageCache* cache )
+{
+  // Buffers pick it up at Start().
+  this->Cache = cache;
+}
+
+
+
+void vtkAsyncSliceReslicer
+::Start()
+{
+  if ( this->Running )
+  {
+    return;
+  }
+
+  this->Buffers.resize( this->NumberOfBuffers );
+  for ( int i = 0; i < this->NumberOfBuffers; ++ i )
+  {
+    Buffer& buffer = this->Buffers[ i ];
+    if ( buffer.Reslicer == NULL )
+    {
+      buffer.Reslicer = vtkSmartPointer< vtkSliceImageReslicer >::New();
+      buffer.XYToRAS = vtkSmartPointer< vtkMatrix4x4 >::New();
+    }
+    buffer.Reslicer->SetCache( this->Cache );
+    buffer.SubmitTime = 0.0;
+    buffer.FinishTime = 0.0;
+  }
+  this->Front = -1;
+  this->Ready = -1;
+  this->Busy = -1;
+  this->PendingValid = false;
+
+  this->Running = true;
+  this->ThreadID = this->Threader->SpawnThread( vtkAsyncSliceReslicer::WorkerThread, this );
+  this->Modified();
+}
+
+
+
+void vtkAsyncSliceReslicer
+::Stop()
+{
+  if ( ! this->Running )
+  {
+    return;
+  }
+
+  this->Mutex->Lock();
+  this->Running = false;
+  this->PendingValid = false;
+  this->RequestPending->Broadcast();
+  this->Mutex->Unlock();
+
+  this->Threader->TerminateThread( this->ThreadID );
+  this->ThreadID = -1;
+
+  // Nothing references the inputs once stopped.
+  this->Pending.Image = NULL;
+  this->Pending.QuantizedImage = NULL;
+  this->Pending.ReadaheadSource = NULL;
+  this->InputCopy = NULL;
+  this->InputCopySource = NULL;
+  this->Modified();
+}
+
+
+
+bool vtkAsyncSliceReslicer
+::IsRunning()
+{
+  return this->Running;
+}
+
+
+
+void vtkAsyncSliceReslicer
+::SetInput( vtkImageData* image, vtkMatrix4x4* rasToIJK )
+{
+  this->Next.Image = image;
+  this->Next.QuantizedImage = NULL;
+  if ( rasToIJK != NULL )
+  {
+    vtkMatrix4x4::DeepCopy( this->Next.RASToIJK, rasToIJK );
+  }
+}
+
+
+
+void vtkAsyncSliceReslicer
+::SetQuantizedInput( vtkQuantizedImage* image, vtkMatrix4x4* rasToIJK )
+{
+  this->Next.QuantizedImage = image;
+  this->Next.Image = NULL;
+  if ( rasToIJK != NULL )
+  {
+    vtkMatrix4x4::DeepCopy( this->Next.RASToIJK, rasToIJK );
+  }
+}
+
+
+
+void vtkAsyncSliceReslicer
+::SetInputKey( const char* volumeID, unsigned long volumeMTime )
+{
+  this->Next.VolumeID = ( volumeID != NULL ) ? volumeID : "";
+  this->Next.VolumeMTime = volumeMTime;
+}
+
+
+
+void vtkAsyncSliceReslicer
+::SetReadaheadSource( vtkMemoryMappedImage* source )
+{
+  this->Next.ReadaheadSource = source;
+}
+
+
+
+void vtkAsyncSliceReslicer
+::Submit( vtkMatrix4x4* xyToRAS, int width, int height )
+{
+  if ( xyToRAS == NULL || ( this->Next.Image == NULL && this->Next.QuantizedImage == NULL ) )
+  {
+    return;
+  }
+  if ( ! this->Running )
+  {
+    this->Start();
+  }
+
+  vtkMatrix4x4::DeepCopy( this->Next.XYToRAS, xyToRAS );
+  this->Next.Size[0] = width;
+  this->Next.Size[1] = height;
+  this->Next.NumberOfThreads = this->NumberOfThreads;
+  this->Next.InterpolationMode = this->InterpolationMode;
+  this->Next.SubmitTime = vtkTimerLog::GetUniversalTime();
+  if ( this->Next.Image != NULL )
+  {
+    this->UpdateInputCopy( this->Next.Image );
+  }
+
+  this->Mutex->Lock();
+  if ( this->PendingValid )
+  {
+    ++ this->NumberOfSupersededRequests;
+  }
+  this->Pending = this->Next;
+  if ( this->Next.Image != NULL )
+  {
+    this->Pending.Image = this->InputCopy;
+  }
+  this->PendingValid = true;
+  ++ this->NumberOfSubmittedRequests;
+  this->RequestPending->Signal();
+  this->Mutex->Unlock();
+}
+
+
+
+bool vtkAsyncSliceReslicer
+::CollectOutput()
+{
+  this->Mutex->Lock();
+  bool collected = ( this->Ready >= 0 );
+  if ( collected )
+  {
+    // The previous front buffer goes back to the worker.
+    this->Front = this->Ready;
+    this->Ready = -1;
+    ++ this->NumberOfCollectedFrames;
+    if ( this->PendingValid )
+    {
+      this->RequestPending->Signal();
+    }
+  }
+  this->Mutex->Unlock();
+  return collected;
+}
+
+
+
+vtkImageData* vtkAsyncSliceReslicer
+::GetOutput()
+{
+  // Front only changes in CollectOutput(), on the calling thread.
+  return ( this->Front >= 0 ) ? this->Buffers[ this->Front ].Reslicer->GetOutput() : NULL;
+}
+
+
+
+vtkMatrix4x4* vtkAsyncSliceReslicer
+::GetOutputXYToRAS()
+{
+  return ( this->Front >= 0 ) ? this->Buffers[ this->Front ].XYToRAS.GetPointer() : NULL;
+}
+
+
+
+double vtkAsyncSliceReslicer
+::GetOutputSubmitTime()
+{
+  return ( this->Front >= 0 ) ? this->Buffers[ this->Front ].SubmitTime : 0.0;
+}
+
+
+
+double vtkAsyncSliceReslicer
+::GetOutputFinishTime()
+{
+  return ( this->Front >= 0 ) ? this->Buffers[ this->Front ].FinishTime : 0.0;
+}
+
+
+
+void vtkAsyncSliceReslicer
+::Wait()
+{
+  this->Mutex->Lock();
+  while ( this->Running && ( this->Busy >= 0 || ( this->PendingValid && this->GetFreeBuffer() >= 0 ) ) )
+  {
+    this->WorkerIdle->Wait( this->Mutex );
+  }
+  this->Mutex->Unlock();
+}
+
+
+
+unsigned long vtkAsyncSliceReslicer
+::GetNumberOfSubmittedRequests()
+{
+  this->Mutex->Lock();
+  unsigned long count = this->NumberOfSubmittedRequests;
+  this->Mutex->Unlock();
+  return count;
+}
+
+
+
+unsigned long vtkAsyncSliceReslicer
+::GetNumberOfSupersededRequests()
+{
+  this->Mutex->Lock();
+  unsigned long count = this->NumberOfSupersededRequests;
+  this->Mutex->Unlock();
+  return count;
+}
+
+
+
+unsigned long vtkAsyncSliceReslicer
+::GetNumberOfFinishedFrames()
+{
+  this->Mutex->Lock();
+  unsigned long count = this->NumberOfFinishedFrames;
+  this->Mutex->Unlock();
+  return count;
+}
+
+
+
+unsigned long vtkAsyncSliceReslicer
+::GetNumberOfCachedFrames()
+{
+  this->Mutex->Lock();
+  unsigned long count = this->NumberOfCachedFrames;
+  this->Mutex->Unlock();
+  return count;
+}
+
+
+
+unsigned long vtkAsyncSliceReslicer
+::GetNumberOfCollectedFrames()
+{
+  this->Mutex->Lock();
+  unsigned long count = this->NumberOfCollectedFrames;
+  this->Mutex->Unlock();
+  return count;
+}
+
+
+
+unsigned long vtkAsyncSliceReslicer
+::GetNumberOfSkippedFrames()
+{
+  this->Mutex->Lock();
+  unsigned long count = this->NumberOfSkippedFrames;
+  this->Mutex->Unlock();
+  return count;
+}
+
+
+
+VTK_THREAD_RETURN_TYPE vtkAsyncSliceReslicer
+::WorkerThread( void* arg )
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast< vtkMultiThreader::ThreadInfo* >( arg );
+  static_cast< vtkAsyncSliceReslicer* >( info->UserData )->WorkerLoop();
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+
+
+void vtkAsyncSliceReslicer
+::WorkerLoop()
+{
+  Request request;
+  this->Mutex->Lock();
+  while ( true )
+  {
+    int index = this->GetFreeBuffer();
+    while ( this->Running && ( ! this->PendingValid || index < 0 ) )
+    {
+      if ( this->PendingValid )
+      {
+        // Both buffers taken: the request waits for the display.
+        this->WorkerIdle->Broadcast();
+      }
+      this->RequestPending->Wait( this->Mutex );
+      index = this->GetFreeBuffer();
+    }
+    if ( ! this->Running )
+    {
+      break;
+    }
+
+    request = this->Pending;
+    this->PendingValid = false;
+    this->Busy = index;
+    this->Mutex->Unlock();
+
+    // The busy buffer is neither shown nor collectable, so it is
+    // resampled without the lock.
+    Buffer& buffer = this->Buffers[ index ];
+    bool cached = this->Resample( buffer, request );
+    buffer.SubmitTime = request.SubmitTime;
+    buffer.FinishTime = vtkTimerLog::GetUniversalTime();
+
+    this->Mutex->Lock();
+    if ( this->Ready >= 0 )
+    {
+      ++ this->NumberOfSkippedFrames;
+    }
+    this->Ready = index;
+    this->Busy = -1;
+    ++ this->NumberOfFinishedFrames;
+    if ( cached )
+    {
+      ++ this->NumberOfCachedFrames;
+    }
+    if ( ! this->PendingValid )
+    {
+      this->WorkerIdle->Broadcast();
+    }
+  }
+  this->Mutex->Unlock();
+}
+
+
+
+void vtkAsyncSliceReslicer
+::UpdateInputCopy( vtkImageData* image )
+{
+  if ( this->InputCopy != NULL && image == this->InputCopySource && image->GetMTime() == this->InputCopyMTime )
+  {
+    return;
+  }
+
+  // A new copy each time: the worker may still be reading the last one.
+  vtkSmartPointer< vtkImageData > copy = vtkSmartPointer< vtkImageData >::New();
+  copy->SetExtent( image->GetExtent() );
+  copy->SetWholeExtent( image->GetExtent() );
+  copy->SetSpacing( image->GetSpacing() );
+  copy->SetOrigin( image->GetOrigin() );
+  copy->SetScalarType( image->GetScalarType() );
+  copy->SetNumberOfScalarComponents( image->GetNumberOfScalarComponents() );
+  copy->AllocateScalars();
+  if ( image->GetScalarPointer() != NULL )
+  {
+    memcpy( copy->GetScalarPointer(), image->GetScalarPointer(),
+            static_cast< size_t >( image->GetNumberOfPoints() ) * image->GetNumberOfScalarComponents()
+            * image->GetScalarSize() );
+  }
+  this->InputCopy = copy;
+  this->InputCopySource = image;
+  this->InputCopyMTime = image->GetMTime();
+  ++ this->NumberOfInputCopies;
+}
+
+
+
+int vtkAsyncSliceReslicer
+::GetFreeBuffer()
+{
+  int numberOfBuffers = static_cast< int >( this->Buffers.size() );
+  for ( int i = 0; i < numberOfBuffers; ++ i )
+  {
+    if ( i != this->Front && i != this->Ready && i != this->Busy )
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+
+
+bool vtkAsyncSliceReslicer
+::Resample( Buffer& buffer, const Request& request )
+{
+  vtkSliceImageReslicer* reslicer = buffer.Reslicer;
+  this->ResampleRASToIJK->DeepCopy( request.RASToIJK );
+  if ( request.QuantizedImage != NULL )
+  {
+    reslicer->SetQuantizedInput( request.QuantizedImage, this->ResampleRASToIJK );
+  }
+  else
+  {
+    reslicer->SetInput( request.Image, this->ResampleRASToIJK );
+  }
+  reslicer->SetInputKey( request.VolumeID.c_str(), request.VolumeMTime );
+  reslicer->SetReadaheadSource( request.ReadaheadSource );
+  reslicer->SetNumberOfThreads( request.NumberOfThreads );
+  reslicer->SetInterpolationMode( request.InterpolationMode );
+  buffer.XYToRAS->DeepCopy( request.XYToRAS );
+  reslicer->SetSliceGeometry( buffer.XYToRAS, request.Size[0], request.Size[1] );
+  unsigned long cachedUpdates = reslicer->GetNumberOfCachedUpdates();
+  reslicer->Update();
+  return reslicer->GetNumberOfCachedUpdates() != cachedUpdates;
+}
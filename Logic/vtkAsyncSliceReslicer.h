@@ -0,0 +1,226 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkAsyncSliceReslicer - resample a driven slice on a worker thread, pipelined with display
+// .SECTION Description
+// Keeps two or three vtkSliceImageReslicer buffers per slice and a worker
+// thread resampling into one of them while the output of another is
+// shown. Submit() hands the worker the plane of the next frame and
+// returns at once; a request the worker has not started yet is replaced,
+// not queued, so the worker always moves on to the newest pose. The GUI
+// thread picks up finished frames with CollectOutput(): the newest one
+// becomes the output and stays untouched by the worker until the next
+// collect. With two buffers a finished frame holds the second one until
+// it is collected, and the next request waits; with three the worker
+// goes on into the third, and a finished frame replaced before it is
+// collected is skipped.
+//
+// Each buffer keeps its own content, so incremental updates compare the
+// new plane with the one that buffer was last resampled at.
+//
+// The worker never reads an image input itself: Submit() hands it a copy,
+// taken again whenever the image was modified since the last one, so that
+// the next frame may be written into the image, as OpenIGTLink does,
+// while the previous one is resampled. A volume that does not change is
+// copied once. Quantized copies are read as they are: call Wait() before
+// rebuilding one in place.
+
+
+#ifndef __vtkAsyncSliceReslicer_h
+#define __vtkAsyncSliceReslicer_h
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <string>
+#include <vector>
+
+#include "vtkSlicerVolumeResliceDriverModuleLogicExport.h"
+
+class vtkConditionVariable;
+class vtkImageData;
+class vtkMatrix4x4;
+class vtkMemoryMappedImage;
+class vtkMutexLock;
+class vtkQuantizedImage;
+class vtkResliceImageCache;
+class vtkSliceImageReslicer;
+
+
+/// \ingroup Slicer_QtModules_VolumeResliceDriver
+class VTK_SLICER_VOLUMERESLICEDRIVER_MODULE_LOGIC_EXPORT vtkAsyncSliceReslicer
+  : public vtkObject
+{
+public:
+
+  static vtkAsyncSliceReslicer *New();
+  vtkTypeMacro(vtkAsyncSliceReslicer,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Output buffers rotated between the worker and the display, applied
+  /// at Start(): with 2 the worker waits for each frame to be collected,
+  /// with 3 it never waits for the display.
+  vtkSetClampMacro( NumberOfBuffers, int, 2, 3 );
+  vtkGetMacro( NumberOfBuffers, int );
+
+  /// Threads of each resample, besides the worker itself.
+  vtkSetClampMacro( NumberOfThreads, int, 1, VTK_MAX_THREADS );
+  vtkGetMacro( NumberOfThreads, int );
+
+  /// vtkSliceImageReslicer::INTERPOLATION_* of the next frames, taken by
+  /// Submit().
+  vtkSetMacro( InterpolationMode, int );
+  vtkGetMacro( InterpolationMode, int );
+
+  /// Optional cache consulted before resampling (shared between slices).
+  void SetCache( vtkResliceImageCache* cache );
+
+  /// Start the worker; Stop() waits for the resample in progress and
+  /// drops a pending request.
+  void Start();
+  void Stop();
+  bool IsRunning();
+
+  /// Source of the next frames, as for vtkSliceImageReslicer: an image or
+  /// a quantized copy, RAS to IJK, the cache key and a readahead source.
+  /// Taken by the next Submit().
+  void SetInput( vtkImageData* image, vtkMatrix4x4* rasToIJK );
+  void SetQuantizedInput( vtkQuantizedImage* image, vtkMatrix4x4* rasToIJK );
+  void SetInputKey( const char* volumeID, unsigned long volumeMTime );
+  void SetReadaheadSource( vtkMemoryMappedImage* source );
+
+  /// Request a frame along the plane; replaces a request not started yet.
+  /// Starts the worker if needed.
+  void Submit( vtkMatrix4x4* xyToRAS, int width, int height );
+
+  /// Make the newest finished frame the output; false if none finished
+  /// since the last collect.
+  bool CollectOutput();
+  /// Frame shown since the last CollectOutput(), NULL before the first;
+  /// the plane it was resampled at, and when it was submitted and finished
+  /// (vtkTimerLog::GetUniversalTime()).
+  vtkImageData* GetOutput();
+  vtkMatrix4x4* GetOutputXYToRAS();
+  double GetOutputSubmitTime();
+  double GetOutputFinishTime();
+
+  /// Block until the worker is idle: nothing is being resampled, and a
+  /// pending request, if any, waits for a frame to be collected.
+  void Wait();
+
+  /// Requests submitted, replaced before the worker started them,
+  /// resampled, of those found in the cache, collected, and finished but
+  /// replaced before collected.
+  unsigned long GetNumberOfSubmittedRequests();
+  unsigned long GetNumberOfSupersededRequests();
+  unsigned long GetNumberOfFinishedFrames();
+  unsigned long GetNumberOfCachedFrames();
+  unsigned long GetNumberOfCollectedFrames();
+  unsigned long GetNumberOfSkippedFrames();
+  /// Copies of image inputs taken by Submit().
+  vtkGetMacro( NumberOfInputCopies, unsigned long );
+
+
+protected:
+
+  vtkAsyncSliceReslicer();
+  virtual ~vtkAsyncSliceReslicer();
+
+  struct Request
+  {
+    vtkSmartPointer< vtkImageData > Image;
+    vtkSmartPointer< vtkQuantizedImage > QuantizedImage;
+    vtkSmartPointer< vtkMemoryMappedImage > ReadaheadSource;
+    std::string VolumeID;
+    unsigned long VolumeMTime;
+    double RASToIJK[16];
+    double XYToRAS[16];
+    int Size[2];
+    int NumberOfThreads;
+    int InterpolationMode;
+    double SubmitTime;
+  };
+
+  struct Buffer
+  {
+    vtkSmartPointer< vtkSliceImageReslicer > Reslicer;
+    vtkSmartPointer< vtkMatrix4x4 > XYToRAS;
+    double SubmitTime;
+    double FinishTime;
+  };
+
+  static VTK_THREAD_RETURN_TYPE WorkerThread( void* arg );
+  void WorkerLoop();
+  /// Copies the image input for the worker unless the last copy is still
+  /// current.
+  void UpdateInputCopy( vtkImageData* image );
+  /// Returns true if the frame was found in the cache.
+  bool Resample( Buffer& buffer, const Request& request );
+  /// A buffer neither shown, finished nor busy, or -1; with the lock held.
+  int GetFreeBuffer();
+
+  int NumberOfBuffers;
+  int NumberOfThreads;
+  int InterpolationMode;
+  bool Running;
+  int ThreadID;
+  vtkSmartPointer< vtkResliceImageCache > Cache;
+  /// RAS to IJK of the request being resampled, worker thread only.
+  vtkSmartPointer< vtkMatrix4x4 > ResampleRASToIJK;
+
+  /// Source set for the next Submit(), GUI thread only.
+  Request Next;
+  /// Copy of the image input handed to the worker, and the image and
+  /// modification time it was taken from; GUI thread only. The source is
+  /// only compared, never dereferenced.
+  vtkSmartPointer< vtkImageData > InputCopy;
+  vtkImageData* InputCopySource;
+  unsigned long InputCopyMTime;
+  unsigned long NumberOfInputCopies;
+
+  // Guarded by Mutex. Buffer indices: Front is shown, Ready finished and
+  // not collected yet, Busy being resampled; -1 if none.
+  Request Pending;
+  bool PendingValid;
+  std::vector< Buffer > Buffers;
+  int Front;
+  int Ready;
+  int Busy;
+  unsigned long NumberOfSubmittedRequests;
+  unsigned long NumberOfSupersededRequests;
+  unsigned long NumberOfFinishedFrames;
+  unsigned long NumberOfCachedFrames;
+  unsigned long NumberOfCollectedFrames;
+  unsigned long NumberOfSkippedFrames;
+
+  vtkMutexLock* Mutex;
+  /// Signaled when a request is pending or a frame collected, and when
+  /// the worker goes idle.
+  vtkConditionVariable* RequestPending;
+  vtkConditionVariable* WorkerIdle;
+  vtkMultiThreader* Threader;
+
+private:
+
+  vtkAsyncSliceReslicer(const vtkAsyncSliceReslicer&); // Not implemented
+  void operator=(const vtkAsyncSliceReslicer&);        // Not implemented
+};
+
+#endif
@@ -0,0 +1,268 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VolumeResliceDriver includes
+#include "vtkDriverEventTracer.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <cstring>
+#include <fstream>
+
+
+
+vtkStandardNewMacro(vtkDriverEventTracer);
+
+
+
+namespace
+{
+
+void CopyID( char* target, const char* id, size_t length )
+{
+  if ( id == NULL )
+  {
+    target[0] = '\0';
+    return;
+  }
+  strncpy( target, id, length - 1 );
+  target[ length - 1 ] = '\0';
+}
+
+
+void WriteJSONString( ostream& os, const char* s )
+{
+  os << '"';
+  for ( ; *s != '\0'; ++ s )
+  {
+    if ( *s == '"' || *s == '\\' )
+    {
+      os << '\\';
+    }
+    if ( static_cast< unsigned char >( *s ) >= 0x20 )
+    {
+      os << *s;
+    }
+  }
+  os << '"';
+}
+
+} // namespace
+
+
+
+vtkDriverEventTracer
+::vtkDriverEventTracer()
+{
+  this->Enabled = false;
+  this->Capacity = 65536;
+  this->NextIndex = 0;
+  this->NumberOfEvents = 0;
+  this->NumberOfLostEvents = 0;
+  this->StartTime = vtkDriverEventTracer::GetTime();
+}
+
+
+
+vtkDriverEventTracer
+::~vtkDriverEventTracer()
+{
+}
+
+
+
+void vtkDriverEventTracer
+::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf( os, indent );
+
+  os << indent << "Enabled: " << ( this->Enabled ? "On" : "Off" ) << std::endl;
+  os << indent << "Capacity: " << this->Capacity << std::endl;
+  os << indent << "NumberOfEvents: " << this->NumberOfEvents << std::endl;
+  os << indent << "NumberOfLostEvents: " << this->NumberOfLostEvents << std::endl;
+}
+
+
+
+void vtkDriverEventTracer
+::SetEnabled( bool enabled )
+{
+  if ( this->Enabled == enabled )
+  {
+    return;
+  }
+
+  // Allocate the ring up front, so recording never allocates.
+  if ( enabled && static_cast< int >( this->Events.size() ) != this->Capacity )
+  {
+    this->Events.resize( this->Capacity );
+    this->Clear();
+  }
+  this->Enabled = enabled;
+  this->Modified();
+}
+
+
+
+double vtkDriverEventTracer
+::GetTime()
+{
+  return vtkTimerLog::GetUniversalTime();
+}
+
+
+
+vtkDriverEventTracer::Event& vtkDriverEventTracer
+::NextEvent()
+{
+  Event& event = this->Events[ this->NextIndex ];
+  this->NextIndex = ( this->NextIndex + 1 ) % static_cast< int >( this->Events.size() );
+  if ( this->NumberOfEvents < static_cast< int >( this->Events.size() ) )
+  {
+    ++ this->NumberOfEvents;
+  }
+  else
+  {
+    ++ this->NumberOfLostEvents;
+  }
+  return event;
+}
+
+
+
+void vtkDriverEventTracer
+::AddSpan( const char* name, double startTime, const char* driverID, const char* sliceID )
+{
+  if ( ! this->Enabled )
+  {
+    return;
+  }
+
+  double now = vtkDriverEventTracer::GetTime();
+  Event& event = this->NextEvent();
+  event.Name = name;
+  event.Phase = 'X';
+  event.Time = startTime;
+  event.Duration = now - startTime;
+  event.Value = 0.0;
+  CopyID( event.DriverID, driverID, ID_LENGTH );
+  CopyID( event.SliceID, sliceID, ID_LENGTH );
+}
+
+
+
+void vtkDriverEventTracer
+::AddCounter( const char* name, double value )
+{
+  if ( ! this->Enabled )
+  {
+    return;
+  }
+
+  Event& event = this->NextEvent();
+  event.Name = name;
+  event.Phase = 'C';
+  event.Time = vtkDriverEventTracer::GetTime();
+  event.Duration = 0.0;
+  event.Value = value;
+  event.DriverID[0] = '\0';
+  event.SliceID[0] = '\0';
+}
+
+
+
+void vtkDriverEventTracer
+::Clear()
+{
+  this->NextIndex = 0;
+  this->NumberOfEvents = 0;
+  this->NumberOfLostEvents = 0;
+}
+
+
+
+int vtkDriverEventTracer
+::GetNumberOfEvents()
+{
+  return this->NumberOfEvents;
+}
+
+
+
+bool vtkDriverEventTracer
+::WriteChromeTrace( const char* fileName )
+{
+  if ( fileName == NULL )
+  {
+    return false;
+  }
+
+  std::ofstream file( fileName );
+  if ( ! file )
+  {
+    vtkErrorMacro( "Cannot write trace to " << fileName );
+    return false;
+  }
+  this->WriteChromeTrace( file );
+  return file.good();
+}
+
+
+
+void vtkDriverEventTracer
+::WriteChromeTrace( ostream& os )
+{
+  // Timestamps in microseconds; fixed notation keeps their precision.
+  std::ios::fmtflags flags = os.flags();
+  std::streamsize precision = os.precision();
+  os.setf( std::ios::fixed, std::ios::floatfield );
+  os.precision( 3 );
+
+  os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+  os << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+     << "\"args\":{\"name\":\"MRML events\"}}";
+
+  int size = static_cast< int >( this->Events.size() );
+  int first = ( this->NextIndex - this->NumberOfEvents + size ) % ( size > 0 ? size : 1 );
+  for ( int n = 0; n < this->NumberOfEvents; ++ n )
+  {
+    const Event& event = this->Events[ ( first + n ) % size ];
+    os << "," << std::endl << "{\"name\":";
+    WriteJSONString( os, event.Name );
+    os << ",\"cat\":\"VolumeResliceDriver\",\"ph\":\"" << event.Phase << "\",\"pid\":1,\"tid\":1"
+       << ",\"ts\":" << ( event.Time - this->StartTime ) * 1.0e6;
+    if ( event.Phase == 'X' )
+    {
+      os << ",\"dur\":" << event.Duration * 1.0e6 << ",\"args\":{\"driver\":";
+      WriteJSONString( os, event.DriverID );
+      os << ",\"slice\":";
+      WriteJSONString( os, event.SliceID );
+      os << "}}";
+    }
+    else
+    {
+      os << ",\"args\":{\"value\":" << event.Value << "}}";
+    }
+  }
+  os << std::endl << "]}" << std::endl;
+
+  os.flags( flags );
+  os.precision( precision );
+}
@@ -0,0 +1,143 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkDriverEventTracer - ring buffer of timed spans in the driver pipeline
+// .SECTION Description
+// Records spans (a named stage with start and duration) and counter
+// samples, tagged with the driver and slice node IDs, into a fixed ring
+// allocated when tracing is enabled. Recording copies into the ring and
+// never allocates; once full, the oldest events are overwritten.
+// WriteChromeTrace() dumps the ring in the Chrome trace event format,
+// which chrome://tracing and Perfetto open directly.
+//
+// Events must be recorded from a single thread (the MRML event thread).
+
+
+#ifndef __vtkDriverEventTracer_h
+#define __vtkDriverEventTracer_h
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerVolumeResliceDriverModuleLogicExport.h"
+
+
+/// \ingroup Slicer_QtModules_VolumeResliceDriver
+class VTK_SLICER_VOLUMERESLICEDRIVER_MODULE_LOGIC_EXPORT vtkDriverEventTracer
+  : public vtkObject
+{
+public:
+
+  static vtkDriverEventTracer *New();
+  vtkTypeMacro(vtkDriverEventTracer,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Number of events kept, applied when tracing is enabled.
+  vtkSetClampMacro( Capacity, int, 16, 16777216 );
+  vtkGetMacro( Capacity, int );
+
+  void SetEnabled( bool enabled );
+  bool GetEnabled() { return this->Enabled; }
+
+  /// Seconds, from the same clock as the recorded events.
+  static double GetTime();
+
+  /// Record a span that started at startTime (from GetTime()) and ends now.
+  /// The name must be a string literal; the IDs are copied and may be NULL.
+  void AddSpan( const char* name, double startTime, const char* driverID, const char* sliceID );
+  /// Record a counter sample at the current time.
+  void AddCounter( const char* name, double value );
+
+  void Clear();
+  int GetNumberOfEvents();
+  /// Events overwritten since the ring was last cleared.
+  vtkGetMacro( NumberOfLostEvents, unsigned long );
+
+  /// Write the events, oldest first, as Chrome trace JSON.
+  bool WriteChromeTrace( const char* fileName );
+  void WriteChromeTrace( ostream& os );
+
+
+protected:
+
+  vtkDriverEventTracer();
+  virtual ~vtkDriverEventTracer();
+
+  enum { ID_LENGTH = 48 };
+
+  struct Event
+  {
+    const char* Name;
+    char Phase;  // 'X' span, 'C' counter
+    double Time;
+    double Duration;
+    double Value;
+    char DriverID[ ID_LENGTH ];
+    char SliceID[ ID_LENGTH ];
+  };
+
+  Event& NextEvent();
+
+  bool Enabled;
+  int Capacity;
+  std::vector< Event > Events;
+  int NextIndex;
+  int NumberOfEvents;
+  unsigned long NumberOfLostEvents;
+  double StartTime;
+
+private:
+
+  vtkDriverEventTracer(const vtkDriverEventTracer&); // Not implemented
+  void operator=(const vtkDriverEventTracer&);       // Not implemented
+};
+
+
+
+/// Records a span from construction to destruction, if tracing is enabled.
+class vtkDriverEventTracerSpan
+{
+public:
+  vtkDriverEventTracerSpan( vtkDriverEventTracer* tracer, const char* name,
+                            const char* driverID = NULL, const char* sliceID = NULL )
+    : Tracer( ( tracer != NULL && tracer->GetEnabled() ) ? tracer : NULL ),
+      Name( name ), DriverID( driverID ), SliceID( sliceID ), StartTime( 0.0 )
+  {
+    if ( this->Tracer != NULL )
+    {
+      this->StartTime = vtkDriverEventTracer::GetTime();
+    }
+  }
+  ~vtkDriverEventTracerSpan()
+  {
+    if ( this->Tracer != NULL )
+    {
+      this->Tracer->AddSpan( this->Name, this->StartTime, this->DriverID, this->SliceID );
+    }
+  }
+private:
+  vtkDriverEventTracer* Tracer;
+  const char* Name;
+  const char* DriverID;
+  const char* SliceID;
+  double StartTime;
+};
+
+#endif
@@ -0,0 +1,380 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VolumeResliceDriver includes
+#include "vtkDriverPoseHistory.h"
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cmath>
+
+
+
+vtkStandardNewMacro(vtkDriverPoseHistory);
+
+
+
+namespace
+{
+
+/// Spherical interpolation from q0 (t = 0) to q1 (t = 1), along the
+/// shorter arc; t outside [0, 1] extrapolates the rotation.
+void SlerpQuaternion( const double q0[4], const double q1[4], double t, double q[4] )
+{
+  double cosAngle = q0[0] * q1[0] + q0[1] * q1[1] + q0[2] * q1[2] + q0[3] * q1[3];
+  double sign = 1.0;
+  if ( cosAngle < 0.0 )
+  {
+    cosAngle = -cosAngle;
+    sign = -1.0;
+  }
+
+  double w0 = 1.0 - t;
+  double w1 = t;
+  if ( cosAngle < 0.9999 )
+  {
+    double angle = acos( cosAngle );
+    double sinAngle = sin( angle );
+    w0 = sin( ( 1.0 - t ) * angle ) / sinAngle;
+    w1 = sin( t * angle ) / sinAngle;
+  }
+
+  double norm = 0.0;
+  for ( int k = 0; k < 4; ++ k )
+  {
+    q[ k ] = w0 * q0[ k ] + w1 * sign * q1[ k ];
+    norm += q[ k ] * q[ k ];
+  }
+  norm = sqrt( norm );
+  for ( int k = 0; k < 4; ++ k )
+  {
+    q[ k ] /= norm;
+  }
+}
+
+
+/// Pose of rotation times stretch, then translation.
+void ComposePose( const double quaternion[4], const double stretch[3][3], const double translation[3], vtkMatrix4x4* pose )
+{
+  double rotation[3][3];
+  vtkMath::QuaternionToMatrix3x3( quaternion, rotation );
+  double linear[3][3];
+  vtkMath::Multiply3x3( rotation, stretch, linear );
+  pose->Identity();
+  for ( int row = 0; row < 3; ++ row )
+  {
+    for ( int column = 0; column < 3; ++ column )
+    {
+      pose->Element[ row ][ column ] = linear[ row ][ column ];
+    }
+    pose->Element[ row ][3] = translation[ row ];
+  }
+}
+
+} // namespace
+
+
+
+vtkDriverPoseHistory
+::vtkDriverPoseHistory()
+{
+  this->Capacity = 0;
+  this->MaximumExtrapolation = 0.1;
+  this->NumberOfSamples = 0;
+  this->NextSample = 0;
+  this->SetCapacity( 64 );
+}
+
+
+
+vtkDriverPoseHistory
+::~vtkDriverPoseHistory()
+{
+}
+
+
+
+void vtkDriverPoseHistory
+::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf( os, indent );
+
+  os << indent << "Capacity: " << this->Capacity << std::endl;
+  os << indent << "MaximumExtrapolation: " << this->MaximumExtrapolation << std::endl;
+  os << indent << "NumberOfSamples: " << this->NumberOfSamples << std::endl;
+}
+
+
+
+void vtkDriverPoseHistory
+::SetCapacity( int capacity )
+{
+  capacity = capacity < 2 ? 2 : capacity;
+  if ( this->Capacity == capacity )
+  {
+    return;
+  }
+
+  this->Capacity = capacity;
+  this->Samples.resize( capacity );
+  this->Clear();
+}
+
+
+
+void vtkDriverPoseHistory
+::Clear()
+{
+  this->NumberOfSamples = 0;
+  this->NextSample = 0;
+  this->Modified();
+}
+
+
+
+int vtkDriverPoseHistory
+::GetNumberOfSamples()
+{
+  return this->NumberOfSamples;
+}
+
+
+
+double vtkDriverPoseHistory
+::GetOldestTime()
+{
+  return ( this->NumberOfSamples > 0 ) ? this->GetSample( 0 ).Time : 0.0;
+}
+
+
+
+double vtkDriverPoseHistory
+::GetNewestTime()
+{
+  return ( this->NumberOfSamples > 0 ) ? this->GetSample( this->NumberOfSamples - 1 ).Time : 0.0;
+}
+
+
+
+int vtkDriverPoseHistory
+::FindSample( double time )
+{
+  int low = 0;
+  int high = this->NumberOfSamples;
+  while ( low < high )
+  {
+    int middle = ( low + high ) / 2;
+    if ( this->GetSample( middle ).Time < time )
+    {
+      low = middle + 1;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+
+
+void vtkDriverPoseHistory
+::GetSamplePose( const Sample& sample, vtkMatrix4x4* pose )
+{
+  ComposePose( sample.Quaternion, sample.Stretch, sample.Translation, pose );
+}
+
+
+
+int vtkDriverPoseHistory
+::ExportWindow( double start, double end, vtkDoubleArray* times, vtkDoubleArray* poses )
+{
+  times->Initialize();
+  times->SetNumberOfComponents( 1 );
+  poses->Initialize();
+  poses->SetNumberOfComponents( 16 );
+  
+  int first = this->FindSample( start );
+  int last = this->FindSample( end );
+  while ( last < this->NumberOfSamples && this->GetSample( last ).Time <= end )
+  {
+    ++ last;
+  }
+  if ( last <= first )
+  {
+    return 0;
+  }
+  
+  times->SetNumberOfTuples( last - first );
+  poses->SetNumberOfTuples( last - first );
+  vtkSmartPointer< vtkMatrix4x4 > pose = vtkSmartPointer< vtkMatrix4x4 >::New();
+  for ( int i = first; i < last; ++ i )
+  {
+    const Sample& sample = this->GetSample( i );
+    this->GetSamplePose( sample, pose );
+    times->SetValue( i - first, sample.Time );
+    poses->SetTupleValue( i - first, &pose->Element[0][0] );
+  }
+  return last - first;
+}
+
+
+
+const vtkDriverPoseHistory::Sample& vtkDriverPoseHistory
+::GetSample( int i )
+{
+  int index = this->NextSample - this->NumberOfSamples + i;
+  return this->Samples[ index < 0 ? index + this->Capacity : index ];
+}
+
+
+
+void vtkDriverPoseHistory
+::AddPose( double time, vtkMatrix4x4* pose )
+{
+  // A pose at the time of the newest sample replaces it: the later one
+  // is the pose in effect at that time.
+  int index = this->NextSample;
+  if ( this->NumberOfSamples > 0 )
+  {
+    double newestTime = this->GetSample( this->NumberOfSamples - 1 ).Time;
+    if ( time < newestTime )
+    {
+      return;
+    }
+    if ( time == newestTime )
+    {
+      index = ( this->NextSample + this->Capacity - 1 ) % this->Capacity;
+    }
+  }
+
+  Sample& sample = this->Samples[ index ];
+  sample.Time = time;
+
+  // Polar decomposition of the linear part into a rotation and a stretch,
+  // which keeps the scale (such as pixel spacing in an image to reference
+  // transform) and a reflection, if any, so the rotation is proper.
+  double linear[3][3];
+  for ( int row = 0; row < 3; ++ row )
+  {
+    for ( int column = 0; column < 3; ++ column )
+    {
+      linear[ row ][ column ] = pose->Element[ row ][ column ];
+    }
+    sample.Translation[ row ] = pose->Element[ row ][3];
+  }
+  double rotation[3][3];
+  vtkMath::Orthogonalize3x3( linear, rotation );
+  if ( vtkMath::Determinant3x3( rotation ) < 0.0 )
+  {
+    for ( int row = 0; row < 3; ++ row )
+    {
+      for ( int column = 0; column < 3; ++ column )
+      {
+        rotation[ row ][ column ] = - rotation[ row ][ column ];
+      }
+    }
+  }
+  vtkMath::Matrix3x3ToQuaternion( rotation, sample.Quaternion );
+  double inverseRotation[3][3];
+  vtkMath::Transpose3x3( rotation, inverseRotation );
+  vtkMath::Multiply3x3( inverseRotation, linear, sample.Stretch );
+
+  if ( index != this->NextSample )
+  {
+    return;
+  }
+  this->NextSample = ( this->NextSample + 1 ) % this->Capacity;
+  if ( this->NumberOfSamples < this->Capacity )
+  {
+    ++ this->NumberOfSamples;
+  }
+}
+
+
+
+int vtkDriverPoseHistory
+::GetPose( double time, vtkMatrix4x4* pose )
+{
+  if ( this->NumberOfSamples < 2 )
+  {
+    return POSE_NONE;
+  }
+
+  // Bracketing pair: the last sample not newer than time, and the next
+  // one; clamped to the first or last pair outside the sampled interval.
+  int low = 0;
+  int high = this->NumberOfSamples - 1;
+  if ( time >= this->GetSample( high ).Time )
+  {
+    low = high - 1;
+  }
+  else if ( time <= this->GetSample( 0 ).Time )
+  {
+    high = 1;
+  }
+  else
+  {
+    while ( high - low > 1 )
+    {
+      int middle = ( low + high ) / 2;
+      if ( this->GetSample( middle ).Time <= time )
+      {
+        low = middle;
+      }
+      else
+      {
+        high = middle;
+      }
+    }
+  }
+
+  const Sample& s0 = this->GetSample( low );
+  const Sample& s1 = this->GetSample( high );
+  int result = POSE_INTERPOLATED;
+  if ( time < s0.Time || time > s1.Time )
+  {
+    result = POSE_EXTRAPOLATED;
+    double limit = this->MaximumExtrapolation;
+    time = ( time < s0.Time - limit ) ? s0.Time - limit : time;
+    time = ( time > s1.Time + limit ) ? s1.Time + limit : time;
+  }
+  double t = ( time - s0.Time ) / ( s1.Time - s0.Time );
+
+  // Only the rotation is interpolated on the sphere; the stretch and the
+  // translation are interpolated linearly.
+  double q[4];
+  SlerpQuaternion( s0.Quaternion, s1.Quaternion, t, q );
+  double stretch[3][3];
+  double translation[3];
+  for ( int row = 0; row < 3; ++ row )
+  {
+    for ( int column = 0; column < 3; ++ column )
+    {
+      stretch[ row ][ column ] = s0.Stretch[ row ][ column ] + t * ( s1.Stretch[ row ][ column ] - s0.Stretch[ row ][ column ] );
+    }
+    translation[ row ] = s0.Translation[ row ] + t * ( s1.Translation[ row ] - s0.Translation[ row ] );
+  }
+  ComposePose( q, stretch, translation, pose );
+  return result;
+}
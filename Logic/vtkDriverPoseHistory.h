@@ -0,0 +1,122 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkDriverPoseHistory - recent timestamped affine poses of a tracker
+// .SECTION Description
+// Keeps the latest poses of one tracker in a fixed ring, each split into a
+// rotation quaternion, a stretch matrix holding scale and reflection, and
+// a translation. GetPose() returns the pose at an arbitrary time:
+// interpolated between the two samples around it (slerp for the rotation,
+// linear for the rest), or extrapolated from the two newest or oldest
+// samples, up to MaximumExtrapolation seconds beyond them. At the time of
+// a sample it returns the pose added. Samples must be added in time order;
+// adding and looking up never allocate. A sample takes 136 bytes, so the
+// memory held is bounded by Capacity.
+
+
+#ifndef __vtkDriverPoseHistory_h
+#define __vtkDriverPoseHistory_h
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerVolumeResliceDriverModuleLogicExport.h"
+
+class vtkDoubleArray;
+class vtkMatrix4x4;
+
+
+/// \ingroup Slicer_QtModules_VolumeResliceDriver
+class VTK_SLICER_VOLUMERESLICEDRIVER_MODULE_LOGIC_EXPORT vtkDriverPoseHistory
+  : public vtkObject
+{
+public:
+
+  static vtkDriverPoseHistory *New();
+  vtkTypeMacro(vtkDriverPoseHistory,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  enum {
+    POSE_NONE,
+    POSE_INTERPOLATED,
+    POSE_EXTRAPOLATED,
+  };
+
+  /// Number of samples kept. Changing it clears the history.
+  void SetCapacity( int capacity );
+  vtkGetMacro( Capacity, int );
+
+  /// Seconds a pose may be extrapolated beyond the sampled interval.
+  vtkSetMacro( MaximumExtrapolation, double );
+  vtkGetMacro( MaximumExtrapolation, double );
+
+  /// Add pose, sampled at time (seconds). A pose at the time of the
+  /// newest sample replaces it; older ones are ignored.
+  void AddPose( double time, vtkMatrix4x4* pose );
+
+  /// Pose at time, into pose. Returns POSE_NONE, leaving pose untouched,
+  /// if fewer than two samples were added.
+  int GetPose( double time, vtkMatrix4x4* pose );
+
+  /// Samples with start <= time <= end, oldest first: their times into
+  /// times, and their poses into poses as 16 components per tuple, row by
+  /// row. Both arrays are reset. Returns the number of samples.
+  int ExportWindow( double start, double end, vtkDoubleArray* times, vtkDoubleArray* poses );
+  
+  int GetNumberOfSamples();
+  /// Time of the oldest and newest sample; 0 if there are none.
+  double GetOldestTime();
+  double GetNewestTime();
+  void Clear();
+
+
+protected:
+
+  vtkDriverPoseHistory();
+  virtual ~vtkDriverPoseHistory();
+
+  struct Sample
+  {
+    double Time;
+    double Quaternion[4];
+    /// Rotation^-1 * linear part of the pose.
+    double Stretch[3][3];
+    double Translation[3];
+  };
+
+  /// i-th sample, 0 being the oldest.
+  const Sample& GetSample( int i );
+  /// Index of the first sample not older than time; NumberOfSamples if none.
+  int FindSample( double time );
+  void GetSamplePose( const Sample& sample, vtkMatrix4x4* pose );
+
+  int Capacity;
+  double MaximumExtrapolation;
+  std::vector< Sample > Samples;
+  int NumberOfSamples;
+  int NextSample;
+
+private:
+
+  vtkDriverPoseHistory(const vtkDriverPoseHistory&); // Not implemented
+  void operator=(const vtkDriverPoseHistory&);       // Not implemented
+};
+
+#endif
@@ -0,0 +1,343 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VolumeResliceDriver includes
+#include "vtkDriverPoseLogReslicer.h"
+#include "vtkQuantizedImage.h"
+#include "vtkSliceImageReslicer.h"
+#include "vtkSlicerVolumeResliceDriverLogic.h"
+
+// MRML includes
+#include "vtkMRMLSliceNode.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkMetaImageWriter.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+
+
+vtkStandardNewMacro(vtkDriverPoseLogReslicer);
+
+
+
+namespace
+{
+
+/// True if pattern has exactly one conversion, and it is an integer one.
+bool IsIndexPattern( const char* pattern )
+{
+  int conversions = 0;
+  for ( const char* p = pattern; *p != '\0'; ++ p )
+  {
+    if ( *p != '%' )
+    {
+      continue;
+    }
+    ++ p;
+    if ( *p == '%' )
+    {
+      continue;
+    }
+    while ( *p != '\0' && strchr( "-+ #0123456789", *p ) != NULL )
+    {
+      ++ p;
+    }
+    if ( *p != 'd' && *p != 'i' )
+    {
+      return false;
+    }
+    ++ conversions;
+  }
+  return conversions == 1;
+}
+
+} // namespace
+
+
+
+vtkDriverPoseLogReslicer
+::vtkDriverPoseLogReslicer()
+{
+  this->Method = vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION;
+  this->Orientation = vtkSlicerVolumeResliceDriverLogic::ORIENTATION_INPLANE;
+  this->InterpolationMode = vtkSliceImageReslicer::INTERPOLATION_LINEAR;
+  this->SliceDimensions[0] = 256;
+  this->SliceDimensions[1] = 256;
+  this->FieldOfView[0] = 250.0;
+  this->FieldOfView[1] = 250.0;
+  this->ImageDimensions[0] = 0;
+  this->ImageDimensions[1] = 0;
+  this->NumberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  this->BlockSize = 16;
+  this->OutputFilePattern = NULL;
+  this->NumberOfSkippedLines = 0;
+  this->Threader = vtkMultiThreader::New();
+  this->NumberOfBlockPoses = 0;
+  this->FirstBlockIndex = 0;
+}
+
+
+
+vtkDriverPoseLogReslicer
+::~vtkDriverPoseLogReslicer()
+{
+  this->SetOutputFilePattern( NULL );
+  this->Threader->Delete();
+}
+
+
+
+void vtkDriverPoseLogReslicer
+::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf( os, indent );
+
+  os << indent << "Method: " << this->Method << std::endl;
+  os << indent << "Orientation: " << this->Orientation << std::endl;
+  os << indent << "InterpolationMode: " << this->InterpolationMode << std::endl;
+  os << indent << "SliceDimensions: " << this->SliceDimensions[0] << " " << this->SliceDimensions[1] << std::endl;
+  os << indent << "FieldOfView: " << this->FieldOfView[0] << " " << this->FieldOfView[1] << std::endl;
+  os << indent << "ImageDimensions: " << this->ImageDimensions[0] << " " << this->ImageDimensions[1] << std::endl;
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << std::endl;
+  os << indent << "BlockSize: " << this->BlockSize << std::endl;
+  os << indent << "OutputFilePattern: " << ( this->OutputFilePattern ? this->OutputFilePattern : "(none)" ) << std::endl;
+  os << indent << "NumberOfSkippedLines: " << this->NumberOfSkippedLines << std::endl;
+}
+
+
+
+void vtkDriverPoseLogReslicer
+::SetInput( vtkImageData* image, vtkMatrix4x4* rasToIJK )
+{
+  this->Input = image;
+  this->QuantizedInput = NULL;
+  this->SetRASToIJK( rasToIJK );
+}
+
+
+
+void vtkDriverPoseLogReslicer
+::SetQuantizedInput( vtkQuantizedImage* image, vtkMatrix4x4* rasToIJK )
+{
+  this->QuantizedInput = image;
+  this->Input = NULL;
+  this->SetRASToIJK( rasToIJK );
+}
+
+
+
+void vtkDriverPoseLogReslicer
+::SetRASToIJK( vtkMatrix4x4* rasToIJK )
+{
+  if ( this->RASToIJK == NULL )
+  {
+    this->RASToIJK = vtkSmartPointer< vtkMatrix4x4 >::New();
+  }
+  if ( rasToIJK != NULL )
+  {
+    this->RASToIJK->DeepCopy( rasToIJK );
+  }
+  else
+  {
+    this->RASToIJK->Identity();
+  }
+  this->Modified();
+}
+
+
+
+int vtkDriverPoseLogReslicer
+::Reslice( std::istream& log )
+{
+  if ( ( this->Input == NULL && this->QuantizedInput == NULL ) || this->OutputFilePattern == NULL )
+  {
+    vtkErrorMacro( "No input volume or output file pattern set." );
+    return -1;
+  }
+  if ( ! IsIndexPattern( this->OutputFilePattern ) )
+  {
+    vtkErrorMacro( "Output file pattern " << this->OutputFilePattern << " needs exactly one %d." );
+    return -1;
+  }
+
+  // One slice node, reslicer and writer per thread, so the threads share
+  // nothing but the input volume.
+  this->Workers.resize( this->NumberOfThreads );
+  for ( unsigned int t = 0; t < this->Workers.size(); ++ t )
+  {
+    Worker& worker = this->Workers[ t ];
+    worker.SliceNode = vtkSmartPointer< vtkMRMLSliceNode >::New();
+    worker.SliceNode->SetDimensions( this->SliceDimensions[0], this->SliceDimensions[1], 1 );
+    worker.SliceNode->SetFieldOfView( this->FieldOfView[0], this->FieldOfView[1], 1.0 );
+    worker.Reslicer = vtkSmartPointer< vtkSliceImageReslicer >::New();
+    if ( this->QuantizedInput != NULL )
+    {
+      worker.Reslicer->SetQuantizedInput( this->QuantizedInput, this->RASToIJK );
+    }
+    else
+    {
+      worker.Reslicer->SetInput( this->Input, this->RASToIJK );
+    }
+    worker.Reslicer->SetInterpolationMode( this->InterpolationMode );
+    worker.Reslicer->SetNumberOfThreads( 1 );
+    // Each image resampled in full: it must not depend on which poses its
+    // thread happened to reslice before.
+    worker.Reslicer->IncrementalUpdateOff();
+    worker.Writer = vtkSmartPointer< vtkMetaImageWriter >::New();
+    worker.Pose = vtkSmartPointer< vtkMatrix4x4 >::New();
+    worker.FileName.resize( strlen( this->OutputFilePattern ) + 64 );
+    worker.NumberOfFailures = 0;
+  }
+
+  int blockCapacity = this->BlockSize * this->NumberOfThreads;
+  this->Block.resize( 16 * blockCapacity );
+  this->NumberOfSkippedLines = 0;
+  this->FirstBlockIndex = 0;
+  this->Threader->SetNumberOfThreads( this->NumberOfThreads );
+  this->Threader->SetSingleMethod( vtkDriverPoseLogReslicer::ResliceThread, this );
+
+  int written = 0;
+  for ( ;; )
+  {
+    this->NumberOfBlockPoses = this->ReadBlock( log, blockCapacity );
+    if ( this->NumberOfBlockPoses == 0 )
+    {
+      break;
+    }
+    this->Threader->SingleMethodExecute();
+
+    for ( unsigned int t = 0; t < this->Workers.size(); ++ t )
+    {
+      if ( this->Workers[ t ].NumberOfFailures > 0 )
+      {
+        vtkErrorMacro( "Cannot write the images of poses " << this->FirstBlockIndex << " to "
+                       << this->FirstBlockIndex + this->NumberOfBlockPoses - 1 );
+        return -1;
+      }
+    }
+    written += this->NumberOfBlockPoses;
+    this->FirstBlockIndex += this->NumberOfBlockPoses;
+  }
+
+  // The per-thread images are only needed while reslicing.
+  this->Workers.clear();
+  return written;
+}
+
+
+
+int vtkDriverPoseLogReslicer
+::ReadBlock( std::istream& log, int count )
+{
+  std::string line;
+  int read = 0;
+  while ( read < count && std::getline( log, line ) )
+  {
+    const char* p = line.c_str();
+    while ( isspace( static_cast< unsigned char >( *p ) ) )
+    {
+      ++ p;
+    }
+    if ( *p == '\0' || *p == '#' )
+    {
+      continue;
+    }
+
+    // Timestamp, then the matrix.
+    double values[17];
+    int k = 0;
+    for ( ; k < 17; ++ k )
+    {
+      char* end = NULL;
+      values[ k ] = strtod( p, &end );
+      if ( end == p )
+      {
+        break;
+      }
+      p = end;
+    }
+    if ( k < 17 )
+    {
+      ++ this->NumberOfSkippedLines;
+      continue;
+    }
+    memcpy( &this->Block[ 16 * read ], values + 1, 16 * sizeof( double ) );
+    ++ read;
+  }
+  return read;
+}
+
+
+
+VTK_THREAD_RETURN_TYPE vtkDriverPoseLogReslicer
+::ResliceThread( void* arg )
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast< vtkMultiThreader::ThreadInfo* >( arg );
+  vtkDriverPoseLogReslicer* self = static_cast< vtkDriverPoseLogReslicer* >( info->UserData );
+
+  // Contiguous runs, so that each reslicer sees consecutive poses.
+  int count = self->NumberOfBlockPoses;
+  int first = count * info->ThreadID / info->NumberOfThreads;
+  int last = count * ( info->ThreadID + 1 ) / info->NumberOfThreads;
+  Worker& worker = self->Workers[ info->ThreadID ];
+  for ( int i = first; i < last && worker.NumberOfFailures == 0; ++ i )
+  {
+    self->ReslicePose( worker, i );
+  }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+
+
+void vtkDriverPoseLogReslicer
+::ReslicePose( Worker& worker, int index )
+{
+  vtkMatrix4x4* pose = worker.Pose;
+  pose->DeepCopy( &this->Block[ 16 * index ] );
+  if ( this->ImageDimensions[0] > 0 && this->ImageDimensions[1] > 0 )
+  {
+    int dimensions[3] = { this->ImageDimensions[0], this->ImageDimensions[1], 1 };
+    vtkSlicerVolumeResliceDriverLogic::GetImageFramePose( pose, dimensions, pose );
+  }
+
+  vtkSlicerVolumeResliceDriverLogic::SlicePlane plane;
+  vtkSlicerVolumeResliceDriverLogic::ComputeSlicePlane( pose, this->Method, this->Orientation, plane );
+  vtkSlicerVolumeResliceDriverLogic::ApplySlicePlane( worker.SliceNode, plane );
+  worker.SliceNode->UpdateMatrices();
+
+  vtkSliceImageReslicer* reslicer = worker.Reslicer;
+  reslicer->SetSliceGeometry( worker.SliceNode->GetXYToRAS(), this->SliceDimensions[0], this->SliceDimensions[1] );
+  reslicer->Update();
+
+  sprintf( &worker.FileName[0], this->OutputFilePattern, this->FirstBlockIndex + index );
+  worker.Writer->SetFileName( &worker.FileName[0] );
+  worker.Writer->SetInput( reslicer->GetOutput() );
+  worker.Writer->Write();
+  if ( worker.Writer->GetErrorCode() != 0 )
+  {
+    ++ worker.NumberOfFailures;
+  }
+}
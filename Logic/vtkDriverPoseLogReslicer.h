@@ -0,0 +1,163 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkDriverPoseLogReslicer - reslices a volume along a logged pose sequence
+// .SECTION Description
+// Offline counterpart of the driven slices. For every pose of a log, puts
+// a slice node at the pose with the method and orientation semantics of
+// vtkSlicerVolumeResliceDriverLogic, resamples the input volume along it
+// and writes the image to a file. Poses are read in blocks, each block
+// split into contiguous runs over NumberOfThreads threads, and every image
+// is written as soon as it is resampled: memory does not grow with the
+// length of the log.
+//
+// Log format: one pose per line, a timestamp followed by the 16 matrix
+// elements row by row (as exported by vtkDriverPoseHistory); blank lines
+// and lines starting with '#' are skipped. With ImageDimensions set, the
+// poses are the IJKToRAS matrices of image driver frames of that size, and
+// the OpenIGTLink center shift is applied as for image driver nodes.
+
+
+#ifndef __vtkDriverPoseLogReslicer_h
+#define __vtkDriverPoseLogReslicer_h
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <istream>
+#include <vector>
+
+#include "vtkSlicerVolumeResliceDriverModuleLogicExport.h"
+
+class vtkImageData;
+class vtkMatrix4x4;
+class vtkMetaImageWriter;
+class vtkMRMLSliceNode;
+class vtkQuantizedImage;
+class vtkSliceImageReslicer;
+
+
+/// \ingroup Slicer_QtModules_VolumeResliceDriver
+class VTK_SLICER_VOLUMERESLICEDRIVER_MODULE_LOGIC_EXPORT vtkDriverPoseLogReslicer
+  : public vtkObject
+{
+public:
+
+  static vtkDriverPoseLogReslicer *New();
+  vtkTypeMacro(vtkDriverPoseLogReslicer,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Volume to reslice and the matrix mapping RAS to its voxel indices.
+  void SetInput( vtkImageData* image, vtkMatrix4x4* rasToIJK );
+  /// Reduced-precision volume to reslice instead; setting either input
+  /// clears the other.
+  void SetQuantizedInput( vtkQuantizedImage* image, vtkMatrix4x4* rasToIJK );
+
+  /// vtkSlicerVolumeResliceDriverLogic::METHOD_* and ORIENTATION_*.
+  vtkSetMacro( Method, int );
+  vtkGetMacro( Method, int );
+  vtkSetMacro( Orientation, int );
+  vtkGetMacro( Orientation, int );
+
+  /// vtkSliceImageReslicer::INTERPOLATION_*.
+  vtkSetMacro( InterpolationMode, int );
+  vtkGetMacro( InterpolationMode, int );
+
+  /// Output images in pixels, and the slice field of view in mm.
+  vtkSetVector2Macro( SliceDimensions, int );
+  vtkGetVector2Macro( SliceDimensions, int );
+  vtkSetVector2Macro( FieldOfView, double );
+  vtkGetVector2Macro( FieldOfView, double );
+
+  /// Frame size of an image driver whose IJKToRAS matrices were logged;
+  /// 0 for poses of transform drivers (the default).
+  vtkSetVector2Macro( ImageDimensions, int );
+  vtkGetVector2Macro( ImageDimensions, int );
+
+  vtkSetClampMacro( NumberOfThreads, int, 1, VTK_MAX_THREADS );
+  vtkGetMacro( NumberOfThreads, int );
+
+  /// Poses per thread read at once.
+  vtkSetClampMacro( BlockSize, int, 1, VTK_INT_MAX );
+  vtkGetMacro( BlockSize, int );
+
+  /// printf pattern of the output file names, given the pose index;
+  /// MetaImage files, e.g. "slices/slice_%05d.mha".
+  vtkSetStringMacro( OutputFilePattern );
+  vtkGetStringMacro( OutputFilePattern );
+
+  /// Reslice every pose of the log. Returns the number of images written,
+  /// or -1 if an image could not be written or nothing was set to reslice.
+  int Reslice( std::istream& log );
+
+  /// Lines of the last log that were neither poses nor comments.
+  vtkGetMacro( NumberOfSkippedLines, int );
+
+
+protected:
+
+  vtkDriverPoseLogReslicer();
+  virtual ~vtkDriverPoseLogReslicer();
+
+  /// State of one thread, set up before the first block.
+  struct Worker
+  {
+    vtkSmartPointer< vtkMRMLSliceNode > SliceNode;
+    vtkSmartPointer< vtkSliceImageReslicer > Reslicer;
+    vtkSmartPointer< vtkMetaImageWriter > Writer;
+    vtkSmartPointer< vtkMatrix4x4 > Pose;
+    std::vector< char > FileName;
+    int NumberOfFailures;
+  };
+
+  void SetRASToIJK( vtkMatrix4x4* rasToIJK );
+  /// Reads up to count poses into Block; returns the number read.
+  int ReadBlock( std::istream& log, int count );
+  void ReslicePose( Worker& worker, int index );
+  static VTK_THREAD_RETURN_TYPE ResliceThread( void* arg );
+
+  vtkSmartPointer< vtkImageData > Input;
+  vtkSmartPointer< vtkQuantizedImage > QuantizedInput;
+  vtkSmartPointer< vtkMatrix4x4 > RASToIJK;
+  int Method;
+  int Orientation;
+  int InterpolationMode;
+  int SliceDimensions[2];
+  double FieldOfView[2];
+  int ImageDimensions[2];
+  int NumberOfThreads;
+  int BlockSize;
+  char* OutputFilePattern;
+  int NumberOfSkippedLines;
+
+  std::vector< Worker > Workers;
+  vtkMultiThreader* Threader;
+  /// Poses of the current block, 16 values each, and the index of the first.
+  std::vector< double > Block;
+  int NumberOfBlockPoses;
+  int FirstBlockIndex;
+
+private:
+
+  vtkDriverPoseLogReslicer(const vtkDriverPoseLogReslicer&); // Not implemented
+  void operator=(const vtkDriverPoseLogReslicer&);           // Not implemented
+};
+
+#endif
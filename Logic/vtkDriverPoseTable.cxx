@@ -0,0 +1,272 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VolumeResliceDriver includes
+#include "vtkDriverPoseTable.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+
+
+
+vtkStandardNewMacro(vtkDriverPoseTable);
+
+
+
+vtkDriverPoseTable
+::vtkDriverPoseTable()
+{
+  this->NumberOfRows = 0;
+  this->Capacity = 0;
+  this->FirstDirtyRow = 0;
+  this->LastDirtyRow = -1;
+  this->NumberOfComputedRows = 0;
+}
+
+
+
+vtkDriverPoseTable
+::~vtkDriverPoseTable()
+{
+}
+
+
+
+void vtkDriverPoseTable
+::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf( os, indent );
+
+  os << indent << "NumberOfRows: " << this->NumberOfRows << std::endl;
+  os << indent << "Capacity: " << this->Capacity << std::endl;
+  os << indent << "NumberOfDirtyRows: "
+     << std::max( 0, this->LastDirtyRow - this->FirstDirtyRow + 1 ) << std::endl;
+  os << indent << "NumberOfComputedRows: " << this->NumberOfComputedRows << std::endl;
+}
+
+
+
+float* vtkDriverPoseTable
+::GetArray( int array )
+{
+  return &this->Arrays[ static_cast< size_t >( array ) * this->Capacity ];
+}
+
+
+
+void vtkDriverPoseTable
+::SetNumberOfRows( int numberOfRows )
+{
+  if ( numberOfRows < 0 || numberOfRows == this->NumberOfRows )
+  {
+    return;
+  }
+
+  // Arrays start on multiples of 8 floats, for aligned vector loads, and
+  // are padded so that they do not start 4 KB apart, which would make
+  // loads from one stall on stores to another.
+  int capacity = ( ( numberOfRows + 7 ) & ~7 ) + 8;
+  if ( capacity > this->Capacity )
+  {
+    std::vector< float > arrays( static_cast< size_t >( NUMBER_OF_ARRAYS ) * capacity, 0.0f );
+    for ( int a = 0; a < NUMBER_OF_ARRAYS && this->NumberOfRows > 0; ++ a )
+    {
+      std::copy( this->GetArray( a ), this->GetArray( a ) + this->NumberOfRows,
+                 arrays.begin() + static_cast< size_t >( a ) * capacity );
+    }
+    this->Arrays.swap( arrays );
+    this->Capacity = capacity;
+  }
+  this->Flags.resize( numberOfRows, 0 );
+
+  // New rows: identity poses, already computed.
+  for ( int row = this->NumberOfRows; row < numberOfRows; ++ row )
+  {
+    for ( int a = 0; a < NUMBER_OF_ARRAYS; ++ a )
+    {
+      this->GetArray( a )[ row ] = 0.0f;
+    }
+    for ( int k = 0; k < 3; ++ k )
+    {
+      this->GetArray( AXIS_X + 4 * k )[ row ] = 1.0f;
+      this->GetArray( SCALE + k )[ row ] = 1.0f;
+    }
+    this->GetArray( UNIT_X )[ row ] = 1.0f;
+    this->GetArray( UNIT_Z + 2 )[ row ] = 1.0f;
+    this->Flags[ row ] = 0;
+  }
+  this->NumberOfRows = numberOfRows;
+  this->LastDirtyRow = std::min( this->LastDirtyRow, numberOfRows - 1 );
+  this->Modified();
+}
+
+
+
+int vtkDriverPoseTable
+::GetNumberOfRows()
+{
+  return this->NumberOfRows;
+}
+
+
+
+void vtkDriverPoseTable
+::SetPose( int row, const double pose[16] )
+{
+  if ( row < 0 || row >= this->NumberOfRows )
+  {
+    vtkErrorMacro( "SetPose: no row " << row );
+    return;
+  }
+  // Column c of the pose goes to the arrays from 3 * c on.
+  float* column = &this->Arrays[ row ];
+  size_t stride = this->Capacity;
+  for ( int c = 0; c < 4; ++ c )
+  {
+    for ( int k = 0; k < 3; ++ k )
+    {
+      column[ ( 3 * c + k ) * stride ] = static_cast< float >( pose[ 4 * k + c ] );
+    }
+  }
+  this->Flags[ row ] = FLAG_DIRTY;
+  this->FirstDirtyRow = ( this->FirstDirtyRow > this->LastDirtyRow ) ? row : std::min( this->FirstDirtyRow, row );
+  this->LastDirtyRow = std::max( this->LastDirtyRow, row );
+}
+
+
+
+int vtkDriverPoseTable
+::GetFlags( int row )
+{
+  if ( row < 0 || row >= this->NumberOfRows )
+  {
+    return 0;
+  }
+  return this->Flags[ row ];
+}
+
+
+
+int vtkDriverPoseTable
+::Update()
+{
+  if ( this->FirstDirtyRow > this->LastDirtyRow )
+  {
+    return 0;
+  }
+
+  int first = this->FirstDirtyRow;
+  int last = this->LastDirtyRow + 1;
+  this->ComputeRows( first, last );
+  for ( int row = first; row < last; ++ row )
+  {
+    this->Flags[ row ] &= ~FLAG_DIRTY;
+  }
+  this->FirstDirtyRow = 0;
+  this->LastDirtyRow = -1;
+  this->NumberOfComputedRows += last - first;
+  return last - first;
+}
+
+
+
+void vtkDriverPoseTable
+::ComputeRows( int first, int last )
+{
+  int n = last - first;
+
+  // Squared lengths of the axes.
+  for ( int axis = 0; axis < 3; ++ axis )
+  {
+    const float* x = this->GetArray( AXIS_X + 3 * axis ) + first;
+    const float* y = this->GetArray( AXIS_X + 3 * axis + 1 ) + first;
+    const float* z = this->GetArray( AXIS_X + 3 * axis + 2 ) + first;
+    float* scale = this->GetArray( SCALE + axis ) + first;
+    for ( int i = 0; i < n; ++ i )
+    {
+      scale[ i ] = x[ i ] * x[ i ] + y[ i ] * y[ i ] + z[ i ] * z[ i ];
+    }
+  }
+
+  // Lengths, and inverses of the transverse and normal ones, row by row.
+  // Zero axes stay as they are, as vtkMath::Normalize() leaves them.
+  float* scaleX = this->GetArray( SCALE ) + first;
+  float* scaleY = this->GetArray( SCALE + 1 ) + first;
+  float* scaleZ = this->GetArray( SCALE + 2 ) + first;
+  float* inverseX = this->GetArray( INVERSE_SCALE ) + first;
+  float* inverseZ = this->GetArray( INVERSE_SCALE + 1 ) + first;
+  for ( int i = 0; i < n; ++ i )
+  {
+    scaleX[ i ] = std::sqrt( scaleX[ i ] );
+    scaleY[ i ] = std::sqrt( scaleY[ i ] );
+    scaleZ[ i ] = std::sqrt( scaleZ[ i ] );
+    inverseX[ i ] = ( scaleX[ i ] > 0.0f ) ? 1.0f / scaleX[ i ] : 1.0f;
+    inverseZ[ i ] = ( scaleZ[ i ] > 0.0f ) ? 1.0f / scaleZ[ i ] : 1.0f;
+  }
+
+  // Unit transverse and normal axes.
+  for ( int k = 0; k < 6; ++ k )
+  {
+    const float* axis = this->GetArray( ( k < 3 ) ? AXIS_X + k : AXIS_Z + k - 3 ) + first;
+    const float* inverse = ( k < 3 ) ? inverseX : inverseZ;
+    float* unit = this->GetArray( ( k < 3 ) ? UNIT_X + k : UNIT_Z + k - 3 ) + first;
+    for ( int i = 0; i < n; ++ i )
+    {
+      unit[ i ] = axis[ i ] * inverse[ i ];
+    }
+  }
+}
+
+
+
+void vtkDriverPoseTable
+::GetSliceFrame( int row, bool unitAxes, float transverse[3], float normal[3], float position[3] )
+{
+  if ( row < 0 || row >= this->NumberOfRows )
+  {
+    return;
+  }
+  const float* column = &this->Arrays[ row ];
+  size_t stride = this->Capacity;
+  int transverseArray = unitAxes ? UNIT_X : AXIS_X;
+  int normalArray = unitAxes ? UNIT_Z : AXIS_Z;
+  for ( int k = 0; k < 3; ++ k )
+  {
+    transverse[ k ] = column[ ( transverseArray + k ) * stride ];
+    normal[ k ] = column[ ( normalArray + k ) * stride ];
+    position[ k ] = column[ ( POSITION + k ) * stride ];
+  }
+}
+
+
+
+void vtkDriverPoseTable
+::GetScales( int row, float scales[3] )
+{
+  if ( row < 0 || row >= this->NumberOfRows )
+  {
+    return;
+  }
+  for ( int k = 0; k < 3; ++ k )
+  {
+    scales[ k ] = this->GetArray( SCALE + k )[ row ];
+  }
+}
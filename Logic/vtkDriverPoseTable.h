@@ -0,0 +1,126 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkDriverPoseTable - driver poses as arrays, turned into slice frames in batches
+// .SECTION Description
+// Holds the latest pose of many drivers, one row per driver, as a
+// structure of arrays: one float array per component of the axes, the
+// position, the axis scales and the unit axes, plus one flag byte per row.
+// Update() computes the slice frames of the rows set since the previous
+// update, all at once: axis lengths and normalized transverse and normal
+// axes. Each step is a plain loop over contiguous arrays that the
+// compiler vectorizes, except for the square roots and their inverses:
+// sqrt sets errno unless the build says otherwise, so those are taken one
+// row at a time.
+//
+// vtkSlicerVolumeResliceDriverLogic fills it from the shared-memory pose
+// channel only, where one poll brings the poses of many drivers. Poses of
+// MRML events come one driver at a time, image frames already centered
+// by GetImageFramePose(), and keep the double precision path of
+// ComputeSlicePlane(); the frames here match it up to float rounding.
+// Setting rows and updating never allocate once the number of rows is
+// set.
+
+
+#ifndef __vtkDriverPoseTable_h
+#define __vtkDriverPoseTable_h
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerVolumeResliceDriverModuleLogicExport.h"
+
+
+/// \ingroup Slicer_QtModules_VolumeResliceDriver
+class VTK_SLICER_VOLUMERESLICEDRIVER_MODULE_LOGIC_EXPORT vtkDriverPoseTable
+  : public vtkObject
+{
+public:
+
+  static vtkDriverPoseTable *New();
+  vtkTypeMacro(vtkDriverPoseTable,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  enum {
+    /// The row was set since the last Update().
+    FLAG_DIRTY = 1
+  };
+
+  /// Rows, one per driver. New rows are identity poses, computed.
+  void SetNumberOfRows( int numberOfRows );
+  int GetNumberOfRows();
+
+  /// Pose of a driver, 16 elements row by row as in vtkMatrix4x4::Element.
+  void SetPose( int row, const double pose[16] );
+  int GetFlags( int row );
+
+  /// Computes the slice frames of the rows from the first to the last
+  /// dirty one, clean rows between them included; returns their number.
+  int Update();
+
+  /// Slice frame of a computed row: transverse and normal axes, unit
+  /// length if unitAxes is set and as given otherwise, and position.
+  void GetSliceFrame( int row, bool unitAxes, float transverse[3], float normal[3], float position[3] );
+  /// Lengths of the axes of a computed row.
+  void GetScales( int row, float scales[3] );
+
+  /// Rows computed by all updates.
+  vtkGetMacro( NumberOfComputedRows, unsigned long );
+
+
+protected:
+
+  vtkDriverPoseTable();
+  virtual ~vtkDriverPoseTable();
+
+  /// Arrays of the table, each Capacity floats long.
+  enum {
+    AXIS_X = 0,
+    AXIS_Y = 3,
+    AXIS_Z = 6,
+    POSITION = 9,
+    SCALE = 12,
+    /// Of the X and Z axes.
+    INVERSE_SCALE = 15,
+    UNIT_X = 17,
+    UNIT_Z = 20,
+    NUMBER_OF_ARRAYS = 23
+  };
+  float* GetArray( int array );
+
+  /// Applies the kernel to rows [first, last).
+  void ComputeRows( int first, int last );
+
+  int NumberOfRows;
+  int Capacity;
+  std::vector< float > Arrays;
+  std::vector< unsigned char > Flags;
+  /// Range of the dirty rows, empty if first > last.
+  int FirstDirtyRow;
+  int LastDirtyRow;
+  unsigned long NumberOfComputedRows;
+
+private:
+
+  vtkDriverPoseTable(const vtkDriverPoseTable&); // Not implemented
+  void operator=(const vtkDriverPoseTable&);     // Not implemented
+};
+
+#endif
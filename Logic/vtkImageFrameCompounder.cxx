@@ -0,0 +1,412 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VolumeResliceDriver includes
+#include "vtkImageFrameCompounder.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <cmath>
+#include <cstring>
+
+
+
+vtkStandardNewMacro(vtkImageFrameCompounder);
+
+
+
+struct vtkImageFrameCompounderThreadData
+{
+  vtkImageData* Frame;
+  float* OutputPointer;
+  float* Weights;
+  int Dimensions[3];
+  double Start[3];  // continuous output index of the first frame pixel
+  double StepI[3];  // output index increment per frame column
+  double StepJ[3];  // output index increment per frame row
+  int SplitAxis;
+  bool Weighted;
+};
+
+
+
+namespace
+{
+
+inline void AccumulateVoxel( float* output, float* weights, vtkIdType index, float value, float weight )
+{
+  float total = weights[ index ] + weight;
+  output[ index ] += ( value - output[ index ] ) * ( weight / total );
+  weights[ index ] = total;
+}
+
+
+// Each thread owns the output voxels in [slabMin, slabMax) along the split axis,
+// so no two threads ever write the same voxel.
+template < class T >
+void InsertFrameSlab( vtkImageFrameCompounderThreadData* data, T* framePtr, int slabMin, int slabMax )
+{
+  int frameDims[3];
+  data->Frame->GetDimensions( frameDims );
+  int numComponents = data->Frame->GetNumberOfScalarComponents();
+
+  const int* dims = data->Dimensions;
+  vtkIdType rowSize = dims[0];
+  vtkIdType sliceSize = static_cast< vtkIdType >( dims[0] ) * dims[1];
+  int axis = data->SplitAxis;
+  double margin = data->Weighted ? 1.0 : 0.5;
+
+  for ( int j = 0; j < frameDims[1]; ++ j )
+  {
+    double rowStart[3];
+    for ( int k = 0; k < 3; ++ k )
+    {
+      rowStart[ k ] = data->Start[ k ] + j * data->StepJ[ k ];
+    }
+
+    // Skip rows that cannot reach this thread's slab.
+    double a0 = rowStart[ axis ];
+    double a1 = a0 + ( frameDims[0] - 1 ) * data->StepI[ axis ];
+    if (    ( a0 > a1 ? a0 : a1 ) < slabMin - margin
+         || ( a0 < a1 ? a0 : a1 ) > slabMax - 1 + margin )
+    {
+      continue;
+    }
+
+    T* pixel = framePtr + static_cast< vtkIdType >( j ) * frameDims[0] * numComponents;
+    for ( int i = 0; i < frameDims[0]; ++ i, pixel += numComponents )
+    {
+      double p[3];
+      p[0] = rowStart[0] + i * data->StepI[0];
+      p[1] = rowStart[1] + i * data->StepI[1];
+      p[2] = rowStart[2] + i * data->StepI[2];
+      float value = static_cast< float >( *pixel );
+
+      if ( ! data->Weighted )
+      {
+        int x[3];
+        x[0] = vtkMath::Floor( p[0] + 0.5 );
+        x[1] = vtkMath::Floor( p[1] + 0.5 );
+        x[2] = vtkMath::Floor( p[2] + 0.5 );
+        if (    x[0] < 0 || x[0] >= dims[0]
+             || x[1] < 0 || x[1] >= dims[1]
+             || x[2] < 0 || x[2] >= dims[2]
+             || x[ axis ] < slabMin || x[ axis ] >= slabMax )
+        {
+          continue;
+        }
+        AccumulateVoxel( data->OutputPointer, data->Weights,
+                         x[0] + x[1] * rowSize + x[2] * sliceSize, value, 1.0f );
+        continue;
+      }
+
+      // Distance-weighted splat into the 8 surrounding voxels.
+      int x0[3];
+      double f[3];
+      for ( int k = 0; k < 3; ++ k )
+      {
+        x0[ k ] = vtkMath::Floor( p[ k ] );
+        f[ k ] = p[ k ] - x0[ k ];
+      }
+      for ( int n = 0; n < 8; ++ n )
+      {
+        int x[3];
+        double w = 1.0;
+        bool inside = true;
+        for ( int k = 0; k < 3; ++ k )
+        {
+          int d = ( n >> k ) & 1;
+          x[ k ] = x0[ k ] + d;
+          w *= d ? f[ k ] : ( 1.0 - f[ k ] );
+          inside = inside && x[ k ] >= 0 && x[ k ] < dims[ k ];
+        }
+        if ( ! inside || w <= 0.0 || x[ axis ] < slabMin || x[ axis ] >= slabMax )
+        {
+          continue;
+        }
+        AccumulateVoxel( data->OutputPointer, data->Weights,
+                         x[0] + x[1] * rowSize + x[2] * sliceSize, value, static_cast< float >( w ) );
+      }
+    }
+  }
+}
+
+} // namespace
+
+
+
+vtkImageFrameCompounder
+::vtkImageFrameCompounder()
+{
+  this->OutputExtent[0] = 0;
+  this->OutputExtent[1] = 255;
+  this->OutputExtent[2] = 0;
+  this->OutputExtent[3] = 255;
+  this->OutputExtent[4] = 0;
+  this->OutputExtent[5] = 255;
+  this->OutputSpacing[0] = this->OutputSpacing[1] = this->OutputSpacing[2] = 1.0;
+  this->OutputOrigin[0] = this->OutputOrigin[1] = this->OutputOrigin[2] = 0.0;
+  this->MaximumMemoryInMB = 512;
+  this->InsertionMode = INSERTION_NEAREST;
+  this->NumberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  this->NumberOfInsertedFrames = 0;
+  this->Output = NULL;
+  this->Threader = vtkMultiThreader::New();
+}
+
+
+
+vtkImageFrameCompounder
+::~vtkImageFrameCompounder()
+{
+  if ( this->Output != NULL )
+  {
+    this->Output->Delete();
+  }
+  this->Threader->Delete();
+}
+
+
+
+void vtkImageFrameCompounder
+::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf( os, indent );
+
+  os << indent << "OutputExtent: " << this->OutputExtent[0] << " " << this->OutputExtent[1] << " "
+     << this->OutputExtent[2] << " " << this->OutputExtent[3] << " "
+     << this->OutputExtent[4] << " " << this->OutputExtent[5] << std::endl;
+  os << indent << "OutputSpacing: " << this->OutputSpacing[0] << " " << this->OutputSpacing[1] << " "
+     << this->OutputSpacing[2] << std::endl;
+  os << indent << "OutputOrigin: " << this->OutputOrigin[0] << " " << this->OutputOrigin[1] << " "
+     << this->OutputOrigin[2] << std::endl;
+  os << indent << "MaximumMemoryInMB: " << this->MaximumMemoryInMB << std::endl;
+  os << indent << "InsertionMode: " << this->InsertionMode << std::endl;
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << std::endl;
+  os << indent << "NumberOfInsertedFrames: " << this->NumberOfInsertedFrames << std::endl;
+}
+
+
+
+bool vtkImageFrameCompounder
+::Reset()
+{
+  double numberOfVoxels = 1.0;
+  for ( int k = 0; k < 3; ++ k )
+  {
+    int size = this->OutputExtent[ 2 * k + 1 ] - this->OutputExtent[ 2 * k ] + 1;
+    if ( size <= 0 || this->OutputSpacing[ k ] <= 0.0 )
+    {
+      vtkErrorMacro( "Invalid output extent or spacing." );
+      return false;
+    }
+    numberOfVoxels *= size;
+  }
+
+  // Output scalars plus one accumulation weight per voxel.
+  double megabytes = numberOfVoxels * 2 * sizeof( float ) / ( 1024.0 * 1024.0 );
+  if ( megabytes > this->MaximumMemoryInMB )
+  {
+    vtkErrorMacro( "Output volume needs " << megabytes << " MB, limit is " << this->MaximumMemoryInMB << " MB." );
+    return false;
+  }
+
+  if ( this->Output == NULL )
+  {
+    this->Output = vtkImageData::New();
+  }
+  this->Output->SetExtent( this->OutputExtent );
+  this->Output->SetWholeExtent( this->OutputExtent );
+  this->Output->SetSpacing( this->OutputSpacing );
+  this->Output->SetOrigin( this->OutputOrigin );
+  this->Output->SetScalarTypeToFloat();
+  this->Output->SetNumberOfScalarComponents( 1 );
+  this->Output->AllocateScalars();
+
+  vtkIdType count = static_cast< vtkIdType >( numberOfVoxels );
+  memset( this->Output->GetScalarPointer(), 0, count * sizeof( float ) );
+  this->Weights.assign( count, 0.0f );
+
+  this->NumberOfInsertedFrames = 0;
+  this->Modified();
+  return true;
+}
+
+
+
+void vtkImageFrameCompounder
+::InsertFrame( vtkImageData* frame, vtkMatrix4x4* ijkToRAS )
+{
+  if ( frame == NULL || ijkToRAS == NULL || frame->GetScalarPointer() == NULL )
+  {
+    return;
+  }
+
+  if ( this->Output == NULL && ! this->Reset() )
+  {
+    return;
+  }
+
+  int frameExtent[6];
+  frame->GetExtent( frameExtent );
+  if ( frameExtent[4] != frameExtent[5] )
+  {
+    vtkWarningMacro( "Only single-slice frames can be compounded." );
+    return;
+  }
+
+  vtkImageFrameCompounderThreadData data;
+  data.Frame = frame;
+  data.OutputPointer = static_cast< float* >( this->Output->GetScalarPointer() );
+  data.Weights = &this->Weights[ 0 ];
+  data.Weighted = ( this->InsertionMode == INSERTION_DISTANCE_WEIGHTED );
+
+  // Map frame pixel (i, j) to a continuous index into the output buffer.
+  for ( int k = 0; k < 3; ++ k )
+  {
+    double s = this->OutputSpacing[ k ];
+    data.Dimensions[ k ] = this->OutputExtent[ 2 * k + 1 ] - this->OutputExtent[ 2 * k ] + 1;
+    data.StepI[ k ] = ijkToRAS->Element[ k ][ 0 ] / s;
+    data.StepJ[ k ] = ijkToRAS->Element[ k ][ 1 ] / s;
+    data.Start[ k ] = ( ijkToRAS->Element[ k ][ 3 ] - this->OutputOrigin[ k ] ) / s - this->OutputExtent[ 2 * k ]
+                      + frameExtent[0] * data.StepI[ k ]
+                      + frameExtent[2] * data.StepJ[ k ]
+                      + frameExtent[4] * ijkToRAS->Element[ k ][ 2 ] / s;
+  }
+
+  // Split the work along the output axis the frame spans the most, so that
+  // threads get comparable shares regardless of the probe orientation.
+  int frameDims[3];
+  frame->GetDimensions( frameDims );
+  data.SplitAxis = 0;
+  double maxSpan = -1.0;
+  for ( int k = 0; k < 3; ++ k )
+  {
+    double span = fabs( data.StepI[ k ] ) * frameDims[0] + fabs( data.StepJ[ k ] ) * frameDims[1];
+    if ( span > maxSpan )
+    {
+      maxSpan = span;
+      data.SplitAxis = k;
+    }
+  }
+
+  this->Threader->SetNumberOfThreads( this->NumberOfThreads );
+  this->Threader->SetSingleMethod( vtkImageFrameCompounder::InsertFrameThread, &data );
+  this->Threader->SingleMethodExecute();
+
+  ++ this->NumberOfInsertedFrames;
+  this->Output->Modified();
+  this->Modified();
+}
+
+
+
+VTK_THREAD_RETURN_TYPE vtkImageFrameCompounder
+::InsertFrameThread( void* arg )
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast< vtkMultiThreader::ThreadInfo* >( arg );
+  vtkImageFrameCompounderThreadData* data = static_cast< vtkImageFrameCompounderThreadData* >( info->UserData );
+
+  int size = data->Dimensions[ data->SplitAxis ];
+  int slabMin = size * info->ThreadID / info->NumberOfThreads;
+  int slabMax = size * ( info->ThreadID + 1 ) / info->NumberOfThreads;
+  if ( slabMin >= slabMax )
+  {
+    return VTK_THREAD_RETURN_VALUE;
+  }
+
+  void* framePtr = data->Frame->GetScalarPointer();
+  switch ( data->Frame->GetScalarType() )
+  {
+    vtkTemplateMacro( InsertFrameSlab( data, static_cast< VTK_TT* >( framePtr ), slabMin, slabMax ) );
+  }
+
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+
+
+void vtkImageFrameCompounder
+::FillHoles()
+{
+  if ( this->Output == NULL )
+  {
+    return;
+  }
+
+  int dims[3];
+  this->Output->GetDimensions( dims );
+  vtkIdType sliceSize = static_cast< vtkIdType >( dims[0] ) * dims[1];
+  float* output = static_cast< float* >( this->Output->GetScalarPointer() );
+
+  // Holes keep a zero weight, so they only ever average hit voxels and are
+  // overwritten by the next frame that reaches them.
+  for ( int z = 0; z < dims[2]; ++ z )
+  {
+    for ( int y = 0; y < dims[1]; ++ y )
+    {
+      for ( int x = 0; x < dims[0]; ++ x )
+      {
+        vtkIdType index = x + y * dims[0] + z * sliceSize;
+        if ( this->Weights[ index ] > 0.0f )
+        {
+          continue;
+        }
+        double sum = 0.0;
+        double weight = 0.0;
+        for ( int dz = -1; dz <= 1; ++ dz )
+        {
+          if ( z + dz < 0 || z + dz >= dims[2] ) continue;
+          for ( int dy = -1; dy <= 1; ++ dy )
+          {
+            if ( y + dy < 0 || y + dy >= dims[1] ) continue;
+            for ( int dx = -1; dx <= 1; ++ dx )
+            {
+              if ( x + dx < 0 || x + dx >= dims[0] ) continue;
+              vtkIdType n = index + dx + dy * dims[0] + dz * sliceSize;
+              float w = this->Weights[ n ];
+              if ( w > 0.0f )
+              {
+                sum += output[ n ] * w;
+                weight += w;
+              }
+            }
+          }
+        }
+        if ( weight > 0.0 )
+        {
+          output[ index ] = static_cast< float >( sum / weight );
+        }
+      }
+    }
+  }
+
+  this->Output->Modified();
+}
+
+
+
+vtkImageData* vtkImageFrameCompounder
+::GetOutput()
+{
+  return this->Output;
+}
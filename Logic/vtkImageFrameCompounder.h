@@ -0,0 +1,116 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkImageFrameCompounder - insert tracked 2D frames into a 3D volume
+// .SECTION Description
+// Accumulates 2D image frames (e.g. tracked ultrasound) into an axis-aligned
+// RAS output volume. Each frame only touches the voxels it intersects, so
+// frames can be inserted incrementally as they arrive. The output grid is
+// fixed by the extent, spacing and origin, which bound the memory use.
+
+
+#ifndef __vtkImageFrameCompounder_h
+#define __vtkImageFrameCompounder_h
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkObject.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerVolumeResliceDriverModuleLogicExport.h"
+
+class vtkImageData;
+class vtkMatrix4x4;
+
+
+/// \ingroup Slicer_QtModules_VolumeResliceDriver
+class VTK_SLICER_VOLUMERESLICEDRIVER_MODULE_LOGIC_EXPORT vtkImageFrameCompounder
+  : public vtkObject
+{
+public:
+
+  static vtkImageFrameCompounder *New();
+  vtkTypeMacro(vtkImageFrameCompounder,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  enum {
+    INSERTION_NEAREST,
+    INSERTION_DISTANCE_WEIGHTED,
+  };
+
+  /// Geometry of the output volume. Changes take effect at the next Reset().
+  vtkSetVector6Macro( OutputExtent, int );
+  vtkGetVector6Macro( OutputExtent, int );
+  vtkSetVector3Macro( OutputSpacing, double );
+  vtkGetVector3Macro( OutputSpacing, double );
+  vtkSetVector3Macro( OutputOrigin, double );
+  vtkGetVector3Macro( OutputOrigin, double );
+
+  /// Upper limit for output volume plus accumulation buffer, in megabytes.
+  vtkSetMacro( MaximumMemoryInMB, int );
+  vtkGetMacro( MaximumMemoryInMB, int );
+
+  vtkSetClampMacro( InsertionMode, int, INSERTION_NEAREST, INSERTION_DISTANCE_WEIGHTED );
+  vtkGetMacro( InsertionMode, int );
+
+  vtkSetClampMacro( NumberOfThreads, int, 1, VTK_MAX_THREADS );
+  vtkGetMacro( NumberOfThreads, int );
+
+  vtkGetMacro( NumberOfInsertedFrames, int );
+
+  /// Allocate the output volume and clear the accumulation buffer.
+  /// Returns false if the configured extent exceeds the memory limit.
+  bool Reset();
+
+  /// Insert a single-slice frame. ijkToRAS maps frame voxel indices to RAS.
+  void InsertFrame( vtkImageData* frame, vtkMatrix4x4* ijkToRAS );
+
+  /// Fill voxels no frame has reached from the mean of their filled neighbours.
+  void FillHoles();
+
+  /// Compounded volume; float scalars, RAS-aligned, NULL before Reset().
+  vtkImageData* GetOutput();
+
+
+protected:
+
+  vtkImageFrameCompounder();
+  virtual ~vtkImageFrameCompounder();
+
+  static VTK_THREAD_RETURN_TYPE InsertFrameThread( void* arg );
+
+  int OutputExtent[6];
+  double OutputSpacing[3];
+  double OutputOrigin[3];
+  int MaximumMemoryInMB;
+  int InsertionMode;
+  int NumberOfThreads;
+  int NumberOfInsertedFrames;
+
+  vtkImageData* Output;
+  std::vector< float > Weights;
+  vtkMultiThreader* Threader;
+
+private:
+
+  vtkImageFrameCompounder(const vtkImageFrameCompounder&); // Not implemented
+  void operator=(const vtkImageFrameCompounder&);          // Not implemented
+};
+
+#endif
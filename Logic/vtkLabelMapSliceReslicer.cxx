@@ -0,0 +1,595 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VolumeResliceDriver includes
+#include "vtkLabelMapSliceReslicer.h"
+#include "vtkSliceImageSampling.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkCellData.h>
+#include <vtkImageData.h>
+#include <vtkIntArray.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+// STD includes
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+
+
+vtkStandardNewMacro(vtkLabelMapSliceReslicer);
+
+
+
+namespace
+{
+
+template < class T, class L >
+inline L ToLabel( T value )
+{
+  double v = static_cast< double >( value );
+  if ( v < 0.0 || v > std::numeric_limits< L >::max() )
+  {
+    return 0;
+  }
+  return static_cast< L >( value );
+}
+
+
+inline int CornerX( int corner, int width )
+{
+  return corner % ( width + 1 );
+}
+
+
+inline int CornerY( int corner, int width )
+{
+  return corner / ( width + 1 );
+}
+
+
+/// Pixel edges only run along x or y, so three corners are collinear when
+/// they share one of them.
+inline bool Collinear( int a, int b, int c, int width )
+{
+  return    ( CornerX( a, width ) == CornerX( b, width ) && CornerX( b, width ) == CornerX( c, width ) )
+         || ( CornerY( a, width ) == CornerY( b, width ) && CornerY( b, width ) == CornerY( c, width ) );
+}
+
+
+void AppendCorner( std::vector< int >& polyline, int corner, int width )
+{
+  size_t n = polyline.size();
+  if ( n >= 2 && Collinear( polyline[ n - 2 ], polyline[ n - 1 ], corner, width ) )
+  {
+    polyline[ n - 1 ] = corner;
+  }
+  else
+  {
+    polyline.push_back( corner );
+  }
+}
+
+} // namespace
+
+
+
+vtkLabelMapSliceReslicer
+::vtkLabelMapSliceReslicer()
+{
+  this->RASToIJK = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->XYToRAS = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->OutputSize[0] = 0;
+  this->OutputSize[1] = 0;
+  this->Output = vtkSmartPointer< vtkImageData >::New();
+  this->ContourOutput = vtkSmartPointer< vtkPolyData >::New();
+  this->ContourPoints = vtkSmartPointer< vtkPoints >::New();
+  this->ContourLines = vtkSmartPointer< vtkCellArray >::New();
+  this->ContourLabels = vtkSmartPointer< vtkIntArray >::New();
+  this->ContourLabels->SetName( "Label" );
+  this->ContourOutput->SetPoints( this->ContourPoints );
+  this->ContourOutput->SetLines( this->ContourLines );
+  this->ContourOutput->GetCellData()->SetScalars( this->ContourLabels );
+  this->InputRangeMTime = 0;
+  this->LabelScalarType = VTK_UNSIGNED_CHAR;
+  Run background;
+  background.Start = 0;
+  background.End = 0;
+  background.Label = 0;
+  this->EmptyRow.push_back( background );
+  this->NumberOfLabels = 0;
+  this->NumberOfRuns = 0;
+  this->NumberOfEdges = 0;
+}
+
+
+
+vtkLabelMapSliceReslicer
+::~vtkLabelMapSliceReslicer()
+{
+}
+
+
+
+void vtkLabelMapSliceReslicer
+::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf( os, indent );
+
+  os << indent << "Input: " << this->Input.GetPointer() << std::endl;
+  os << indent << "OutputSize: " << this->OutputSize[0] << " " << this->OutputSize[1] << std::endl;
+  os << indent << "LabelScalarType: " << this->LabelScalarType << std::endl;
+  os << indent << "NumberOfLabels: " << this->NumberOfLabels << std::endl;
+  os << indent << "NumberOfRuns: " << this->NumberOfRuns << std::endl;
+  os << indent << "NumberOfEdges: " << this->NumberOfEdges << std::endl;
+}
+
+
+
+void vtkLabelMapSliceReslicer
+::SetInput( vtkImageData* labelMap, vtkMatrix4x4* rasToIJK )
+{
+  if ( labelMap != this->Input )
+  {
+    this->InputRangeMTime = 0;
+  }
+  this->Input = labelMap;
+  if ( rasToIJK != NULL )
+  {
+    this->RASToIJK->DeepCopy( rasToIJK );
+  }
+  this->Modified();
+}
+
+
+
+vtkImageData* vtkLabelMapSliceReslicer
+::GetInput()
+{
+  return this->Input;
+}
+
+
+
+void vtkLabelMapSliceReslicer
+::SetSliceGeometry( vtkMatrix4x4* xyToRAS, int width, int height )
+{
+  if ( xyToRAS != NULL )
+  {
+    this->XYToRAS->DeepCopy( xyToRAS );
+  }
+  this->OutputSize[0] = width;
+  this->OutputSize[1] = height;
+  this->Modified();
+}
+
+
+
+vtkImageData* vtkLabelMapSliceReslicer
+::GetOutput()
+{
+  return this->Output;
+}
+
+
+
+vtkPolyData* vtkLabelMapSliceReslicer
+::GetContourOutput()
+{
+  return this->ContourOutput;
+}
+
+
+
+void vtkLabelMapSliceReslicer
+::AllocateOutput( int scalarType )
+{
+  int w = this->OutputSize[0];
+  int h = this->OutputSize[1];
+  int* dims = this->Output->GetDimensions();
+  if (    this->Output->GetScalarPointer() != NULL
+       && dims[0] == w && dims[1] == h
+       && this->Output->GetScalarType() == scalarType )
+  {
+    return;
+  }
+  this->Output->SetExtent( 0, w - 1, 0, h - 1, 0, 0 );
+  this->Output->SetWholeExtent( 0, w - 1, 0, h - 1, 0, 0 );
+  this->Output->SetSpacing( 1.0, 1.0, 1.0 );
+  this->Output->SetOrigin( 0.0, 0.0, 0.0 );
+  this->Output->SetScalarType( scalarType );
+  this->Output->SetNumberOfScalarComponents( 1 );
+  this->Output->AllocateScalars();
+}
+
+
+
+template < class T, class L >
+void vtkLabelMapSliceReslicer
+::SampleRow( const T* inPtr, const int inDims[3], const double rowStart[3], const double step[3],
+             int width, L* out )
+{
+  vtkIdType incY = inDims[0];
+  vtkIdType incZ = incY * inDims[1];
+
+  // Neighboring pixels mostly fall in the same voxel; read it once.
+  vtkIdType lastOffset = -1;
+  L lastLabel = 0;
+  for ( int i = 0; i < width; ++ i )
+  {
+    int x, y, z;
+    if (    ! vtkSliceImageSampling::NearestAxis( rowStart[0] + i * step[0], inDims[0], x )
+         || ! vtkSliceImageSampling::NearestAxis( rowStart[1] + i * step[1], inDims[1], y )
+         || ! vtkSliceImageSampling::NearestAxis( rowStart[2] + i * step[2], inDims[2], z ) )
+    {
+      out[ i ] = 0;
+      continue;
+    }
+    vtkIdType offset = x + y * incY + z * incZ;
+    if ( offset != lastOffset )
+    {
+      lastOffset = offset;
+      lastLabel = ToLabel< T, L >( inPtr[ offset ] );
+    }
+    out[ i ] = lastLabel;
+  }
+}
+
+
+
+template < class L >
+void vtkLabelMapSliceReslicer
+::EncodeRow( const L* row, int width, RunListType& runs )
+{
+  // A word of labels is compared at once against the run label repeated.
+  const int labelsPerWord = sizeof( size_t ) / sizeof( L );
+  const size_t repeat = static_cast< size_t >( -1 ) / std::numeric_limits< L >::max();
+
+  runs.clear();
+  int i = 0;
+  while ( i < width )
+  {
+    L label = row[ i ];
+    size_t pattern = repeat * label;
+    int j = i + 1;
+    while ( j + labelsPerWord <= width )
+    {
+      size_t word;
+      memcpy( &word, row + j, sizeof( word ) );
+      if ( word != pattern )
+      {
+        break;
+      }
+      j += labelsPerWord;
+    }
+    while ( j < width && row[ j ] == label )
+    {
+      ++ j;
+    }
+    Run run;
+    run.Start = i;
+    run.End = j;
+    run.Label = label;
+    runs.push_back( run );
+    i = j;
+  }
+}
+
+
+
+void vtkLabelMapSliceReslicer
+::AddEdge( unsigned short label, int a, int b )
+{
+  if ( label == 0 )
+  {
+    return;
+  }
+  int& slot = this->LabelSlots[ label ];
+  if ( slot < 0 )
+  {
+    slot = static_cast< int >( this->SlotLabels.size() );
+    this->SlotLabels.push_back( label );
+    if ( this->LabelEdges.size() < this->SlotLabels.size() )
+    {
+      this->LabelEdges.resize( this->SlotLabels.size() );
+    }
+  }
+  this->LabelEdges[ slot ].push_back( EdgeType( a, b ) );
+}
+
+
+
+void vtkLabelMapSliceReslicer
+::AddHorizontalEdges( int y, const RunListType& above, const RunListType& below )
+{
+  int w = this->OutputSize[0];
+  int corners = y * ( w + 1 );
+  size_t a = 0;
+  size_t b = 0;
+  int x = 0;
+  while ( x < w )
+  {
+    int aboveEnd = above[ a ].End;
+    int belowEnd = below[ b ].End;
+    int end = std::min( aboveEnd, belowEnd );
+    unsigned short aboveLabel = above[ a ].Label;
+    unsigned short belowLabel = below[ b ].Label;
+    if ( aboveLabel != belowLabel )
+    {
+      this->AddEdge( aboveLabel, corners + x, corners + end );
+      this->AddEdge( belowLabel, corners + x, corners + end );
+    }
+    x = end;
+    if ( aboveEnd == end )
+    {
+      ++ a;
+    }
+    if ( belowEnd == end )
+    {
+      ++ b;
+    }
+  }
+}
+
+
+
+void vtkLabelMapSliceReslicer
+::AddVerticalEdges( int y, const RunListType& runs )
+{
+  int w = this->OutputSize[0];
+  int top = y * ( w + 1 );
+  int bottom = top + w + 1;
+  unsigned short left = 0;
+  for ( size_t k = 0; k < runs.size(); ++ k )
+  {
+    int x = runs[ k ].Start;
+    this->AddEdge( left, top + x, bottom + x );
+    this->AddEdge( runs[ k ].Label, top + x, bottom + x );
+    left = runs[ k ].Label;
+  }
+  this->AddEdge( left, top + w, bottom + w );
+}
+
+
+
+void vtkLabelMapSliceReslicer
+::LinkEdges()
+{
+  int w = this->OutputSize[0];
+  double ( *xyToRAS )[4] = this->XYToRAS->Element;
+
+  this->ContourPoints->Reset();
+  this->ContourLines->Reset();
+  this->ContourLabels->Reset();
+  this->NumberOfEdges = 0;
+
+  for ( size_t slot = 0; slot < this->SlotLabels.size(); ++ slot )
+  {
+    const std::vector< EdgeType >& edges = this->LabelEdges[ slot ];
+    int n = static_cast< int >( edges.size() );
+    this->NumberOfEdges += n;
+
+    // Edge ends by corner, to find the next edge of a loop: a list per
+    // corner, heads in CornerEnds, links in NextEnd. End 2e + s is side s
+    // of edge e.
+    this->NextEnd.resize( 2 * n );
+    for ( int e = 0; e < n; ++ e )
+    {
+      this->NextEnd[ 2 * e ] = this->CornerEnds[ edges[ e ].first ];
+      this->CornerEnds[ edges[ e ].first ] = 2 * e;
+      this->NextEnd[ 2 * e + 1 ] = this->CornerEnds[ edges[ e ].second ];
+      this->CornerEnds[ edges[ e ].second ] = 2 * e + 1;
+    }
+    this->EdgeUsed.assign( n, 0 );
+
+    for ( int first = 0; first < n; ++ first )
+    {
+      if ( this->EdgeUsed[ first ] )
+      {
+        continue;
+      }
+      this->EdgeUsed[ first ] = 1;
+      std::vector< int >& polyline = this->Polyline;
+      polyline.clear();
+      polyline.push_back( edges[ first ].first );
+      polyline.push_back( edges[ first ].second );
+      int corner = edges[ first ].second;
+
+      // Every corner joins an even number of edges of a label, so the walk
+      // comes back to where it started.
+      for ( ;; )
+      {
+        int end = this->CornerEnds[ corner ];
+        while ( end >= 0 && this->EdgeUsed[ end >> 1 ] )
+        {
+          end = this->NextEnd[ end ];
+        }
+        if ( end < 0 )
+        {
+          break;
+        }
+        this->EdgeUsed[ end >> 1 ] = 1;
+        const EdgeType& edge = edges[ end >> 1 ];
+        corner = ( edge.first == corner ) ? edge.second : edge.first;
+        AppendCorner( polyline, corner, w );
+      }
+
+      // Start the loop at a corner rather than inside a straight edge.
+      size_t count = polyline.size();
+      if ( count >= 4 && polyline[ count - 1 ] == polyline[0]
+           && Collinear( polyline[ count - 2 ], polyline[0], polyline[1], w ) )
+      {
+        polyline.pop_back();
+        polyline[0] = polyline.back();
+        count = polyline.size();
+      }
+
+      bool closed = ( polyline[ count - 1 ] == polyline[0] );
+      int numberOfPoints = static_cast< int >( closed ? count - 1 : count );
+      vtkIdType firstId = this->ContourPoints->GetNumberOfPoints();
+      for ( int p = 0; p < numberOfPoints; ++ p )
+      {
+        // Corner (x, y) is between pixels, at x - 0.5, y - 0.5 in XY.
+        double x = CornerX( polyline[ p ], w ) - 0.5;
+        double y = CornerY( polyline[ p ], w ) - 0.5;
+        this->ContourPoints->InsertNextPoint( xyToRAS[0][0] * x + xyToRAS[0][1] * y + xyToRAS[0][3],
+                                              xyToRAS[1][0] * x + xyToRAS[1][1] * y + xyToRAS[1][3],
+                                              xyToRAS[2][0] * x + xyToRAS[2][1] * y + xyToRAS[2][3] );
+      }
+      this->ContourLines->InsertNextCell( static_cast< int >( count ) );
+      for ( int p = 0; p < numberOfPoints; ++ p )
+      {
+        this->ContourLines->InsertCellPoint( firstId + p );
+      }
+      if ( closed )
+      {
+        this->ContourLines->InsertCellPoint( firstId );
+      }
+      this->ContourLabels->InsertNextValue( this->SlotLabels[ slot ] );
+    }
+
+    for ( int e = 0; e < n; ++ e )
+    {
+      this->CornerEnds[ edges[ e ].first ] = -1;
+      this->CornerEnds[ edges[ e ].second ] = -1;
+    }
+  }
+
+  this->ContourPoints->Modified();
+  this->ContourLines->Modified();
+  this->ContourLabels->Modified();
+  this->ContourOutput->Modified();
+}
+
+
+
+void vtkLabelMapSliceReslicer
+::Update()
+{
+  // Forget the labels of the previous update.
+  for ( size_t slot = 0; slot < this->SlotLabels.size(); ++ slot )
+  {
+    this->LabelSlots[ this->SlotLabels[ slot ] ] = -1;
+    this->LabelEdges[ slot ].clear();
+  }
+  this->SlotLabels.clear();
+  this->NumberOfLabels = 0;
+  this->NumberOfRuns = 0;
+
+  int w = this->OutputSize[0];
+  int h = this->OutputSize[1];
+  if (    w <= 0 || h <= 0
+       || this->Input == NULL
+       || this->Input->GetScalarPointer() == NULL
+       || this->Input->GetNumberOfScalarComponents() != 1 )
+  {
+    this->LinkEdges();
+    return;
+  }
+
+  if ( this->Input->GetMTime() != this->InputRangeMTime )
+  {
+    double range[2];
+    this->Input->GetScalarRange( range );
+    this->LabelScalarType = ( range[0] >= 0.0 && range[1] <= VTK_UNSIGNED_CHAR_MAX ) ? VTK_UNSIGNED_CHAR
+                                                                                    : VTK_UNSIGNED_SHORT;
+    this->InputRangeMTime = this->Input->GetMTime();
+  }
+  this->AllocateOutput( this->LabelScalarType );
+  this->EmptyRow[0].End = w;
+  this->CornerEnds.resize( static_cast< size_t >( w + 1 ) * ( h + 1 ), -1 );
+  size_t labelSize = ( this->LabelScalarType == VTK_UNSIGNED_CHAR ) ? 1 : 2;
+  this->LabelSlots.resize( labelSize == 1 ? VTK_UNSIGNED_CHAR_MAX + 1 : VTK_UNSIGNED_SHORT_MAX + 1, -1 );
+
+  int inDims[3];
+  int inExtent[6];
+  this->Input->GetDimensions( inDims );
+  this->Input->GetExtent( inExtent );
+  const void* inPtr = this->Input->GetScalarPointer();
+  unsigned char* outPtr = static_cast< unsigned char* >( this->Output->GetScalarPointer() );
+  double ( *xyToRAS )[4] = this->XYToRAS->Element;
+  double ( *rasToIJK )[4] = this->RASToIJK->Element;
+  double step[3];
+  for ( int k = 0; k < 3; ++ k )
+  {
+    step[ k ] = rasToIJK[ k ][ 0 ] * xyToRAS[ 0 ][ 0 ] + rasToIJK[ k ][ 1 ] * xyToRAS[ 1 ][ 0 ]
+                + rasToIJK[ k ][ 2 ] * xyToRAS[ 2 ][ 0 ];
+  }
+
+  const RunListType* above = &this->EmptyRow;
+  for ( int j = 0; j < h; ++ j )
+  {
+    double ras[3];
+    double rowStart[3];
+    for ( int k = 0; k < 3; ++ k )
+    {
+      ras[ k ] = xyToRAS[ k ][ 1 ] * j + xyToRAS[ k ][ 3 ];
+    }
+    for ( int k = 0; k < 3; ++ k )
+    {
+      rowStart[ k ] = rasToIJK[ k ][ 0 ] * ras[0] + rasToIJK[ k ][ 1 ] * ras[1] + rasToIJK[ k ][ 2 ] * ras[2]
+                      + rasToIJK[ k ][ 3 ] - inExtent[ 2 * k ];
+    }
+
+    unsigned char* row = outPtr + static_cast< size_t >( j ) * w * labelSize;
+    switch ( this->Input->GetScalarType() )
+    {
+      vtkTemplateMacro(
+        if ( labelSize == 1 )
+        {
+          SampleRow( static_cast< const VTK_TT* >( inPtr ), inDims, rowStart, step, w, row );
+        }
+        else
+        {
+          SampleRow( static_cast< const VTK_TT* >( inPtr ), inDims, rowStart, step, w,
+                     reinterpret_cast< unsigned short* >( row ) );
+        } );
+    }
+
+    // A row equal to the one above has its runs and no horizontal edges.
+    RunListType& runs = this->Runs[ j & 1 ];
+    if ( j > 0 && memcmp( row, row - w * labelSize, w * labelSize ) == 0 )
+    {
+      runs = *above;
+    }
+    else
+    {
+      if ( labelSize == 1 )
+      {
+        EncodeRow( row, w, runs );
+      }
+      else
+      {
+        EncodeRow( reinterpret_cast< const unsigned short* >( row ), w, runs );
+      }
+      this->AddHorizontalEdges( j, *above, runs );
+    }
+    this->AddVerticalEdges( j, runs );
+    this->NumberOfRuns += static_cast< vtkIdType >( runs.size() );
+    above = &runs;
+  }
+  this->AddHorizontalEdges( h, *above, this->EmptyRow );
+
+  this->NumberOfLabels = static_cast< int >( this->SlotLabels.size() );
+  this->LinkEdges();
+  this->Output->Modified();
+}
@@ -0,0 +1,160 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkLabelMapSliceReslicer - label map slice and label outlines in one pass
+// .SECTION Description
+// Resamples a label map along one plane, nearest neighbor, into an unsigned
+// char image if the labels of the volume fit in 0..255 and into unsigned
+// short otherwise; other values become 0. The outline of every label is
+// extracted in the same pass over the rows: each row is run-length encoded
+// right after it is sampled, its vertical boundaries are the run ends, and
+// its horizontal boundaries are where its runs differ from the previous
+// row's. Uniform stretches are skipped a machine word of labels at a time,
+// and a row equal to the previous one reuses its runs.
+//
+// Outlines follow pixel edges. The edges of each label are linked into
+// closed polylines, one per boundary loop, without collinear points, and
+// written to GetContourOutput() in RAS with the label as cell scalars.
+// Label 0 is background and gets no outline; pixels outside the volume
+// are 0, so outlines close along the edge of the slice.
+
+
+#ifndef __vtkLabelMapSliceReslicer_h
+#define __vtkLabelMapSliceReslicer_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <utility>
+#include <vector>
+
+#include "vtkSlicerVolumeResliceDriverModuleLogicExport.h"
+
+class vtkCellArray;
+class vtkImageData;
+class vtkIntArray;
+class vtkMatrix4x4;
+class vtkPoints;
+class vtkPolyData;
+
+
+/// \ingroup Slicer_QtModules_VolumeResliceDriver
+class VTK_SLICER_VOLUMERESLICEDRIVER_MODULE_LOGIC_EXPORT vtkLabelMapSliceReslicer
+  : public vtkObject
+{
+public:
+
+  static vtkLabelMapSliceReslicer *New();
+  vtkTypeMacro(vtkLabelMapSliceReslicer,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Single-component label map and the matrix mapping RAS to its voxel indices.
+  void SetInput( vtkImageData* labelMap, vtkMatrix4x4* rasToIJK );
+  vtkImageData* GetInput();
+
+  /// Output plane: XYToRAS of the slice node and its size in pixels.
+  void SetSliceGeometry( vtkMatrix4x4* xyToRAS, int width, int height );
+
+  /// Resample the label map along the current plane and extract the outlines.
+  void Update();
+
+  /// Labels of the slice, unsigned char or unsigned short.
+  vtkImageData* GetOutput();
+  /// Outline polylines in RAS, with a "Label" cell array as scalars.
+  vtkPolyData* GetContourOutput();
+
+  /// Labels outlined, runs and boundary edges of the last update.
+  vtkGetMacro( NumberOfLabels, int );
+  vtkGetMacro( NumberOfRuns, vtkIdType );
+  vtkGetMacro( NumberOfEdges, vtkIdType );
+
+
+protected:
+
+  vtkLabelMapSliceReslicer();
+  virtual ~vtkLabelMapSliceReslicer();
+
+  /// Run of one label in a row, columns [Start, End).
+  struct Run
+  {
+    int Start;
+    int End;
+    unsigned short Label;
+  };
+  typedef std::vector< Run > RunListType;
+
+  /// Boundary edge between two pixel corners, corner = y * ( width + 1 ) + x.
+  typedef std::pair< int, int > EdgeType;
+
+  template < class T, class L >
+  static void SampleRow( const T* inPtr, const int inDims[3], const double rowStart[3], const double step[3],
+                         int width, L* out );
+  template < class L >
+  static void EncodeRow( const L* row, int width, RunListType& runs );
+
+  /// Edges along corner row y, between the rows above and below it, and
+  /// along the run ends of row y.
+  void AddHorizontalEdges( int y, const RunListType& above, const RunListType& below );
+  void AddVerticalEdges( int y, const RunListType& runs );
+  void AddEdge( unsigned short label, int a, int b );
+  /// Links the edges of every label into polylines of the contour output.
+  void LinkEdges();
+
+  void AllocateOutput( int scalarType );
+
+  vtkSmartPointer< vtkImageData > Input;
+  vtkSmartPointer< vtkMatrix4x4 > RASToIJK;
+  vtkSmartPointer< vtkMatrix4x4 > XYToRAS;
+  int OutputSize[2];
+
+  vtkSmartPointer< vtkImageData > Output;
+  vtkSmartPointer< vtkPolyData > ContourOutput;
+  vtkSmartPointer< vtkPoints > ContourPoints;
+  vtkSmartPointer< vtkCellArray > ContourLines;
+  vtkSmartPointer< vtkIntArray > ContourLabels;
+
+  /// Label range of the input, read again when it is modified.
+  unsigned long InputRangeMTime;
+  int LabelScalarType;
+
+  /// Scratch of Update(), kept for the next one.
+  RunListType Runs[2];
+  /// Background run of the rows above and below the slice.
+  RunListType EmptyRow;
+  /// Edges of each label seen, by slot; LabelSlots maps labels to slots.
+  std::vector< std::vector< EdgeType > > LabelEdges;
+  std::vector< unsigned short > SlotLabels;
+  std::vector< int > LabelSlots;
+  /// Edge ends at each corner while linking; all -1 in between.
+  std::vector< int > CornerEnds;
+  std::vector< int > NextEnd;
+  std::vector< char > EdgeUsed;
+  std::vector< int > Polyline;
+
+  int NumberOfLabels;
+  vtkIdType NumberOfRuns;
+  vtkIdType NumberOfEdges;
+
+private:
+
+  vtkLabelMapSliceReslicer(const vtkLabelMapSliceReslicer&); // Not implemented
+  void operator=(const vtkLabelMapSliceReslicer&);           // Not implemented
+};
+
+#endif
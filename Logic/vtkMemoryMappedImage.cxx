@@ -0,0 +1,368 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VolumeResliceDriver includes
+#include "vtkMemoryMappedImage.h"
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <climits>
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+
+
+vtkStandardNewMacro(vtkMemoryMappedImage);
+
+
+
+vtkMemoryMappedImage
+::vtkMemoryMappedImage()
+{
+  this->FileName = NULL;
+  this->Dimensions[0] = this->Dimensions[1] = this->Dimensions[2] = 0;
+  this->ScalarType = VTK_SHORT;
+  this->NumberOfScalarComponents = 1;
+  this->HeaderSize = 0;
+  this->Mapping = NULL;
+  this->MappingSize = 0;
+#ifdef _WIN32
+  this->FileHandle = INVALID_HANDLE_VALUE;
+  this->MappingHandle = NULL;
+#else
+  this->FileDescriptor = -1;
+#endif
+  this->Output = vtkImageData::New();
+  this->ReadaheadMutex = vtkMutexLock::New();
+}
+
+
+
+vtkMemoryMappedImage
+::~vtkMemoryMappedImage()
+{
+  this->Close();
+  this->Output->Delete();
+  this->ReadaheadMutex->Delete();
+  this->SetFileName( NULL );
+}
+
+
+
+void vtkMemoryMappedImage
+::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf( os, indent );
+
+  os << indent << "FileName: " << ( this->FileName ? this->FileName : "(none)" ) << std::endl;
+  os << indent << "Dimensions: " << this->Dimensions[0] << " " << this->Dimensions[1] << " "
+     << this->Dimensions[2] << std::endl;
+  os << indent << "ScalarType: " << this->ScalarType << std::endl;
+  os << indent << "NumberOfScalarComponents: " << this->NumberOfScalarComponents << std::endl;
+  os << indent << "HeaderSize: " << this->HeaderSize << std::endl;
+  os << indent << "MappedBytes: " << this->MappingSize << std::endl;
+}
+
+
+
+bool vtkMemoryMappedImage
+::Open()
+{
+  this->Close();
+
+  if ( this->FileName == NULL )
+  {
+    vtkErrorMacro( "No file name set." );
+    return false;
+  }
+
+  vtkSmartPointer< vtkDataArray > scalars;
+  scalars.TakeReference( vtkDataArray::CreateDataArray( this->ScalarType ) );
+  if ( scalars == NULL )
+  {
+    vtkErrorMacro( "Unsupported scalar type " << this->ScalarType );
+    return false;
+  }
+  vtkTypeInt64 numberOfValues = static_cast< vtkTypeInt64 >( this->Dimensions[0] ) * this->Dimensions[1]
+                                * this->Dimensions[2] * this->NumberOfScalarComponents;
+  vtkTypeInt64 size = this->HeaderSize + numberOfValues * scalars->GetDataTypeSize();
+  if ( numberOfValues <= 0 )
+  {
+    vtkErrorMacro( "Invalid dimensions." );
+    return false;
+  }
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA( this->FileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL );
+  if ( file == INVALID_HANDLE_VALUE )
+  {
+    vtkErrorMacro( "Cannot open " << this->FileName );
+    return false;
+  }
+  LARGE_INTEGER fileSize;
+  if ( ! GetFileSizeEx( file, &fileSize ) || fileSize.QuadPart < size )
+  {
+    vtkErrorMacro( this->FileName << " is smaller than the volume it should hold." );
+    CloseHandle( file );
+    return false;
+  }
+  HANDLE mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+  void* view = mapping ? MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 ) : NULL;
+  if ( view == NULL )
+  {
+    vtkErrorMacro( "Cannot map " << this->FileName );
+    if ( mapping )
+    {
+      CloseHandle( mapping );
+    }
+    CloseHandle( file );
+    return false;
+  }
+  this->FileHandle = file;
+  this->MappingHandle = mapping;
+#else
+  int fd = open( this->FileName, O_RDONLY );
+  if ( fd < 0 )
+  {
+    vtkErrorMacro( "Cannot open " << this->FileName );
+    return false;
+  }
+  struct stat fileStat;
+  if ( fstat( fd, &fileStat ) != 0 || fileStat.st_size < size )
+  {
+    vtkErrorMacro( this->FileName << " is smaller than the volume it should hold." );
+    close( fd );
+    return false;
+  }
+  void* view = mmap( NULL, static_cast< size_t >( size ), PROT_READ, MAP_SHARED, fd, 0 );
+  if ( view == MAP_FAILED )
+  {
+    vtkErrorMacro( "Cannot map " << this->FileName );
+    close( fd );
+    return false;
+  }
+  // Slices are sampled sparsely; the kernel's sequential readahead only wastes I/O.
+  madvise( view, static_cast< size_t >( size ), MADV_RANDOM );
+  this->FileDescriptor = fd;
+#endif
+
+  this->Mapping = view;
+  this->MappingSize = size;
+
+  // save = 1: VTK must never free or reallocate the mapped memory.
+  scalars->SetNumberOfComponents( this->NumberOfScalarComponents );
+  scalars->SetVoidArray( static_cast< char* >( view ) + this->HeaderSize,
+                         static_cast< vtkIdType >( numberOfValues ), 1 );
+
+  this->Output->Initialize();
+  this->Output->SetExtent( 0, this->Dimensions[0] - 1, 0, this->Dimensions[1] - 1, 0, this->Dimensions[2] - 1 );
+  this->Output->SetWholeExtent( 0, this->Dimensions[0] - 1, 0, this->Dimensions[1] - 1, 0, this->Dimensions[2] - 1 );
+  this->Output->SetScalarType( this->ScalarType );
+  this->Output->SetNumberOfScalarComponents( this->NumberOfScalarComponents );
+  this->Output->GetPointData()->SetScalars( scalars );
+  this->Output->Modified();
+
+  this->Modified();
+  return true;
+}
+
+
+
+void vtkMemoryMappedImage
+::Close()
+{
+  if ( this->Mapping == NULL )
+  {
+    return;
+  }
+
+  // Drop the scalars before the memory behind them goes away.
+  this->Output->Initialize();
+
+#ifdef _WIN32
+  UnmapViewOfFile( this->Mapping );
+  CloseHandle( this->MappingHandle );
+  CloseHandle( this->FileHandle );
+  this->MappingHandle = NULL;
+  this->FileHandle = INVALID_HANDLE_VALUE;
+#else
+  munmap( this->Mapping, static_cast< size_t >( this->MappingSize ) );
+  close( this->FileDescriptor );
+  this->FileDescriptor = -1;
+#endif
+
+  this->Mapping = NULL;
+  this->MappingSize = 0;
+  this->Modified();
+}
+
+
+
+bool vtkMemoryMappedImage
+::IsOpen()
+{
+  return this->Mapping != NULL;
+}
+
+
+
+vtkImageData* vtkMemoryMappedImage
+::GetOutput()
+{
+  return this->Output;
+}
+
+
+
+vtkTypeInt64 vtkMemoryMappedImage
+::GetMappedBytes()
+{
+  return this->MappingSize;
+}
+
+
+
+void vtkMemoryMappedImage
+::Readahead( vtkMatrix4x4* xyToIJK, int width, int height )
+{
+#ifdef _WIN32
+  (void)xyToIJK;
+  (void)width;
+  (void)height;
+#else
+  if ( this->Mapping == NULL || xyToIJK == NULL || width <= 0 || height <= 0 )
+  {
+    return;
+  }
+
+  this->ReadaheadMutex->Lock();
+  const int nx = this->Dimensions[0];
+  const int ny = this->Dimensions[1];
+  const int nz = this->Dimensions[2];
+  this->RowRanges.resize( 2 * nz );
+  for ( int z = 0; z < nz; ++ z )
+  {
+    this->RowRanges[ 2 * z ] = INT_MAX;
+    this->RowRanges[ 2 * z + 1 ] = -1;
+  }
+
+  // Sample the plane on a coarse grid and collect, per z slice, the rows
+  // the interpolation kernel may read, with a margin for the grid gaps.
+  const int steps = 64;
+  const int margin = 2;
+  for ( int sj = 0; sj <= steps; ++ sj )
+  {
+    double j = static_cast< double >( height - 1 ) * sj / steps;
+    for ( int si = 0; si <= steps; ++ si )
+    {
+      double i = static_cast< double >( width - 1 ) * si / steps;
+      double y = xyToIJK->Element[1][0] * i + xyToIJK->Element[1][1] * j + xyToIJK->Element[1][3];
+      double z = xyToIJK->Element[2][0] * i + xyToIJK->Element[2][1] * j + xyToIJK->Element[2][3];
+      int y0 = vtkMath::Floor( y ) - margin;
+      int y1 = vtkMath::Floor( y ) + 1 + margin;
+      int z0 = vtkMath::Floor( z ) - 1;
+      int z1 = vtkMath::Floor( z ) + 2;
+      if ( y1 < 0 || y0 >= ny || z1 < 0 || z0 >= nz )
+      {
+        continue;
+      }
+      y0 = y0 < 0 ? 0 : y0;
+      y1 = y1 >= ny ? ny - 1 : y1;
+      z0 = z0 < 0 ? 0 : z0;
+      z1 = z1 >= nz ? nz - 1 : z1;
+      for ( int zz = z0; zz <= z1; ++ zz )
+      {
+        int* range = &this->RowRanges[ 2 * zz ];
+        range[0] = y0 < range[0] ? y0 : range[0];
+        range[1] = y1 > range[1] ? y1 : range[1];
+      }
+    }
+  }
+
+  vtkTypeInt64 voxelBytes = ( this->MappingSize - this->HeaderSize ) / ( static_cast< vtkTypeInt64 >( nx ) * ny * nz );
+  vtkTypeInt64 rowBytes = voxelBytes * nx;
+  vtkTypeInt64 pageSize = sysconf( _SC_PAGESIZE );
+  char* base = static_cast< char* >( this->Mapping );
+  for ( int z = 0; z < nz; ++ z )
+  {
+    const int* range = &this->RowRanges[ 2 * z ];
+    if ( range[1] < range[0] )
+    {
+      continue;
+    }
+    vtkTypeInt64 begin = this->HeaderSize + ( static_cast< vtkTypeInt64 >( z ) * ny + range[0] ) * rowBytes;
+    vtkTypeInt64 end = begin + ( range[1] - range[0] + 1 ) * rowBytes;
+    begin -= begin % pageSize;
+    madvise( base + begin, static_cast< size_t >( end - begin ), MADV_WILLNEED );
+  }
+  this->ReadaheadMutex->Unlock();
+#endif
+}
+
+
+
+vtkTypeInt64 vtkMemoryMappedImage
+::GetResidentBytes()
+{
+#ifdef _WIN32
+  return -1;
+#else
+  if ( this->Mapping == NULL )
+  {
+    return 0;
+  }
+
+  vtkTypeInt64 pageSize = sysconf( _SC_PAGESIZE );
+  size_t pages = static_cast< size_t >( ( this->MappingSize + pageSize - 1 ) / pageSize );
+# ifdef __APPLE__
+  std::vector< char > residency( pages );
+# else
+  std::vector< unsigned char > residency( pages );
+# endif
+  if ( mincore( this->Mapping, static_cast< size_t >( this->MappingSize ), &residency[ 0 ] ) != 0 )
+  {
+    return -1;
+  }
+
+  vtkTypeInt64 resident = 0;
+  for ( size_t i = 0; i < pages; ++ i )
+  {
+    if ( residency[ i ] & 1 )
+    {
+      resident += pageSize;
+    }
+  }
+  return resident;
+#endif
+}
@@ -0,0 +1,115 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkMemoryMappedImage - raw volume file mapped into memory
+// .SECTION Description
+// Maps a raw volume file (x fastest, then y, then z, after an optional
+// header) read-only into the address space and exposes it as a
+// vtkImageData whose scalars point into the mapping. Nothing is read up
+// front: the operating system pages in only the voxels that are sampled,
+// so volumes larger than physical memory can be resliced. The scalars
+// must not be modified.
+
+
+#ifndef __vtkMemoryMappedImage_h
+#define __vtkMemoryMappedImage_h
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerVolumeResliceDriverModuleLogicExport.h"
+
+class vtkImageData;
+class vtkMatrix4x4;
+class vtkMutexLock;
+
+
+/// \ingroup Slicer_QtModules_VolumeResliceDriver
+class VTK_SLICER_VOLUMERESLICEDRIVER_MODULE_LOGIC_EXPORT vtkMemoryMappedImage
+  : public vtkObject
+{
+public:
+
+  static vtkMemoryMappedImage *New();
+  vtkTypeMacro(vtkMemoryMappedImage,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// File layout, applied at Open().
+  vtkSetStringMacro( FileName );
+  vtkGetStringMacro( FileName );
+  vtkSetVector3Macro( Dimensions, int );
+  vtkGetVector3Macro( Dimensions, int );
+  vtkSetMacro( ScalarType, int );
+  vtkGetMacro( ScalarType, int );
+  vtkSetMacro( NumberOfScalarComponents, int );
+  vtkGetMacro( NumberOfScalarComponents, int );
+  vtkSetMacro( HeaderSize, vtkTypeInt64 );
+  vtkGetMacro( HeaderSize, vtkTypeInt64 );
+
+  bool Open();
+  void Close();
+  bool IsOpen();
+
+  /// Image whose scalars live in the mapping; empty while closed.
+  vtkImageData* GetOutput();
+
+  /// Ask the OS to start reading the voxels a plane will sample.
+  /// xyToIJK maps output pixel (i, j, 0, 1) to voxel indices. Reslicers
+  /// of several slices may call it from their own threads.
+  void Readahead( vtkMatrix4x4* xyToIJK, int width, int height );
+
+  vtkTypeInt64 GetMappedBytes();
+  /// Bytes of the mapping currently in physical memory; -1 if unknown.
+  vtkTypeInt64 GetResidentBytes();
+
+
+protected:
+
+  vtkMemoryMappedImage();
+  virtual ~vtkMemoryMappedImage();
+
+  char* FileName;
+  int Dimensions[3];
+  int ScalarType;
+  int NumberOfScalarComponents;
+  vtkTypeInt64 HeaderSize;
+
+  void* Mapping;
+  vtkTypeInt64 MappingSize;
+#ifdef _WIN32
+  void* FileHandle;
+  void* MappingHandle;
+#else
+  int FileDescriptor;
+#endif
+
+  vtkImageData* Output;
+
+  /// Per z slice, the range of y rows a plane touches (scratch for Readahead).
+  std::vector< int > RowRanges;
+  vtkMutexLock* ReadaheadMutex;
+
+private:
+
+  vtkMemoryMappedImage(const vtkMemoryMappedImage&); // Not implemented
+  void operator=(const vtkMemoryMappedImage&);       // Not implemented
+};
+
+#endif
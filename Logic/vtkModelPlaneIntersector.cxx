@@ -0,0 +1,456 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VolumeResliceDriver includes
+#include "vtkModelPlaneIntersector.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+
+
+
+vtkStandardNewMacro(vtkModelPlaneIntersector);
+
+
+
+namespace
+{
+
+/// Orders triangle indices by one coordinate of their centroids.
+struct CentroidLess
+{
+  const double* Centroids;
+  int Axis;
+  bool operator()( int a, int b ) const
+  {
+    return Centroids[ 3 * a + Axis ] < Centroids[ 3 * b + Axis ];
+  }
+};
+
+
+inline double PlaneDistance( const double* p, const double origin[3], const double normal[3] )
+{
+  return   normal[0] * ( p[0] - origin[0] )
+         + normal[1] * ( p[1] - origin[1] )
+         + normal[2] * ( p[2] - origin[2] );
+}
+
+} // namespace
+
+
+
+vtkModelPlaneIntersector
+::vtkModelPlaneIntersector()
+{
+  this->UseIndex = true;
+  this->IndexMTime = 0;
+  this->NumberOfTriangles = 0;
+  this->NumberOfIndexBuilds = 0;
+  this->NumberOfTestedTriangles = 0;
+  this->NumberOfCutTriangles = 0;
+}
+
+
+
+vtkModelPlaneIntersector
+::~vtkModelPlaneIntersector()
+{
+}
+
+
+
+void vtkModelPlaneIntersector
+::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf( os, indent );
+
+  os << indent << "Input: " << this->Input.GetPointer() << std::endl;
+  os << indent << "UseIndex: " << ( this->UseIndex ? "On" : "Off" ) << std::endl;
+  os << indent << "NumberOfTriangles: " << this->NumberOfTriangles << std::endl;
+  os << indent << "NumberOfNodes: " << this->Nodes.size() << std::endl;
+  os << indent << "NumberOfIndexBuilds: " << this->NumberOfIndexBuilds << std::endl;
+  os << indent << "NumberOfTestedTriangles: " << this->NumberOfTestedTriangles << std::endl;
+  os << indent << "NumberOfCutTriangles: " << this->NumberOfCutTriangles << std::endl;
+}
+
+
+
+void vtkModelPlaneIntersector
+::SetInput( vtkPolyData* mesh )
+{
+  if ( mesh == this->Input )
+  {
+    return;
+  }
+  this->Input = mesh;
+  this->IndexMTime = 0;
+  this->Modified();
+}
+
+
+
+vtkPolyData* vtkModelPlaneIntersector
+::GetInput()
+{
+  return this->Input;
+}
+
+
+
+void vtkModelPlaneIntersector
+::UpdateIndex()
+{
+  if ( this->Input == NULL )
+  {
+    if ( ! this->Nodes.empty() || ! this->Triangles.empty() )
+    {
+      std::vector< double >().swap( this->Points );
+      std::vector< vtkIdType >().swap( this->Triangles );
+      std::vector< int >().swap( this->TriangleOrder );
+      std::vector< Node >().swap( this->Nodes );
+      this->NumberOfTriangles = 0;
+    }
+    return;
+  }
+  if ( this->Input->GetMTime() != this->IndexMTime )
+  {
+    this->BuildIndex();
+    this->IndexMTime = this->Input->GetMTime();
+  }
+}
+
+
+
+void vtkModelPlaneIntersector
+::BuildIndex()
+{
+  vtkPolyData* mesh = this->Input;
+  vtkIdType numberOfPoints = mesh->GetNumberOfPoints();
+  this->Points.resize( 3 * numberOfPoints );
+  for ( vtkIdType i = 0; i < numberOfPoints; ++ i )
+  {
+    mesh->GetPoint( i, &this->Points[ 3 * i ] );
+  }
+
+  this->Triangles.clear();
+  vtkCellArray* polys = mesh->GetPolys();
+  vtkIdType numberOfCellPoints = 0;
+  vtkIdType* cellPoints = NULL;
+  polys->InitTraversal();
+  while ( polys->GetNextCell( numberOfCellPoints, cellPoints ) )
+  {
+    for ( vtkIdType k = 1; k + 1 < numberOfCellPoints; ++ k )
+    {
+      this->Triangles.push_back( cellPoints[0] );
+      this->Triangles.push_back( cellPoints[ k ] );
+      this->Triangles.push_back( cellPoints[ k + 1 ] );
+    }
+  }
+  int numberOfTriangles = static_cast< int >( this->Triangles.size() / 3 );
+  this->NumberOfTriangles = numberOfTriangles;
+
+  this->Centroids.resize( 3 * numberOfTriangles );
+  this->TriangleOrder.resize( numberOfTriangles );
+  for ( int t = 0; t < numberOfTriangles; ++ t )
+  {
+    this->TriangleOrder[ t ] = t;
+    for ( int k = 0; k < 3; ++ k )
+    {
+      this->Centroids[ 3 * t + k ] = (   this->Points[ 3 * this->Triangles[ 3 * t ] + k ]
+                                       + this->Points[ 3 * this->Triangles[ 3 * t + 1 ] + k ]
+                                       + this->Points[ 3 * this->Triangles[ 3 * t + 2 ] + k ] ) / 3.0;
+    }
+  }
+
+  this->Nodes.clear();
+  if ( numberOfTriangles > 0 )
+  {
+    this->Nodes.reserve( 4 * ( numberOfTriangles / LEAF_SIZE + 1 ) );
+    this->Nodes.resize( 1 );
+    this->BuildNode( 0, 0, numberOfTriangles );
+  }
+  std::vector< double >().swap( this->Centroids );
+  ++ this->NumberOfIndexBuilds;
+}
+
+
+
+void vtkModelPlaneIntersector
+::BuildNode( int node, int first, int count )
+{
+  // Box of the triangles, and extent of their centroids for the split.
+  double bounds[6] = { VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX, VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX,
+                       VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX };
+  double centroidBounds[6] = { VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX, VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX,
+                               VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX };
+  for ( int i = first; i < first + count; ++ i )
+  {
+    int t = this->TriangleOrder[ i ];
+    for ( int v = 0; v < 3; ++ v )
+    {
+      const double* p = &this->Points[ 3 * this->Triangles[ 3 * t + v ] ];
+      for ( int k = 0; k < 3; ++ k )
+      {
+        bounds[ 2 * k ] = std::min( bounds[ 2 * k ], p[ k ] );
+        bounds[ 2 * k + 1 ] = std::max( bounds[ 2 * k + 1 ], p[ k ] );
+      }
+    }
+    for ( int k = 0; k < 3; ++ k )
+    {
+      centroidBounds[ 2 * k ] = std::min( centroidBounds[ 2 * k ], this->Centroids[ 3 * t + k ] );
+      centroidBounds[ 2 * k + 1 ] = std::max( centroidBounds[ 2 * k + 1 ], this->Centroids[ 3 * t + k ] );
+    }
+  }
+  for ( int k = 0; k < 3; ++ k )
+  {
+    this->Nodes[ node ].Center[ k ] = ( bounds[ 2 * k ] + bounds[ 2 * k + 1 ] ) / 2.0;
+    this->Nodes[ node ].HalfSize[ k ] = ( bounds[ 2 * k + 1 ] - bounds[ 2 * k ] ) / 2.0;
+  }
+
+  if ( count <= LEAF_SIZE )
+  {
+    this->Nodes[ node ].First = first;
+    this->Nodes[ node ].Count = count;
+    return;
+  }
+
+  CentroidLess less;
+  less.Centroids = &this->Centroids[0];
+  less.Axis = 0;
+  for ( int k = 1; k < 3; ++ k )
+  {
+    if (   centroidBounds[ 2 * k + 1 ] - centroidBounds[ 2 * k ]
+         > centroidBounds[ 2 * less.Axis + 1 ] - centroidBounds[ 2 * less.Axis ] )
+    {
+      less.Axis = k;
+    }
+  }
+  int half = count / 2;
+  std::nth_element( this->TriangleOrder.begin() + first, this->TriangleOrder.begin() + first + half,
+                    this->TriangleOrder.begin() + first + count, less );
+
+  int children = static_cast< int >( this->Nodes.size() );
+  this->Nodes.resize( children + 2 );
+  this->Nodes[ node ].First = children;
+  this->Nodes[ node ].Count = 0;
+  this->BuildNode( children, first, half );
+  this->BuildNode( children + 1, first + half, count - half );
+}
+
+
+
+void vtkModelPlaneIntersector
+::CutTriangle( vtkIdType t, const double origin[3], const double normal[3] )
+{
+  const vtkIdType* ids = &this->Triangles[ 3 * t ];
+  double distances[3];
+  int below = 0;
+  for ( int v = 0; v < 3; ++ v )
+  {
+    distances[ v ] = PlaneDistance( &this->Points[ 3 * ids[ v ] ], origin, normal );
+    below += ( distances[ v ] < 0.0 ) ? 1 : 0;
+  }
+  if ( below == 0 || below == 3 )
+  {
+    return;
+  }
+  ++ this->NumberOfCutTriangles;
+
+  // Two of the edges have one end below; each gives an end of the segment.
+  vtkTypeUInt64 numberOfPoints = this->Points.size() / 3;
+  int end = static_cast< int >( this->SegmentEnds.size() );
+  for ( int v = 0; v < 3; ++ v )
+  {
+    int w = ( v + 1 ) % 3;
+    if ( ( distances[ v ] < 0.0 ) == ( distances[ w ] < 0.0 ) )
+    {
+      continue;
+    }
+    // Computed from the smaller id, so both triangles of the edge agree.
+    int a = ( ids[ v ] < ids[ w ] ) ? v : w;
+    int b = ( a == v ) ? w : v;
+    double f = distances[ a ] / ( distances[ a ] - distances[ b ] );
+    const double* pa = &this->Points[ 3 * ids[ a ] ];
+    const double* pb = &this->Points[ 3 * ids[ b ] ];
+    for ( int k = 0; k < 3; ++ k )
+    {
+      this->EndPoints.push_back( pa[ k ] + f * ( pb[ k ] - pa[ k ] ) );
+    }
+    vtkTypeUInt64 key = static_cast< vtkTypeUInt64 >( ids[ a ] ) * numberOfPoints + ids[ b ];
+    this->SegmentEnds.push_back( std::make_pair( key, end ++ ) );
+  }
+}
+
+
+
+int vtkModelPlaneIntersector
+::Intersect( const double origin[3], const double normal[3], vtkMatrix4x4* meshToOutput,
+             vtkPolyData* output )
+{
+  this->UpdateIndex();
+  this->SegmentEnds.clear();
+  this->EndPoints.clear();
+  this->NumberOfTestedTriangles = 0;
+  this->NumberOfCutTriangles = 0;
+
+  if ( ! this->UseIndex )
+  {
+    for ( vtkIdType t = 0; t < this->NumberOfTriangles; ++ t )
+    {
+      this->CutTriangle( t, origin, normal );
+    }
+    this->NumberOfTestedTriangles = this->NumberOfTriangles;
+  }
+  else if ( ! this->Nodes.empty() )
+  {
+    // A box straddles the plane if its center is closer to it than the
+    // projection of its half size on the normal.
+    this->NodeStack.clear();
+    this->NodeStack.push_back( 0 );
+    while ( ! this->NodeStack.empty() )
+    {
+      const Node& node = this->Nodes[ this->NodeStack.back() ];
+      this->NodeStack.pop_back();
+      double distance = PlaneDistance( node.Center, origin, normal );
+      double reach =   fabs( normal[0] ) * node.HalfSize[0]
+                     + fabs( normal[1] ) * node.HalfSize[1]
+                     + fabs( normal[2] ) * node.HalfSize[2];
+      if ( fabs( distance ) > reach )
+      {
+        continue;
+      }
+      if ( node.Count == 0 )
+      {
+        this->NodeStack.push_back( node.First );
+        this->NodeStack.push_back( node.First + 1 );
+        continue;
+      }
+      for ( int i = node.First; i < node.First + node.Count; ++ i )
+      {
+        this->CutTriangle( this->TriangleOrder[ i ], origin, normal );
+      }
+      this->NumberOfTestedTriangles += node.Count;
+    }
+  }
+
+  this->LinkSegments( meshToOutput, output );
+  return output->GetNumberOfCells();
+}
+
+
+
+void vtkModelPlaneIntersector
+::LinkSegments( vtkMatrix4x4* meshToOutput, vtkPolyData* output )
+{
+  vtkPoints* points = output->GetPoints();
+  if ( points == NULL )
+  {
+    vtkSmartPointer< vtkPoints > newPoints = vtkSmartPointer< vtkPoints >::New();
+    output->SetPoints( newPoints );
+    points = newPoints;
+  }
+  points->Reset();
+  vtkSmartPointer< vtkCellArray > lines = vtkSmartPointer< vtkCellArray >::New();
+
+  // One point per cut edge; segment ends of the same edge share it.
+  int numberOfEnds = static_cast< int >( this->SegmentEnds.size() );
+  this->EndPointIds.resize( numberOfEnds );
+  std::sort( this->SegmentEnds.begin(), this->SegmentEnds.end() );
+  int numberOfPoints = 0;
+  for ( int i = 0; i < numberOfEnds; ++ i )
+  {
+    if ( i == 0 || this->SegmentEnds[ i ].first != this->SegmentEnds[ i - 1 ].first )
+    {
+      double p[4] = { 0.0, 0.0, 0.0, 1.0 };
+      std::copy( &this->EndPoints[ 3 * this->SegmentEnds[ i ].second ],
+                 &this->EndPoints[ 3 * this->SegmentEnds[ i ].second ] + 3, p );
+      if ( meshToOutput != NULL )
+      {
+        meshToOutput->MultiplyPoint( p, p );
+      }
+      points->InsertNextPoint( p[0], p[1], p[2] );
+      ++ numberOfPoints;
+    }
+    this->EndPointIds[ this->SegmentEnds[ i ].second ] = numberOfPoints - 1;
+  }
+
+  this->PointEnds.assign( numberOfPoints, -1 );
+  this->NextEnd.resize( numberOfEnds );
+  for ( int end = 0; end < numberOfEnds; ++ end )
+  {
+    int point = this->EndPointIds[ end ];
+    this->NextEnd[ end ] = this->PointEnds[ point ];
+    this->PointEnds[ point ] = end;
+  }
+  int numberOfSegments = numberOfEnds / 2;
+  this->SegmentUsed.assign( numberOfSegments, 0 );
+
+  // Open polylines start at points with one segment, on the boundary of
+  // an open mesh; the second pass collects the closed loops.
+  for ( int pass = 0; pass < 2; ++ pass )
+  {
+    for ( int start = 0; start < numberOfEnds; ++ start )
+    {
+      if ( this->SegmentUsed[ start / 2 ] )
+      {
+        continue;
+      }
+      int startPoint = this->EndPointIds[ start ];
+      if ( pass == 0 && this->NextEnd[ this->PointEnds[ startPoint ] ] >= 0 )
+      {
+        continue;
+      }
+
+      this->Polyline.clear();
+      this->Polyline.push_back( startPoint );
+      int end = start;
+      for ( ;; )
+      {
+        this->SegmentUsed[ end / 2 ] = 1;
+        int point = this->EndPointIds[ end ^ 1 ];
+        this->Polyline.push_back( point );
+        end = this->PointEnds[ point ];
+        while ( end >= 0 && this->SegmentUsed[ end / 2 ] )
+        {
+          end = this->NextEnd[ end ];
+        }
+        if ( end < 0 )
+        {
+          break;
+        }
+      }
+
+      lines->InsertNextCell( static_cast< int >( this->Polyline.size() ) );
+      for ( size_t i = 0; i < this->Polyline.size(); ++ i )
+      {
+        lines->InsertCellPoint( this->Polyline[ i ] );
+      }
+    }
+  }
+
+  points->Modified();
+  output->SetLines( lines );
+  output->Modified();
+}
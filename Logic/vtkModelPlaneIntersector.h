@@ -0,0 +1,152 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkModelPlaneIntersector - indexed cuts of a surface mesh by planes
+// .SECTION Description
+// Intersects the triangles of a surface mesh with a plane and links the
+// cut segments into polylines. A bounding volume hierarchy over the
+// triangles, built on the first cut and again only when the mesh is
+// modified, limits the triangles tested to those whose boxes straddle
+// the plane; nodes are split at the median of the longest axis down to
+// leaves of a few triangles. Polygons are fanned into triangles, other
+// cells are ignored.
+//
+// Vertices on the plane count as above it, so every cut point lies on a
+// mesh edge with one end below the plane. Cut points are shared by the
+// triangles of the edge, which links the segments: closed surfaces give
+// closed polylines, ending on their first point, and open ones may give
+// open polylines too.
+//
+// Cuts of one intersector are not thread safe: they share its scratch
+// buffers and may rebuild the hierarchy.
+
+
+#ifndef __vtkModelPlaneIntersector_h
+#define __vtkModelPlaneIntersector_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <utility>
+#include <vector>
+
+#include "vtkSlicerVolumeResliceDriverModuleLogicExport.h"
+
+class vtkMatrix4x4;
+class vtkPolyData;
+
+
+/// \ingroup Slicer_QtModules_VolumeResliceDriver
+class VTK_SLICER_VOLUMERESLICEDRIVER_MODULE_LOGIC_EXPORT vtkModelPlaneIntersector
+  : public vtkObject
+{
+public:
+
+  static vtkModelPlaneIntersector *New();
+  vtkTypeMacro(vtkModelPlaneIntersector,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Surface mesh to cut.
+  void SetInput( vtkPolyData* mesh );
+  vtkPolyData* GetInput();
+
+  /// Test the triangles through the hierarchy (the default), or test
+  /// them all, as a plain cutter does.
+  vtkSetMacro( UseIndex, bool );
+  vtkGetMacro( UseIndex, bool );
+  vtkBooleanMacro( UseIndex, bool );
+
+  /// Cut the mesh by the plane through origin with normal, both in mesh
+  /// coordinates, into output: one line cell per polyline. Points are
+  /// mapped through meshToOutput if not NULL. Returns the number of
+  /// polylines.
+  int Intersect( const double origin[3], const double normal[3], vtkMatrix4x4* meshToOutput,
+                 vtkPolyData* output );
+
+  /// Builds the hierarchy now if the mesh changed since it was built.
+  void UpdateIndex();
+
+  vtkGetMacro( NumberOfTriangles, vtkIdType );
+  vtkGetMacro( NumberOfIndexBuilds, int );
+  /// Triangles tested and cut by the last Intersect().
+  vtkGetMacro( NumberOfTestedTriangles, vtkIdType );
+  vtkGetMacro( NumberOfCutTriangles, vtkIdType );
+
+
+protected:
+
+  vtkModelPlaneIntersector();
+  virtual ~vtkModelPlaneIntersector();
+
+  enum { LEAF_SIZE = 8 };
+
+  struct Node
+  {
+    double Center[3];
+    double HalfSize[3];
+    /// Leaves: Count triangles from First in TriangleOrder. Inner nodes:
+    /// Count is 0 and the children are nodes First and First + 1.
+    int First;
+    int Count;
+  };
+
+  void BuildIndex();
+  void BuildNode( int node, int first, int count );
+  /// Adds the cut of triangle t, if any, to the segments.
+  void CutTriangle( vtkIdType t, const double origin[3], const double normal[3] );
+  void LinkSegments( vtkMatrix4x4* meshToOutput, vtkPolyData* output );
+
+  vtkSmartPointer< vtkPolyData > Input;
+  bool UseIndex;
+  unsigned long IndexMTime;
+
+  /// Mesh copied at build time: point coordinates and point ids, three
+  /// per triangle.
+  std::vector< double > Points;
+  std::vector< vtkIdType > Triangles;
+  /// Triangle centroids, while building.
+  std::vector< double > Centroids;
+  std::vector< int > TriangleOrder;
+  std::vector< Node > Nodes;
+
+  /// Scratch of Intersect(): cut segments as pairs of mesh edges, each
+  /// edge key ( smaller id * number of points + larger id ), and the cut
+  /// point of each end.
+  std::vector< std::pair< vtkTypeUInt64, int > > SegmentEnds;
+  std::vector< double > EndPoints;
+  std::vector< int > NodeStack;
+  std::vector< int > EndPointIds;
+  /// Segment ends at each cut point, heads in PointEnds, links in NextEnd.
+  std::vector< int > PointEnds;
+  std::vector< int > NextEnd;
+  std::vector< char > SegmentUsed;
+  std::vector< int > Polyline;
+
+  vtkIdType NumberOfTriangles;
+  int NumberOfIndexBuilds;
+  vtkIdType NumberOfTestedTriangles;
+  vtkIdType NumberOfCutTriangles;
+
+private:
+
+  vtkModelPlaneIntersector(const vtkModelPlaneIntersector&); // Not implemented
+  void operator=(const vtkModelPlaneIntersector&);           // Not implemented
+};
+
+#endif
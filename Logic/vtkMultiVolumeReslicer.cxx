@@ -0,0 +1,398 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VolumeResliceDriver includes
+#include "vtkMultiVolumeReslicer.h"
+#include "vtkResliceTaskScheduler.h"
+#include "vtkSliceImageReslicer.h"
+#include "vtkSliceImageSampling.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <algorithm>
+
+
+
+vtkStandardNewMacro(vtkMultiVolumeReslicer);
+
+
+
+vtkMultiVolumeReslicer
+::vtkMultiVolumeReslicer()
+{
+  this->NumberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  this->OutputSize[0] = 0;
+  this->OutputSize[1] = 0;
+  this->XYToRAS = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->Threader = vtkSmartPointer< vtkMultiThreader >::New();
+  this->NumberOfAllocatedOutputs = 0;
+  this->NumberOfResampledPixels = 0;
+}
+
+
+
+vtkMultiVolumeReslicer
+::~vtkMultiVolumeReslicer()
+{
+}
+
+
+
+void vtkMultiVolumeReslicer
+::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf( os, indent );
+
+  os << indent << "NumberOfLayers: " << this->Layers.size() << std::endl;
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << std::endl;
+  os << indent << "OutputSize: " << this->OutputSize[0] << " " << this->OutputSize[1] << std::endl;
+  os << indent << "NumberOfSpareOutputs: " << this->SpareOutputs.size() << std::endl;
+  os << indent << "NumberOfAllocatedOutputs: " << this->NumberOfAllocatedOutputs << std::endl;
+  os << indent << "NumberOfResampledPixels: " << this->NumberOfResampledPixels << std::endl;
+}
+
+
+
+void vtkMultiVolumeReslicer
+::SetNumberOfLayers( int numberOfLayers )
+{
+  if ( numberOfLayers < 0 || numberOfLayers == static_cast< int >( this->Layers.size() ) )
+  {
+    return;
+  }
+  for ( unsigned int i = numberOfLayers; i < this->Layers.size(); ++ i )
+  {
+    this->ReleaseOutput( this->Layers[ i ] );
+  }
+
+  Layer empty;
+  empty.InterpolationMode = vtkSliceImageReslicer::INTERPOLATION_LINEAR;
+  empty.ScalarType = VTK_VOID;
+  empty.NumberOfComponents = 0;
+  empty.InputPointer = NULL;
+  empty.OutputPointer = NULL;
+  this->Layers.resize( numberOfLayers, empty );
+  this->Modified();
+}
+
+
+
+int vtkMultiVolumeReslicer
+::GetNumberOfLayers()
+{
+  return static_cast< int >( this->Layers.size() );
+}
+
+
+
+void vtkMultiVolumeReslicer
+::SetLayer( int layer, vtkImageData* image, vtkMatrix4x4* rasToIJK, int interpolationMode )
+{
+  if ( layer < 0 || layer >= static_cast< int >( this->Layers.size() ) )
+  {
+    vtkErrorMacro( "SetLayer: no layer " << layer );
+    return;
+  }
+  Layer& target = this->Layers[ layer ];
+  target.Input = image;
+  if ( target.RASToIJK == NULL )
+  {
+    target.RASToIJK = vtkSmartPointer< vtkMatrix4x4 >::New();
+  }
+  if ( rasToIJK != NULL )
+  {
+    target.RASToIJK->DeepCopy( rasToIJK );
+  }
+  target.InterpolationMode = interpolationMode;
+  this->Modified();
+}
+
+
+
+vtkImageData* vtkMultiVolumeReslicer
+::GetLayerInput( int layer )
+{
+  if ( layer < 0 || layer >= static_cast< int >( this->Layers.size() ) )
+  {
+    return NULL;
+  }
+  return this->Layers[ layer ].Input;
+}
+
+
+
+void vtkMultiVolumeReslicer
+::SetSliceGeometry( vtkMatrix4x4* xyToRAS, int width, int height )
+{
+  if ( xyToRAS != NULL )
+  {
+    this->XYToRAS->DeepCopy( xyToRAS );
+  }
+  this->OutputSize[0] = width;
+  this->OutputSize[1] = height;
+  this->Modified();
+}
+
+
+
+vtkImageData* vtkMultiVolumeReslicer
+::GetOutput( int layer )
+{
+  if (    layer < 0
+       || layer >= static_cast< int >( this->Layers.size() )
+       || this->Layers[ layer ].Input == NULL )
+  {
+    return NULL;
+  }
+  return this->Layers[ layer ].Output;
+}
+
+
+
+void vtkMultiVolumeReslicer
+::ReleaseOutput( Layer& layer )
+{
+  if ( layer.Output != NULL )
+  {
+    this->SpareOutputs.push_back( layer.Output );
+    layer.Output = NULL;
+  }
+}
+
+
+
+void vtkMultiVolumeReslicer
+::AcquireOutput( Layer& layer )
+{
+  int scalarType = layer.Input->GetScalarType();
+  int numberOfComponents = layer.Input->GetNumberOfScalarComponents();
+  int w = this->OutputSize[0];
+  int h = this->OutputSize[1];
+
+  vtkImageData* output = layer.Output;
+  if ( output != NULL )
+  {
+    int* dims = output->GetDimensions();
+    if (    dims[0] == w && dims[1] == h
+         && output->GetScalarType() == scalarType
+         && output->GetNumberOfScalarComponents() == numberOfComponents )
+    {
+      return;
+    }
+    this->ReleaseOutput( layer );
+  }
+
+  for ( unsigned int i = 0; i < this->SpareOutputs.size(); ++ i )
+  {
+    vtkImageData* spare = this->SpareOutputs[ i ];
+    int* dims = spare->GetDimensions();
+    if (    dims[0] == w && dims[1] == h
+         && spare->GetScalarType() == scalarType
+         && spare->GetNumberOfScalarComponents() == numberOfComponents )
+    {
+      layer.Output = spare;
+      this->SpareOutputs.erase( this->SpareOutputs.begin() + i );
+      return;
+    }
+  }
+
+  layer.Output = vtkSmartPointer< vtkImageData >::New();
+  layer.Output->SetExtent( 0, w - 1, 0, h - 1, 0, 0 );
+  layer.Output->SetWholeExtent( 0, w - 1, 0, h - 1, 0, 0 );
+  layer.Output->SetSpacing( 1.0, 1.0, 1.0 );
+  layer.Output->SetOrigin( 0.0, 0.0, 0.0 );
+  layer.Output->SetScalarType( scalarType );
+  layer.Output->SetNumberOfScalarComponents( numberOfComponents );
+  layer.Output->AllocateScalars();
+  ++ this->NumberOfAllocatedOutputs;
+}
+
+
+
+void vtkMultiVolumeReslicer
+::SetScheduler( vtkResliceTaskScheduler* scheduler )
+{
+  this->Scheduler = scheduler;
+}
+
+
+
+vtkResliceTaskScheduler* vtkMultiVolumeReslicer
+::GetScheduler()
+{
+  return this->Scheduler;
+}
+
+
+
+void vtkMultiVolumeReslicer
+::Update()
+{
+  if ( this->BeginUpdate() > 0 )
+  {
+    if ( this->Scheduler != NULL )
+    {
+      this->AddTasks( this->Scheduler, 0 );
+      this->Scheduler->Run();
+    }
+    else
+    {
+      int numberOfThreads = std::min( this->NumberOfThreads, this->OutputSize[1] );
+      this->Threader->SetNumberOfThreads( numberOfThreads );
+      this->Threader->SetSingleMethod( vtkMultiVolumeReslicer::ResliceThread, this );
+      this->Threader->SingleMethodExecute();
+    }
+  }
+  this->EndUpdate();
+}
+
+
+
+int vtkMultiVolumeReslicer
+::BeginUpdate()
+{
+  this->ActiveLayers.clear();
+  if ( this->OutputSize[0] <= 0 || this->OutputSize[1] <= 0 )
+  {
+    return 0;
+  }
+
+  // Everything the threads need is read from VTK here, once per update.
+  for ( unsigned int i = 0; i < this->Layers.size(); ++ i )
+  {
+    Layer& layer = this->Layers[ i ];
+    if ( layer.Input == NULL || layer.Input->GetScalarPointer() == NULL )
+    {
+      this->ReleaseOutput( layer );
+      continue;
+    }
+    this->AcquireOutput( layer );
+    layer.ScalarType = layer.Input->GetScalarType();
+    layer.NumberOfComponents = layer.Input->GetNumberOfScalarComponents();
+    layer.Input->GetDimensions( layer.Dimensions );
+    layer.Input->GetExtent( layer.Extent );
+    layer.InputPointer = layer.Input->GetScalarPointer();
+    layer.OutputPointer = layer.Output->GetScalarPointer();
+    for ( int k = 0; k < 3; ++ k )
+    {
+      layer.Step[ k ] = 0.0;
+      for ( int m = 0; m < 3; ++ m )
+      {
+        layer.Step[ k ] += layer.RASToIJK->Element[ k ][ m ] * this->XYToRAS->Element[ m ][ 0 ];
+      }
+    }
+    this->ActiveLayers.push_back( &layer );
+  }
+  return this->ActiveLayers.empty() ? 0 : this->OutputSize[1];
+}
+
+
+
+void vtkMultiVolumeReslicer
+::AddTasks( vtkResliceTaskScheduler* scheduler, int group )
+{
+  if ( this->ActiveLayers.empty() )
+  {
+    return;
+  }
+  // The layers of a row stay in one task, as in the single pass.
+  int rowPixels = std::max( 1, this->OutputSize[0] * static_cast< int >( this->ActiveLayers.size() ) );
+  int band = std::max( 1, scheduler->GetTaskPixels() / rowPixels );
+  for ( int j = 0; j < this->OutputSize[1]; j += band )
+  {
+    scheduler->AddTask( vtkMultiVolumeReslicer::ResliceBand, this, j, std::min( j + band, this->OutputSize[1] ),
+                        group );
+  }
+}
+
+
+
+void vtkMultiVolumeReslicer
+::EndUpdate()
+{
+  if ( this->ActiveLayers.empty() )
+  {
+    return;
+  }
+  for ( unsigned int i = 0; i < this->ActiveLayers.size(); ++ i )
+  {
+    this->ActiveLayers[ i ]->Output->Modified();
+  }
+  this->NumberOfResampledPixels += static_cast< unsigned long >( this->OutputSize[0] )
+                                   * this->OutputSize[1] * this->ActiveLayers.size();
+  this->ActiveLayers.clear();
+}
+
+
+
+VTK_THREAD_RETURN_TYPE vtkMultiVolumeReslicer
+::ResliceThread( void* arg )
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast< vtkMultiThreader::ThreadInfo* >( arg );
+  vtkMultiVolumeReslicer* self = static_cast< vtkMultiVolumeReslicer* >( info->UserData );
+
+  int h = self->OutputSize[1];
+  int rowMin = h * info->ThreadID / info->NumberOfThreads;
+  int rowMax = h * ( info->ThreadID + 1 ) / info->NumberOfThreads;
+  vtkMultiVolumeReslicer::ResliceBand( self, rowMin, rowMax );
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+
+
+void vtkMultiVolumeReslicer
+::ResliceBand( void* arg, int rowMin, int rowMax )
+{
+  vtkMultiVolumeReslicer* self = static_cast< vtkMultiVolumeReslicer* >( arg );
+  int w = self->OutputSize[0];
+  double ( *xyToRAS )[4] = self->XYToRAS->Element;
+  int numberOfLayers = static_cast< int >( self->ActiveLayers.size() );
+
+  for ( int j = rowMin; j < rowMax; ++ j )
+  {
+    // RAS position of the row, shared by the layers.
+    double ras[3];
+    for ( int k = 0; k < 3; ++ k )
+    {
+      ras[ k ] = xyToRAS[ k ][ 1 ] * j + xyToRAS[ k ][ 3 ];
+    }
+
+    for ( int l = 0; l < numberOfLayers; ++ l )
+    {
+      const Layer& layer = *self->ActiveLayers[ l ];
+      double ( *rasToIJK )[4] = layer.RASToIJK->Element;
+      double rowStart[3];
+      for ( int k = 0; k < 3; ++ k )
+      {
+        rowStart[ k ] = rasToIJK[ k ][ 0 ] * ras[0] + rasToIJK[ k ][ 1 ] * ras[1] + rasToIJK[ k ][ 2 ] * ras[2]
+                        + rasToIJK[ k ][ 3 ] - layer.Extent[ 2 * k ];
+      }
+      vtkIdType offset = static_cast< vtkIdType >( j ) * w * layer.NumberOfComponents;
+      switch ( layer.ScalarType )
+      {
+        vtkTemplateMacro( vtkSliceImageSampling::SampleRow( static_cast< const VTK_TT* >( layer.InputPointer ),
+                                                            layer.Dimensions, layer.NumberOfComponents,
+                                                            layer.InterpolationMode, rowStart, layer.Step, 0, w,
+                                                            static_cast< VTK_TT* >( layer.OutputPointer ) + offset ) );
+      }
+    }
+  }
+}
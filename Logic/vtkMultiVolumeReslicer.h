@@ -0,0 +1,151 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkMultiVolumeReslicer - resample co-registered volumes along one plane
+// .SECTION Description
+// Samples several volumes, such as the background, foreground and label
+// layers of a slice view, on the pixel grid of one slice node in a single
+// pass. The RAS position of each output row is computed once from XYToRAS
+// and mapped into every layer through the layer's own RASToIJK, and the
+// row is resampled for all layers before moving on. Threads split the rows,
+// or a task scheduler runs them in bands, as for vtkSliceImageReslicer.
+//
+// Each layer output keeps the scalar type and number of components of its
+// volume. Output buffers are pooled: a layer keeps its buffer while the
+// slice size and its volume type do not change, and otherwise takes a
+// spare buffer left by another layer before allocating a new one.
+
+
+#ifndef __vtkMultiVolumeReslicer_h
+#define __vtkMultiVolumeReslicer_h
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerVolumeResliceDriverModuleLogicExport.h"
+
+class vtkImageData;
+class vtkMatrix4x4;
+class vtkResliceTaskScheduler;
+
+
+/// \ingroup Slicer_QtModules_VolumeResliceDriver
+class VTK_SLICER_VOLUMERESLICEDRIVER_MODULE_LOGIC_EXPORT vtkMultiVolumeReslicer
+  : public vtkObject
+{
+public:
+
+  static vtkMultiVolumeReslicer *New();
+  vtkTypeMacro(vtkMultiVolumeReslicer,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Layers resampled by Update(); new layers have no volume.
+  void SetNumberOfLayers( int numberOfLayers );
+  int GetNumberOfLayers();
+
+  /// Volume of a layer, the matrix mapping RAS to its voxel indices and
+  /// vtkSliceImageReslicer::INTERPOLATION_*. A NULL image leaves the layer
+  /// out of the pass.
+  void SetLayer( int layer, vtkImageData* image, vtkMatrix4x4* rasToIJK, int interpolationMode );
+  vtkImageData* GetLayerInput( int layer );
+
+  vtkSetClampMacro( NumberOfThreads, int, 1, VTK_MAX_THREADS );
+  vtkGetMacro( NumberOfThreads, int );
+
+  /// Output plane: XYToRAS of the slice node and its size in pixels.
+  void SetSliceGeometry( vtkMatrix4x4* xyToRAS, int width, int height );
+
+  /// Scheduler running the rows of Update() instead of the reslicer's
+  /// threads; NumberOfThreads is then unused.
+  void SetScheduler( vtkResliceTaskScheduler* scheduler );
+  vtkResliceTaskScheduler* GetScheduler();
+
+  /// Resample all layers along the current plane.
+  void Update();
+
+  /// Update() in steps, as vtkSliceImageReslicer::BeginUpdate(): returns
+  /// the rows to resample, 0 if no layer has a volume. A task covers a
+  /// band of rows for all layers.
+  int BeginUpdate();
+  void AddTasks( vtkResliceTaskScheduler* scheduler, int group );
+  void EndUpdate();
+
+  /// Resampled image of a layer; NULL for a layer without volume.
+  vtkImageData* GetOutput( int layer );
+
+  /// Buffers allocated so far, spare ones included.
+  vtkGetMacro( NumberOfAllocatedOutputs, int );
+  /// Pixels resampled, summed over the layers.
+  vtkGetMacro( NumberOfResampledPixels, unsigned long );
+
+
+protected:
+
+  vtkMultiVolumeReslicer();
+  virtual ~vtkMultiVolumeReslicer();
+
+  struct Layer
+  {
+    vtkSmartPointer< vtkImageData > Input;
+    vtkSmartPointer< vtkMatrix4x4 > RASToIJK;
+    int InterpolationMode;
+    vtkSmartPointer< vtkImageData > Output;
+
+    // Set up by Update() for the threads.
+    int ScalarType;
+    int NumberOfComponents;
+    int Dimensions[3];
+    int Extent[6];
+    const void* InputPointer;
+    void* OutputPointer;
+    double Step[3];  // input index increment per output column
+  };
+
+  /// Gives the layer an output of the slice size and its volume type.
+  void AcquireOutput( Layer& layer );
+  void ReleaseOutput( Layer& layer );
+
+  static VTK_THREAD_RETURN_TYPE ResliceThread( void* arg );
+  /// Resamples rows [rowMin, rowMax) of all active layers.
+  static void ResliceBand( void* self, int rowMin, int rowMax );
+
+  std::vector< Layer > Layers;
+  std::vector< vtkSmartPointer< vtkImageData > > SpareOutputs;
+  /// Layers with a volume, for the threads.
+  std::vector< Layer* > ActiveLayers;
+
+  int NumberOfThreads;
+  int OutputSize[2];
+  vtkSmartPointer< vtkMatrix4x4 > XYToRAS;
+  vtkSmartPointer< vtkMultiThreader > Threader;
+  vtkSmartPointer< vtkResliceTaskScheduler > Scheduler;
+
+  int NumberOfAllocatedOutputs;
+  unsigned long NumberOfResampledPixels;
+
+private:
+
+  vtkMultiVolumeReslicer(const vtkMultiVolumeReslicer&); // Not implemented
+  void operator=(const vtkMultiVolumeReslicer&);         // Not implemented
+};
+
+#endif
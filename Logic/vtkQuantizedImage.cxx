@@ -0,0 +1,335 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VolumeResliceDriver includes
+#include "vtkQuantizedImage.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <algorithm>
+
+
+
+vtkStandardNewMacro(vtkQuantizedImage);
+
+
+
+namespace
+{
+
+template < class T >
+void ComputeRange( const T* in, vtkIdType count, double range[2] )
+{
+  double minimum = in[0];
+  double maximum = in[0];
+  for ( vtkIdType i = 1; i < count; ++ i )
+  {
+    double v = in[ i ];
+    if ( v < minimum )
+    {
+      minimum = v;
+    }
+    else if ( v > maximum )
+    {
+      maximum = v;
+    }
+  }
+  range[0] = minimum;
+  range[1] = maximum;
+}
+
+
+template < class T, class Q >
+void QuantizeScalars( const T* in, vtkIdType count, double shift, double scale, double maxCode, Q* out )
+{
+  double inverseScale = 1.0 / scale;
+  for ( vtkIdType i = 0; i < count; ++ i )
+  {
+    double c = ( in[ i ] - shift ) * inverseScale + 0.5;
+    if ( ! ( c > 0.0 ) )
+    {
+      out[ i ] = 0;
+    }
+    else if ( c >= maxCode )
+    {
+      out[ i ] = static_cast< Q >( maxCode );
+    }
+    else
+    {
+      out[ i ] = static_cast< Q >( c );
+    }
+  }
+}
+
+
+/// Codes up to maxCode, stored in codeSize bytes each.
+template < class T >
+void QuantizeImage( const T* in, vtkIdType count, double shift, double scale, double maxCode,
+                    int codeSize, void* out )
+{
+  if ( codeSize == 1 )
+  {
+    QuantizeScalars( in, count, shift, scale, maxCode, static_cast< unsigned char* >( out ) );
+  }
+  else
+  {
+    QuantizeScalars( in, count, shift, scale, maxCode, static_cast< unsigned short* >( out ) );
+  }
+}
+
+} // namespace
+
+
+
+vtkQuantizedImage
+::vtkQuantizedImage()
+{
+  this->Dimensions[0] = this->Dimensions[1] = this->Dimensions[2] = 0;
+  this->Extent[0] = this->Extent[2] = this->Extent[4] = 0;
+  this->Extent[1] = this->Extent[3] = this->Extent[5] = -1;
+  this->ScalarType = VTK_VOID;
+  this->SourceMTime = 0;
+  this->Initialize();
+}
+
+
+
+vtkQuantizedImage
+::~vtkQuantizedImage()
+{
+}
+
+
+
+void vtkQuantizedImage
+::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf( os, indent );
+
+  os << indent << "BitsPerVoxel: " << this->BitsPerVoxel << std::endl;
+  os << indent << "Compressed: " << this->Compressed << std::endl;
+  os << indent << "Scale: " << this->Scale << std::endl;
+  os << indent << "Shift: " << this->Shift << std::endl;
+  os << indent << "Dimensions: " << this->Dimensions[0] << " " << this->Dimensions[1] << " " << this->Dimensions[2] << std::endl;
+  os << indent << "MemorySize: " << this->GetMemorySize() << std::endl;
+  os << indent << "SourceMemorySize: " << this->SourceMemorySize << std::endl;
+}
+
+
+
+void vtkQuantizedImage
+::Initialize()
+{
+  this->BitsPerVoxel = 0;
+  this->Compressed = 0;
+  this->Scale = 1.0;
+  this->Shift = 0.0;
+  this->SourceMemorySize = 0;
+  this->BrickCounts[0] = this->BrickCounts[1] = this->BrickCounts[2] = 0;
+  std::vector< unsigned char >().swap( this->Codes );
+  std::vector< Brick >().swap( this->Bricks );
+  std::vector< unsigned char >().swap( this->Packed );
+  this->Modified();
+}
+
+
+
+bool vtkQuantizedImage
+::IsEmpty()
+{
+  return this->BitsPerVoxel == 0;
+}
+
+
+
+bool vtkQuantizedImage
+::Build( vtkImageData* image, int bitsPerVoxel, bool compressed )
+{
+  this->Initialize();
+  if (    image == NULL
+       || image->GetScalarPointer() == NULL
+       || image->GetNumberOfScalarComponents() != 1 )
+  {
+    vtkErrorMacro( "Build: no single-component image to quantize." );
+    return false;
+  }
+  if ( bitsPerVoxel != 8 && bitsPerVoxel != 16 )
+  {
+    vtkErrorMacro( "Build: " << bitsPerVoxel << " bits per voxel requested, 8 or 16 supported." );
+    return false;
+  }
+
+  image->GetDimensions( this->Dimensions );
+  image->GetExtent( this->Extent );
+  this->ScalarType = image->GetScalarType();
+  this->SourceMTime = image->GetMTime();
+  vtkIdType count = static_cast< vtkIdType >( this->Dimensions[0] ) * this->Dimensions[1] * this->Dimensions[2];
+  this->SourceMemorySize = static_cast< size_t >( count ) * image->GetScalarSize();
+
+  const void* in = image->GetScalarPointer();
+  double range[2];
+  switch ( this->ScalarType )
+  {
+    vtkTemplateMacro( ComputeRange( static_cast< const VTK_TT* >( in ), count, range ) );
+    default:
+      vtkErrorMacro( "Build: unsupported scalar type " << this->ScalarType );
+      return false;
+  }
+
+  // Integer ranges that fit the codes keep unit steps, and so every value.
+  double maxCode = ( 1 << bitsPerVoxel ) - 1;
+  bool integer = ( this->ScalarType != VTK_FLOAT && this->ScalarType != VTK_DOUBLE );
+  this->Shift = range[0];
+  this->Scale = ( range[1] - range[0] ) / maxCode;
+  if ( this->Scale <= 0.0 || ( integer && range[1] - range[0] <= maxCode ) )
+  {
+    this->Scale = 1.0;
+  }
+
+  // Bricks are packed from 16-bit codes, only kept while compressing.
+  std::vector< unsigned short > brickSource;
+  void* out = NULL;
+  if ( compressed )
+  {
+    brickSource.resize( count );
+    out = &brickSource[0];
+  }
+  else
+  {
+    this->Codes.resize( count * ( bitsPerVoxel / 8 ) );
+    out = &this->Codes[0];
+  }
+  switch ( this->ScalarType )
+  {
+    vtkTemplateMacro( QuantizeImage( static_cast< const VTK_TT* >( in ), count, this->Shift, this->Scale,
+                                     maxCode, compressed ? 2 : bitsPerVoxel / 8, out ) );
+  }
+  if ( compressed )
+  {
+    this->CompressCodes( &brickSource[0] );
+  }
+
+  this->BitsPerVoxel = bitsPerVoxel;
+  this->Compressed = compressed ? 1 : 0;
+  this->Modified();
+  return true;
+}
+
+
+
+void vtkQuantizedImage
+::CompressCodes( const unsigned short* codes )
+{
+  for ( int k = 0; k < 3; ++ k )
+  {
+    this->BrickCounts[ k ] = ( this->Dimensions[ k ] + 7 ) / 8;
+  }
+  this->Bricks.resize( static_cast< size_t >( this->BrickCounts[0] ) * this->BrickCounts[1] * this->BrickCounts[2] );
+  this->Packed.clear();
+
+  vtkIdType incY = this->Dimensions[0];
+  vtkIdType incZ = incY * this->Dimensions[1];
+  unsigned short brickCodes[512];
+  size_t b = 0;
+  for ( int bz = 0; bz < this->BrickCounts[2]; ++ bz )
+  {
+    for ( int by = 0; by < this->BrickCounts[1]; ++ by )
+    {
+      for ( int bx = 0; bx < this->BrickCounts[0]; ++ bx, ++ b )
+      {
+        // Bricks past the edge of the volume repeat its last voxels, which
+        // keeps their range, and so their bits, as small as the inside.
+        unsigned short minCode = 0xffff;
+        unsigned short maxCode = 0;
+        for ( int v = 0; v < 512; ++ v )
+        {
+          int x = std::min( bx * 8 + ( v & 7 ), this->Dimensions[0] - 1 );
+          int y = std::min( by * 8 + ( ( v >> 3 ) & 7 ), this->Dimensions[1] - 1 );
+          int z = std::min( bz * 8 + ( v >> 6 ), this->Dimensions[2] - 1 );
+          unsigned short code = codes[ x + y * incY + z * incZ ];
+          brickCodes[ v ] = code;
+          minCode = std::min( minCode, code );
+          maxCode = std::max( maxCode, code );
+        }
+
+        Brick& brick = this->Bricks[ b ];
+        brick.Base = minCode;
+        brick.Bits = 0;
+        while ( ( maxCode - minCode ) >> brick.Bits )
+        {
+          ++ brick.Bits;
+        }
+        brick.Offset = this->Packed.size();
+        if ( brick.Bits == 0 )
+        {
+          continue;
+        }
+
+        // Two bytes of slack for the three-byte writes, dropped after.
+        size_t brickBytes = 64 * brick.Bits;
+        this->Packed.resize( brick.Offset + brickBytes + 2, 0 );
+        unsigned char* packed = &this->Packed[ brick.Offset ];
+        for ( int v = 0; v < 512; ++ v )
+        {
+          unsigned int bit = v * brick.Bits;
+          unsigned int value = static_cast< unsigned int >( brickCodes[ v ] - minCode ) << ( bit & 7 );
+          unsigned char* p = packed + ( bit >> 3 );
+          p[0] |= static_cast< unsigned char >( value );
+          p[1] |= static_cast< unsigned char >( value >> 8 );
+          p[2] |= static_cast< unsigned char >( value >> 16 );
+        }
+        this->Packed.resize( brick.Offset + brickBytes );
+      }
+    }
+  }
+
+  // GetBrickCode reads three bytes from the last offset too.
+  this->Packed.resize( this->Packed.size() + 2, 0 );
+  std::vector< unsigned char >( this->Packed ).swap( this->Packed );
+}
+
+
+
+double vtkQuantizedImage
+::GetMaximumError()
+{
+  if ( this->IsEmpty() )
+  {
+    return 0.0;
+  }
+  bool integer = ( this->ScalarType != VTK_FLOAT && this->ScalarType != VTK_DOUBLE );
+  return ( integer && this->Scale == 1.0 ) ? 0.0 : this->Scale / 2.0;
+}
+
+
+
+size_t vtkQuantizedImage
+::GetMemorySize()
+{
+  return this->Codes.size() + this->Bricks.size() * sizeof( Brick ) + this->Packed.size();
+}
+
+
+
+const void* vtkQuantizedImage
+::GetCodePointer() const
+{
+  return this->Codes.empty() ? NULL : &this->Codes[0];
+}
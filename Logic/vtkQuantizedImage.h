@@ -0,0 +1,144 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkQuantizedImage - reduced-precision copy of a volume for reslicing
+// .SECTION Description
+// Holds a single-component volume as 8 or 16-bit codes with a linear
+// rescale, value = code * Scale + Shift. Shift is the minimum of the
+// source and Scale spreads its range over the codes, so that a value is
+// off by at most Scale / 2; integer volumes whose range fits the codes are
+// kept exactly. vtkSliceImageReslicer samples the codes directly and
+// rescales the interpolated result.
+//
+// Compressed, the codes are kept in bricks of 8x8x8 voxels: each brick
+// stores its smallest code and the offsets from it, bit-packed with as
+// many bits as the range of the brick needs (none for a constant brick).
+// A voxel is decoded from its brick header and one three-byte read,
+// without unpacking the rest of the brick.
+
+
+#ifndef __vtkQuantizedImage_h
+#define __vtkQuantizedImage_h
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerVolumeResliceDriverModuleLogicExport.h"
+
+class vtkImageData;
+
+
+/// \ingroup Slicer_QtModules_VolumeResliceDriver
+class VTK_SLICER_VOLUMERESLICEDRIVER_MODULE_LOGIC_EXPORT vtkQuantizedImage
+  : public vtkObject
+{
+public:
+
+  static vtkQuantizedImage *New();
+  vtkTypeMacro(vtkQuantizedImage,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Quantize a single-component image to 8 or 16 bits per voxel. Returns
+  /// false, leaving the copy empty, for other images or bit depths.
+  bool Build( vtkImageData* image, int bitsPerVoxel, bool compressed );
+
+  /// Release the codes.
+  void Initialize();
+  bool IsEmpty();
+
+  vtkGetMacro( BitsPerVoxel, int );
+  vtkGetMacro( Compressed, int );
+  vtkGetMacro( Scale, double );
+  vtkGetMacro( Shift, double );
+  /// Largest difference between a source voxel and its decoded value.
+  double GetMaximumError();
+
+  /// Geometry and scalar type of the source image.
+  vtkGetVector3Macro( Dimensions, int );
+  vtkGetVector6Macro( Extent, int );
+  vtkGetMacro( ScalarType, int );
+  /// MTime of the source image when the copy was built.
+  vtkGetMacro( SourceMTime, unsigned long );
+
+  /// Bytes held by the copy, and by the scalars it was built from.
+  size_t GetMemorySize();
+  vtkGetMacro( SourceMemorySize, size_t );
+
+  /// Codes, x fastest, when not compressed.
+  const void* GetCodePointer() const;
+
+  /// Code of voxel (x, y, z) of a compressed copy.
+  unsigned int GetBrickCode( int x, int y, int z ) const;
+
+
+protected:
+
+  vtkQuantizedImage();
+  virtual ~vtkQuantizedImage();
+
+  void CompressCodes( const unsigned short* codes );
+
+  struct Brick
+  {
+    size_t Offset;       // first byte of the packed offsets
+    unsigned short Base; // smallest code
+    unsigned char Bits;  // bits per packed offset
+  };
+
+  int BitsPerVoxel;
+  int Compressed;
+  double Scale;
+  double Shift;
+  int Dimensions[3];
+  int Extent[6];
+  int ScalarType;
+  unsigned long SourceMTime;
+  size_t SourceMemorySize;
+
+  std::vector< unsigned char > Codes;
+  std::vector< Brick > Bricks;
+  int BrickCounts[3];
+  std::vector< unsigned char > Packed;
+
+private:
+
+  vtkQuantizedImage(const vtkQuantizedImage&); // Not implemented
+  void operator=(const vtkQuantizedImage&);    // Not implemented
+};
+
+
+
+inline unsigned int vtkQuantizedImage
+::GetBrickCode( int x, int y, int z ) const
+{
+  const Brick& brick = this->Bricks[ ( static_cast< size_t >( z >> 3 ) * this->BrickCounts[1] + ( y >> 3 ) )
+                                     * this->BrickCounts[0] + ( x >> 3 ) ];
+  if ( brick.Bits == 0 )
+  {
+    return brick.Base;
+  }
+  // At most 7 bits into a byte plus 16 bits of offset: three bytes.
+  unsigned int bit = ( ( ( z & 7 ) << 6 ) | ( ( y & 7 ) << 3 ) | ( x & 7 ) ) * brick.Bits;
+  const unsigned char* p = &this->Packed[ brick.Offset + ( bit >> 3 ) ];
+  unsigned int word = p[0] | ( p[1] << 8 ) | ( p[2] << 16 );
+  return brick.Base + ( ( word >> ( bit & 7 ) ) & ( ( 1u << brick.Bits ) - 1 ) );
+}
+
+#endif
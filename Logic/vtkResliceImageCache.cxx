@@ -0,0 +1,379 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VolumeResliceDriver includes
+#include "vtkResliceImageCache.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <cmath>
+#include <cstring>
+
+
+
+vtkStandardNewMacro(vtkResliceImageCache);
+
+
+
+namespace
+{
+
+unsigned long ImageBytes( vtkImageData* image )
+{
+  int dims[3];
+  image->GetDimensions( dims );
+  return static_cast< unsigned long >( dims[0] ) * dims[1] * dims[2]
+         * image->GetNumberOfScalarComponents() * image->GetScalarSize();
+}
+
+} // namespace
+
+
+
+bool vtkResliceImageCache::Key
+::operator<( const Key& other ) const
+{
+  for ( int i = 0; i < 9; ++ i )
+  {
+    if ( this->Pose[ i ] != other.Pose[ i ] )
+    {
+      return this->Pose[ i ] < other.Pose[ i ];
+    }
+  }
+  if ( this->Size[0] != other.Size[0] )
+  {
+    return this->Size[0] < other.Size[0];
+  }
+  if ( this->Size[1] != other.Size[1] )
+  {
+    return this->Size[1] < other.Size[1];
+  }
+  if ( this->InterpolationMode != other.InterpolationMode )
+  {
+    return this->InterpolationMode < other.InterpolationMode;
+  }
+  if ( this->VolumeMTime != other.VolumeMTime )
+  {
+    return this->VolumeMTime < other.VolumeMTime;
+  }
+  for ( int i = 0; i < 12; ++ i )
+  {
+    if ( this->RASToIJK[ i ] != other.RASToIJK[ i ] )
+    {
+      return this->RASToIJK[ i ] < other.RASToIJK[ i ];
+    }
+  }
+  return this->VolumeID < other.VolumeID;
+}
+
+
+
+vtkResliceImageCache
+::vtkResliceImageCache()
+{
+  this->MaximumMemoryInMB = 64;
+  this->AxisQuantum = 1.0e-4;
+  this->PositionQuantum = 0.05;
+  this->NumberOfHits = 0;
+  this->NumberOfMisses = 0;
+  this->MemoryUsage = 0;
+  this->Mutex = vtkMutexLock::New();
+}
+
+
+
+vtkResliceImageCache
+::~vtkResliceImageCache()
+{
+  this->Mutex->Delete();
+}
+
+
+
+void vtkResliceImageCache
+::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf( os, indent );
+
+  os << indent << "MaximumMemoryInMB: " << this->MaximumMemoryInMB << std::endl;
+  os << indent << "AxisQuantum: " << this->AxisQuantum << std::endl;
+  os << indent << "PositionQuantum: " << this->PositionQuantum << std::endl;
+  os << indent << "NumberOfEntries: " << this->Entries.size() << std::endl;
+  os << indent << "MemoryUsageInBytes: " << this->MemoryUsage << std::endl;
+  os << indent << "NumberOfHits: " << this->NumberOfHits << std::endl;
+  os << indent << "NumberOfMisses: " << this->NumberOfMisses << std::endl;
+  os << indent << "HitRate: " << this->GetHitRate() << std::endl;
+}
+
+
+
+bool vtkResliceImageCache
+::IsEnabled()
+{
+  return this->MaximumMemoryInMB > 0;
+}
+
+
+
+void vtkResliceImageCache
+::MakeKey( Key& key, const char* volumeID, unsigned long volumeMTime, vtkMatrix4x4* rasToIJK,
+           vtkMatrix4x4* xyToRAS, int width, int height, int interpolationMode )
+{
+  key.VolumeID = ( volumeID != NULL ) ? volumeID : "";
+  key.VolumeMTime = volumeMTime;
+  memcpy( key.RASToIJK, rasToIJK->Element, sizeof( key.RASToIJK ) );
+  // Only the in-plane axes and the origin determine the sampled pixels.
+  for ( int k = 0; k < 3; ++ k )
+  {
+    key.Pose[ k ]     = static_cast< vtkTypeInt64 >( floor( xyToRAS->Element[ k ][ 0 ] / this->AxisQuantum + 0.5 ) );
+    key.Pose[ 3 + k ] = static_cast< vtkTypeInt64 >( floor( xyToRAS->Element[ k ][ 1 ] / this->AxisQuantum + 0.5 ) );
+    key.Pose[ 6 + k ] = static_cast< vtkTypeInt64 >( floor( xyToRAS->Element[ k ][ 3 ] / this->PositionQuantum + 0.5 ) );
+  }
+  key.Size[0] = width;
+  key.Size[1] = height;
+  key.InterpolationMode = interpolationMode;
+}
+
+
+
+vtkImageData* vtkResliceImageCache
+::Find( const char* volumeID, unsigned long volumeMTime, vtkMatrix4x4* rasToIJK,
+        vtkMatrix4x4* xyToRAS, int width, int height, int interpolationMode )
+{
+  this->Mutex->Lock();
+  Entry* entry = this->Lookup( volumeID, volumeMTime, rasToIJK, xyToRAS, width, height, interpolationMode );
+  this->Mutex->Unlock();
+  return ( entry != NULL ) ? entry->Image.GetPointer() : NULL;
+}
+
+
+
+bool vtkResliceImageCache
+::FindCopy( const char* volumeID, unsigned long volumeMTime, vtkMatrix4x4* rasToIJK,
+            vtkMatrix4x4* xyToRAS, int width, int height, int interpolationMode,
+            vtkImageData* target, vtkMatrix4x4* targetXYToRAS )
+{
+  this->Mutex->Lock();
+  Entry* entry = this->Lookup( volumeID, volumeMTime, rasToIJK, xyToRAS, width, height, interpolationMode );
+  if ( entry != NULL )
+  {
+    vtkResliceImageCache::CopyImage( entry->Image, target );
+    if ( targetXYToRAS != NULL )
+    {
+      targetXYToRAS->DeepCopy( entry->XYToRAS );
+    }
+  }
+  this->Mutex->Unlock();
+  return entry != NULL;
+}
+
+
+
+vtkResliceImageCache::Entry* vtkResliceImageCache
+::Lookup( const char* volumeID, unsigned long volumeMTime, vtkMatrix4x4* rasToIJK,
+          vtkMatrix4x4* xyToRAS, int width, int height, int interpolationMode )
+{
+  if ( ! this->IsEnabled() || rasToIJK == NULL || xyToRAS == NULL )
+  {
+    return NULL;
+  }
+
+  // Reuse the member key: its ID string keeps its capacity across lookups.
+  this->MakeKey( this->LookupKey, volumeID, volumeMTime, rasToIJK, xyToRAS, width, height, interpolationMode );
+  EntryMapType::iterator found = this->Index.find( this->LookupKey );
+  if ( found == this->Index.end() )
+  {
+    ++ this->NumberOfMisses;
+    return NULL;
+  }
+
+  ++ this->NumberOfHits;
+  this->Entries.splice( this->Entries.begin(), this->Entries, found->second );
+  return &*found->second;
+}
+
+
+
+void vtkResliceImageCache
+::Insert( const char* volumeID, unsigned long volumeMTime, vtkMatrix4x4* rasToIJK,
+          vtkMatrix4x4* xyToRAS, int width, int height, int interpolationMode, vtkImageData* image )
+{
+  if (    ! this->IsEnabled() || rasToIJK == NULL || xyToRAS == NULL
+       || image == NULL || image->GetScalarPointer() == NULL )
+  {
+    return;
+  }
+
+  unsigned long bytes = ImageBytes( image );
+  unsigned long limit = static_cast< unsigned long >( this->MaximumMemoryInMB ) * 1024 * 1024;
+  if ( bytes > limit )
+  {
+    return;
+  }
+
+  Key key;
+  this->MakeKey( key, volumeID, volumeMTime, rasToIJK, xyToRAS, width, height, interpolationMode );
+
+  this->Mutex->Lock();
+
+  // Drop the previous image for this key and any image of an older
+  // version of the same volume; those of other poses of the volume stay,
+  // for when it moves back.
+  for ( EntryListType::iterator it = this->Entries.begin(); it != this->Entries.end(); )
+  {
+    EntryListType::iterator current = it ++;
+    if (    current->EntryKey.VolumeID == key.VolumeID
+         && (    current->EntryKey.VolumeMTime != volumeMTime
+              || ! ( current->EntryKey < key || key < current->EntryKey ) ) )
+    {
+      this->Erase( current );
+    }
+  }
+
+  // Evict least recently used entries; recycle an evicted image of the
+  // same size instead of allocating a new one.
+  vtkSmartPointer< vtkImageData > copy;
+  while ( this->MemoryUsage + bytes > limit && ! this->Entries.empty() )
+  {
+    EntryListType::iterator last = this->Entries.end();
+    -- last;
+    if ( copy == NULL && last->Bytes == bytes )
+    {
+      copy = last->Image;
+    }
+    this->Erase( last );
+  }
+  if ( copy == NULL )
+  {
+    copy = vtkSmartPointer< vtkImageData >::New();
+  }
+  vtkResliceImageCache::CopyImage( image, copy );
+
+  Entry entry;
+  entry.EntryKey = key;
+  entry.Image = copy;
+  entry.Bytes = bytes;
+  memcpy( entry.XYToRAS, xyToRAS->Element, sizeof( entry.XYToRAS ) );
+  this->Entries.push_front( entry );
+  this->Index[ key ] = this->Entries.begin();
+  this->MemoryUsage += bytes;
+  this->Mutex->Unlock();
+}
+
+
+
+void vtkResliceImageCache
+::Erase( EntryListType::iterator it )
+{
+  this->MemoryUsage -= it->Bytes;
+  this->Index.erase( it->EntryKey );
+  this->Entries.erase( it );
+}
+
+
+
+void vtkResliceImageCache
+::InvalidateVolume( const char* volumeID )
+{
+  if ( volumeID == NULL )
+  {
+    return;
+  }
+
+  this->Mutex->Lock();
+  for ( EntryListType::iterator it = this->Entries.begin(); it != this->Entries.end(); )
+  {
+    EntryListType::iterator current = it ++;
+    if ( current->EntryKey.VolumeID == volumeID )
+    {
+      this->Erase( current );
+    }
+  }
+  this->Mutex->Unlock();
+}
+
+
+
+void vtkResliceImageCache
+::Clear()
+{
+  this->Mutex->Lock();
+  this->Entries.clear();
+  this->Index.clear();
+  this->MemoryUsage = 0;
+  this->Mutex->Unlock();
+}
+
+
+
+double vtkResliceImageCache
+::GetHitRate()
+{
+  unsigned long lookups = this->NumberOfHits + this->NumberOfMisses;
+  return lookups > 0 ? static_cast< double >( this->NumberOfHits ) / lookups : 0.0;
+}
+
+
+
+unsigned long vtkResliceImageCache
+::GetMemoryUsageInBytes()
+{
+  return this->MemoryUsage;
+}
+
+
+
+int vtkResliceImageCache
+::GetNumberOfEntries()
+{
+  return static_cast< int >( this->Entries.size() );
+}
+
+
+
+void vtkResliceImageCache
+::CopyImage( vtkImageData* source, vtkImageData* target )
+{
+  int* sourceExtent = source->GetExtent();
+  int* targetExtent = target->GetExtent();
+  bool sameShape = (    target->GetScalarPointer() != NULL
+                     && target->GetScalarType() == source->GetScalarType()
+                     && target->GetNumberOfScalarComponents() == source->GetNumberOfScalarComponents() );
+  for ( int i = 0; i < 6 && sameShape; ++ i )
+  {
+    sameShape = ( sourceExtent[ i ] == targetExtent[ i ] );
+  }
+
+  if ( ! sameShape )
+  {
+    target->SetExtent( sourceExtent );
+    target->SetWholeExtent( sourceExtent );
+    target->SetScalarType( source->GetScalarType() );
+    target->SetNumberOfScalarComponents( source->GetNumberOfScalarComponents() );
+    target->AllocateScalars();
+  }
+  target->SetSpacing( source->GetSpacing() );
+  target->SetOrigin( source->GetOrigin() );
+
+  memcpy( target->GetScalarPointer(), source->GetScalarPointer(), ImageBytes( source ) );
+  target->Modified();
+}
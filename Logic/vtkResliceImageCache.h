@@ -0,0 +1,155 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkResliceImageCache - LRU cache of resliced images keyed by plane pose
+// .SECTION Description
+// Stores resliced images under a key made of the quantized XYToRAS of the
+// plane, the output size, the interpolation mode, and the ID, modification
+// time and RAS to IJK of the source volume, so moving the volume (its
+// parent transform, origin, spacing or directions) misses. Entries are
+// evicted least recently used first once the memory limit is reached.
+
+
+#ifndef __vtkResliceImageCache_h
+#define __vtkResliceImageCache_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <list>
+#include <map>
+#include <string>
+
+#include "vtkSlicerVolumeResliceDriverModuleLogicExport.h"
+
+class vtkImageData;
+class vtkMatrix4x4;
+class vtkMutexLock;
+
+
+/// \ingroup Slicer_QtModules_VolumeResliceDriver
+class VTK_SLICER_VOLUMERESLICEDRIVER_MODULE_LOGIC_EXPORT vtkResliceImageCache
+  : public vtkObject
+{
+public:
+
+  static vtkResliceImageCache *New();
+  vtkTypeMacro(vtkResliceImageCache,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Memory limit for cached images; 0 disables the cache.
+  vtkSetMacro( MaximumMemoryInMB, int );
+  vtkGetMacro( MaximumMemoryInMB, int );
+
+  /// Quantization steps for the plane pose. Poses closer than this map to
+  /// the same entry. Axis columns are in mm per pixel, the origin in mm.
+  vtkSetMacro( AxisQuantum, double );
+  vtkGetMacro( AxisQuantum, double );
+  vtkSetMacro( PositionQuantum, double );
+  vtkGetMacro( PositionQuantum, double );
+
+  bool IsEnabled();
+
+  /// Cached image for the plane, or NULL. A hit marks the entry most recently used.
+  vtkImageData* Find( const char* volumeID, unsigned long volumeMTime, vtkMatrix4x4* rasToIJK,
+                      vtkMatrix4x4* xyToRAS, int width, int height, int interpolationMode );
+
+  /// Copy the cached image for the plane into target, and the XYToRAS it
+  /// was resampled at, up to the quantization steps from xyToRAS, into
+  /// targetXYToRAS if given; false on a miss. Unlike Find(), safe while
+  /// other threads use the cache: lookups, insertions and invalidation
+  /// are serialized.
+  bool FindCopy( const char* volumeID, unsigned long volumeMTime, vtkMatrix4x4* rasToIJK,
+                 vtkMatrix4x4* xyToRAS, int width, int height, int interpolationMode,
+                 vtkImageData* target, vtkMatrix4x4* targetXYToRAS );
+
+  /// Store a copy of the image, evicting old entries as needed.
+  void Insert( const char* volumeID, unsigned long volumeMTime, vtkMatrix4x4* rasToIJK,
+               vtkMatrix4x4* xyToRAS, int width, int height, int interpolationMode, vtkImageData* image );
+
+  void InvalidateVolume( const char* volumeID );
+  void Clear();
+
+  vtkGetMacro( NumberOfHits, unsigned long );
+  vtkGetMacro( NumberOfMisses, unsigned long );
+  double GetHitRate();
+  unsigned long GetMemoryUsageInBytes();
+  int GetNumberOfEntries();
+
+  /// Copy scalars, reallocating the target only if its shape differs.
+  static void CopyImage( vtkImageData* source, vtkImageData* target );
+
+
+protected:
+
+  vtkResliceImageCache();
+  virtual ~vtkResliceImageCache();
+
+  struct Key
+  {
+    std::string VolumeID;
+    unsigned long VolumeMTime;
+    /// RAS to IJK as is: it only changes when the volume moves.
+    double RASToIJK[12];
+    vtkTypeInt64 Pose[9];
+    int Size[2];
+    int InterpolationMode;
+    bool operator<( const Key& other ) const;
+  };
+
+  struct Entry
+  {
+    Key EntryKey;
+    vtkSmartPointer< vtkImageData > Image;
+    /// XYToRAS the image was resampled at.
+    double XYToRAS[16];
+    unsigned long Bytes;
+  };
+
+  typedef std::list< Entry > EntryListType;
+  typedef std::map< Key, EntryListType::iterator > EntryMapType;
+
+  void MakeKey( Key& key, const char* volumeID, unsigned long volumeMTime, vtkMatrix4x4* rasToIJK,
+                vtkMatrix4x4* xyToRAS, int width, int height, int interpolationMode );
+  void Erase( EntryListType::iterator it );
+  /// Entry for the plane, or NULL; with the lock held.
+  Entry* Lookup( const char* volumeID, unsigned long volumeMTime, vtkMatrix4x4* rasToIJK,
+                 vtkMatrix4x4* xyToRAS, int width, int height, int interpolationMode );
+
+  int MaximumMemoryInMB;
+  double AxisQuantum;
+  double PositionQuantum;
+
+  unsigned long NumberOfHits;
+  unsigned long NumberOfMisses;
+  unsigned long MemoryUsage;
+
+  /// Most recently used first.
+  EntryListType Entries;
+  EntryMapType Index;
+  Key LookupKey;
+  vtkMutexLock* Mutex;
+
+private:
+
+  vtkResliceImageCache(const vtkResliceImageCache&); // Not implemented
+  void operator=(const vtkResliceImageCache&);       // Not implemented
+};
+
+#endif
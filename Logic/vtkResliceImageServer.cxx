@@ -0,0 +1,678 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VolumeResliceDriver includes
+#include "vtkResliceImageServer.h"
+
+// VTK includes
+#include <vtkClientSocket.h>
+#include <vtkConditionVariable.h>
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+#include <vtkServerSocket.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <cmath>
+#include <cstring>
+
+#ifdef _WIN32
+# include <winsock2.h>
+#else
+# include <arpa/inet.h>
+# include <netinet/in.h>
+# include <sys/socket.h>
+#endif
+
+
+
+vtkStandardNewMacro(vtkResliceImageServer);
+
+
+
+namespace
+{
+
+const size_t IGTL_HEADER_SIZE = 58;
+const size_t IGTL_IMAGE_HEADER_SIZE = 72;
+const size_t RAW_HEADER_SIZE = 4 + 4 + 20 + 8 + 5 * 4 + 16 * 8 + 1 + 8;
+
+// Polling the server socket for a client bounds how long Stop() waits on
+// the sender thread, in milliseconds.
+const unsigned long CONNECTION_POLL_INTERVAL = 100;
+
+// Built once, by the first Start(); constructed before main(), so the lock
+// exists before any server does.
+vtkTypeUInt64 Crc64Table[256];
+bool Crc64TableReady = false;
+vtkSimpleMutexLock Crc64TableLock;
+
+
+// CRC-64 (ECMA-182) as used in OpenIGTLink message headers.
+void BuildCrc64Table()
+{
+  const vtkTypeUInt64 poly = 0x42F0E1EBA9EA3693ULL;
+  for ( int i = 0; i < 256; ++ i )
+  {
+    vtkTypeUInt64 crc = static_cast< vtkTypeUInt64 >( i ) << 56;
+    for ( int b = 0; b < 8; ++ b )
+    {
+      crc = ( crc & 0x8000000000000000ULL ) ? ( crc << 1 ) ^ poly : ( crc << 1 );
+    }
+    Crc64Table[ i ] = crc;
+  }
+}
+
+
+vtkTypeUInt64 Crc64( const unsigned char* data, size_t length )
+{
+  vtkTypeUInt64 crc = 0;
+  for ( size_t i = 0; i < length; ++ i )
+  {
+    crc = Crc64Table[ ( ( crc >> 56 ) ^ data[ i ] ) & 0xFF ] ^ ( crc << 8 );
+  }
+  return crc;
+}
+
+
+inline void PutUInt8( unsigned char*& p, unsigned int v )
+{
+  *p ++ = static_cast< unsigned char >( v & 0xFF );
+}
+
+inline void PutUInt16( unsigned char*& p, unsigned int v )
+{
+  *p ++ = static_cast< unsigned char >( ( v >> 8 ) & 0xFF );
+  *p ++ = static_cast< unsigned char >( v & 0xFF );
+}
+
+inline void PutUInt32( unsigned char*& p, vtkTypeUInt32 v )
+{
+  for ( int s = 24; s >= 0; s -= 8 )
+  {
+    *p ++ = static_cast< unsigned char >( ( v >> s ) & 0xFF );
+  }
+}
+
+inline void PutUInt64( unsigned char*& p, vtkTypeUInt64 v )
+{
+  for ( int s = 56; s >= 0; s -= 8 )
+  {
+    *p ++ = static_cast< unsigned char >( ( v >> s ) & 0xFF );
+  }
+}
+
+inline void PutFloat32( unsigned char*& p, float f )
+{
+  vtkTypeUInt32 v;
+  memcpy( &v, &f, sizeof( v ) );
+  PutUInt32( p, v );
+}
+
+inline void PutFloat64( unsigned char*& p, double d )
+{
+  vtkTypeUInt64 v;
+  memcpy( &v, &d, sizeof( v ) );
+  PutUInt64( p, v );
+}
+
+inline void PutString( unsigned char*& p, const char* s, size_t length )
+{
+  memset( p, 0, length );
+  if ( s != NULL )
+  {
+    strncpy( reinterpret_cast< char* >( p ), s, length );
+  }
+  p += length;
+}
+
+
+// Endianness of the pixel data as coded in OpenIGTLink (1: big, 2: little).
+inline unsigned int HostEndian()
+{
+#ifdef VTK_WORDS_BIGENDIAN
+  return 1;
+#else
+  return 2;
+#endif
+}
+
+
+// OpenIGTLink scalar type codes; 0 if the VTK type cannot be sent.
+unsigned int IGTLScalarType( int vtkType )
+{
+  switch ( vtkType )
+  {
+    case VTK_CHAR:
+    case VTK_SIGNED_CHAR:    return 2;
+    case VTK_UNSIGNED_CHAR:  return 3;
+    case VTK_SHORT:          return 4;
+    case VTK_UNSIGNED_SHORT: return 5;
+    case VTK_INT:            return 6;
+    case VTK_UNSIGNED_INT:   return 7;
+    case VTK_FLOAT:          return 10;
+    case VTK_DOUBLE:         return 11;
+    default:                 return 0;
+  }
+}
+
+
+// Room left in front of the pixels for the message header.
+size_t HeaderSize( int protocol )
+{
+  return ( protocol == vtkResliceImageServer::PROTOCOL_RAW ) ? RAW_HEADER_SIZE
+                                                            : IGTL_HEADER_SIZE + IGTL_IMAGE_HEADER_SIZE;
+}
+
+
+size_t ImageDataSize( vtkImageData* image )
+{
+  int dims[3];
+  image->GetDimensions( dims );
+  return static_cast< size_t >( dims[0] ) * dims[1] * dims[2]
+         * image->GetNumberOfScalarComponents() * image->GetScalarSize();
+}
+
+
+// Unblocks a Send() or Receive() in progress on the socket from another thread.
+void ShutdownSocket( vtkSocket* socket )
+{
+#ifdef _WIN32
+  shutdown( socket->GetSocketDescriptor(), SD_BOTH );
+#else
+  shutdown( socket->GetSocketDescriptor(), SHUT_RDWR );
+#endif
+}
+
+
+// Server socket listening on the loopback interface alone, since the
+// stream carries patient images: vtkServerSocket::CreateServer() binds
+// every interface.
+class vtkLoopbackServerSocket : public vtkServerSocket
+{
+public:
+  static vtkLoopbackServerSocket* New()
+  {
+    return new vtkLoopbackServerSocket;
+  }
+
+  int CreateServer( int port )
+  {
+    if ( this->SocketDescriptor != -1 )
+    {
+      this->CloseSocket();
+    }
+    this->SocketDescriptor = this->CreateSocket();
+    if ( this->SocketDescriptor < 0 )
+    {
+      return -1;
+    }
+
+    sockaddr_in address;
+    memset( &address, 0, sizeof( address ) );
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    address.sin_port = htons( static_cast< unsigned short >( port ) );
+    if (    bind( this->SocketDescriptor, reinterpret_cast< sockaddr* >( &address ), sizeof( address ) ) != 0
+         || this->Listen( this->SocketDescriptor ) != 0 )
+    {
+      this->CloseSocket();
+      return -1;
+    }
+    return 0;
+  }
+};
+
+
+// Grow-only, so buffers reach their steady-state size after the first frame.
+unsigned char* Reserve( std::vector< unsigned char >& data, size_t size )
+{
+  if ( data.size() < size )
+  {
+    data.resize( size );
+  }
+  return &data[ 0 ];
+}
+
+} // namespace
+
+
+
+vtkResliceImageServer
+::vtkResliceImageServer()
+{
+  this->Protocol = PROTOCOL_OPENIGTLINK;
+  this->PoolSize = 4;
+  this->Running = false;
+  this->ThreadID = -1;
+  this->NumberOfSentFrames = 0;
+  this->NumberOfDroppedFrames = 0;
+  this->QueueHead = 0;
+  this->QueueCount = 0;
+
+  this->Mutex = vtkMutexLock::New();
+  this->FrameQueued = vtkConditionVariable::New();
+  this->Threader = vtkMultiThreader::New();
+  this->ServerSocket = NULL;
+  this->ClientSocket = NULL;
+}
+
+
+
+vtkResliceImageServer
+::~vtkResliceImageServer()
+{
+  this->Stop();
+  this->Threader->Delete();
+  this->FrameQueued->Delete();
+  this->Mutex->Delete();
+}
+
+
+
+void vtkResliceImageServer
+::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf( os, indent );
+
+  os << indent << "Protocol: " << ( this->Protocol == PROTOCOL_RAW ? "Raw" : "OpenIGTLink" ) << std::endl;
+  os << indent << "PoolSize: " << this->PoolSize << std::endl;
+  os << indent << "Running: " << ( this->IsRunning() ? "Yes" : "No" ) << std::endl;
+  os << indent << "NumberOfSentFrames: " << this->NumberOfSentFrames << std::endl;
+  os << indent << "NumberOfDroppedFrames: " << this->NumberOfDroppedFrames << std::endl;
+}
+
+
+
+bool vtkResliceImageServer
+::Start( int port )
+{
+  this->Stop();
+
+  vtkLoopbackServerSocket* serverSocket = vtkLoopbackServerSocket::New();
+  if ( serverSocket->CreateServer( port ) != 0 )
+  {
+    vtkErrorMacro( "Cannot listen on port " << port << " of the local host" );
+    serverSocket->Delete();
+    return false;
+  }
+  this->ServerSocket = serverSocket;
+
+  // Sender threads only read the table, and start after it is built.
+  Crc64TableLock.Lock();
+  if ( ! Crc64TableReady )
+  {
+    BuildCrc64Table();
+    Crc64TableReady = true;
+  }
+  Crc64TableLock.Unlock();
+
+  this->Pool.resize( this->PoolSize );
+  this->FreeBuffers.clear();
+  this->FreeBuffers.reserve( this->PoolSize );
+  for ( int i = 0; i < this->PoolSize; ++ i )
+  {
+    this->FreeBuffers.push_back( i );
+  }
+  this->QueuedBuffers.assign( this->PoolSize, -1 );
+  this->QueueHead = 0;
+  this->QueueCount = 0;
+  this->NumberOfSentFrames = 0;
+  this->NumberOfDroppedFrames = 0;
+
+  this->Mutex->Lock();
+  this->Running = true;
+  this->Mutex->Unlock();
+  this->ThreadID = this->Threader->SpawnThread( vtkResliceImageServer::SendThread, this );
+  this->Modified();
+  return true;
+}
+
+
+
+void vtkResliceImageServer
+::Stop()
+{
+  this->Mutex->Lock();
+  if ( ! this->Running )
+  {
+    this->Mutex->Unlock();
+    return;
+  }
+  this->Running = false;
+  this->FrameQueued->Broadcast();
+  // A slow client would keep the sender blocked in Send() and this join
+  // waiting on it.
+  if ( this->ClientSocket != NULL )
+  {
+    ShutdownSocket( this->ClientSocket );
+  }
+  this->Mutex->Unlock();
+
+  this->Threader->TerminateThread( this->ThreadID );
+  this->ThreadID = -1;
+
+  if ( this->ClientSocket != NULL )
+  {
+    this->ClientSocket->CloseSocket();
+    this->ClientSocket->Delete();
+    this->ClientSocket = NULL;
+  }
+  if ( this->ServerSocket != NULL )
+  {
+    this->ServerSocket->CloseSocket();
+    this->ServerSocket->Delete();
+    this->ServerSocket = NULL;
+  }
+  this->Modified();
+}
+
+
+
+bool vtkResliceImageServer
+::IsRunning()
+{
+  this->Mutex->Lock();
+  bool running = this->Running;
+  this->Mutex->Unlock();
+  return running;
+}
+
+
+
+unsigned long vtkResliceImageServer
+::GetNumberOfSentFrames()
+{
+  this->Mutex->Lock();
+  unsigned long count = this->NumberOfSentFrames;
+  this->Mutex->Unlock();
+  return count;
+}
+
+
+
+unsigned long vtkResliceImageServer
+::GetNumberOfDroppedFrames()
+{
+  this->Mutex->Lock();
+  unsigned long count = this->NumberOfDroppedFrames;
+  this->Mutex->Unlock();
+  return count;
+}
+
+
+
+void vtkResliceImageServer
+::PushImage( vtkImageData* image, vtkMatrix4x4* ijkToRAS, const char* deviceName )
+{
+  if ( image == NULL || ijkToRAS == NULL || image->GetScalarPointer() == NULL )
+  {
+    return;
+  }
+
+  int protocol = this->Protocol;
+  int dims[3];
+  image->GetDimensions( dims );
+  if (    protocol == PROTOCOL_OPENIGTLINK
+       && (    IGTLScalarType( image->GetScalarType() ) == 0
+            || dims[0] > 0xFFFF || dims[1] > 0xFFFF || dims[2] > 0xFFFF ) )
+  {
+    vtkWarningMacro( "Image cannot be sent as an OpenIGTLink IMAGE message." );
+    return;
+  }
+
+  // Take a free buffer, or reclaim the oldest queued frame.
+  int index = -1;
+  this->Mutex->Lock();
+  if ( ! this->Running )
+  {
+    // Stopped, or never started.
+  }
+  else if ( ! this->FreeBuffers.empty() )
+  {
+    index = this->FreeBuffers.back();
+    this->FreeBuffers.pop_back();
+  }
+  else if ( this->QueueCount > 0 )
+  {
+    index = this->QueuedBuffers[ this->QueueHead ];
+    this->QueueHead = ( this->QueueHead + 1 ) % this->PoolSize;
+    -- this->QueueCount;
+    ++ this->NumberOfDroppedFrames;
+  }
+  this->Mutex->Unlock();
+
+  if ( index < 0 )
+  {
+    return;
+  }
+
+  // The buffer is in neither list now, so it can be filled without the lock.
+  // Only the pixels are copied here; the header and its CRC are left to the
+  // sender thread.
+  FrameBuffer& buffer = this->Pool[ index ];
+  buffer.Protocol = protocol;
+  for ( int k = 0; k < 3; ++ k )
+  {
+    buffer.Dimensions[ k ] = dims[ k ];
+  }
+  buffer.ScalarType = image->GetScalarType();
+  buffer.NumberOfScalarComponents = image->GetNumberOfScalarComponents();
+  vtkMatrix4x4::DeepCopy( &buffer.IJKToRAS[0][0], ijkToRAS );
+  memset( buffer.DeviceName, 0, sizeof( buffer.DeviceName ) );
+  if ( deviceName != NULL )
+  {
+    strncpy( buffer.DeviceName, deviceName, sizeof( buffer.DeviceName ) );
+  }
+  buffer.Timestamp = vtkTimerLog::GetUniversalTime();
+  buffer.DataSize = ImageDataSize( image );
+  unsigned char* data = Reserve( buffer.Data, HeaderSize( protocol ) + buffer.DataSize );
+  memcpy( data + HeaderSize( protocol ), image->GetScalarPointer(), buffer.DataSize );
+
+  this->Mutex->Lock();
+  this->QueuedBuffers[ ( this->QueueHead + this->QueueCount ) % this->PoolSize ] = index;
+  ++ this->QueueCount;
+  this->FrameQueued->Signal();
+  this->Mutex->Unlock();
+}
+
+
+
+size_t vtkResliceImageServer
+::SerializeOpenIGTLink( FrameBuffer& buffer )
+{
+  const int* dims = buffer.Dimensions;
+  const double ( *ijkToRAS )[4] = buffer.IJKToRAS;
+  size_t bodySize = IGTL_IMAGE_HEADER_SIZE + buffer.DataSize;
+  unsigned char* header = &buffer.Data[ 0 ];
+  unsigned char* body = header + IGTL_HEADER_SIZE;
+
+  // Image header. OpenIGTLink places the image origin at its center (see
+  // GetImageNodePose in the logic) and stores axes scaled by spacing.
+  unsigned char* p = body;
+  PutUInt16( p, 1 );
+  PutUInt8( p, buffer.NumberOfScalarComponents );
+  PutUInt8( p, IGTLScalarType( buffer.ScalarType ) );
+  PutUInt8( p, HostEndian() );
+  PutUInt8( p, 1 ); // RAS
+  PutUInt16( p, dims[0] );
+  PutUInt16( p, dims[1] );
+  PutUInt16( p, dims[2] );
+  double center[3];
+  for ( int k = 0; k < 3; ++ k )
+  {
+    center[ k ] = ijkToRAS[ k ][ 3 ]
+                  + ijkToRAS[ k ][ 0 ] * dims[0] / 2.0
+                  + ijkToRAS[ k ][ 1 ] * dims[1] / 2.0;
+  }
+  for ( int col = 0; col < 3; ++ col )
+  {
+    for ( int k = 0; k < 3; ++ k )
+    {
+      PutFloat32( p, static_cast< float >( ijkToRAS[ k ][ col ] ) );
+    }
+  }
+  for ( int k = 0; k < 3; ++ k )
+  {
+    PutFloat32( p, static_cast< float >( center[ k ] ) );
+  }
+  // Subvolume: offset, then size; the whole image.
+  PutUInt16( p, 0 );
+  PutUInt16( p, 0 );
+  PutUInt16( p, 0 );
+  PutUInt16( p, dims[0] );
+  PutUInt16( p, dims[1] );
+  PutUInt16( p, dims[2] );
+
+  // Pixel data follows, copied by PushImage() in host byte order as
+  // declared above.
+
+  // Message header.
+  double timestamp = buffer.Timestamp;
+  double seconds = floor( timestamp );
+  vtkTypeUInt64 igtlTime = ( static_cast< vtkTypeUInt64 >( seconds ) << 32 )
+                           | static_cast< vtkTypeUInt32 >( ( timestamp - seconds ) * 4294967296.0 );
+  p = header;
+  PutUInt16( p, 1 );
+  PutString( p, "IMAGE", 12 );
+  PutString( p, buffer.DeviceName, 20 );
+  PutUInt64( p, igtlTime );
+  PutUInt64( p, bodySize );
+  PutUInt64( p, Crc64( body, bodySize ) );
+
+  return IGTL_HEADER_SIZE + bodySize;
+}
+
+
+
+size_t vtkResliceImageServer
+::SerializeRaw( FrameBuffer& buffer )
+{
+  unsigned char* p = &buffer.Data[ 0 ];
+
+  // Big-endian header; pixel data in the byte order given by the endian flag.
+  PutString( p, "VRDI", 4 );
+  PutUInt32( p, 1 );
+  PutString( p, buffer.DeviceName, 20 );
+  PutFloat64( p, buffer.Timestamp );
+  PutUInt32( p, buffer.Dimensions[0] );
+  PutUInt32( p, buffer.Dimensions[1] );
+  PutUInt32( p, buffer.Dimensions[2] );
+  PutUInt32( p, buffer.ScalarType );
+  PutUInt32( p, buffer.NumberOfScalarComponents );
+  for ( int r = 0; r < 4; ++ r )
+  {
+    for ( int c = 0; c < 4; ++ c )
+    {
+      PutFloat64( p, buffer.IJKToRAS[ r ][ c ] );
+    }
+  }
+  PutUInt8( p, HostEndian() );
+  PutUInt64( p, buffer.DataSize );
+
+  return RAW_HEADER_SIZE + buffer.DataSize;
+}
+
+
+
+VTK_THREAD_RETURN_TYPE vtkResliceImageServer
+::SendThread( void* arg )
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast< vtkMultiThreader::ThreadInfo* >( arg );
+  static_cast< vtkResliceImageServer* >( info->UserData )->SendLoop();
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+
+
+void vtkResliceImageServer
+::SendLoop()
+{
+  while ( true )
+  {
+    this->Mutex->Lock();
+    bool running = this->Running;
+    vtkClientSocket* clientSocket = this->ClientSocket;
+    this->Mutex->Unlock();
+    if ( ! running )
+    {
+      break;
+    }
+
+    // Wait for a client whether or not frames are queued, so that a client
+    // can connect before the first frame arrives. Frames queued with nobody
+    // to receive them are dropped: a client connecting later starts with
+    // current frames rather than a backlog.
+    if ( clientSocket == NULL )
+    {
+      clientSocket = this->ServerSocket->WaitForConnection( CONNECTION_POLL_INTERVAL );
+      this->Mutex->Lock();
+      this->ClientSocket = clientSocket;
+      if ( clientSocket == NULL )
+      {
+        for ( ; this->QueueCount > 0; -- this->QueueCount )
+        {
+          this->FreeBuffers.push_back( this->QueuedBuffers[ this->QueueHead ] );
+          this->QueueHead = ( this->QueueHead + 1 ) % this->PoolSize;
+          ++ this->NumberOfDroppedFrames;
+        }
+      }
+      this->Mutex->Unlock();
+      continue;
+    }
+
+    this->Mutex->Lock();
+    while ( this->Running && this->QueueCount == 0 )
+    {
+      this->FrameQueued->Wait( this->Mutex );
+    }
+    if ( ! this->Running )
+    {
+      this->Mutex->Unlock();
+      break;
+    }
+    int index = this->QueuedBuffers[ this->QueueHead ];
+    this->QueueHead = ( this->QueueHead + 1 ) % this->PoolSize;
+    -- this->QueueCount;
+    this->Mutex->Unlock();
+
+    // Header, CRC and socket work happen outside the lock, so the driver
+    // never waits on them. The client socket is only replaced under the
+    // lock, for Stop().
+    FrameBuffer& buffer = this->Pool[ index ];
+    size_t size = ( buffer.Protocol == PROTOCOL_RAW ) ? this->SerializeRaw( buffer )
+                                                      : this->SerializeOpenIGTLink( buffer );
+    bool sent = ( clientSocket->Send( &buffer.Data[ 0 ], static_cast< int >( size ) ) != 0 );
+
+    this->Mutex->Lock();
+    if ( sent )
+    {
+      ++ this->NumberOfSentFrames;
+    }
+    else
+    {
+      this->ClientSocket = NULL;
+      clientSocket->CloseSocket();
+      clientSocket->Delete();
+      ++ this->NumberOfDroppedFrames;
+    }
+    this->FreeBuffers.push_back( index );
+    this->Mutex->Unlock();
+  }
+}
@@ -0,0 +1,142 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkResliceImageServer - publish resliced images on a local TCP port
+// .SECTION Description
+// Images pushed by the logic are copied into one of a fixed pool of
+// preallocated buffers. A background thread accepts the client, writes the
+// message header (OpenIGTLink IMAGE with its CRC, or a raw framed format)
+// in front of the pixels and sends the buffer. PushImage() never waits for
+// the socket: when every buffer is in use, the oldest queued frame is
+// dropped and its buffer reused.
+
+
+#ifndef __vtkResliceImageServer_h
+#define __vtkResliceImageServer_h
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkObject.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerVolumeResliceDriverModuleLogicExport.h"
+
+class vtkClientSocket;
+class vtkConditionVariable;
+class vtkImageData;
+class vtkMatrix4x4;
+class vtkMutexLock;
+class vtkServerSocket;
+
+
+/// \ingroup Slicer_QtModules_VolumeResliceDriver
+class VTK_SLICER_VOLUMERESLICEDRIVER_MODULE_LOGIC_EXPORT vtkResliceImageServer
+  : public vtkObject
+{
+public:
+
+  static vtkResliceImageServer *New();
+  vtkTypeMacro(vtkResliceImageServer,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  enum {
+    PROTOCOL_OPENIGTLINK,
+    PROTOCOL_RAW,
+  };
+
+  vtkSetClampMacro( Protocol, int, PROTOCOL_OPENIGTLINK, PROTOCOL_RAW );
+  vtkGetMacro( Protocol, int );
+
+  /// Number of preallocated frame buffers, applied at Start().
+  vtkSetClampMacro( PoolSize, int, 2, 64 );
+  vtkGetMacro( PoolSize, int );
+
+  /// Listen on the given port of the loopback interface; other hosts
+  /// cannot connect.
+  bool Start( int port );
+  void Stop();
+  bool IsRunning();
+
+  /// Copy the image into a pooled buffer and queue it for sending.
+  /// ijkToRAS maps image voxel indices to RAS.
+  void PushImage( vtkImageData* image, vtkMatrix4x4* ijkToRAS, const char* deviceName );
+
+  unsigned long GetNumberOfSentFrames();
+  unsigned long GetNumberOfDroppedFrames();
+
+
+protected:
+
+  vtkResliceImageServer();
+  virtual ~vtkResliceImageServer();
+
+  /// Pixels of a pushed frame, stored after room for the message header,
+  /// and what the sender needs to write that header.
+  struct FrameBuffer
+  {
+    std::vector< unsigned char > Data;
+    int Protocol;
+    int Dimensions[3];
+    int ScalarType;
+    int NumberOfScalarComponents;
+    double IJKToRAS[4][4];
+    char DeviceName[20];
+    double Timestamp;
+    size_t DataSize;
+  };
+
+  /// Write the message header in front of the pixels of the buffer; called
+  /// on the sender thread. Return the size of the message.
+  size_t SerializeOpenIGTLink( FrameBuffer& buffer );
+  size_t SerializeRaw( FrameBuffer& buffer );
+
+  static VTK_THREAD_RETURN_TYPE SendThread( void* arg );
+  void SendLoop();
+
+  int Protocol;
+  int PoolSize;
+  /// Guarded by Mutex, as the client socket. The client is accepted and
+  /// replaced on the sender thread only.
+  bool Running;
+  int ThreadID;
+
+  unsigned long NumberOfSentFrames;
+  unsigned long NumberOfDroppedFrames;
+
+  // Buffer bookkeeping, guarded by Mutex. Queued buffers form a ring of
+  // PoolSize indices; a buffer being sent is in neither list.
+  std::vector< FrameBuffer > Pool;
+  std::vector< int > FreeBuffers;
+  std::vector< int > QueuedBuffers;
+  int QueueHead;
+  int QueueCount;
+
+  vtkMutexLock* Mutex;
+  vtkConditionVariable* FrameQueued;
+  vtkMultiThreader* Threader;
+  vtkServerSocket* ServerSocket;
+  vtkClientSocket* ClientSocket;
+
+private:
+
+  vtkResliceImageServer(const vtkResliceImageServer&); // Not implemented
+  void operator=(const vtkResliceImageServer&);        // Not implemented
+};
+
+#endif
@@ -0,0 +1,524 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VolumeResliceDriver includes
+#include "vtkResliceTaskScheduler.h"
+
+// VTK includes
+#include <vtkConditionVariable.h>
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <algorithm>
+
+#if defined( _WIN32 )
+# include <windows.h>
+#elif defined( __linux__ )
+# include <pthread.h>
+# include <sched.h>
+#endif
+
+
+
+vtkStandardNewMacro(vtkResliceTaskScheduler);
+
+
+
+namespace
+{
+
+void PinCurrentThread( int core )
+{
+  if ( core < 0 )
+  {
+    return;
+  }
+#if defined( _WIN32 )
+  SetThreadAffinityMask( GetCurrentThread(), static_cast< DWORD_PTR >( 1 ) << ( core % ( 8 * sizeof( DWORD_PTR ) ) ) );
+#elif defined( __linux__ )
+  cpu_set_t cores;
+  CPU_ZERO( &cores );
+  CPU_SET( core % CPU_SETSIZE, &cores );
+  pthread_setaffinity_np( pthread_self(), sizeof( cores ), &cores );
+#endif
+}
+
+} // namespace
+
+
+
+vtkResliceTaskScheduler
+::vtkResliceTaskScheduler()
+{
+  this->NumberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  this->TaskPixels = 16384;
+  this->PoolRunning = false;
+  this->PoolSize = 0;
+  this->Generation = 0;
+  this->ActiveThreads = 0;
+  this->NumberOfRunTasks = 0;
+  this->RunTime = 0.0;
+  this->NumberOfRuns = 0;
+  this->NumberOfSteals = 0;
+
+  this->Mutex = vtkMutexLock::New();
+  this->BatchReady = vtkConditionVariable::New();
+  this->BatchDone = vtkConditionVariable::New();
+  this->Threader = vtkMultiThreader::New();
+}
+
+
+
+vtkResliceTaskScheduler
+::~vtkResliceTaskScheduler()
+{
+  this->Stop();
+  this->Threader->Delete();
+  this->BatchDone->Delete();
+  this->BatchReady->Delete();
+  this->Mutex->Delete();
+}
+
+
+
+void vtkResliceTaskScheduler
+::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf( os, indent );
+
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << std::endl;
+  os << indent << "ThreadCores:";
+  for ( size_t i = 0; i < this->ThreadCores.size(); ++ i )
+  {
+    os << " " << this->ThreadCores[ i ];
+  }
+  os << std::endl;
+  os << indent << "TaskPixels: " << this->TaskPixels << std::endl;
+  os << indent << "NumberOfRuns: " << this->NumberOfRuns << std::endl;
+  os << indent << "NumberOfSteals: " << this->NumberOfSteals << std::endl;
+  os << indent << "Last batch: " << this->NumberOfRunTasks << " tasks, "
+     << this->RunTime * 1000.0 << " ms, load imbalance " << this->GetLoadImbalance() << std::endl;
+  for ( int t = 0; t < static_cast< int >( this->Queues.size() ); ++ t )
+  {
+    const Queue& queue = this->Queues[ t ];
+    os << indent << "  Thread " << t << ": " << queue.NumberOfTasks << " tasks, "
+       << queue.NumberOfSteals << " stolen, " << queue.BusyTime * 1000.0 << " ms" << std::endl;
+  }
+}
+
+
+
+void vtkResliceTaskScheduler
+::SetThreadCores( const std::vector< int >& cores )
+{
+  if ( cores == this->ThreadCores )
+  {
+    return;
+  }
+  this->ThreadCores = cores;
+  // Pinned when the pool starts again.
+  this->Stop();
+  this->Modified();
+}
+
+
+
+const std::vector< int >& vtkResliceTaskScheduler
+::GetThreadCores()
+{
+  return this->ThreadCores;
+}
+
+
+
+int vtkResliceTaskScheduler
+::AddTask( TaskFunction function, void* data, int first, int last, int group )
+{
+  Task task;
+  task.Function = function;
+  task.Data = data;
+  task.First = first;
+  task.Last = last;
+  task.Group = group;
+  task.Thread = -1;
+  task.Time = 0.0;
+  this->Tasks.push_back( task );
+  return static_cast< int >( this->Tasks.size() ) - 1;
+}
+
+
+
+int vtkResliceTaskScheduler
+::GetNumberOfTasks()
+{
+  return static_cast< int >( this->Tasks.size() );
+}
+
+
+
+void vtkResliceTaskScheduler
+::StartPool()
+{
+  if ( this->PoolRunning && this->PoolSize == this->NumberOfThreads )
+  {
+    return;
+  }
+  this->Stop();
+
+  this->PoolSize = this->NumberOfThreads;
+  this->Queues.resize( this->PoolSize );
+  for ( int t = 0; t < this->PoolSize; ++ t )
+  {
+    Queue& queue = this->Queues[ t ];
+    queue.Head = 0;
+    queue.Tail = 0;
+    queue.Lock = vtkMutexLock::New();
+    queue.NumberOfTasks = 0;
+    queue.NumberOfSteals = 0;
+    queue.BusyTime = 0.0;
+  }
+
+  this->Generation = 0;
+  this->PoolRunning = true;
+  this->ThreadArguments.resize( this->PoolSize );
+  this->ThreadIDs.assign( this->PoolSize, -1 );
+  for ( int t = 1; t < this->PoolSize; ++ t )
+  {
+    this->ThreadArguments[ t ].Self = this;
+    this->ThreadArguments[ t ].Thread = t;
+    this->ThreadIDs[ t ] = this->Threader->SpawnThread( vtkResliceTaskScheduler::PoolThread,
+                                                        &this->ThreadArguments[ t ] );
+  }
+}
+
+
+
+void vtkResliceTaskScheduler
+::Stop()
+{
+  if ( ! this->PoolRunning )
+  {
+    return;
+  }
+
+  this->Mutex->Lock();
+  this->PoolRunning = false;
+  this->BatchReady->Broadcast();
+  this->Mutex->Unlock();
+
+  for ( int t = 1; t < this->PoolSize; ++ t )
+  {
+    this->Threader->TerminateThread( this->ThreadIDs[ t ] );
+  }
+  this->ThreadIDs.clear();
+  for ( size_t t = 0; t < this->Queues.size(); ++ t )
+  {
+    this->Queues[ t ].Lock->Delete();
+  }
+  this->Queues.clear();
+  this->PoolSize = 0;
+}
+
+
+
+void vtkResliceTaskScheduler
+::Run()
+{
+  int numberOfTasks = static_cast< int >( this->Tasks.size() );
+  this->StartPool();
+
+  // Contiguous runs of tasks, so that a thread starts on neighbouring rows.
+  for ( int t = 0; t < this->PoolSize; ++ t )
+  {
+    Queue& queue = this->Queues[ t ];
+    int first = static_cast< int >( static_cast< long long >( numberOfTasks ) * t / this->PoolSize );
+    int last = static_cast< int >( static_cast< long long >( numberOfTasks ) * ( t + 1 ) / this->PoolSize );
+    queue.Tasks.resize( last - first );
+    for ( int i = first; i < last; ++ i )
+    {
+      queue.Tasks[ i - first ] = i;
+    }
+    queue.Head = 0;
+    queue.Tail = last - first;
+    queue.NumberOfTasks = 0;
+    queue.NumberOfSteals = 0;
+    queue.BusyTime = 0.0;
+  }
+
+  double start = vtkTimerLog::GetUniversalTime();
+  if ( this->PoolSize > 1 && numberOfTasks > 0 )
+  {
+    this->Mutex->Lock();
+    this->ActiveThreads = this->PoolSize;
+    ++ this->Generation;
+    this->BatchReady->Broadcast();
+    this->Mutex->Unlock();
+
+    this->RunTasks( 0 );
+
+    this->Mutex->Lock();
+    -- this->ActiveThreads;
+    while ( this->ActiveThreads > 0 )
+    {
+      this->BatchDone->Wait( this->Mutex );
+    }
+    this->Mutex->Unlock();
+  }
+  else
+  {
+    this->RunTasks( 0 );
+  }
+  this->RunTime = vtkTimerLog::GetUniversalTime() - start;
+
+  this->NumberOfRunTasks = numberOfTasks;
+  ++ this->NumberOfRuns;
+  for ( int t = 0; t < this->PoolSize; ++ t )
+  {
+    this->NumberOfSteals += this->Queues[ t ].NumberOfSteals;
+  }
+  int numberOfGroups = 0;
+  for ( int i = 0; i < numberOfTasks; ++ i )
+  {
+    numberOfGroups = std::max( numberOfGroups, this->Tasks[ i ].Group + 1 );
+  }
+  this->GroupTimes.assign( numberOfGroups, 0.0 );
+  for ( int i = 0; i < numberOfTasks; ++ i )
+  {
+    if ( this->Tasks[ i ].Group >= 0 )
+    {
+      this->GroupTimes[ this->Tasks[ i ].Group ] += this->Tasks[ i ].Time;
+    }
+  }
+
+  // Both keep their capacity, so batches of a steady size do not allocate.
+  this->LastTasks.swap( this->Tasks );
+  this->Tasks.clear();
+}
+
+
+
+VTK_THREAD_RETURN_TYPE vtkResliceTaskScheduler
+::PoolThread( void* arg )
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast< vtkMultiThreader::ThreadInfo* >( arg );
+  PoolThreadArgument* argument = static_cast< PoolThreadArgument* >( info->UserData );
+  argument->Self->PoolLoop( argument->Thread );
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+
+
+void vtkResliceTaskScheduler
+::PoolLoop( int thread )
+{
+  if ( ! this->ThreadCores.empty() )
+  {
+    PinCurrentThread( this->ThreadCores[ thread % this->ThreadCores.size() ] );
+  }
+
+  // StartPool() reset Generation before spawning: a batch posted before
+  // this thread got here is still run.
+  unsigned long generation = 0;
+  this->Mutex->Lock();
+  while ( true )
+  {
+    while ( this->PoolRunning && this->Generation == generation )
+    {
+      this->BatchReady->Wait( this->Mutex );
+    }
+    if ( ! this->PoolRunning )
+    {
+      break;
+    }
+    generation = this->Generation;
+    this->Mutex->Unlock();
+
+    this->RunTasks( thread );
+
+    this->Mutex->Lock();
+    if ( -- this->ActiveThreads == 0 )
+    {
+      this->BatchDone->Broadcast();
+    }
+  }
+  this->Mutex->Unlock();
+}
+
+
+
+void vtkResliceTaskScheduler
+::RunTasks( int thread )
+{
+  Queue& queue = this->Queues[ thread ];
+  while ( true )
+  {
+    int index = this->TakeOwnTask( thread );
+    if ( index < 0 )
+    {
+      index = this->StealTask( thread );
+      if ( index < 0 )
+      {
+        // Tasks are only added between batches, so every queue is empty.
+        return;
+      }
+      ++ queue.NumberOfSteals;
+    }
+
+    Task& task = this->Tasks[ index ];
+    double start = vtkTimerLog::GetUniversalTime();
+    task.Function( task.Data, task.First, task.Last );
+    task.Time = vtkTimerLog::GetUniversalTime() - start;
+    task.Thread = thread;
+    queue.BusyTime += task.Time;
+    ++ queue.NumberOfTasks;
+  }
+}
+
+
+
+int vtkResliceTaskScheduler
+::TakeOwnTask( int thread )
+{
+  Queue& queue = this->Queues[ thread ];
+  int index = -1;
+  queue.Lock->Lock();
+  if ( queue.Head < queue.Tail )
+  {
+    index = queue.Tasks[ -- queue.Tail ];
+  }
+  queue.Lock->Unlock();
+  return index;
+}
+
+
+
+int vtkResliceTaskScheduler
+::StealTask( int thread )
+{
+  // Victims in turn from the next thread on, so that thieves spread out.
+  for ( int n = 1; n < this->PoolSize; ++ n )
+  {
+    Queue& victim = this->Queues[ ( thread + n ) % this->PoolSize ];
+    int index = -1;
+    victim.Lock->Lock();
+    if ( victim.Head < victim.Tail )
+    {
+      index = victim.Tasks[ victim.Head ++ ];
+    }
+    victim.Lock->Unlock();
+    if ( index >= 0 )
+    {
+      return index;
+    }
+  }
+  return -1;
+}
+
+
+
+int vtkResliceTaskScheduler
+::GetThreadTaskCount( int thread )
+{
+  if ( thread < 0 || thread >= static_cast< int >( this->Queues.size() ) )
+  {
+    return 0;
+  }
+  return this->Queues[ thread ].NumberOfTasks;
+}
+
+
+
+int vtkResliceTaskScheduler
+::GetThreadStealCount( int thread )
+{
+  if ( thread < 0 || thread >= static_cast< int >( this->Queues.size() ) )
+  {
+    return 0;
+  }
+  return this->Queues[ thread ].NumberOfSteals;
+}
+
+
+
+double vtkResliceTaskScheduler
+::GetThreadBusyTime( int thread )
+{
+  if ( thread < 0 || thread >= static_cast< int >( this->Queues.size() ) )
+  {
+    return 0.0;
+  }
+  return this->Queues[ thread ].BusyTime;
+}
+
+
+
+double vtkResliceTaskScheduler
+::GetTaskTime( int task )
+{
+  if ( task < 0 || task >= static_cast< int >( this->LastTasks.size() ) )
+  {
+    vtkErrorMacro( "GetTaskTime: no task " << task << " in the last batch" );
+    return 0.0;
+  }
+  return this->LastTasks[ task ].Time;
+}
+
+
+
+int vtkResliceTaskScheduler
+::GetTaskThread( int task )
+{
+  if ( task < 0 || task >= static_cast< int >( this->LastTasks.size() ) )
+  {
+    vtkErrorMacro( "GetTaskThread: no task " << task << " in the last batch" );
+    return -1;
+  }
+  return this->LastTasks[ task ].Thread;
+}
+
+
+
+double vtkResliceTaskScheduler
+::GetGroupTime( int group )
+{
+  if ( group < 0 || group >= static_cast< int >( this->GroupTimes.size() ) )
+  {
+    return 0.0;
+  }
+  return this->GroupTimes[ group ];
+}
+
+
+
+double vtkResliceTaskScheduler
+::GetLoadImbalance()
+{
+  double total = 0.0;
+  double largest = 0.0;
+  for ( size_t t = 0; t < this->Queues.size(); ++ t )
+  {
+    total += this->Queues[ t ].BusyTime;
+    largest = std::max( largest, this->Queues[ t ].BusyTime );
+  }
+  if ( total <= 0.0 )
+  {
+    return 1.0;
+  }
+  return largest * this->Queues.size() / total;
+}
@@ -0,0 +1,194 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkResliceTaskScheduler - work-stealing thread pool for reslice tasks
+// .SECTION Description
+// Runs batches of small tasks, typically bands of output rows of one slice
+// and one volume, on a pool of threads kept across batches. Run() deals
+// the tasks of a batch out to the threads in contiguous runs; each thread
+// takes its own tasks from the back of its queue and, once it is empty,
+// steals from the front of the others', so a slice that costs more than
+// the rest does not leave threads idle. The calling thread works as
+// thread 0 and Run() returns when every task has run.
+//
+// Each task is timed. The times of the last batch are kept per task and
+// summed per thread and per group (a slice, for instance), next to the
+// tasks each thread ran and stole, to show how the load was balanced.
+//
+// Threads but the caller can be pinned to cores. Run() is not reentrant:
+// call it from one thread at a time, and not from a task.
+
+
+#ifndef __vtkResliceTaskScheduler_h
+#define __vtkResliceTaskScheduler_h
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkObject.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerVolumeResliceDriverModuleLogicExport.h"
+
+class vtkConditionVariable;
+class vtkMutexLock;
+
+
+/// \ingroup Slicer_QtModules_VolumeResliceDriver
+class VTK_SLICER_VOLUMERESLICEDRIVER_MODULE_LOGIC_EXPORT vtkResliceTaskScheduler
+  : public vtkObject
+{
+public:
+
+  static vtkResliceTaskScheduler *New();
+  vtkTypeMacro(vtkResliceTaskScheduler,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Work of a task: items [first, last), rows for instance, of data.
+  typedef void ( *TaskFunction )( void* data, int first, int last );
+
+  /// Threads running a batch, the caller included. The pool is resized
+  /// at the next Run().
+  vtkSetClampMacro( NumberOfThreads, int, 1, VTK_MAX_THREADS );
+  vtkGetMacro( NumberOfThreads, int );
+
+  /// Cores of the pool threads: thread t is pinned to cores[ t % size ],
+  /// from thread 1 on; the caller is left alone. Empty (the default) pins
+  /// nothing. Applied when the pool starts; ignored where threads cannot
+  /// be pinned (Mac OS X).
+  void SetThreadCores( const std::vector< int >& cores );
+  const std::vector< int >& GetThreadCores();
+
+  /// Output pixels per task that reslicers aim for when splitting their
+  /// rows into bands.
+  vtkSetClampMacro( TaskPixels, int, 256, 1 << 24 );
+  vtkGetMacro( TaskPixels, int );
+
+  /// Queue a task for the next Run(); returns its index in the batch.
+  int AddTask( TaskFunction function, void* data, int first, int last, int group );
+  int GetNumberOfTasks();
+
+  /// Run the queued tasks and return when all are done; the batch is
+  /// then emptied, and its counters kept until the next Run().
+  void Run();
+
+  /// Stop the pool threads; the next Run() starts them again.
+  void Stop();
+
+  /// Counters of the last batch: its tasks, wall time, and for each thread
+  /// the tasks run and stolen and the time spent in tasks, in seconds.
+  vtkGetMacro( NumberOfRunTasks, int );
+  vtkGetMacro( RunTime, double );
+  int GetThreadTaskCount( int thread );
+  int GetThreadStealCount( int thread );
+  double GetThreadBusyTime( int thread );
+  /// Time of a task of the last batch, by the index AddTask() returned,
+  /// and the thread that ran it.
+  double GetTaskTime( int task );
+  int GetTaskThread( int task );
+  /// Task time of the last batch summed over a group; 0 for a group
+  /// without tasks.
+  double GetGroupTime( int group );
+  /// Largest thread busy time of the last batch over the mean: 1 when the
+  /// load was even.
+  double GetLoadImbalance();
+
+  /// Batches run and tasks stolen since the scheduler was created.
+  vtkGetMacro( NumberOfRuns, unsigned long );
+  vtkGetMacro( NumberOfSteals, unsigned long );
+
+
+protected:
+
+  vtkResliceTaskScheduler();
+  virtual ~vtkResliceTaskScheduler();
+
+  struct Task
+  {
+    TaskFunction Function;
+    void* Data;
+    int First;
+    int Last;
+    int Group;
+    /// Set by the thread that ran it.
+    int Thread;
+    double Time;
+  };
+
+  /// Task indices of a thread: the owner takes from Tail, thieves from
+  /// Head, both under Lock.
+  struct Queue
+  {
+    std::vector< int > Tasks;
+    int Head;
+    int Tail;
+    vtkMutexLock* Lock;
+    int NumberOfTasks;
+    int NumberOfSteals;
+    double BusyTime;
+  };
+
+  struct PoolThreadArgument
+  {
+    vtkResliceTaskScheduler* Self;
+    int Thread;
+  };
+
+  void StartPool();
+  static VTK_THREAD_RETURN_TYPE PoolThread( void* arg );
+  void PoolLoop( int thread );
+  /// Runs tasks of its own queue, then stolen ones, until none is left.
+  void RunTasks( int thread );
+  int TakeOwnTask( int thread );
+  int StealTask( int thread );
+
+  int NumberOfThreads;
+  std::vector< int > ThreadCores;
+  int TaskPixels;
+
+  /// Queued tasks, and those of the last batch with their times.
+  std::vector< Task > Tasks;
+  std::vector< Task > LastTasks;
+  std::vector< Queue > Queues;
+  std::vector< double > GroupTimes;
+
+  // Pool state, guarded by Mutex. Threads run the batch of each new
+  // Generation; ActiveThreads counts those not done with it yet.
+  bool PoolRunning;
+  int PoolSize;
+  std::vector< int > ThreadIDs;
+  std::vector< PoolThreadArgument > ThreadArguments;
+  unsigned long Generation;
+  int ActiveThreads;
+  vtkMutexLock* Mutex;
+  vtkConditionVariable* BatchReady;
+  vtkConditionVariable* BatchDone;
+  vtkMultiThreader* Threader;
+
+  int NumberOfRunTasks;
+  double RunTime;
+  unsigned long NumberOfRuns;
+  unsigned long NumberOfSteals;
+
+private:
+
+  vtkResliceTaskScheduler(const vtkResliceTaskScheduler&); // Not implemented
+  void operator=(const vtkResliceTaskScheduler&);          // Not implemented
+};
+
+#endif
@@ -0,0 +1,394 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VolumeResliceDriver includes
+#include "vtkSharedMemoryPoseChannel.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <cstring>
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+
+
+vtkStandardNewMacro(vtkSharedMemoryPoseChannel);
+
+
+
+namespace
+{
+
+const char PoseChannelMagic[8] = { 'V', 'R', 'D', 'P', 'O', 'S', 'E', '1' };
+const vtkTypeUInt32 PoseChannelVersion = 1;
+
+// A read gives up on an entry after this many attempts and retries at the next poll.
+const int MaximumReadAttempts = 4;
+
+
+inline void FullMemoryBarrier()
+{
+#ifdef _WIN32
+  MemoryBarrier();
+#else
+  __sync_synchronize();
+#endif
+}
+
+
+inline vtkTypeUInt32 LoadSequence( const vtkSharedMemoryPoseChannel::PoseEntry* entry )
+{
+  return *static_cast< const volatile vtkTypeUInt32* >( &entry->Sequence );
+}
+
+
+inline void StoreSequence( vtkSharedMemoryPoseChannel::PoseEntry* entry, vtkTypeUInt32 sequence )
+{
+  *static_cast< volatile vtkTypeUInt32* >( &entry->Sequence ) = sequence;
+}
+
+
+size_t RegionSize( int capacity )
+{
+  return sizeof( vtkSharedMemoryPoseChannel::TableHeader )
+         + capacity * sizeof( vtkSharedMemoryPoseChannel::PoseEntry );
+}
+
+} // namespace
+
+
+
+vtkSharedMemoryPoseChannel
+::vtkSharedMemoryPoseChannel()
+{
+  this->Owner = false;
+#ifdef _WIN32
+  this->MappingHandle = NULL;
+#else
+  this->FileDescriptor = -1;
+#endif
+  this->Mapping = NULL;
+  this->MappingSize = 0;
+  this->Capacity = 0;
+  this->NumberOfChangedEntries = 0;
+  this->NumberOfContendedReads = 0;
+}
+
+
+
+vtkSharedMemoryPoseChannel
+::~vtkSharedMemoryPoseChannel()
+{
+  this->Detach();
+}
+
+
+
+void vtkSharedMemoryPoseChannel
+::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf( os, indent );
+
+  os << indent << "Name: " << this->Name << std::endl;
+  os << indent << "Attached: " << ( this->Mapping ? "Yes" : "No" ) << std::endl;
+  os << indent << "Owner: " << ( this->Owner ? "Yes" : "No" ) << std::endl;
+  os << indent << "Capacity: " << this->Capacity << std::endl;
+  os << indent << "NumberOfContendedReads: " << this->NumberOfContendedReads << std::endl;
+}
+
+
+
+bool vtkSharedMemoryPoseChannel
+::Create( const char* name, int capacity )
+{
+  if ( capacity <= 0 )
+  {
+    vtkErrorMacro( "Invalid pose channel capacity " << capacity );
+    return false;
+  }
+  return this->Map( name, true, capacity );
+}
+
+
+
+bool vtkSharedMemoryPoseChannel
+::Attach( const char* name )
+{
+  return this->Map( name, false, 0 );
+}
+
+
+
+bool vtkSharedMemoryPoseChannel
+::Map( const char* name, bool create, int capacity )
+{
+  this->Detach();
+
+  if ( name == NULL || name[0] == '\0' )
+  {
+    vtkErrorMacro( "No pose channel name set." );
+    return false;
+  }
+
+  size_t size = create ? RegionSize( capacity ) : 0;
+
+#ifdef _WIN32
+  HANDLE mapping = NULL;
+  void* view = NULL;
+  if ( create )
+  {
+    mapping = CreateFileMappingA( INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0,
+                                  static_cast< DWORD >( size ), name );
+    view = mapping ? MapViewOfFile( mapping, FILE_MAP_ALL_ACCESS, 0, 0, size ) : NULL;
+  }
+  else
+  {
+    mapping = OpenFileMappingA( FILE_MAP_READ, FALSE, name );
+    view = mapping ? MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 ) : NULL;
+    MEMORY_BASIC_INFORMATION info;
+    if ( view != NULL && VirtualQuery( view, &info, sizeof( info ) ) != 0 )
+    {
+      size = info.RegionSize;
+    }
+  }
+  if ( view == NULL )
+  {
+    vtkErrorMacro( "Cannot map pose channel " << name );
+    if ( mapping )
+    {
+      CloseHandle( mapping );
+    }
+    return false;
+  }
+  this->MappingHandle = mapping;
+#else
+  std::string objectName = ( name[0] == '/' ) ? name : std::string( "/" ) + name;
+  int fd = create ? shm_open( objectName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 )
+                  : shm_open( objectName.c_str(), O_RDONLY, 0 );
+  if ( fd < 0 )
+  {
+    vtkErrorMacro( "Cannot open pose channel " << objectName );
+    return false;
+  }
+  struct stat regionStat;
+  if ( create ? ftruncate( fd, static_cast< off_t >( size ) ) != 0 : fstat( fd, &regionStat ) != 0 )
+  {
+    vtkErrorMacro( "Cannot size pose channel " << objectName );
+    close( fd );
+    return false;
+  }
+  if ( ! create )
+  {
+    size = static_cast< size_t >( regionStat.st_size );
+  }
+  void* view = ( size < sizeof( TableHeader ) ) ? MAP_FAILED
+               : mmap( NULL, size, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0 );
+  if ( view == MAP_FAILED )
+  {
+    vtkErrorMacro( "Cannot map pose channel " << objectName );
+    close( fd );
+    return false;
+  }
+  this->FileDescriptor = fd;
+#endif
+
+  this->Mapping = view;
+  this->MappingSize = size;
+  this->Name = name;
+  this->Owner = create;
+
+  TableHeader* header = static_cast< TableHeader* >( view );
+  if ( create )
+  {
+    // The entries were zero filled when the region was sized.
+    header->Version = PoseChannelVersion;
+    header->Capacity = capacity;
+    FullMemoryBarrier();
+    memcpy( header->Magic, PoseChannelMagic, sizeof( PoseChannelMagic ) );
+  }
+  else if ( memcmp( header->Magic, PoseChannelMagic, sizeof( PoseChannelMagic ) ) != 0
+            || header->Version != PoseChannelVersion
+            || RegionSize( header->Capacity ) > size )
+  {
+    vtkErrorMacro( "Pose channel " << name << " has an unknown layout." );
+    this->Owner = false;
+    this->Detach();
+    return false;
+  }
+
+  // Reader scratch, allocated once so that polling never allocates.
+  this->Capacity = header->Capacity;
+  this->LastSequences.assign( this->Capacity, 0 );
+  this->ChangedEntries.resize( this->Capacity );
+  this->NumberOfChangedEntries = 0;
+  this->NumberOfContendedReads = 0;
+
+  this->Modified();
+  return true;
+}
+
+
+
+void vtkSharedMemoryPoseChannel
+::Detach()
+{
+  if ( this->Mapping == NULL )
+  {
+    return;
+  }
+
+#ifdef _WIN32
+  UnmapViewOfFile( this->Mapping );
+  CloseHandle( this->MappingHandle );
+  this->MappingHandle = NULL;
+#else
+  munmap( this->Mapping, this->MappingSize );
+  close( this->FileDescriptor );
+  this->FileDescriptor = -1;
+  if ( this->Owner )
+  {
+    // Readers keep their mapping; the name just goes away.
+    std::string objectName = ( this->Name[0] == '/' ) ? this->Name : "/" + this->Name;
+    shm_unlink( objectName.c_str() );
+  }
+#endif
+
+  this->Mapping = NULL;
+  this->MappingSize = 0;
+  this->Capacity = 0;
+  this->Owner = false;
+  this->NumberOfChangedEntries = 0;
+  this->Modified();
+}
+
+
+
+bool vtkSharedMemoryPoseChannel
+::IsAttached()
+{
+  return this->Mapping != NULL;
+}
+
+
+
+int vtkSharedMemoryPoseChannel
+::GetCapacity()
+{
+  return this->Capacity;
+}
+
+
+
+vtkSharedMemoryPoseChannel::PoseEntry* vtkSharedMemoryPoseChannel
+::GetEntries()
+{
+  return reinterpret_cast< PoseEntry* >( static_cast< char* >( this->Mapping ) + sizeof( TableHeader ) );
+}
+
+
+
+void vtkSharedMemoryPoseChannel
+::WritePose( int index, const char* driverID, double timestamp, const double matrix[16], bool valid )
+{
+  if ( ! this->Owner || index < 0 || index >= this->Capacity )
+  {
+    vtkErrorMacro( "Cannot write pose " << index );
+    return;
+  }
+
+  PoseEntry* entry = this->GetEntries() + index;
+  vtkTypeUInt32 sequence = LoadSequence( entry );
+
+  StoreSequence( entry, sequence + 1 );
+  FullMemoryBarrier();
+  entry->Valid = valid ? 1 : 0;
+  entry->Timestamp = timestamp;
+  memcpy( entry->Matrix, matrix, sizeof( entry->Matrix ) );
+  if ( driverID != NULL )
+  {
+    strncpy( entry->DriverID, driverID, DRIVER_ID_LENGTH - 1 );
+    entry->DriverID[ DRIVER_ID_LENGTH - 1 ] = '\0';
+  }
+  FullMemoryBarrier();
+  StoreSequence( entry, sequence + 2 );
+}
+
+
+
+int vtkSharedMemoryPoseChannel
+::ReadChangedEntries()
+{
+  this->NumberOfChangedEntries = 0;
+  if ( this->Mapping == NULL )
+  {
+    return 0;
+  }
+
+  const PoseEntry* entries = this->GetEntries();
+  for ( int i = 0; i < this->Capacity; ++ i )
+  {
+    const PoseEntry* entry = entries + i;
+    bool done = false;
+    for ( int attempt = 0; attempt < MaximumReadAttempts && ! done; ++ attempt )
+    {
+      vtkTypeUInt32 before = LoadSequence( entry );
+      if ( before == this->LastSequences[ i ] )
+      {
+        done = true;
+        break;
+      }
+      if ( before & 1 )
+      {
+        continue;  // write in progress
+      }
+      FullMemoryBarrier();
+      PoseEntry& copy = this->ChangedEntries[ this->NumberOfChangedEntries ];
+      memcpy( &copy, entry, sizeof( PoseEntry ) );
+      FullMemoryBarrier();
+      if ( LoadSequence( entry ) == before )
+      {
+        copy.Sequence = before;
+        copy.DriverID[ DRIVER_ID_LENGTH - 1 ] = '\0';
+        this->LastSequences[ i ] = before;
+        ++ this->NumberOfChangedEntries;
+        done = true;
+      }
+    }
+    if ( ! done )
+    {
+      ++ this->NumberOfContendedReads;
+    }
+  }
+  return this->NumberOfChangedEntries;
+}
+
+
+
+const vtkSharedMemoryPoseChannel::PoseEntry& vtkSharedMemoryPoseChannel
+::GetChangedEntry( int i )
+{
+  return this->ChangedEntries[ i ];
+}
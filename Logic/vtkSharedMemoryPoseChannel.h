@@ -0,0 +1,128 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkSharedMemoryPoseChannel - table of driver poses in shared memory
+// .SECTION Description
+// A named shared-memory region holding a fixed table of driver poses, for
+// tracker processes on the same workstation. Each entry carries the MRML
+// ID of the driver node, a timestamp (seconds, vtkTimerLog::GetUniversalTime
+// clock), a 4x4 matrix (row major) and a validity flag.
+//
+// Entries are protected by a sequence lock: the writer makes the sequence
+// odd, writes, and makes it even again; the reader copies an entry and
+// keeps the copy only if the sequence was even and unchanged. The reader
+// never blocks the writer and never waits for it: an entry caught in the
+// middle of a write is picked up at the next poll.
+//
+// One process creates the region and writes, others attach and read.
+// The region is a POSIX shared-memory object (shm_open) named "/<name>",
+// or a named file mapping on Windows.
+
+
+#ifndef __vtkSharedMemoryPoseChannel_h
+#define __vtkSharedMemoryPoseChannel_h
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <string>
+#include <vector>
+
+#include "vtkSlicerVolumeResliceDriverModuleLogicExport.h"
+
+
+/// \ingroup Slicer_QtModules_VolumeResliceDriver
+class VTK_SLICER_VOLUMERESLICEDRIVER_MODULE_LOGIC_EXPORT vtkSharedMemoryPoseChannel
+  : public vtkObject
+{
+public:
+
+  static vtkSharedMemoryPoseChannel *New();
+  vtkTypeMacro(vtkSharedMemoryPoseChannel,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  enum { DRIVER_ID_LENGTH = 64 };
+
+  /// Shared layout: a TableHeader followed by Capacity entries.
+  struct TableHeader
+  {
+    char Magic[8];
+    vtkTypeUInt32 Version;
+    vtkTypeUInt32 Capacity;
+  };
+
+  struct PoseEntry
+  {
+    vtkTypeUInt32 Sequence;
+    vtkTypeUInt32 Valid;
+    double Timestamp;
+    double Matrix[16];
+    char DriverID[ DRIVER_ID_LENGTH ];
+  };
+
+  /// Writer side: create (or replace) the region; it is unlinked on Detach().
+  bool Create( const char* name, int capacity );
+  void WritePose( int index, const char* driverID, double timestamp, const double matrix[16], bool valid );
+
+  /// Reader side.
+  bool Attach( const char* name );
+
+  void Detach();
+  bool IsAttached();
+  int GetCapacity();
+
+  /// Copy the entries written since the previous call. Returns how many;
+  /// they stay available through GetChangedEntry() until the next call.
+  int ReadChangedEntries();
+  const PoseEntry& GetChangedEntry( int i );
+
+  /// Reads abandoned because the writer kept the entry busy; retried next poll.
+  vtkGetMacro( NumberOfContendedReads, unsigned long );
+
+
+protected:
+
+  vtkSharedMemoryPoseChannel();
+  virtual ~vtkSharedMemoryPoseChannel();
+
+  bool Map( const char* name, bool create, int capacity );
+  PoseEntry* GetEntries();
+
+  std::string Name;
+  bool Owner;
+#ifdef _WIN32
+  void* MappingHandle;
+#else
+  int FileDescriptor;
+#endif
+  void* Mapping;
+  size_t MappingSize;
+  int Capacity;
+
+  std::vector< vtkTypeUInt32 > LastSequences;
+  std::vector< PoseEntry > ChangedEntries;
+  int NumberOfChangedEntries;
+  unsigned long NumberOfContendedReads;
+
+private:
+
+  vtkSharedMemoryPoseChannel(const vtkSharedMemoryPoseChannel&); // Not implemented
+  void operator=(const vtkSharedMemoryPoseChannel&);             // Not implemented
+};
+
+#endif
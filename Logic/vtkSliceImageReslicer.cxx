@@ -0,0 +1,1013 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VolumeResliceDriver includes
+#include "vtkSliceImageReslicer.h"
+#include "vtkMemoryMappedImage.h"
+#include "vtkQuantizedImage.h"
+#include "vtkResliceImageCache.h"
+#include "vtkResliceTaskScheduler.h"
+#include "vtkSliceImageSampling.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+
+
+vtkStandardNewMacro(vtkSliceImageReslicer);
+
+
+
+namespace
+{
+
+using vtkSliceImageSampling::CastKernelSample;
+using vtkSliceImageSampling::CastSample;
+using vtkSliceImageSampling::KernelAxis;
+using vtkSliceImageSampling::LinearAxis;
+using vtkSliceImageSampling::NearestAxis;
+
+
+template < class T >
+void ResliceRows( vtkSliceImageReslicerThreadData* data, const T* inPtr, T* outPtr, int rowMin, int rowMax )
+{
+  int inDims[3];
+  data->Input->GetDimensions( inDims );
+  int outDims[3];
+  data->Output->GetDimensions( outDims );
+  int nc = data->Input->GetNumberOfScalarComponents();
+
+  for ( int j = rowMin; j < rowMax; ++ j )
+  {
+    int colMin = data->Region[0];
+    T* out = outPtr + ( static_cast< vtkIdType >( j ) * outDims[0] + colMin ) * nc;
+    double rowStart[3];
+    for ( int k = 0; k < 3; ++ k )
+    {
+      rowStart[ k ] = data->Start[ k ] + j * data->StepJ[ k ];
+    }
+    vtkSliceImageSampling::SampleRow( inPtr, inDims, nc, data->Interpolation, rowStart, data->StepI,
+                                      colMin, data->Region[1], out );
+  }
+}
+
+
+/// Codes of an uncompressed quantized image.
+template < class Q >
+struct PlainCodes
+{
+  const Q* Codes;
+  vtkIdType IncY;
+  vtkIdType IncZ;
+
+  double operator()( int x, int y, int z ) const
+  {
+    return this->Codes[ x + y * this->IncY + z * this->IncZ ];
+  }
+};
+
+
+/// Codes of a compressed quantized image, decoded voxel by voxel.
+struct BrickCodes
+{
+  const vtkQuantizedImage* Image;
+
+  double operator()( int x, int y, int z ) const
+  {
+    return this->Image->GetBrickCode( x, y, z );
+  }
+};
+
+
+/// ResliceCodeRows with a cubic or Lanczos kernel of TAPS taps per axis.
+template < int TAPS, class T, class C >
+void ResliceKernelCodeRows( vtkSliceImageReslicerThreadData* data, const C& codes, T* outPtr,
+                            int rowMin, int rowMax )
+{
+  int inDims[3];
+  data->QuantizedInput->GetDimensions( inDims );
+  int outDims[3];
+  data->Output->GetDimensions( outDims );
+  double scale = data->QuantizedInput->GetScale();
+  double shift = data->QuantizedInput->GetShift();
+  const float* table = vtkSliceImageSampling::GetKernelTable( data->Interpolation ).Weights;
+  vtkIdType x[ TAPS ];
+  vtkIdType y[ TAPS ];
+  vtkIdType z[ TAPS ];
+
+  for ( int j = rowMin; j < rowMax; ++ j )
+  {
+    int colMin = data->Region[0];
+    T* out = outPtr + static_cast< vtkIdType >( j ) * outDims[0] + colMin;
+    double rowStart[3];
+    for ( int k = 0; k < 3; ++ k )
+    {
+      rowStart[ k ] = data->Start[ k ] + j * data->StepJ[ k ];
+    }
+
+    for ( int i = colMin; i < data->Region[1]; ++ i, ++ out )
+    {
+      const float* wx;
+      const float* wy;
+      const float* wz;
+      if (    ! KernelAxis< TAPS >( rowStart[0] + i * data->StepI[0], inDims[0], 1, table, x, wx )
+           || ! KernelAxis< TAPS >( rowStart[1] + i * data->StepI[1], inDims[1], 1, table, y, wy )
+           || ! KernelAxis< TAPS >( rowStart[2] + i * data->StepI[2], inDims[2], 1, table, z, wz ) )
+      {
+        *out = 0;
+        continue;
+      }
+      double sum = 0.0;
+      for ( int zt = 0; zt < TAPS; ++ zt )
+      {
+        double sy = 0.0;
+        for ( int yt = 0; yt < TAPS; ++ yt )
+        {
+          double sx = 0.0;
+          for ( int xt = 0; xt < TAPS; ++ xt )
+          {
+            sx += wx[ xt ] * codes( x[ xt ], y[ yt ], z[ zt ] );
+          }
+          sy += wy[ yt ] * sx;
+        }
+        sum += wz[ zt ] * sy;
+      }
+      *out = CastKernelSample< T >( shift + scale * sum );
+    }
+  }
+}
+
+
+/// Same sampling as ResliceRows, on the codes of a quantized image. The
+/// rescale is linear, so it is applied once to the interpolated code.
+template < class T, class C >
+void ResliceCodeRows( vtkSliceImageReslicerThreadData* data, const C& codes, T* outPtr, int rowMin, int rowMax )
+{
+  if ( data->Interpolation == vtkSliceImageReslicer::INTERPOLATION_CUBIC )
+  {
+    ResliceKernelCodeRows< 4 >( data, codes, outPtr, rowMin, rowMax );
+    return;
+  }
+  if ( data->Interpolation == vtkSliceImageReslicer::INTERPOLATION_LANCZOS )
+  {
+    ResliceKernelCodeRows< 6 >( data, codes, outPtr, rowMin, rowMax );
+    return;
+  }
+
+  int inDims[3];
+  data->QuantizedInput->GetDimensions( inDims );
+  int outDims[3];
+  data->Output->GetDimensions( outDims );
+  double scale = data->QuantizedInput->GetScale();
+  double shift = data->QuantizedInput->GetShift();
+
+  for ( int j = rowMin; j < rowMax; ++ j )
+  {
+    int colMin = data->Region[0];
+    T* out = outPtr + static_cast< vtkIdType >( j ) * outDims[0] + colMin;
+    double rowStart[3];
+    for ( int k = 0; k < 3; ++ k )
+    {
+      rowStart[ k ] = data->Start[ k ] + j * data->StepJ[ k ];
+    }
+
+    for ( int i = colMin; i < data->Region[1]; ++ i, ++ out )
+    {
+      double p[3];
+      p[0] = rowStart[0] + i * data->StepI[0];
+      p[1] = rowStart[1] + i * data->StepI[1];
+      p[2] = rowStart[2] + i * data->StepI[2];
+
+      if ( data->Interpolation == vtkSliceImageReslicer::INTERPOLATION_NEAREST )
+      {
+        int x, y, z;
+        if (    ! NearestAxis( p[0], inDims[0], x )
+             || ! NearestAxis( p[1], inDims[1], y )
+             || ! NearestAxis( p[2], inDims[2], z ) )
+        {
+          *out = 0;
+          continue;
+        }
+        *out = CastSample< T >( shift + scale * codes( x, y, z ) );
+        continue;
+      }
+
+      int x0, x1, y0, y1, z0, z1;
+      double fx, fy, fz;
+      if (    ! LinearAxis( p[0], inDims[0], x0, x1, fx )
+           || ! LinearAxis( p[1], inDims[1], y0, y1, fy )
+           || ! LinearAxis( p[2], inDims[2], z0, z1, fz ) )
+      {
+        *out = 0;
+        continue;
+      }
+      double c000 = codes( x0, y0, z0 );
+      double c010 = codes( x0, y1, z0 );
+      double c001 = codes( x0, y0, z1 );
+      double c011 = codes( x0, y1, z1 );
+      double v00 = c000 + fx * ( codes( x1, y0, z0 ) - c000 );
+      double v10 = c010 + fx * ( codes( x1, y1, z0 ) - c010 );
+      double v01 = c001 + fx * ( codes( x1, y0, z1 ) - c001 );
+      double v11 = c011 + fx * ( codes( x1, y1, z1 ) - c011 );
+      double v0 = v00 + fy * ( v10 - v00 );
+      double v1 = v01 + fy * ( v11 - v01 );
+      *out = CastSample< T >( shift + scale * ( v0 + fz * ( v1 - v0 ) ) );
+    }
+  }
+}
+
+
+template < class T >
+void ResliceQuantizedRows( vtkSliceImageReslicerThreadData* data, T* outPtr, int rowMin, int rowMax )
+{
+  vtkQuantizedImage* image = data->QuantizedInput;
+  if ( image->GetCompressed() )
+  {
+    BrickCodes codes;
+    codes.Image = image;
+    ResliceCodeRows( data, codes, outPtr, rowMin, rowMax );
+    return;
+  }
+
+  int* inDims = image->GetDimensions();
+  vtkIdType incY = inDims[0];
+  vtkIdType incZ = incY * inDims[1];
+  if ( image->GetBitsPerVoxel() == 8 )
+  {
+    PlainCodes< unsigned char > codes;
+    codes.Codes = static_cast< const unsigned char* >( image->GetCodePointer() );
+    codes.IncY = incY;
+    codes.IncZ = incZ;
+    ResliceCodeRows( data, codes, outPtr, rowMin, rowMax );
+  }
+  else
+  {
+    PlainCodes< unsigned short > codes;
+    codes.Codes = static_cast< const unsigned short* >( image->GetCodePointer() );
+    codes.IncY = incY;
+    codes.IncZ = incZ;
+    ResliceCodeRows( data, codes, outPtr, rowMin, rowMax );
+  }
+}
+
+} // namespace
+
+
+
+vtkSliceImageReslicer
+::vtkSliceImageReslicer()
+{
+  this->InterpolationMode = INTERPOLATION_LINEAR;
+  this->NumberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  this->OutputSize[0] = 0;
+  this->OutputSize[1] = 0;
+  this->InputMTime = 0;
+  this->IncrementalUpdate = 1;
+  this->InPlaneShiftTolerance = 0.01;
+  this->NormalStepTolerance = 0.001;
+  this->NumberOfNeighbourPlanes = 4;
+  this->NextNeighbourPlane = 0;
+  this->NumberOfFullUpdates = 0;
+  this->NumberOfIncrementalUpdates = 0;
+  this->NumberOfCachedUpdates = 0;
+  this->NumberOfNeighbourPlaneUpdates = 0;
+  this->NumberOfResampledPixels = 0;
+  this->ContentValid = false;
+  this->ContentInput = NULL;
+  this->ContentInputMTime = 0;
+  this->ContentInterpolationMode = -1;
+  this->ContentRASToIJK = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->ContentXYToRAS = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->CachedXYToRAS = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->LastXYToRASValid = false;
+  this->LastXYToRAS = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->PredictedXYToIJK = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->RASToIJK = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->XYToRAS = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->XYToIJK = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->Output = vtkSmartPointer< vtkImageData >::New();
+  this->Threader = vtkSmartPointer< vtkMultiThreader >::New();
+  this->PendingUpdate = UPDATE_NONE;
+}
+
+
+
+vtkSliceImageReslicer
+::~vtkSliceImageReslicer()
+{
+}
+
+
+
+void vtkSliceImageReslicer
+::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf( os, indent );
+
+  os << indent << "InterpolationMode: " << this->InterpolationMode << std::endl;
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << std::endl;
+  os << indent << "OutputSize: " << this->OutputSize[0] << " " << this->OutputSize[1] << std::endl;
+  os << indent << "IncrementalUpdate: " << this->IncrementalUpdate << std::endl;
+  os << indent << "InPlaneShiftTolerance: " << this->InPlaneShiftTolerance << std::endl;
+  os << indent << "NormalStepTolerance: " << this->NormalStepTolerance << std::endl;
+  os << indent << "NumberOfNeighbourPlanes: " << this->NumberOfNeighbourPlanes << std::endl;
+  os << indent << "NumberOfFullUpdates: " << this->NumberOfFullUpdates << std::endl;
+  os << indent << "NumberOfIncrementalUpdates: " << this->NumberOfIncrementalUpdates << std::endl;
+  os << indent << "NumberOfCachedUpdates: " << this->NumberOfCachedUpdates << std::endl;
+  os << indent << "NumberOfNeighbourPlaneUpdates: " << this->NumberOfNeighbourPlaneUpdates << std::endl;
+  os << indent << "NumberOfResampledPixels: " << this->NumberOfResampledPixels << std::endl;
+}
+
+
+
+void vtkSliceImageReslicer
+::SetInput( vtkImageData* image, vtkMatrix4x4* rasToIJK )
+{
+  this->Input = image;
+  this->QuantizedInput = NULL;
+  if ( rasToIJK != NULL )
+  {
+    this->RASToIJK->DeepCopy( rasToIJK );
+  }
+  this->Modified();
+}
+
+
+
+vtkImageData* vtkSliceImageReslicer
+::GetInput()
+{
+  return this->Input;
+}
+
+
+
+void vtkSliceImageReslicer
+::SetQuantizedInput( vtkQuantizedImage* image, vtkMatrix4x4* rasToIJK )
+{
+  this->QuantizedInput = image;
+  this->Input = NULL;
+  if ( rasToIJK != NULL )
+  {
+    this->RASToIJK->DeepCopy( rasToIJK );
+  }
+  this->Modified();
+}
+
+
+
+vtkQuantizedImage* vtkSliceImageReslicer
+::GetQuantizedInput()
+{
+  return this->QuantizedInput;
+}
+
+
+
+vtkObject* vtkSliceImageReslicer
+::GetSource()
+{
+  if ( this->QuantizedInput != NULL )
+  {
+    return this->QuantizedInput;
+  }
+  return this->Input;
+}
+
+
+
+void vtkSliceImageReslicer
+::SetInputKey( const char* volumeID, unsigned long volumeMTime )
+{
+  this->InputVolumeID = ( volumeID != NULL ) ? volumeID : "";
+  this->InputMTime = volumeMTime;
+}
+
+
+
+void vtkSliceImageReslicer
+::SetCache( vtkResliceImageCache* cache )
+{
+  this->Cache = cache;
+}
+
+
+
+vtkResliceImageCache* vtkSliceImageReslicer
+::GetCache()
+{
+  return this->Cache;
+}
+
+
+
+void vtkSliceImageReslicer
+::SetReadaheadSource( vtkMemoryMappedImage* source )
+{
+  if ( this->ReadaheadSource.GetPointer() != source )
+  {
+    this->ReadaheadSource = source;
+    this->LastXYToRASValid = false;
+  }
+}
+
+
+
+vtkMemoryMappedImage* vtkSliceImageReslicer
+::GetReadaheadSource()
+{
+  return this->ReadaheadSource;
+}
+
+
+
+void vtkSliceImageReslicer
+::SetSliceGeometry( vtkMatrix4x4* xyToRAS, int width, int height )
+{
+  if ( xyToRAS != NULL )
+  {
+    this->XYToRAS->DeepCopy( xyToRAS );
+  }
+  this->OutputSize[0] = width;
+  this->OutputSize[1] = height;
+  this->Modified();
+}
+
+
+
+vtkMatrix4x4* vtkSliceImageReslicer
+::GetXYToRAS()
+{
+  return this->XYToRAS;
+}
+
+
+
+vtkImageData* vtkSliceImageReslicer
+::GetOutput()
+{
+  return this->Output;
+}
+
+
+
+bool vtkSliceImageReslicer
+::AllocateOutput()
+{
+  int scalarType = 0;
+  int numberOfComponents = 1;
+  if ( this->QuantizedInput != NULL )
+  {
+    scalarType = this->QuantizedInput->GetScalarType();
+  }
+  else
+  {
+    scalarType = this->Input->GetScalarType();
+    numberOfComponents = this->Input->GetNumberOfScalarComponents();
+  }
+
+  int* extent = this->Output->GetExtent();
+  bool sameSize = (    extent[1] == this->OutputSize[0] - 1
+                    && extent[3] == this->OutputSize[1] - 1
+                    && extent[0] == 0 && extent[2] == 0 && extent[4] == 0 && extent[5] == 0 );
+  if (    sameSize
+       && this->Output->GetScalarPointer() != NULL
+       && this->Output->GetScalarType() == scalarType
+       && this->Output->GetNumberOfScalarComponents() == numberOfComponents )
+  {
+    return false;
+  }
+
+  this->Output->SetExtent( 0, this->OutputSize[0] - 1, 0, this->OutputSize[1] - 1, 0, 0 );
+  this->Output->SetWholeExtent( 0, this->OutputSize[0] - 1, 0, this->OutputSize[1] - 1, 0, 0 );
+  this->Output->SetSpacing( 1.0, 1.0, 1.0 );
+  this->Output->SetOrigin( 0.0, 0.0, 0.0 );
+  this->Output->SetScalarType( scalarType );
+  this->Output->SetNumberOfScalarComponents( numberOfComponents );
+  this->Output->AllocateScalars();
+  return true;
+}
+
+
+
+void vtkSliceImageReslicer
+::SetScheduler( vtkResliceTaskScheduler* scheduler )
+{
+  this->Scheduler = scheduler;
+}
+
+
+
+vtkResliceTaskScheduler* vtkSliceImageReslicer
+::GetScheduler()
+{
+  return this->Scheduler;
+}
+
+
+
+void vtkSliceImageReslicer
+::Update()
+{
+  if ( this->BeginUpdate() > 0 )
+  {
+    if ( this->Scheduler != NULL )
+    {
+      this->AddTasks( this->Scheduler, 0 );
+      this->Scheduler->Run();
+    }
+    else
+    {
+      for ( size_t r = 0; r < this->Regions.size(); ++ r )
+      {
+        vtkSliceImageReslicerThreadData& region = this->Regions[ r ];
+        int numberOfThreads = std::min( this->NumberOfThreads, region.Region[3] - region.Region[2] );
+        this->Threader->SetNumberOfThreads( numberOfThreads );
+        this->Threader->SetSingleMethod( vtkSliceImageReslicer::ResliceThread, &region );
+        this->Threader->SingleMethodExecute();
+      }
+    }
+  }
+  this->EndUpdate();
+}
+
+
+
+int vtkSliceImageReslicer
+::BeginUpdate()
+{
+  this->Regions.clear();
+  this->PendingUpdate = UPDATE_NONE;
+  bool hasSource = ( this->QuantizedInput != NULL )
+                   ? ! this->QuantizedInput->IsEmpty()
+                   : ( this->Input != NULL && this->Input->GetScalarPointer() != NULL );
+  if (    ! hasSource
+       || this->OutputSize[0] <= 0
+       || this->OutputSize[1] <= 0 )
+  {
+    return 0;
+  }
+
+  bool useCache = ( this->Cache != NULL && this->Cache->IsEnabled() && ! this->InputVolumeID.empty() );
+  if ( useCache )
+  {
+    if ( this->Cache->FindCopy( this->InputVolumeID.c_str(), this->InputMTime, this->RASToIJK, this->XYToRAS,
+                                this->OutputSize[0], this->OutputSize[1], this->InterpolationMode, this->Output,
+                                this->CachedXYToRAS ) )
+    {
+      // The image was resampled at a pose within the cache quantization
+      // of the requested one; later shifts must start from that grid.
+      this->SetContent( this->CachedXYToRAS );
+      ++ this->NumberOfCachedUpdates;
+      this->PendingUpdate = UPDATE_CACHED;
+      return 0;
+    }
+  }
+
+  bool reallocated = this->AllocateOutput();
+
+  int w = this->OutputSize[0];
+  int h = this->OutputSize[1];
+  int di = 0;
+  int dj = 0;
+  bool shift = false;
+  if ( ! reallocated && this->IncrementalUpdate && this->IsContentReusable() )
+  {
+    shift = this->ComputeShift( this->ContentXYToRAS, di, dj );
+    if ( ! shift && this->RestoreNeighbourPlane( di, dj ) )
+    {
+      shift = true;
+      ++ this->NumberOfNeighbourPlaneUpdates;
+    }
+    else if ( ! shift )
+    {
+      // Moving off the plane: keep it for when the slice steps back.
+      this->SaveNeighbourPlane();
+    }
+  }
+  if ( shift )
+  {
+    // Shift the content, then fill in the border no longer covered by it.
+    // ContentXYToRAS moves onto the previous pixel grid, not the new pose,
+    // so rounding errors cannot accumulate over successive shifts.
+    for ( int k = 0; k < 3; ++ k )
+    {
+      this->ContentXYToRAS->Element[ k ][ 3 ] +=   di * this->ContentXYToRAS->Element[ k ][ 0 ]
+                                                 + dj * this->ContentXYToRAS->Element[ k ][ 1 ];
+    }
+    this->ContentXYToRAS->Modified();
+    this->ShiftOutput( di, dj );
+    int iMin = di < 0 ? -di : 0;
+    int iMax = di > 0 ? w - di : w;
+    int jMin = dj < 0 ? -dj : 0;
+    int jMax = dj > 0 ? h - dj : h;
+    this->ResliceRegion( this->ContentXYToRAS, 0, w, 0, jMin );
+    this->ResliceRegion( this->ContentXYToRAS, 0, w, jMax, h );
+    this->ResliceRegion( this->ContentXYToRAS, 0, iMin, jMin, jMax );
+    this->ResliceRegion( this->ContentXYToRAS, iMax, w, jMin, jMax );
+    ++ this->NumberOfIncrementalUpdates;
+  }
+  else
+  {
+    this->ResliceRegion( this->XYToRAS, 0, w, 0, h );
+    this->SetContent( this->XYToRAS );
+    ++ this->NumberOfFullUpdates;
+  }
+  this->PendingUpdate = UPDATE_RESAMPLED;
+
+  int rows = 0;
+  for ( size_t r = 0; r < this->Regions.size(); ++ r )
+  {
+    rows += this->Regions[ r ].Region[3] - this->Regions[ r ].Region[2];
+  }
+  return rows;
+}
+
+
+
+void vtkSliceImageReslicer
+::AddTasks( vtkResliceTaskScheduler* scheduler, int group )
+{
+  for ( size_t r = 0; r < this->Regions.size(); ++ r )
+  {
+    vtkSliceImageReslicerThreadData& region = this->Regions[ r ];
+    int columns = std::max( 1, region.Region[1] - region.Region[0] );
+    int band = std::max( 1, scheduler->GetTaskPixels() / columns );
+    for ( int j = region.Region[2]; j < region.Region[3]; j += band )
+    {
+      scheduler->AddTask( vtkSliceImageReslicer::ResliceBand, &region, j, std::min( j + band, region.Region[3] ),
+                          group );
+    }
+  }
+}
+
+
+
+void vtkSliceImageReslicer
+::EndUpdate()
+{
+  if ( this->PendingUpdate == UPDATE_RESAMPLED )
+  {
+    this->Output->Modified();
+
+    if ( this->Cache != NULL && this->Cache->IsEnabled() && ! this->InputVolumeID.empty() )
+    {
+      this->Cache->Insert( this->InputVolumeID.c_str(), this->InputMTime, this->RASToIJK, this->XYToRAS,
+                           this->OutputSize[0], this->OutputSize[1], this->InterpolationMode, this->Output );
+    }
+  }
+  if ( this->PendingUpdate != UPDATE_NONE )
+  {
+    this->ReadaheadNextPlane();
+  }
+  this->PendingUpdate = UPDATE_NONE;
+}
+
+
+
+void vtkSliceImageReslicer
+::ReadaheadNextPlane()
+{
+  if (    this->ReadaheadSource == NULL
+       || this->ReadaheadSource->GetOutput() != this->Input.GetPointer() )
+  {
+    this->LastXYToRASValid = false;
+    return;
+  }
+
+  // Constant velocity: the next plane is as far ahead as the last one was
+  // behind. Only the translation is extrapolated; the row margins in
+  // Readahead cover small rotations.
+  this->PredictedXYToIJK->DeepCopy( this->XYToRAS );
+  if ( this->LastXYToRASValid )
+  {
+    for ( int k = 0; k < 3; ++ k )
+    {
+      this->PredictedXYToIJK->Element[ k ][ 3 ] += this->XYToRAS->Element[ k ][ 3 ]
+                                                    - this->LastXYToRAS->Element[ k ][ 3 ];
+    }
+  }
+  vtkMatrix4x4::Multiply4x4( this->RASToIJK, this->PredictedXYToIJK, this->PredictedXYToIJK );
+  this->ReadaheadSource->Readahead( this->PredictedXYToIJK, this->OutputSize[0], this->OutputSize[1] );
+
+  this->LastXYToRAS->DeepCopy( this->XYToRAS );
+  this->LastXYToRASValid = true;
+}
+
+
+
+void vtkSliceImageReslicer
+::SetContent( vtkMatrix4x4* xyToRAS )
+{
+  if ( ! this->IsContentReusable() )
+  {
+    this->ClearNeighbourPlanes();
+  }
+  this->ContentValid = true;
+  this->ContentInput = this->GetSource();
+  this->ContentInputMTime = this->ContentInput->GetMTime();
+  this->ContentInterpolationMode = this->InterpolationMode;
+  this->ContentRASToIJK->DeepCopy( this->RASToIJK );
+  this->ContentXYToRAS->DeepCopy( xyToRAS );
+}
+
+
+
+bool vtkSliceImageReslicer
+::IsContentReusable()
+{
+  if (    ! this->ContentValid
+       || this->ContentInput != this->GetSource()
+       || this->ContentInputMTime != this->ContentInput->GetMTime()
+       || this->ContentInterpolationMode != this->InterpolationMode )
+  {
+    return false;
+  }
+  for ( int r = 0; r < 4; ++ r )
+  {
+    for ( int c = 0; c < 4; ++ c )
+    {
+      if ( this->ContentRASToIJK->Element[ r ][ c ] != this->RASToIJK->Element[ r ][ c ] )
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+
+
+bool vtkSliceImageReslicer
+::ComputeShift( vtkMatrix4x4* reference, int& di, int& dj )
+{
+  // In-plane axes must be unchanged.
+  const double epsilon = 1.0e-6;
+  double u[3], v[3], d[3];
+  for ( int k = 0; k < 3; ++ k )
+  {
+    u[ k ] = this->XYToRAS->Element[ k ][ 0 ];
+    v[ k ] = this->XYToRAS->Element[ k ][ 1 ];
+    d[ k ] = this->XYToRAS->Element[ k ][ 3 ] - reference->Element[ k ][ 3 ];
+    if (    fabs( u[ k ] - reference->Element[ k ][ 0 ] ) > epsilon
+         || fabs( v[ k ] - reference->Element[ k ][ 1 ] ) > epsilon )
+    {
+      return false;
+    }
+  }
+
+  double uu = vtkMath::Dot( u, u );
+  double vv = vtkMath::Dot( v, v );
+  if ( uu <= 0.0 || vv <= 0.0 || fabs( vtkMath::Dot( u, v ) ) > epsilon * sqrt( uu * vv ) )
+  {
+    return false;
+  }
+
+  // Split the translation into pixel steps along the axes and a step along the normal.
+  double n[3];
+  vtkMath::Cross( u, v, n );
+  vtkMath::Normalize( n );
+  if ( fabs( vtkMath::Dot( d, n ) ) > this->NormalStepTolerance + epsilon )
+  {
+    return false;
+  }
+
+  double a = vtkMath::Dot( d, u ) / uu;
+  double b = vtkMath::Dot( d, v ) / vv;
+  di = vtkMath::Floor( a + 0.5 );
+  dj = vtkMath::Floor( b + 0.5 );
+  if (    fabs( a - di ) > this->InPlaneShiftTolerance + epsilon
+       || fabs( b - dj ) > this->InPlaneShiftTolerance + epsilon
+       || abs( di ) >= this->OutputSize[0]
+       || abs( dj ) >= this->OutputSize[1] )
+  {
+    return false;
+  }
+
+  // New pixel (i, j) is old pixel (i + di, j + dj).
+  return true;
+}
+
+
+
+void vtkSliceImageReslicer
+::SaveNeighbourPlane()
+{
+  int count = this->NumberOfNeighbourPlanes;
+  if ( count != static_cast< int >( this->NeighbourPlanes.size() ) )
+  {
+    NeighbourPlane empty;
+    empty.Valid = false;
+    this->NeighbourPlanes.assign( count, empty );
+    this->NextNeighbourPlane = 0;
+  }
+  if ( count == 0 )
+  {
+    return;
+  }
+
+  int index = this->NextNeighbourPlane % count;
+  this->NextNeighbourPlane = index + 1;
+
+  // The slot buffers are allocated once and reused while the size holds.
+  NeighbourPlane& plane = this->NeighbourPlanes[ index ];
+  if ( plane.Image == NULL )
+  {
+    plane.Image = vtkSmartPointer< vtkImageData >::New();
+    plane.XYToRAS = vtkSmartPointer< vtkMatrix4x4 >::New();
+  }
+  vtkResliceImageCache::CopyImage( this->Output, plane.Image );
+  plane.XYToRAS->DeepCopy( this->ContentXYToRAS );
+  plane.Valid = true;
+}
+
+
+
+bool vtkSliceImageReslicer
+::RestoreNeighbourPlane( int& di, int& dj )
+{
+  int* outputExtent = this->Output->GetExtent();
+  for ( size_t p = 0; p < this->NeighbourPlanes.size(); ++ p )
+  {
+    NeighbourPlane& plane = this->NeighbourPlanes[ p ];
+    if ( ! plane.Valid || ! this->ComputeShift( plane.XYToRAS, di, dj ) )
+    {
+      continue;
+    }
+    int* planeExtent = plane.Image->GetExtent();
+    bool sameExtent = true;
+    for ( int i = 0; i < 6; ++ i )
+    {
+      sameExtent = sameExtent && ( planeExtent[ i ] == outputExtent[ i ] );
+    }
+    if ( ! sameExtent || plane.Image->GetScalarType() != this->Output->GetScalarType() )
+    {
+      continue;
+    }
+
+    // The output object is kept, as consumers may hold it; its pixels go
+    // through the swap buffer and the plane takes that buffer's place.
+    if ( this->NeighbourPlaneSwap == NULL )
+    {
+      this->NeighbourPlaneSwap = vtkSmartPointer< vtkImageData >::New();
+    }
+    vtkResliceImageCache::CopyImage( this->Output, this->NeighbourPlaneSwap );
+    vtkResliceImageCache::CopyImage( plane.Image, this->Output );
+    std::swap( plane.Image, this->NeighbourPlaneSwap );
+    std::swap( plane.XYToRAS, this->ContentXYToRAS );
+    return true;
+  }
+  return false;
+}
+
+
+
+void vtkSliceImageReslicer
+::ClearNeighbourPlanes()
+{
+  for ( size_t p = 0; p < this->NeighbourPlanes.size(); ++ p )
+  {
+    this->NeighbourPlanes[ p ].Valid = false;
+  }
+}
+
+
+
+void vtkSliceImageReslicer
+::ShiftOutput( int di, int dj )
+{
+  if ( di == 0 && dj == 0 )
+  {
+    return;
+  }
+
+  int w = this->OutputSize[0];
+  int h = this->OutputSize[1];
+  size_t pixelSize = this->Output->GetNumberOfScalarComponents() * this->Output->GetScalarSize();
+  size_t rowBytes = pixelSize * w;
+  unsigned char* base = static_cast< unsigned char* >( this->Output->GetScalarPointer() );
+
+  int iMin = di < 0 ? -di : 0;
+  int iMax = di > 0 ? w - di : w;
+  int jMin = dj < 0 ? -dj : 0;
+  int jMax = dj > 0 ? h - dj : h;
+  size_t count = ( iMax - iMin ) * pixelSize;
+
+  // Walk rows so that each source row is read before it is overwritten.
+  for ( int n = 0; n < jMax - jMin; ++ n )
+  {
+    int j = ( dj > 0 ) ? jMin + n : jMax - 1 - n;
+    memmove( base + j * rowBytes + iMin * pixelSize,
+             base + ( j + dj ) * rowBytes + ( iMin + di ) * pixelSize,
+             count );
+  }
+}
+
+
+
+void vtkSliceImageReslicer
+::ResliceRegion( vtkMatrix4x4* xyToRAS, int colMin, int colMax, int rowMin, int rowMax )
+{
+  if ( colMin >= colMax || rowMin >= rowMax )
+  {
+    return;
+  }
+
+  vtkMatrix4x4::Multiply4x4( this->RASToIJK, xyToRAS, this->XYToIJK );
+
+  int inExtent[6];
+  if ( this->QuantizedInput != NULL )
+  {
+    this->QuantizedInput->GetExtent( inExtent );
+  }
+  else
+  {
+    this->Input->GetExtent( inExtent );
+  }
+
+  this->Regions.resize( this->Regions.size() + 1 );
+  vtkSliceImageReslicerThreadData& data = this->Regions.back();
+  data.Input = this->Input;
+  data.QuantizedInput = this->QuantizedInput;
+  data.Output = this->Output;
+  data.Interpolation = this->InterpolationMode;
+  data.Region[0] = colMin;
+  data.Region[1] = colMax;
+  data.Region[2] = rowMin;
+  data.Region[3] = rowMax;
+  for ( int k = 0; k < 3; ++ k )
+  {
+    data.StepI[ k ] = this->XYToIJK->Element[ k ][ 0 ];
+    data.StepJ[ k ] = this->XYToIJK->Element[ k ][ 1 ];
+    data.Start[ k ] = this->XYToIJK->Element[ k ][ 3 ] - inExtent[ 2 * k ];
+  }
+
+  this->NumberOfResampledPixels += static_cast< unsigned long >( colMax - colMin ) * ( rowMax - rowMin );
+}
+
+
+
+VTK_THREAD_RETURN_TYPE vtkSliceImageReslicer
+::ResliceThread( void* arg )
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast< vtkMultiThreader::ThreadInfo* >( arg );
+  vtkSliceImageReslicerThreadData* data = static_cast< vtkSliceImageReslicerThreadData* >( info->UserData );
+
+  int rows = data->Region[3] - data->Region[2];
+  int rowMin = data->Region[2] + rows * info->ThreadID / info->NumberOfThreads;
+  int rowMax = data->Region[2] + rows * ( info->ThreadID + 1 ) / info->NumberOfThreads;
+  vtkSliceImageReslicer::ResliceBand( data, rowMin, rowMax );
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+
+
+void vtkSliceImageReslicer
+::ResliceBand( void* arg, int rowMin, int rowMax )
+{
+  vtkSliceImageReslicerThreadData* data = static_cast< vtkSliceImageReslicerThreadData* >( arg );
+  if ( rowMin >= rowMax )
+  {
+    return;
+  }
+
+  void* outPtr = data->Output->GetScalarPointer();
+  if ( data->QuantizedInput != NULL )
+  {
+    switch ( data->QuantizedInput->GetScalarType() )
+    {
+      vtkTemplateMacro( ResliceQuantizedRows( data, static_cast< VTK_TT* >( outPtr ), rowMin, rowMax ) );
+    }
+    return;
+  }
+
+  void* inPtr = data->Input->GetScalarPointer();
+  switch ( data->Input->GetScalarType() )
+  {
+    vtkTemplateMacro( ResliceRows( data, static_cast< const VTK_TT* >( inPtr ),
+                                   static_cast< VTK_TT* >( outPtr ), rowMin, rowMax ) );
+  }
+}
@@ -0,0 +1,276 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkSliceImageReslicer - resample a volume along a driven slice plane
+// .SECTION Description
+// Samples a source volume on the pixel grid of a slice node: output pixel
+// (i, j) is taken at XYToRAS * (i, j, 0, 1). The output image keeps the
+// scalar type and number of components of the source, and its buffer is
+// reused across updates as long as the slice size does not change.
+//
+// When the plane only slides within itself by whole pixels, the previous
+// output is shifted in place and only the newly exposed border is
+// resampled. The tolerances decide how far a pose may be from the pixel
+// grid of the previous output (in pixels) and from its plane (in mm) for
+// the previous pixels to be reused. The last few planes left by a step
+// along the normal are kept too, so that stepping back to one of them
+// shifts it instead of resampling the whole plane.
+//
+// Besides nearest and linear, the source can be sampled with a tricubic
+// (Catmull-Rom) or Lanczos (3 lobes) kernel, sharper on oblique planes at
+// 64 and 216 voxels per pixel; see vtkSliceImageSampling.
+//
+// A quantized input (vtkQuantizedImage) is sampled in place of an image:
+// its codes are interpolated and rescaled into the scalar type of the
+// volume it was built from.
+//
+// With a memory-mapped readahead source, each update also asks the OS to
+// start paging in the voxels of the next plane, extrapolated from the
+// last two poses.
+//
+// The rows are resampled on the reslicer's own threads, or as bands of a
+// task scheduler if one is set. Several reslicers share a scheduler batch
+// through BeginUpdate(), AddTasks() and EndUpdate().
+
+
+#ifndef __vtkSliceImageReslicer_h
+#define __vtkSliceImageReslicer_h
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <string>
+#include <vector>
+
+#include "vtkSlicerVolumeResliceDriverModuleLogicExport.h"
+
+class vtkImageData;
+class vtkMatrix4x4;
+class vtkMemoryMappedImage;
+class vtkQuantizedImage;
+class vtkResliceImageCache;
+class vtkResliceTaskScheduler;
+
+
+/// Region of the output resampled in one pass, shared with the threads.
+struct vtkSliceImageReslicerThreadData
+{
+  vtkImageData* Input;
+  vtkQuantizedImage* QuantizedInput;
+  vtkImageData* Output;
+  double Start[3];  // continuous input index of output pixel (0, 0)
+  double StepI[3];  // input index increment per output column
+  double StepJ[3];  // input index increment per output row
+  int Region[4];    // output columns [0], [1]) and rows [2], [3])
+  int Interpolation; // INTERPOLATION_*
+};
+
+
+/// \ingroup Slicer_QtModules_VolumeResliceDriver
+class VTK_SLICER_VOLUMERESLICEDRIVER_MODULE_LOGIC_EXPORT vtkSliceImageReslicer
+  : public vtkObject
+{
+public:
+
+  static vtkSliceImageReslicer *New();
+  vtkTypeMacro(vtkSliceImageReslicer,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  enum {
+    INTERPOLATION_NEAREST,
+    INTERPOLATION_LINEAR,
+    INTERPOLATION_CUBIC,
+    INTERPOLATION_LANCZOS,
+  };
+
+  vtkSetClampMacro( InterpolationMode, int, INTERPOLATION_NEAREST, INTERPOLATION_LANCZOS );
+  vtkGetMacro( InterpolationMode, int );
+
+  vtkSetClampMacro( NumberOfThreads, int, 1, VTK_MAX_THREADS );
+  vtkGetMacro( NumberOfThreads, int );
+
+  /// Source volume and the matrix mapping RAS to its voxel indices.
+  void SetInput( vtkImageData* image, vtkMatrix4x4* rasToIJK );
+  vtkImageData* GetInput();
+
+  /// Reduced-precision source, sampled instead of an image. Setting either
+  /// input clears the other.
+  void SetQuantizedInput( vtkQuantizedImage* image, vtkMatrix4x4* rasToIJK );
+  vtkQuantizedImage* GetQuantizedInput();
+
+  /// Identify the source for cache lookups: volume node ID and image MTime.
+  void SetInputKey( const char* volumeID, unsigned long volumeMTime );
+
+  /// Optional cache consulted before resampling (shared between slices).
+  void SetCache( vtkResliceImageCache* cache );
+  vtkResliceImageCache* GetCache();
+
+  /// Mapped volume backing the input, if any; used for readahead only.
+  void SetReadaheadSource( vtkMemoryMappedImage* source );
+  vtkMemoryMappedImage* GetReadaheadSource();
+
+  /// Output plane: XYToRAS of the slice node and its size in pixels.
+  void SetSliceGeometry( vtkMatrix4x4* xyToRAS, int width, int height );
+  vtkMatrix4x4* GetXYToRAS();
+
+  /// Reuse the previous output for in-plane translations.
+  vtkSetMacro( IncrementalUpdate, int );
+  vtkGetMacro( IncrementalUpdate, int );
+  vtkBooleanMacro( IncrementalUpdate, int );
+  vtkSetMacro( InPlaneShiftTolerance, double );
+  vtkGetMacro( InPlaneShiftTolerance, double );
+  vtkSetMacro( NormalStepTolerance, double );
+  vtkGetMacro( NormalStepTolerance, double );
+  /// Planes kept besides the previous output, for steps back along the
+  /// normal; 0 disables.
+  vtkSetClampMacro( NumberOfNeighbourPlanes, int, 0, 16 );
+  vtkGetMacro( NumberOfNeighbourPlanes, int );
+
+  /// Scheduler running the rows of Update() instead of the reslicer's
+  /// threads; NumberOfThreads is then unused.
+  void SetScheduler( vtkResliceTaskScheduler* scheduler );
+  vtkResliceTaskScheduler* GetScheduler();
+
+  /// Resample the source along the current plane.
+  void Update();
+
+  /// Update() in steps, for resampling in a batch with other reslicers:
+  /// BeginUpdate() looks up the cache, shifts the previous output and
+  /// returns the number of rows left to resample; AddTasks() queues them
+  /// in bands of about the scheduler's TaskPixels, in the given group;
+  /// once the scheduler has run them, EndUpdate() completes the update.
+  int BeginUpdate();
+  void AddTasks( vtkResliceTaskScheduler* scheduler, int group );
+  void EndUpdate();
+
+  vtkImageData* GetOutput();
+
+  vtkGetMacro( NumberOfFullUpdates, unsigned long );
+  vtkGetMacro( NumberOfIncrementalUpdates, unsigned long );
+  /// Updates served from the cache.
+  vtkGetMacro( NumberOfCachedUpdates, unsigned long );
+  /// Incremental updates shifted from a neighbour plane.
+  vtkGetMacro( NumberOfNeighbourPlaneUpdates, unsigned long );
+  vtkGetMacro( NumberOfResampledPixels, unsigned long );
+
+
+protected:
+
+  vtkSliceImageReslicer();
+  virtual ~vtkSliceImageReslicer();
+
+  /// The input or quantized input, whichever is set.
+  vtkObject* GetSource();
+  bool AllocateOutput();
+  /// Whether the content was sampled from the current source, in the
+  /// current interpolation mode and volume geometry.
+  bool IsContentReusable();
+  /// Pixel shift from the grid of a plane sampled at reference to the
+  /// current plane, if within the tolerances.
+  bool ComputeShift( vtkMatrix4x4* reference, int& di, int& dj );
+  void ShiftOutput( int di, int dj );
+  /// Keep the output as a neighbour plane, in place of the oldest.
+  void SaveNeighbourPlane();
+  /// Swap the output with a kept plane the current one is a shift of;
+  /// false if there is none.
+  bool RestoreNeighbourPlane( int& di, int& dj );
+  void ClearNeighbourPlanes();
+  /// Adds an output region, sampled at xyToRAS, to Regions.
+  void ResliceRegion( vtkMatrix4x4* xyToRAS, int colMin, int colMax, int rowMin, int rowMax );
+  void SetContent( vtkMatrix4x4* xyToRAS );
+  void ReadaheadNextPlane();
+
+  static VTK_THREAD_RETURN_TYPE ResliceThread( void* arg );
+  /// Resamples rows [rowMin, rowMax) of a region.
+  static void ResliceBand( void* region, int rowMin, int rowMax );
+
+  int InterpolationMode;
+  int NumberOfThreads;
+  int OutputSize[2];
+
+  int IncrementalUpdate;
+  double InPlaneShiftTolerance;
+  double NormalStepTolerance;
+  int NumberOfNeighbourPlanes;
+
+  unsigned long NumberOfFullUpdates;
+  unsigned long NumberOfIncrementalUpdates;
+  unsigned long NumberOfCachedUpdates;
+  unsigned long NumberOfNeighbourPlaneUpdates;
+  unsigned long NumberOfResampledPixels;
+
+  // What the current output pixels were actually sampled from. After an
+  // incremental update ContentXYToRAS is on the previous pixel grid, so
+  // rounding errors cannot accumulate over successive shifts.
+  bool ContentValid;
+  vtkObject* ContentInput;
+  unsigned long ContentInputMTime;
+  int ContentInterpolationMode;
+  vtkSmartPointer< vtkMatrix4x4 > ContentRASToIJK;
+  vtkSmartPointer< vtkMatrix4x4 > ContentXYToRAS;
+  /// Pose of the last image found in the cache.
+  vtkSmartPointer< vtkMatrix4x4 > CachedXYToRAS;
+
+  // Earlier outputs of the same content source, for steps back along the
+  // normal; slots are overwritten round robin from NextNeighbourPlane.
+  struct NeighbourPlane
+  {
+    vtkSmartPointer< vtkImageData > Image;
+    vtkSmartPointer< vtkMatrix4x4 > XYToRAS;
+    bool Valid;
+  };
+  std::vector< NeighbourPlane > NeighbourPlanes;
+  int NextNeighbourPlane;
+  /// Buffer the output goes through when swapped with a kept plane.
+  vtkSmartPointer< vtkImageData > NeighbourPlaneSwap;
+
+  vtkSmartPointer< vtkImageData > Input;
+  vtkSmartPointer< vtkQuantizedImage > QuantizedInput;
+  std::string InputVolumeID;
+  unsigned long InputMTime;
+  vtkSmartPointer< vtkResliceImageCache > Cache;
+  vtkSmartPointer< vtkMemoryMappedImage > ReadaheadSource;
+  bool LastXYToRASValid;
+  vtkSmartPointer< vtkMatrix4x4 > LastXYToRAS;
+  vtkSmartPointer< vtkMatrix4x4 > PredictedXYToIJK;
+  vtkSmartPointer< vtkMatrix4x4 > RASToIJK;
+  vtkSmartPointer< vtkMatrix4x4 > XYToRAS;
+  vtkSmartPointer< vtkMatrix4x4 > XYToIJK;
+  vtkSmartPointer< vtkImageData > Output;
+  vtkSmartPointer< vtkMultiThreader > Threader;
+  vtkSmartPointer< vtkResliceTaskScheduler > Scheduler;
+
+  /// State between BeginUpdate() and EndUpdate(): the output regions to
+  /// resample, and what the update did.
+  enum {
+    UPDATE_NONE,
+    UPDATE_CACHED,
+    UPDATE_RESAMPLED
+  };
+  std::vector< vtkSliceImageReslicerThreadData > Regions;
+  int PendingUpdate;
+
+private:
+
+  vtkSliceImageReslicer(const vtkSliceImageReslicer&); // Not implemented
+  void operator=(const vtkSliceImageReslicer&);        // Not implemented
+};
+
+#endif
@@ -0,0 +1,104 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// VolumeResliceDriver includes
+#include "vtkSliceImageSampling.h"
+
+// STD includes
+#include <cmath>
+#include <vector>
+
+
+
+namespace
+{
+
+/// Catmull-Rom cubic (a = -0.5): interpolating, reproduces linear ramps.
+double CubicKernel( double x )
+{
+  x = fabs( x );
+  if ( x < 1.0 )
+  {
+    return ( 1.5 * x - 2.5 ) * x * x + 1.0;
+  }
+  if ( x < 2.0 )
+  {
+    return ( ( -0.5 * x + 2.5 ) * x - 4.0 ) * x + 2.0;
+  }
+  return 0.0;
+}
+
+
+/// Lanczos windowed sinc with 3 lobes.
+double LanczosKernel( double x )
+{
+  x = fabs( x );
+  if ( x < 1.0e-9 )
+  {
+    return 1.0;
+  }
+  if ( x >= 3.0 )
+  {
+    return 0.0;
+  }
+  double px = vtkMath::Pi() * x;
+  return 3.0 * sin( px ) * sin( px / 3.0 ) / ( px * px );
+}
+
+
+struct KernelTableData
+{
+  KernelTableData( int taps, double ( *kernel )( double ) )
+  {
+    this->Weights.resize( ( vtkSliceImageSampling::KernelPhases + 1 ) * taps );
+    for ( int r = 0; r <= vtkSliceImageSampling::KernelPhases; ++ r )
+    {
+      // Tap t sits at voxel x - taps / 2 + 1 + t, the sample at x + f.
+      double f = static_cast< double >( r ) / vtkSliceImageSampling::KernelPhases;
+      float* row = &this->Weights[ r * taps ];
+      double sum = 0.0;
+      for ( int t = 0; t < taps; ++ t )
+      {
+        row[ t ] = static_cast< float >( kernel( f + taps / 2 - 1 - t ) );
+        sum += row[ t ];
+      }
+      for ( int t = 0; t < taps; ++ t )
+      {
+        row[ t ] = static_cast< float >( row[ t ] / sum );
+      }
+    }
+    this->Table.Taps = taps;
+    this->Table.Weights = &this->Weights[0];
+  }
+
+  std::vector< float > Weights;
+  vtkSliceImageSampling::KernelTable Table;
+};
+
+const KernelTableData CubicTable( 4, CubicKernel );
+const KernelTableData LanczosTable( 6, LanczosKernel );
+
+} // namespace
+
+
+
+const vtkSliceImageSampling::KernelTable& vtkSliceImageSampling
+::GetKernelTable( int interpolation )
+{
+  return ( interpolation == vtkSliceImageReslicer::INTERPOLATION_LANCZOS ) ? LanczosTable.Table : CubicTable.Table;
+}
@@ -0,0 +1,299 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkSliceImageSampling - voxel sampling shared by the slice reslicers
+// .SECTION Description
+// Nearest, trilinear, tricubic and Lanczos sampling of a volume along one
+// output row, used by vtkSliceImageReslicer and vtkMultiVolumeReslicer.
+// Positions are continuous voxel indices relative to the first voxel of
+// the volume; pixels outside of it are set to 0.
+//
+// The cubic (Catmull-Rom, 4 taps per axis) and Lanczos (3 lobes, 6 taps)
+// kernels are separable and read their weights from tables built once at
+// KernelPhases fractional positions, so a pixel costs three table lookups
+// and the multiply-adds over its 4^3 or 6^3 voxels. The voxel offsets of
+// each axis are gathered first, clamped at the volume edges, and the tap
+// loops have a fixed length the compiler can unroll and vectorize.
+
+
+#ifndef __vtkSliceImageSampling_h
+#define __vtkSliceImageSampling_h
+
+// VolumeResliceDriver includes
+#include "vtkSliceImageReslicer.h"
+
+// VTK includes
+#include <vtkMath.h>
+#include <vtkType.h>
+
+// STD includes
+#include <cstring>
+#include <limits>
+
+
+namespace vtkSliceImageSampling
+{
+
+inline bool NearestAxis( double p, int size, int& x )
+{
+  x = vtkMath::Floor( p + 0.5 );
+  return x >= 0 && x < size;
+}
+
+
+inline bool LinearAxis( double p, int size, int& x0, int& x1, double& f )
+{
+  if ( size == 1 )
+  {
+    x0 = x1 = 0;
+    f = 0.0;
+    return p > -0.5 && p < 0.5;
+  }
+  if ( p < 0.0 || p > size - 1 )
+  {
+    return false;
+  }
+  x0 = vtkMath::Floor( p );
+  if ( x0 >= size - 1 )
+  {
+    x0 = size - 2;
+  }
+  x1 = x0 + 1;
+  f = p - x0;
+  return true;
+}
+
+
+template < class T >
+inline T CastSample( double v )
+{
+  if ( std::numeric_limits< T >::is_integer )
+  {
+    v += ( v >= 0.0 ) ? 0.5 : -0.5;
+  }
+  return static_cast< T >( v );
+}
+
+
+/// As CastSample, clamped to the range of integer types: the cubic and
+/// Lanczos kernels overshoot at edges.
+template < class T >
+inline T CastKernelSample( double v )
+{
+  if ( std::numeric_limits< T >::is_integer )
+  {
+    if ( v <= static_cast< double >( std::numeric_limits< T >::min() ) )
+    {
+      return std::numeric_limits< T >::min();
+    }
+    if ( v >= static_cast< double >( std::numeric_limits< T >::max() ) )
+    {
+      return std::numeric_limits< T >::max();
+    }
+  }
+  return CastSample< T >( v );
+}
+
+
+/// Fractional positions per voxel of the kernel tables.
+const int KernelPhases = 1024;
+
+/// Weights of a separable kernel: row r, at fraction r / KernelPhases past
+/// voxel x, holds the weights of voxels x - Taps / 2 + 1 ... x + Taps / 2,
+/// normalized to sum 1.
+struct KernelTable
+{
+  int Taps;
+  const float* Weights;
+};
+
+/// Table of vtkSliceImageReslicer::INTERPOLATION_CUBIC or
+/// INTERPOLATION_LANCZOS, built when the library loads.
+VTK_SLICER_VOLUMERESLICEDRIVER_MODULE_LOGIC_EXPORT const KernelTable& GetKernelTable( int interpolation );
+
+
+/// Taps of a kernel along one axis for a sample at f past voxel x0:
+/// offsets of the TAPS voxels around it, clamped to the volume, times inc,
+/// and their weights.
+template < int TAPS >
+inline void KernelTaps( int x0, double f, int size, vtkIdType inc, const float* table, vtkIdType offsets[],
+                        const float*& weights )
+{
+  int first = x0 - ( TAPS / 2 - 1 );
+  for ( int t = 0; t < TAPS; ++ t )
+  {
+    int x = first + t;
+    x = ( x < 0 ) ? 0 : ( x >= size ? size - 1 : x );
+    offsets[ t ] = x * inc;
+  }
+  weights = table + static_cast< int >( f * KernelPhases + 0.5 ) * TAPS;
+}
+
+
+/// KernelTaps for a sample at p. False outside the volume, with the same
+/// bounds as LinearAxis.
+template < int TAPS >
+inline bool KernelAxis( double p, int size, vtkIdType inc, const float* table, vtkIdType offsets[],
+                        const float*& weights )
+{
+  int x0, x1;
+  double f;
+  if ( ! LinearAxis( p, size, x0, x1, f ) )
+  {
+    return false;
+  }
+  KernelTaps< TAPS >( x0, f, size, inc, table, offsets, weights );
+  return true;
+}
+
+
+/// Kernel sum over the TAPS^3 voxels whose offsets KernelAxis gathered.
+template < int TAPS, class T >
+inline double KernelSum( const T* in, const vtkIdType xo[], const vtkIdType yo[], const vtkIdType zo[],
+                         const float* wx, const float* wy, const float* wz )
+{
+  double sum = 0.0;
+  for ( int zt = 0; zt < TAPS; ++ zt )
+  {
+    double sy = 0.0;
+    for ( int yt = 0; yt < TAPS; ++ yt )
+    {
+      const T* row = in + yo[ yt ] + zo[ zt ];
+      double sx = 0.0;
+      for ( int xt = 0; xt < TAPS; ++ xt )
+      {
+        sx += wx[ xt ] * row[ xo[ xt ] ];
+      }
+      sy += wy[ yt ] * sx;
+    }
+    sum += wz[ zt ] * sy;
+  }
+  return sum;
+}
+
+
+/// SampleRow with a cubic or Lanczos kernel of TAPS taps per axis.
+template < int TAPS, class T >
+void SampleKernelRow( const T* inPtr, const int inDims[3], int nc, const float* table,
+                      const double rowStart[3], const double step[3], int colMin, int colMax, T* out )
+{
+  vtkIdType incY = static_cast< vtkIdType >( inDims[0] ) * nc;
+  vtkIdType incZ = incY * inDims[1];
+  vtkIdType xo[ TAPS ];
+  vtkIdType yo[ TAPS ];
+  vtkIdType zo[ TAPS ];
+
+  for ( int i = colMin; i < colMax; ++ i, out += nc )
+  {
+    const float* wx;
+    const float* wy;
+    const float* wz;
+    if (    ! KernelAxis< TAPS >( rowStart[0] + i * step[0], inDims[0], nc, table, xo, wx )
+         || ! KernelAxis< TAPS >( rowStart[1] + i * step[1], inDims[1], incY, table, yo, wy )
+         || ! KernelAxis< TAPS >( rowStart[2] + i * step[2], inDims[2], incZ, table, zo, wz ) )
+    {
+      memset( out, 0, nc * sizeof( T ) );
+      continue;
+    }
+    for ( int c = 0; c < nc; ++ c )
+    {
+      out[ c ] = CastKernelSample< T >( KernelSum< TAPS >( inPtr + c, xo, yo, zo, wx, wy, wz ) );
+    }
+  }
+}
+
+
+/// Sample columns [colMin, colMax) of a row: column i is at
+/// rowStart + i * step. out points to column colMin. interpolation is a
+/// vtkSliceImageReslicer::INTERPOLATION_* mode.
+template < class T >
+void SampleRow( const T* inPtr, const int inDims[3], int nc, int interpolation,
+                const double rowStart[3], const double step[3], int colMin, int colMax, T* out )
+{
+  if ( interpolation == vtkSliceImageReslicer::INTERPOLATION_CUBIC )
+  {
+    SampleKernelRow< 4 >( inPtr, inDims, nc, GetKernelTable( interpolation ).Weights,
+                          rowStart, step, colMin, colMax, out );
+    return;
+  }
+  if ( interpolation == vtkSliceImageReslicer::INTERPOLATION_LANCZOS )
+  {
+    SampleKernelRow< 6 >( inPtr, inDims, nc, GetKernelTable( interpolation ).Weights,
+                          rowStart, step, colMin, colMax, out );
+    return;
+  }
+  bool linear = ( interpolation == vtkSliceImageReslicer::INTERPOLATION_LINEAR );
+
+  vtkIdType incY = static_cast< vtkIdType >( inDims[0] ) * nc;
+  vtkIdType incZ = incY * inDims[1];
+
+  for ( int i = colMin; i < colMax; ++ i, out += nc )
+  {
+    double p[3];
+    p[0] = rowStart[0] + i * step[0];
+    p[1] = rowStart[1] + i * step[1];
+    p[2] = rowStart[2] + i * step[2];
+
+    if ( ! linear )
+    {
+      int x, y, z;
+      if (    ! NearestAxis( p[0], inDims[0], x )
+           || ! NearestAxis( p[1], inDims[1], y )
+           || ! NearestAxis( p[2], inDims[2], z ) )
+      {
+        memset( out, 0, nc * sizeof( T ) );
+        continue;
+      }
+      const T* in = inPtr + x * nc + y * incY + z * incZ;
+      for ( int c = 0; c < nc; ++ c )
+      {
+        out[ c ] = in[ c ];
+      }
+      continue;
+    }
+
+    int x0, x1, y0, y1, z0, z1;
+    double fx, fy, fz;
+    if (    ! LinearAxis( p[0], inDims[0], x0, x1, fx )
+         || ! LinearAxis( p[1], inDims[1], y0, y1, fy )
+         || ! LinearAxis( p[2], inDims[2], z0, z1, fz ) )
+    {
+      memset( out, 0, nc * sizeof( T ) );
+      continue;
+    }
+    vtkIdType o00 = y0 * incY + z0 * incZ;
+    vtkIdType o10 = y1 * incY + z0 * incZ;
+    vtkIdType o01 = y0 * incY + z1 * incZ;
+    vtkIdType o11 = y1 * incY + z1 * incZ;
+    vtkIdType a0 = x0 * nc;
+    vtkIdType a1 = x1 * nc;
+    for ( int c = 0; c < nc; ++ c )
+    {
+      double v00 = inPtr[ o00 + a0 + c ] + fx * ( inPtr[ o00 + a1 + c ] - inPtr[ o00 + a0 + c ] );
+      double v10 = inPtr[ o10 + a0 + c ] + fx * ( inPtr[ o10 + a1 + c ] - inPtr[ o10 + a0 + c ] );
+      double v01 = inPtr[ o01 + a0 + c ] + fx * ( inPtr[ o01 + a1 + c ] - inPtr[ o01 + a0 + c ] );
+      double v11 = inPtr[ o11 + a0 + c ] + fx * ( inPtr[ o11 + a1 + c ] - inPtr[ o11 + a0 + c ] );
+      double v0 = v00 + fy * ( v10 - v00 );
+      double v1 = v01 + fy * ( v11 - v01 );
+      out[ c ] = CastSample< T >( v0 + fz * ( v1 - v0 ) );
+    }
+  }
+}
+
+} // namespace vtkSliceImageSampling
+
+#endif
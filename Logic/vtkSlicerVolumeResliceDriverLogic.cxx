@@ -17,21 +17,46 @@
 
 // VolumeResliceDriver includes
 #include "vtkSlicerVolumeResliceDriverLogic.h"
+#include "vtkAsyncSliceReslicer.h"
+#include "vtkDriverEventTracer.h"
+#include "vtkDriverPoseHistory.h"
+#include "vtkDriverPoseTable.h"
+#include "vtkImageFrameCompounder.h"
+#include "vtkLabelMapSliceReslicer.h"
+#include "vtkMemoryMappedImage.h"
+#include "vtkModelPlaneIntersector.h"
+#include "vtkMultiVolumeReslicer.h"
+#include "vtkQuantizedImage.h"
+#include "vtkResliceImageCache.h"
+#include "vtkResliceImageServer.h"
+#include "vtkResliceTaskScheduler.h"
+#include "vtkSharedMemoryPoseChannel.h"
+#include "vtkSliceImageReslicer.h"
+#include "vtkTimeSeriesSliceReslicer.h"
 
 // MRML includes
 #include "vtkMRMLLinearTransformNode.h"
+#include "vtkMRMLModelNode.h"
 #include "vtkMRMLScalarVolumeNode.h"
+#include "vtkMRMLSliceCompositeNode.h"
 #include "vtkMRMLSliceNode.h"
 
 // VTK includes
 #include <vtkCollection.h>
 #include <vtkCollectionIterator.h>
+#include <vtkDoubleArray.h>
 #include <vtkImageData.h>
+#include <vtkMath.h>
 #include <vtkMatrix4x4.h>
+#include <vtkMultiThreader.h>
 #include <vtkNew.h>
+#include <vtkPolyData.h>
+#include <vtkTimerLog.h>
 
 // STD includes
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 
 
 
@@ -39,9 +64,88 @@ vtkStandardNewMacro(vtkSlicerVolumeResliceDriverLogic);
 
 
 
+namespace
+{
+
+/// Brackets a call into MRML on the pose path for the MRML call callback.
+class MRMLCallScope
+{
+public:
+  MRMLCallScope( vtkSlicerVolumeResliceDriverLogic::MRMLCallCallbackType callback, void* clientData )
+    : Callback( callback ), ClientData( clientData )
+  {
+    if ( this->Callback != NULL )
+    {
+      this->Callback( true, this->ClientData );
+    }
+  }
+  ~MRMLCallScope()
+  {
+    if ( this->Callback != NULL )
+    {
+      this->Callback( false, this->ClientData );
+    }
+  }
+private:
+  vtkSlicerVolumeResliceDriverLogic::MRMLCallCallbackType Callback;
+  void* ClientData;
+};
+
+/// Scheduler task outlining the labels of a slice, as a whole.
+void UpdateLabelOutlinesTask( void* outliner, int, int )
+{
+  static_cast< vtkLabelMapSliceReslicer* >( outliner )->Update();
+}
+
+/// Scheduler task resampling the time point of a series slice, as a whole.
+void UpdateTimeSeriesTask( void* reslicer, int, int )
+{
+  static_cast< vtkTimeSeriesSliceReslicer* >( reslicer )->Update();
+}
+
+} // namespace
+
+
+
 vtkSlicerVolumeResliceDriverLogic
 ::vtkSlicerVolumeResliceDriverLogic()
 {
+  this->CompoundingEnabled = false;
+  this->FrameCompounder = vtkImageFrameCompounder::New();
+  this->ResliceOutputEnabled = false;
+  this->ImageServer = vtkResliceImageServer::New();
+  this->ResliceCache = vtkResliceImageCache::New();
+  this->Tracer = vtkDriverEventTracer::New();
+  this->NumberOfPoseEvents = 0;
+  this->MRMLCallCallback = NULL;
+  this->MRMLCallClientData = NULL;
+  this->PoseChannel = vtkSharedMemoryPoseChannel::New();
+  this->PoseTable = vtkSmartPointer< vtkDriverPoseTable >::New();
+  this->BatchPoseRow = -1;
+  this->EventStartTime = 0.0;
+  this->CoalescePoses = false;
+  this->FramePose = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->FramePoseValid = false;
+  this->DriverTransform = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->ParentTransform = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->SliceTransform = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->ResliceRASToIJK = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->PoseHistoryCapacity = 1024;
+  this->NumberOfThreads = 1;
+  this->Threader = vtkMultiThreader::New();
+  this->TaskSchedulingEnabled = false;
+  this->TaskScheduler = vtkSmartPointer< vtkResliceTaskScheduler >::New();
+  this->ResliceQuantizationBits = 0;
+  this->ResliceQuantizationCompressed = false;
+  this->ResliceAllLayers = false;
+  this->AsyncResliceEnabled = false;
+  this->AsyncResliceBuffers = 3;
+  this->TimeSeriesTime = 0.0;
+  this->TimeSeriesTimeValid = false;
+  this->TimeSeriesPrefetchCapacity = 4;
+  this->LabelOutlinesEnabled = false;
+  this->ModelToWorld = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->WorldToModel = vtkSmartPointer< vtkMatrix4x4 >::New();
 }
 
 
@@ -50,6 +154,13 @@ vtkSlicerVolumeResliceDriverLogic
 ::~vtkSlicerVolumeResliceDriverLogic()
 {
   this->ClearObservedNodes();
+  this->FrameCompounder->Delete();
+  this->ImageServer->Stop();
+  this->ImageServer->Delete();
+  this->ResliceCache->Delete();
+  this->Tracer->Delete();
+  this->PoseChannel->Delete();
+  this->Threader->Delete();
 }
 
 
@@ -68,6 +179,34 @@ void vtkSlicerVolumeResliceDriverLogic
   }
   
   os << std::endl;
+  
+  os << indent << "Compounding: " << ( this->CompoundingEnabled ? "On" : "Off" ) << std::endl;
+  this->FrameCompounder->PrintSelf( os, indent.GetNextIndent() );
+  
+  os << indent << "Reslice output: " << ( this->ResliceOutputEnabled ? "On" : "Off" ) << std::endl;
+  os << indent << "Reslice all layers: " << ( this->ResliceAllLayers ? "On" : "Off" ) << std::endl;
+  os << indent << "Async reslice: " << ( this->AsyncResliceEnabled ? "On" : "Off" )
+     << ", " << this->AsyncResliceBuffers << " buffers" << std::endl;
+  os << indent << "Time series: " << this->TimeSeriesVolumes.size() << ", time " << this->TimeSeriesTime
+     << ", prefetch " << this->TimeSeriesPrefetchCapacity << " time points" << std::endl;
+  os << indent << "Label outlines: " << ( this->LabelOutlinesEnabled ? "On" : "Off" ) << std::endl;
+  os << indent << "Intersection models: " << this->ModelIntersectors.size() << std::endl;
+  os << indent << "Pose history capacity: " << this->PoseHistoryCapacity << std::endl;
+  os << indent << "Number of threads: " << this->NumberOfThreads << std::endl;
+  os << indent << "Task scheduling: " << ( this->TaskSchedulingEnabled ? "On" : "Off" ) << std::endl;
+  this->TaskScheduler->PrintSelf( os, indent.GetNextIndent() );
+  os << indent << "Reslice quantization: " << this->ResliceQuantizationBits << " bits"
+     << ( this->ResliceQuantizationCompressed ? ", compressed" : "" ) << std::endl;
+  os << indent << "Image server:" << std::endl;
+  this->ImageServer->PrintSelf( os, indent.GetNextIndent() );
+  os << indent << "Reslice cache:" << std::endl;
+  this->ResliceCache->PrintSelf( os, indent.GetNextIndent() );
+  os << indent << "Tracer:" << std::endl;
+  this->Tracer->PrintSelf( os, indent.GetNextIndent() );
+  os << indent << "Pose channel:" << std::endl;
+  this->PoseChannel->PrintSelf( os, indent.GetNextIndent() );
+  os << indent << "Pose table:" << std::endl;
+  this->PoseTable->PrintSelf( os, indent.GetNextIndent() );
 }
 
 
@@ -79,6 +218,7 @@ void vtkSlicerVolumeResliceDriverLogic
   if ( node == NULL )
   {
     sliceNode->RemoveAttribute( VOLUMERESLICEDRIVER_DRIVER_ATTRIBUTE );
+    this->UpdateDrivenSlices();
     return;
   }
   
@@ -86,13 +226,15 @@ void vtkSlicerVolumeResliceDriverLogic
   if ( tnode == NULL )
   {
     sliceNode->RemoveAttribute( VOLUMERESLICEDRIVER_DRIVER_ATTRIBUTE );
+    this->UpdateDrivenSlices();
     return;
   }
   
   sliceNode->SetAttribute( VOLUMERESLICEDRIVER_DRIVER_ATTRIBUTE, nodeID.c_str() );
   this->AddObservedNode( tnode );
+  this->UpdateDrivenSlices();
   
-  this->UpdateSliceIfObserved( sliceNode );
+  this->RecomputeSlice( sliceNode );
 }
 
 
@@ -113,8 +255,9 @@ void vtkSlicerVolumeResliceDriverLogic
   std::stringstream methodSS;
   methodSS << method;
   sliceNode->SetAttribute( VOLUMERESLICEDRIVER_METHOD_ATTRIBUTE, methodSS.str().c_str() );
+  this->UpdateDrivenSlices();
   
-  this->UpdateSliceIfObserved( sliceNode );
+  this->RecomputeSlice( sliceNode );
 }
 
 
@@ -135,251 +278,1525 @@ void vtkSlicerVolumeResliceDriverLogic
   std::stringstream orientationSS;
   orientationSS << orientation;
   sliceNode->SetAttribute( VOLUMERESLICEDRIVER_ORIENTATION_ATTRIBUTE, orientationSS.str().c_str() );
+  this->UpdateDrivenSlices();
   
-  this->UpdateSliceIfObserved( sliceNode );
+  this->RecomputeSlice( sliceNode );
 }
 
 
 
 void vtkSlicerVolumeResliceDriverLogic
-::AddObservedNode( vtkMRMLTransformableNode* node )
+::SetInterpolationForSlice( int interpolation, vtkMRMLSliceNode* sliceNode )
 {
-  for ( unsigned int i = 0; i < this->ObservedNodes.size(); ++ i )
+  if ( sliceNode == NULL )
   {
-    if ( node == this->ObservedNodes[ i ] )
+    return;
+  }
+  
+  if (    interpolation < vtkSliceImageReslicer::INTERPOLATION_NEAREST
+       || interpolation > vtkSliceImageReslicer::INTERPOLATION_LANCZOS )
+  {
+    interpolation = vtkSliceImageReslicer::INTERPOLATION_LINEAR;
+  }
+  
+  std::stringstream interpolationSS;
+  interpolationSS << interpolation;
+  sliceNode->SetAttribute( VOLUMERESLICEDRIVER_INTERPOLATION_ATTRIBUTE, interpolationSS.str().c_str() );
+  this->UpdateDrivenSlices();
+  
+  this->RecomputeSlice( sliceNode );
+}
+
+
+
+bool vtkSlicerVolumeResliceDriverLogic
+::SetSliceConfigurations( const std::vector< SliceConfiguration >& configurations )
+{
+  if ( this->GetMRMLScene() == NULL )
+  {
+    vtkErrorMacro( "SetSliceConfigurations: no scene." );
+    return false;
+  }
+  
+  // Validate everything before changing anything.
+  std::vector< vtkMRMLTransformableNode* > driverNodes( configurations.size(), NULL );
+  for ( unsigned int i = 0; i < configurations.size(); ++ i )
+  {
+    const SliceConfiguration& configuration = configurations[ i ];
+    if ( configuration.SliceNode == NULL || configuration.SliceNode->GetScene() != this->GetMRMLScene() )
     {
-      return;
+      vtkErrorMacro( "SetSliceConfigurations: entry " << i << " has no slice node of this scene." );
+      return false;
+    }
+    if ( configuration.Method < METHOD_DEFAULT || configuration.Method > METHOD_ORIENTATION )
+    {
+      vtkErrorMacro( "SetSliceConfigurations: entry " << i << " has invalid method " << configuration.Method );
+      return false;
+    }
+    if ( configuration.Orientation < ORIENTATION_DEFAULT || configuration.Orientation > ORIENTATION_TRANSVERSE )
+    {
+      vtkErrorMacro( "SetSliceConfigurations: entry " << i << " has invalid orientation " << configuration.Orientation );
+      return false;
+    }
+    if ( configuration.DriverID.empty() )
+    {
+      continue;
+    }
+    driverNodes[ i ] = vtkMRMLTransformableNode::SafeDownCast(
+      this->GetMRMLScene()->GetNodeByID( configuration.DriverID ) );
+    if ( driverNodes[ i ] == NULL )
+    {
+      vtkErrorMacro( "SetSliceConfigurations: entry " << i << " has no transformable driver "
+                     << configuration.DriverID );
+      return false;
     }
   }
   
   int wasModifying = this->StartModify();
   
-  vtkMRMLTransformableNode* newNode = NULL;
+  for ( unsigned int i = 0; i < configurations.size(); ++ i )
+  {
+    const SliceConfiguration& configuration = configurations[ i ];
+    vtkMRMLSliceNode* sliceNode = configuration.SliceNode;
+    int method = ( configuration.Method == METHOD_DEFAULT ) ? METHOD_POSITION : configuration.Method;
+    int orientation = ( configuration.Orientation == ORIENTATION_DEFAULT ) ? ORIENTATION_INPLANE
+                                                                            : configuration.Orientation;
+    
+    int wasModifyingSlice = sliceNode->StartModify();
+    if ( driverNodes[ i ] == NULL )
+    {
+      sliceNode->RemoveAttribute( VOLUMERESLICEDRIVER_DRIVER_ATTRIBUTE );
+    }
+    else
+    {
+      sliceNode->SetAttribute( VOLUMERESLICEDRIVER_DRIVER_ATTRIBUTE, configuration.DriverID.c_str() );
+      this->AddObservedNode( driverNodes[ i ] );
+    }
+    std::stringstream methodSS;
+    methodSS << method;
+    sliceNode->SetAttribute( VOLUMERESLICEDRIVER_METHOD_ATTRIBUTE, methodSS.str().c_str() );
+    std::stringstream orientationSS;
+    orientationSS << orientation;
+    sliceNode->SetAttribute( VOLUMERESLICEDRIVER_ORIENTATION_ATTRIBUTE, orientationSS.str().c_str() );
+    sliceNode->EndModify( wasModifyingSlice );
+  }
   
-  vtkSmartPointer< vtkIntArray > events = vtkSmartPointer< vtkIntArray >::New();
-  events->InsertNextValue( vtkMRMLTransformableNode::TransformModifiedEvent );
-  events->InsertNextValue( vtkCommand::ModifiedEvent );
-  events->InsertNextValue( vtkMRMLVolumeNode::ImageDataModifiedEvent );
-  vtkSetAndObserveMRMLNodeEventsMacro( newNode, node, events );
-  this->ObservedNodes.push_back( newNode );
+  this->UpdateDrivenSlices();
+  
+  // A slice listed twice is still updated once.
+  std::vector< vtkMRMLSliceNode* > updatedSlices;
+  for ( unsigned int i = 0; i < configurations.size(); ++ i )
+  {
+    vtkMRMLSliceNode* sliceNode = configurations[ i ].SliceNode;
+    if (    driverNodes[ i ] != NULL
+         && std::find( updatedSlices.begin(), updatedSlices.end(), sliceNode ) == updatedSlices.end() )
+    {
+      this->RecomputeSlice( sliceNode );
+      updatedSlices.push_back( sliceNode );
+    }
+  }
   
+  this->Modified();
   this->EndModify( wasModifying );
+  return true;
 }
 
 
 
 void vtkSlicerVolumeResliceDriverLogic
-::ClearObservedNodes()
+::SetTemporalOffsetForDriver( std::string nodeID, double offset )
 {
-  for ( unsigned int i = 0; i < this->ObservedNodes.size(); ++ i )
+  vtkMRMLNode* node = this->GetMRMLScene() ? this->GetMRMLScene()->GetNodeByID( nodeID ) : NULL;
+  if ( node == NULL )
   {
-    vtkSetAndObserveMRMLNodeMacro( this->ObservedNodes[ i ], 0 );
+    return;
   }
   
-  this->ObservedNodes.clear();
+  std::stringstream offsetSS;
+  offsetSS << offset;
+  node->SetAttribute( VOLUMERESLICEDRIVER_TEMPORAL_OFFSET_ATTRIBUTE, offsetSS.str().c_str() );
+  this->UpdateDrivenSlices();
 }
 
 
 
-void vtkSlicerVolumeResliceDriverLogic::SetMRMLSceneInternal(vtkMRMLScene * newScene)
-{
-  vtkNew<vtkIntArray> events;
-  events->InsertNextValue(vtkMRMLScene::NodeAddedEvent);
-  events->InsertNextValue(vtkMRMLScene::NodeRemovedEvent);
-  events->InsertNextValue(vtkMRMLScene::EndBatchProcessEvent);
-  this->SetAndObserveMRMLSceneEventsInternal(newScene, events.GetPointer());
-}
-
-//-----------------------------------------------------------------------------
-void vtkSlicerVolumeResliceDriverLogic::RegisterNodes()
+double vtkSlicerVolumeResliceDriverLogic
+::GetTemporalOffsetForDriver( std::string nodeID )
 {
-  assert(this->GetMRMLScene() != 0);
+  vtkMRMLNode* node = this->GetMRMLScene() ? this->GetMRMLScene()->GetNodeByID( nodeID ) : NULL;
+  const char* offsetCC = ( node != NULL ) ? node->GetAttribute( VOLUMERESLICEDRIVER_TEMPORAL_OFFSET_ATTRIBUTE ) : NULL;
+  return ( offsetCC != NULL ) ? atof( offsetCC ) : 0.0;
 }
 
 
 
-/// This method is called by Slicer after each significant MRML scene event (import, load, etc.)
 void vtkSlicerVolumeResliceDriverLogic
-::UpdateFromMRMLScene()
+::SetPoseHistoryCapacity( int capacity )
 {
-  assert(this->GetMRMLScene() != 0);
-  
-  // Check if any of the slice nodes contain driver transoforms that need to be observed.
-  
-  vtkCollection* sliceNodes = this->GetMRMLScene()->GetNodesByClass( "vtkMRMLSliceNode" );
-  vtkCollectionIterator* sliceIt = vtkCollectionIterator::New();
-  sliceIt->SetCollection( sliceNodes );
-  for ( sliceIt->InitTraversal(); ! sliceIt->IsDoneWithTraversal(); sliceIt->GoToNextItem() )
+  capacity = capacity < 2 ? 2 : capacity;
+  if ( this->PoseHistoryCapacity == capacity )
   {
-    vtkMRMLSliceNode* slice = vtkMRMLSliceNode::SafeDownCast( sliceIt->GetCurrentObject() );
-    if ( slice == NULL )
-    {
-      continue;
-    }
-    const char* driverCC = slice->GetAttribute( VOLUMERESLICEDRIVER_DRIVER_ATTRIBUTE );
-    if ( driverCC == NULL )
-    {
-      continue;
-    }
-    vtkMRMLNode* driverNode = this->GetMRMLScene()->GetNodeByID( driverCC );
-    if ( driverNode == NULL )
-    {
-      continue;
-    }
-    vtkMRMLTransformableNode* driverTransformable = vtkMRMLTransformableNode::SafeDownCast( driverNode );
-    if ( driverTransformable == NULL )
-    {
-      continue;
-    }
-    this->AddObservedNode( driverTransformable );
+    return;
   }
-  sliceIt->Delete();
-  sliceNodes->Delete();
   
+  this->PoseHistoryCapacity = capacity;
+  for ( DriverMapType::iterator driverIt = this->Drivers.begin(); driverIt != this->Drivers.end(); ++ driverIt )
+  {
+    driverIt->second.PoseHistory->SetCapacity( capacity );
+  }
   this->Modified();
 }
 
-//---------------------------------------------------------------------------
-void vtkSlicerVolumeResliceDriverLogic
-::OnMRMLSceneNodeAdded(vtkMRMLNode* vtkNotUsed(node))
+
+
+vtkDriverPoseHistory* vtkSlicerVolumeResliceDriverLogic
+::GetPoseHistory( const std::string& nodeID )
 {
+  vtkMRMLNode* node = this->GetMRMLScene() ? this->GetMRMLScene()->GetNodeByID( nodeID ) : NULL;
+  DriverMapType::iterator driverIt = this->Drivers.find( node );
+  if ( driverIt == this->Drivers.end() )
+  {
+    return NULL;
+  }
+  return driverIt->second.PoseHistory;
 }
 
-//---------------------------------------------------------------------------
-void vtkSlicerVolumeResliceDriverLogic
-::OnMRMLSceneNodeRemoved(vtkMRMLNode* vtkNotUsed(node))
+
+
+bool vtkSlicerVolumeResliceDriverLogic
+::GetDriverPoseAtTime( std::string nodeID, double time, vtkMatrix4x4* pose )
 {
+  vtkDriverPoseHistory* history = this->GetPoseHistory( nodeID );
+  return history != NULL && history->GetPose( time, pose ) != vtkDriverPoseHistory::POSE_NONE;
 }
 
 
 
-void vtkSlicerVolumeResliceDriverLogic
-::OnMRMLNodeModified( vtkMRMLNode* node )
+int vtkSlicerVolumeResliceDriverLogic
+::ExportDriverPoseHistory( std::string nodeID, double start, double end,
+                           vtkDoubleArray* times, vtkDoubleArray* poses )
 {
-  std::cout << "Observed node modified." << std::endl;
+  vtkDriverPoseHistory* history = this->GetPoseHistory( nodeID );
+  if ( history == NULL )
+  {
+    times->Initialize();
+    poses->Initialize();
+    return 0;
+  }
+  return history->ExportWindow( start, end, times, poses );
 }
 
 
 
 void vtkSlicerVolumeResliceDriverLogic
-::ProcessMRMLNodesEvents( vtkObject* caller, unsigned long event, void * callData )
+::SetCompoundingEnabled( bool enabled )
 {
-  if ( caller == NULL )
+  if ( this->CompoundingEnabled == enabled )
   {
     return;
   }
   
-  if (    event != vtkMRMLTransformableNode::TransformModifiedEvent
-       && event != vtkCommand::ModifiedEvent
-       && event != vtkMRMLVolumeNode::ImageDataModifiedEvent )
+  this->CompoundingEnabled = enabled;
+  this->Modified();
+}
+
+
+
+bool vtkSlicerVolumeResliceDriverLogic
+::GetCompoundingEnabled()
+{
+  return this->CompoundingEnabled;
+}
+
+
+
+vtkImageFrameCompounder* vtkSlicerVolumeResliceDriverLogic
+::GetFrameCompounder()
+{
+  return this->FrameCompounder;
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::SetResliceOutputEnabled( bool enabled )
+{
+  if ( this->ResliceOutputEnabled == enabled )
   {
-    this->Superclass::ProcessMRMLNodesEvents( caller, event, callData );
+    return;
   }
   
-  vtkMRMLTransformableNode* callerNode = vtkMRMLTransformableNode::SafeDownCast( caller );
-  if ( callerNode == NULL )
+  this->ResliceOutputEnabled = enabled;
+  this->Modified();
+}
+
+
+
+bool vtkSlicerVolumeResliceDriverLogic
+::GetResliceOutputEnabled()
+{
+  return this->ResliceOutputEnabled;
+}
+
+
+
+vtkImageData* vtkSlicerVolumeResliceDriverLogic
+::GetResliceOutput( vtkMRMLSliceNode* sliceNode )
+{
+  if ( this->ResliceAllLayers )
   {
-    return;
+    return this->GetResliceLayerOutput( sliceNode, LAYER_BACKGROUND );
   }
-  
-  std::string callerNodeID( callerNode->GetID() );
-  
-  vtkMRMLNode* node = 0;
-  std::vector< vtkMRMLSliceNode* > SlicesToDrive;
-  
-  vtkCollection* sliceNodes = this->GetMRMLScene()->GetNodesByClass( "vtkMRMLSliceNode" );
-  vtkCollectionIterator* sliceIt = vtkCollectionIterator::New();
-  sliceIt->SetCollection( sliceNodes );
-  sliceIt->InitTraversal();
-  for ( unsigned int i = 0; i < sliceNodes->GetNumberOfItems(); ++ i )
+  if ( this->AsyncResliceEnabled )
   {
-    vtkMRMLSliceNode* sliceNode = vtkMRMLSliceNode::SafeDownCast( sliceIt->GetCurrentObject() );
-    sliceIt->GoToNextItem();
-    const char* driverCC = sliceNode->GetAttribute( VOLUMERESLICEDRIVER_DRIVER_ATTRIBUTE );
-    if (    sliceNode != NULL
-         && driverCC != NULL
-         && callerNodeID.compare( std::string( driverCC ) ) == 0 )
-    {
-      SlicesToDrive.push_back( sliceNode );
-    }
+    vtkAsyncSliceReslicer* reslicer = this->GetAsyncReslicer( sliceNode );
+    return ( reslicer != NULL ) ? reslicer->GetOutput() : NULL;
   }
-  sliceIt->Delete();
-  sliceNodes->Delete();
-  
-  for ( unsigned int i = 0; i < SlicesToDrive.size(); ++ i )
+  vtkTimeSeriesSliceReslicer* seriesReslicer = this->GetTimeSeriesReslicer( sliceNode );
+  if ( seriesReslicer != NULL )
+  {
+    return seriesReslicer->GetOutput();
+  }
+  SliceReslicerMapType::iterator it = this->SliceReslicers.find( sliceNode );
+  if ( it == this->SliceReslicers.end() )
   {
-    this->UpdateSliceByTransformableNode( callerNode, SlicesToDrive[ i ] );
+    return NULL;
   }
+  return it->second->GetOutput();
 }
 
 
 
 void vtkSlicerVolumeResliceDriverLogic
-::UpdateSliceByTransformableNode( vtkMRMLTransformableNode* tnode, vtkMRMLSliceNode* sliceNode )
+::SetResliceAllLayers( bool enabled )
 {
-  vtkMRMLLinearTransformNode* transformNode = vtkMRMLLinearTransformNode::SafeDownCast( tnode );
-  if ( transformNode != NULL )
+  if ( this->ResliceAllLayers == enabled )
   {
-    this->UpdateSliceByTransformNode( transformNode, sliceNode );
+    return;
   }
   
-  vtkMRMLScalarVolumeNode* imageNode = vtkMRMLScalarVolumeNode::SafeDownCast( tnode );
-  if ( imageNode != NULL )
+  this->ResliceAllLayers = enabled;
+  this->Modified();
+}
+
+
+
+bool vtkSlicerVolumeResliceDriverLogic
+::GetResliceAllLayers()
+{
+  return this->ResliceAllLayers;
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::SetAsyncResliceEnabled( bool enabled )
+{
+  if ( this->AsyncResliceEnabled == enabled )
   {
-    this->UpdateSliceByImageNode( imageNode, sliceNode );
+    return;
   }
+  
+  // Stops the workers; frames still in flight are dropped.
+  this->SliceAsyncReslicers.clear();
+  this->AsyncResliceEnabled = enabled;
+  this->Modified();
+}
+
+
+
+bool vtkSlicerVolumeResliceDriverLogic
+::GetAsyncResliceEnabled()
+{
+  return this->AsyncResliceEnabled;
 }
 
 
 
 void vtkSlicerVolumeResliceDriverLogic
-::UpdateSliceByTransformNode( vtkMRMLLinearTransformNode* tnode, vtkMRMLSliceNode* sliceNode )
+::SetAsyncResliceBuffers( int numberOfBuffers )
 {
-  if ( ! tnode)
+  numberOfBuffers = std::min( 3, std::max( 2, numberOfBuffers ) );
+  if ( this->AsyncResliceBuffers == numberOfBuffers )
   {
     return;
   }
+  
+  // Workers are created again, with the new buffers, on the next update.
+  this->SliceAsyncReslicers.clear();
+  this->AsyncResliceBuffers = numberOfBuffers;
+  this->Modified();
+}
 
-  vtkSmartPointer< vtkMatrix4x4 > transform = vtkSmartPointer< vtkMatrix4x4 >::New();
-  transform->Identity();
-  int getTransf = tnode->GetMatrixTransformToWorld( transform );
-  if( getTransf != 0 )
+
+
+int vtkSlicerVolumeResliceDriverLogic
+::GetAsyncResliceBuffers()
+{
+  return this->AsyncResliceBuffers;
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::SetTaskSchedulingEnabled( bool enabled )
+{
+  if ( this->TaskSchedulingEnabled == enabled )
+  {
+    return;
+  }
+  
+  this->TaskSchedulingEnabled = enabled;
+  if ( ! enabled )
   {
-    this->UpdateSlice( transform, sliceNode );
+    // Releases the pool threads until scheduling is on again.
+    this->TaskScheduler->Stop();
   }
+  this->Modified();
 }
 
 
-void vtkSlicerVolumeResliceDriverLogic
-::UpdateSliceByImageNode( vtkMRMLScalarVolumeNode* inode, vtkMRMLSliceNode* sliceNode )
+
+bool vtkSlicerVolumeResliceDriverLogic
+::GetTaskSchedulingEnabled()
 {
-  vtkMRMLVolumeNode* volumeNode = inode;
+  return this->TaskSchedulingEnabled;
+}
 
-  if (volumeNode == NULL)
+
+
+vtkResliceTaskScheduler* vtkSlicerVolumeResliceDriverLogic
+::GetTaskScheduler()
+{
+  return this->TaskScheduler;
+}
+
+
+
+int vtkSlicerVolumeResliceDriverLogic
+::PollAsyncResliceOutputs()
+{
+  int numberOfFrames = 0;
+  for ( SliceAsyncReslicerMapType::iterator it = this->SliceAsyncReslicers.begin();
+        it != this->SliceAsyncReslicers.end(); ++ it )
+  {
+    vtkAsyncSliceReslicer* reslicer = it->second;
+    if ( reslicer->CollectOutput() )
     {
-    return;
+      this->PublishResliceOutput( it->first, reslicer->GetOutput(), reslicer->GetOutputXYToRAS() );
+      ++ numberOfFrames;
     }
+  }
+  return numberOfFrames;
+}
 
-  vtkSmartPointer<vtkMatrix4x4> rtimgTransform = vtkSmartPointer<vtkMatrix4x4>::New();
-  volumeNode->GetIJKToRASMatrix(rtimgTransform);
 
-  float tx = rtimgTransform->GetElement(0, 0);
-  float ty = rtimgTransform->GetElement(1, 0);
-  float tz = rtimgTransform->GetElement(2, 0);
-  float sx = rtimgTransform->GetElement(0, 1);
-  float sy = rtimgTransform->GetElement(1, 1);
-  float sz = rtimgTransform->GetElement(2, 1);
-  float nx = rtimgTransform->GetElement(0, 2);
-  float ny = rtimgTransform->GetElement(1, 2);
-  float nz = rtimgTransform->GetElement(2, 2);
-  float px = rtimgTransform->GetElement(0, 3);
-  float py = rtimgTransform->GetElement(1, 3);
-  float pz = rtimgTransform->GetElement(2, 3);
 
-  vtkImageData* imageData;
-  imageData = volumeNode->GetImageData();
-  int size[3];
-  imageData->GetDimensions(size);
+vtkAsyncSliceReslicer* vtkSlicerVolumeResliceDriverLogic
+::GetAsyncReslicer( vtkMRMLSliceNode* sliceNode )
+{
+  SliceAsyncReslicerMapType::iterator it = this->SliceAsyncReslicers.find( sliceNode );
+  if ( it == this->SliceAsyncReslicers.end() )
+  {
+    return NULL;
+  }
+  return it->second;
+}
+
+
+
+vtkImageData* vtkSlicerVolumeResliceDriverLogic
+::GetResliceLayerOutput( vtkMRMLSliceNode* sliceNode, int layer )
+{
+  if ( ! this->ResliceAllLayers )
+  {
+    return NULL;
+  }
+  SliceLayerReslicerMapType::iterator it = this->SliceLayerReslicers.find( sliceNode );
+  if ( it == this->SliceLayerReslicers.end() )
+  {
+    return NULL;
+  }
+  return it->second->GetOutput( layer );
+}
+
+
+
+bool vtkSlicerVolumeResliceDriverLogic
+::SetTimeSeries( vtkMRMLScalarVolumeNode* volumeNode,
+                 const std::vector< vtkMRMLScalarVolumeNode* >& timePoints,
+                 const std::vector< double >& times )
+{
+  if ( volumeNode == NULL || volumeNode->GetImageData() == NULL || timePoints.empty()
+       || timePoints.size() != times.size() )
+  {
+    vtkErrorMacro( "SetTimeSeries: a volume with an image and as many times as time points are needed." );
+    return false;
+  }
+  vtkImageData* image = volumeNode->GetImageData();
+  for ( size_t i = 0; i < timePoints.size(); ++ i )
+  {
+    vtkImageData* timePointImage = ( timePoints[ i ] != NULL ) ? timePoints[ i ]->GetImageData() : NULL;
+    if (    timePointImage == NULL
+         || timePointImage->GetScalarType() != image->GetScalarType()
+         || timePointImage->GetNumberOfScalarComponents() != image->GetNumberOfScalarComponents()
+         || ! std::equal( timePointImage->GetExtent(), timePointImage->GetExtent() + 6, image->GetExtent() )
+         || ( i > 0 && times[ i ] <= times[ i - 1 ] ) )
+    {
+      vtkErrorMacro( "SetTimeSeries: time point " << i << " does not match " << volumeNode->GetID()
+                     << " or is not later than the previous." );
+      return false;
+    }
+  }
+  
+  TimeSeries& series = this->TimeSeriesVolumes[ volumeNode ];
+  series.TimePoints = timePoints;
+  series.Times = times;
+  // The next SetTimeSeriesTime() shows the new series, even at the same time.
+  this->TimeSeriesTimeValid = false;
+  this->Modified();
+  return true;
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::RemoveTimeSeries( vtkMRMLScalarVolumeNode* volumeNode )
+{
+  if ( this->TimeSeriesVolumes.erase( volumeNode ) == 0 )
+  {
+    return;
+  }
+  // Reslicers hold the images of the time points; the slices still
+  // showing a series get new ones at their next update.
+  this->SliceTimeSeriesReslicers.clear();
+  this->TimeSeriesTimeValid = false;
+  this->Modified();
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::SetTimeSeriesTime( double time )
+{
+  if ( this->TimeSeriesTimeValid && time == this->TimeSeriesTime )
+  {
+    return;
+  }
+  this->TimeSeriesTime = time;
+  this->TimeSeriesTimeValid = true;
+  if (    this->TimeSeriesVolumes.empty()
+       || ! ( this->ResliceOutputEnabled || this->ImageServer->IsRunning() )
+       || this->ResliceAllLayers || this->AsyncResliceEnabled )
+  {
+    return;
+  }
+  
+  vtkDriverEventTracerSpan span( this->Tracer, "UpdateTimeSeries" );
+  int numberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  for ( DriverMapType::iterator driverIt = this->Drivers.begin(); driverIt != this->Drivers.end(); ++ driverIt )
+  {
+    DrivenSliceListType& slices = driverIt->second.Slices;
+    for ( size_t i = 0; i < slices.size(); ++ i )
+    {
+      vtkTimeSeriesSliceReslicer* reslicer = this->PrepareTimeSeriesResliceOutput( slices[ i ], numberOfThreads );
+      if ( reslicer == NULL )
+      {
+        continue;
+      }
+      // Unchanged if the time stays within the time point shown.
+      unsigned long outputMTime = reslicer->GetOutput()->GetMTime();
+      reslicer->Update();
+      if ( reslicer->GetOutput()->GetMTime() != outputMTime )
+      {
+        vtkMRMLSliceNode* sliceNode = slices[ i ].SliceNode;
+        this->PublishResliceOutput( sliceNode, reslicer->GetOutput(), sliceNode->GetXYToRAS() );
+      }
+    }
+  }
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::SetTimeSeriesPrefetchCapacity( int capacity )
+{
+  capacity = std::max( 0, std::min( capacity, 64 ) );
+  if ( this->TimeSeriesPrefetchCapacity == capacity )
+  {
+    return;
+  }
+  
+  this->TimeSeriesPrefetchCapacity = capacity;
+  for ( SliceTimeSeriesReslicerMapType::iterator it = this->SliceTimeSeriesReslicers.begin();
+        it != this->SliceTimeSeriesReslicers.end(); ++ it )
+  {
+    it->second->SetPrefetchCapacity( capacity );
+  }
+  this->Modified();
+}
+
+
+
+vtkTimeSeriesSliceReslicer* vtkSlicerVolumeResliceDriverLogic
+::GetTimeSeriesReslicer( vtkMRMLSliceNode* sliceNode )
+{
+  SliceTimeSeriesReslicerMapType::iterator it = this->SliceTimeSeriesReslicers.find( sliceNode );
+  return ( it != this->SliceTimeSeriesReslicers.end() ) ? it->second.GetPointer() : NULL;
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::SetLabelOutlinesEnabled( bool enabled )
+{
+  if ( this->LabelOutlinesEnabled == enabled )
+  {
+    return;
+  }
+  
+  this->LabelOutlinesEnabled = enabled;
+  this->Modified();
+}
+
+
+
+bool vtkSlicerVolumeResliceDriverLogic
+::GetLabelOutlinesEnabled()
+{
+  return this->LabelOutlinesEnabled;
+}
+
+
+
+vtkPolyData* vtkSlicerVolumeResliceDriverLogic
+::GetLabelOutlines( vtkMRMLSliceNode* sliceNode )
+{
+  if ( ! this->LabelOutlinesEnabled )
+  {
+    return NULL;
+  }
+  SliceLabelReslicerMapType::iterator it = this->SliceLabelReslicers.find( sliceNode );
+  if ( it == this->SliceLabelReslicers.end() || it->second->GetInput() == NULL )
+  {
+    return NULL;
+  }
+  return it->second->GetContourOutput();
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::AddIntersectionModel( vtkMRMLModelNode* modelNode )
+{
+  if ( modelNode == NULL || this->ModelIntersectors.count( modelNode ) > 0 )
+  {
+    return;
+  }
+  
+  this->ModelIntersectors[ modelNode ] = vtkSmartPointer< vtkModelPlaneIntersector >::New();
+  this->Modified();
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::RemoveIntersectionModel( vtkMRMLModelNode* modelNode )
+{
+  if ( this->ModelIntersectors.erase( modelNode ) == 0 )
+  {
+    return;
+  }
+  
+  ModelIntersectionMapType::iterator it = this->ModelIntersections.begin();
+  while ( it != this->ModelIntersections.end() )
+  {
+    if ( it->first.second == modelNode )
+    {
+      this->ModelIntersections.erase( it ++ );
+    }
+    else
+    {
+      ++ it;
+    }
+  }
+  this->Modified();
+}
+
+
+
+int vtkSlicerVolumeResliceDriverLogic
+::GetNumberOfIntersectionModels()
+{
+  return static_cast< int >( this->ModelIntersectors.size() );
+}
+
+
+
+vtkPolyData* vtkSlicerVolumeResliceDriverLogic
+::GetModelIntersection( vtkMRMLSliceNode* sliceNode, vtkMRMLModelNode* modelNode )
+{
+  ModelIntersectionMapType::iterator it = this->ModelIntersections.find( std::make_pair( sliceNode, modelNode ) );
+  if ( it == this->ModelIntersections.end() )
+  {
+    return NULL;
+  }
+  return it->second;
+}
+
+
+
+vtkModelPlaneIntersector* vtkSlicerVolumeResliceDriverLogic
+::GetModelIntersector( vtkMRMLModelNode* modelNode )
+{
+  ModelIntersectorMapType::iterator it = this->ModelIntersectors.find( modelNode );
+  if ( it == this->ModelIntersectors.end() )
+  {
+    return NULL;
+  }
+  return it->second;
+}
+
+
+
+vtkResliceImageCache* vtkSlicerVolumeResliceDriverLogic
+::GetResliceCache()
+{
+  return this->ResliceCache;
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::SetResliceQuantization( int bitsPerVoxel, bool compressed )
+{
+  if ( bitsPerVoxel != 0 && bitsPerVoxel != 8 && bitsPerVoxel != 16 )
+  {
+    vtkErrorMacro( "SetResliceQuantization: " << bitsPerVoxel << " bits per voxel, expected 0, 8 or 16." );
+    return;
+  }
+  if (    bitsPerVoxel == this->ResliceQuantizationBits
+       && compressed == this->ResliceQuantizationCompressed )
+  {
+    return;
+  }
+  this->ResliceQuantizationBits = bitsPerVoxel;
+  this->ResliceQuantizationCompressed = compressed;
+  this->QuantizedVolumes.clear();
+  this->Modified();
+}
+
+
+
+vtkQuantizedImage* vtkSlicerVolumeResliceDriverLogic
+::GetQuantizedVolume( vtkMRMLScalarVolumeNode* volumeNode )
+{
+  QuantizedVolumeMapType::iterator it = this->QuantizedVolumes.find( volumeNode );
+  if ( it == this->QuantizedVolumes.end() || it->second->IsEmpty() )
+  {
+    return NULL;
+  }
+  return it->second;
+}
+
+
+
+vtkMRMLScalarVolumeNode* vtkSlicerVolumeResliceDriverLogic
+::AddMappedVolume( vtkMemoryMappedImage* image, const char* name )
+{
+  if ( image == NULL || ! image->IsOpen() || this->GetMRMLScene() == NULL )
+  {
+    vtkErrorMacro( "AddMappedVolume: no open mapped image or no scene." );
+    return NULL;
+  }
+  
+  vtkNew< vtkMRMLScalarVolumeNode > volumeNode;
+  volumeNode->SetName( name );
+  volumeNode->SetAndObserveImageData( image->GetOutput() );
+  this->GetMRMLScene()->AddNode( volumeNode.GetPointer() );
+  this->MappedVolumes[ volumeNode.GetPointer() ] = image;
+  return volumeNode.GetPointer();
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::SetTracingEnabled( bool enabled )
+{
+  if ( this->Tracer->GetEnabled() == enabled )
+  {
+    return;
+  }
+  
+  this->Tracer->SetEnabled( enabled );
+  this->Modified();
+}
+
+
+
+bool vtkSlicerVolumeResliceDriverLogic
+::GetTracingEnabled()
+{
+  return this->Tracer->GetEnabled();
+}
+
+
+
+vtkDriverEventTracer* vtkSlicerVolumeResliceDriverLogic
+::GetTracer()
+{
+  return this->Tracer;
+}
+
+
+
+bool vtkSlicerVolumeResliceDriverLogic
+::WriteTrace( const char* fileName )
+{
+  return this->Tracer->WriteChromeTrace( fileName );
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::SetMRMLCallCallback( MRMLCallCallbackType callback, void* clientData )
+{
+  this->MRMLCallCallback = callback;
+  this->MRMLCallClientData = clientData;
+}
+
+
+
+bool vtkSlicerVolumeResliceDriverLogic
+::StartImageServer( int port )
+{
+  bool started = this->ImageServer->Start( port );
+  this->Modified();
+  return started;
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::StopImageServer()
+{
+  this->ImageServer->Stop();
+  this->Modified();
+}
+
+
+
+vtkResliceImageServer* vtkSlicerVolumeResliceDriverLogic
+::GetImageServer()
+{
+  return this->ImageServer;
+}
+
+
+
+bool vtkSlicerVolumeResliceDriverLogic
+::AttachPoseChannel( const char* name )
+{
+  bool attached = this->PoseChannel->Attach( name );
+  this->Modified();
+  return attached;
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::DetachPoseChannel()
+{
+  this->PoseChannel->Detach();
+  this->Modified();
+}
+
+
+
+bool vtkSlicerVolumeResliceDriverLogic
+::IsPoseChannelAttached()
+{
+  return this->PoseChannel->IsAttached();
+}
+
+
+
+vtkSharedMemoryPoseChannel* vtkSlicerVolumeResliceDriverLogic
+::GetPoseChannel()
+{
+  return this->PoseChannel;
+}
+
+
+
+vtkDriverPoseTable* vtkSlicerVolumeResliceDriverLogic
+::GetPoseTable()
+{
+  return this->PoseTable;
+}
+
+
+
+int vtkSlicerVolumeResliceDriverLogic
+::PollPoseChannel()
+{
+  int numberOfEntries = this->PoseChannel->ReadChangedEntries();
+  if ( numberOfEntries == 0 )
+  {
+    return 0;
+  }
+  // Latency is measured from when the poses were read, on this clock; the
+  // tracker's timestamps are on its own.
+  double arrivalTime = vtkTimerLog::GetUniversalTime();
+  
+  vtkDriverEventTracerSpan span( this->Tracer, "PollPoseChannel" );
+  
+  // First the table rows of all drivers that moved, so that their slice
+  // frames are computed in one batch.
+  this->PolledDrivers.clear();
+  for ( int n = 0; n < numberOfEntries; ++ n )
+  {
+    const vtkSharedMemoryPoseChannel::PoseEntry& entry = this->PoseChannel->GetChangedEntry( n );
+    
+    DriverMapType::iterator driverIt = this->Drivers.begin();
+    for ( ; driverIt != this->Drivers.end(); ++ driverIt )
+    {
+      const char* driverID = driverIt->first->GetID();
+      if ( driverID != NULL && strcmp( driverID, entry.DriverID ) == 0 )
+      {
+        break;
+      }
+    }
+    if ( driverIt == this->Drivers.end() )
+    {
+      continue;
+    }
+    
+    ++ this->NumberOfPoseEvents;
+    Driver& driver = driverIt->second;
+    ++ driver.NumberOfPoseEvents;
+    
+    DrivenSliceListType& slices = driver.Slices;
+    if ( ! entry.Valid )
+    {
+      for ( unsigned int i = 0; i < slices.size(); ++ i )
+      {
+        ++ slices[ i ].Counters.NumberOfDroppedPoses;
+      }
+      continue;
+    }
+    
+    // A driver written to two entries gets the later pose only.
+    bool polled = ( this->PoseTable->GetFlags( driver.PoseRow ) & vtkDriverPoseTable::FLAG_DIRTY ) != 0;
+    this->PoseTable->SetPose( driver.PoseRow, entry.Matrix );
+    if ( polled )
+    {
+      for ( unsigned int i = 0; i < this->PolledDrivers.size(); ++ i )
+      {
+        if ( this->PolledDrivers[ i ].second == &driver )
+        {
+          this->PolledDrivers[ i ].first = n;
+        }
+      }
+      for ( unsigned int i = 0; i < slices.size(); ++ i )
+      {
+        ++ slices[ i ].Counters.NumberOfCoalescedPoses;
+      }
+      continue;
+    }
+    this->PolledDrivers.push_back( std::make_pair( n, &driver ) );
+  }
+  
+  {
+    vtkDriverEventTracerSpan tableSpan( this->Tracer, "UpdatePoseTable" );
+    this->PoseTable->Update();
+  }
+  
+  int applied = 0;
+  for ( unsigned int i = 0; i < this->PolledDrivers.size(); ++ i )
+  {
+    const vtkSharedMemoryPoseChannel::PoseEntry& entry =
+      this->PoseChannel->GetChangedEntry( this->PolledDrivers[ i ].first );
+    Driver& driver = *this->PolledDrivers[ i ].second;
+    
+    // The pose history is kept on the tracker's clock when it has one,
+    // as are the frame timestamps paired against it.
+    this->EventStartTime = arrivalTime;
+    this->CoalescePoses = true;
+    this->DriverTransform->DeepCopy( entry.Matrix );
+    driver.PoseHistory->AddPose( ( entry.Timestamp > 0.0 ) ? entry.Timestamp : arrivalTime, this->DriverTransform );
+    this->BatchPoseRow = driver.PoseRow;
+    this->UpdateSlices( this->DriverTransform, driver );
+    this->BatchPoseRow = -1;
+    ++ applied;
+  }
+  
+  this->Tracer->AddCounter( "PoseEvents", this->NumberOfPoseEvents );
+  return applied;
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::AddObservedNode( vtkMRMLTransformableNode* node )
+{
+  for ( unsigned int i = 0; i < this->ObservedNodes.size(); ++ i )
+  {
+    if ( node == this->ObservedNodes[ i ] )
+    {
+      return;
+    }
+  }
+  
+  int wasModifying = this->StartModify();
+  
+  vtkMRMLTransformableNode* newNode = NULL;
+  
+  vtkSmartPointer< vtkIntArray > events = vtkSmartPointer< vtkIntArray >::New();
+  events->InsertNextValue( vtkMRMLTransformableNode::TransformModifiedEvent );
+  events->InsertNextValue( vtkCommand::ModifiedEvent );
+  events->InsertNextValue( vtkMRMLVolumeNode::ImageDataModifiedEvent );
+  vtkSetAndObserveMRMLNodeEventsMacro( newNode, node, events );
+  this->ObservedNodes.push_back( newNode );
+  
+  this->EndModify( wasModifying );
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::ClearObservedNodes()
+{
+  for ( unsigned int i = 0; i < this->ObservedNodes.size(); ++ i )
+  {
+    vtkSetAndObserveMRMLNodeMacro( this->ObservedNodes[ i ], 0 );
+  }
+  
+  this->ObservedNodes.clear();
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic::SetMRMLSceneInternal(vtkMRMLScene * newScene)
+{
+  vtkNew<vtkIntArray> events;
+  events->InsertNextValue(vtkMRMLScene::NodeAddedEvent);
+  events->InsertNextValue(vtkMRMLScene::NodeRemovedEvent);
+  events->InsertNextValue(vtkMRMLScene::EndBatchProcessEvent);
+  this->SetAndObserveMRMLSceneEventsInternal(newScene, events.GetPointer());
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerVolumeResliceDriverLogic::RegisterNodes()
+{
+  assert(this->GetMRMLScene() != 0);
+}
+
+
+
+/// This method is called by Slicer after each significant MRML scene event (import, load, etc.)
+void vtkSlicerVolumeResliceDriverLogic
+::UpdateFromMRMLScene()
+{
+  assert(this->GetMRMLScene() != 0);
+  
+  // Check if any of the slice nodes contain driver transoforms that need to be observed.
+  
+  vtkCollection* sliceNodes = this->GetMRMLScene()->GetNodesByClass( "vtkMRMLSliceNode" );
+  vtkCollectionIterator* sliceIt = vtkCollectionIterator::New();
+  sliceIt->SetCollection( sliceNodes );
+  for ( sliceIt->InitTraversal(); ! sliceIt->IsDoneWithTraversal(); sliceIt->GoToNextItem() )
+  {
+    vtkMRMLSliceNode* slice = vtkMRMLSliceNode::SafeDownCast( sliceIt->GetCurrentObject() );
+    if ( slice == NULL )
+    {
+      continue;
+    }
+    const char* driverCC = slice->GetAttribute( VOLUMERESLICEDRIVER_DRIVER_ATTRIBUTE );
+    if ( driverCC == NULL )
+    {
+      continue;
+    }
+    vtkMRMLNode* driverNode = this->GetMRMLScene()->GetNodeByID( driverCC );
+    if ( driverNode == NULL )
+    {
+      continue;
+    }
+    vtkMRMLTransformableNode* driverTransformable = vtkMRMLTransformableNode::SafeDownCast( driverNode );
+    if ( driverTransformable == NULL )
+    {
+      continue;
+    }
+    this->AddObservedNode( driverTransformable );
+  }
+  sliceIt->Delete();
+  sliceNodes->Delete();
+  
+  this->UpdateDrivenSlices();
+  this->Modified();
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerVolumeResliceDriverLogic
+::OnMRMLSceneNodeAdded(vtkMRMLNode* node)
+{
+  vtkMRMLSliceNode* sliceNode = vtkMRMLSliceNode::SafeDownCast( node );
+  if ( sliceNode != NULL && sliceNode->GetAttribute( VOLUMERESLICEDRIVER_DRIVER_ATTRIBUTE ) != NULL )
+  {
+    this->UpdateDrivenSlices();
+  }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerVolumeResliceDriverLogic
+::OnMRMLSceneNodeRemoved(vtkMRMLNode* node)
+{
+  vtkMRMLSliceNode* sliceNode = vtkMRMLSliceNode::SafeDownCast( node );
+  if ( sliceNode != NULL )
+  {
+    this->SliceReslicers.erase( sliceNode );
+    this->SliceLayerReslicers.erase( sliceNode );
+    this->SliceAsyncReslicers.erase( sliceNode );
+    this->SliceTimeSeriesReslicers.erase( sliceNode );
+    this->SliceLabelReslicers.erase( sliceNode );
+    ModelIntersectionMapType::iterator it = this->ModelIntersections.begin();
+    while ( it != this->ModelIntersections.end() )
+    {
+      if ( it->first.first == sliceNode )
+      {
+        this->ModelIntersections.erase( it ++ );
+      }
+      else
+      {
+        ++ it;
+      }
+    }
+  }
+  
+  vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast( node );
+  if ( modelNode != NULL )
+  {
+    this->RemoveIntersectionModel( modelNode );
+  }
+  
+  vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast( node );
+  if ( volumeNode != NULL )
+  {
+    this->MappedVolumes.erase( volumeNode );
+    this->QuantizedVolumes.erase( volumeNode );
+    // The series played in the volume, and those it is a time point of.
+    TimeSeriesMapType::iterator seriesIt = this->TimeSeriesVolumes.begin();
+    while ( seriesIt != this->TimeSeriesVolumes.end() )
+    {
+      const std::vector< vtkMRMLScalarVolumeNode* >& timePoints = seriesIt->second.TimePoints;
+      vtkMRMLScalarVolumeNode* seriesVolume = ( seriesIt ++ )->first;
+      if (    seriesVolume == volumeNode
+           || std::find( timePoints.begin(), timePoints.end(), volumeNode ) != timePoints.end() )
+      {
+        this->RemoveTimeSeries( seriesVolume );
+      }
+    }
+  }
+  
+  // The driver table holds node pointers: drivers, slices, composite and
+  // background volume nodes.
+  if ( ! this->Drivers.empty() )
+  {
+    this->UpdateDrivenSlices();
+  }
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::OnMRMLNodeModified( vtkMRMLNode* node )
+{
+  std::cout << "Observed node modified." << std::endl;
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::ProcessMRMLNodesEvents( vtkObject* caller, unsigned long event, void * callData )
+{
+  if ( caller == NULL )
+  {
+    return;
+  }
+  
+  if (    event != vtkMRMLTransformableNode::TransformModifiedEvent
+       && event != vtkCommand::ModifiedEvent
+       && event != vtkMRMLVolumeNode::ImageDataModifiedEvent )
+  {
+    this->Superclass::ProcessMRMLNodesEvents( caller, event, callData );
+  }
+  
+  vtkMRMLTransformableNode* callerNode = vtkMRMLTransformableNode::SafeDownCast( caller );
+  if ( callerNode == NULL )
+  {
+    return;
+  }
+  
+  vtkDriverEventTracerSpan span( this->Tracer, "ProcessMRMLNodesEvents", callerNode->GetID() );
+  this->EventStartTime = vtkTimerLog::GetUniversalTime();
+  // A new image frame may change resliced output even at the same pose.
+  this->CoalescePoses = ( event != vtkMRMLVolumeNode::ImageDataModifiedEvent );
+  ++ this->NumberOfPoseEvents;
+  this->Tracer->AddCounter( "PoseEvents", this->NumberOfPoseEvents );
+  
+  bool newFrame = ( event == vtkMRMLVolumeNode::ImageDataModifiedEvent );
+  if ( newFrame )
+  {
+    this->ResliceCache->InvalidateVolume( callerNode->GetID() );
+  }
+  
+  this->FramePoseValid = false;
+  vtkMRMLScalarVolumeNode* imageNode = vtkMRMLScalarVolumeNode::SafeDownCast( callerNode );
+  DriverMapType::iterator driverIt = this->Drivers.find( callerNode );
+  if ( driverIt == this->Drivers.end() )
+  {
+    // Not driving any slice: no tracker history to pair the frame with.
+    if ( newFrame && this->CompoundingEnabled )
+    {
+      this->CompoundImageNode( imageNode );
+    }
+    return;
+  }
+  
+  Driver& driver = driverIt->second;
+  ++ driver.NumberOfPoseEvents;
+  
+  bool paired = ( imageNode == NULL || this->PairImageFrame( imageNode, event, driver ) );
+  // A new frame arrived on an image driver; compound it once, not per
+  // slice, at the tracker pose paired with its acquisition time.
+  if ( newFrame && this->CompoundingEnabled )
+  {
+    this->CompoundImageNode( imageNode );
+  }
+  if ( ! paired )
+  {
+    return;
+  }
+  
+  // One pose for all slices of the driver.
+  if ( this->GetDriverPose( callerNode, this->DriverTransform ) )
+  {
+    // A plain ModifiedEvent may come from an attribute change, such as a
+    // new timestamp, before the pose it belongs to; it is recorded only if
+    // it moves the driver, as an image driver whose origin changed.
+    if (    event != vtkCommand::ModifiedEvent || ! driver.PoseValid
+         || memcmp( driver.Pose, this->DriverTransform->Element, sizeof( driver.Pose ) ) != 0 )
+    {
+      driver.PoseHistory->AddPose( this->GetNodeTimestamp( callerNode ), this->DriverTransform );
+    }
+    this->UpdateSlices( this->DriverTransform, driver );
+  }
+  else
+  {
+    for ( unsigned int i = 0; i < driver.Slices.size(); ++ i )
+    {
+      ++ driver.Slices[ i ].Counters.NumberOfDroppedPoses;
+    }
+  }
+  this->FramePoseValid = false;
+}
+
+
+
+bool vtkSlicerVolumeResliceDriverLogic
+::PairImageFrame( vtkMRMLScalarVolumeNode* imageNode, unsigned long event, Driver& driver )
+{
+  vtkMRMLLinearTransformNode* trackerNode = NULL;
+  {
+    MRMLCallScope mrmlCall( this->MRMLCallCallback, this->MRMLCallClientData );
+    trackerNode = vtkMRMLLinearTransformNode::SafeDownCast( imageNode->GetParentTransformNode() );
+  }
+  if ( trackerNode == NULL )
+  {
+    return true;
+  }
+  
+  if ( driver.TrackerHistory == NULL )
+  {
+    driver.TrackerHistory = vtkSmartPointer< vtkDriverPoseHistory >::New();
+  }
+  vtkDriverPoseHistory* history = driver.TrackerHistory;
+  
+  if ( event == vtkMRMLTransformableNode::TransformModifiedEvent )
+  {
+    vtkMatrix4x4* trackerPose = this->ParentTransform;
+    trackerPose->Identity();
+    bool tracked = false;
+    {
+      MRMLCallScope mrmlCall( this->MRMLCallCallback, this->MRMLCallClientData );
+      tracked = ( trackerNode->GetMatrixTransformToWorld( trackerPose ) != 0 );
+    }
+    if ( tracked )
+    {
+      history->AddPose( this->GetNodeTimestamp( trackerNode ), trackerPose );
+    }
+  }
+  
+  // Until two tracker poses are known, frames take the current one.
+  if ( history->GetNumberOfSamples() < 2 )
+  {
+    return true;
+  }
+  // After that the slices move with the frames only, each at the tracker
+  // pose of its acquisition time.
+  if ( event != vtkMRMLVolumeNode::ImageDataModifiedEvent )
+  {
+    return false;
+  }
+  
+  double frameTime = this->GetNodeTimestamp( imageNode ) + driver.TemporalOffset;
+  int paired = history->GetPose( frameTime, this->FramePose );
+  if ( paired == vtkDriverPoseHistory::POSE_INTERPOLATED )
+  {
+    ++ driver.NumberOfInterpolatedFrames;
+  }
+  else if ( paired == vtkDriverPoseHistory::POSE_EXTRAPOLATED )
+  {
+    ++ driver.NumberOfExtrapolatedFrames;
+  }
+  this->FramePoseValid = ( paired != vtkDriverPoseHistory::POSE_NONE );
+  return true;
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::UpdateDrivenSlices()
+{
+  // Counters survive the rebuild; cached poses and nodes do not.
+  DriverMapType previousDrivers;
+  previousDrivers.swap( this->Drivers );
+  if ( this->GetMRMLScene() == NULL )
+  {
+    return;
+  }
+  
+  vtkCollection* sliceNodes = this->GetMRMLScene()->GetNodesByClass( "vtkMRMLSliceNode" );
+  vtkCollectionIterator* sliceIt = vtkCollectionIterator::New();
+  sliceIt->SetCollection( sliceNodes );
+  for ( sliceIt->InitTraversal(); ! sliceIt->IsDoneWithTraversal(); sliceIt->GoToNextItem() )
+  {
+    vtkMRMLSliceNode* sliceNode = vtkMRMLSliceNode::SafeDownCast( sliceIt->GetCurrentObject() );
+    if ( sliceNode == NULL )
+    {
+      continue;
+    }
+    const char* driverCC = sliceNode->GetAttribute( VOLUMERESLICEDRIVER_DRIVER_ATTRIBUTE );
+    vtkMRMLNode* driverNode = ( driverCC != NULL ) ? this->GetMRMLScene()->GetNodeByID( driverCC ) : NULL;
+    if ( driverNode == NULL )
+    {
+      continue;
+    }
+    
+    DrivenSlice slice;
+    slice.DriverNode = driverNode;
+    slice.SliceNode = sliceNode;
+    const char* methodCC = sliceNode->GetAttribute( VOLUMERESLICEDRIVER_METHOD_ATTRIBUTE );
+    slice.Method = ( methodCC != NULL ) ? atoi( methodCC ) : METHOD_POSITION;
+    const char* orientationCC = sliceNode->GetAttribute( VOLUMERESLICEDRIVER_ORIENTATION_ATTRIBUTE );
+    slice.Orientation = ( orientationCC != NULL ) ? atoi( orientationCC ) : ORIENTATION_INPLANE;
+    const char* interpolationCC = sliceNode->GetAttribute( VOLUMERESLICEDRIVER_INTERPOLATION_ATTRIBUTE );
+    slice.Interpolation = ( interpolationCC != NULL ) ? atoi( interpolationCC )
+                                                      : vtkSliceImageReslicer::INTERPOLATION_LINEAR;
+    slice.CompositeNode = this->GetCompositeNodeForSlice( sliceNode );
+    for ( int layer = 0; layer < NUMBER_OF_LAYERS; ++ layer )
+    {
+      slice.LayerVolumes[ layer ] = NULL;
+    }
+    slice.LastPoseValid = false;
+    slice.LastSliceMTime = 0;
+    memset( &slice.Counters, 0, sizeof( slice.Counters ) );
+    
+    Driver& driver = this->Drivers[ driverNode ];
+    const char* offsetCC = driverNode->GetAttribute( VOLUMERESLICEDRIVER_TEMPORAL_OFFSET_ATTRIBUTE );
+    driver.TemporalOffset = ( offsetCC != NULL ) ? atof( offsetCC ) : 0.0;
+    driver.NumberOfPoseEvents = 0;
+    driver.PoseValid = false;
+    driver.NumberOfInterpolatedFrames = 0;
+    driver.NumberOfExtrapolatedFrames = 0;
+    DriverMapType::iterator previousIt = previousDrivers.find( driverNode );
+    if ( previousIt != previousDrivers.end() )
+    {
+      driver.NumberOfPoseEvents = previousIt->second.NumberOfPoseEvents;
+      driver.PoseValid = previousIt->second.PoseValid;
+      memcpy( driver.Pose, previousIt->second.Pose, sizeof( driver.Pose ) );
+      driver.TrackerHistory = previousIt->second.TrackerHistory;
+      driver.PoseHistory = previousIt->second.PoseHistory;
+      driver.NumberOfInterpolatedFrames = previousIt->second.NumberOfInterpolatedFrames;
+      driver.NumberOfExtrapolatedFrames = previousIt->second.NumberOfExtrapolatedFrames;
+      for ( unsigned int i = 0; i < previousIt->second.Slices.size(); ++ i )
+      {
+        if ( previousIt->second.Slices[ i ].SliceNode == sliceNode )
+        {
+          slice.Counters = previousIt->second.Slices[ i ].Counters;
+        }
+      }
+    }
+    if ( driver.PoseHistory == NULL )
+    {
+      // Allocated here, so that recording poses never allocates.
+      driver.PoseHistory = vtkSmartPointer< vtkDriverPoseHistory >::New();
+      driver.PoseHistory->SetCapacity( this->PoseHistoryCapacity );
+    }
+    driver.Slices.push_back( slice );
+  }
+  sliceIt->Delete();
+  sliceNodes->Delete();
+  
+  // Table rows in driver order, written by the polls of the pose channel.
+  this->PoseTable->SetNumberOfRows( static_cast< int >( this->Drivers.size() ) );
+  int row = 0;
+  for ( DriverMapType::iterator driverIt = this->Drivers.begin(); driverIt != this->Drivers.end(); ++ driverIt )
+  {
+    driverIt->second.PoseRow = row ++;
+  }
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::GetPerformanceSnapshot( std::vector< SlicePerformance >& snapshot )
+{
+  snapshot.clear();
+  std::vector< double > latencies;
+  for ( DriverMapType::iterator driverIt = this->Drivers.begin(); driverIt != this->Drivers.end(); ++ driverIt )
+  {
+    vtkMRMLNode* driverNode = driverIt->first;
+    for ( unsigned int i = 0; i < driverIt->second.Slices.size(); ++ i )
+    {
+      const DrivenSlice& slice = driverIt->second.Slices[ i ];
+      SlicePerformance performance;
+      performance.DriverID = driverNode->GetID() ? driverNode->GetID() : "";
+      performance.DriverName = driverNode->GetName() ? driverNode->GetName() : "";
+      performance.SliceID = slice.SliceNode->GetID() ? slice.SliceNode->GetID() : "";
+      performance.SliceName = slice.SliceNode->GetLayoutName() ? slice.SliceNode->GetLayoutName() : "";
+      performance.NumberOfPoseEvents = driverIt->second.NumberOfPoseEvents;
+      performance.NumberOfUpdates = slice.Counters.NumberOfUpdates;
+      performance.NumberOfCoalescedPoses = slice.Counters.NumberOfCoalescedPoses;
+      performance.NumberOfDroppedPoses = slice.Counters.NumberOfDroppedPoses;
+      performance.NumberOfInterpolatedFrames = driverIt->second.NumberOfInterpolatedFrames;
+      performance.NumberOfExtrapolatedFrames = driverIt->second.NumberOfExtrapolatedFrames;
+      
+      unsigned long cached = 0;
+      unsigned long reslices = 0;
+      SliceReslicerMapType::iterator reslicerIt = this->SliceReslicers.find( slice.SliceNode );
+      if ( reslicerIt != this->SliceReslicers.end() )
+      {
+        vtkSliceImageReslicer* reslicer = reslicerIt->second;
+        cached += reslicer->GetNumberOfCachedUpdates();
+        reslices += reslicer->GetNumberOfCachedUpdates() + reslicer->GetNumberOfFullUpdates()
+                    + reslicer->GetNumberOfIncrementalUpdates();
+      }
+      SliceAsyncReslicerMapType::iterator asyncIt = this->SliceAsyncReslicers.find( slice.SliceNode );
+      if ( asyncIt != this->SliceAsyncReslicers.end() )
+      {
+        cached += asyncIt->second->GetNumberOfCachedFrames();
+        reslices += asyncIt->second->GetNumberOfFinishedFrames();
+      }
+      performance.CacheHitRate = ( reslices > 0 ) ? 100.0 * cached / reslices : -1.0;
+      
+      latencies.assign( slice.Counters.Latencies, slice.Counters.Latencies + slice.Counters.NumberOfLatencies );
+      std::sort( latencies.begin(), latencies.end() );
+      const double fractions[3] = { 0.50, 0.95, 0.99 };
+      for ( int p = 0; p < 3; ++ p )
+      {
+        performance.LatencyPercentiles[ p ] = 0.0;
+        if ( ! latencies.empty() )
+        {
+          size_t index = static_cast< size_t >( fractions[ p ] * ( latencies.size() - 1 ) + 0.5 );
+          performance.LatencyPercentiles[ p ] = latencies[ index ] * 1000.0;
+        }
+      }
+      snapshot.push_back( performance );
+    }
+  }
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::UpdateSliceByTransformableNode( vtkMRMLTransformableNode* tnode, DrivenSlice& slice )
+{
+  if ( this->GetDriverPose( tnode, this->DriverTransform ) )
+  {
+    this->UpdateSlice( this->DriverTransform, slice );
+  }
+  else
+  {
+    ++ slice.Counters.NumberOfDroppedPoses;
+  }
+}
+
+
+
+bool vtkSlicerVolumeResliceDriverLogic
+::GetDriverPose( vtkMRMLTransformableNode* tnode, vtkMatrix4x4* pose )
+{
+  vtkMRMLLinearTransformNode* transformNode = vtkMRMLLinearTransformNode::SafeDownCast( tnode );
+  if ( transformNode != NULL )
+  {
+    return this->GetTransformNodePose( transformNode, pose );
+  }
+  
+  vtkMRMLScalarVolumeNode* imageNode = vtkMRMLScalarVolumeNode::SafeDownCast( tnode );
+  if ( imageNode != NULL )
+  {
+    return this->GetImageNodePose( imageNode, pose );
+  }
+  return false;
+}
+
+
+
+bool vtkSlicerVolumeResliceDriverLogic
+::GetTransformNodePose( vtkMRMLLinearTransformNode* tnode, vtkMatrix4x4* pose )
+{
+  if ( ! tnode)
+  {
+    return false;
+  }
+
+  pose->Identity();
+  MRMLCallScope mrmlCall( this->MRMLCallCallback, this->MRMLCallClientData );
+  return tnode->GetMatrixTransformToWorld( pose ) != 0;
+}
+
+
+
+double vtkSlicerVolumeResliceDriverLogic
+::GetNodeTimestamp( vtkMRMLNode* node )
+{
+  MRMLCallScope mrmlCall( this->MRMLCallCallback, this->MRMLCallClientData );
+  const char* timestamp = node->GetAttribute( VOLUMERESLICEDRIVER_TIMESTAMP_ATTRIBUTE );
+  return ( timestamp != NULL ) ? atof( timestamp ) : this->EventStartTime;
+}
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::GetImageFramePose( vtkMatrix4x4* ijkToRAS, const int dimensions[3], vtkMatrix4x4* pose )
+{
+  float tx = ijkToRAS->GetElement(0, 0);
+  float ty = ijkToRAS->GetElement(1, 0);
+  float tz = ijkToRAS->GetElement(2, 0);
+  float sx = ijkToRAS->GetElement(0, 1);
+  float sy = ijkToRAS->GetElement(1, 1);
+  float sz = ijkToRAS->GetElement(2, 1);
+  float nx = ijkToRAS->GetElement(0, 2);
+  float ny = ijkToRAS->GetElement(1, 2);
+  float nz = ijkToRAS->GetElement(2, 2);
+  float px = ijkToRAS->GetElement(0, 3);
+  float py = ijkToRAS->GetElement(1, 3);
+  float pz = ijkToRAS->GetElement(2, 3);
+
+  if (pose != ijkToRAS)
+    {
+    pose->DeepCopy(ijkToRAS);
+    }
 
   // normalize
   float psi = sqrt(tx*tx + ty*ty + tz*tz);
@@ -401,8 +1818,8 @@ void vtkSlicerVolumeResliceDriverLogic
   // OpenIGTLink image has its origin at the center, while VTK image
   // has one at the corner.
 
-  float hfovi = psi * size[0] / 2.0;
-  float hfovj = psj * size[1] / 2.0;
+  float hfovi = psi * dimensions[0] / 2.0;
+  float hfovj = psj * dimensions[1] / 2.0;
   //float hfovk = psk * imgheader->size[2] / 2.0;
   float hfovk = 0;
 
@@ -410,126 +1827,961 @@ void vtkSlicerVolumeResliceDriverLogic
   float cy = nty * hfovi + nsy * hfovj + nny * hfovk;
   float cz = ntz * hfovi + nsz * hfovj + nnz * hfovk;
 
-  rtimgTransform->SetElement(0, 0, ntx);
-  rtimgTransform->SetElement(1, 0, nty);
-  rtimgTransform->SetElement(2, 0, ntz);
-  rtimgTransform->SetElement(0, 1, nsx);
-  rtimgTransform->SetElement(1, 1, nsy);
-  rtimgTransform->SetElement(2, 1, nsz);
-  rtimgTransform->SetElement(0, 2, nnx);
-  rtimgTransform->SetElement(1, 2, nny);
-  rtimgTransform->SetElement(2, 2, nnz);
-  rtimgTransform->SetElement(0, 3, px + cx);
-  rtimgTransform->SetElement(1, 3, py + cy);
-  rtimgTransform->SetElement(2, 3, pz + cz);
+  pose->SetElement(0, 0, ntx);
+  pose->SetElement(1, 0, nty);
+  pose->SetElement(2, 0, ntz);
+  pose->SetElement(0, 1, nsx);
+  pose->SetElement(1, 1, nsy);
+  pose->SetElement(2, 1, nsz);
+  pose->SetElement(0, 2, nnx);
+  pose->SetElement(1, 2, nny);
+  pose->SetElement(2, 2, nnz);
+  pose->SetElement(0, 3, px + cx);
+  pose->SetElement(1, 3, py + cy);
+  pose->SetElement(2, 3, pz + cz);
+}
+
+
+
+bool vtkSlicerVolumeResliceDriverLogic
+::GetImageNodePose( vtkMRMLScalarVolumeNode* inode, vtkMatrix4x4* pose )
+{
+  vtkMRMLVolumeNode* volumeNode = inode;
+
+  if (volumeNode == NULL)
+    {
+    return false;
+    }
+
+  vtkMatrix4x4* rtimgTransform = this->SliceTransform;
+  vtkImageData* imageData;
+  vtkMRMLLinearTransformNode* parentNode;
+  {
+    MRMLCallScope mrmlCall( this->MRMLCallCallback, this->MRMLCallClientData );
+    volumeNode->GetIJKToRASMatrix(rtimgTransform);
+    imageData = volumeNode->GetImageData();
+    parentNode = vtkMRMLLinearTransformNode::SafeDownCast(volumeNode->GetParentTransformNode());
+  }
+  if (imageData == NULL)
+    {
+    return false;
+    }
+  int size[3];
+  imageData->GetDimensions(size);
+
+  GetImageFramePose(rtimgTransform, size, rtimgTransform);
+
+  if (parentNode)
+    {
+    vtkMatrix4x4* parentTransform = this->ParentTransform;
+    parentTransform->Identity();
+    int r = 1;
+    if (this->FramePoseValid)
+      {
+      // Tracker pose at the frame's acquisition time.
+      parentTransform->DeepCopy(this->FramePose);
+      }
+    else
+      {
+      MRMLCallScope mrmlCall( this->MRMLCallCallback, this->MRMLCallClientData );
+      r = parentNode->GetMatrixTransformToWorld(parentTransform);
+      }
+    if (r)
+      {
+      vtkMatrix4x4::Multiply4x4(parentTransform, rtimgTransform,  pose);
+      return true;
+      }
+    }
+
+  pose->DeepCopy( rtimgTransform );
+  return true;
+
+}
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::UpdateSlice( vtkMatrix4x4* transform, DrivenSlice& slice )
+{
+  vtkDriverEventTracerSpan span( this->Tracer, "UpdateSlice", slice.DriverNode->GetID(), slice.SliceNode->GetID() );
+  
+  // Remembered per driver, for recomputing a slice when its settings change.
+  DriverMapType::iterator driverIt = this->Drivers.find( slice.DriverNode );
+  if ( driverIt != this->Drivers.end() )
+  {
+    memcpy( driverIt->second.Pose, transform->Element, sizeof( driverIt->second.Pose ) );
+    driverIt->second.PoseValid = true;
+  }
+  
+  SliceUpdate update;
+  update.Slice = &slice;
+  this->ComputeSliceUpdate( transform, update );
+  if ( ! this->ApplySliceUpdate( transform, update ) )
+  {
+    return;
+  }
+  
+  if ( this->ResliceOutputEnabled || this->ImageServer->IsRunning() )
+  {
+    vtkDriverEventTracerSpan resliceSpan( this->Tracer, "UpdateResliceOutput",
+                                          slice.DriverNode->GetID(), slice.SliceNode->GetID() );
+    int numberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+    if ( this->ResliceAllLayers )
+    {
+      vtkMultiVolumeReslicer* reslicer = this->PrepareLayerResliceOutput( slice, numberOfThreads );
+      if ( reslicer != NULL )
+      {
+        reslicer->Update();
+        this->PublishResliceOutput( slice.SliceNode, reslicer->GetOutput( LAYER_BACKGROUND ),
+                                    slice.SliceNode->GetXYToRAS() );
+      }
+    }
+    else if ( this->AsyncResliceEnabled )
+    {
+      this->SubmitAsyncResliceOutput( slice, numberOfThreads );
+    }
+    else
+    {
+      vtkTimeSeriesSliceReslicer* seriesReslicer = this->PrepareTimeSeriesResliceOutput( slice, numberOfThreads );
+      vtkSliceImageReslicer* reslicer =
+        ( seriesReslicer == NULL ) ? this->PrepareResliceOutput( slice, numberOfThreads ) : NULL;
+      if ( seriesReslicer != NULL )
+      {
+        seriesReslicer->Update();
+        this->PublishResliceOutput( slice.SliceNode, seriesReslicer->GetOutput(), slice.SliceNode->GetXYToRAS() );
+      }
+      else if ( reslicer != NULL )
+      {
+        reslicer->Update();
+        this->PublishResliceOutput( slice.SliceNode, reslicer->GetOutput(), slice.SliceNode->GetXYToRAS() );
+      }
+    }
+  }
+  
+  if ( this->LabelOutlinesEnabled )
+  {
+    vtkDriverEventTracerSpan outlineSpan( this->Tracer, "UpdateLabelOutlines",
+                                          slice.DriverNode->GetID(), slice.SliceNode->GetID() );
+    vtkLabelMapSliceReslicer* outliner = this->PrepareLabelOutlines( slice );
+    if ( outliner != NULL )
+    {
+      outliner->Update();
+      this->InvokeEvent( LabelOutlinesModifiedEvent, slice.SliceNode );
+    }
+  }
+  
+  this->UpdateModelIntersections( slice );
+  this->RecordSliceUpdate( slice );
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::UpdateSlices( vtkMatrix4x4* transform, Driver& driver )
+{
+  DrivenSliceListType& slices = driver.Slices;
+  int numberOfSlices = static_cast< int >( slices.size() );
+  if ( ( this->NumberOfThreads <= 1 && ! this->TaskSchedulingEnabled ) || numberOfSlices < 2 )
+  {
+    for ( int i = 0; i < numberOfSlices; ++ i )
+    {
+      this->UpdateSlice( transform, slices[ i ] );
+    }
+    return;
+  }
+  
+  vtkDriverEventTracerSpan span( this->Tracer, "UpdateSlices", slices[0].DriverNode->GetID() );
+  memcpy( driver.Pose, transform->Element, sizeof( driver.Pose ) );
+  driver.PoseValid = true;
+  
+  int numberOfThreads = ( this->NumberOfThreads < numberOfSlices ) ? this->NumberOfThreads : numberOfSlices;
+  this->Threader->SetNumberOfThreads( numberOfThreads );
+  
+  // Apply phase: MRML is not thread safe, so the slice nodes are written
+  // here, one after another. The planes are computed inline: a few cross
+  // products, and the matrices are composed by MRML in UpdateMatrices(),
+  // so neither is worth a thread.
+  this->SliceUpdates.resize( numberOfSlices );
+  bool reslice = ( this->ResliceOutputEnabled || this->ImageServer->IsRunning() );
+  int numberOfReslices = 0;
+  for ( int i = 0; i < numberOfSlices; ++ i )
+  {
+    SliceUpdate& update = this->SliceUpdates[ i ];
+    update.Slice = &slices[ i ];
+    this->ComputeSliceUpdate( transform, update );
+    update.Applied = this->ApplySliceUpdate( transform, update );
+    update.Reslicer = NULL;
+    update.LayerReslicer = NULL;
+    update.TimeSeriesReslicer = NULL;
+    update.LabelReslicer = NULL;
+    if ( update.Applied && this->LabelOutlinesEnabled )
+    {
+      update.LabelReslicer = this->PrepareLabelOutlines( *update.Slice );
+      numberOfReslices += ( update.LabelReslicer != NULL ) ? 1 : 0;
+    }
+    if ( update.Applied && reslice )
+    {
+      // One thread per reslicer; the slices are spread over the workers.
+      if ( this->ResliceAllLayers )
+      {
+        update.LayerReslicer = this->PrepareLayerResliceOutput( *update.Slice, 1 );
+        numberOfReslices += ( update.LayerReslicer != NULL ) ? 1 : 0;
+      }
+      else if ( this->AsyncResliceEnabled )
+      {
+        // Each slice has a worker of its own already.
+        this->SubmitAsyncResliceOutput( *update.Slice, 1 );
+      }
+      else
+      {
+        update.TimeSeriesReslicer = this->PrepareTimeSeriesResliceOutput( *update.Slice, 1 );
+        if ( update.TimeSeriesReslicer == NULL )
+        {
+          update.Reslicer = this->PrepareResliceOutput( *update.Slice, 1 );
+        }
+        numberOfReslices += ( update.Reslicer != NULL || update.TimeSeriesReslicer != NULL ) ? 1 : 0;
+      }
+    }
+  }
+  
+  // Resample phase: every reslicer works on its own output.
+  if ( numberOfReslices > 0 && this->TaskSchedulingEnabled )
+  {
+    vtkDriverEventTracerSpan resliceSpan( this->Tracer, "ScheduleSlices" );
+    this->ScheduleReslices();
+  }
+  else if ( numberOfReslices > 0 )
+  {
+    vtkDriverEventTracerSpan resliceSpan( this->Tracer, "ResliceSlices" );
+    this->Threader->SetSingleMethod( vtkSlicerVolumeResliceDriverLogic::ResliceThread, this );
+    this->Threader->SingleMethodExecute();
+  }
+  
+  for ( int i = 0; i < numberOfSlices; ++ i )
+  {
+    SliceUpdate& update = this->SliceUpdates[ i ];
+    if ( ! update.Applied )
+    {
+      continue;
+    }
+    vtkMRMLSliceNode* sliceNode = update.Slice->SliceNode;
+    if ( update.Reslicer != NULL )
+    {
+      this->PublishResliceOutput( sliceNode, update.Reslicer->GetOutput(), sliceNode->GetXYToRAS() );
+    }
+    else if ( update.LayerReslicer != NULL )
+    {
+      this->PublishResliceOutput( sliceNode, update.LayerReslicer->GetOutput( LAYER_BACKGROUND ),
+                                  sliceNode->GetXYToRAS() );
+    }
+    else if ( update.TimeSeriesReslicer != NULL )
+    {
+      this->PublishResliceOutput( sliceNode, update.TimeSeriesReslicer->GetOutput(), sliceNode->GetXYToRAS() );
+    }
+    if ( update.LabelReslicer != NULL )
+    {
+      this->InvokeEvent( LabelOutlinesModifiedEvent, update.Slice->SliceNode );
+    }
+    // Model indexes are shared by the slices, so cuts stay on this thread.
+    this->UpdateModelIntersections( *update.Slice );
+    this->RecordSliceUpdate( *update.Slice );
+  }
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::ScheduleReslices()
+{
+  // Bands of all slices in one batch, grouped by slice; label outlines,
+  // traced across rows, and series time points, mostly copied from the
+  // prefetched ones, stay one task each.
+  vtkResliceTaskScheduler* scheduler = this->TaskScheduler;
+  int numberOfSlices = static_cast< int >( this->SliceUpdates.size() );
+  for ( int i = 0; i < numberOfSlices; ++ i )
+  {
+    SliceUpdate& update = this->SliceUpdates[ i ];
+    if ( update.Reslicer != NULL && update.Reslicer->BeginUpdate() > 0 )
+    {
+      update.Reslicer->AddTasks( scheduler, i );
+    }
+    else if ( update.LayerReslicer != NULL && update.LayerReslicer->BeginUpdate() > 0 )
+    {
+      update.LayerReslicer->AddTasks( scheduler, i );
+    }
+    else if ( update.TimeSeriesReslicer != NULL )
+    {
+      scheduler->AddTask( UpdateTimeSeriesTask, update.TimeSeriesReslicer, 0, 1, i );
+    }
+    if ( update.LabelReslicer != NULL )
+    {
+      scheduler->AddTask( UpdateLabelOutlinesTask, update.LabelReslicer, 0, 1, i );
+    }
+  }
+  
+  scheduler->Run();
+  
+  for ( int i = 0; i < numberOfSlices; ++ i )
+  {
+    SliceUpdate& update = this->SliceUpdates[ i ];
+    if ( update.Reslicer != NULL )
+    {
+      update.Reslicer->EndUpdate();
+    }
+    else if ( update.LayerReslicer != NULL )
+    {
+      update.LayerReslicer->EndUpdate();
+    }
+  }
+}
+
 
-  vtkMRMLLinearTransformNode* parentNode =
-    vtkMRMLLinearTransformNode::SafeDownCast(volumeNode->GetParentTransformNode());
-  if (parentNode)
+
+VTK_THREAD_RETURN_TYPE vtkSlicerVolumeResliceDriverLogic
+::ResliceThread( void* arg )
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast< vtkMultiThreader::ThreadInfo* >( arg );
+  vtkSlicerVolumeResliceDriverLogic* self = static_cast< vtkSlicerVolumeResliceDriverLogic* >( info->UserData );
+  
+  int numberOfSlices = static_cast< int >( self->SliceUpdates.size() );
+  for ( int i = info->ThreadID; i < numberOfSlices; i += info->NumberOfThreads )
+  {
+    SliceUpdate& update = self->SliceUpdates[ i ];
+    if ( update.Reslicer != NULL )
     {
-    vtkSmartPointer<vtkMatrix4x4> parentTransform = vtkSmartPointer<vtkMatrix4x4>::New();
-    parentTransform->Identity();
-    int r = parentNode->GetMatrixTransformToWorld(parentTransform);
-    if (r)
-      {
-      vtkSmartPointer<vtkMatrix4x4> transform = vtkSmartPointer<vtkMatrix4x4>::New();
-      vtkMatrix4x4::Multiply4x4(parentTransform, rtimgTransform,  transform);
-      this->UpdateSlice( transform, sliceNode );
-      return;
-      }
+      update.Reslicer->Update();
+    }
+    else if ( update.LayerReslicer != NULL )
+    {
+      update.LayerReslicer->Update();
+    }
+    else if ( update.TimeSeriesReslicer != NULL )
+    {
+      update.TimeSeriesReslicer->Update();
+    }
+    if ( update.LabelReslicer != NULL )
+    {
+      update.LabelReslicer->Update();
     }
+  }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
 
-  this->UpdateSlice( rtimgTransform, sliceNode );
 
+void vtkSlicerVolumeResliceDriverLogic
+::ComputeSliceUpdate( vtkMatrix4x4* transform, SliceUpdate& update )
+{
+  const DrivenSlice& slice = *update.Slice;
+  
+  // Drivers often signal one pose twice (ModifiedEvent and
+  // TransformModifiedEvent). Skip it if nothing moved the slice since.
+  update.Repeat = false;
+  if (    this->CoalescePoses
+       && slice.LastPoseValid
+       && slice.LastSliceMTime == slice.SliceNode->GetMTime() )
+  {
+    bool samePose = true;
+    for ( int k = 0; k < 12 && samePose; ++ k )
+    {
+      samePose = ( slice.LastPose[ k ] == transform->Element[ k / 4 ][ k % 4 ] );
+    }
+    update.Repeat = samePose;
+  }
+  if ( update.Repeat )
+  {
+    return;
+  }
+  
+  if ( this->BatchPoseRow >= 0 )
+  {
+    SlicePlane& plane = update.Plane;
+    plane.Method = slice.Method;
+    plane.Orientation = slice.Orientation;
+    this->PoseTable->GetSliceFrame( this->BatchPoseRow, slice.Method == METHOD_ORIENTATION,
+                                    plane.Transverse, plane.Normal, plane.Position );
+    return;
+  }
+  ComputeSlicePlane( transform, slice.Method, slice.Orientation, update.Plane );
 }
 
 
+
 void vtkSlicerVolumeResliceDriverLogic
-::UpdateSlice( vtkMatrix4x4* transform, vtkMRMLSliceNode* sliceNode )
+::ComputeSlicePlane( vtkMatrix4x4* pose, int method, int orientation, SlicePlane& plane )
 {
-  int method = METHOD_POSITION;
-  const char* methodCC = sliceNode->GetAttribute( VOLUMERESLICEDRIVER_METHOD_ATTRIBUTE );
-  if ( methodCC != NULL )
+  plane.Method = method;
+  plane.Orientation = orientation;
+  for ( int k = 0; k < 3; ++ k )
   {
-    std::stringstream methodSS( methodCC );
-    methodSS >> method;
+    plane.Transverse[ k ] = pose->Element[ k ][0];
+    plane.Normal[ k ] = pose->Element[ k ][2];
+    plane.Position[ k ] = pose->Element[ k ][3];
   }
-  
-  int orientation = ORIENTATION_INPLANE;
-  const char* orientationCC = sliceNode->GetAttribute( VOLUMERESLICEDRIVER_ORIENTATION_ATTRIBUTE );
-  if ( orientationCC != NULL )
+  if ( method == vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION )
   {
-    std::stringstream orientationSS( orientationCC );
-    orientationSS >> orientation;
+    vtkMath::Normalize( plane.Transverse );
+    vtkMath::Normalize( plane.Normal );
   }
-  
-  float tx = transform->Element[0][0];
-  float ty = transform->Element[1][0];
-  float tz = transform->Element[2][0];
-  float nx = transform->Element[0][2];
-  float ny = transform->Element[1][2];
-  float nz = transform->Element[2][2];
-  float px = transform->Element[0][3];
-  float py = transform->Element[1][3];
-  float pz = transform->Element[2][3];
+}
+
+
 
-  if ( orientation == vtkSlicerVolumeResliceDriverLogic::ORIENTATION_INPLANE)
+void vtkSlicerVolumeResliceDriverLogic
+::ApplySlicePlane( vtkMRMLSliceNode* sliceNode, const SlicePlane& plane )
+{
+  const float* n = plane.Normal;
+  const float* t = plane.Transverse;
+  const float* p = plane.Position;
+  
+  if ( plane.Method == vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION )
     {
-    if ( method == vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION)
+    int ntpOrientation = 1;
+    if ( plane.Orientation == vtkSlicerVolumeResliceDriverLogic::ORIENTATION_INPLANE90 )
       {
-      sliceNode->SetSliceToRASByNTP(nx, ny, nz, tx, ty, tz, px, py, pz, 1);
+      ntpOrientation = 2;
       }
-    else
+    else if ( plane.Orientation == vtkSlicerVolumeResliceDriverLogic::ORIENTATION_TRANSVERSE )
       {
-      sliceNode->SetOrientationToAxial();
-      sliceNode->JumpSlice(px, py, pz);
+      ntpOrientation = 0;
       }
+    sliceNode->SetSliceToRASByNTP(n[0], n[1], n[2], t[0], t[1], t[2], p[0], p[1], p[2], ntpOrientation);
     }
-  else if ( orientation == vtkSlicerVolumeResliceDriverLogic::ORIENTATION_INPLANE90 )
+  else
     {
-    if ( method == vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION )
+    if ( plane.Orientation == vtkSlicerVolumeResliceDriverLogic::ORIENTATION_INPLANE90 )
+      {
+      sliceNode->SetOrientationToSagittal();
+      }
+    else if ( plane.Orientation == vtkSlicerVolumeResliceDriverLogic::ORIENTATION_TRANSVERSE )
       {
-      sliceNode->SetSliceToRASByNTP(nx, ny, nz, tx, ty, tz, px, py, pz, 2);
+      sliceNode->SetOrientationToCoronal();
       }
     else
       {
-      sliceNode->SetOrientationToSagittal();
-      sliceNode->JumpSlice(px, py, pz);
+      sliceNode->SetOrientationToAxial();
       }
+    sliceNode->JumpSlice(p[0], p[1], p[2]);
     }
-  else if ( orientation == vtkSlicerVolumeResliceDriverLogic::ORIENTATION_TRANSVERSE )
+}
+
+
+
+bool vtkSlicerVolumeResliceDriverLogic
+::ApplySliceUpdate( vtkMatrix4x4* transform, SliceUpdate& update )
+{
+  DrivenSlice& slice = *update.Slice;
+  if ( update.Repeat )
+  {
+    ++ slice.Counters.NumberOfCoalescedPoses;
+    return false;
+  }
+  
+  vtkMRMLSliceNode* sliceNode = slice.SliceNode;
+  const char* driverID = slice.DriverNode->GetID();
+  const char* sliceID = sliceNode->GetID();
+  
+  {
+    const char* name = ( slice.Method == METHOD_ORIENTATION ) ? "SetSliceToRASByNTP" : "JumpSlice";
+    vtkDriverEventTracerSpan planeSpan( this->Tracer, name, driverID, sliceID );
+    MRMLCallScope mrmlCall( this->MRMLCallCallback, this->MRMLCallClientData );
+    ApplySlicePlane( sliceNode, update.Plane );
+  }
+  {
+    vtkDriverEventTracerSpan matricesSpan( this->Tracer, "UpdateMatrices", driverID, sliceID );
+    MRMLCallScope mrmlCall( this->MRMLCallCallback, this->MRMLCallClientData );
+    sliceNode->UpdateMatrices();
+  }
+  
+  for ( int k = 0; k < 12; ++ k )
+  {
+    slice.LastPose[ k ] = transform->Element[ k / 4 ][ k % 4 ];
+  }
+  slice.LastSliceMTime = sliceNode->GetMTime();
+  slice.LastPoseValid = true;
+  return true;
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::RecordSliceUpdate( DrivenSlice& slice )
+{
+  SliceCounters& counters = slice.Counters;
+  ++ counters.NumberOfUpdates;
+  counters.Latencies[ counters.NextLatency ] = vtkTimerLog::GetUniversalTime() - this->EventStartTime;
+  counters.NextLatency = ( counters.NextLatency + 1 ) % LATENCY_HISTORY;
+  if ( counters.NumberOfLatencies < LATENCY_HISTORY )
+  {
+    ++ counters.NumberOfLatencies;
+  }
+}
+
+
+bool vtkSlicerVolumeResliceDriverLogic
+::RecomputeSlice( vtkMRMLSliceNode* sliceNode )
+{
+  for ( DriverMapType::iterator driverIt = this->Drivers.begin(); driverIt != this->Drivers.end(); ++ driverIt )
+  {
+    DrivenSliceListType& slices = driverIt->second.Slices;
+    for ( unsigned int i = 0; i < slices.size(); ++ i )
     {
-    if ( method == vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION )
+      if ( slices[ i ].SliceNode != sliceNode )
       {
-      sliceNode->SetSliceToRASByNTP(nx, ny, nz, tx, ty, tz, px, py, pz, 0);
+        continue;
       }
-    else
+      // The settings changed, not the pose: never skip as a repeat.
+      this->EventStartTime = vtkTimerLog::GetUniversalTime();
+      this->CoalescePoses = false;
+      if ( driverIt->second.PoseValid )
       {
-      sliceNode->SetOrientationToCoronal();
-      sliceNode->JumpSlice(px, py, pz);
+        this->DriverTransform->DeepCopy( driverIt->second.Pose );
+        this->UpdateSlice( this->DriverTransform, slices[ i ] );
+        return true;
+      }
+      vtkMRMLTransformableNode* driverNode = vtkMRMLTransformableNode::SafeDownCast( driverIt->first );
+      if ( driverNode == NULL )
+      {
+        return false;
       }
+      this->UpdateSliceByTransformableNode( driverNode, slices[ i ] );
+      return true;
     }
-  sliceNode->UpdateMatrices();
+  }
+  return false;
 }
 
 
+
 void vtkSlicerVolumeResliceDriverLogic
-::UpdateSliceIfObserved( vtkMRMLSliceNode* sliceNode )
+::CompoundImageNode( vtkMRMLScalarVolumeNode* inode )
 {
-  if ( sliceNode == NULL )
+  if ( inode == NULL || inode->GetImageData() == NULL )
   {
     return;
   }
   
-  const char* driverCC = sliceNode->GetAttribute( VOLUMERESLICEDRIVER_DRIVER_ATTRIBUTE );
-  if ( driverCC == NULL )
+  vtkDriverEventTracerSpan span( this->Tracer, "CompoundImageNode", inode->GetID() );
+  
+  // Frame pose in RAS: IJKToRAS (no OpenIGTLink center shift, the compounder
+  // works on voxel indices) composed with the tracker transform, if any:
+  // the pose paired with the frame's acquisition time if there is one,
+  // else the current one.
+  vtkMatrix4x4* ijkToRAS = this->SliceTransform;
+  inode->GetIJKToRASMatrix( ijkToRAS );
+  
+  vtkMRMLLinearTransformNode* parentNode =
+    vtkMRMLLinearTransformNode::SafeDownCast( inode->GetParentTransformNode() );
+  if ( parentNode )
+  {
+    vtkMatrix4x4* parentTransform = this->ParentTransform;
+    parentTransform->Identity();
+    if ( this->FramePoseValid )
+    {
+      parentTransform->DeepCopy( this->FramePose );
+    }
+    if ( this->FramePoseValid || parentNode->GetMatrixTransformToWorld( parentTransform ) )
+    {
+      vtkMatrix4x4* frameToRAS = this->DriverTransform;
+      vtkMatrix4x4::Multiply4x4( parentTransform, ijkToRAS, frameToRAS );
+      this->FrameCompounder->InsertFrame( inode->GetImageData(), frameToRAS );
+      return;
+    }
+  }
+  
+  this->FrameCompounder->InsertFrame( inode->GetImageData(), ijkToRAS );
+}
+
+
+
+vtkSliceImageReslicer* vtkSlicerVolumeResliceDriverLogic
+::PrepareResliceOutput( DrivenSlice& slice, int numberOfThreads )
+{
+  vtkMRMLSliceNode* sliceNode = slice.SliceNode;
+  vtkMRMLScalarVolumeNode* volumeNode = this->GetLayerVolumeForSlice( slice, LAYER_BACKGROUND );
+  if ( volumeNode == NULL || volumeNode->GetImageData() == NULL )
+  {
+    return NULL;
+  }
+  
+  vtkSmartPointer< vtkSliceImageReslicer >& reslicer = this->SliceReslicers[ sliceNode ];
+  if ( reslicer == NULL )
+  {
+    reslicer = vtkSmartPointer< vtkSliceImageReslicer >::New();
+    reslicer->SetCache( this->ResliceCache );
+  }
+  reslicer->SetNumberOfThreads( numberOfThreads );
+  reslicer->SetScheduler( this->TaskSchedulingEnabled ? this->TaskScheduler.GetPointer() : NULL );
+  reslicer->SetInterpolationMode( slice.Interpolation );
+  
+  MappedVolumeMapType::iterator mappedIt = this->MappedVolumes.find( volumeNode );
+  reslicer->SetReadaheadSource( mappedIt != this->MappedVolumes.end() ? mappedIt->second.GetPointer() : NULL );
+  
+  vtkMatrix4x4* rasToIJK = this->ResliceRASToIJK;
+  this->GetWorldRASToIJK( volumeNode, rasToIJK );
+  
+  int* dims = sliceNode->GetDimensions();
+  vtkImageData* image = volumeNode->GetImageData();
+  vtkQuantizedImage* quantized = this->UpdateQuantizedVolume( volumeNode );
+  if ( quantized != NULL )
+  {
+    // Keyed by the copy's MTime, which is newer than the image's: cached
+    // full-precision planes are not returned for it.
+    reslicer->SetQuantizedInput( quantized, rasToIJK );
+    reslicer->SetInputKey( volumeNode->GetID(), quantized->GetMTime() );
+  }
+  else
+  {
+    reslicer->SetInput( image, rasToIJK );
+    reslicer->SetInputKey( volumeNode->GetID(), image->GetMTime() );
+  }
+  reslicer->SetSliceGeometry( sliceNode->GetXYToRAS(), dims[0], dims[1] );
+  return reslicer;
+}
+
+
+
+vtkTimeSeriesSliceReslicer* vtkSlicerVolumeResliceDriverLogic
+::PrepareTimeSeriesResliceOutput( DrivenSlice& slice, int numberOfThreads )
+{
+  vtkMRMLSliceNode* sliceNode = slice.SliceNode;
+  vtkMRMLScalarVolumeNode* volumeNode = this->GetLayerVolumeForSlice( slice, LAYER_BACKGROUND );
+  TimeSeriesMapType::iterator seriesIt = this->TimeSeriesVolumes.find( volumeNode );
+  if ( volumeNode == NULL || seriesIt == this->TimeSeriesVolumes.end() )
+  {
+    this->SliceTimeSeriesReslicers.erase( sliceNode );
+    return NULL;
+  }
+  
+  const TimeSeries& series = seriesIt->second;
+  this->TimeSeriesImages.clear();
+  for ( size_t i = 0; i < series.TimePoints.size(); ++ i )
+  {
+    this->TimeSeriesImages.push_back( series.TimePoints[ i ]->GetImageData() );
+  }
+  
+  vtkSmartPointer< vtkTimeSeriesSliceReslicer >& reslicer = this->SliceTimeSeriesReslicers[ sliceNode ];
+  if ( reslicer == NULL )
+  {
+    reslicer = vtkSmartPointer< vtkTimeSeriesSliceReslicer >::New();
+    reslicer->SetPrefetchCapacity( this->TimeSeriesPrefetchCapacity );
+  }
+  // Images replaced since SetTimeSeries() are checked again here.
+  if ( ! reslicer->SetTimePoints( this->TimeSeriesImages, series.Times ) )
+  {
+    this->SliceTimeSeriesReslicers.erase( sliceNode );
+    return NULL;
+  }
+  reslicer->SetNumberOfThreads( numberOfThreads );
+  reslicer->SetInterpolationMode( slice.Interpolation );
+  
+  vtkMatrix4x4* rasToIJK = this->ResliceRASToIJK;
+  this->GetWorldRASToIJK( volumeNode, rasToIJK );
+  reslicer->SetRASToIJK( rasToIJK );
+  reslicer->SetTime( this->TimeSeriesTime );
+  int* dims = sliceNode->GetDimensions();
+  reslicer->SetSliceGeometry( sliceNode->GetXYToRAS(), dims[0], dims[1] );
+  return reslicer;
+}
+
+
+
+bool vtkSlicerVolumeResliceDriverLogic
+::SubmitAsyncResliceOutput( DrivenSlice& slice, int numberOfThreads )
+{
+  vtkMRMLSliceNode* sliceNode = slice.SliceNode;
+  vtkMRMLScalarVolumeNode* volumeNode = this->GetLayerVolumeForSlice( slice, LAYER_BACKGROUND );
+  if ( volumeNode == NULL || volumeNode->GetImageData() == NULL )
+  {
+    return false;
+  }
+  
+  vtkSmartPointer< vtkAsyncSliceReslicer >& reslicer = this->SliceAsyncReslicers[ sliceNode ];
+  if ( reslicer == NULL )
+  {
+    reslicer = vtkSmartPointer< vtkAsyncSliceReslicer >::New();
+    reslicer->SetNumberOfBuffers( this->AsyncResliceBuffers );
+    reslicer->SetCache( this->ResliceCache );
+  }
+  reslicer->SetNumberOfThreads( numberOfThreads );
+  reslicer->SetInterpolationMode( slice.Interpolation );
+  
+  // Frame n is shown while frame n + 1 is resampled.
+  if ( reslicer->CollectOutput() )
+  {
+    this->PublishResliceOutput( sliceNode, reslicer->GetOutput(), reslicer->GetOutputXYToRAS() );
+  }
+  
+  MappedVolumeMapType::iterator mappedIt = this->MappedVolumes.find( volumeNode );
+  reslicer->SetReadaheadSource( mappedIt != this->MappedVolumes.end() ? mappedIt->second.GetPointer() : NULL );
+  
+  vtkMatrix4x4* rasToIJK = this->ResliceRASToIJK;
+  this->GetWorldRASToIJK( volumeNode, rasToIJK );
+  
+  vtkImageData* image = volumeNode->GetImageData();
+  vtkQuantizedImage* quantized = this->UpdateQuantizedVolume( volumeNode );
+  if ( quantized != NULL )
+  {
+    reslicer->SetQuantizedInput( quantized, rasToIJK );
+    reslicer->SetInputKey( volumeNode->GetID(), quantized->GetMTime() );
+  }
+  else
+  {
+    reslicer->SetInput( image, rasToIJK );
+    reslicer->SetInputKey( volumeNode->GetID(), image->GetMTime() );
+  }
+  int* dims = sliceNode->GetDimensions();
+  reslicer->Submit( sliceNode->GetXYToRAS(), dims[0], dims[1] );
+  return true;
+}
+
+
+
+vtkQuantizedImage* vtkSlicerVolumeResliceDriverLogic
+::UpdateQuantizedVolume( vtkMRMLScalarVolumeNode* volumeNode )
+{
+  vtkImageData* image = volumeNode->GetImageData();
+  if ( this->ResliceQuantizationBits <= 0 || image == NULL || image->GetNumberOfScalarComponents() != 1 )
+  {
+    return NULL;
+  }
+  
+  vtkSmartPointer< vtkQuantizedImage >& copy = this->QuantizedVolumes[ volumeNode ];
+  if ( copy == NULL )
+  {
+    copy = vtkSmartPointer< vtkQuantizedImage >::New();
+  }
+  if ( copy->IsEmpty() || copy->GetSourceMTime() != image->GetMTime() )
+  {
+    // Rebuilt in place: no worker may be reading the old copy.
+    for ( SliceAsyncReslicerMapType::iterator it = this->SliceAsyncReslicers.begin();
+          it != this->SliceAsyncReslicers.end(); ++ it )
+    {
+      it->second->Wait();
+    }
+    copy->Build( image, this->ResliceQuantizationBits, this->ResliceQuantizationCompressed );
+  }
+  return copy->IsEmpty() ? NULL : copy.GetPointer();
+}
+
+
+
+vtkMultiVolumeReslicer* vtkSlicerVolumeResliceDriverLogic
+::PrepareLayerResliceOutput( DrivenSlice& slice, int numberOfThreads )
+{
+  vtkMRMLSliceNode* sliceNode = slice.SliceNode;
+  vtkSmartPointer< vtkMultiVolumeReslicer >& reslicer = this->SliceLayerReslicers[ sliceNode ];
+  if ( reslicer == NULL )
+  {
+    reslicer = vtkSmartPointer< vtkMultiVolumeReslicer >::New();
+    reslicer->SetNumberOfLayers( NUMBER_OF_LAYERS );
+  }
+  reslicer->SetNumberOfThreads( numberOfThreads );
+  reslicer->SetScheduler( this->TaskSchedulingEnabled ? this->TaskScheduler.GetPointer() : NULL );
+  
+  int numberOfVolumes = 0;
+  vtkMatrix4x4* rasToIJK = this->ResliceRASToIJK;
+  for ( int layer = 0; layer < NUMBER_OF_LAYERS; ++ layer )
+  {
+    vtkMRMLScalarVolumeNode* volumeNode = this->GetLayerVolumeForSlice( slice, layer );
+    if ( volumeNode == NULL || volumeNode->GetImageData() == NULL )
+    {
+      reslicer->SetLayer( layer, NULL, NULL, vtkSliceImageReslicer::INTERPOLATION_LINEAR );
+      continue;
+    }
+    this->GetWorldRASToIJK( volumeNode, rasToIJK );
+    reslicer->SetLayer( layer, volumeNode->GetImageData(), rasToIJK,
+                        layer == LAYER_LABEL ? vtkSliceImageReslicer::INTERPOLATION_NEAREST : slice.Interpolation );
+    ++ numberOfVolumes;
+  }
+  if ( numberOfVolumes == 0 )
+  {
+    return NULL;
+  }
+  
+  int* dims = sliceNode->GetDimensions();
+  reslicer->SetSliceGeometry( sliceNode->GetXYToRAS(), dims[0], dims[1] );
+  return reslicer;
+}
+
+
+
+vtkLabelMapSliceReslicer* vtkSlicerVolumeResliceDriverLogic
+::PrepareLabelOutlines( DrivenSlice& slice )
+{
+  vtkMRMLSliceNode* sliceNode = slice.SliceNode;
+  vtkSmartPointer< vtkLabelMapSliceReslicer >& outliner = this->SliceLabelReslicers[ sliceNode ];
+  if ( outliner == NULL )
+  {
+    outliner = vtkSmartPointer< vtkLabelMapSliceReslicer >::New();
+  }
+  
+  vtkMRMLScalarVolumeNode* volumeNode = this->GetLayerVolumeForSlice( slice, LAYER_LABEL );
+  if ( volumeNode == NULL || volumeNode->GetImageData() == NULL )
+  {
+    outliner->SetInput( NULL, NULL );
+    return NULL;
+  }
+  this->GetWorldRASToIJK( volumeNode, this->ResliceRASToIJK );
+  outliner->SetInput( volumeNode->GetImageData(), this->ResliceRASToIJK );
+  
+  int* dims = sliceNode->GetDimensions();
+  outliner->SetSliceGeometry( sliceNode->GetXYToRAS(), dims[0], dims[1] );
+  return outliner;
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::UpdateModelIntersections( DrivenSlice& slice )
+{
+  if ( this->ModelIntersectors.empty() )
   {
     return;
   }
+  vtkDriverEventTracerSpan span( this->Tracer, "UpdateModelIntersections",
+                                 slice.DriverNode->GetID(), slice.SliceNode->GetID() );
+  
+  // Plane of the slice: its normal is the z axis of SliceToRAS.
+  vtkMatrix4x4* sliceToRAS = slice.SliceNode->GetSliceToRAS();
+  double origin[4] = { sliceToRAS->Element[0][3], sliceToRAS->Element[1][3], sliceToRAS->Element[2][3], 1.0 };
+  double normal[3] = { sliceToRAS->Element[0][2], sliceToRAS->Element[1][2], sliceToRAS->Element[2][2] };
+  
+  for ( ModelIntersectorMapType::iterator it = this->ModelIntersectors.begin();
+        it != this->ModelIntersectors.end(); ++ it )
+  {
+    vtkMRMLModelNode* modelNode = it->first;
+    vtkModelPlaneIntersector* intersector = it->second;
+    intersector->SetInput( modelNode->GetPolyData() );
+    vtkSmartPointer< vtkPolyData >& output = this->ModelIntersections[ std::make_pair( slice.SliceNode, modelNode ) ];
+    if ( output == NULL )
+    {
+      output = vtkSmartPointer< vtkPolyData >::New();
+    }
+    
+    // Cut in mesh coordinates: the plane goes in through the inverse of
+    // the model's transform, and the cut points come out through it.
+    vtkMatrix4x4* modelToWorld = NULL;
+    double localOrigin[4] = { origin[0], origin[1], origin[2], 1.0 };
+    double localNormal[3] = { normal[0], normal[1], normal[2] };
+    vtkMRMLLinearTransformNode* parentNode =
+      vtkMRMLLinearTransformNode::SafeDownCast( modelNode->GetParentTransformNode() );
+    if ( parentNode != NULL && parentNode->GetMatrixTransformToWorld( this->ModelToWorld ) )
+    {
+      modelToWorld = this->ModelToWorld;
+      vtkMatrix4x4::Invert( modelToWorld, this->WorldToModel );
+      this->WorldToModel->MultiplyPoint( origin, localOrigin );
+      for ( int k = 0; k < 3; ++ k )
+      {
+        localNormal[ k ] =   modelToWorld->Element[0][ k ] * normal[0]
+                           + modelToWorld->Element[1][ k ] * normal[1]
+                           + modelToWorld->Element[2][ k ] * normal[2];
+      }
+    }
+    intersector->Intersect( localOrigin, localNormal, modelToWorld, output );
+  }
+  
+  this->InvokeEvent( ModelIntersectionsModifiedEvent, slice.SliceNode );
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::GetWorldRASToIJK( vtkMRMLScalarVolumeNode* volumeNode, vtkMatrix4x4* rasToIJK )
+{
+  // Sample in world coordinates, so undo the volume's own parent transform.
+  volumeNode->GetRASToIJKMatrix( rasToIJK );
+  vtkMRMLLinearTransformNode* parentNode =
+    vtkMRMLLinearTransformNode::SafeDownCast( volumeNode->GetParentTransformNode() );
+  if ( parentNode )
+  {
+    vtkMatrix4x4* worldToParent = this->ParentTransform;
+    worldToParent->Identity();
+    if ( parentNode->GetMatrixTransformToWorld( worldToParent ) )
+    {
+      worldToParent->Invert();
+      vtkMatrix4x4::Multiply4x4( rasToIJK, worldToParent, rasToIJK );
+    }
+  }
+}
+
+
+
+void vtkSlicerVolumeResliceDriverLogic
+::PublishResliceOutput( vtkMRMLSliceNode* sliceNode, vtkImageData* image, vtkMatrix4x4* xyToRAS )
+{
+  if ( image != NULL && this->ImageServer->IsRunning() )
+  {
+    this->ImageServer->PushImage( image, xyToRAS, sliceNode->GetLayoutName() );
+  }
   
-  vtkMRMLNode* node = this->GetMRMLScene()->GetNodeByID( driverCC );
+  this->InvokeEvent( ResliceOutputModifiedEvent, sliceNode );
+}
+
+
+
+vtkMRMLScalarVolumeNode* vtkSlicerVolumeResliceDriverLogic
+::GetLayerVolumeForSlice( DrivenSlice& slice, int layer )
+{
+  if ( slice.CompositeNode == NULL )
+  {
+    slice.CompositeNode = this->GetCompositeNodeForSlice( slice.SliceNode );
+    if ( slice.CompositeNode == NULL )
+    {
+      return NULL;
+    }
+  }
   
-  sliceNode->Modified();
-  node->InvokeEvent( vtkMRMLTransformableNode::TransformModifiedEvent );
+  const char* volumeID = NULL;
+  switch ( layer )
+  {
+    case LAYER_BACKGROUND: volumeID = slice.CompositeNode->GetBackgroundVolumeID(); break;
+    case LAYER_FOREGROUND: volumeID = slice.CompositeNode->GetForegroundVolumeID(); break;
+    case LAYER_LABEL:      volumeID = slice.CompositeNode->GetLabelVolumeID(); break;
+    default: return NULL;
+  }
+  if ( volumeID == NULL )
+  {
+    slice.LayerVolumes[ layer ] = NULL;
+    return NULL;
+  }
+  if ( slice.LayerVolumes[ layer ] == NULL || slice.LayerVolumeIDs[ layer ].compare( volumeID ) != 0 )
+  {
+    slice.LayerVolumeIDs[ layer ] = volumeID;
+    slice.LayerVolumes[ layer ] =
+      vtkMRMLScalarVolumeNode::SafeDownCast( this->GetMRMLScene()->GetNodeByID( volumeID ) );
+  }
+  return slice.LayerVolumes[ layer ];
 }
 
+
+
+vtkMRMLSliceCompositeNode* vtkSlicerVolumeResliceDriverLogic
+::GetCompositeNodeForSlice( vtkMRMLSliceNode* sliceNode )
+{
+  const char* layoutName = sliceNode->GetLayoutName();
+  if ( layoutName == NULL )
+  {
+    return NULL;
+  }
+  
+  vtkMRMLSliceCompositeNode* found = NULL;
+  vtkCollection* compositeNodes = this->GetMRMLScene()->GetNodesByClass( "vtkMRMLSliceCompositeNode" );
+  vtkCollectionIterator* compositeIt = vtkCollectionIterator::New();
+  compositeIt->SetCollection( compositeNodes );
+  for ( compositeIt->InitTraversal(); ! compositeIt->IsDoneWithTraversal(); compositeIt->GoToNextItem() )
+  {
+    vtkMRMLSliceCompositeNode* compositeNode =
+      vtkMRMLSliceCompositeNode::SafeDownCast( compositeIt->GetCurrentObject() );
+    if (    compositeNode != NULL
+         && compositeNode->GetLayoutName() != NULL
+         && strcmp( compositeNode->GetLayoutName(), layoutName ) == 0 )
+    {
+      found = compositeNode;
+      break;
+    }
+  }
+  compositeIt->Delete();
+  compositeNodes->Delete();
+  
+  return found;
+}
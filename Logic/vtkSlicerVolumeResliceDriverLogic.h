@@ -30,19 +30,50 @@
 // MRML includes
 #include "vtkMRMLTransformableNode.h"
 
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkSmartPointer.h>
+
 // STD includes
 #include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
 
 #include "vtkSlicerVolumeResliceDriverModuleLogicExport.h"
 
+class vtkAsyncSliceReslicer;
+class vtkDriverEventTracer;
+class vtkDoubleArray;
+class vtkDriverPoseHistory;
+class vtkDriverPoseTable;
+class vtkImageData;
+class vtkImageFrameCompounder;
+class vtkLabelMapSliceReslicer;
+class vtkMemoryMappedImage;
+class vtkModelPlaneIntersector;
 class vtkMRMLLinearTransformNode;
+class vtkMRMLModelNode;
 class vtkMRMLScalarVolumeNode;
+class vtkMRMLSliceCompositeNode;
 class vtkMRMLSliceNode;
+class vtkMultiVolumeReslicer;
+class vtkPolyData;
+class vtkQuantizedImage;
+class vtkResliceImageCache;
+class vtkResliceImageServer;
+class vtkResliceTaskScheduler;
+class vtkSharedMemoryPoseChannel;
+class vtkSliceImageReslicer;
+class vtkTimeSeriesSliceReslicer;
 
 
 #define VOLUMERESLICEDRIVER_DRIVER_ATTRIBUTE "VolumeResliceDriver.Driver"
 #define VOLUMERESLICEDRIVER_METHOD_ATTRIBUTE "VolumeResliceDriver.Method"
 #define VOLUMERESLICEDRIVER_ORIENTATION_ATTRIBUTE "VolumeResliceDriver.Orientation"
+#define VOLUMERESLICEDRIVER_INTERPOLATION_ATTRIBUTE "VolumeResliceDriver.Interpolation"
+#define VOLUMERESLICEDRIVER_TEMPORAL_OFFSET_ATTRIBUTE "VolumeResliceDriver.TemporalOffset"
+#define VOLUMERESLICEDRIVER_TIMESTAMP_ATTRIBUTE "VolumeResliceDriver.Timestamp"
 
 
 
@@ -69,11 +100,289 @@ public:
     ORIENTATION_TRANSVERSE,
   };
   
+  /// Volume layers of a slice view.
+  enum {
+    LAYER_BACKGROUND,
+    LAYER_FOREGROUND,
+    LAYER_LABEL,
+    NUMBER_OF_LAYERS,
+  };
+  
+  enum {
+    /// Invoked with the slice node as call data when its resliced image changes.
+    ResliceOutputModifiedEvent = vtkCommand::UserEvent + 1,
+    /// Invoked with the slice node as call data when its label outlines change.
+    LabelOutlinesModifiedEvent,
+    /// Invoked with the slice node as call data when its model intersections change.
+    ModelIntersectionsModifiedEvent,
+  };
+  
   
   /// Set attributes of MRML slice nodes to define reslice driver.
+  /// Attributes changed by other means take effect at the next scene update.
   void SetDriverForSlice( std::string nodeID, vtkMRMLSliceNode* sliceNode );
   void SetMethodForSlice( int method, vtkMRMLSliceNode* sliceNode );
   void SetOrientationForSlice( int orientation, vtkMRMLSliceNode* sliceNode );
+  /// Kernel resampling the reslice output of a slice,
+  /// vtkSliceImageReslicer::INTERPOLATION_*; linear by default. Label maps
+  /// stay nearest neighbor.
+  void SetInterpolationForSlice( int interpolation, vtkMRMLSliceNode* sliceNode );
+  
+  /// Driver settings of one slice, for SetSliceConfigurations().
+  struct SliceConfiguration
+  {
+    vtkMRMLSliceNode* SliceNode;
+    /// Empty to remove the driver.
+    std::string DriverID;
+    int Method;
+    int Orientation;
+  };
+  
+  /// Configure many slices at once. All entries are validated first and
+  /// nothing changes if one is invalid. Then the driver index is rebuilt
+  /// once, each configured slice is updated once (see RecomputeSlice()),
+  /// and a single ModifiedEvent is invoked on the logic.
+  bool SetSliceConfigurations( const std::vector< SliceConfiguration >& configurations );
+  
+  /// Update just one driven slice from the last pose of its driver (or the
+  /// driver's current pose if none was applied yet), without invoking
+  /// events on the driver. Returns false if the slice is not driven.
+  bool RecomputeSlice( vtkMRMLSliceNode* sliceNode );
+  
+  /// Image drivers with a tracker transform as parent pair each frame with
+  /// the tracker pose interpolated at the frame's acquisition time plus
+  /// this offset (seconds), instead of the latest tracker pose. Frame and
+  /// tracker times are read from the VOLUMERESLICEDRIVER_TIMESTAMP_ATTRIBUTE
+  /// of the image and transform nodes, or taken at arrival if absent.
+  void SetTemporalOffsetForDriver( std::string nodeID, double offset );
+  double GetTemporalOffsetForDriver( std::string nodeID );
+  
+  /// Every pose a driver applies is also kept with its timestamp (the
+  /// VOLUMERESLICEDRIVER_TIMESTAMP_ATTRIBUTE, or the arrival time), the
+  /// latest capacity of them per driver; 136 bytes each. Of poses with the
+  /// same timestamp the last is kept, and poses older than the newest one
+  /// kept are not. Changing the capacity clears the histories.
+  void SetPoseHistoryCapacity( int capacity );
+  vtkGetMacro( PoseHistoryCapacity, int );
+  /// Pose of a driver at time, interpolated between the recorded poses;
+  /// at the timestamp of a recorded pose, that pose. Returns false if
+  /// fewer than two were recorded.
+  bool GetDriverPoseAtTime( std::string nodeID, double time, vtkMatrix4x4* pose );
+  /// Recorded poses of a driver from start to end; see
+  /// vtkDriverPoseHistory::ExportWindow(). Returns the number of poses.
+  int ExportDriverPoseHistory( std::string nodeID, double start, double end,
+                               vtkDoubleArray* times, vtkDoubleArray* poses );
+  
+  /// Insert each new frame of 2D scalar-volume drivers into a 3D volume
+  /// at its tracked pose. Output geometry is configured on the compounder.
+  void SetCompoundingEnabled( bool enabled );
+  bool GetCompoundingEnabled();
+  vtkImageFrameCompounder* GetFrameCompounder();
+  
+  /// Resample the background volume of each driven slice along its new plane
+  /// after every update. Always on while the image server is running.
+  void SetResliceOutputEnabled( bool enabled );
+  bool GetResliceOutputEnabled();
+  vtkImageData* GetResliceOutput( vtkMRMLSliceNode* sliceNode );
+  
+  /// Reslice the foreground and label volumes of each driven slice with the
+  /// background, all in one pass over the plane. Label maps are sampled
+  /// nearest neighbor. The reslice cache, readahead, quantized copies and
+  /// incremental updates apply to the background-only mode alone.
+  void SetResliceAllLayers( bool enabled );
+  bool GetResliceAllLayers();
+  /// Resliced image of a layer (LAYER_*); NULL if the slice view shows no
+  /// volume in that layer or only the background is resliced.
+  vtkImageData* GetResliceLayerOutput( vtkMRMLSliceNode* sliceNode, int layer );
+  
+  /// Resample the background of each driven slice on a worker thread of
+  /// its own instead of in the event handler: the event submits the new
+  /// plane and returns, and the newest finished frame is published at the
+  /// next update of the slice or PollAsyncResliceOutputs(). A plane
+  /// submitted while another waits replaces it. Background-only mode
+  /// alone; see vtkAsyncSliceReslicer.
+  void SetAsyncResliceEnabled( bool enabled );
+  bool GetAsyncResliceEnabled();
+  /// Output buffers of each slice, 2 or 3.
+  void SetAsyncResliceBuffers( int numberOfBuffers );
+  int GetAsyncResliceBuffers();
+  /// Publish the frames finished since they were last published; call at
+  /// the display rate. Returns the number of frames published.
+  int PollAsyncResliceOutputs();
+  /// Worker of a slice, for its counters; NULL if none.
+  vtkAsyncSliceReslicer* GetAsyncReslicer( vtkMRMLSliceNode* sliceNode );
+  
+  /// Play a time series where driven slices show volumeNode in their
+  /// background: the reslice output is the time point at the series time
+  /// instead of volumeNode's image. The time points share volumeNode's
+  /// geometry; times are in seconds, increasing, and playback loops. The
+  /// sampling of each slice plane is computed once for all time points,
+  /// and the next time points are prefetched; see
+  /// vtkTimeSeriesSliceReslicer. Background-only synchronous reslicing
+  /// alone. Returns false, changing nothing, if the time points differ in
+  /// size or type from volumeNode.
+  bool SetTimeSeries( vtkMRMLScalarVolumeNode* volumeNode,
+                      const std::vector< vtkMRMLScalarVolumeNode* >& timePoints,
+                      const std::vector< double >& times );
+  void RemoveTimeSeries( vtkMRMLScalarVolumeNode* volumeNode );
+  /// Move playback of all series to time, then reslice and publish the
+  /// driven slices whose time point changed; call at the display rate.
+  /// The first call after SetTimeSeries() or RemoveTimeSeries() always
+  /// reslices, even at the current time.
+  void SetTimeSeriesTime( double time );
+  vtkGetMacro( TimeSeriesTime, double );
+  /// Time points resliced ahead per slice, clamped to 0..64; 0 turns
+  /// prefetching off.
+  void SetTimeSeriesPrefetchCapacity( int capacity );
+  vtkGetMacro( TimeSeriesPrefetchCapacity, int );
+  /// Series reslicer of a slice, for its counters; NULL if the slice shows
+  /// no series.
+  vtkTimeSeriesSliceReslicer* GetTimeSeriesReslicer( vtkMRMLSliceNode* sliceNode );
+  
+  /// Outline the labels of the label layer of each driven slice after
+  /// every update, in the same pass as resampling the label map; see
+  /// vtkLabelMapSliceReslicer. Independent of the reslice output.
+  void SetLabelOutlinesEnabled( bool enabled );
+  bool GetLabelOutlinesEnabled();
+  /// Outline polylines in RAS, labels as cell scalars; NULL if the slice
+  /// view shows no label map or outlines are off.
+  vtkPolyData* GetLabelOutlines( vtkMRMLSliceNode* sliceNode );
+  
+  /// Cut the selected models by the plane of each driven slice after every
+  /// update. Each model keeps a triangle hierarchy, built on its first cut
+  /// and again only when its mesh changes; see vtkModelPlaneIntersector.
+  void AddIntersectionModel( vtkMRMLModelNode* modelNode );
+  void RemoveIntersectionModel( vtkMRMLModelNode* modelNode );
+  int GetNumberOfIntersectionModels();
+  /// Intersection polylines of a selected model with a driven slice, in
+  /// RAS; NULL until the slice is updated with the model selected.
+  vtkPolyData* GetModelIntersection( vtkMRMLSliceNode* sliceNode, vtkMRMLModelNode* modelNode );
+  /// Index of a selected model, for its build and cut statistics.
+  vtkModelPlaneIntersector* GetModelIntersector( vtkMRMLModelNode* modelNode );
+  
+  /// Plane a driver pose puts a slice at, with the method and orientation
+  /// semantics of the driven slices.
+  struct SlicePlane
+  {
+    int Method;
+    int Orientation;
+    float Normal[3];
+    float Transverse[3];
+    float Position[3];
+  };
+  /// Computes the plane without MRML; safe to call from any thread.
+  static void ComputeSlicePlane( vtkMatrix4x4* pose, int method, int orientation, SlicePlane& plane );
+  /// Moves the slice node to the plane. UpdateMatrices() is left to the caller.
+  static void ApplySlicePlane( vtkMRMLSliceNode* sliceNode, const SlicePlane& plane );
+  /// Pose of an image driver frame from its IJKToRAS and dimensions: unit
+  /// axes, origin at the image center as OpenIGTLink defines it. pose may
+  /// be ijkToRAS.
+  static void GetImageFramePose( vtkMatrix4x4* ijkToRAS, const int dimensions[3], vtkMatrix4x4* pose );
+  
+  /// Threads sharing the resampling of the slices of one driver, when the
+  /// reslice output or the image server is on. The slice planes are still
+  /// computed and the slice nodes written on the calling thread, one after
+  /// another, so only the resampling scales with the threads; without it,
+  /// an update costs the same on any number of threads.
+  vtkSetClampMacro( NumberOfThreads, int, 1, VTK_MAX_THREADS );
+  vtkGetMacro( NumberOfThreads, int );
+  
+  /// Resample driven slices as bands of rows on a work-stealing thread
+  /// pool instead: a thread done with its bands takes those of others, so
+  /// a slice that costs more than the rest, an oblique plane through a
+  /// large volume for instance, does not leave threads idle. Applies to
+  /// UpdateSlices() whatever NumberOfThreads, and to single slices; the
+  /// async workers keep their threads. Threads, cores and band size are
+  /// set on the scheduler.
+  void SetTaskSchedulingEnabled( bool enabled );
+  bool GetTaskSchedulingEnabled();
+  vtkResliceTaskScheduler* GetTaskScheduler();
+  
+  /// Cache of resliced images shared by all slices, consulted before
+  /// resampling. Holds the hit rate and memory usage statistics.
+  vtkResliceImageCache* GetResliceCache();
+  
+  /// Reslice reduced-precision copies of the background volumes: 8 or 16
+  /// bits per voxel, optionally brick-compressed; 0 bits reslices the
+  /// images themselves (the default). A copy is built on the first reslice
+  /// of a volume and rebuilt when its image changes. Slicer's own views
+  /// still need the volume's image, so the copies save memory only where
+  /// they replace it, as in the batch tool. See vtkQuantizedImage.
+  void SetResliceQuantization( int bitsPerVoxel, bool compressed );
+  vtkGetMacro( ResliceQuantizationBits, int );
+  vtkGetMacro( ResliceQuantizationCompressed, bool );
+  /// Copy resliced for a volume node, for its memory and error figures;
+  /// NULL until the volume is resliced quantized.
+  vtkQuantizedImage* GetQuantizedVolume( vtkMRMLScalarVolumeNode* volumeNode );
+  
+  /// Add a scalar volume node backed by an opened memory-mapped file.
+  /// Reslicing it reads ahead the voxels of the predicted next plane.
+  /// Geometry (spacing, origin, directions) is left to the caller.
+  vtkMRMLScalarVolumeNode* AddMappedVolume( vtkMemoryMappedImage* image, const char* name );
+  
+  /// Record timed spans of the pose pipeline (event, slice update, matrix
+  /// update, reslice) into an in-memory ring; WriteTrace() dumps it as
+  /// Chrome trace JSON.
+  void SetTracingEnabled( bool enabled );
+  bool GetTracingEnabled();
+  vtkDriverEventTracer* GetTracer();
+  bool WriteTrace( const char* fileName );
+  
+  /// Called with true before and false after each call into MRML on the
+  /// path from a driver pose to its slices (reading the pose and its
+  /// timestamp, placing the slice and updating its matrices), so that tools
+  /// measuring that path can tell the work of the logic from that of MRML.
+  typedef void ( *MRMLCallCallbackType )( bool entering, void* clientData );
+  void SetMRMLCallCallback( MRMLCallCallbackType callback, void* clientData );
+  
+  /// Counters of one driven slice, copied out by GetPerformanceSnapshot().
+  struct SlicePerformance
+  {
+    std::string DriverID;
+    std::string DriverName;
+    std::string SliceID;
+    std::string SliceName;
+    /// Pose events received from the driver.
+    unsigned long NumberOfPoseEvents;
+    /// Poses applied to the slice.
+    unsigned long NumberOfUpdates;
+    /// Poses identical to the one last applied, skipped.
+    unsigned long NumberOfCoalescedPoses;
+    /// Poses that could not be read from the driver.
+    unsigned long NumberOfDroppedPoses;
+    /// Image frames of the driver paired with an interpolated or extrapolated tracker pose.
+    unsigned long NumberOfInterpolatedFrames;
+    unsigned long NumberOfExtrapolatedFrames;
+    /// Event to slice update latency over recent updates, in ms: 50th, 95th, 99th percentile.
+    double LatencyPercentiles[3];
+    /// Reslices of the slice found in the reslice cache, in percent; -1 before the first.
+    double CacheHitRate;
+  };
+  
+  /// Copy the counters of all driven slices. Meant to be polled at a low
+  /// rate; the pose path itself only increments counters.
+  void GetPerformanceSnapshot( std::vector< SlicePerformance >& snapshot );
+  
+  /// Publish the resliced image of each driven slice on a local TCP port.
+  bool StartImageServer( int port );
+  void StopImageServer();
+  vtkResliceImageServer* GetImageServer();
+  
+  /// Take driver poses from a shared-memory table written by an external
+  /// tracker process, matched to driver nodes by MRML ID. The poses go to
+  /// the driven slices directly; the driver nodes themselves are not moved.
+  bool AttachPoseChannel( const char* name );
+  void DetachPoseChannel();
+  bool IsPoseChannelAttached();
+  vtkSharedMemoryPoseChannel* GetPoseChannel();
+  /// Apply the channel entries written since the previous poll; call at
+  /// render rate. Returns the number of poses applied. The slice frames of
+  /// all drivers in the poll are computed in one batch by the pose table.
+  int PollPoseChannel();
+  /// Poses of the last poll of the pose channel, one row per driver,
+  /// reordered when the driven slices change. Poses of MRML events do not
+  /// go through it.
+  vtkDriverPoseTable* GetPoseTable();
   
   
 protected:
@@ -94,14 +403,236 @@ protected:
   
   virtual void ProcessMRMLNodesEvents(vtkObject* caller, unsigned long event, void * callData);
   
-  void UpdateSliceByTransformableNode( vtkMRMLTransformableNode* tnode, vtkMRMLSliceNode* sliceNode );
-  void UpdateSliceByTransformNode( vtkMRMLLinearTransformNode* tnode, vtkMRMLSliceNode* sliceNode );
-  void UpdateSliceByImageNode( vtkMRMLScalarVolumeNode* inode, vtkMRMLSliceNode* sliceNode );
-  void UpdateSlice( vtkMatrix4x4* transform, vtkMRMLSliceNode* sliceNode );
-  void UpdateSliceIfObserved( vtkMRMLSliceNode* sliceNode );
+  enum { LATENCY_HISTORY = 256 };
+  
+  struct SliceCounters
+  {
+    unsigned long NumberOfUpdates;
+    unsigned long NumberOfCoalescedPoses;
+    unsigned long NumberOfDroppedPoses;
+    /// Ring of the latest latencies, in seconds.
+    double Latencies[ LATENCY_HISTORY ];
+    int NumberOfLatencies;
+    int NextLatency;
+  };
+  
+  /// A slice driven by a node, with its attributes parsed once, so that
+  /// pose events need neither read attributes nor allocate.
+  struct DrivenSlice
+  {
+    vtkMRMLNode* DriverNode;
+    vtkMRMLSliceNode* SliceNode;
+    int Method;
+    int Orientation;
+    int Interpolation;
+    /// Layer volumes, looked up again only when their ID changes.
+    vtkMRMLSliceCompositeNode* CompositeNode;
+    std::string LayerVolumeIDs[ NUMBER_OF_LAYERS ];
+    vtkMRMLScalarVolumeNode* LayerVolumes[ NUMBER_OF_LAYERS ];
+    /// Pose last applied and the slice node MTime right after, to skip repeats.
+    bool LastPoseValid;
+    double LastPose[12];
+    unsigned long LastSliceMTime;
+    SliceCounters Counters;
+  };
+  
+  void UpdateDrivenSlices();
+  
+  void UpdateSliceByTransformableNode( vtkMRMLTransformableNode* tnode, DrivenSlice& slice );
+  /// World pose of a driver node, into pose. Returns false if it has none.
+  bool GetDriverPose( vtkMRMLTransformableNode* tnode, vtkMatrix4x4* pose );
+  /// Acquisition time recorded on a node by its source, or the time the
+  /// pose event arrived.
+  double GetNodeTimestamp( vtkMRMLNode* node );
+  bool GetTransformNodePose( vtkMRMLLinearTransformNode* tnode, vtkMatrix4x4* pose );
+  bool GetImageNodePose( vtkMRMLScalarVolumeNode* inode, vtkMatrix4x4* pose );
+  void UpdateSlice( vtkMatrix4x4* transform, DrivenSlice& slice );
+  
+  /// Update of a driven slice, computed without touching MRML, so that
+  /// the slices of a driver can be computed concurrently.
+  struct SliceUpdate
+  {
+    DrivenSlice* Slice;
+    /// Same pose as last applied, nothing to do.
+    bool Repeat;
+    SlicePlane Plane;
+    bool Applied;
+    vtkSliceImageReslicer* Reslicer;
+    vtkMultiVolumeReslicer* LayerReslicer;
+    vtkTimeSeriesSliceReslicer* TimeSeriesReslicer;
+    vtkLabelMapSliceReslicer* LabelReslicer;
+  };
+  void ComputeSliceUpdate( vtkMatrix4x4* transform, SliceUpdate& update );
+  /// Writes the update into the slice node. Returns false for a repeat.
+  bool ApplySliceUpdate( vtkMatrix4x4* transform, SliceUpdate& update );
+  void RecordSliceUpdate( DrivenSlice& slice );
+  static VTK_THREAD_RETURN_TYPE ResliceThread( void* arg );
+  /// Resample phase of UpdateSlices() on the task scheduler.
+  void ScheduleReslices();
+  
+  void CompoundImageNode( vtkMRMLScalarVolumeNode* inode );
+  /// Sets up the reslicer of a slice for its current plane; NULL if the
+  /// slice shows no volume. Publish after the reslicer has been updated.
+  vtkSliceImageReslicer* PrepareResliceOutput( DrivenSlice& slice, int numberOfThreads );
+  vtkMultiVolumeReslicer* PrepareLayerResliceOutput( DrivenSlice& slice, int numberOfThreads );
+  /// Sets up the series reslicer of a slice for its current plane and the
+  /// series time; NULL, dropping the reslicer, if it shows no series.
+  vtkTimeSeriesSliceReslicer* PrepareTimeSeriesResliceOutput( DrivenSlice& slice, int numberOfThreads );
+  /// Publishes the frame of the slice finished last, if new, and submits
+  /// its current plane. Returns false if the slice shows no volume.
+  bool SubmitAsyncResliceOutput( DrivenSlice& slice, int numberOfThreads );
+  /// Quantized copy of a volume, rebuilt if the image changed; NULL if
+  /// quantization is off or does not apply.
+  vtkQuantizedImage* UpdateQuantizedVolume( vtkMRMLScalarVolumeNode* volumeNode );
+  /// Sets up the label outlines of a slice; NULL if it shows no label map.
+  vtkLabelMapSliceReslicer* PrepareLabelOutlines( DrivenSlice& slice );
+  /// Cut the selected models by the current plane of the slice.
+  void UpdateModelIntersections( DrivenSlice& slice );
+  /// Get the RAS to IJK matrix of a volume in world coordinates, into rasToIJK.
+  void GetWorldRASToIJK( vtkMRMLScalarVolumeNode* volumeNode, vtkMatrix4x4* rasToIJK );
+  /// Send the background image of the slice, resampled at xyToRAS, and
+  /// signal the new output.
+  void PublishResliceOutput( vtkMRMLSliceNode* sliceNode, vtkImageData* image, vtkMatrix4x4* xyToRAS );
+  vtkMRMLScalarVolumeNode* GetLayerVolumeForSlice( DrivenSlice& slice, int layer );
+  vtkMRMLSliceCompositeNode* GetCompositeNodeForSlice( vtkMRMLSliceNode* sliceNode );
   
   std::vector< vtkMRMLTransformableNode* > ObservedNodes;
   
+  /// Slices of each driver node, rebuilt when driver settings or the scene change.
+  typedef std::vector< DrivenSlice > DrivenSliceListType;
+  struct Driver
+  {
+    unsigned long NumberOfPoseEvents;
+    DrivenSliceListType Slices;
+    /// Last pose applied to the slices, for recomputing a reconfigured slice.
+    bool PoseValid;
+    double Pose[16];
+    /// Row of the driver in the pose table.
+    int PoseRow;
+    /// Tracker poses of an image driver's parent transform, created on first use.
+    vtkSmartPointer< vtkDriverPoseHistory > TrackerHistory;
+    double TemporalOffset;
+    /// Poses applied to the slices, by time.
+    vtkSmartPointer< vtkDriverPoseHistory > PoseHistory;
+    unsigned long NumberOfInterpolatedFrames;
+    unsigned long NumberOfExtrapolatedFrames;
+  };
+  typedef std::map< vtkMRMLNode*, Driver > DriverMapType;
+  DriverMapType Drivers;
+  
+  /// For image drivers with a tracker parent: record tracker poses, and
+  /// pair new frames with them. Returns false if the event should not
+  /// update the slices.
+  bool PairImageFrame( vtkMRMLScalarVolumeNode* imageNode, unsigned long event, Driver& driver );
+  
+  /// Pose history of a driver node by ID, NULL if it drives no slice.
+  vtkDriverPoseHistory* GetPoseHistory( const std::string& nodeID );
+  
+  /// Applies one pose to all slices of a driver, then resamples them on
+  /// NumberOfThreads threads.
+  void UpdateSlices( vtkMatrix4x4* transform, Driver& driver );
+  
+  /// State of the pose event being processed.
+  double EventStartTime;
+  bool CoalescePoses;
+  /// Tracker pose paired with the current image frame, used instead of the
+  /// parent transform's current pose while FramePoseValid is set.
+  vtkSmartPointer< vtkMatrix4x4 > FramePose;
+  bool FramePoseValid;
+  
+  /// Scratch matrices of the pose path, reused across events.
+  vtkSmartPointer< vtkMatrix4x4 > DriverTransform;
+  vtkSmartPointer< vtkMatrix4x4 > ParentTransform;
+  vtkSmartPointer< vtkMatrix4x4 > SliceTransform;
+  vtkSmartPointer< vtkMatrix4x4 > ResliceRASToIJK;
+  
+  bool CompoundingEnabled;
+  vtkImageFrameCompounder* FrameCompounder;
+  
+  bool ResliceOutputEnabled;
+  vtkResliceImageServer* ImageServer;
+  vtkResliceImageCache* ResliceCache;
+  vtkDriverEventTracer* Tracer;
+  unsigned long NumberOfPoseEvents;
+  MRMLCallCallbackType MRMLCallCallback;
+  void* MRMLCallClientData;
+  vtkSharedMemoryPoseChannel* PoseChannel;
+  
+  vtkSmartPointer< vtkDriverPoseTable > PoseTable;
+  /// Row whose slice frame the slices take while a batch is applied; -1
+  /// when each slice computes its plane from the pose.
+  int BatchPoseRow;
+  /// Channel entries of a poll, by index, and the drivers they move.
+  std::vector< std::pair< int, Driver* > > PolledDrivers;
+  
+  int PoseHistoryCapacity;
+  
+  int NumberOfThreads;
+  vtkMultiThreader* Threader;
+  /// Work of UpdateSlices, shared with its threads; grows to the largest
+  /// number of slices of a driver, then is reused.
+  std::vector< SliceUpdate > SliceUpdates;
+  
+  bool TaskSchedulingEnabled;
+  vtkSmartPointer< vtkResliceTaskScheduler > TaskScheduler;
+  
+  /// Reslicers of driven slices.
+  typedef std::map< vtkMRMLSliceNode*, vtkSmartPointer< vtkSliceImageReslicer > > SliceReslicerMapType;
+  SliceReslicerMapType SliceReslicers;
+  
+  bool ResliceAllLayers;
+  /// Layer reslicers of driven slices, used instead with ResliceAllLayers.
+  typedef std::map< vtkMRMLSliceNode*, vtkSmartPointer< vtkMultiVolumeReslicer > > SliceLayerReslicerMapType;
+  SliceLayerReslicerMapType SliceLayerReslicers;
+  
+  bool AsyncResliceEnabled;
+  int AsyncResliceBuffers;
+  /// Workers of driven slices, used instead with AsyncResliceEnabled.
+  typedef std::map< vtkMRMLSliceNode*, vtkSmartPointer< vtkAsyncSliceReslicer > > SliceAsyncReslicerMapType;
+  SliceAsyncReslicerMapType SliceAsyncReslicers;
+  
+  /// Time series by the volume node they play in, and the series
+  /// reslicers of driven slices showing one.
+  struct TimeSeries
+  {
+    std::vector< vtkMRMLScalarVolumeNode* > TimePoints;
+    std::vector< double > Times;
+  };
+  typedef std::map< vtkMRMLScalarVolumeNode*, TimeSeries > TimeSeriesMapType;
+  TimeSeriesMapType TimeSeriesVolumes;
+  typedef std::map< vtkMRMLSliceNode*, vtkSmartPointer< vtkTimeSeriesSliceReslicer > > SliceTimeSeriesReslicerMapType;
+  SliceTimeSeriesReslicerMapType SliceTimeSeriesReslicers;
+  double TimeSeriesTime;
+  /// False until SetTimeSeriesTime() shows the current series.
+  bool TimeSeriesTimeValid;
+  int TimeSeriesPrefetchCapacity;
+  /// Images of the time points of a series, reused across updates.
+  std::vector< vtkImageData* > TimeSeriesImages;
+  
+  bool LabelOutlinesEnabled;
+  /// Label outliners of driven slices.
+  typedef std::map< vtkMRMLSliceNode*, vtkSmartPointer< vtkLabelMapSliceReslicer > > SliceLabelReslicerMapType;
+  SliceLabelReslicerMapType SliceLabelReslicers;
+  
+  /// Selected models and their indexes, and their cuts by driven slices.
+  typedef std::map< vtkMRMLModelNode*, vtkSmartPointer< vtkModelPlaneIntersector > > ModelIntersectorMapType;
+  ModelIntersectorMapType ModelIntersectors;
+  typedef std::map< std::pair< vtkMRMLSliceNode*, vtkMRMLModelNode* >, vtkSmartPointer< vtkPolyData > >
+    ModelIntersectionMapType;
+  ModelIntersectionMapType ModelIntersections;
+  vtkSmartPointer< vtkMatrix4x4 > ModelToWorld;
+  vtkSmartPointer< vtkMatrix4x4 > WorldToModel;
+  
+  /// Memory-mapped sources of volume nodes.
+  typedef std::map< vtkMRMLScalarVolumeNode*, vtkSmartPointer< vtkMemoryMappedImage > > MappedVolumeMapType;
+  MappedVolumeMapType MappedVolumes;
+  
+  int ResliceQuantizationBits;
+  bool ResliceQuantizationCompressed;
+  /// Quantized copies of volume nodes.
+  typedef std::map< vtkMRMLScalarVolumeNode*, vtkSmartPointer< vtkQuantizedImage > > QuantizedVolumeMapType;
+  QuantizedVolumeMapType QuantizedVolumes;
+  
 private:
 
   vtkSlicerVolumeResliceDriverLogic(const vtkSlicerVolumeResliceDriverLogic&); // Not implemented
@@ -0,0 +1,901 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VolumeResliceDriver includes
+#include "vtkTimeSeriesSliceReslicer.h"
+#include "vtkSliceImageReslicer.h"
+#include "vtkSliceImageSampling.h"
+
+// VTK includes
+#include <vtkConditionVariable.h>
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+
+
+vtkStandardNewMacro(vtkTimeSeriesSliceReslicer);
+
+
+
+namespace
+{
+
+using vtkSliceImageSampling::CastKernelSample;
+using vtkSliceImageSampling::CastSample;
+using vtkSliceImageSampling::KernelSum;
+using vtkSliceImageSampling::KernelTaps;
+
+typedef vtkTimeSeriesSliceReslicerPlanPixel PlanPixel;
+
+
+/// Cubic or Lanczos samples of a run of planned pixels.
+template < int TAPS, class T >
+void SampleKernelPixels( const PlanPixel* plan, vtkIdType count, const float* table,
+                         const T* inPtr, const int inDims[3], int nc, T* out )
+{
+  vtkIdType incY = static_cast< vtkIdType >( inDims[0] ) * nc;
+  vtkIdType incZ = incY * inDims[1];
+  vtkIdType xo[ TAPS ];
+  vtkIdType yo[ TAPS ];
+  vtkIdType zo[ TAPS ];
+
+  for ( vtkIdType n = 0; n < count; ++ n, out += nc )
+  {
+    const PlanPixel& pixel = plan[ n ];
+    if ( pixel.Voxel[0] < 0 )
+    {
+      memset( out, 0, nc * sizeof( T ) );
+      continue;
+    }
+    const float* wx;
+    const float* wy;
+    const float* wz;
+    KernelTaps< TAPS >( pixel.Voxel[0], pixel.Fraction[0], inDims[0], nc, table, xo, wx );
+    KernelTaps< TAPS >( pixel.Voxel[1], pixel.Fraction[1], inDims[1], incY, table, yo, wy );
+    KernelTaps< TAPS >( pixel.Voxel[2], pixel.Fraction[2], inDims[2], incZ, table, zo, wz );
+    for ( int c = 0; c < nc; ++ c )
+    {
+      out[ c ] = CastKernelSample< T >( KernelSum< TAPS >( inPtr + c, xo, yo, zo, wx, wy, wz ) );
+    }
+  }
+}
+
+
+/// Samples of a run of planned pixels, as vtkSliceImageSampling::SampleRow
+/// computes them.
+template < class T >
+void SamplePlanPixels( const PlanPixel* plan, vtkIdType count, int interpolation,
+                       const T* inPtr, const int inDims[3], int nc, T* out )
+{
+  if ( interpolation == vtkSliceImageReslicer::INTERPOLATION_CUBIC )
+  {
+    SampleKernelPixels< 4 >( plan, count, vtkSliceImageSampling::GetKernelTable( interpolation ).Weights,
+                             inPtr, inDims, nc, out );
+    return;
+  }
+  if ( interpolation == vtkSliceImageReslicer::INTERPOLATION_LANCZOS )
+  {
+    SampleKernelPixels< 6 >( plan, count, vtkSliceImageSampling::GetKernelTable( interpolation ).Weights,
+                             inPtr, inDims, nc, out );
+    return;
+  }
+  bool linear = ( interpolation == vtkSliceImageReslicer::INTERPOLATION_LINEAR );
+
+  vtkIdType incY = static_cast< vtkIdType >( inDims[0] ) * nc;
+  vtkIdType incZ = incY * inDims[1];
+  // The next voxel along an axis, the same one along an axis of one voxel.
+  vtkIdType nextX = ( inDims[0] > 1 ) ? nc : 0;
+  vtkIdType nextY = ( inDims[1] > 1 ) ? incY : 0;
+  vtkIdType nextZ = ( inDims[2] > 1 ) ? incZ : 0;
+
+  for ( vtkIdType n = 0; n < count; ++ n, out += nc )
+  {
+    const PlanPixel& pixel = plan[ n ];
+    if ( pixel.Voxel[0] < 0 )
+    {
+      memset( out, 0, nc * sizeof( T ) );
+      continue;
+    }
+    if ( ! linear )
+    {
+      const T* in = inPtr + pixel.Voxel[0] * nc + pixel.Voxel[1] * incY + pixel.Voxel[2] * incZ;
+      for ( int c = 0; c < nc; ++ c )
+      {
+        out[ c ] = in[ c ];
+      }
+      continue;
+    }
+
+    double fx = pixel.Fraction[0];
+    double fy = pixel.Fraction[1];
+    double fz = pixel.Fraction[2];
+    vtkIdType o00 = pixel.Voxel[1] * incY + pixel.Voxel[2] * incZ;
+    vtkIdType o10 = o00 + nextY;
+    vtkIdType o01 = o00 + nextZ;
+    vtkIdType o11 = o10 + nextZ;
+    vtkIdType a0 = pixel.Voxel[0] * nc;
+    vtkIdType a1 = a0 + nextX;
+    for ( int c = 0; c < nc; ++ c )
+    {
+      double v00 = inPtr[ o00 + a0 + c ] + fx * ( inPtr[ o00 + a1 + c ] - inPtr[ o00 + a0 + c ] );
+      double v10 = inPtr[ o10 + a0 + c ] + fx * ( inPtr[ o10 + a1 + c ] - inPtr[ o10 + a0 + c ] );
+      double v01 = inPtr[ o01 + a0 + c ] + fx * ( inPtr[ o01 + a1 + c ] - inPtr[ o01 + a0 + c ] );
+      double v11 = inPtr[ o11 + a0 + c ] + fx * ( inPtr[ o11 + a1 + c ] - inPtr[ o11 + a0 + c ] );
+      double v0 = v00 + fy * ( v10 - v00 );
+      double v1 = v01 + fy * ( v11 - v01 );
+      out[ c ] = CastSample< T >( v0 + fz * ( v1 - v0 ) );
+    }
+  }
+}
+
+} // namespace
+
+
+
+vtkTimeSeriesSliceReslicer
+::vtkTimeSeriesSliceReslicer()
+{
+  this->InterpolationMode = vtkSliceImageReslicer::INTERPOLATION_LINEAR;
+  this->NumberOfThreads = 1;
+  this->PrefetchCapacity = 0;
+  this->Loop = true;
+  this->TimePoint = 0;
+  this->Direction = 1;
+  this->RASToIJK = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->XYToRAS = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->XYToIJK = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->OutputSize[0] = 0;
+  this->OutputSize[1] = 0;
+  this->Output = vtkSmartPointer< vtkImageData >::New();
+
+  this->PlanID = 0;
+  vtkMatrix4x4::Identity( this->PlanXYToIJK );
+  this->PlanSize[0] = 0;
+  this->PlanSize[1] = 0;
+  this->PlanInterpolationMode = -1;
+  for ( int k = 0; k < 6; ++ k )
+  {
+    this->PlanExtent[ k ] = 0;
+  }
+  for ( int k = 0; k < 3; ++ k )
+  {
+    this->PlanStart[ k ] = 0.0;
+    this->PlanStepI[ k ] = 0.0;
+    this->PlanStepJ[ k ] = 0.0;
+  }
+  this->NumberOfPlans = 0;
+
+  this->OutputPlanID = 0;
+  this->OutputTimePoint = -1;
+  this->OutputImageMTime = 0;
+
+  this->Threader = vtkMultiThreader::New();
+  this->ApplyInput = NULL;
+  this->ApplyOutput = NULL;
+  this->ApplyBuildPlan = false;
+
+  this->UseCount = 0;
+  this->Running = false;
+  this->ThreadID = -1;
+  this->NumberOfPrefetchHits = 0;
+  this->NumberOfResampledTimePoints = 0;
+  this->NumberOfPrefetchedTimePoints = 0;
+
+  this->Mutex = vtkMutexLock::New();
+  this->PrefetchPending = vtkConditionVariable::New();
+  this->WorkerIdle = vtkConditionVariable::New();
+  this->WorkerThreader = vtkMultiThreader::New();
+
+  this->SetPrefetchCapacity( 4 );
+}
+
+
+
+vtkTimeSeriesSliceReslicer
+::~vtkTimeSeriesSliceReslicer()
+{
+  this->StopWorker();
+  this->WorkerThreader->Delete();
+  this->WorkerIdle->Delete();
+  this->PrefetchPending->Delete();
+  this->Mutex->Delete();
+  this->Threader->Delete();
+}
+
+
+
+void vtkTimeSeriesSliceReslicer
+::PrintSelf( ostream& os, vtkIndent indent )
+{
+  this->Superclass::PrintSelf( os, indent );
+
+  os << indent << "InterpolationMode: " << this->InterpolationMode << std::endl;
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << std::endl;
+  os << indent << "PrefetchCapacity: " << this->PrefetchCapacity << std::endl;
+  os << indent << "Loop: " << ( this->Loop ? "On" : "Off" ) << std::endl;
+  os << indent << "NumberOfTimePoints: " << this->Images.size() << std::endl;
+  os << indent << "TimePoint: " << this->TimePoint << std::endl;
+  os << indent << "NumberOfPlans: " << this->NumberOfPlans << std::endl;
+  this->Mutex->Lock();
+  os << indent << "NumberOfPrefetchHits: " << this->NumberOfPrefetchHits << std::endl;
+  os << indent << "NumberOfResampledTimePoints: " << this->NumberOfResampledTimePoints << std::endl;
+  os << indent << "NumberOfPrefetchedTimePoints: " << this->NumberOfPrefetchedTimePoints << std::endl;
+  this->Mutex->Unlock();
+}
+
+
+
+void vtkTimeSeriesSliceReslicer
+::SetPrefetchCapacity( int capacity )
+{
+  capacity = std::max( 0, std::min( capacity, 64 ) );
+  if ( capacity == this->PrefetchCapacity )
+  {
+    return;
+  }
+  this->CancelPrefetch();
+
+  CachedTimePoint empty;
+  empty.TimePoint = -1;
+  empty.PlanID = 0;
+  empty.ImageMTime = 0;
+  empty.Busy = false;
+  empty.LastUse = 0;
+  this->Mutex->Lock();
+  this->Cache.resize( capacity, empty );
+  this->Mutex->Unlock();
+  this->PrefetchCapacity = capacity;
+  this->Modified();
+}
+
+
+
+bool vtkTimeSeriesSliceReslicer
+::SetTimePoints( const std::vector< vtkImageData* >& images, const std::vector< double >& times )
+{
+  if ( images.size() != times.size() )
+  {
+    vtkErrorMacro( "SetTimePoints: " << images.size() << " images for " << times.size() << " times." );
+    return false;
+  }
+  bool same = ( images.size() == this->Images.size() );
+  for ( size_t i = 0; i < images.size(); ++ i )
+  {
+    if (    images[ i ] == NULL
+         || images[ i ]->GetScalarType() != images[0]->GetScalarType()
+         || images[ i ]->GetNumberOfScalarComponents() != images[0]->GetNumberOfScalarComponents()
+         || ! std::equal( images[ i ]->GetExtent(), images[ i ]->GetExtent() + 6, images[0]->GetExtent() )
+         || ( i > 0 && times[ i ] <= times[ i - 1 ] ) )
+    {
+      vtkErrorMacro( "SetTimePoints: time point " << i << " does not match the first or is not later." );
+      return false;
+    }
+    same = same && images[ i ] == this->Images[ i ] && times[ i ] == this->Times[ i ];
+  }
+  if ( same )
+  {
+    return true;
+  }
+
+  this->CancelPrefetch();
+  this->Mutex->Lock();
+  this->Images.assign( images.begin(), images.end() );
+  this->Times = times;
+  for ( size_t i = 0; i < this->Cache.size(); ++ i )
+  {
+    this->Cache[ i ].TimePoint = -1;
+  }
+  this->Mutex->Unlock();
+  int last = static_cast< int >( this->Images.size() ) - 1;
+  this->TimePoint = std::max( 0, std::min( this->TimePoint, last ) );
+  this->OutputTimePoint = -1;
+  this->Modified();
+  return true;
+}
+
+
+
+int vtkTimeSeriesSliceReslicer
+::GetNumberOfTimePoints()
+{
+  return static_cast< int >( this->Images.size() );
+}
+
+
+
+void vtkTimeSeriesSliceReslicer
+::SetRASToIJK( vtkMatrix4x4* rasToIJK )
+{
+  if ( rasToIJK != NULL )
+  {
+    this->RASToIJK->DeepCopy( rasToIJK );
+  }
+}
+
+
+
+void vtkTimeSeriesSliceReslicer
+::SetTime( double time )
+{
+  int n = static_cast< int >( this->Times.size() );
+  if ( n == 0 )
+  {
+    return;
+  }
+  double first = this->Times[0];
+  if ( this->Loop && n > 1 )
+  {
+    double period = ( this->Times[ n - 1 ] - first ) * n / ( n - 1 );
+    time = first + fmod( time - first, period );
+    if ( time < first )
+    {
+      time += period;
+    }
+  }
+  int timePoint = static_cast< int >( std::upper_bound( this->Times.begin(), this->Times.end(), time )
+                                      - this->Times.begin() ) - 1;
+  this->SetTimePoint( std::max( timePoint, 0 ) );
+}
+
+
+
+void vtkTimeSeriesSliceReslicer
+::SetTimePoint( int timePoint )
+{
+  int n = static_cast< int >( this->Images.size() );
+  timePoint = std::max( 0, std::min( timePoint, n - 1 ) );
+  if ( timePoint == this->TimePoint )
+  {
+    return;
+  }
+  // Prefetch the way playback goes, across the end of a loop too.
+  int step = timePoint - this->TimePoint;
+  if ( this->Loop && 2 * abs( step ) > n )
+  {
+    step += ( step > 0 ) ? -n : n;
+  }
+  this->Direction = ( step >= 0 ) ? 1 : -1;
+  this->TimePoint = timePoint;
+  this->Modified();
+}
+
+
+
+void vtkTimeSeriesSliceReslicer
+::SetSliceGeometry( vtkMatrix4x4* xyToRAS, int width, int height )
+{
+  if ( xyToRAS != NULL )
+  {
+    this->XYToRAS->DeepCopy( xyToRAS );
+  }
+  this->OutputSize[0] = width;
+  this->OutputSize[1] = height;
+}
+
+
+
+vtkImageData* vtkTimeSeriesSliceReslicer
+::GetOutput()
+{
+  return this->Output;
+}
+
+
+
+void vtkTimeSeriesSliceReslicer
+::Update()
+{
+  if ( this->Images.empty() || this->OutputSize[0] <= 0 || this->OutputSize[1] <= 0 )
+  {
+    return;
+  }
+
+  bool buildPlan = this->PlanChanged();
+  if ( buildPlan )
+  {
+    this->CancelPrefetch();
+    this->ResetPlan();
+  }
+  int timePoint = this->TimePoint;
+  unsigned long imageMTime = this->Images[ timePoint ]->GetMTime();
+  if (    ! buildPlan
+       && this->OutputPlanID == this->PlanID
+       && this->OutputTimePoint == timePoint
+       && this->OutputImageMTime == imageMTime )
+  {
+    return;
+  }
+
+  bool copied = false;
+  if ( ! buildPlan )
+  {
+    this->Mutex->Lock();
+    int index = this->FindCachedTimePoint( timePoint, false );
+    while ( index < 0 && this->FindCachedTimePoint( timePoint, true ) >= 0 )
+    {
+      // The worker is resampling it.
+      this->WorkerIdle->Wait( this->Mutex );
+      index = this->FindCachedTimePoint( timePoint, false );
+    }
+    if ( index >= 0 )
+    {
+      // Copied with the lock held, so the worker does not take the entry.
+      this->AllocateImage( this->Output );
+      vtkImageData* cached = this->Cache[ index ].Image;
+      memcpy( this->Output->GetScalarPointer(), cached->GetScalarPointer(),
+              static_cast< size_t >( this->Output->GetNumberOfPoints() )
+              * this->Output->GetNumberOfScalarComponents() * this->Output->GetScalarSize() );
+      this->Cache[ index ].LastUse = ++ this->UseCount;
+      ++ this->NumberOfPrefetchHits;
+      copied = true;
+    }
+    this->Mutex->Unlock();
+  }
+  if ( ! copied )
+  {
+    this->ApplyPlan( timePoint, this->Output, this->NumberOfThreads, buildPlan );
+    this->Mutex->Lock();
+    ++ this->NumberOfResampledTimePoints;
+    this->Mutex->Unlock();
+  }
+  this->Output->Modified();
+  this->OutputPlanID = this->PlanID;
+  this->OutputTimePoint = timePoint;
+  this->OutputImageMTime = imageMTime;
+
+  // A plane that just moved likely moves again before the time points
+  // ahead are shown: prefetch only the next until it stays.
+  this->Prefetch( buildPlan ? 1 : this->PrefetchCapacity );
+}
+
+
+
+void vtkTimeSeriesSliceReslicer
+::Wait()
+{
+  this->Mutex->Lock();
+  while ( this->Running )
+  {
+    bool busy = ! this->PrefetchQueue.empty();
+    for ( size_t i = 0; i < this->Cache.size() && ! busy; ++ i )
+    {
+      busy = this->Cache[ i ].Busy;
+    }
+    if ( ! busy )
+    {
+      break;
+    }
+    this->WorkerIdle->Wait( this->Mutex );
+  }
+  this->Mutex->Unlock();
+}
+
+
+
+unsigned long vtkTimeSeriesSliceReslicer
+::GetNumberOfPrefetchHits()
+{
+  this->Mutex->Lock();
+  unsigned long count = this->NumberOfPrefetchHits;
+  this->Mutex->Unlock();
+  return count;
+}
+
+
+
+unsigned long vtkTimeSeriesSliceReslicer
+::GetNumberOfResampledTimePoints()
+{
+  this->Mutex->Lock();
+  unsigned long count = this->NumberOfResampledTimePoints;
+  this->Mutex->Unlock();
+  return count;
+}
+
+
+
+unsigned long vtkTimeSeriesSliceReslicer
+::GetNumberOfPrefetchedTimePoints()
+{
+  this->Mutex->Lock();
+  unsigned long count = this->NumberOfPrefetchedTimePoints;
+  this->Mutex->Unlock();
+  return count;
+}
+
+
+
+bool vtkTimeSeriesSliceReslicer
+::PlanChanged()
+{
+  vtkMatrix4x4::Multiply4x4( this->RASToIJK, this->XYToRAS, this->XYToIJK );
+  const int* extent = this->Images[0]->GetExtent();
+  return this->PlanID == 0
+    || this->PlanSize[0] != this->OutputSize[0]
+    || this->PlanSize[1] != this->OutputSize[1]
+    || this->PlanInterpolationMode != this->InterpolationMode
+    || ! std::equal( this->PlanExtent, this->PlanExtent + 6, extent )
+    || ! std::equal( this->PlanXYToIJK, this->PlanXYToIJK + 16, &this->XYToIJK->Element[0][0] );
+}
+
+
+
+void vtkTimeSeriesSliceReslicer
+::ResetPlan()
+{
+  // XYToIJK is up to date from PlanChanged().
+  vtkMatrix4x4::DeepCopy( this->PlanXYToIJK, this->XYToIJK );
+  this->PlanSize[0] = this->OutputSize[0];
+  this->PlanSize[1] = this->OutputSize[1];
+  this->PlanInterpolationMode = this->InterpolationMode;
+  this->Images[0]->GetExtent( this->PlanExtent );
+  for ( int k = 0; k < 3; ++ k )
+  {
+    this->PlanStepI[ k ] = this->XYToIJK->Element[ k ][ 0 ];
+    this->PlanStepJ[ k ] = this->XYToIJK->Element[ k ][ 1 ];
+    this->PlanStart[ k ] = this->XYToIJK->Element[ k ][ 3 ] - this->PlanExtent[ 2 * k ];
+  }
+  this->Plan.resize( static_cast< size_t >( this->PlanSize[0] ) * this->PlanSize[1] );
+
+  this->Mutex->Lock();
+  ++ this->PlanID;
+  this->Mutex->Unlock();
+  ++ this->NumberOfPlans;
+}
+
+
+
+void vtkTimeSeriesSliceReslicer
+::AllocateImage( vtkImageData* image )
+{
+  int scalarType = this->Images[0]->GetScalarType();
+  int numberOfComponents = this->Images[0]->GetNumberOfScalarComponents();
+  int* extent = image->GetExtent();
+  if (    extent[0] == 0 && extent[1] == this->PlanSize[0] - 1
+       && extent[2] == 0 && extent[3] == this->PlanSize[1] - 1
+       && extent[4] == 0 && extent[5] == 0
+       && image->GetScalarPointer() != NULL
+       && image->GetScalarType() == scalarType
+       && image->GetNumberOfScalarComponents() == numberOfComponents )
+  {
+    return;
+  }
+  image->SetExtent( 0, this->PlanSize[0] - 1, 0, this->PlanSize[1] - 1, 0, 0 );
+  image->SetWholeExtent( 0, this->PlanSize[0] - 1, 0, this->PlanSize[1] - 1, 0, 0 );
+  image->SetSpacing( 1.0, 1.0, 1.0 );
+  image->SetOrigin( 0.0, 0.0, 0.0 );
+  image->SetScalarType( scalarType );
+  image->SetNumberOfScalarComponents( numberOfComponents );
+  image->AllocateScalars();
+}
+
+
+
+void vtkTimeSeriesSliceReslicer
+::ApplyPlan( int timePoint, vtkImageData* output, int numberOfThreads, bool buildPlan )
+{
+  this->AllocateImage( output );
+  this->ApplyInput = this->Images[ timePoint ];
+  this->ApplyOutput = output;
+  this->ApplyBuildPlan = buildPlan;
+  int rows = this->PlanSize[1];
+  if ( numberOfThreads <= 1 || rows < 2 )
+  {
+    if ( buildPlan )
+    {
+      this->BuildPlanRows( 0, rows );
+    }
+    this->SamplePlanRows( this->ApplyInput, output, 0, rows );
+    return;
+  }
+  this->Threader->SetNumberOfThreads( std::min( numberOfThreads, rows ) );
+  this->Threader->SetSingleMethod( vtkTimeSeriesSliceReslicer::ApplyPlanThread, this );
+  this->Threader->SingleMethodExecute();
+}
+
+
+
+VTK_THREAD_RETURN_TYPE vtkTimeSeriesSliceReslicer
+::ApplyPlanThread( void* arg )
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast< vtkMultiThreader::ThreadInfo* >( arg );
+  vtkTimeSeriesSliceReslicer* self = static_cast< vtkTimeSeriesSliceReslicer* >( info->UserData );
+
+  int rows = self->PlanSize[1];
+  int rowMin = rows * info->ThreadID / info->NumberOfThreads;
+  int rowMax = rows * ( info->ThreadID + 1 ) / info->NumberOfThreads;
+  if ( self->ApplyBuildPlan )
+  {
+    self->BuildPlanRows( rowMin, rowMax );
+  }
+  self->SamplePlanRows( self->ApplyInput, self->ApplyOutput, rowMin, rowMax );
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+
+
+void vtkTimeSeriesSliceReslicer
+::BuildPlanRows( int rowMin, int rowMax )
+{
+  int dims[3];
+  for ( int k = 0; k < 3; ++ k )
+  {
+    dims[ k ] = this->PlanExtent[ 2 * k + 1 ] - this->PlanExtent[ 2 * k ] + 1;
+  }
+  bool nearest = ( this->PlanInterpolationMode == vtkSliceImageReslicer::INTERPOLATION_NEAREST );
+
+  // Same positions as vtkSliceImageReslicer samples, row by row.
+  for ( int j = rowMin; j < rowMax; ++ j )
+  {
+    double rowStart[3];
+    for ( int k = 0; k < 3; ++ k )
+    {
+      rowStart[ k ] = this->PlanStart[ k ] + j * this->PlanStepJ[ k ];
+    }
+    PlanPixel* pixel = &this->Plan[ static_cast< size_t >( j ) * this->PlanSize[0] ];
+    for ( int i = 0; i < this->PlanSize[0]; ++ i, ++ pixel )
+    {
+      bool inside = true;
+      for ( int k = 0; k < 3 && inside; ++ k )
+      {
+        double p = rowStart[ k ] + i * this->PlanStepI[ k ];
+        if ( nearest )
+        {
+          inside = vtkSliceImageSampling::NearestAxis( p, dims[ k ], pixel->Voxel[ k ] );
+          pixel->Fraction[ k ] = 0.0;
+        }
+        else
+        {
+          int next;
+          inside = vtkSliceImageSampling::LinearAxis( p, dims[ k ], pixel->Voxel[ k ], next, pixel->Fraction[ k ] );
+        }
+      }
+      if ( ! inside )
+      {
+        pixel->Voxel[0] = -1;
+      }
+    }
+  }
+}
+
+
+
+void vtkTimeSeriesSliceReslicer
+::SamplePlanRows( vtkImageData* input, vtkImageData* output, int rowMin, int rowMax )
+{
+  if ( rowMin >= rowMax )
+  {
+    return;
+  }
+  int inDims[3];
+  input->GetDimensions( inDims );
+  int nc = input->GetNumberOfScalarComponents();
+  vtkIdType first = static_cast< vtkIdType >( rowMin ) * this->PlanSize[0];
+  vtkIdType count = static_cast< vtkIdType >( rowMax - rowMin ) * this->PlanSize[0];
+  const PlanPixel* plan = &this->Plan[ first ];
+  void* inPtr = input->GetScalarPointer();
+  void* outPtr = output->GetScalarPointer();
+  switch ( input->GetScalarType() )
+  {
+    vtkTemplateMacro( SamplePlanPixels( plan, count, this->PlanInterpolationMode,
+                                        static_cast< const VTK_TT* >( inPtr ), inDims, nc,
+                                        static_cast< VTK_TT* >( outPtr ) + first * nc ) );
+  }
+}
+
+
+
+void vtkTimeSeriesSliceReslicer
+::CancelPrefetch()
+{
+  this->Mutex->Lock();
+  this->PrefetchQueue.clear();
+  for ( size_t i = 0; i < this->Cache.size(); ++ i )
+  {
+    while ( this->Cache[ i ].Busy )
+    {
+      this->WorkerIdle->Wait( this->Mutex );
+    }
+  }
+  this->Mutex->Unlock();
+}
+
+
+
+void vtkTimeSeriesSliceReslicer
+::Prefetch( int count )
+{
+  int n = static_cast< int >( this->Images.size() );
+  count = std::min( count, this->PrefetchCapacity );
+  if ( count <= 0 || n < 2 )
+  {
+    return;
+  }
+
+  this->Mutex->Lock();
+  // Entries of the time points ahead are used last, nearest first, so the
+  // worker replaces the others.
+  this->PrefetchQueue.clear();
+  for ( int k = 1; k <= count && k < n; ++ k )
+  {
+    int timePoint = this->TimePoint + k * this->Direction;
+    if ( this->Loop )
+    {
+      timePoint = ( timePoint % n + n ) % n;
+    }
+    else if ( timePoint < 0 || timePoint >= n )
+    {
+      break;
+    }
+    int index = this->FindCachedTimePoint( timePoint, false );
+    if ( index >= 0 )
+    {
+      this->Cache[ index ].LastUse = ++ this->UseCount;
+    }
+    else if ( this->FindCachedTimePoint( timePoint, true ) < 0 )
+    {
+      this->PrefetchQueue.push_back( timePoint );
+    }
+  }
+  if ( ! this->PrefetchQueue.empty() )
+  {
+    if ( ! this->Running )
+    {
+      // The worker takes the lock first thing.
+      this->Running = true;
+      this->ThreadID = this->WorkerThreader->SpawnThread( vtkTimeSeriesSliceReslicer::WorkerThread, this );
+    }
+    this->PrefetchPending->Signal();
+  }
+  this->Mutex->Unlock();
+}
+
+
+
+int vtkTimeSeriesSliceReslicer
+::FindCachedTimePoint( int timePoint, bool busy )
+{
+  unsigned long imageMTime = this->Images[ timePoint ]->GetMTime();
+  for ( size_t i = 0; i < this->Cache.size(); ++ i )
+  {
+    const CachedTimePoint& entry = this->Cache[ i ];
+    if (    entry.TimePoint == timePoint
+         && entry.Busy == busy
+         && entry.PlanID == this->PlanID
+         && entry.ImageMTime == imageMTime )
+    {
+      return static_cast< int >( i );
+    }
+  }
+  return -1;
+}
+
+
+
+VTK_THREAD_RETURN_TYPE vtkTimeSeriesSliceReslicer
+::WorkerThread( void* arg )
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast< vtkMultiThreader::ThreadInfo* >( arg );
+  static_cast< vtkTimeSeriesSliceReslicer* >( info->UserData )->WorkerLoop();
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+
+
+void vtkTimeSeriesSliceReslicer
+::WorkerLoop()
+{
+  this->Mutex->Lock();
+  while ( true )
+  {
+    while ( this->Running && this->PrefetchQueue.empty() )
+    {
+      this->WorkerIdle->Broadcast();
+      this->PrefetchPending->Wait( this->Mutex );
+    }
+    if ( ! this->Running )
+    {
+      break;
+    }
+
+    int timePoint = this->PrefetchQueue.front();
+    this->PrefetchQueue.erase( this->PrefetchQueue.begin() );
+    if ( this->FindCachedTimePoint( timePoint, false ) >= 0 )
+    {
+      continue;
+    }
+    // An entry of another plan or image first, else the one used longest ago.
+    int index = -1;
+    unsigned long imageMTime = 0;
+    for ( size_t i = 0; i < this->Cache.size(); ++ i )
+    {
+      const CachedTimePoint& entry = this->Cache[ i ];
+      if ( entry.Busy )
+      {
+        continue;
+      }
+      if (    entry.TimePoint < 0
+           || entry.PlanID != this->PlanID
+           || entry.ImageMTime != this->Images[ entry.TimePoint ]->GetMTime() )
+      {
+        index = static_cast< int >( i );
+        break;
+      }
+      if ( index < 0 || entry.LastUse < this->Cache[ index ].LastUse )
+      {
+        index = static_cast< int >( i );
+      }
+    }
+    if ( index < 0 )
+    {
+      continue;
+    }
+
+    CachedTimePoint& entry = this->Cache[ index ];
+    vtkImageData* input = this->Images[ timePoint ];
+    imageMTime = input->GetMTime();
+    entry.TimePoint = timePoint;
+    entry.PlanID = this->PlanID;
+    entry.ImageMTime = imageMTime;
+    entry.Busy = true;
+    entry.LastUse = ++ this->UseCount;
+    if ( entry.Image == NULL )
+    {
+      entry.Image = vtkSmartPointer< vtkImageData >::New();
+    }
+    vtkImageData* image = entry.Image;
+    this->Mutex->Unlock();
+
+    // The plan and the time points only change once no entry is busy.
+    this->AllocateImage( image );
+    this->SamplePlanRows( input, image, 0, this->PlanSize[1] );
+
+    this->Mutex->Lock();
+    entry.Busy = false;
+    ++ this->NumberOfPrefetchedTimePoints;
+    this->WorkerIdle->Broadcast();
+  }
+  this->Mutex->Unlock();
+}
+
+
+
+void vtkTimeSeriesSliceReslicer
+::StopWorker()
+{
+  if ( ! this->Running )
+  {
+    return;
+  }
+
+  this->Mutex->Lock();
+  this->Running = false;
+  this->PrefetchQueue.clear();
+  this->PrefetchPending->Broadcast();
+  this->Mutex->Unlock();
+
+  this->WorkerThreader->TerminateThread( this->ThreadID );
+  this->ThreadID = -1;
+}
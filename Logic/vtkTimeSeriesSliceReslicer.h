@@ -0,0 +1,240 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkTimeSeriesSliceReslicer - reslice the current time point of a 4D volume along a driven plane
+// .SECTION Description
+// Resamples one time point of a series of volumes sharing a voxel grid,
+// such as the phases of a cardiac CT or a 4D ultrasound sequence, along
+// the plane of a driven slice. The plane follows the driver, the time
+// point follows SetTime().
+//
+// Since the time points share their geometry, the sampling of a plane is
+// computed once into a plan: for each pixel, its voxel and the fractions
+// past it along each axis (40 bytes per pixel). Each time point resliced
+// along the plane then only gathers and weighs its voxels. The plan is
+// rebuilt when the plane, the output size, RAS to IJK, the interpolation
+// mode or the volume extent change, in the same pass as resampling the
+// time point shown; the output is the same as vtkSliceImageReslicer's.
+//
+// Resliced time points are kept in a cache of PrefetchCapacity images for
+// the current plan. After each Update() a worker thread resamples the
+// next time points in the direction of playback into it, so moving to
+// the next time point along an unmoved plane costs a copy, and a moved
+// plane is planned once for the shown and the prefetched time points.
+// Right after the plane moves only the next time point is prefetched.
+// The worker reads the images of the time points: call Wait() before
+// modifying them in place.
+
+
+#ifndef __vtkTimeSeriesSliceReslicer_h
+#define __vtkTimeSeriesSliceReslicer_h
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerVolumeResliceDriverModuleLogicExport.h"
+
+class vtkConditionVariable;
+class vtkImageData;
+class vtkMatrix4x4;
+class vtkMutexLock;
+
+
+/// Sampling of one output pixel in a plan: the voxel, or the voxel below
+/// the sample, along each axis and the fractions past it. Voxel[0] is -1
+/// outside the volume.
+struct vtkTimeSeriesSliceReslicerPlanPixel
+{
+  int Voxel[3];
+  double Fraction[3];
+};
+
+
+/// \ingroup Slicer_QtModules_VolumeResliceDriver
+class VTK_SLICER_VOLUMERESLICEDRIVER_MODULE_LOGIC_EXPORT vtkTimeSeriesSliceReslicer
+  : public vtkObject
+{
+public:
+
+  static vtkTimeSeriesSliceReslicer *New();
+  vtkTypeMacro(vtkTimeSeriesSliceReslicer,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// vtkSliceImageReslicer::INTERPOLATION_*.
+  vtkSetMacro( InterpolationMode, int );
+  vtkGetMacro( InterpolationMode, int );
+
+  /// Threads resampling the time point shown by Update(); the prefetch
+  /// worker resamples on its own.
+  vtkSetClampMacro( NumberOfThreads, int, 1, VTK_MAX_THREADS );
+  vtkGetMacro( NumberOfThreads, int );
+
+  /// Resliced time points kept for the current plan, prefetched ahead of
+  /// the shown one; 0 turns prefetching off.
+  void SetPrefetchCapacity( int capacity );
+  vtkGetMacro( PrefetchCapacity, int );
+
+  /// Time points of the series and their times, increasing. All images
+  /// have the dimensions, components and scalar type of the first.
+  /// Returns false, keeping the previous series, if not. Setting the same
+  /// images and times again keeps the prefetched time points.
+  bool SetTimePoints( const std::vector< vtkImageData* >& images, const std::vector< double >& times );
+  int GetNumberOfTimePoints();
+  /// RAS to IJK of the volume, shared by the time points.
+  void SetRASToIJK( vtkMatrix4x4* rasToIJK );
+
+  /// Playback wraps around: times past the last time point continue from
+  /// the first, one mean frame interval after it. On by default.
+  vtkSetMacro( Loop, bool );
+  vtkGetMacro( Loop, bool );
+  vtkBooleanMacro( Loop, bool );
+
+  /// Show the latest time point at or before time.
+  void SetTime( double time );
+  void SetTimePoint( int timePoint );
+  vtkGetMacro( TimePoint, int );
+
+  /// Output plane: XYToRAS of the slice node and its size in pixels.
+  void SetSliceGeometry( vtkMatrix4x4* xyToRAS, int width, int height );
+
+  /// Resample the time point shown along the plane, or copy it from the
+  /// prefetched ones, then prefetch the next. Does nothing if neither
+  /// changed since the last update.
+  void Update();
+  vtkImageData* GetOutput();
+
+  /// Block until the worker is idle.
+  void Wait();
+
+  /// Plans built, time points shown from the prefetched ones, resampled
+  /// by Update() itself, and resampled ahead by the worker.
+  vtkGetMacro( NumberOfPlans, unsigned long );
+  unsigned long GetNumberOfPrefetchHits();
+  unsigned long GetNumberOfResampledTimePoints();
+  unsigned long GetNumberOfPrefetchedTimePoints();
+
+
+protected:
+
+  vtkTimeSeriesSliceReslicer();
+  virtual ~vtkTimeSeriesSliceReslicer();
+
+  /// Resliced time point kept for the plan it was resampled with.
+  struct CachedTimePoint
+  {
+    int TimePoint;
+    unsigned long PlanID;
+    unsigned long ImageMTime;
+    bool Busy;
+    unsigned long LastUse;
+    vtkSmartPointer< vtkImageData > Image;
+  };
+
+  /// True if the plan is out of date.
+  bool PlanChanged();
+  /// Starts a plan for the current plane, filled by the next ApplyPlan().
+  void ResetPlan();
+  void AllocateImage( vtkImageData* image );
+  /// Resamples a time point along the plan on numberOfThreads threads,
+  /// filling the plan first if buildPlan is set.
+  void ApplyPlan( int timePoint, vtkImageData* output, int numberOfThreads, bool buildPlan );
+  static VTK_THREAD_RETURN_TYPE ApplyPlanThread( void* arg );
+  void BuildPlanRows( int rowMin, int rowMax );
+  void SamplePlanRows( vtkImageData* input, vtkImageData* output, int rowMin, int rowMax );
+
+  /// Drop the queued prefetches and wait for the one in progress, before
+  /// the plan or the time points change.
+  void CancelPrefetch();
+  /// Queue the next count time points in the direction of playback.
+  void Prefetch( int count );
+  /// Cached time point resampled with the current plan and image, or -1;
+  /// with the lock held.
+  int FindCachedTimePoint( int timePoint, bool busy );
+  static VTK_THREAD_RETURN_TYPE WorkerThread( void* arg );
+  void WorkerLoop();
+  void StopWorker();
+
+  int InterpolationMode;
+  int NumberOfThreads;
+  int PrefetchCapacity;
+  bool Loop;
+
+  std::vector< vtkSmartPointer< vtkImageData > > Images;
+  std::vector< double > Times;
+  int TimePoint;
+  /// +1 or -1, the direction the time point moved last.
+  int Direction;
+  vtkSmartPointer< vtkMatrix4x4 > RASToIJK;
+  vtkSmartPointer< vtkMatrix4x4 > XYToRAS;
+  vtkSmartPointer< vtkMatrix4x4 > XYToIJK;
+  int OutputSize[2];
+  vtkSmartPointer< vtkImageData > Output;
+
+  /// Read by the worker while it resamples, changed after CancelPrefetch().
+  /// PlanStart is the continuous index of pixel (0, 0) relative to the
+  /// first voxel, PlanStepI and PlanStepJ its increments per column and row.
+  std::vector< vtkTimeSeriesSliceReslicerPlanPixel > Plan;
+  unsigned long PlanID;
+  double PlanXYToIJK[16];
+  int PlanSize[2];
+  int PlanInterpolationMode;
+  int PlanExtent[6];
+  double PlanStart[3];
+  double PlanStepI[3];
+  double PlanStepJ[3];
+  unsigned long NumberOfPlans;
+
+  /// What the output shows, to skip unchanged updates.
+  unsigned long OutputPlanID;
+  int OutputTimePoint;
+  unsigned long OutputImageMTime;
+
+  /// Threads of ApplyPlan(), calling thread only.
+  vtkMultiThreader* Threader;
+  vtkImageData* ApplyInput;
+  vtkImageData* ApplyOutput;
+  bool ApplyBuildPlan;
+
+  // Guarded by Mutex: the cache, the time points to prefetch in order and
+  // the worker state.
+  std::vector< CachedTimePoint > Cache;
+  std::vector< int > PrefetchQueue;
+  unsigned long UseCount;
+  bool Running;
+  int ThreadID;
+  unsigned long NumberOfPrefetchHits;
+  unsigned long NumberOfResampledTimePoints;
+  unsigned long NumberOfPrefetchedTimePoints;
+
+  vtkMutexLock* Mutex;
+  /// Signaled when time points are queued, and when the worker finishes one.
+  vtkConditionVariable* PrefetchPending;
+  vtkConditionVariable* WorkerIdle;
+  vtkMultiThreader* WorkerThreader;
+
+private:
+
+  vtkTimeSeriesSliceReslicer(const vtkTimeSeriesSliceReslicer&); // Not implemented
+  void operator=(const vtkTimeSeriesSliceReslicer&);             // Not implemented
+};
+
+#endif
@@ -0,0 +1,203 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// VolumeResliceDriver includes
+#include "vtkAsyncSliceReslicer.h"
+#include "vtkSliceImageReslicer.h"
+#include "vtkVolumeResliceDriverTestingUtilities.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cstring>
+#include <iostream>
+
+using namespace vtkVolumeResliceDriverTestingUtilities;
+
+namespace
+{
+
+const int VolumeSize = 64;
+const int SliceSize = 96;
+const int NumberOfRounds = 8;
+
+/// Writes frame n of a stream into the volume in place, as OpenIGTLink
+/// does: the test volume shifted by 100 n.
+void WriteFrame( vtkImageData* volume, vtkImageData* base, int n )
+{
+  const short* in = static_cast< const short* >( base->GetScalarPointer() );
+  short* out = static_cast< short* >( volume->GetScalarPointer() );
+  vtkIdType count = static_cast< vtkIdType >( VolumeSize ) * VolumeSize * VolumeSize;
+  for ( vtkIdType i = 0; i < count; ++ i )
+  {
+    out[ i ] = static_cast< short >( in[ i ] + 100 * n );
+  }
+  volume->Modified();
+}
+
+/// Waits for the worker and collects its frames until none is left, then
+/// compares the frame shown with the synchronous reslice.
+int CheckLastFrame( vtkAsyncSliceReslicer* pipeline, vtkSliceImageReslicer* reslicer, int line )
+{
+  do
+  {
+    pipeline->Wait();
+  }
+  while ( pipeline->CollectOutput() );
+  vtkImageData* output = pipeline->GetOutput();
+  size_t bytes = static_cast< size_t >( SliceSize ) * SliceSize * sizeof( short );
+  if (   output == NULL
+      || memcmp( output->GetScalarPointer(), reslicer->GetOutput()->GetScalarPointer(), bytes ) != 0 )
+  {
+    std::cerr << "Line " << line << ": last frame differs from the synchronous reslice" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+
+//----------------------------------------------------------------------------
+int TestPoseStream()
+{
+  vtkSmartPointer< vtkImageData > volume = CreateTestVolume( VolumeSize );
+  vtkNew< vtkMatrix4x4 > rasToIJK;
+  CreateRASToIJK( rasToIJK.GetPointer(), VolumeSize );
+  vtkNew< vtkMatrix4x4 > pose;
+  vtkNew< vtkMatrix4x4 > xyToRAS;
+
+  for ( int numberOfBuffers = 2; numberOfBuffers <= 3; ++ numberOfBuffers )
+  {
+    vtkNew< vtkSliceImageReslicer > reslicer;
+    reslicer->SetInput( volume, rasToIJK.GetPointer() );
+    vtkNew< vtkAsyncSliceReslicer > pipeline;
+    pipeline->SetNumberOfBuffers( numberOfBuffers );
+    pipeline->SetInput( volume, rasToIJK.GetPointer() );
+    pipeline->Start();
+
+    // Poses submitted faster than they are resampled.
+    for ( int n = 0; n < 50; ++ n )
+    {
+      SetStreamPose( pose.GetPointer(), n );
+      SetPoseXYToRAS( xyToRAS.GetPointer(), pose.GetPointer(), SliceSize, 1.0 );
+      pipeline->CollectOutput();
+      pipeline->Submit( xyToRAS.GetPointer(), SliceSize, SliceSize );
+    }
+    reslicer->SetSliceGeometry( xyToRAS.GetPointer(), SliceSize, SliceSize );
+    reslicer->Update();
+    if ( CheckLastFrame( pipeline.GetPointer(), reslicer.GetPointer(), __LINE__ ) != EXIT_SUCCESS )
+    {
+      return EXIT_FAILURE;
+    }
+    if (   pipeline->GetNumberOfSupersededRequests() + pipeline->GetNumberOfFinishedFrames()
+        != pipeline->GetNumberOfSubmittedRequests() )
+    {
+      std::cerr << "Line " << __LINE__ << ": " << numberOfBuffers << " buffers, "
+                << pipeline->GetNumberOfSubmittedRequests() << " requests submitted, "
+                << pipeline->GetNumberOfSupersededRequests() << " superseded, "
+                << pipeline->GetNumberOfFinishedFrames() << " finished" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    // The volume did not change: it was copied once.
+    if ( pipeline->GetNumberOfInputCopies() != 1 )
+    {
+      std::cerr << "Line " << __LINE__ << ": unchanged volume copied " << pipeline->GetNumberOfInputCopies()
+                << " times" << std::endl;
+      return EXIT_FAILURE;
+    }
+    pipeline->Stop();
+  }
+  return EXIT_SUCCESS;
+}
+
+
+//----------------------------------------------------------------------------
+int TestImageUpdates()
+{
+  vtkSmartPointer< vtkImageData > base = CreateTestVolume( VolumeSize );
+  vtkSmartPointer< vtkImageData > volume = CreateTestVolume( VolumeSize );
+  vtkSmartPointer< vtkImageData > expected = CreateTestVolume( VolumeSize );
+  vtkNew< vtkMatrix4x4 > rasToIJK;
+  CreateRASToIJK( rasToIJK.GetPointer(), VolumeSize );
+  vtkNew< vtkSliceImageReslicer > reslicer;
+  reslicer->SetInput( expected, rasToIJK.GetPointer() );
+  reslicer->IncrementalUpdateOff();
+  vtkNew< vtkAsyncSliceReslicer > pipeline;
+  pipeline->SetInput( volume, rasToIJK.GetPointer() );
+  pipeline->Start();
+
+  vtkNew< vtkMatrix4x4 > pose;
+  vtkNew< vtkMatrix4x4 > xyToRAS;
+  for ( int n = 0; n < NumberOfRounds; ++ n )
+  {
+    // Frame n is submitted, and frame n + 1 written into the volume while
+    // the worker may still be resampling it: the frame shown is frame n.
+    WriteFrame( volume, base, n );
+    SetStreamPose( pose.GetPointer(), 10 * n );
+    SetPoseXYToRAS( xyToRAS.GetPointer(), pose.GetPointer(), SliceSize, 1.0 );
+    pipeline->Submit( xyToRAS.GetPointer(), SliceSize, SliceSize );
+    WriteFrame( volume, base, n + 1 );
+
+    WriteFrame( expected, base, n );
+    reslicer->SetSliceGeometry( xyToRAS.GetPointer(), SliceSize, SliceSize );
+    reslicer->Update();
+    if ( CheckLastFrame( pipeline.GetPointer(), reslicer.GetPointer(), __LINE__ ) != EXIT_SUCCESS )
+    {
+      std::cerr << "Line " << __LINE__ << ": round " << n << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Submitting again along the last plane shows the volume as now written.
+  pipeline->Submit( xyToRAS.GetPointer(), SliceSize, SliceSize );
+  WriteFrame( expected, base, NumberOfRounds );
+  reslicer->Update();
+  if ( CheckLastFrame( pipeline.GetPointer(), reslicer.GetPointer(), __LINE__ ) != EXIT_SUCCESS )
+  {
+    return EXIT_FAILURE;
+  }
+  if ( pipeline->GetNumberOfInputCopies() != NumberOfRounds + 1 )
+  {
+    std::cerr << "Line " << __LINE__ << ": volume copied " << pipeline->GetNumberOfInputCopies() << " times for "
+              << NumberOfRounds + 1 << " modifications" << std::endl;
+    return EXIT_FAILURE;
+  }
+  pipeline->Stop();
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+
+//----------------------------------------------------------------------------
+/// Oblique planes resampled on the worker with 2 and 3 buffers: no request
+/// is lost, and the last frame is the synchronous reslice of the last
+/// plane, also when the volume is written again while a frame is in
+/// flight.
+int vtkAsyncSliceReslicerTest1( int, char*[] )
+{
+  if ( TestPoseStream() != EXIT_SUCCESS || TestImageUpdates() != EXIT_SUCCESS )
+  {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
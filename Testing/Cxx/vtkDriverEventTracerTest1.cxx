@@ -0,0 +1,449 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// VolumeResliceDriver includes
+#include "vtkDriverEventTracer.h"
+
+// VTK includes
+#include <vtkNew.h>
+
+// STD includes
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+
+namespace
+{
+
+struct JSONScalar
+{
+  bool IsString;
+  std::string Text;
+};
+
+/// Scalars of a JSON document by path, such as "traceEvents[2].args.driver".
+typedef std::map< std::string, JSONScalar > JSONDocument;
+
+/// Strict JSON parser, enough to check that chrome://tracing can load a
+/// trace: any syntax error fails the whole document.
+class JSONParser
+{
+public:
+  JSONParser( const std::string& text ) : Text( text ), Pos( 0 ) {}
+
+  bool Parse( JSONDocument& document )
+  {
+    if ( ! this->ParseValue( "", document ) )
+    {
+      return false;
+    }
+    this->SkipSpace();
+    return this->Pos == this->Text.size();
+  }
+
+  size_t GetPosition() { return this->Pos; }
+
+private:
+  void SkipSpace()
+  {
+    while ( this->Peek( ' ' ) || this->Peek( '\t' ) || this->Peek( '\r' ) || this->Peek( '\n' ) )
+    {
+      ++ this->Pos;
+    }
+  }
+
+  bool Accept( char c )
+  {
+    this->SkipSpace();
+    if ( this->Pos < this->Text.size() && this->Text[ this->Pos ] == c )
+    {
+      ++ this->Pos;
+      return true;
+    }
+    return false;
+  }
+
+  bool ParseValue( const std::string& path, JSONDocument& document )
+  {
+    this->SkipSpace();
+    if ( this->Pos >= this->Text.size() )
+    {
+      return false;
+    }
+    char c = this->Text[ this->Pos ];
+    if ( c == '{' )
+    {
+      return this->ParseObject( path, document );
+    }
+    if ( c == '[' )
+    {
+      return this->ParseArray( path, document );
+    }
+    JSONScalar scalar;
+    scalar.IsString = ( c == '"' );
+    if ( scalar.IsString ? ! this->ParseString( scalar.Text ) : ! this->ParseLiteral( scalar.Text ) )
+    {
+      return false;
+    }
+    document[ path ] = scalar;
+    return true;
+  }
+
+  bool ParseObject( const std::string& path, JSONDocument& document )
+  {
+    this->Accept( '{' );
+    if ( this->Accept( '}' ) )
+    {
+      return true;
+    }
+    do
+    {
+      std::string key;
+      this->SkipSpace();
+      if (    ! this->ParseString( key ) || ! this->Accept( ':' )
+           || ! this->ParseValue( path.empty() ? key : path + "." + key, document ) )
+      {
+        return false;
+      }
+    }
+    while ( this->Accept( ',' ) );
+    return this->Accept( '}' );
+  }
+
+  bool ParseArray( const std::string& path, JSONDocument& document )
+  {
+    this->Accept( '[' );
+    if ( this->Accept( ']' ) )
+    {
+      return true;
+    }
+    int index = 0;
+    do
+    {
+      std::ostringstream element;
+      element << path << "[" << index << "]";
+      ++ index;
+      if ( ! this->ParseValue( element.str(), document ) )
+      {
+        return false;
+      }
+    }
+    while ( this->Accept( ',' ) );
+    return this->Accept( ']' );
+  }
+
+  bool ParseString( std::string& s )
+  {
+    if ( this->Pos >= this->Text.size() || this->Text[ this->Pos ] != '"' )
+    {
+      return false;
+    }
+    for ( ++ this->Pos; this->Pos < this->Text.size(); ++ this->Pos )
+    {
+      unsigned char c = static_cast< unsigned char >( this->Text[ this->Pos ] );
+      if ( c == '"' )
+      {
+        ++ this->Pos;
+        return true;
+      }
+      if ( c < 0x20 )
+      {
+        return false;
+      }
+      if ( c == '\\' )
+      {
+        ++ this->Pos;
+        if ( this->Pos >= this->Text.size() || this->Text[ this->Pos ] == '\0'
+             || strchr( "\"\\/bfnrt", this->Text[ this->Pos ] ) == NULL )
+        {
+          return false;
+        }
+        c = static_cast< unsigned char >( this->Text[ this->Pos ] );
+      }
+      s += static_cast< char >( c );
+    }
+    return false;
+  }
+
+  /// A number (-?int frac? exp?), true, false or null.
+  bool ParseLiteral( std::string& s )
+  {
+    const char* words[3] = { "true", "false", "null" };
+    for ( int n = 0; n < 3; ++ n )
+    {
+      if ( this->Text.compare( this->Pos, strlen( words[ n ] ), words[ n ] ) == 0 )
+      {
+        s = words[ n ];
+        this->Pos += s.size();
+        return true;
+      }
+    }
+    size_t start = this->Pos;
+    if ( this->Peek( '-' ) )
+    {
+      ++ this->Pos;
+    }
+    if ( this->Peek( '0' ) )
+    {
+      ++ this->Pos;
+    }
+    else if ( ! this->SkipDigits() )
+    {
+      return false;
+    }
+    if ( this->Peek( '.' ) )
+    {
+      ++ this->Pos;
+      if ( ! this->SkipDigits() )
+      {
+        return false;
+      }
+    }
+    if ( this->Peek( 'e' ) || this->Peek( 'E' ) )
+    {
+      ++ this->Pos;
+      if ( this->Peek( '+' ) || this->Peek( '-' ) )
+      {
+        ++ this->Pos;
+      }
+      if ( ! this->SkipDigits() )
+      {
+        return false;
+      }
+    }
+    s = this->Text.substr( start, this->Pos - start );
+    return true;
+  }
+
+  bool Peek( char c )
+  {
+    return this->Pos < this->Text.size() && this->Text[ this->Pos ] == c;
+  }
+
+  bool SkipDigits()
+  {
+    size_t start = this->Pos;
+    while ( this->Pos < this->Text.size() && this->Text[ this->Pos ] >= '0' && this->Text[ this->Pos ] <= '9' )
+    {
+      ++ this->Pos;
+    }
+    return this->Pos > start;
+  }
+
+  std::string Text;
+  size_t Pos;
+};
+
+/// Parse the Chrome trace of the tracer.
+bool ReadTrace( vtkDriverEventTracer* tracer, JSONDocument& document, int line )
+{
+  std::ostringstream os;
+  tracer->WriteChromeTrace( os );
+  JSONParser parser( os.str() );
+  if ( ! parser.Parse( document ) )
+  {
+    std::cerr << "Line " << line << ": trace is not valid JSON at offset " << parser.GetPosition() << ":\n"
+              << os.str() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+std::string GetEventField( JSONDocument& document, int index, const char* field, bool* isString = NULL )
+{
+  std::ostringstream path;
+  path << "traceEvents[" << index << "]." << field;
+  JSONDocument::iterator it = document.find( path.str() );
+  if ( isString != NULL )
+  {
+    *isString = ( it != document.end() && it->second.IsString );
+  }
+  return it == document.end() ? std::string() : it->second.Text;
+}
+
+bool HasEvent( JSONDocument& document, int index )
+{
+  return ! GetEventField( document, index, "ph" ).empty();
+}
+
+/// Check the fields Chrome requires of every event after the thread name:
+/// spans need a duration, counters a value, both a timestamp.
+bool CheckEvents( JSONDocument& document, int expectedNumberOfEvents, int line )
+{
+  if ( GetEventField( document, 0, "ph" ) != "M" || GetEventField( document, 0, "args.name" ).empty() )
+  {
+    std::cerr << "Line " << line << ": trace does not start with the thread name" << std::endl;
+    return false;
+  }
+  int n = 1;
+  double lastTime = 0.0;
+  for ( ; HasEvent( document, n ); ++ n )
+  {
+    bool nameIsString = false;
+    bool tsIsString = true;
+    std::string phase = GetEventField( document, n, "ph" );
+    GetEventField( document, n, "name", &nameIsString );
+    std::string ts = GetEventField( document, n, "ts", &tsIsString );
+    double time = atof( ts.c_str() );
+    if ( ! nameIsString || ts.empty() || tsIsString || time < lastTime )
+    {
+      std::cerr << "Line " << line << ": event " << n << " lacks a name, or its timestamp " << ts
+                << " is before the previous one, " << lastTime << std::endl;
+      return false;
+    }
+    lastTime = time;
+    bool isString = true;
+    std::string required = GetEventField( document, n, phase == "X" ? "dur" : "args.value", &isString );
+    if ( ( phase != "X" && phase != "C" ) || required.empty() || isString || atof( required.c_str() ) < 0.0 )
+    {
+      std::cerr << "Line " << line << ": event " << n << " of phase " << phase
+                << " lacks a numeric duration or value" << std::endl;
+      return false;
+    }
+  }
+  if ( n - 1 != expectedNumberOfEvents )
+  {
+    std::cerr << "Line " << line << ": " << n - 1 << " events in the trace, expected "
+              << expectedNumberOfEvents << std::endl;
+    return false;
+  }
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+int TestSpans()
+{
+  vtkNew< vtkDriverEventTracer > tracer;
+
+  // Nothing is recorded, nor allocated, until tracing is enabled.
+  tracer->AddCounter( "Ignored", 1.0 );
+  JSONDocument document;
+  if ( tracer->GetNumberOfEvents() != 0 || ! ReadTrace( tracer.GetPointer(), document, __LINE__ )
+       || ! CheckEvents( document, 0, __LINE__ ) )
+  {
+    std::cerr << "Line " << __LINE__ << ": events recorded with tracing disabled" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  tracer->SetEnabled( true );
+  {
+    vtkDriverEventTracerSpan outer( tracer.GetPointer(), "UpdateSlice", "vtkMRMLLinearTransformNode4",
+                                    "vtkMRMLSliceNodeRed" );
+    vtkDriverEventTracerSpan inner( tracer.GetPointer(), "ApplySlicePlane" );
+  }
+  tracer->AddCounter( "PoseEvents", 42.0 );
+  // Node IDs are free text: quotes, backslashes and control characters
+  // must not break the JSON, and long IDs are truncated.
+  std::string longID( 100, 'x' );
+  tracer->AddSpan( "Escaped", vtkDriverEventTracer::GetTime(), "Driver \"A\"\\B\tC", longID.c_str() );
+
+  document.clear();
+  if ( ! ReadTrace( tracer.GetPointer(), document, __LINE__ ) || ! CheckEvents( document, 4, __LINE__ ) )
+  {
+    return EXIT_FAILURE;
+  }
+  // The inner span ends first, so it is recorded first.
+  if (    GetEventField( document, 1, "name" ) != "ApplySlicePlane"
+       || GetEventField( document, 2, "name" ) != "UpdateSlice"
+       || GetEventField( document, 2, "args.driver" ) != "vtkMRMLLinearTransformNode4"
+       || GetEventField( document, 2, "args.slice" ) != "vtkMRMLSliceNodeRed"
+       || atof( GetEventField( document, 2, "dur" ).c_str() ) < atof( GetEventField( document, 1, "dur" ).c_str() ) )
+  {
+    std::cerr << "Line " << __LINE__ << ": nested spans not recorded as written" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if ( GetEventField( document, 3, "ph" ) != "C" || atof( GetEventField( document, 3, "args.value" ).c_str() ) != 42.0 )
+  {
+    std::cerr << "Line " << __LINE__ << ": counter sample not recorded" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (    GetEventField( document, 4, "args.driver" ) != "Driver \"A\"\\BC"
+       || GetEventField( document, 4, "args.slice" ) != longID.substr( 0, 47 ) )
+  {
+    std::cerr << "Line " << __LINE__ << ": IDs not escaped or truncated: " << GetEventField( document, 4, "args.driver" )
+              << ", " << GetEventField( document, 4, "args.slice" ) << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+
+//----------------------------------------------------------------------------
+int TestRingOverflow()
+{
+  vtkNew< vtkDriverEventTracer > tracer;
+  tracer->SetCapacity( 16 );
+  tracer->SetEnabled( true );
+  for ( int n = 0; n < 20; ++ n )
+  {
+    tracer->AddCounter( "Sample", n );
+  }
+  if ( tracer->GetNumberOfEvents() != 16 || tracer->GetNumberOfLostEvents() != 4 )
+  {
+    std::cerr << "Line " << __LINE__ << ": " << tracer->GetNumberOfEvents() << " events kept and "
+              << tracer->GetNumberOfLostEvents() << " lost, expected 16 and 4" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // The ring is written oldest first, from the first sample not overwritten.
+  JSONDocument document;
+  if ( ! ReadTrace( tracer.GetPointer(), document, __LINE__ ) || ! CheckEvents( document, 16, __LINE__ ) )
+  {
+    return EXIT_FAILURE;
+  }
+  for ( int n = 0; n < 16; ++ n )
+  {
+    double value = atof( GetEventField( document, n + 1, "args.value" ).c_str() );
+    if ( value != n + 4 )
+    {
+      std::cerr << "Line " << __LINE__ << ": event " << n << " is sample " << value << ", expected "
+                << n + 4 << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  tracer->Clear();
+  document.clear();
+  if (    tracer->GetNumberOfEvents() != 0 || tracer->GetNumberOfLostEvents() != 0
+       || ! ReadTrace( tracer.GetPointer(), document, __LINE__ ) || ! CheckEvents( document, 0, __LINE__ ) )
+  {
+    std::cerr << "Line " << __LINE__ << ": events left after clearing the ring" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+
+//----------------------------------------------------------------------------
+/// The tracer writes what it recorded as a Chrome trace that parses as
+/// JSON, with the fields chrome://tracing requires of each event.
+int vtkDriverEventTracerTest1( int, char*[] )
+{
+  if ( TestSpans() != EXIT_SUCCESS
+       || TestRingOverflow() != EXIT_SUCCESS )
+  {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
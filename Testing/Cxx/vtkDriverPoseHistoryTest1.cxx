@@ -0,0 +1,260 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// VolumeResliceDriver includes
+#include "vtkDriverPoseHistory.h"
+#include "vtkVolumeResliceDriverTestingUtilities.h"
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+
+// STD includes
+#include <cmath>
+#include <iostream>
+
+using namespace vtkVolumeResliceDriverTestingUtilities;
+
+namespace
+{
+
+/// Tracker with non-uniform scale and a reflection, turning at 1 rad/s
+/// about an oblique axis while moving at 10 mm/s along each axis.
+void SetAffinePose( double time, vtkMatrix4x4* pose )
+{
+  double axis[3] = { 1.0 / sqrt( 3.0 ), 1.0 / sqrt( 3.0 ), 1.0 / sqrt( 3.0 ) };
+  double c = cos( time );
+  double s = sin( time );
+  double rotation[3][3];
+  for ( int row = 0; row < 3; ++ row )
+  {
+    for ( int column = 0; column < 3; ++ column )
+    {
+      rotation[ row ][ column ] = ( 1.0 - c ) * axis[ row ] * axis[ column ] + ( row == column ? c : 0.0 );
+    }
+  }
+  rotation[0][1] -= s * axis[2];
+  rotation[1][0] += s * axis[2];
+  rotation[0][2] += s * axis[1];
+  rotation[2][0] -= s * axis[1];
+  rotation[1][2] -= s * axis[0];
+  rotation[2][1] += s * axis[0];
+
+  const double scale[3] = { 0.3, -0.7, 1.2 };
+  pose->Identity();
+  for ( int row = 0; row < 3; ++ row )
+  {
+    for ( int column = 0; column < 3; ++ column )
+    {
+      pose->SetElement( row, column, rotation[ row ][ column ] * scale[ column ] );
+    }
+    pose->SetElement( row, 3, 10.0 * time + row );
+  }
+}
+
+
+//----------------------------------------------------------------------------
+int TestAffinePoses()
+{
+  vtkNew< vtkDriverPoseHistory > history;
+  vtkNew< vtkMatrix4x4 > pose;
+  vtkNew< vtkMatrix4x4 > expected;
+  const int numberOfSamples = 10;
+  const double interval = 0.1;
+  for ( int n = 0; n < numberOfSamples; ++ n )
+  {
+    SetAffinePose( n * interval, pose.GetPointer() );
+    history->AddPose( n * interval, pose.GetPointer() );
+  }
+
+  // At the time of a sample, the pose added; between samples, the pose of
+  // the motion, as it turns about a fixed axis and moves at constant speed.
+  for ( int n = 0; n < 2 * numberOfSamples - 1; ++ n )
+  {
+    double time = 0.5 * n * interval;
+    SetAffinePose( time, expected.GetPointer() );
+    if (    history->GetPose( time, pose.GetPointer() ) != vtkDriverPoseHistory::POSE_INTERPOLATED
+         || GetMaximumDifference( pose.GetPointer(), expected.GetPointer() ) > 1.0e-9 )
+    {
+      std::cerr << "Line " << __LINE__ << ": pose at " << time << " s is "
+                << GetMaximumDifference( pose.GetPointer(), expected.GetPointer() ) << " off the tracker pose"
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Beyond the newest sample the motion is extrapolated, up to the limit.
+  double newestTime = ( numberOfSamples - 1 ) * interval;
+  SetAffinePose( newestTime + 0.05, expected.GetPointer() );
+  if (    history->GetPose( newestTime + 0.05, pose.GetPointer() ) != vtkDriverPoseHistory::POSE_EXTRAPOLATED
+       || GetMaximumDifference( pose.GetPointer(), expected.GetPointer() ) > 1.0e-9 )
+  {
+    std::cerr << "Line " << __LINE__ << ": extrapolated pose off the tracker pose" << std::endl;
+    return EXIT_FAILURE;
+  }
+  SetAffinePose( newestTime + history->GetMaximumExtrapolation(), expected.GetPointer() );
+  history->GetPose( newestTime + 1.0, pose.GetPointer() );
+  if ( GetMaximumDifference( pose.GetPointer(), expected.GetPointer() ) > 1.0e-9 )
+  {
+    std::cerr << "Line " << __LINE__ << ": pose extrapolated beyond the limit" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Exported samples are the poses added.
+  vtkNew< vtkDoubleArray > times;
+  vtkNew< vtkDoubleArray > poses;
+  if ( history->ExportWindow( 0.0, newestTime, times.GetPointer(), poses.GetPointer() ) != numberOfSamples )
+  {
+    std::cerr << "Line " << __LINE__ << ": not all samples exported" << std::endl;
+    return EXIT_FAILURE;
+  }
+  for ( int n = 0; n < numberOfSamples; ++ n )
+  {
+    SetAffinePose( n * interval, expected.GetPointer() );
+    double matrix[16];
+    poses->GetTupleValue( n, matrix );
+    pose->DeepCopy( matrix );
+    if ( times->GetValue( n ) != n * interval || GetMaximumDifference( pose.GetPointer(), expected.GetPointer() ) > 1.0e-9 )
+    {
+      std::cerr << "Line " << __LINE__ << ": exported sample " << n << " differs from the pose added" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+
+//----------------------------------------------------------------------------
+int TestCapacity()
+{
+  const int capacity = 50;
+  const int numberOfSamples = 200;
+  const double interval = 0.01;
+  vtkNew< vtkDriverPoseHistory > history;
+  history->SetCapacity( capacity );
+  vtkNew< vtkMatrix4x4 > pose;
+  for ( int n = 0; n < numberOfSamples; ++ n )
+  {
+    SetAffinePose( n * interval, pose.GetPointer() );
+    history->AddPose( n * interval, pose.GetPointer() );
+  }
+
+  // Only the newest samples are kept.
+  int firstKept = numberOfSamples - capacity;
+  if (    history->GetNumberOfSamples() != capacity
+       || history->GetOldestTime() != firstKept * interval
+       || history->GetNewestTime() != ( numberOfSamples - 1 ) * interval )
+  {
+    std::cerr << "Line " << __LINE__ << ": " << history->GetNumberOfSamples() << " samples kept, expected "
+              << capacity << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // A window exports the samples inside it, bounds included.
+  vtkNew< vtkDoubleArray > times;
+  vtkNew< vtkDoubleArray > poses;
+  double start = ( firstKept + 10.5 ) * interval;
+  double end = ( firstKept + 20 ) * interval;
+  int exported = history->ExportWindow( start, end, times.GetPointer(), poses.GetPointer() );
+  if (    exported != 10 || times->GetNumberOfTuples() != 10 || poses->GetNumberOfTuples() != 10
+       || poses->GetNumberOfComponents() != 16 )
+  {
+    std::cerr << "Line " << __LINE__ << ": " << exported << " samples exported from the window, expected 10"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  vtkNew< vtkMatrix4x4 > expected;
+  for ( int i = 0; i < exported; ++ i )
+  {
+    double time = ( firstKept + 11 + i ) * interval;
+    SetAffinePose( time, expected.GetPointer() );
+    double matrix[16];
+    poses->GetTupleValue( i, matrix );
+    pose->DeepCopy( matrix );
+    if ( times->GetValue( i ) != time || GetMaximumDifference( pose.GetPointer(), expected.GetPointer() ) > 1.0e-9 )
+    {
+      std::cerr << "Line " << __LINE__ << ": exported sample " << i << " is not the sample at " << time << " s"
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Windows before, or after every kept sample are empty.
+  if (    history->ExportWindow( 0.0, ( firstKept - 1 ) * interval, times.GetPointer(), poses.GetPointer() ) != 0
+       || history->ExportWindow( numberOfSamples * interval, 1.0e12, times.GetPointer(), poses.GetPointer() ) != 0 )
+  {
+    std::cerr << "Line " << __LINE__ << ": samples exported outside the kept interval" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+
+//----------------------------------------------------------------------------
+int TestSameTime()
+{
+  vtkNew< vtkDriverPoseHistory > history;
+  vtkNew< vtkMatrix4x4 > pose;
+  vtkNew< vtkMatrix4x4 > expected;
+  for ( int n = 0; n < 3; ++ n )
+  {
+    SetAffinePose( n, pose.GetPointer() );
+    history->AddPose( n, pose.GetPointer() );
+  }
+
+  // A second pose at the newest time replaces the first one.
+  SetAffinePose( 5.0, expected.GetPointer() );
+  history->AddPose( 2.0, expected.GetPointer() );
+  history->GetPose( 2.0, pose.GetPointer() );
+  if ( history->GetNumberOfSamples() != 3 || GetMaximumDifference( pose.GetPointer(), expected.GetPointer() ) > 1.0e-9 )
+  {
+    std::cerr << "Line " << __LINE__ << ": a pose at the newest time did not replace the newest sample" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // An older one is ignored.
+  SetAffinePose( 7.0, pose.GetPointer() );
+  history->AddPose( 1.5, pose.GetPointer() );
+  history->GetPose( 2.0, pose.GetPointer() );
+  if ( history->GetNumberOfSamples() != 3 || GetMaximumDifference( pose.GetPointer(), expected.GetPointer() ) > 1.0e-9 )
+  {
+    std::cerr << "Line " << __LINE__ << ": a pose older than the newest sample was added" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+
+//----------------------------------------------------------------------------
+/// The pose history keeps the full affine pose of a tracker: poses looked
+/// up between samples turn, scale and reflect like the tracker. It keeps
+/// the newest Capacity samples, exports time windows of them, and of two
+/// poses at the same time keeps the later.
+int vtkDriverPoseHistoryTest1( int, char*[] )
+{
+  if (    TestAffinePoses() != EXIT_SUCCESS
+       || TestCapacity() != EXIT_SUCCESS
+       || TestSameTime() != EXIT_SUCCESS )
+  {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,164 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// VolumeResliceDriver includes
+#include "vtkDriverPoseLogReslicer.h"
+#include "vtkSliceImageReslicer.h"
+#include "vtkSlicerVolumeResliceDriverLogic.h"
+#include "vtkVolumeResliceDriverTestingUtilities.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkMetaImageReader.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace vtkVolumeResliceDriverTestingUtilities;
+
+namespace
+{
+
+const int VolumeSize = 32;
+const int SliceSize = 32;
+const int NumberOfPoses = 30;
+const double RampValue = 100.0;
+const double Ramp[3] = { 1.0, 2.0, 3.0 };
+
+/// Log of NumberOfPoses stream poses, with a comment, a blank line and a
+/// line too short to be a pose among them.
+std::string CreateLog()
+{
+  std::ostringstream log;
+  log.precision( 17 );
+  log << "# time, then the pose row by row\n";
+  vtkNew< vtkMatrix4x4 > pose;
+  for ( int n = 0; n < NumberOfPoses; ++ n )
+  {
+    SetStreamPose( pose.GetPointer(), n );
+    log << 1000.0 + n * 0.01;
+    for ( int k = 0; k < 16; ++ k )
+    {
+      log << " " << pose->Element[ k / 4 ][ k % 4 ];
+    }
+    log << "\n";
+    if ( n == NumberOfPoses / 2 )
+    {
+      log << "\n" << "1000.5 1 0 0\n";
+    }
+  }
+  return log.str();
+}
+
+std::string GetFileName( const char* pattern, int n )
+{
+  std::vector< char > fileName( strlen( pattern ) + 16 );
+  sprintf( &fileName[0], pattern, n );
+  return std::string( &fileName[0] );
+}
+
+std::string ReadFile( const std::string& fileName )
+{
+  std::ifstream file( fileName.c_str(), std::ios::binary );
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+} // namespace
+
+
+//----------------------------------------------------------------------------
+/// A pose log resliced on one thread and on three, in blocks smaller than
+/// the log: every pose is written, at its position in the volume, and
+/// the threads write the same images as the single thread.
+int vtkDriverPoseLogReslicerTest1( int, char*[] )
+{
+  vtkSmartPointer< vtkImageData > volume = CreateRampVolume( VolumeSize, RampValue, Ramp );
+  vtkNew< vtkMatrix4x4 > rasToIJK;
+  CreateRASToIJK( rasToIJK.GetPointer(), VolumeSize );
+  std::string log = CreateLog();
+
+  const int threadCounts[2] = { 1, 3 };
+  const char* patterns[2] = { "vtkDriverPoseLogReslicerTest1A_%03d.mha", "vtkDriverPoseLogReslicerTest1B_%03d.mha" };
+  for ( int run = 0; run < 2; ++ run )
+  {
+    vtkNew< vtkDriverPoseLogReslicer > reslicer;
+    reslicer->SetInput( volume, rasToIJK.GetPointer() );
+    reslicer->SetMethod( vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION );
+    reslicer->SetInterpolationMode( vtkSliceImageReslicer::INTERPOLATION_LINEAR );
+    reslicer->SetSliceDimensions( SliceSize, SliceSize );
+    reslicer->SetFieldOfView( SliceSize * 0.5, SliceSize * 0.5 );
+    reslicer->SetNumberOfThreads( threadCounts[ run ] );
+    reslicer->SetBlockSize( 4 );
+    reslicer->SetOutputFilePattern( patterns[ run ] );
+    std::istringstream input( log );
+    int written = reslicer->Reslice( input );
+    if ( written != NumberOfPoses || reslicer->GetNumberOfSkippedLines() != 1 )
+    {
+      std::cerr << "Line " << __LINE__ << ": " << written << " images written on " << threadCounts[ run ]
+                << " threads, " << reslicer->GetNumberOfSkippedLines() << " lines skipped" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // The center of each image is the position of its pose, where the ramp
+  // is known exactly.
+  int result = EXIT_SUCCESS;
+  vtkNew< vtkMatrix4x4 > pose;
+  for ( int n = 0; n < NumberOfPoses; ++ n )
+  {
+    std::string fileNames[2] = { GetFileName( patterns[0], n ), GetFileName( patterns[1], n ) };
+    if ( result == EXIT_SUCCESS )
+    {
+      vtkNew< vtkMetaImageReader > reader;
+      reader->SetFileName( fileNames[0].c_str() );
+      reader->Update();
+      SetStreamPose( pose.GetPointer(), n );
+      double position[4] = { pose->Element[0][3], pose->Element[1][3], pose->Element[2][3], 1.0 };
+      double ijk[4];
+      rasToIJK->MultiplyPoint( position, ijk );
+      double expected = RampValue + Ramp[0] * ijk[0] + Ramp[1] * ijk[1] + Ramp[2] * ijk[2];
+      double center = reader->GetOutput()->GetScalarComponentAsDouble( SliceSize / 2, SliceSize / 2, 0, 0 );
+      if ( fabs( center - expected ) > 1.0e-3 )
+      {
+        std::cerr << "Line " << __LINE__ << ": image " << n << " is " << center << " at its center, expected "
+                  << expected << std::endl;
+        result = EXIT_FAILURE;
+      }
+      std::string contents = ReadFile( fileNames[0] );
+      if ( result == EXIT_SUCCESS && ( contents.empty() || contents != ReadFile( fileNames[1] ) ) )
+      {
+        std::cerr << "Line " << __LINE__ << ": image " << n << " differs between one and three threads" << std::endl;
+        result = EXIT_FAILURE;
+      }
+    }
+    remove( fileNames[0].c_str() );
+    remove( fileNames[1].c_str() );
+  }
+  return result;
+}
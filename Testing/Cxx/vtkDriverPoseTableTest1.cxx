@@ -0,0 +1,217 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// VolumeResliceDriver includes
+#include "vtkDriverPoseTable.h"
+#include "vtkSlicerVolumeResliceDriverLogic.h"
+#include "vtkVolumeResliceDriverTestingUtilities.h"
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+
+// STD includes
+#include <cmath>
+#include <iostream>
+
+using namespace vtkVolumeResliceDriverTestingUtilities;
+
+namespace
+{
+
+const int NumberOfRows = 37;
+
+/// Stream pose n, its in-plane axes scaled for odd n as a calibrated probe
+/// gives them, and its normal zero for every seventh.
+void SetTablePose( vtkMatrix4x4* pose, int n )
+{
+  SetStreamPose( pose, 13 * n );
+  double scale = ( n % 2 == 1 ) ? 0.3 + 0.01 * n : 1.0;
+  for ( int k = 0; k < 3; ++ k )
+  {
+    pose->Element[ k ][0] *= scale;
+    pose->Element[ k ][1] *= scale;
+    if ( n % 7 == 6 )
+    {
+      pose->Element[ k ][2] = 0.0;
+    }
+  }
+}
+
+/// The frame of a computed row is the plane ComputeSlicePlane() gives for
+/// the pose, for both methods, up to float rounding.
+int CheckRow( vtkDriverPoseTable* table, int row, vtkMatrix4x4* pose, int line )
+{
+  const int methods[2] = { vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION,
+                           vtkSlicerVolumeResliceDriverLogic::METHOD_POSITION };
+  for ( int m = 0; m < 2; ++ m )
+  {
+    vtkSlicerVolumeResliceDriverLogic::SlicePlane plane;
+    vtkSlicerVolumeResliceDriverLogic::ComputeSlicePlane( pose, methods[ m ],
+                                                          vtkSlicerVolumeResliceDriverLogic::ORIENTATION_INPLANE,
+                                                          plane );
+    float transverse[3];
+    float normal[3];
+    float position[3];
+    table->GetSliceFrame( row, methods[ m ] == vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION,
+                          transverse, normal, position );
+    for ( int k = 0; k < 3; ++ k )
+    {
+      if (    fabs( plane.Transverse[ k ] - transverse[ k ] ) > 1.0e-5
+           || fabs( plane.Normal[ k ] - normal[ k ] ) > 1.0e-5
+           || fabs( plane.Position[ k ] - position[ k ] ) > 1.0e-5 * ( 1.0 + fabs( plane.Position[ k ] ) ) )
+      {
+        std::cerr << "Line " << line << ": row " << row << " differs from its slice plane" << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  float scales[3];
+  table->GetScales( row, scales );
+  for ( int c = 0; c < 3; ++ c )
+  {
+    double length = sqrt( pose->Element[0][ c ] * pose->Element[0][ c ] + pose->Element[1][ c ] * pose->Element[1][ c ]
+                          + pose->Element[2][ c ] * pose->Element[2][ c ] );
+    if ( fabs( scales[ c ] - length ) > 1.0e-5 * ( 1.0 + length ) )
+    {
+      std::cerr << "Line " << line << ": row " << row << ", axis " << c << " of length " << scales[ c ]
+                << ", expected " << length << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+
+//----------------------------------------------------------------------------
+int TestFrames()
+{
+  vtkNew< vtkDriverPoseTable > table;
+  table->SetNumberOfRows( NumberOfRows );
+  vtkNew< vtkMatrix4x4 > pose;
+
+  // New rows are identity poses, already computed.
+  if (    table->Update() != 0
+       || CheckRow( table.GetPointer(), NumberOfRows - 1, pose.GetPointer(), __LINE__ ) != EXIT_SUCCESS )
+  {
+    std::cerr << "Line " << __LINE__ << ": new rows are not computed identity poses" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  for ( int row = 0; row < NumberOfRows; ++ row )
+  {
+    SetTablePose( pose.GetPointer(), row );
+    table->SetPose( row, &pose->Element[0][0] );
+  }
+  if ( table->Update() != NumberOfRows )
+  {
+    std::cerr << "Line " << __LINE__ << ": not every row computed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  for ( int row = 0; row < NumberOfRows; ++ row )
+  {
+    SetTablePose( pose.GetPointer(), row );
+    if ( CheckRow( table.GetPointer(), row, pose.GetPointer(), __LINE__ ) != EXIT_SUCCESS )
+    {
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Growing the table keeps the computed rows.
+  table->SetNumberOfRows( 3 * NumberOfRows );
+  for ( int row = 0; row < NumberOfRows; ++ row )
+  {
+    SetTablePose( pose.GetPointer(), row );
+    if ( CheckRow( table.GetPointer(), row, pose.GetPointer(), __LINE__ ) != EXIT_SUCCESS )
+    {
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+
+//----------------------------------------------------------------------------
+int TestDirtyRows()
+{
+  vtkNew< vtkDriverPoseTable > table;
+  table->SetNumberOfRows( NumberOfRows );
+  vtkNew< vtkMatrix4x4 > pose;
+
+  // Rows from the first to the last dirty one are computed, once.
+  SetTablePose( pose.GetPointer(), 20 );
+  table->SetPose( 20, &pose->Element[0][0] );
+  SetTablePose( pose.GetPointer(), 5 );
+  table->SetPose( 5, &pose->Element[0][0] );
+  if (    ( table->GetFlags( 5 ) & vtkDriverPoseTable::FLAG_DIRTY ) == 0
+       || ( table->GetFlags( 6 ) & vtkDriverPoseTable::FLAG_DIRTY ) != 0 )
+  {
+    std::cerr << "Line " << __LINE__ << ": dirty flags not those of the rows set" << std::endl;
+    return EXIT_FAILURE;
+  }
+  int computed = table->Update();
+  if (    computed != 16 || table->Update() != 0 || table->GetNumberOfComputedRows() != 16
+       || ( table->GetFlags( 5 ) & vtkDriverPoseTable::FLAG_DIRTY ) != 0 )
+  {
+    std::cerr << "Line " << __LINE__ << ": " << computed << " rows computed for rows 5 to 20, "
+              << table->GetNumberOfComputedRows() << " in all" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if ( CheckRow( table.GetPointer(), 5, pose.GetPointer(), __LINE__ ) != EXIT_SUCCESS )
+  {
+    return EXIT_FAILURE;
+  }
+
+  // A row set twice before an update keeps the later pose.
+  SetTablePose( pose.GetPointer(), 8 );
+  table->SetPose( 20, &pose->Element[0][0] );
+  SetTablePose( pose.GetPointer(), 9 );
+  table->SetPose( 20, &pose->Element[0][0] );
+  if ( table->Update() != 1 || CheckRow( table.GetPointer(), 20, pose.GetPointer(), __LINE__ ) != EXIT_SUCCESS )
+  {
+    std::cerr << "Line " << __LINE__ << ": row set twice not computed once with its later pose" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Shrinking the table past a dirty row leaves nothing to compute.
+  table->SetPose( 30, &pose->Element[0][0] );
+  table->SetNumberOfRows( 10 );
+  if ( table->Update() != 0 || table->GetNumberOfRows() != 10 )
+  {
+    std::cerr << "Line " << __LINE__ << ": removed row computed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+
+//----------------------------------------------------------------------------
+/// Slice frames computed by the pose table in batches are those of
+/// ComputeSlicePlane(), for unit and scaled axes, and only the rows set
+/// since the last update are computed.
+int vtkDriverPoseTableTest1( int, char*[] )
+{
+  if ( TestFrames() != EXIT_SUCCESS || TestDirtyRows() != EXIT_SUCCESS )
+  {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,249 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// VolumeResliceDriver includes
+#include "vtkImageFrameCompounder.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+
+const int FrameSize = 10;
+
+/// Single-slice float frame of FrameSize^2 pixels, all of the given value.
+vtkSmartPointer< vtkImageData > CreateFrame( float value )
+{
+  vtkSmartPointer< vtkImageData > frame = vtkSmartPointer< vtkImageData >::New();
+  frame->SetDimensions( FrameSize, FrameSize, 1 );
+  frame->SetScalarTypeToFloat();
+  frame->SetNumberOfScalarComponents( 1 );
+  frame->AllocateScalars();
+  float* pixel = static_cast< float* >( frame->GetScalarPointer() );
+  for ( int n = 0; n < FrameSize * FrameSize; ++ n )
+  {
+    pixel[ n ] = value;
+  }
+  return frame;
+}
+
+/// Compounder with a FrameSize^3 output of 1 mm voxels at the RAS origin.
+void SetupCompounder( vtkImageFrameCompounder* compounder, int mode )
+{
+  int extent[6] = { 0, FrameSize - 1, 0, FrameSize - 1, 0, FrameSize - 1 };
+  compounder->SetOutputExtent( extent );
+  compounder->SetOutputSpacing( 1.0, 1.0, 1.0 );
+  compounder->SetOutputOrigin( 0.0, 0.0, 0.0 );
+  compounder->SetInsertionMode( mode );
+}
+
+/// Insert a constant frame in the axial plane at the given height.
+void InsertAxialFrame( vtkImageFrameCompounder* compounder, float value, double z )
+{
+  vtkNew< vtkMatrix4x4 > ijkToRAS;
+  ijkToRAS->SetElement( 2, 3, z );
+  compounder->InsertFrame( CreateFrame( value ), ijkToRAS.GetPointer() );
+}
+
+float GetVoxel( vtkImageFrameCompounder* compounder, int x, int y, int z )
+{
+  return *static_cast< float* >( compounder->GetOutput()->GetScalarPointer( x, y, z ) );
+}
+
+
+//----------------------------------------------------------------------------
+int TestNearestInsertion()
+{
+  vtkNew< vtkImageFrameCompounder > compounder;
+  SetupCompounder( compounder.GetPointer(), vtkImageFrameCompounder::INSERTION_NEAREST );
+  if ( ! compounder->Reset() )
+  {
+    std::cerr << "Line " << __LINE__ << ": Reset failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Two frames in the same plane average; the planes next to them stay empty.
+  InsertAxialFrame( compounder.GetPointer(), 100.0f, 4.9 );
+  InsertAxialFrame( compounder.GetPointer(), 200.0f, 5.2 );
+  if ( compounder->GetNumberOfInsertedFrames() != 2 )
+  {
+    std::cerr << "Line " << __LINE__ << ": inserted " << compounder->GetNumberOfInsertedFrames()
+              << " frames, expected 2" << std::endl;
+    return EXIT_FAILURE;
+  }
+  for ( int z = 4; z <= 6; ++ z )
+  {
+    float expected = ( z == 5 ) ? 150.0f : 0.0f;
+    for ( int y = 0; y < FrameSize; ++ y )
+    {
+      for ( int x = 0; x < FrameSize; ++ x )
+      {
+        float value = GetVoxel( compounder.GetPointer(), x, y, z );
+        if ( fabs( value - expected ) > 1e-3 )
+        {
+          std::cerr << "Line " << __LINE__ << ": voxel " << x << " " << y << " " << z << " is "
+                    << value << ", expected " << expected << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+    }
+  }
+
+  // The output does not depend on how the frame is split between threads.
+  vtkNew< vtkMatrix4x4 > oblique;
+  oblique->SetElement( 0, 0, 0.8 );
+  oblique->SetElement( 2, 0, 0.6 );
+  oblique->SetElement( 0, 2, -0.6 );
+  oblique->SetElement( 2, 2, 0.8 );
+  oblique->SetElement( 0, 3, 1.3 );
+  oblique->SetElement( 2, 3, 1.7 );
+  vtkNew< vtkImageFrameCompounder > single;
+  vtkNew< vtkImageFrameCompounder > threaded;
+  SetupCompounder( single.GetPointer(), vtkImageFrameCompounder::INSERTION_NEAREST );
+  SetupCompounder( threaded.GetPointer(), vtkImageFrameCompounder::INSERTION_NEAREST );
+  single->SetNumberOfThreads( 1 );
+  threaded->SetNumberOfThreads( 3 );
+  single->InsertFrame( CreateFrame( 42.0f ), oblique.GetPointer() );
+  threaded->InsertFrame( CreateFrame( 42.0f ), oblique.GetPointer() );
+  if ( memcmp( single->GetOutput()->GetScalarPointer(), threaded->GetOutput()->GetScalarPointer(),
+               FrameSize * FrameSize * FrameSize * sizeof( float ) ) != 0 )
+  {
+    std::cerr << "Line " << __LINE__ << ": threaded insertion differs from single-threaded" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+
+//----------------------------------------------------------------------------
+int TestDistanceWeightedInsertion()
+{
+  vtkNew< vtkImageFrameCompounder > compounder;
+  SetupCompounder( compounder.GetPointer(), vtkImageFrameCompounder::INSERTION_DISTANCE_WEIGHTED );
+  compounder->Reset();
+
+  // A frame a quarter voxel above z = 5 weighs 0.75 in plane 5 and 0.25 in
+  // plane 6, and the other way round for a frame a quarter below z = 6.
+  InsertAxialFrame( compounder.GetPointer(), 100.0f, 5.25 );
+  InsertAxialFrame( compounder.GetPointer(), 200.0f, 5.75 );
+  const float expected[3] = { 0.0f, 125.0f, 175.0f };
+  for ( int z = 4; z <= 6; ++ z )
+  {
+    float value = GetVoxel( compounder.GetPointer(), 3, 7, z );
+    if ( fabs( value - expected[ z - 4 ] ) > 1e-3 )
+    {
+      std::cerr << "Line " << __LINE__ << ": voxel in plane " << z << " is " << value
+                << ", expected " << expected[ z - 4 ] << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+
+//----------------------------------------------------------------------------
+int TestMemoryLimit()
+{
+  vtkNew< vtkImageFrameCompounder > compounder;
+  compounder->SetMaximumMemoryInMB( 1 );
+
+  // 64^3 voxels with their weights need 2 MB.
+  compounder->SetOutputExtent( 0, 63, 0, 63, 0, 63 );
+  if ( compounder->Reset() || compounder->GetOutput() != NULL )
+  {
+    std::cerr << "Line " << __LINE__ << ": output allocated beyond the memory limit" << std::endl;
+    return EXIT_FAILURE;
+  }
+  InsertAxialFrame( compounder.GetPointer(), 1.0f, 0.0 );
+  if ( compounder->GetNumberOfInsertedFrames() != 0 || compounder->GetOutput() != NULL )
+  {
+    std::cerr << "Line " << __LINE__ << ": frame inserted beyond the memory limit" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // 32^3 voxels need 0.25 MB.
+  compounder->SetOutputExtent( 0, 31, 0, 31, 0, 31 );
+  if ( ! compounder->Reset() || compounder->GetOutput() == NULL )
+  {
+    std::cerr << "Line " << __LINE__ << ": output not allocated within the memory limit" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+
+//----------------------------------------------------------------------------
+int TestFillHoles()
+{
+  vtkNew< vtkImageFrameCompounder > compounder;
+  SetupCompounder( compounder.GetPointer(), vtkImageFrameCompounder::INSERTION_NEAREST );
+  compounder->Reset();
+  InsertAxialFrame( compounder.GetPointer(), 100.0f, 2.0 );
+  InsertAxialFrame( compounder.GetPointer(), 300.0f, 4.0 );
+  compounder->FillHoles();
+
+  // Plane 3 lies between the two frames, plane 1 next to one of them only;
+  // plane 0 has no filled neighbor and stays empty.
+  const float expected[5] = { 0.0f, 100.0f, 100.0f, 200.0f, 300.0f };
+  for ( int z = 0; z < 5; ++ z )
+  {
+    float value = GetVoxel( compounder.GetPointer(), 5, 5, z );
+    if ( fabs( value - expected[ z ] ) > 1e-3 )
+    {
+      std::cerr << "Line " << __LINE__ << ": voxel in plane " << z << " is " << value
+                << " after filling, expected " << expected[ z ] << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Filled voxels are not hits: the next frame through them replaces them.
+  InsertAxialFrame( compounder.GetPointer(), 50.0f, 3.0 );
+  float value = GetVoxel( compounder.GetPointer(), 5, 5, 3 );
+  if ( fabs( value - 50.0f ) > 1e-3 )
+  {
+    std::cerr << "Line " << __LINE__ << ": filled voxel is " << value
+              << " after a frame reached it, expected 50" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+
+//----------------------------------------------------------------------------
+int vtkImageFrameCompounderTest1( int, char*[] )
+{
+  if ( TestNearestInsertion() != EXIT_SUCCESS
+       || TestDistanceWeightedInsertion() != EXIT_SUCCESS
+       || TestMemoryLimit() != EXIT_SUCCESS
+       || TestFillHoles() != EXIT_SUCCESS )
+  {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,233 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// VolumeResliceDriver includes
+#include "vtkLabelMapSliceReslicer.h"
+#include "vtkSliceImageReslicer.h"
+#include "vtkVolumeResliceDriverTestingUtilities.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkCellData.h>
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cmath>
+#include <iostream>
+#include <map>
+
+using namespace vtkVolumeResliceDriverTestingUtilities;
+
+namespace
+{
+
+const int VolumeSize = 64;
+const int SliceSize = 128;
+const double SlicePixelSpacing = 0.5;
+
+/// Nested, wavy labels 1 to 15 around the center of the volume, each
+/// times labelStep so that unsigned short labels pass 255.
+vtkSmartPointer< vtkImageData > CreateLabelMap( int scalarType, int labelStep )
+{
+  vtkSmartPointer< vtkImageData > labelMap = vtkSmartPointer< vtkImageData >::New();
+  labelMap->SetExtent( 0, VolumeSize - 1, 0, VolumeSize - 1, 0, VolumeSize - 1 );
+  labelMap->SetWholeExtent( 0, VolumeSize - 1, 0, VolumeSize - 1, 0, VolumeSize - 1 );
+  labelMap->SetScalarType( scalarType );
+  labelMap->SetNumberOfScalarComponents( 1 );
+  labelMap->AllocateScalars();
+  double center = VolumeSize / 2.0;
+  vtkIdType i = 0;
+  for ( int z = 0; z < VolumeSize; ++ z )
+  {
+    for ( int y = 0; y < VolumeSize; ++ y )
+    {
+      for ( int x = 0; x < VolumeSize; ++ x, ++ i )
+      {
+        double r = sqrt( ( x - center ) * ( x - center ) + ( y - center ) * ( y - center )
+                         + ( z - center ) * ( z - center ) );
+        int label = static_cast< int >( r / 2.0 + 2.0 * sin( 0.2 * x ) * cos( 0.3 * y ) );
+        label = ( label >= 1 && label <= 15 ) ? label * labelStep : 0;
+        if ( scalarType == VTK_UNSIGNED_CHAR )
+        {
+          static_cast< unsigned char* >( labelMap->GetScalarPointer() )[ i ] = static_cast< unsigned char >( label );
+        }
+        else
+        {
+          static_cast< unsigned short* >( labelMap->GetScalarPointer() )[ i ] = static_cast< unsigned short >( label );
+        }
+      }
+    }
+  }
+  return labelMap;
+}
+
+/// Pixel edges between each label of the slice and its neighbors, the
+/// outside of the slice counting as label 0.
+void CountEdges( vtkImageData* slice, std::map< int, double >& edges )
+{
+  edges.clear();
+  for ( int y = -1; y < SliceSize; ++ y )
+  {
+    for ( int x = -1; x < SliceSize; ++ x )
+    {
+      int label = ( x >= 0 && y >= 0 ) ? static_cast< int >( slice->GetScalarComponentAsDouble( x, y, 0, 0 ) ) : 0;
+      if ( y >= 0 )
+      {
+        int right = ( x + 1 < SliceSize ) ? static_cast< int >( slice->GetScalarComponentAsDouble( x + 1, y, 0, 0 ) ) : 0;
+        if ( label != right )
+        {
+          edges[ label ] += 1.0;
+          edges[ right ] += 1.0;
+        }
+      }
+      if ( x >= 0 )
+      {
+        int above = ( y + 1 < SliceSize ) ? static_cast< int >( slice->GetScalarComponentAsDouble( x, y + 1, 0, 0 ) ) : 0;
+        if ( label != above )
+        {
+          edges[ label ] += 1.0;
+          edges[ above ] += 1.0;
+        }
+      }
+    }
+  }
+}
+
+/// The outlines of the slice are closed, and the outline length of each
+/// label, in pixels, is its count of pixel edges.
+int CheckOutlines( vtkLabelMapSliceReslicer* reslicer, int plane )
+{
+  std::map< int, double > edges;
+  CountEdges( reslicer->GetOutput(), edges );
+  edges.erase( 0 );
+
+  vtkPolyData* outlines = reslicer->GetContourOutput();
+  vtkDataArray* outlineLabels = outlines->GetCellData()->GetScalars();
+  std::map< int, double > lengths;
+  vtkCellArray* lines = outlines->GetLines();
+  vtkIdType numberOfPoints = 0;
+  vtkIdType* pointIds = NULL;
+  vtkIdType cell = 0;
+  lines->InitTraversal();
+  while ( lines->GetNextCell( numberOfPoints, pointIds ) )
+  {
+    if ( numberOfPoints < 2 || pointIds[0] != pointIds[ numberOfPoints - 1 ] )
+    {
+      std::cerr << "Line " << __LINE__ << ": plane " << plane << ", outline " << cell << " is open" << std::endl;
+      return EXIT_FAILURE;
+    }
+    int label = static_cast< int >( outlineLabels->GetTuple1( cell ++ ) );
+    for ( vtkIdType i = 0; i + 1 < numberOfPoints; ++ i )
+    {
+      double a[3];
+      double b[3];
+      outlines->GetPoint( pointIds[ i ], a );
+      outlines->GetPoint( pointIds[ i + 1 ], b );
+      lengths[ label ] += sqrt( vtkMath::Distance2BetweenPoints( a, b ) ) / SlicePixelSpacing;
+    }
+  }
+
+  if ( reslicer->GetNumberOfLabels() != static_cast< int >( edges.size() ) || lengths.size() != edges.size() )
+  {
+    std::cerr << "Line " << __LINE__ << ": plane " << plane << ", " << reslicer->GetNumberOfLabels()
+              << " labels outlined, " << lengths.size() << " with outlines, " << edges.size() << " in the slice"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  for ( std::map< int, double >::const_iterator it = edges.begin(); it != edges.end(); ++ it )
+  {
+    double length = lengths[ it->first ];
+    if ( fabs( length - it->second ) > 1.0e-6 * it->second + 1.0e-6 )
+    {
+      std::cerr << "Line " << __LINE__ << ": plane " << plane << ", label " << it->first << " outlined over "
+                << length << " pixels, " << it->second << " pixel edges" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+
+//----------------------------------------------------------------------------
+/// Unsigned char and unsigned short label maps resliced along oblique
+/// planes with their outlines: the labels are those of the generic
+/// nearest-neighbor reslice, and the outlines are closed and run along
+/// the pixel edges between labels.
+int vtkLabelMapSliceReslicerTest1( int, char*[] )
+{
+  const int scalarTypes[2] = { VTK_UNSIGNED_CHAR, VTK_UNSIGNED_SHORT };
+  const int labelSteps[2] = { 1, 1000 };
+  vtkNew< vtkMatrix4x4 > rasToIJK;
+  CreateRASToIJK( rasToIJK.GetPointer(), VolumeSize );
+  for ( int t = 0; t < 2; ++ t )
+  {
+    vtkSmartPointer< vtkImageData > labelMap = CreateLabelMap( scalarTypes[ t ], labelSteps[ t ] );
+    vtkNew< vtkSliceImageReslicer > generic;
+    generic->SetInput( labelMap, rasToIJK.GetPointer() );
+    generic->SetInterpolationMode( vtkSliceImageReslicer::INTERPOLATION_NEAREST );
+    generic->IncrementalUpdateOff();
+    vtkNew< vtkLabelMapSliceReslicer > contoured;
+    contoured->SetInput( labelMap, rasToIJK.GetPointer() );
+
+    vtkNew< vtkMatrix4x4 > pose;
+    vtkNew< vtkMatrix4x4 > xyToRAS;
+    for ( int n = 0; n < 10; ++ n )
+    {
+      SetStreamPose( pose.GetPointer(), 10 * n );
+      SetPoseXYToRAS( xyToRAS.GetPointer(), pose.GetPointer(), SliceSize, SlicePixelSpacing );
+      generic->SetSliceGeometry( xyToRAS.GetPointer(), SliceSize, SliceSize );
+      generic->Update();
+      contoured->SetSliceGeometry( xyToRAS.GetPointer(), SliceSize, SliceSize );
+      contoured->Update();
+
+      vtkImageData* labels = contoured->GetOutput();
+      if ( labels->GetScalarType() != scalarTypes[ t ] )
+      {
+        std::cerr << "Line " << __LINE__ << ": labels of type " << scalarTypes[ t ] << " resliced as type "
+                  << labels->GetScalarType() << std::endl;
+        return EXIT_FAILURE;
+      }
+      for ( int y = 0; y < SliceSize; ++ y )
+      {
+        for ( int x = 0; x < SliceSize; ++ x )
+        {
+          if (   labels->GetScalarComponentAsDouble( x, y, 0, 0 )
+              != generic->GetOutput()->GetScalarComponentAsDouble( x, y, 0, 0 ) )
+          {
+            std::cerr << "Line " << __LINE__ << ": plane " << n << ", pixel " << x << " " << y
+                      << " differs from the nearest-neighbor reslice" << std::endl;
+            return EXIT_FAILURE;
+          }
+        }
+      }
+      if ( CheckOutlines( contoured.GetPointer(), n ) != EXIT_SUCCESS )
+      {
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  return EXIT_SUCCESS;
+}
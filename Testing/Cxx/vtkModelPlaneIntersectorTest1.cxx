@@ -0,0 +1,281 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// VolumeResliceDriver includes
+#include "vtkModelPlaneIntersector.h"
+#include "vtkVolumeResliceDriverTestingUtilities.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+using namespace vtkVolumeResliceDriverTestingUtilities;
+
+namespace
+{
+
+const double Radius = 80.0;
+const int NumberOfSegments = 96;
+const int NumberOfPlanes = 30;
+
+/// Sphere of n segments around and n / 2 rings: quads between the rings,
+/// triangles at the poles.
+vtkSmartPointer< vtkPolyData > CreateSphere()
+{
+  const int numberOfRings = NumberOfSegments / 2;
+  vtkSmartPointer< vtkPoints > points = vtkSmartPointer< vtkPoints >::New();
+  vtkSmartPointer< vtkCellArray > polys = vtkSmartPointer< vtkCellArray >::New();
+  points->InsertNextPoint( 0.0, 0.0, Radius );
+  for ( int j = 1; j < numberOfRings; ++ j )
+  {
+    double theta = vtkMath::Pi() * j / numberOfRings;
+    for ( int i = 0; i < NumberOfSegments; ++ i )
+    {
+      double phi = 2.0 * vtkMath::Pi() * i / NumberOfSegments;
+      points->InsertNextPoint( Radius * sin( theta ) * cos( phi ), Radius * sin( theta ) * sin( phi ),
+                               Radius * cos( theta ) );
+    }
+  }
+  vtkIdType southPole = points->InsertNextPoint( 0.0, 0.0, -Radius );
+  for ( int j = 0; j < numberOfRings; ++ j )
+  {
+    for ( int i = 0; i < NumberOfSegments; ++ i )
+    {
+      vtkIdType above = 1 + ( j - 1 ) * NumberOfSegments;
+      vtkIdType below = 1 + j * NumberOfSegments;
+      vtkIdType next = ( i + 1 ) % NumberOfSegments;
+      if ( j == 0 )
+      {
+        polys->InsertNextCell( 3 );
+        polys->InsertCellPoint( 0 );
+        polys->InsertCellPoint( below + i );
+        polys->InsertCellPoint( below + next );
+      }
+      else if ( j == numberOfRings - 1 )
+      {
+        polys->InsertNextCell( 3 );
+        polys->InsertCellPoint( southPole );
+        polys->InsertCellPoint( above + next );
+        polys->InsertCellPoint( above + i );
+      }
+      else
+      {
+        polys->InsertNextCell( 4 );
+        polys->InsertCellPoint( above + i );
+        polys->InsertCellPoint( below + i );
+        polys->InsertCellPoint( below + next );
+        polys->InsertCellPoint( above + next );
+      }
+    }
+  }
+  vtkSmartPointer< vtkPolyData > mesh = vtkSmartPointer< vtkPolyData >::New();
+  mesh->SetPoints( points );
+  mesh->SetPolys( polys );
+  return mesh;
+}
+
+/// Plane n of the test: through the position of stream pose 10 n, normal
+/// to its third axis.
+void GetPlane( int n, double origin[3], double normal[3] )
+{
+  vtkNew< vtkMatrix4x4 > pose;
+  SetStreamPose( pose.GetPointer(), 10 * n );
+  for ( int k = 0; k < 3; ++ k )
+  {
+    origin[ k ] = pose->Element[ k ][ 3 ];
+    normal[ k ] = pose->Element[ k ][ 2 ];
+  }
+}
+
+/// Length of the polylines of a cut, and whether all are closed.
+double GetCutLength( vtkPolyData* cut, bool& closed )
+{
+  double length = 0.0;
+  closed = true;
+  vtkCellArray* lines = cut->GetLines();
+  vtkIdType numberOfPoints = 0;
+  vtkIdType* pointIds = NULL;
+  lines->InitTraversal();
+  while ( lines->GetNextCell( numberOfPoints, pointIds ) )
+  {
+    closed = closed && numberOfPoints > 2 && pointIds[0] == pointIds[ numberOfPoints - 1 ];
+    for ( vtkIdType i = 0; i + 1 < numberOfPoints; ++ i )
+    {
+      double a[3];
+      double b[3];
+      cut->GetPoint( pointIds[ i ], a );
+      cut->GetPoint( pointIds[ i + 1 ], b );
+      length += sqrt( vtkMath::Distance2BetweenPoints( a, b ) );
+    }
+  }
+  return length;
+}
+
+
+//----------------------------------------------------------------------------
+int TestSphereCuts()
+{
+  vtkSmartPointer< vtkPolyData > mesh = CreateSphere();
+  vtkNew< vtkModelPlaneIntersector > indexed;
+  indexed->SetInput( mesh );
+  vtkNew< vtkModelPlaneIntersector > exhaustive;
+  exhaustive->SetInput( mesh );
+  exhaustive->UseIndexOff();
+
+  vtkNew< vtkPolyData > indexedCut;
+  vtkNew< vtkPolyData > exhaustiveCut;
+  for ( int n = 0; n < NumberOfPlanes; ++ n )
+  {
+    double origin[3];
+    double normal[3];
+    GetPlane( n, origin, normal );
+    int numberOfLines = indexed->Intersect( origin, normal, NULL, indexedCut.GetPointer() );
+    int exhaustiveLines = exhaustive->Intersect( origin, normal, NULL, exhaustiveCut.GetPointer() );
+    if (    numberOfLines != exhaustiveLines
+         || indexedCut->GetNumberOfPoints() != exhaustiveCut->GetNumberOfPoints()
+         || indexed->GetNumberOfCutTriangles() != exhaustive->GetNumberOfCutTriangles() )
+    {
+      std::cerr << "Line " << __LINE__ << ": plane " << n << " cut into " << numberOfLines << " lines through "
+                << indexed->GetNumberOfCutTriangles() << " triangles, " << exhaustiveLines << " lines through "
+                << exhaustive->GetNumberOfCutTriangles() << " without the index" << std::endl;
+      return EXIT_FAILURE;
+    }
+    if ( indexed->GetNumberOfTestedTriangles() >= exhaustive->GetNumberOfTestedTriangles() )
+    {
+      std::cerr << "Line " << __LINE__ << ": plane " << n << ", " << indexed->GetNumberOfTestedTriangles()
+                << " triangles tested through the index, " << exhaustive->GetNumberOfTestedTriangles()
+                << " without" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    // One loop close to the circle of the sphere in the plane, or none;
+    // planes grazing the sphere are not checked.
+    double distance = fabs( vtkMath::Dot( origin, normal ) ) / vtkMath::Norm( normal );
+    if ( fabs( distance - Radius ) < 1.0 )
+    {
+      continue;
+    }
+    double circle = 2.0 * vtkMath::Pi() * sqrt( std::max( 0.0, Radius * Radius - distance * distance ) );
+    bool closed = false;
+    double length = GetCutLength( indexedCut.GetPointer(), closed );
+    if ( numberOfLines != ( distance < Radius ? 1 : 0 ) || ! closed || fabs( length - circle ) > 0.01 * circle )
+    {
+      std::cerr << "Line " << __LINE__ << ": plane " << n << " cut into " << numberOfLines << " lines of length "
+                << length << ( closed ? "" : ", not closed" ) << ", circle of length " << circle << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  if ( indexed->GetNumberOfIndexBuilds() != 1 )
+  {
+    std::cerr << "Line " << __LINE__ << ": index built " << indexed->GetNumberOfIndexBuilds() << " times for "
+              << NumberOfPlanes << " cuts of one mesh" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+
+//----------------------------------------------------------------------------
+int TestMeshToOutput()
+{
+  vtkSmartPointer< vtkPolyData > mesh = CreateSphere();
+  vtkNew< vtkModelPlaneIntersector > intersector;
+  intersector->SetInput( mesh );
+  double origin[3] = { 0.0, 0.0, 10.0 };
+  double normal[3] = { 0.0, 0.0, 1.0 };
+  vtkNew< vtkPolyData > cut;
+  intersector->Intersect( origin, normal, NULL, cut.GetPointer() );
+
+  // Mapped points are the mesh points through the matrix.
+  vtkNew< vtkMatrix4x4 > meshToOutput;
+  meshToOutput->Element[0][3] = 5.0;
+  meshToOutput->Element[1][3] = -3.0;
+  meshToOutput->Element[2][3] = 2.0;
+  vtkNew< vtkPolyData > mappedCut;
+  intersector->Intersect( origin, normal, meshToOutput.GetPointer(), mappedCut.GetPointer() );
+  if ( mappedCut->GetNumberOfPoints() != cut->GetNumberOfPoints() || cut->GetNumberOfPoints() == 0 )
+  {
+    std::cerr << "Line " << __LINE__ << ": " << mappedCut->GetNumberOfPoints() << " points mapped from "
+              << cut->GetNumberOfPoints() << std::endl;
+    return EXIT_FAILURE;
+  }
+  for ( vtkIdType i = 0; i < cut->GetNumberOfPoints(); ++ i )
+  {
+    double point[3];
+    double mapped[3];
+    cut->GetPoint( i, point );
+    mappedCut->GetPoint( i, mapped );
+    for ( int k = 0; k < 3; ++ k )
+    {
+      if ( fabs( mapped[ k ] - point[ k ] - meshToOutput->Element[ k ][ 3 ] ) > 1.0e-9 )
+      {
+        std::cerr << "Line " << __LINE__ << ": point " << i << " not mapped through the matrix" << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  // Moving the mesh rebuilds the index on the next cut, which follows it.
+  vtkPoints* points = mesh->GetPoints();
+  for ( vtkIdType i = 0; i < points->GetNumberOfPoints(); ++ i )
+  {
+    double point[3];
+    points->GetPoint( i, point );
+    points->SetPoint( i, point[0], point[1], point[2] + 20.0 );
+  }
+  points->Modified();
+  origin[2] = 30.0;
+  intersector->Intersect( origin, normal, NULL, mappedCut.GetPointer() );
+  bool closed = false;
+  if (    intersector->GetNumberOfIndexBuilds() != 2
+       || fabs( GetCutLength( mappedCut.GetPointer(), closed ) - GetCutLength( cut.GetPointer(), closed ) ) > 1.0e-6 )
+  {
+    std::cerr << "Line " << __LINE__ << ": cut of the moved mesh after " << intersector->GetNumberOfIndexBuilds()
+              << " index builds differs from the cut before the move" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+
+//----------------------------------------------------------------------------
+/// A tessellated sphere cut along oblique planes through the triangle
+/// hierarchy: the cuts are those of testing every triangle, closed circles
+/// of the sphere, mapped through the output matrix, and follow the mesh
+/// when it moves.
+int vtkModelPlaneIntersectorTest1( int, char*[] )
+{
+  if ( TestSphereCuts() != EXIT_SUCCESS || TestMeshToOutput() != EXIT_SUCCESS )
+  {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,173 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// VolumeResliceDriver includes
+#include "vtkMultiVolumeReslicer.h"
+#include "vtkSliceImageReslicer.h"
+#include "vtkVolumeResliceDriverTestingUtilities.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cmath>
+#include <iostream>
+
+using namespace vtkVolumeResliceDriverTestingUtilities;
+
+namespace
+{
+
+const int NumberOfLayers = 3;
+const int SliceSize = 48;
+const int NumberOfPlanes = 10;
+
+/// Layer l of a fused view: a short CT of 64^3 1 mm voxels, and a float MR
+/// and a label map of 32^3 2 mm voxels, the MR tilted about its z axis.
+void CreateLayer( int l, vtkSmartPointer< vtkImageData >& volume, vtkSmartPointer< vtkMatrix4x4 >& rasToIJK )
+{
+  rasToIJK = vtkSmartPointer< vtkMatrix4x4 >::New();
+  if ( l == 0 )
+  {
+    volume = CreateTestVolume( 64 );
+    CreateRASToIJK( rasToIJK, 64 );
+    return;
+  }
+
+  vtkSmartPointer< vtkImageData > small = CreateTestVolume( 32 );
+  const short* in = static_cast< const short* >( small->GetScalarPointer() );
+  volume = vtkSmartPointer< vtkImageData >::New();
+  volume->SetExtent( small->GetExtent() );
+  volume->SetWholeExtent( small->GetExtent() );
+  volume->SetScalarType( ( l == 1 ) ? VTK_FLOAT : VTK_UNSIGNED_CHAR );
+  volume->SetNumberOfScalarComponents( 1 );
+  volume->AllocateScalars();
+  for ( vtkIdType i = 0; i < 32 * 32 * 32; ++ i )
+  {
+    if ( l == 1 )
+    {
+      static_cast< float* >( volume->GetScalarPointer() )[ i ] = in[ i ] * 0.5f + 0.125f;
+    }
+    else
+    {
+      static_cast< unsigned char* >( volume->GetScalarPointer() )[ i ] = static_cast< unsigned char >( ( in[ i ] / 200 ) & 7 );
+    }
+  }
+
+  double angle = ( l == 1 ) ? 0.2 : 0.0;
+  rasToIJK->Element[0][0] = 0.5 * cos( angle );
+  rasToIJK->Element[0][1] = 0.5 * sin( angle );
+  rasToIJK->Element[1][0] = -0.5 * sin( angle );
+  rasToIJK->Element[1][1] = 0.5 * cos( angle );
+  rasToIJK->Element[2][2] = 0.5;
+  for ( int k = 0; k < 3; ++ k )
+  {
+    rasToIJK->Element[ k ][ 3 ] = 16.0;
+  }
+}
+
+} // namespace
+
+
+//----------------------------------------------------------------------------
+/// Three volumes of different types and geometries resliced along the same
+/// oblique planes in one pass: each layer matches its separate reslice up
+/// to rounding, and the pass reuses one output buffer per layer.
+int vtkMultiVolumeReslicerTest1( int, char*[] )
+{
+  vtkSmartPointer< vtkImageData > volumes[ NumberOfLayers ];
+  vtkSmartPointer< vtkMatrix4x4 > rasToIJK[ NumberOfLayers ];
+  vtkSmartPointer< vtkSliceImageReslicer > separate[ NumberOfLayers ];
+  vtkNew< vtkMultiVolumeReslicer > combined;
+  combined->SetNumberOfThreads( 2 );
+  combined->SetNumberOfLayers( NumberOfLayers );
+  for ( int l = 0; l < NumberOfLayers; ++ l )
+  {
+    CreateLayer( l, volumes[ l ], rasToIJK[ l ] );
+    int interpolation = ( l == 2 ) ? vtkSliceImageReslicer::INTERPOLATION_NEAREST
+                                   : vtkSliceImageReslicer::INTERPOLATION_LINEAR;
+    separate[ l ] = vtkSmartPointer< vtkSliceImageReslicer >::New();
+    separate[ l ]->SetInput( volumes[ l ], rasToIJK[ l ] );
+    separate[ l ]->SetInterpolationMode( interpolation );
+    separate[ l ]->IncrementalUpdateOff();
+    combined->SetLayer( l, volumes[ l ], rasToIJK[ l ], interpolation );
+  }
+
+  vtkIdType differing[ NumberOfLayers ] = { 0, 0, 0 };
+  vtkNew< vtkMatrix4x4 > pose;
+  vtkNew< vtkMatrix4x4 > xyToRAS;
+  vtkIdType count = static_cast< vtkIdType >( SliceSize ) * SliceSize;
+  for ( int n = 0; n < NumberOfPlanes; ++ n )
+  {
+    SetStreamPose( pose.GetPointer(), 10 * n );
+    SetPoseXYToRAS( xyToRAS.GetPointer(), pose.GetPointer(), SliceSize, 1.0 );
+    combined->SetSliceGeometry( xyToRAS.GetPointer(), SliceSize, SliceSize );
+    combined->Update();
+    for ( int l = 0; l < NumberOfLayers; ++ l )
+    {
+      separate[ l ]->SetSliceGeometry( xyToRAS.GetPointer(), SliceSize, SliceSize );
+      separate[ l ]->Update();
+      vtkImageData* a = separate[ l ]->GetOutput();
+      vtkImageData* b = combined->GetOutput( l );
+      int dimensions[3];
+      b->GetDimensions( dimensions );
+      if (    a->GetScalarType() != b->GetScalarType()
+           || dimensions[0] != SliceSize || dimensions[1] != SliceSize )
+      {
+        std::cerr << "Line " << __LINE__ << ": layer " << l << " of another type or size than its separate reslice"
+                  << std::endl;
+        return EXIT_FAILURE;
+      }
+      // The two paths map positions in a different order, so samples on a
+      // rounding boundary may land on either side of it.
+      double tolerance = ( l == 1 ) ? 1.0e-3 : 1.0;
+      for ( vtkIdType i = 0; i < count; ++ i )
+      {
+        int x = static_cast< int >( i % SliceSize );
+        int y = static_cast< int >( i / SliceSize );
+        double difference = fabs(   a->GetScalarComponentAsDouble( x, y, 0, 0 )
+                                  - b->GetScalarComponentAsDouble( x, y, 0, 0 ) );
+        if ( l != 2 && difference > tolerance )
+        {
+          std::cerr << "Line " << __LINE__ << ": plane " << n << ", layer " << l << " differs by " << difference
+                    << " from its separate reslice" << std::endl;
+          return EXIT_FAILURE;
+        }
+        differing[ l ] += ( difference > 0.0 ) ? 1 : 0;
+      }
+    }
+  }
+
+  // Nearest labels may only differ on the rare rounding boundaries.
+  if ( differing[2] > count * NumberOfPlanes / 1000 )
+  {
+    std::cerr << "Line " << __LINE__ << ": " << differing[2] << " labels differ from the separate reslice"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  if ( combined->GetNumberOfAllocatedOutputs() != NumberOfLayers )
+  {
+    std::cerr << "Line " << __LINE__ << ": " << combined->GetNumberOfAllocatedOutputs()
+              << " output buffers allocated for " << NumberOfLayers << " layers" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
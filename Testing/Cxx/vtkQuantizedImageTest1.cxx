@@ -0,0 +1,233 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// VolumeResliceDriver includes
+#include "vtkQuantizedImage.h"
+#include "vtkSliceImageReslicer.h"
+#include "vtkVolumeResliceDriverTestingUtilities.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+using namespace vtkVolumeResliceDriverTestingUtilities;
+
+namespace
+{
+
+/// Not a multiple of the 8-voxel bricks.
+const int VolumeSize = 36;
+const int SliceSize = 48;
+
+/// Float copy of the test volume with a fractional part, as left by
+/// filtering or resampling.
+vtkSmartPointer< vtkImageData > CreateFloatVolume()
+{
+  vtkSmartPointer< vtkImageData > shortVolume = CreateTestVolume( VolumeSize );
+  vtkSmartPointer< vtkImageData > volume = vtkSmartPointer< vtkImageData >::New();
+  volume->SetExtent( shortVolume->GetExtent() );
+  volume->SetWholeExtent( shortVolume->GetExtent() );
+  volume->SetScalarTypeToFloat();
+  volume->SetNumberOfScalarComponents( 1 );
+  volume->AllocateScalars();
+  const short* in = static_cast< const short* >( shortVolume->GetScalarPointer() );
+  float* out = static_cast< float* >( volume->GetScalarPointer() );
+  vtkIdType count = static_cast< vtkIdType >( VolumeSize ) * VolumeSize * VolumeSize;
+  for ( vtkIdType i = 0; i < count; ++ i )
+  {
+    out[ i ] = static_cast< float >( in[ i ] + 0.25 * sin( 0.1 * ( i % VolumeSize ) ) );
+  }
+  return volume;
+}
+
+/// Every voxel of a plain copy decodes to its source value within the
+/// maximum error, and a compressed copy holds the same codes.
+int CheckCodes( vtkImageData* volume, vtkQuantizedImage* plain, vtkQuantizedImage* compressed, int line )
+{
+  double maximumError = plain->GetMaximumError();
+  if ( compressed->GetMaximumError() != maximumError || maximumError > plain->GetScale() / 2.0 )
+  {
+    std::cerr << "Line " << line << ": maximum error " << maximumError << " beyond half the scale "
+              << plain->GetScale() << std::endl;
+    return EXIT_FAILURE;
+  }
+  const unsigned char* codes8 = static_cast< const unsigned char* >( plain->GetCodePointer() );
+  const unsigned short* codes16 = static_cast< const unsigned short* >( plain->GetCodePointer() );
+  vtkIdType i = 0;
+  for ( int z = 0; z < VolumeSize; ++ z )
+  {
+    for ( int y = 0; y < VolumeSize; ++ y )
+    {
+      for ( int x = 0; x < VolumeSize; ++ x, ++ i )
+      {
+        unsigned int code = ( plain->GetBitsPerVoxel() == 8 ) ? codes8[ i ] : codes16[ i ];
+        double value = code * plain->GetScale() + plain->GetShift();
+        double error = fabs( value - volume->GetScalarComponentAsDouble( x, y, z, 0 ) );
+        // The float source values themselves are rounded.
+        if ( error > maximumError * 1.0001 + 1.0e-6 || compressed->GetBrickCode( x, y, z ) != code )
+        {
+          std::cerr << "Line " << line << ": voxel " << x << " " << y << " " << z << " decoded " << error
+                    << " off its source value, or compressed differently" << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+
+//----------------------------------------------------------------------------
+int TestCodes()
+{
+  // Integer volumes whose range fits the codes are kept exactly.
+  vtkSmartPointer< vtkImageData > shortVolume = CreateTestVolume( VolumeSize );
+  vtkSmartPointer< vtkImageData > floatVolume = CreateFloatVolume();
+  vtkImageData* volumes[2] = { shortVolume, floatVolume };
+  for ( int v = 0; v < 2; ++ v )
+  {
+    for ( int bits = 8; bits <= 16; bits += 8 )
+    {
+      vtkNew< vtkQuantizedImage > plain;
+      vtkNew< vtkQuantizedImage > compressed;
+      if ( ! plain->Build( volumes[ v ], bits, false ) || ! compressed->Build( volumes[ v ], bits, true ) )
+      {
+        std::cerr << "Line " << __LINE__ << ": cannot build a " << bits << "-bit copy" << std::endl;
+        return EXIT_FAILURE;
+      }
+      if ( CheckCodes( volumes[ v ], plain.GetPointer(), compressed.GetPointer(), __LINE__ ) != EXIT_SUCCESS )
+      {
+        return EXIT_FAILURE;
+      }
+      if ( v == 0 && bits == 16 && plain->GetMaximumError() != 0.0 )
+      {
+        std::cerr << "Line " << __LINE__ << ": short volume not kept exactly in 16 bits" << std::endl;
+        return EXIT_FAILURE;
+      }
+      if ( compressed->GetMemorySize() >= plain->GetMemorySize() )
+      {
+        std::cerr << "Line " << __LINE__ << ": compressed copy of " << compressed->GetMemorySize()
+                  << " bytes, plain copy of " << plain->GetMemorySize() << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  // Other bit depths are refused.
+  vtkNew< vtkQuantizedImage > copy;
+  if ( copy->Build( floatVolume, 12, false ) || ! copy->IsEmpty() )
+  {
+    std::cerr << "Line " << __LINE__ << ": 12-bit copy built" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+
+//----------------------------------------------------------------------------
+int TestReslice()
+{
+  vtkSmartPointer< vtkImageData > volume = CreateFloatVolume();
+  vtkNew< vtkMatrix4x4 > rasToIJK;
+  CreateRASToIJK( rasToIJK.GetPointer(), VolumeSize );
+
+  // Full precision, then for each bit depth the plain and compressed copy.
+  const int NumberOfSources = 5;
+  const int bits[ NumberOfSources ] = { 0, 8, 8, 16, 16 };
+  const bool compressed[ NumberOfSources ] = { false, false, true, false, true };
+  vtkSmartPointer< vtkQuantizedImage > copies[ NumberOfSources ];
+  vtkSmartPointer< vtkSliceImageReslicer > reslicers[ NumberOfSources ];
+  for ( int r = 0; r < NumberOfSources; ++ r )
+  {
+    reslicers[ r ] = vtkSmartPointer< vtkSliceImageReslicer >::New();
+    reslicers[ r ]->SetInterpolationMode( vtkSliceImageReslicer::INTERPOLATION_LINEAR );
+    if ( bits[ r ] == 0 )
+    {
+      reslicers[ r ]->SetInput( volume, rasToIJK.GetPointer() );
+      continue;
+    }
+    copies[ r ] = vtkSmartPointer< vtkQuantizedImage >::New();
+    copies[ r ]->Build( volume, bits[ r ], compressed[ r ] );
+    reslicers[ r ]->SetQuantizedInput( copies[ r ], rasToIJK.GetPointer() );
+  }
+
+  // Oblique planes through the volume: each copy stays within its error
+  // of the full-precision slice, and compressed copies reslice exactly as
+  // plain ones.
+  vtkNew< vtkMatrix4x4 > pose;
+  vtkNew< vtkMatrix4x4 > xyToRAS;
+  vtkIdType count = static_cast< vtkIdType >( SliceSize ) * SliceSize;
+  for ( int n = 0; n < 10; ++ n )
+  {
+    SetStreamPose( pose.GetPointer(), 10 * n );
+    SetPoseXYToRAS( xyToRAS.GetPointer(), pose.GetPointer(), SliceSize, 0.7 );
+    for ( int r = 0; r < NumberOfSources; ++ r )
+    {
+      reslicers[ r ]->SetSliceGeometry( xyToRAS.GetPointer(), SliceSize, SliceSize );
+      reslicers[ r ]->Update();
+    }
+    const float* full = static_cast< const float* >( reslicers[0]->GetOutput()->GetScalarPointer() );
+    for ( int r = 1; r < NumberOfSources; ++ r )
+    {
+      // The float sums of the interpolation differ in the last bits.
+      double bound = copies[ r ]->GetMaximumError() * 1.0001 + 1.0e-3;
+      const float* quantized = static_cast< const float* >( reslicers[ r ]->GetOutput()->GetScalarPointer() );
+      for ( vtkIdType i = 0; i < count; ++ i )
+      {
+        if ( fabs( static_cast< double >( quantized[ i ] ) - full[ i ] ) > bound )
+        {
+          std::cerr << "Line " << __LINE__ << ": plane " << n << ", " << bits[ r ] << "-bit copy "
+                    << fabs( static_cast< double >( quantized[ i ] ) - full[ i ] ) << " off, bound " << bound
+                    << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+      if (    compressed[ r ]
+           && memcmp( quantized, reslicers[ r - 1 ]->GetOutput()->GetScalarPointer(), count * sizeof( float ) ) != 0 )
+      {
+        std::cerr << "Line " << __LINE__ << ": plane " << n << ", compressed " << bits[ r ]
+                  << "-bit copy resliced differently from the plain one" << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+
+//----------------------------------------------------------------------------
+/// 8 and 16-bit copies of a volume, plain and brick-compressed, decode
+/// within their maximum error and reslice within it, compressed copies
+/// exactly as plain ones.
+int vtkQuantizedImageTest1( int, char*[] )
+{
+  if ( TestCodes() != EXIT_SUCCESS || TestReslice() != EXIT_SUCCESS )
+  {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,248 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// VolumeResliceDriver includes
+#include "vtkResliceImageCache.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+
+/// 256 x 256 float images take 256 kB, so four fit in 1 MB.
+const int ImageSize = 256;
+const unsigned long ImageBytes = ImageSize * ImageSize * sizeof( float );
+
+vtkSmartPointer< vtkImageData > CreateImage( float value )
+{
+  vtkSmartPointer< vtkImageData > image = vtkSmartPointer< vtkImageData >::New();
+  image->SetDimensions( ImageSize, ImageSize, 1 );
+  image->SetScalarTypeToFloat();
+  image->SetNumberOfScalarComponents( 1 );
+  image->AllocateScalars();
+  float* pixel = static_cast< float* >( image->GetScalarPointer() );
+  for ( int n = 0; n < ImageSize * ImageSize; ++ n )
+  {
+    pixel[ n ] = value + n;
+  }
+  return image;
+}
+
+/// XYToRAS of an axial plane at the given height.
+void SetPlane( vtkMatrix4x4* xyToRAS, double z )
+{
+  xyToRAS->Identity();
+  xyToRAS->SetElement( 0, 3, -0.5 * ImageSize );
+  xyToRAS->SetElement( 1, 3, -0.5 * ImageSize );
+  xyToRAS->SetElement( 2, 3, z );
+}
+
+bool SameImage( vtkImageData* a, vtkImageData* b )
+{
+  return a != NULL && b != NULL
+         && memcmp( a->GetScalarPointer(), b->GetScalarPointer(), ImageBytes ) == 0;
+}
+
+
+//----------------------------------------------------------------------------
+int TestHit()
+{
+  vtkNew< vtkResliceImageCache > cache;
+  vtkNew< vtkMatrix4x4 > rasToIJK;
+  vtkNew< vtkMatrix4x4 > xyToRAS;
+  SetPlane( xyToRAS.GetPointer(), 10.0 );
+  vtkSmartPointer< vtkImageData > image = CreateImage( 1.0f );
+  cache->Insert( "vtkMRMLScalarVolumeNode1", 1, rasToIJK.GetPointer(), xyToRAS.GetPointer(),
+                 ImageSize, ImageSize, 1, image );
+
+  vtkImageData* found = cache->Find( "vtkMRMLScalarVolumeNode1", 1, rasToIJK.GetPointer(), xyToRAS.GetPointer(),
+                                     ImageSize, ImageSize, 1 );
+  if ( ! SameImage( found, image ) || found == image.GetPointer() )
+  {
+    std::cerr << "Line " << __LINE__ << ": the cache does not return a copy of the inserted image" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // A pose within the position step hits, and FindCopy returns the pose
+  // the image was resampled at.
+  vtkNew< vtkMatrix4x4 > nearby;
+  SetPlane( nearby.GetPointer(), 10.01 );
+  vtkNew< vtkImageData > target;
+  vtkNew< vtkMatrix4x4 > targetXYToRAS;
+  if (    ! cache->FindCopy( "vtkMRMLScalarVolumeNode1", 1, rasToIJK.GetPointer(), nearby.GetPointer(),
+                             ImageSize, ImageSize, 1, target.GetPointer(), targetXYToRAS.GetPointer() )
+       || ! SameImage( target.GetPointer(), image )
+       || targetXYToRAS->GetElement( 2, 3 ) != 10.0 )
+  {
+    std::cerr << "Line " << __LINE__ << ": no hit for a pose within the position step" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if ( cache->GetNumberOfHits() != 2 || cache->GetNumberOfMisses() != 0 || cache->GetHitRate() != 1.0 )
+  {
+    std::cerr << "Line " << __LINE__ << ": " << cache->GetNumberOfHits() << " hits and "
+              << cache->GetNumberOfMisses() << " misses, expected 2 and 0" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+
+//----------------------------------------------------------------------------
+int TestMiss()
+{
+  vtkNew< vtkResliceImageCache > cache;
+  vtkNew< vtkMatrix4x4 > rasToIJK;
+  vtkNew< vtkMatrix4x4 > xyToRAS;
+  SetPlane( xyToRAS.GetPointer(), 10.0 );
+  cache->Insert( "vtkMRMLScalarVolumeNode1", 1, rasToIJK.GetPointer(), xyToRAS.GetPointer(),
+                 ImageSize, ImageSize, 1, CreateImage( 1.0f ) );
+
+  // Each lookup differs from the inserted key in one part.
+  vtkNew< vtkMatrix4x4 > movedVolume;
+  movedVolume->SetElement( 0, 3, 2.0 );
+  vtkNew< vtkMatrix4x4 > movedPlane;
+  SetPlane( movedPlane.GetPointer(), 11.0 );
+  vtkNew< vtkMatrix4x4 > tiltedPlane;
+  SetPlane( tiltedPlane.GetPointer(), 10.0 );
+  tiltedPlane->SetElement( 2, 0, 0.01 );
+  const char* volumeIDs[6] = { "vtkMRMLScalarVolumeNode1", "vtkMRMLScalarVolumeNode1", "vtkMRMLScalarVolumeNode1",
+                               "vtkMRMLScalarVolumeNode1", "vtkMRMLScalarVolumeNode1", "vtkMRMLScalarVolumeNode2" };
+  const unsigned long mtimes[6] = { 2, 1, 1, 1, 1, 1 };
+  vtkMatrix4x4* rasToIJKs[6] = { rasToIJK.GetPointer(), movedVolume.GetPointer(), rasToIJK.GetPointer(),
+                                 rasToIJK.GetPointer(), rasToIJK.GetPointer(), rasToIJK.GetPointer() };
+  vtkMatrix4x4* xyToRASs[6] = { xyToRAS.GetPointer(), xyToRAS.GetPointer(), movedPlane.GetPointer(),
+                                tiltedPlane.GetPointer(), xyToRAS.GetPointer(), xyToRAS.GetPointer() };
+  const int widths[6] = { ImageSize, ImageSize, ImageSize, ImageSize, ImageSize / 2, ImageSize };
+  const char* changes[6] = { "volume modified", "volume moved", "plane moved", "plane tilted", "size changed",
+                             "other volume" };
+  for ( int n = 0; n < 6; ++ n )
+  {
+    if ( cache->Find( volumeIDs[ n ], mtimes[ n ], rasToIJKs[ n ], xyToRASs[ n ], widths[ n ], ImageSize, 1 ) != NULL )
+    {
+      std::cerr << "Line " << __LINE__ << ": hit after " << changes[ n ] << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if ( cache->Find( "vtkMRMLScalarVolumeNode1", 1, rasToIJK.GetPointer(), xyToRAS.GetPointer(),
+                    ImageSize, ImageSize, 0 ) != NULL )
+  {
+    std::cerr << "Line " << __LINE__ << ": hit after interpolation changed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if ( cache->GetNumberOfMisses() != 7 || cache->GetNumberOfHits() != 0 )
+  {
+    std::cerr << "Line " << __LINE__ << ": " << cache->GetNumberOfMisses() << " misses, expected 7" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // A newer version of the volume replaces the images of the older one.
+  cache->Insert( "vtkMRMLScalarVolumeNode1", 2, rasToIJK.GetPointer(), xyToRAS.GetPointer(),
+                 ImageSize, ImageSize, 1, CreateImage( 2.0f ) );
+  if ( cache->GetNumberOfEntries() != 1 || cache->GetMemoryUsageInBytes() != ImageBytes )
+  {
+    std::cerr << "Line " << __LINE__ << ": " << cache->GetNumberOfEntries()
+              << " entries after the volume was modified, expected 1" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+
+//----------------------------------------------------------------------------
+int TestEviction()
+{
+  vtkNew< vtkResliceImageCache > cache;
+  cache->SetMaximumMemoryInMB( 1 );
+  vtkNew< vtkMatrix4x4 > rasToIJK;
+  vtkNew< vtkMatrix4x4 > xyToRAS;
+  vtkSmartPointer< vtkImageData > images[5];
+  for ( int n = 0; n < 4; ++ n )
+  {
+    images[ n ] = CreateImage( 10.0f * n );
+    SetPlane( xyToRAS.GetPointer(), n );
+    cache->Insert( "vtkMRMLScalarVolumeNode1", 1, rasToIJK.GetPointer(), xyToRAS.GetPointer(),
+                   ImageSize, ImageSize, 1, images[ n ] );
+  }
+
+  // Using plane 0 leaves plane 1 least recently used, so it makes room
+  // for plane 4.
+  SetPlane( xyToRAS.GetPointer(), 0 );
+  cache->Find( "vtkMRMLScalarVolumeNode1", 1, rasToIJK.GetPointer(), xyToRAS.GetPointer(), ImageSize, ImageSize, 1 );
+  images[4] = CreateImage( 40.0f );
+  SetPlane( xyToRAS.GetPointer(), 4 );
+  cache->Insert( "vtkMRMLScalarVolumeNode1", 1, rasToIJK.GetPointer(), xyToRAS.GetPointer(),
+                 ImageSize, ImageSize, 1, images[4] );
+  if ( cache->GetNumberOfEntries() != 4 || cache->GetMemoryUsageInBytes() != 4 * ImageBytes )
+  {
+    std::cerr << "Line " << __LINE__ << ": " << cache->GetNumberOfEntries() << " entries using "
+              << cache->GetMemoryUsageInBytes() << " bytes, expected 4 using " << 4 * ImageBytes << std::endl;
+    return EXIT_FAILURE;
+  }
+  for ( int n = 0; n < 5; ++ n )
+  {
+    SetPlane( xyToRAS.GetPointer(), n );
+    vtkImageData* found = cache->Find( "vtkMRMLScalarVolumeNode1", 1, rasToIJK.GetPointer(), xyToRAS.GetPointer(),
+                                       ImageSize, ImageSize, 1 );
+    if ( ( n == 1 ) != ( found == NULL ) || ( found != NULL && ! SameImage( found, images[ n ] ) ) )
+    {
+      std::cerr << "Line " << __LINE__ << ": plane " << n << ( found == NULL ? " evicted" : " kept" )
+                << ( n == 1 ? ", expected evicted" : ", expected kept with its image" ) << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Without memory the cache finds nothing, even for stored planes.
+  cache->SetMaximumMemoryInMB( 0 );
+  if ( cache->IsEnabled()
+       || cache->Find( "vtkMRMLScalarVolumeNode1", 1, rasToIJK.GetPointer(), xyToRAS.GetPointer(),
+                       ImageSize, ImageSize, 1 ) != NULL )
+  {
+    std::cerr << "Line " << __LINE__ << ": cache enabled without memory" << std::endl;
+    return EXIT_FAILURE;
+  }
+  cache->InvalidateVolume( "vtkMRMLScalarVolumeNode1" );
+  if ( cache->GetNumberOfEntries() != 0 || cache->GetMemoryUsageInBytes() != 0 )
+  {
+    std::cerr << "Line " << __LINE__ << ": entries left after invalidating the volume" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+
+//----------------------------------------------------------------------------
+int vtkResliceImageCacheTest1( int, char*[] )
+{
+  if ( TestHit() != EXIT_SUCCESS
+       || TestMiss() != EXIT_SUCCESS
+       || TestEviction() != EXIT_SUCCESS )
+  {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
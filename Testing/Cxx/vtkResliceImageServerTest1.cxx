@@ -0,0 +1,289 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// VolumeResliceDriver includes
+#include "vtkResliceImageServer.h"
+
+// VTK includes
+#include <vtkClientSocket.h>
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+# include <winsock2.h>
+#else
+# include <sys/socket.h>
+#endif
+
+namespace
+{
+
+const int ServerPort = 18945;
+
+/// A Blocker frame the client does not read keeps the sender in Send().
+const int BlockerSize = 4096;
+
+struct Message
+{
+  unsigned int Version;
+  std::string Type;
+  std::string DeviceName;
+  vtkTypeUInt64 BodySize;
+  vtkTypeUInt64 Crc;
+  std::vector< unsigned char > Body;
+};
+
+vtkTypeUInt64 GetUInt( const unsigned char* p, int size )
+{
+  vtkTypeUInt64 v = 0;
+  for ( int i = 0; i < size; ++ i )
+  {
+    v = ( v << 8 ) | p[ i ];
+  }
+  return v;
+}
+
+float GetFloat32( const unsigned char* p )
+{
+  vtkTypeUInt32 v = static_cast< vtkTypeUInt32 >( GetUInt( p, 4 ) );
+  float f;
+  memcpy( &f, &v, sizeof( f ) );
+  return f;
+}
+
+/// CRC-64 ECMA-182, bit by bit, independently of the table of the server.
+vtkTypeUInt64 ComputeCrc64( const unsigned char* data, size_t length )
+{
+  vtkTypeUInt64 crc = 0;
+  for ( size_t i = 0; i < length; ++ i )
+  {
+    crc ^= static_cast< vtkTypeUInt64 >( data[ i ] ) << 56;
+    for ( int b = 0; b < 8; ++ b )
+    {
+      crc = ( crc & 0x8000000000000000ULL ) ? ( crc << 1 ) ^ 0x42F0E1EBA9EA3693ULL : ( crc << 1 );
+    }
+  }
+  return crc;
+}
+
+/// Read the rest of an OpenIGTLink message whose 58-byte header is given.
+bool ReadMessageBody( vtkClientSocket* socket, const unsigned char* header, Message& message )
+{
+  message.Version = static_cast< unsigned int >( GetUInt( header, 2 ) );
+  message.Type = std::string( reinterpret_cast< const char* >( header + 2 ), 12 ).c_str();
+  message.DeviceName = std::string( reinterpret_cast< const char* >( header + 14 ), 20 ).c_str();
+  message.BodySize = GetUInt( header + 42, 8 );
+  message.Crc = GetUInt( header + 50, 8 );
+  message.Body.resize( static_cast< size_t >( message.BodySize ) );
+  return message.BodySize == 0
+         || socket->Receive( &message.Body[ 0 ], static_cast< int >( message.BodySize ) ) == static_cast< int >( message.BodySize );
+}
+
+bool ReadMessage( vtkClientSocket* socket, Message& message )
+{
+  unsigned char header[58];
+  return socket->Receive( header, sizeof( header ) ) == sizeof( header )
+         && ReadMessageBody( socket, header, message );
+}
+
+vtkSmartPointer< vtkImageData > CreateFrame( int width, int height, unsigned char value )
+{
+  vtkSmartPointer< vtkImageData > frame = vtkSmartPointer< vtkImageData >::New();
+  frame->SetDimensions( width, height, 1 );
+  frame->SetScalarTypeToUnsignedChar();
+  frame->SetNumberOfScalarComponents( 1 );
+  frame->AllocateScalars();
+  unsigned char* pixel = static_cast< unsigned char* >( frame->GetScalarPointer() );
+  for ( int n = 0; n < width * height; ++ n )
+  {
+    pixel[ n ] = static_cast< unsigned char >( value + n );
+  }
+  return frame;
+}
+
+/// Check that a message is a well-formed IMAGE message from the device,
+/// holding the frame.
+bool CheckImageMessage( const Message& message, const char* deviceName, vtkImageData* frame, int line )
+{
+  int dims[3];
+  frame->GetDimensions( dims );
+  size_t dataSize = static_cast< size_t >( dims[0] ) * dims[1];
+  if (    message.Version != 1 || message.Type != "IMAGE" || message.DeviceName != deviceName
+       || message.BodySize != 72 + dataSize )
+  {
+    std::cerr << "Line " << line << ": unexpected header: version " << message.Version << ", type "
+              << message.Type << ", device " << message.DeviceName << ", body " << message.BodySize
+              << " bytes, expected " << deviceName << " with " << 72 + dataSize << std::endl;
+    return false;
+  }
+  if ( message.Crc != ComputeCrc64( &message.Body[ 0 ], message.Body.size() ) )
+  {
+    std::cerr << "Line " << line << ": CRC of " << deviceName << " does not match its body" << std::endl;
+    return false;
+  }
+  const unsigned char* body = &message.Body[ 0 ];
+  if (    GetUInt( body, 2 ) != 1 || body[2] != 1 || body[3] != 3 || body[5] != 1
+       || GetUInt( body + 6, 2 ) != static_cast< unsigned int >( dims[0] )
+       || GetUInt( body + 8, 2 ) != static_cast< unsigned int >( dims[1] )
+       || GetUInt( body + 10, 2 ) != 1 )
+  {
+    std::cerr << "Line " << line << ": unexpected image header in " << deviceName << std::endl;
+    return false;
+  }
+  if ( memcmp( body + 72, frame->GetScalarPointer(), dataSize ) != 0 )
+  {
+    std::cerr << "Line " << line << ": pixels of " << deviceName << " differ from the pushed frame" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+
+//----------------------------------------------------------------------------
+/// Frames pushed to the server arrive as well-formed OpenIGTLink IMAGE
+/// messages, and a client that stops reading costs the driver the oldest
+/// queued frames, never a wait.
+int vtkResliceImageServerTest1( int, char*[] )
+{
+  vtkNew< vtkResliceImageServer > server;
+  server->SetPoolSize( 2 );
+  if ( ! server->Start( ServerPort ) )
+  {
+    std::cerr << "Line " << __LINE__ << ": cannot start the server on port " << ServerPort << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  vtkNew< vtkClientSocket > client;
+  if ( client->ConnectToServer( "127.0.0.1", ServerPort ) != 0 )
+  {
+    std::cerr << "Line " << __LINE__ << ": cannot connect to the server" << std::endl;
+    return EXIT_FAILURE;
+  }
+  // A small receive buffer, so the Blocker frame cannot fit in the socket.
+  int receiveBufferSize = 65536;
+  setsockopt( client->GetSocketDescriptor(), SOL_SOCKET, SO_RCVBUF,
+              reinterpret_cast< const char* >( &receiveBufferSize ), sizeof( receiveBufferSize ) );
+
+  // Probe until the sender has accepted the client and sent a frame.
+  vtkNew< vtkMatrix4x4 > ijkToRAS;
+  ijkToRAS->SetElement( 0, 0, 0.5 );
+  ijkToRAS->SetElement( 1, 1, 0.5 );
+  ijkToRAS->SetElement( 0, 3, 10.0 );
+  ijkToRAS->SetElement( 1, 3, 20.0 );
+  ijkToRAS->SetElement( 2, 3, 30.0 );
+  vtkSmartPointer< vtkImageData > probe = CreateFrame( 4, 3, 100 );
+  unsigned long numberOfProbes = 0;
+  while ( server->GetNumberOfSentFrames() == 0 && numberOfProbes < 500 )
+  {
+    server->PushImage( probe, ijkToRAS.GetPointer(), "Probe" );
+    ++ numberOfProbes;
+    vtksys::SystemTools::Delay( 10 );
+  }
+  while ( server->GetNumberOfSentFrames() + server->GetNumberOfDroppedFrames() < numberOfProbes )
+  {
+    vtksys::SystemTools::Delay( 10 );
+  }
+  unsigned long sentProbes = server->GetNumberOfSentFrames();
+  unsigned long droppedProbes = server->GetNumberOfDroppedFrames();
+  if ( sentProbes == 0 )
+  {
+    std::cerr << "Line " << __LINE__ << ": no frame sent to a connected client" << std::endl;
+    return EXIT_FAILURE;
+  }
+  for ( unsigned long n = 0; n < sentProbes; ++ n )
+  {
+    Message message;
+    if ( ! ReadMessage( client.GetPointer(), message )
+         || ! CheckImageMessage( message, "Probe", probe, __LINE__ ) )
+    {
+      return EXIT_FAILURE;
+    }
+    // The image is placed by its center, with axes scaled by spacing.
+    const unsigned char* body = &message.Body[ 0 ];
+    const float expected[4] = { 0.5f, 11.0f, 20.75f, 30.0f };
+    if (    GetFloat32( body + 12 ) != expected[0] || GetFloat32( body + 48 ) != expected[1]
+         || GetFloat32( body + 52 ) != expected[2] || GetFloat32( body + 56 ) != expected[3] )
+    {
+      std::cerr << "Line " << __LINE__ << ": unexpected geometry in the image header" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Keep the sender in Send() on the Blocker frame: it has started sending
+  // once its header arrives, and the client reads no further meanwhile.
+  vtkSmartPointer< vtkImageData > blocker = CreateFrame( BlockerSize, BlockerSize, 0 );
+  server->PushImage( blocker, ijkToRAS.GetPointer(), "Blocker" );
+  unsigned char blockerHeader[58];
+  if ( client->Receive( blockerHeader, sizeof( blockerHeader ) ) != sizeof( blockerHeader ) )
+  {
+    std::cerr << "Line " << __LINE__ << ": Blocker frame not sent" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // With the other buffer as the whole queue, each frame replaces the one
+  // before it, and only the last one is left to send.
+  const int numberOfFrames = 6;
+  std::vector< vtkSmartPointer< vtkImageData > > frames;
+  for ( int n = 0; n < numberOfFrames; ++ n )
+  {
+    std::ostringstream name;
+    name << "Frame" << n;
+    frames.push_back( CreateFrame( 8, 8, static_cast< unsigned char >( 10 * n ) ) );
+    server->PushImage( frames.back(), ijkToRAS.GetPointer(), name.str().c_str() );
+  }
+  if ( server->GetNumberOfDroppedFrames() - droppedProbes != numberOfFrames - 1 )
+  {
+    std::cerr << "Line " << __LINE__ << ": " << server->GetNumberOfDroppedFrames() - droppedProbes
+              << " frames dropped with the client stalled, expected " << numberOfFrames - 1 << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  Message message;
+  if ( ! ReadMessageBody( client.GetPointer(), blockerHeader, message )
+       || ! CheckImageMessage( message, "Blocker", blocker, __LINE__ ) )
+  {
+    return EXIT_FAILURE;
+  }
+  if ( ! ReadMessage( client.GetPointer(), message )
+       || ! CheckImageMessage( message, "Frame5", frames.back(), __LINE__ ) )
+  {
+    return EXIT_FAILURE;
+  }
+
+  server->Stop();
+  if ( server->GetNumberOfSentFrames() != sentProbes + 2 )
+  {
+    std::cerr << "Line " << __LINE__ << ": " << server->GetNumberOfSentFrames() << " frames sent, expected "
+              << sentProbes + 2 << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
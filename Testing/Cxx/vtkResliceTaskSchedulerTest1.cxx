@@ -0,0 +1,263 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// VolumeResliceDriver includes
+#include "vtkMultiVolumeReslicer.h"
+#include "vtkResliceTaskScheduler.h"
+#include "vtkSliceImageReslicer.h"
+#include "vtkVolumeResliceDriverTestingUtilities.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace vtkVolumeResliceDriverTestingUtilities;
+
+namespace
+{
+
+const int NumberOfThreads = 4;
+const int NumberOfTasks = 200;
+const int NumberOfSmallSlices = 3;
+
+/// Counts the runs of each item, with some work that grows with the item
+/// so that the first threads run out of tasks last.
+void CountItems( void* data, int first, int last )
+{
+  std::vector< int >& counts = *static_cast< std::vector< int >* >( data );
+  for ( int i = first; i < last; ++ i )
+  {
+    volatile double sum = 0.0;
+    for ( int k = 0; k < 50 * i; ++ k )
+    {
+      sum += k;
+    }
+    ++ counts[ i ];
+  }
+}
+
+
+//----------------------------------------------------------------------------
+int TestBatches()
+{
+  vtkNew< vtkResliceTaskScheduler > scheduler;
+  scheduler->SetNumberOfThreads( NumberOfThreads );
+  std::vector< int > counts( 10 * NumberOfTasks, 0 );
+  for ( int batch = 1; batch <= 3; ++ batch )
+  {
+    // Tasks of 10 items, in two groups.
+    for ( int t = 0; t < NumberOfTasks; ++ t )
+    {
+      int index = scheduler->AddTask( CountItems, &counts, 10 * t, 10 * t + 10, t % 2 );
+      if ( index != t )
+      {
+        std::cerr << "Line " << __LINE__ << ": task " << t << " queued at " << index << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+    scheduler->Run();
+
+    // Every task ran once, on one of the threads.
+    for ( size_t i = 0; i < counts.size(); ++ i )
+    {
+      if ( counts[ i ] != batch )
+      {
+        std::cerr << "Line " << __LINE__ << ": batch " << batch << ", item " << i << " run " << counts[ i ]
+                  << " times" << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+    int ranTasks = 0;
+    for ( int thread = 0; thread < NumberOfThreads; ++ thread )
+    {
+      ranTasks += scheduler->GetThreadTaskCount( thread );
+    }
+    if (    ranTasks != NumberOfTasks || scheduler->GetNumberOfRunTasks() != NumberOfTasks
+         || scheduler->GetNumberOfTasks() != 0 )
+    {
+      std::cerr << "Line " << __LINE__ << ": batch " << batch << ", " << scheduler->GetNumberOfRunTasks()
+                << " tasks run, " << ranTasks << " by the threads, " << scheduler->GetNumberOfTasks()
+                << " left queued" << std::endl;
+      return EXIT_FAILURE;
+    }
+    for ( int t = 0; t < NumberOfTasks; ++ t )
+    {
+      if ( scheduler->GetTaskThread( t ) < 0 || scheduler->GetTaskThread( t ) >= NumberOfThreads )
+      {
+        std::cerr << "Line " << __LINE__ << ": batch " << batch << ", task " << t << " run by thread "
+                  << scheduler->GetTaskThread( t ) << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+    if ( scheduler->GetGroupTime( 1 ) <= 0.0 || scheduler->GetGroupTime( 2 ) != 0.0 )
+    {
+      std::cerr << "Line " << __LINE__ << ": batch " << batch << ", group times " << scheduler->GetGroupTime( 1 )
+                << " and " << scheduler->GetGroupTime( 2 ) << " for a group without tasks" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  if ( scheduler->GetNumberOfRuns() != 3 )
+  {
+    std::cerr << "Line " << __LINE__ << ": " << scheduler->GetNumberOfRuns() << " batches counted for 3"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+
+//----------------------------------------------------------------------------
+int TestSlices()
+{
+  // A large slice through a large volume, small slices through a small
+  // one and a slice through both as layers; mode 0 updates each slice on
+  // its own, mode 1 queues them all on the scheduler.
+  const int largeSize = 64;
+  const int smallSize = 32;
+  const int sliceSizes[2] = { 256, 48 };
+  vtkSmartPointer< vtkImageData > largeVolume = CreateTestVolume( largeSize );
+  vtkSmartPointer< vtkImageData > smallVolume = CreateTestVolume( smallSize );
+  vtkNew< vtkMatrix4x4 > largeRASToIJK;
+  CreateRASToIJK( largeRASToIJK.GetPointer(), largeSize );
+  vtkNew< vtkMatrix4x4 > smallRASToIJK;
+  CreateRASToIJK( smallRASToIJK.GetPointer(), smallSize );
+
+  std::vector< vtkSmartPointer< vtkSliceImageReslicer > > reslicers[2];
+  vtkSmartPointer< vtkMultiVolumeReslicer > layerReslicers[2];
+  for ( int mode = 0; mode < 2; ++ mode )
+  {
+    for ( int s = 0; s <= NumberOfSmallSlices; ++ s )
+    {
+      vtkSmartPointer< vtkSliceImageReslicer > reslicer = vtkSmartPointer< vtkSliceImageReslicer >::New();
+      reslicer->SetNumberOfThreads( 1 );
+      reslicer->SetInterpolationMode( vtkSliceImageReslicer::INTERPOLATION_LINEAR );
+      if ( s == 0 )
+      {
+        reslicer->SetInput( largeVolume, largeRASToIJK.GetPointer() );
+      }
+      else
+      {
+        reslicer->SetInput( smallVolume, smallRASToIJK.GetPointer() );
+      }
+      reslicers[ mode ].push_back( reslicer );
+    }
+    layerReslicers[ mode ] = vtkSmartPointer< vtkMultiVolumeReslicer >::New();
+    layerReslicers[ mode ]->SetNumberOfThreads( 1 );
+    layerReslicers[ mode ]->SetNumberOfLayers( 2 );
+    layerReslicers[ mode ]->SetLayer( 0, largeVolume, largeRASToIJK.GetPointer(),
+                                      vtkSliceImageReslicer::INTERPOLATION_LINEAR );
+    layerReslicers[ mode ]->SetLayer( 1, smallVolume, smallRASToIJK.GetPointer(),
+                                      vtkSliceImageReslicer::INTERPOLATION_NEAREST );
+  }
+  vtkNew< vtkResliceTaskScheduler > scheduler;
+  scheduler->SetNumberOfThreads( NumberOfThreads );
+  scheduler->SetTaskPixels( 1024 );
+
+  vtkNew< vtkMatrix4x4 > pose;
+  vtkNew< vtkMatrix4x4 > xyToRAS;
+  for ( int n = 0; n < 5; ++ n )
+  {
+    for ( int s = 0; s <= NumberOfSmallSlices + 1; ++ s )
+    {
+      int size = ( s == 0 ) ? sliceSizes[0] : ( s <= NumberOfSmallSlices ? sliceSizes[1] : 96 );
+      SetStreamPose( pose.GetPointer(), n + 10 * s );
+      SetPoseXYToRAS( xyToRAS.GetPointer(), pose.GetPointer(), size, 64.0 / size );
+      for ( int mode = 0; mode < 2; ++ mode )
+      {
+        if ( s <= NumberOfSmallSlices )
+        {
+          reslicers[ mode ][ s ]->SetSliceGeometry( xyToRAS.GetPointer(), size, size );
+        }
+        else
+        {
+          layerReslicers[ mode ]->SetSliceGeometry( xyToRAS.GetPointer(), size, size );
+        }
+      }
+    }
+
+    for ( int s = 0; s <= NumberOfSmallSlices; ++ s )
+    {
+      reslicers[0][ s ]->Update();
+      if ( reslicers[1][ s ]->BeginUpdate() > 0 )
+      {
+        reslicers[1][ s ]->AddTasks( scheduler.GetPointer(), s );
+      }
+    }
+    layerReslicers[0]->Update();
+    if ( layerReslicers[1]->BeginUpdate() > 0 )
+    {
+      layerReslicers[1]->AddTasks( scheduler.GetPointer(), NumberOfSmallSlices + 1 );
+    }
+    if ( scheduler->GetNumberOfTasks() <= NumberOfSmallSlices + 2 )
+    {
+      std::cerr << "Line " << __LINE__ << ": frame " << n << " split into " << scheduler->GetNumberOfTasks()
+                << " tasks" << std::endl;
+      return EXIT_FAILURE;
+    }
+    scheduler->Run();
+    for ( int s = 0; s <= NumberOfSmallSlices; ++ s )
+    {
+      reslicers[1][ s ]->EndUpdate();
+    }
+    layerReslicers[1]->EndUpdate();
+
+    // Scheduled slices are those updated on their own.
+    for ( int s = 0; s <= NumberOfSmallSlices + 2; ++ s )
+    {
+      vtkImageData* outputs[2];
+      for ( int mode = 0; mode < 2; ++ mode )
+      {
+        outputs[ mode ] = ( s <= NumberOfSmallSlices ) ? reslicers[ mode ][ s ]->GetOutput()
+                                                       : layerReslicers[ mode ]->GetOutput( s - NumberOfSmallSlices - 1 );
+      }
+      size_t bytes = static_cast< size_t >( outputs[0]->GetNumberOfPoints() ) * outputs[0]->GetScalarSize();
+      if (    outputs[1]->GetNumberOfPoints() != outputs[0]->GetNumberOfPoints()
+           || memcmp( outputs[0]->GetScalarPointer(), outputs[1]->GetScalarPointer(), bytes ) != 0 )
+      {
+        std::cerr << "Line " << __LINE__ << ": frame " << n << ", slice " << s
+                  << " differs from the slice updated on its own" << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+
+//----------------------------------------------------------------------------
+/// Batches of uneven tasks run each task once on the pool, and slices and
+/// layers of different sizes resampled in bands on the scheduler are those
+/// updated one by one.
+int vtkResliceTaskSchedulerTest1( int, char*[] )
+{
+  if ( TestBatches() != EXIT_SUCCESS || TestSlices() != EXIT_SUCCESS )
+  {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,208 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// VolumeResliceDriver includes
+#include "vtkQuantizedImage.h"
+#include "vtkSliceImageReslicer.h"
+#include "vtkSliceImageSampling.h"
+#include "vtkVolumeResliceDriverTestingUtilities.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace vtkVolumeResliceDriverTestingUtilities;
+
+namespace
+{
+
+const int NumberOfModes = 4;
+const int Modes[ NumberOfModes ] = { vtkSliceImageReslicer::INTERPOLATION_NEAREST,
+                                     vtkSliceImageReslicer::INTERPOLATION_LINEAR,
+                                     vtkSliceImageReslicer::INTERPOLATION_CUBIC,
+                                     vtkSliceImageReslicer::INTERPOLATION_LANCZOS };
+const int SliceSize = 64;
+const int VolumeSize = 64;
+
+
+//----------------------------------------------------------------------------
+int TestVoxelCenters()
+{
+  // Axial plane through voxel centers of a short volume: every kernel
+  // weighs the voxel under the pixel alone.
+  vtkSmartPointer< vtkImageData > volume = CreateTestVolume( VolumeSize );
+  vtkNew< vtkMatrix4x4 > rasToIJK;
+  CreateRASToIJK( rasToIJK.GetPointer(), VolumeSize );
+  vtkNew< vtkMatrix4x4 > xyToRAS;
+  xyToRAS->SetElement( 0, 3, -SliceSize / 2.0 );
+  xyToRAS->SetElement( 1, 3, -SliceSize / 2.0 );
+  xyToRAS->SetElement( 2, 3, 3.0 );
+  vtkSmartPointer< vtkSliceImageReslicer > reslicers[ NumberOfModes ];
+  for ( int m = 0; m < NumberOfModes; ++ m )
+  {
+    reslicers[ m ] = vtkSmartPointer< vtkSliceImageReslicer >::New();
+    reslicers[ m ]->IncrementalUpdateOff();
+    reslicers[ m ]->SetInterpolationMode( Modes[ m ] );
+    reslicers[ m ]->SetInput( volume, rasToIJK.GetPointer() );
+    reslicers[ m ]->SetSliceGeometry( xyToRAS.GetPointer(), SliceSize, SliceSize );
+    reslicers[ m ]->Update();
+    if ( m > 0 && memcmp( reslicers[ m ]->GetOutput()->GetScalarPointer(),
+                          reslicers[0]->GetOutput()->GetScalarPointer(),
+                          SliceSize * SliceSize * sizeof( short ) ) != 0 )
+    {
+      std::cerr << "Line " << __LINE__ << ": kernel " << Modes[ m ]
+                << " differs from nearest on voxel centers" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+
+//----------------------------------------------------------------------------
+int TestErrorBounds()
+{
+  // Oblique plane inside a float volume, away from its edges where the
+  // taps are clamped.
+  vtkNew< vtkMatrix4x4 > rasToIJK;
+  CreateRASToIJK( rasToIJK.GetPointer(), VolumeSize );
+  vtkNew< vtkMatrix4x4 > pose;
+  SetStreamPose( pose.GetPointer(), 40 );
+  vtkNew< vtkMatrix4x4 > xyToRAS;
+  for ( int k = 0; k < 3; ++ k )
+  {
+    for ( int c = 0; c < 2; ++ c )
+    {
+      xyToRAS->Element[ k ][ c ] = pose->Element[ k ][ c ] * 0.37;
+    }
+    xyToRAS->Element[ k ][ 3 ] = 0.3 - SliceSize / 2.0 * ( xyToRAS->Element[ k ][ 0 ] + xyToRAS->Element[ k ][ 1 ] );
+  }
+  vtkNew< vtkMatrix4x4 > xyToIJK;
+  vtkMatrix4x4::Multiply4x4( rasToIJK.GetPointer(), xyToRAS.GetPointer(), xyToIJK.GetPointer() );
+
+  const double constantValue = 37.25;
+  const double noRamp[3] = { 0.0, 0.0, 0.0 };
+  const double ramp[3] = { 1.5, -0.75, 0.5 };
+  vtkSmartPointer< vtkImageData > constantVolume = CreateRampVolume( VolumeSize, constantValue, noRamp );
+  vtkSmartPointer< vtkImageData > rampVolume = CreateRampVolume( VolumeSize, 5.0, ramp );
+  vtkNew< vtkQuantizedImage > quantizedRamp;
+  quantizedRamp->Build( rampVolume, 16, false );
+
+  // A row of the kernel tables sums to 1 in float; the ramp bound covers
+  // the position rounded to 1 / KernelPhases of a voxel, and the 16-bit
+  // bound the sum of the absolute kernel weights over the taps, at most
+  // about 2.
+  const double constantBound = 1.0e-4;
+  const double rampBound = 2.0 * ( fabs( ramp[0] ) + fabs( ramp[1] ) + fabs( ramp[2] ) )
+                           * 0.5 / vtkSliceImageSampling::KernelPhases + 1.0e-4;
+  const double quantizedBound = quantizedRamp->GetMaximumError() * 2.5 + 1.0e-3;
+  for ( int m = 0; m < NumberOfModes; ++ m )
+  {
+    vtkNew< vtkSliceImageReslicer > reslicer;
+    reslicer->IncrementalUpdateOff();
+    reslicer->SetInterpolationMode( Modes[ m ] );
+    reslicer->SetSliceGeometry( xyToRAS.GetPointer(), SliceSize, SliceSize );
+
+    // Every kernel reproduces a constant volume.
+    reslicer->SetInput( constantVolume, rasToIJK.GetPointer() );
+    reslicer->Update();
+    const float* out = static_cast< const float* >( reslicer->GetOutput()->GetScalarPointer() );
+    double constantError = 0.0;
+    for ( int i = 0; i < SliceSize * SliceSize; ++ i )
+    {
+      constantError = std::max( constantError, fabs( out[ i ] - constantValue ) );
+    }
+    if ( constantError > constantBound )
+    {
+      std::cerr << "Line " << __LINE__ << ": kernel " << Modes[ m ] << " " << constantError
+                << " off a constant volume" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    // Linear and cubic reproduce a linear ramp.
+    reslicer->SetInput( rampVolume, rasToIJK.GetPointer() );
+    reslicer->Update();
+    std::vector< float > rampSlice( SliceSize * SliceSize );
+    memcpy( &rampSlice[0], reslicer->GetOutput()->GetScalarPointer(), rampSlice.size() * sizeof( float ) );
+    double rampError = 0.0;
+    for ( int j = 0; j < SliceSize; ++ j )
+    {
+      for ( int i = 0; i < SliceSize; ++ i )
+      {
+        double expected = 5.0;
+        for ( int k = 0; k < 3; ++ k )
+        {
+          expected += ramp[ k ] * ( xyToIJK->Element[ k ][0] * i + xyToIJK->Element[ k ][1] * j
+                                    + xyToIJK->Element[ k ][3] );
+        }
+        rampError = std::max( rampError, fabs( rampSlice[ j * SliceSize + i ] - expected ) );
+      }
+    }
+    bool reproducesRamp = (    Modes[ m ] == vtkSliceImageReslicer::INTERPOLATION_LINEAR
+                            || Modes[ m ] == vtkSliceImageReslicer::INTERPOLATION_CUBIC );
+    if ( reproducesRamp && rampError > rampBound )
+    {
+      std::cerr << "Line " << __LINE__ << ": kernel " << Modes[ m ] << " " << rampError << " off a linear ramp, bound "
+                << rampBound << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    // Sampling a 16-bit copy stays within the error of the copy.
+    reslicer->SetQuantizedInput( quantizedRamp.GetPointer(), rasToIJK.GetPointer() );
+    reslicer->Update();
+    out = static_cast< const float* >( reslicer->GetOutput()->GetScalarPointer() );
+    double quantizedError = 0.0;
+    for ( int i = 0; i < SliceSize * SliceSize; ++ i )
+    {
+      quantizedError = std::max( quantizedError, fabs( static_cast< double >( out[ i ] ) - rampSlice[ i ] ) );
+    }
+    if ( quantizedError > quantizedBound )
+    {
+      std::cerr << "Line " << __LINE__ << ": kernel " << Modes[ m ] << " " << quantizedError
+                << " off the full-precision ramp through a 16-bit copy, bound " << quantizedBound << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+
+//----------------------------------------------------------------------------
+/// Nearest, linear, cubic and Lanczos interpolation: all return the voxels
+/// of a plane through voxel centers and reproduce a constant volume,
+/// linear and cubic reproduce a linear ramp, and all stay within the error
+/// of a 16-bit quantized copy when sampling it.
+int vtkSliceImageReslicerInterpolationTest1( int, char*[] )
+{
+  if ( TestVoxelCenters() != EXIT_SUCCESS || TestErrorBounds() != EXIT_SUCCESS )
+  {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,157 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// VolumeResliceDriver includes
+#include "vtkSlicerVolumeResliceDriverLogic.h"
+#include "vtkVolumeResliceDriverTestingUtilities.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLSliceNode.h>
+
+// VTK includes
+#include <vtkCallbackCommand.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+
+// STD includes
+#include <iostream>
+#include <vector>
+
+using namespace vtkVolumeResliceDriverTestingUtilities;
+
+namespace
+{
+
+/// Allocations while the logic handles driver events, split by whether
+/// the logic itself or MRML called from the logic made them.
+struct AllocationCounts
+{
+  unsigned long Logic;
+  unsigned long MRML;
+};
+
+/// Observers bracketing the logic's handling of a driver event: counting
+/// is switched on before the observers of default priority run, and off
+/// after them, so what MRML does before invoking the event is left out.
+void StartCountingCallback( vtkObject*, unsigned long, void*, void* )
+{
+  ResetNumberOfAllocations();
+  SetCountingAllocations( true );
+}
+
+void StopCountingCallback( vtkObject*, unsigned long, void* clientData, void* )
+{
+  SetCountingAllocations( false );
+  static_cast< AllocationCounts* >( clientData )->Logic += GetNumberOfAllocations();
+  ResetNumberOfAllocations();
+}
+
+/// Charges the allocations of each MRML call of the logic to MRML.
+void MRMLCallCallback( bool entering, void* clientData )
+{
+  if ( ! GetCountingAllocations() )
+  {
+    return;
+  }
+  AllocationCounts* counts = static_cast< AllocationCounts* >( clientData );
+  ( entering ? counts->Logic : counts->MRML ) += GetNumberOfAllocations();
+  ResetNumberOfAllocations();
+}
+
+} // namespace
+
+
+//----------------------------------------------------------------------------
+/// The logic does not allocate on the steady-state path from a driver pose
+/// event to the slice update. Allocations in the MRML calls it makes on
+/// the way, such as SetSliceToRASByNTP() and UpdateMatrices(), are
+/// reported but not charged to the logic.
+int vtkSlicerVolumeResliceDriverLogicAllocationTest1( int, char*[] )
+{
+  const int warmupPoses = 10;
+  const int poses = 1000;
+
+  vtkNew< vtkMRMLScene > scene;
+  vtkNew< vtkSlicerVolumeResliceDriverLogic > logic;
+  logic->SetMRMLScene( scene.GetPointer() );
+
+  vtkNew< vtkMRMLSliceNode > slice;
+  slice->SetLayoutName( "Red" );
+  scene->AddNode( slice.GetPointer() );
+  vtkNew< vtkMRMLLinearTransformNode > driver;
+  scene->AddNode( driver.GetPointer() );
+
+  logic->SetDriverForSlice( driver->GetID(), slice.GetPointer() );
+  logic->SetMethodForSlice( vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION, slice.GetPointer() );
+  logic->SetOrientationForSlice( vtkSlicerVolumeResliceDriverLogic::ORIENTATION_INPLANE, slice.GetPointer() );
+
+  AllocationCounts counts;
+  counts.Logic = 0;
+  counts.MRML = 0;
+  logic->SetMRMLCallCallback( MRMLCallCallback, &counts );
+
+  // The logic observes with the default priority, 0; it handles both
+  // events as pose updates.
+  vtkNew< vtkCallbackCommand > startCounting;
+  startCounting->SetCallback( StartCountingCallback );
+  vtkNew< vtkCallbackCommand > stopCounting;
+  stopCounting->SetCallback( StopCountingCallback );
+  stopCounting->SetClientData( &counts );
+  const unsigned long events[2] = { vtkMRMLTransformableNode::TransformModifiedEvent, vtkCommand::ModifiedEvent };
+  for ( int e = 0; e < 2; ++ e )
+  {
+    driver->AddObserver( events[ e ], startCounting.GetPointer(), 1.0 );
+    driver->AddObserver( events[ e ], stopCounting.GetPointer(), -1.0 );
+  }
+
+  vtkNew< vtkMatrix4x4 > pose;
+  std::vector< vtkSlicerVolumeResliceDriverLogic::SlicePerformance > snapshot;
+  unsigned long updates = 0;
+  for ( int n = 0; n < warmupPoses + poses; ++ n )
+  {
+    if ( n == warmupPoses )
+    {
+      logic->GetPerformanceSnapshot( snapshot );
+      updates = snapshot.empty() ? 0 : snapshot[0].NumberOfUpdates;
+      counts.Logic = 0;
+      counts.MRML = 0;
+    }
+    SetStreamPose( pose.GetPointer(), n );
+    driver->GetMatrixTransformToParent()->DeepCopy( pose.GetPointer() );
+  }
+  logic->SetMRMLCallCallback( NULL, NULL );
+  logic->GetPerformanceSnapshot( snapshot );
+  updates = ( snapshot.empty() ? 0 : snapshot[0].NumberOfUpdates ) - updates;
+
+  std::cout << poses << " poses, " << updates << " slice updates, " << counts.Logic << " allocations in the logic, "
+            << counts.MRML << " in MRML calls of the logic" << std::endl;
+  if ( updates < static_cast< unsigned long >( poses ) )
+  {
+    std::cerr << "Line " << __LINE__ << ": " << updates << " slice updates for " << poses << " poses" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if ( counts.Logic > 0 )
+  {
+    std::cerr << "Line " << __LINE__ << ": the logic allocated " << counts.Logic << " times in " << poses
+              << " poses" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
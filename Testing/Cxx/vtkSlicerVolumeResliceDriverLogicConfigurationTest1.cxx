@@ -0,0 +1,253 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// VolumeResliceDriver includes
+#include "vtkSlicerVolumeResliceDriverLogic.h"
+#include "vtkVolumeResliceDriverTestingUtilities.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLSliceNode.h>
+
+// VTK includes
+#include <vtkCallbackCommand.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace vtkVolumeResliceDriverTestingUtilities;
+
+namespace
+{
+
+const int NumberOfDrivers = 3;
+const int NumberOfSlices = 9;
+
+void CountCallback( vtkObject*, unsigned long, void* clientData, void* )
+{
+  ++ *static_cast< unsigned long* >( clientData );
+}
+
+/// A 3x3 slice layout and three transform drivers, none driving yet.
+struct SliceLayout
+{
+  vtkSmartPointer< vtkMRMLScene > Scene;
+  vtkSmartPointer< vtkSlicerVolumeResliceDriverLogic > Logic;
+  std::vector< vtkSmartPointer< vtkMRMLLinearTransformNode > > Drivers;
+  std::vector< vtkSmartPointer< vtkMRMLSliceNode > > Slices;
+
+  SliceLayout()
+  {
+    this->Scene = vtkSmartPointer< vtkMRMLScene >::New();
+    this->Logic = vtkSmartPointer< vtkSlicerVolumeResliceDriverLogic >::New();
+    this->Logic->SetMRMLScene( this->Scene );
+    vtkNew< vtkMatrix4x4 > pose;
+    for ( int d = 0; d < NumberOfDrivers; ++ d )
+    {
+      vtkSmartPointer< vtkMRMLLinearTransformNode > driver = vtkSmartPointer< vtkMRMLLinearTransformNode >::New();
+      this->Scene->AddNode( driver );
+      this->GetDriverPose( d, pose.GetPointer() );
+      driver->GetMatrixTransformToParent()->DeepCopy( pose.GetPointer() );
+      this->Drivers.push_back( driver );
+    }
+    for ( int s = 0; s < NumberOfSlices; ++ s )
+    {
+      vtkSmartPointer< vtkMRMLSliceNode > slice = vtkSmartPointer< vtkMRMLSliceNode >::New();
+      std::ostringstream layoutName;
+      layoutName << "Slice" << s;
+      slice->SetLayoutName( layoutName.str().c_str() );
+      this->Scene->AddNode( slice );
+      this->Slices.push_back( slice );
+    }
+  }
+
+  void GetDriverPose( int driver, vtkMatrix4x4* pose )
+  {
+    SetStreamPose( pose, 10 * driver );
+  }
+
+  /// Slice s driven by driver s / 3, in orientation s % 3.
+  void GetConfigurations( std::vector< vtkSlicerVolumeResliceDriverLogic::SliceConfiguration >& configurations )
+  {
+    configurations.resize( NumberOfSlices );
+    for ( int s = 0; s < NumberOfSlices; ++ s )
+    {
+      configurations[ s ].SliceNode = this->Slices[ s ];
+      configurations[ s ].DriverID = this->Drivers[ s / 3 ]->GetID();
+      configurations[ s ].Method = vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION;
+      configurations[ s ].Orientation = vtkSlicerVolumeResliceDriverLogic::ORIENTATION_INPLANE + s % 3;
+    }
+  }
+
+  /// Updates of each driven slice, by slice node ID.
+  void GetNumberOfUpdates( std::map< std::string, unsigned long >& updates )
+  {
+    std::vector< vtkSlicerVolumeResliceDriverLogic::SlicePerformance > snapshot;
+    this->Logic->GetPerformanceSnapshot( snapshot );
+    updates.clear();
+    for ( unsigned int i = 0; i < snapshot.size(); ++ i )
+    {
+      updates[ snapshot[ i ].SliceID ] += snapshot[ i ].NumberOfUpdates;
+    }
+  }
+};
+
+
+//----------------------------------------------------------------------------
+int TestBatchConfiguration()
+{
+  SliceLayout layout;
+  unsigned long notifications = 0;
+  vtkNew< vtkCallbackCommand > counter;
+  counter->SetCallback( CountCallback );
+  counter->SetClientData( &notifications );
+  layout.Logic->AddObserver( vtkCommand::ModifiedEvent, counter.GetPointer() );
+
+  // One batch: each slice is updated once, onto its driver, and the logic
+  // notifies once.
+  std::vector< vtkSlicerVolumeResliceDriverLogic::SliceConfiguration > configurations;
+  layout.GetConfigurations( configurations );
+  if ( ! layout.Logic->SetSliceConfigurations( configurations ) || notifications != 1 )
+  {
+    std::cerr << "Line " << __LINE__ << ": batch not applied, or " << notifications
+              << " notifications, expected 1" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::map< std::string, unsigned long > updates;
+  layout.GetNumberOfUpdates( updates );
+  vtkNew< vtkMatrix4x4 > pose;
+  for ( int s = 0; s < NumberOfSlices; ++ s )
+  {
+    layout.GetDriverPose( s / 3, pose.GetPointer() );
+    if (    updates[ layout.Slices[ s ]->GetID() ] != 1
+         || GetSlicePositionError( layout.Slices[ s ], pose.GetPointer() ) > 1.0e-4 )
+    {
+      std::cerr << "Line " << __LINE__ << ": slice " << s << " updated " << updates[ layout.Slices[ s ]->GetID() ]
+                << " times, expected once onto its driver" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // A slice listed twice is still updated once.
+  configurations.resize( 2 );
+  configurations[1] = configurations[0];
+  notifications = 0;
+  layout.Logic->SetSliceConfigurations( configurations );
+  std::map< std::string, unsigned long > updatesAfter;
+  layout.GetNumberOfUpdates( updatesAfter );
+  if ( updatesAfter[ layout.Slices[0]->GetID() ] - updates[ layout.Slices[0]->GetID() ] != 1 || notifications != 1 )
+  {
+    std::cerr << "Line " << __LINE__ << ": a slice listed twice was not updated once" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // An invalid entry leaves every slice as it was: here slice 0 keeps its
+  // driver although the batch removes it before the invalid entry.
+  configurations[0].DriverID = "";
+  configurations[1].SliceNode = layout.Slices[1];
+  configurations[1].DriverID = "vtkMRMLLinearTransformNodeMissing";
+  notifications = 0;
+  if (    layout.Logic->SetSliceConfigurations( configurations ) || notifications != 0
+       || layout.Slices[0]->GetAttribute( VOLUMERESLICEDRIVER_DRIVER_ATTRIBUTE ) == NULL )
+  {
+    std::cerr << "Line " << __LINE__ << ": a batch with an invalid entry changed the configuration" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  layout.Logic->RemoveObserver( counter.GetPointer() );
+  return EXIT_SUCCESS;
+}
+
+
+//----------------------------------------------------------------------------
+int TestSingleChange()
+{
+  SliceLayout layout;
+  std::vector< vtkSlicerVolumeResliceDriverLogic::SliceConfiguration > configurations;
+  layout.GetConfigurations( configurations );
+  layout.Logic->SetSliceConfigurations( configurations );
+
+  unsigned long driverEvents = 0;
+  vtkNew< vtkCallbackCommand > driverCounter;
+  driverCounter->SetCallback( CountCallback );
+  driverCounter->SetClientData( &driverEvents );
+  layout.Drivers[0]->AddObserver( vtkMRMLTransformableNode::TransformModifiedEvent, driverCounter.GetPointer() );
+
+  // Changing the method, then the orientation of slice 0 updates that
+  // slice alone, each time, and does not signal its driver.
+  std::map< std::string, unsigned long > updates;
+  layout.GetNumberOfUpdates( updates );
+  for ( int change = 0; change < 2; ++ change )
+  {
+    if ( change == 0 )
+    {
+      layout.Logic->SetMethodForSlice( vtkSlicerVolumeResliceDriverLogic::METHOD_POSITION, layout.Slices[0] );
+    }
+    else
+    {
+      layout.Logic->SetOrientationForSlice( vtkSlicerVolumeResliceDriverLogic::ORIENTATION_TRANSVERSE,
+                                            layout.Slices[0] );
+    }
+    std::map< std::string, unsigned long > updatesAfter;
+    layout.GetNumberOfUpdates( updatesAfter );
+    for ( int s = 0; s < NumberOfSlices; ++ s )
+    {
+      const char* sliceID = layout.Slices[ s ]->GetID();
+      unsigned long expected = ( s == 0 ) ? 1 : 0;
+      if ( updatesAfter[ sliceID ] - updates[ sliceID ] != expected )
+      {
+        std::cerr << "Line " << __LINE__ << ": change " << change << " updated slice " << s << " "
+                  << updatesAfter[ sliceID ] - updates[ sliceID ] << " times, expected " << expected << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+    updates = updatesAfter;
+  }
+  layout.Drivers[0]->RemoveObserver( driverCounter.GetPointer() );
+  if ( driverEvents != 0 )
+  {
+    std::cerr << "Line " << __LINE__ << ": reconfiguring a slice signaled its driver " << driverEvents << " times"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+
+//----------------------------------------------------------------------------
+/// Slices configured in one batch are each updated once, with a single
+/// notification; a batch with an invalid entry changes nothing; and
+/// reconfiguring one slice updates that slice alone.
+int vtkSlicerVolumeResliceDriverLogicConfigurationTest1( int, char*[] )
+{
+  if ( TestBatchConfiguration() != EXIT_SUCCESS || TestSingleChange() != EXIT_SUCCESS )
+  {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
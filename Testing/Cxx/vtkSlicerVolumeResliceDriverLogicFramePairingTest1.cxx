@@ -0,0 +1,292 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// VolumeResliceDriver includes
+#include "vtkImageFrameCompounder.h"
+#include "vtkSlicerVolumeResliceDriverLogic.h"
+#include "vtkVolumeResliceDriverTestingUtilities.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+#include <vtkMRMLScalarVolumeNode.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLSliceNode.h>
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using namespace vtkVolumeResliceDriverTestingUtilities;
+
+namespace
+{
+
+const double TrackerRate = 200.0;
+const int TrackerSamplesPerFrame = 7;
+const double FrameLatency = 0.06;
+const double StartTime = 1000.0;
+
+/// An image driving a slice, tracked by its parent transform.
+struct TrackedImage
+{
+  vtkSmartPointer< vtkMRMLScene > Scene;
+  vtkSmartPointer< vtkSlicerVolumeResliceDriverLogic > Logic;
+  vtkSmartPointer< vtkImageData > Frame;
+  vtkSmartPointer< vtkMRMLLinearTransformNode > Tracker;
+  vtkSmartPointer< vtkMRMLScalarVolumeNode > Image;
+  vtkSmartPointer< vtkMRMLSliceNode > Slice;
+
+  /// Float frames of width x height pixels of 1 mm.
+  TrackedImage( int width, int height )
+  {
+    this->Scene = vtkSmartPointer< vtkMRMLScene >::New();
+    this->Logic = vtkSmartPointer< vtkSlicerVolumeResliceDriverLogic >::New();
+    this->Logic->SetMRMLScene( this->Scene );
+
+    this->Frame = vtkSmartPointer< vtkImageData >::New();
+    this->Frame->SetDimensions( width, height, 1 );
+    this->Frame->SetScalarTypeToFloat();
+    this->Frame->AllocateScalars();
+    float* pixel = static_cast< float* >( this->Frame->GetScalarPointer() );
+    for ( int n = 0; n < width * height; ++ n )
+    {
+      pixel[ n ] = 1.0f + n;
+    }
+
+    this->Tracker = vtkSmartPointer< vtkMRMLLinearTransformNode >::New();
+    this->Scene->AddNode( this->Tracker );
+    this->Image = vtkSmartPointer< vtkMRMLScalarVolumeNode >::New();
+    this->Image->SetAndObserveImageData( this->Frame );
+    this->Scene->AddNode( this->Image );
+    this->Image->SetAndObserveTransformNodeID( this->Tracker->GetID() );
+    this->Slice = vtkSmartPointer< vtkMRMLSliceNode >::New();
+    this->Slice->SetLayoutName( "Red" );
+    this->Scene->AddNode( this->Slice );
+    this->Logic->SetDriverForSlice( this->Image->GetID(), this->Slice );
+    this->Logic->SetMethodForSlice( vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION, this->Slice );
+    this->Logic->SetOrientationForSlice( vtkSlicerVolumeResliceDriverLogic::ORIENTATION_INPLANE, this->Slice );
+  }
+
+  void SetTrackerPose( double time, vtkMatrix4x4* pose )
+  {
+    SetTimestamp( this->Tracker, time );
+    this->Tracker->GetMatrixTransformToParent()->DeepCopy( pose );
+    // Signal a repeated pose too: it is a new tracker sample.
+    this->Tracker->GetMatrixTransformToParent()->Modified();
+  }
+
+  void AddFrame( double time )
+  {
+    SetTimestamp( this->Image, time );
+    this->Frame->Modified();
+  }
+};
+
+/// Image to reference transform of a tracker moving at constant linear
+/// and angular speed.
+typedef void ( *TrackerMotionType )( double time, vtkMatrix4x4* pose );
+
+/// 50 mm/s along R.
+void TranslateTracker( double time, vtkMatrix4x4* pose )
+{
+  pose->Identity();
+  pose->SetElement( 0, 3, 50.0 * ( time - StartTime ) );
+}
+
+/// 0.5 mm pixels, flipped vertically, as in an ultrasound probe
+/// calibration, turning at 0.5 rad/s about R while moving at 20 mm/s.
+void TurnScaledReflectedTracker( double time, vtkMatrix4x4* pose )
+{
+  double angle = 0.5 * ( time - StartTime );
+  double c = cos( angle );
+  double s = sin( angle );
+  const double scale[3] = { 0.5, -0.5, 0.5 };
+  const double rotation[3][3] = { { 1.0, 0.0, 0.0 }, { 0.0, c, -s }, { 0.0, s, c } };
+  pose->Identity();
+  for ( int row = 0; row < 3; ++ row )
+  {
+    for ( int column = 0; column < 3; ++ column )
+    {
+      pose->SetElement( row, column, rotation[ row ][ column ] * scale[ column ] );
+    }
+  }
+  pose->SetElement( 0, 3, 20.0 * ( time - StartTime ) );
+  pose->SetElement( 1, 3, 5.0 );
+}
+
+/// Stream tracker poses and frames arriving FrameLatency after them; each
+/// frame must drive the slice to the tracker pose of its acquisition time.
+int CheckFramePairing( TrackedImage& tracked, TrackerMotionType motion, int numberOfFrames, int line )
+{
+  int dimensions[3];
+  tracked.Frame->GetDimensions( dimensions );
+  // OpenIGTLink places frames by their center.
+  vtkNew< vtkMatrix4x4 > frameToTracker;
+  frameToTracker->SetElement( 0, 3, 0.5 * dimensions[0] );
+  frameToTracker->SetElement( 1, 3, 0.5 * dimensions[1] );
+
+  vtkNew< vtkMatrix4x4 > trackerPose;
+  vtkNew< vtkMatrix4x4 > expected;
+  for ( int n = 0; n < numberOfFrames * TrackerSamplesPerFrame; ++ n )
+  {
+    double time = StartTime + n / TrackerRate;
+    motion( time, trackerPose.GetPointer() );
+    tracked.SetTrackerPose( time, trackerPose.GetPointer() );
+    if ( n % TrackerSamplesPerFrame != TrackerSamplesPerFrame - 1 )
+    {
+      continue;
+    }
+
+    double frameTime = time - FrameLatency;
+    tracked.AddFrame( frameTime );
+    if ( frameTime <= StartTime )
+    {
+      continue;
+    }
+    motion( frameTime, trackerPose.GetPointer() );
+    vtkMatrix4x4::Multiply4x4( trackerPose.GetPointer(), frameToTracker.GetPointer(), expected.GetPointer() );
+    vtkMatrix4x4* sliceToRAS = tracked.Slice->GetSliceToRAS();
+    double normal[3];
+    double positionError = 0.0;
+    for ( int k = 0; k < 3; ++ k )
+    {
+      normal[ k ] = expected->GetElement( k, 2 );
+      positionError += fabs( sliceToRAS->GetElement( k, 3 ) - expected->GetElement( k, 3 ) );
+    }
+    vtkMath::Normalize( normal );
+    double cosAngle = 0.0;
+    for ( int k = 0; k < 3; ++ k )
+    {
+      cosAngle += sliceToRAS->GetElement( k, 2 ) * normal[ k ];
+    }
+    if ( positionError > 1.0e-3 || cosAngle < 1.0 - 1.0e-6 )
+    {
+      std::cerr << "Line " << line << ": frame " << n / TrackerSamplesPerFrame << " placed " << positionError
+                << " mm off the tracker pose of its acquisition time, normal at cosine " << cosAngle << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // The first frame was acquired before the first tracker pose.
+  std::vector< vtkSlicerVolumeResliceDriverLogic::SlicePerformance > snapshot;
+  tracked.Logic->GetPerformanceSnapshot( snapshot );
+  if (    snapshot.size() != 1
+       || snapshot[0].NumberOfInterpolatedFrames != static_cast< unsigned long >( numberOfFrames - 1 )
+       || snapshot[0].NumberOfExtrapolatedFrames != 1 )
+  {
+    std::cerr << "Line " << line << ": frames interpolated and extrapolated not counted" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+
+//----------------------------------------------------------------------------
+int TestTranslatingTracker()
+{
+  // A single 1 mm pixel.
+  TrackedImage tracked( 1, 1 );
+  return CheckFramePairing( tracked, TranslateTracker, 200, __LINE__ );
+}
+
+
+//----------------------------------------------------------------------------
+int TestScaledReflectedTracker()
+{
+  // The pixel spacing and the vertical flip of the image are in the
+  // tracker transform, and must survive the pairing.
+  TrackedImage tracked( 20, 10 );
+  return CheckFramePairing( tracked, TurnScaledReflectedTracker, 100, __LINE__ );
+}
+
+
+//----------------------------------------------------------------------------
+int TestCompounding()
+{
+  const int width = 20;
+  const int height = 10;
+  TrackedImage tracked( width, height );
+  vtkImageFrameCompounder* compounder = tracked.Logic->GetFrameCompounder();
+  compounder->SetOutputExtent( 0, 63, 0, 63, 0, 31 );
+  compounder->SetOutputSpacing( 0.5, 0.5, 0.5 );
+  compounder->SetOutputOrigin( 0.0, 0.0, 0.0 );
+  compounder->SetInsertionMode( vtkImageFrameCompounder::INSERTION_NEAREST );
+  compounder->Reset();
+  tracked.Logic->SetCompoundingEnabled( true );
+
+  // 0.5 mm pixels, flipped vertically: pixel (i, j) is at RAS
+  // (10 + i / 2, 20 - j / 2, 5), voxel (20 + i, 40 - j, 10).
+  vtkNew< vtkMatrix4x4 > trackerPose;
+  trackerPose->SetElement( 0, 0, 0.5 );
+  trackerPose->SetElement( 1, 1, -0.5 );
+  trackerPose->SetElement( 2, 2, 0.5 );
+  trackerPose->SetElement( 0, 3, 10.0 );
+  trackerPose->SetElement( 1, 3, 20.0 );
+  trackerPose->SetElement( 2, 3, 5.0 );
+  tracked.SetTrackerPose( 1.0, trackerPose.GetPointer() );
+  tracked.SetTrackerPose( 2.0, trackerPose.GetPointer() );
+  tracked.AddFrame( 1.5 );
+
+  if ( compounder->GetNumberOfInsertedFrames() != 1 )
+  {
+    std::cerr << "Line " << __LINE__ << ": " << compounder->GetNumberOfInsertedFrames()
+              << " frames compounded, expected 1" << std::endl;
+    return EXIT_FAILURE;
+  }
+  vtkImageData* output = compounder->GetOutput();
+  for ( int j = 0; j < height; ++ j )
+  {
+    for ( int i = 0; i < width; ++ i )
+    {
+      float value = *static_cast< float* >( output->GetScalarPointer( 20 + i, 40 - j, 10 ) );
+      if ( value != 1.0f + i + width * j )
+      {
+        std::cerr << "Line " << __LINE__ << ": pixel " << i << " " << j << " compounded as " << value
+                  << ", expected " << 1.0f + i + width * j << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+
+//----------------------------------------------------------------------------
+/// Image frames arriving later than the tracker poses taken at the same
+/// time: the slices and the compounded volume take each frame at the
+/// tracker pose of its acquisition time, scale and reflection included.
+int vtkSlicerVolumeResliceDriverLogicFramePairingTest1( int, char*[] )
+{
+  if ( TestTranslatingTracker() != EXIT_SUCCESS
+       || TestScaledReflectedTracker() != EXIT_SUCCESS
+       || TestCompounding() != EXIT_SUCCESS )
+  {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
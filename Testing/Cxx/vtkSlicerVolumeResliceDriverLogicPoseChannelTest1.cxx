@@ -0,0 +1,188 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// VolumeResliceDriver includes
+#include "vtkSharedMemoryPoseChannel.h"
+#include "vtkSlicerVolumeResliceDriverLogic.h"
+#include "vtkVolumeResliceDriverTestingUtilities.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLSliceNode.h>
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace vtkVolumeResliceDriverTestingUtilities;
+
+namespace
+{
+
+const int NumberOfDrivers = 4;
+const char* ChannelName = "vtkSlicerVolumeResliceDriverLogicPoseChannelTest1";
+
+/// Allocations in MRML calls of the logic are left out of the count,
+/// including those of nested calls made from MRML observers.
+struct MRMLCallState
+{
+  int Depth;
+  bool Counting;
+};
+
+void ExcludeMRMLCallback( bool entering, void* clientData )
+{
+  MRMLCallState* state = static_cast< MRMLCallState* >( clientData );
+  if ( entering && state->Depth++ == 0 )
+  {
+    state->Counting = GetCountingAllocations();
+    SetCountingAllocations( false );
+  }
+  else if ( ! entering && --state->Depth == 0 )
+  {
+    SetCountingAllocations( state->Counting );
+  }
+}
+
+void WritePose( vtkSharedMemoryPoseChannel* writer, int index, const char* driverID, vtkMatrix4x4* pose, bool valid )
+{
+  double matrix[16];
+  vtkMatrix4x4::DeepCopy( matrix, pose );
+  writer->WritePose( index, driverID, 1.0 + index, matrix, valid );
+}
+
+} // namespace
+
+
+//----------------------------------------------------------------------------
+/// Poses written to a shared-memory channel and polled by the logic, in
+/// one process: each written pose moves its slice once, polling again
+/// applies nothing, invalid entries and unknown drivers are skipped, and
+/// the logic does not allocate while polling.
+int vtkSlicerVolumeResliceDriverLogicPoseChannelTest1( int, char*[] )
+{
+  const int rounds = 50;
+
+  vtkNew< vtkMRMLScene > scene;
+  vtkNew< vtkSlicerVolumeResliceDriverLogic > logic;
+  logic->SetMRMLScene( scene.GetPointer() );
+
+  std::vector< vtkSmartPointer< vtkMRMLLinearTransformNode > > drivers;
+  std::vector< vtkSmartPointer< vtkMRMLSliceNode > > slices;
+  for ( int d = 0; d < NumberOfDrivers; ++ d )
+  {
+    vtkSmartPointer< vtkMRMLSliceNode > slice = vtkSmartPointer< vtkMRMLSliceNode >::New();
+    std::stringstream layoutName;
+    layoutName << "Slice" << d;
+    slice->SetLayoutName( layoutName.str().c_str() );
+    scene->AddNode( slice );
+    vtkSmartPointer< vtkMRMLLinearTransformNode > driver = vtkSmartPointer< vtkMRMLLinearTransformNode >::New();
+    scene->AddNode( driver );
+    logic->SetDriverForSlice( driver->GetID(), slice );
+    logic->SetMethodForSlice( vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION, slice );
+    drivers.push_back( driver );
+    slices.push_back( slice );
+  }
+
+  vtkNew< vtkSharedMemoryPoseChannel > writer;
+  if ( ! writer->Create( ChannelName, NumberOfDrivers + 1 ) || ! logic->AttachPoseChannel( ChannelName ) )
+  {
+    std::cerr << "Line " << __LINE__ << ": cannot create or attach the pose channel" << std::endl;
+    return EXIT_FAILURE;
+  }
+  MRMLCallState mrmlCallState;
+  mrmlCallState.Depth = 0;
+  mrmlCallState.Counting = false;
+  logic->SetMRMLCallCallback( ExcludeMRMLCallback, &mrmlCallState );
+
+  vtkNew< vtkMatrix4x4 > pose;
+  ResetNumberOfAllocations();
+  for ( int n = 0; n < rounds; ++ n )
+  {
+    // Every round moves half of the drivers, alternating.
+    int written = 0;
+    for ( int d = n % 2; d < NumberOfDrivers; d += 2 )
+    {
+      SetStreamPose( pose.GetPointer(), n + 100 * d );
+      WritePose( writer.GetPointer(), d, drivers[ d ]->GetID(), pose.GetPointer(), true );
+      ++ written;
+    }
+    // The first poll sizes the buffers of the logic.
+    SetCountingAllocations( n > 0 );
+    int applied = logic->PollPoseChannel();
+    int repeated = logic->PollPoseChannel();
+    SetCountingAllocations( false );
+    if ( applied != written || repeated != 0 )
+    {
+      std::cerr << "Line " << __LINE__ << ": round " << n << ": " << applied << " poses applied of " << written
+                << ", " << repeated << " applied again" << std::endl;
+      return EXIT_FAILURE;
+    }
+    for ( int d = n % 2; d < NumberOfDrivers; d += 2 )
+    {
+      SetStreamPose( pose.GetPointer(), n + 100 * d );
+      if ( GetSlicePositionError( slices[ d ], pose.GetPointer() ) > 1.0e-4 )
+      {
+        std::cerr << "Line " << __LINE__ << ": round " << n << ": slice " << d
+                  << " is off the polled pose" << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  logic->SetMRMLCallCallback( NULL, NULL );
+  if ( GetNumberOfAllocations() != 0 )
+  {
+    std::cerr << "Line " << __LINE__ << ": the logic allocated " << GetNumberOfAllocations()
+              << " times while polling" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // The poses go to the slices; the driver nodes are not moved.
+  vtkNew< vtkMatrix4x4 > identity;
+  if ( GetMaximumDifference( drivers[0]->GetMatrixTransformToParent(), identity.GetPointer() ) != 0.0 )
+  {
+    std::cerr << "Line " << __LINE__ << ": a polled pose moved the driver node" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Neither an invalid entry nor a pose of a node that drives nothing
+  // moves a slice.
+  vtkNew< vtkMatrix4x4 > sliceToRAS;
+  sliceToRAS->DeepCopy( slices[0]->GetSliceToRAS() );
+  SetStreamPose( pose.GetPointer(), 1000 );
+  WritePose( writer.GetPointer(), 0, drivers[0]->GetID(), pose.GetPointer(), false );
+  WritePose( writer.GetPointer(), NumberOfDrivers, "vtkMRMLLinearTransformNodeUnknown", pose.GetPointer(), true );
+  int applied = logic->PollPoseChannel();
+  if ( applied != 0 || GetMaximumDifference( sliceToRAS.GetPointer(), slices[0]->GetSliceToRAS() ) != 0.0 )
+  {
+    std::cerr << "Line " << __LINE__ << ": " << applied << " poses applied from an invalid entry and an unknown driver"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  logic->DetachPoseChannel();
+  writer->Detach();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,193 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// VolumeResliceDriver includes
+#include "vtkSlicerVolumeResliceDriverLogic.h"
+#include "vtkVolumeResliceDriverTestingUtilities.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+#include <vtkMRMLScalarVolumeNode.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLSliceNode.h>
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <iostream>
+#include <vector>
+
+using namespace vtkVolumeResliceDriverTestingUtilities;
+
+namespace
+{
+
+const double StartTime = 1000.0;
+const double Interval = 0.01;
+
+/// Each applied pose, at its time, is returned by GetDriverPoseAtTime()
+/// and exported by ExportDriverPoseHistory().
+int CheckRoundTrip( vtkSlicerVolumeResliceDriverLogic* logic, const char* driverID, const std::vector< double >& times,
+                    const std::vector< vtkSmartPointer< vtkMatrix4x4 > >& applied, int line )
+{
+  vtkNew< vtkMatrix4x4 > pose;
+  for ( unsigned int i = 0; i < times.size(); ++ i )
+  {
+    if (    ! logic->GetDriverPoseAtTime( driverID, times[ i ], pose.GetPointer() )
+         || GetMaximumDifference( pose.GetPointer(), applied[ i ] ) > 1.0e-9 )
+    {
+      std::cerr << "Line " << line << ": pose at " << times[ i ] << " s is not the pose applied" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  vtkNew< vtkDoubleArray > exportedTimes;
+  vtkNew< vtkDoubleArray > exportedPoses;
+  int exported = logic->ExportDriverPoseHistory( driverID, 0.0, 1.0e12, exportedTimes.GetPointer(),
+                                                 exportedPoses.GetPointer() );
+  if ( exported != static_cast< int >( times.size() ) )
+  {
+    std::cerr << "Line " << line << ": " << exported << " poses exported, " << times.size() << " applied" << std::endl;
+    return EXIT_FAILURE;
+  }
+  for ( int i = 0; i < exported; ++ i )
+  {
+    double matrix[16];
+    exportedPoses->GetTupleValue( i, matrix );
+    pose->DeepCopy( matrix );
+    if ( exportedTimes->GetValue( i ) != times[ i ] || GetMaximumDifference( pose.GetPointer(), applied[ i ] ) > 1.0e-9 )
+    {
+      std::cerr << "Line " << line << ": exported pose " << i << " is not the pose applied at " << times[ i ] << " s"
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+
+//----------------------------------------------------------------------------
+int TestTransformDriver()
+{
+  const int numberOfPoses = 30;
+  vtkNew< vtkMRMLScene > scene;
+  vtkNew< vtkSlicerVolumeResliceDriverLogic > logic;
+  logic->SetMRMLScene( scene.GetPointer() );
+  vtkNew< vtkMRMLLinearTransformNode > driver;
+  scene->AddNode( driver.GetPointer() );
+  vtkNew< vtkMRMLSliceNode > slice;
+  slice->SetLayoutName( "Red" );
+  scene->AddNode( slice.GetPointer() );
+  logic->SetDriverForSlice( driver->GetID(), slice.GetPointer() );
+  logic->SetMethodForSlice( vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION, slice.GetPointer() );
+
+  // Timestamps are set before the poses they belong to, as OpenIGTLink
+  // does. The pose at the middle time is sent twice, corrected the second
+  // time: the history keeps the one applied last.
+  std::vector< double > times;
+  std::vector< vtkSmartPointer< vtkMatrix4x4 > > applied;
+  for ( int n = 0; n < numberOfPoses; ++ n )
+  {
+    double time = StartTime + n * Interval;
+    SetTimestamp( driver.GetPointer(), time );
+    vtkSmartPointer< vtkMatrix4x4 > pose = vtkSmartPointer< vtkMatrix4x4 >::New();
+    SetStreamPose( pose, n );
+    driver->GetMatrixTransformToParent()->DeepCopy( pose );
+    if ( n == numberOfPoses / 2 )
+    {
+      SetStreamPose( pose, 100 + n );
+      driver->GetMatrixTransformToParent()->DeepCopy( pose );
+    }
+    if ( GetSlicePositionError( slice.GetPointer(), pose ) > 1.0e-4 )
+    {
+      std::cerr << "Line " << __LINE__ << ": pose " << n << " not applied" << std::endl;
+      return EXIT_FAILURE;
+    }
+    times.push_back( time );
+    applied.push_back( pose );
+  }
+  return CheckRoundTrip( logic.GetPointer(), driver->GetID(), times, applied, __LINE__ );
+}
+
+
+//----------------------------------------------------------------------------
+int TestImageDriver()
+{
+  const int numberOfPoses = 5;
+  vtkNew< vtkMRMLScene > scene;
+  vtkNew< vtkSlicerVolumeResliceDriverLogic > logic;
+  logic->SetMRMLScene( scene.GetPointer() );
+  vtkNew< vtkImageData > frame;
+  frame->SetDimensions( 20, 10, 1 );
+  frame->SetScalarTypeToUnsignedChar();
+  frame->AllocateScalars();
+  vtkNew< vtkMRMLScalarVolumeNode > image;
+  image->SetAndObserveImageData( frame.GetPointer() );
+  image->SetSpacing( 0.5, 0.5, 1.0 );
+  scene->AddNode( image.GetPointer() );
+  vtkNew< vtkMRMLSliceNode > slice;
+  slice->SetLayoutName( "Red" );
+  scene->AddNode( slice.GetPointer() );
+  logic->SetDriverForSlice( image->GetID(), slice.GetPointer() );
+  logic->SetMethodForSlice( vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION, slice.GetPointer() );
+
+  // Moving the image only modifies the node; the pose applied is that of
+  // the frame, centered as OpenIGTLink places it.
+  int dimensions[3];
+  frame->GetDimensions( dimensions );
+  std::vector< double > times;
+  std::vector< vtkSmartPointer< vtkMatrix4x4 > > applied;
+  vtkNew< vtkMatrix4x4 > ijkToRAS;
+  for ( int n = 0; n < numberOfPoses; ++ n )
+  {
+    double time = StartTime + n * Interval;
+    SetTimestamp( image.GetPointer(), time );
+    image->SetOrigin( 5.0 * n, 2.0 * n, -n );
+    image->GetIJKToRASMatrix( ijkToRAS.GetPointer() );
+    vtkSmartPointer< vtkMatrix4x4 > pose = vtkSmartPointer< vtkMatrix4x4 >::New();
+    vtkSlicerVolumeResliceDriverLogic::GetImageFramePose( ijkToRAS.GetPointer(), dimensions, pose );
+    if ( GetSlicePositionError( slice.GetPointer(), pose ) > 1.0e-4 )
+    {
+      std::cerr << "Line " << __LINE__ << ": pose " << n << " not applied" << std::endl;
+      return EXIT_FAILURE;
+    }
+    times.push_back( time );
+    applied.push_back( pose );
+  }
+  return CheckRoundTrip( logic.GetPointer(), image->GetID(), times, applied, __LINE__ );
+}
+
+} // namespace
+
+
+//----------------------------------------------------------------------------
+/// Poses applied by transform and image drivers are the poses the logic
+/// returns at their timestamps and exports.
+int vtkSlicerVolumeResliceDriverLogicPoseHistoryTest1( int, char*[] )
+{
+  if ( TestTransformDriver() != EXIT_SUCCESS || TestImageDriver() != EXIT_SUCCESS )
+  {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
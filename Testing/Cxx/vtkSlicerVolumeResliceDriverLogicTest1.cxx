@@ -0,0 +1,107 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// VolumeResliceDriver includes
+#include "vtkSlicerVolumeResliceDriverLogic.h"
+#include "vtkVolumeResliceDriverTestingUtilities.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLSliceNode.h>
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+
+// STD includes
+#include <iostream>
+#include <vector>
+
+using namespace vtkVolumeResliceDriverTestingUtilities;
+
+namespace
+{
+
+unsigned long GetNumberOfUpdates( vtkSlicerVolumeResliceDriverLogic* logic )
+{
+  std::vector< vtkSlicerVolumeResliceDriverLogic::SlicePerformance > snapshot;
+  logic->GetPerformanceSnapshot( snapshot );
+  return snapshot.empty() ? 0 : snapshot[0].NumberOfUpdates;
+}
+
+} // namespace
+
+
+//----------------------------------------------------------------------------
+/// A transform driving a slice: the slice follows each pose, by position
+/// and by orientation, and stops following once the driver is removed.
+int vtkSlicerVolumeResliceDriverLogicTest1( int, char*[] )
+{
+  vtkNew< vtkMRMLScene > scene;
+  vtkNew< vtkSlicerVolumeResliceDriverLogic > logic;
+  logic->SetMRMLScene( scene.GetPointer() );
+
+  vtkNew< vtkMRMLSliceNode > slice;
+  slice->SetLayoutName( "Red" );
+  scene->AddNode( slice.GetPointer() );
+  vtkNew< vtkMRMLLinearTransformNode > driver;
+  scene->AddNode( driver.GetPointer() );
+
+  logic->SetDriverForSlice( driver->GetID(), slice.GetPointer() );
+  const int methods[2] = { vtkSlicerVolumeResliceDriverLogic::METHOD_POSITION,
+                           vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION };
+  const int numberOfPoses = 20;
+  vtkNew< vtkMatrix4x4 > pose;
+  for ( int m = 0; m < 2; ++ m )
+  {
+    logic->SetMethodForSlice( methods[ m ], slice.GetPointer() );
+    unsigned long updates = GetNumberOfUpdates( logic.GetPointer() );
+    for ( int n = 0; n < numberOfPoses; ++ n )
+    {
+      SetStreamPose( pose.GetPointer(), 10 * n + 1 );
+      driver->GetMatrixTransformToParent()->DeepCopy( pose.GetPointer() );
+      if ( GetSlicePositionError( slice.GetPointer(), pose.GetPointer() ) > 1.0e-4 )
+      {
+        std::cerr << "Line " << __LINE__ << ": method " << methods[ m ] << ", pose " << n
+                  << ": the driver position is off the slice plane." << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+    updates = GetNumberOfUpdates( logic.GetPointer() ) - updates;
+    if ( updates != static_cast< unsigned long >( numberOfPoses ) )
+    {
+      std::cerr << "Line " << __LINE__ << ": method " << methods[ m ] << ": " << updates
+                << " slice updates for " << numberOfPoses << " poses." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  logic->SetDriverForSlice( "", slice.GetPointer() );
+  vtkNew< vtkMatrix4x4 > sliceToRAS;
+  sliceToRAS->DeepCopy( slice->GetSliceToRAS() );
+  SetStreamPose( pose.GetPointer(), 1000 );
+  driver->GetMatrixTransformToParent()->DeepCopy( pose.GetPointer() );
+  if ( GetMaximumDifference( sliceToRAS.GetPointer(), slice->GetSliceToRAS() ) != 0.0 )
+  {
+    std::cerr << "Line " << __LINE__ << ": the slice still follows a removed driver." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,158 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// VolumeResliceDriver includes
+#include "vtkSlicerVolumeResliceDriverLogic.h"
+#include "vtkVolumeResliceDriverTestingUtilities.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+#include <vtkMRMLScalarVolumeNode.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLSliceCompositeNode.h>
+#include <vtkMRMLSliceNode.h>
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace vtkVolumeResliceDriverTestingUtilities;
+
+namespace
+{
+
+const int VolumeSize = 32;
+const int NumberOfSlices = 8;
+const int NumberOfEvents = 10;
+
+/// Slice planes and resliced images of all slices after the last event.
+struct SliceResults
+{
+  std::vector< double > Planes;
+  std::vector< std::vector< char > > Images;
+};
+
+/// One driver moving all slices through the test volume, with
+/// numberOfThreads threads or, if taskScheduling, on the task scheduler.
+int DriveSlices( vtkImageData* volume, int numberOfThreads, bool taskScheduling, SliceResults& results )
+{
+  vtkNew< vtkMRMLScene > scene;
+  vtkNew< vtkSlicerVolumeResliceDriverLogic > logic;
+  logic->SetMRMLScene( scene.GetPointer() );
+  logic->SetNumberOfThreads( numberOfThreads );
+  logic->SetTaskSchedulingEnabled( taskScheduling );
+  logic->SetResliceOutputEnabled( true );
+
+  vtkNew< vtkMRMLScalarVolumeNode > volumeNode;
+  volumeNode->SetAndObserveImageData( volume );
+  volumeNode->SetOrigin( -VolumeSize / 2.0, -VolumeSize / 2.0, -VolumeSize / 2.0 );
+  scene->AddNode( volumeNode.GetPointer() );
+  vtkNew< vtkMRMLLinearTransformNode > driver;
+  scene->AddNode( driver.GetPointer() );
+
+  std::vector< vtkSmartPointer< vtkMRMLSliceNode > > slices;
+  std::vector< vtkSlicerVolumeResliceDriverLogic::SliceConfiguration > configurations( NumberOfSlices );
+  for ( int s = 0; s < NumberOfSlices; ++ s )
+  {
+    std::ostringstream layoutName;
+    layoutName << "Slice" << s;
+    vtkSmartPointer< vtkMRMLSliceCompositeNode > composite = vtkSmartPointer< vtkMRMLSliceCompositeNode >::New();
+    composite->SetLayoutName( layoutName.str().c_str() );
+    composite->SetBackgroundVolumeID( volumeNode->GetID() );
+    scene->AddNode( composite );
+    vtkSmartPointer< vtkMRMLSliceNode > slice = vtkSmartPointer< vtkMRMLSliceNode >::New();
+    slice->SetLayoutName( layoutName.str().c_str() );
+    slice->SetDimensions( VolumeSize, VolumeSize, 1 );
+    scene->AddNode( slice );
+    slices.push_back( slice );
+    configurations[ s ].SliceNode = slice;
+    configurations[ s ].DriverID = driver->GetID();
+    configurations[ s ].Method = ( s % 4 == 3 ) ? vtkSlicerVolumeResliceDriverLogic::METHOD_POSITION
+                                                : vtkSlicerVolumeResliceDriverLogic::METHOD_ORIENTATION;
+    configurations[ s ].Orientation = vtkSlicerVolumeResliceDriverLogic::ORIENTATION_INPLANE + s % 3;
+  }
+  logic->SetSliceConfigurations( configurations );
+
+  vtkNew< vtkMatrix4x4 > pose;
+  for ( int n = 0; n < NumberOfEvents; ++ n )
+  {
+    SetStreamPose( pose.GetPointer(), n );
+    driver->GetMatrixTransformToParent()->DeepCopy( pose.GetPointer() );
+  }
+
+  results.Planes.clear();
+  results.Images.clear();
+  for ( int s = 0; s < NumberOfSlices; ++ s )
+  {
+    vtkMatrix4x4* sliceToRAS = slices[ s ]->GetSliceToRAS();
+    results.Planes.insert( results.Planes.end(), &sliceToRAS->Element[0][0], &sliceToRAS->Element[0][0] + 16 );
+    vtkImageData* image = logic->GetResliceOutput( slices[ s ] );
+    if ( image == NULL )
+    {
+      std::cerr << "Line " << __LINE__ << ": no resliced image of slice " << s << " on " << numberOfThreads
+                << " threads" << std::endl;
+      return EXIT_FAILURE;
+    }
+    const char* scalars = static_cast< const char* >( image->GetScalarPointer() );
+    results.Images.push_back( std::vector< char >( scalars, scalars + image->GetNumberOfPoints() * image->GetScalarSize() ) );
+  }
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+
+//----------------------------------------------------------------------------
+/// Slices of one driver updated on several threads, or on the task
+/// scheduler, end at the same planes with the same resliced images as on
+/// one thread.
+int vtkSlicerVolumeResliceDriverLogicThreadsTest1( int, char*[] )
+{
+  vtkSmartPointer< vtkImageData > volume = CreateTestVolume( VolumeSize );
+  SliceResults serial;
+  if ( DriveSlices( volume, 1, false, serial ) != EXIT_SUCCESS )
+  {
+    return EXIT_FAILURE;
+  }
+
+  const int threadCounts[] = { 2, 3, 4, 2 };
+  const bool taskScheduling[] = { false, false, false, true };
+  for ( int run = 0; run < 4; ++ run )
+  {
+    SliceResults parallel;
+    if ( DriveSlices( volume, threadCounts[ run ], taskScheduling[ run ], parallel ) != EXIT_SUCCESS )
+    {
+      return EXIT_FAILURE;
+    }
+    if ( parallel.Planes != serial.Planes || parallel.Images != serial.Images )
+    {
+      std::cerr << "Line " << __LINE__ << ": slices on " << threadCounts[ run ] << " threads"
+                << ( taskScheduling[ run ] ? " with task scheduling" : "" )
+                << " differ from the slices on one thread" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,196 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// VolumeResliceDriver includes
+#include "vtkSliceImageReslicer.h"
+#include "vtkTimeSeriesSliceReslicer.h"
+#include "vtkVolumeResliceDriverTestingUtilities.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace vtkVolumeResliceDriverTestingUtilities;
+
+namespace
+{
+
+const int VolumeSize = 48;
+const int SliceSize = 80;
+const int NumberOfTimePoints = 10;
+const int PrefetchCapacity = 4;
+
+/// Oblique plane of pose n inside the volume, through the edges of its
+/// voxel grid.
+void SetPlane( vtkMatrix4x4* xyToRAS, int n )
+{
+  vtkNew< vtkMatrix4x4 > pose;
+  SetStreamPose( pose.GetPointer(), n );
+  xyToRAS->Identity();
+  for ( int k = 0; k < 3; ++ k )
+  {
+    for ( int c = 0; c < 2; ++ c )
+    {
+      xyToRAS->Element[ k ][ c ] = pose->Element[ k ][ c ] * 0.8;
+    }
+    xyToRAS->Element[ k ][ 3 ] = 0.3 - SliceSize / 2.0 * ( xyToRAS->Element[ k ][ 0 ] + xyToRAS->Element[ k ][ 1 ] );
+  }
+}
+
+/// The series output is the time point shown resliced by
+/// vtkSliceImageReslicer.
+int CheckFrame( vtkTimeSeriesSliceReslicer* series, vtkSliceImageReslicer* reslicer, vtkImageData* image,
+                vtkMatrix4x4* rasToIJK, vtkMatrix4x4* xyToRAS, int frame, int line )
+{
+  reslicer->SetInput( image, rasToIJK );
+  reslicer->SetSliceGeometry( xyToRAS, SliceSize, SliceSize );
+  reslicer->Update();
+  if ( memcmp( series->GetOutput()->GetScalarPointer(), reslicer->GetOutput()->GetScalarPointer(),
+               SliceSize * SliceSize * sizeof( short ) ) != 0 )
+  {
+    std::cerr << "Line " << line << ": frame " << frame << ", time point " << series->GetTimePoint()
+              << ", interpolation " << series->GetInterpolationMode() << " differs from vtkSliceImageReslicer"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+
+//----------------------------------------------------------------------------
+int TestOutputs()
+{
+  std::vector< vtkSmartPointer< vtkImageData > > timePoints;
+  std::vector< vtkImageData* > images;
+  std::vector< double > times;
+  CreateTimeSeries( VolumeSize, NumberOfTimePoints, timePoints, images, times );
+  vtkNew< vtkMatrix4x4 > rasToIJK;
+  CreateRASToIJK( rasToIJK.GetPointer(), VolumeSize );
+  vtkNew< vtkMatrix4x4 > xyToRAS;
+
+  // The plane moves every few frames and playback goes back and forth.
+  const int modes[4] = { vtkSliceImageReslicer::INTERPOLATION_NEAREST,
+                         vtkSliceImageReslicer::INTERPOLATION_LINEAR,
+                         vtkSliceImageReslicer::INTERPOLATION_CUBIC,
+                         vtkSliceImageReslicer::INTERPOLATION_LANCZOS };
+  const int numberOfFrames = 40;
+  for ( int m = 0; m < 4; ++ m )
+  {
+    vtkNew< vtkTimeSeriesSliceReslicer > series;
+    series->SetInterpolationMode( modes[ m ] );
+    series->SetNumberOfThreads( 1 + m % 3 );
+    series->SetPrefetchCapacity( PrefetchCapacity );
+    series->SetTimePoints( images, times );
+    series->SetRASToIJK( rasToIJK.GetPointer() );
+    vtkNew< vtkSliceImageReslicer > reslicer;
+    reslicer->IncrementalUpdateOff();
+    reslicer->SetInterpolationMode( modes[ m ] );
+    for ( int n = 0; n < numberOfFrames; ++ n )
+    {
+      SetPlane( xyToRAS.GetPointer(), 40 * ( n / 8 ) );
+      int timePoint = ( n < numberOfFrames / 2 ) ? n : numberOfFrames - n;
+      series->SetSliceGeometry( xyToRAS.GetPointer(), SliceSize, SliceSize );
+      series->SetTimePoint( timePoint % NumberOfTimePoints );
+      series->Update();
+      if ( CheckFrame( series.GetPointer(), reslicer.GetPointer(), images[ series->GetTimePoint() ],
+                       rasToIJK.GetPointer(), xyToRAS.GetPointer(), n, __LINE__ ) != EXIT_SUCCESS )
+      {
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+
+//----------------------------------------------------------------------------
+int TestPrefetch()
+{
+  std::vector< vtkSmartPointer< vtkImageData > > timePoints;
+  std::vector< vtkImageData* > images;
+  std::vector< double > times;
+  CreateTimeSeries( VolumeSize, NumberOfTimePoints, timePoints, images, times );
+  vtkNew< vtkMatrix4x4 > rasToIJK;
+  CreateRASToIJK( rasToIJK.GetPointer(), VolumeSize );
+  vtkNew< vtkMatrix4x4 > xyToRAS;
+  SetPlane( xyToRAS.GetPointer(), 40 );
+
+  // Playback along a still plane, the worker given time between frames:
+  // the plane is planned once and the frames after the first are copied
+  // from the prefetched time points, unless prefetching is off.
+  const int numberOfFrames = 2 * NumberOfTimePoints;
+  for ( int capacity = 0; capacity <= PrefetchCapacity; capacity += PrefetchCapacity )
+  {
+    vtkNew< vtkTimeSeriesSliceReslicer > series;
+    series->SetInterpolationMode( vtkSliceImageReslicer::INTERPOLATION_LINEAR );
+    series->SetPrefetchCapacity( capacity );
+    series->SetTimePoints( images, times );
+    series->SetRASToIJK( rasToIJK.GetPointer() );
+    series->SetSliceGeometry( xyToRAS.GetPointer(), SliceSize, SliceSize );
+    vtkNew< vtkSliceImageReslicer > reslicer;
+    reslicer->IncrementalUpdateOff();
+    reslicer->SetInterpolationMode( vtkSliceImageReslicer::INTERPOLATION_LINEAR );
+    for ( int n = 0; n < numberOfFrames; ++ n )
+    {
+      series->SetTime( times[ n % NumberOfTimePoints ] );
+      series->Update();
+      if ( CheckFrame( series.GetPointer(), reslicer.GetPointer(), images[ series->GetTimePoint() ],
+                       rasToIJK.GetPointer(), xyToRAS.GetPointer(), n, __LINE__ ) != EXIT_SUCCESS )
+      {
+        return EXIT_FAILURE;
+      }
+      series->Wait();
+    }
+
+    unsigned long expectedHits = ( capacity > 0 ) ? numberOfFrames - 1 : 0;
+    if (    series->GetNumberOfPlans() != 1 || series->GetNumberOfPrefetchHits() != expectedHits
+         || series->GetNumberOfPrefetchHits() + series->GetNumberOfResampledTimePoints() != numberOfFrames )
+    {
+      std::cerr << "Line " << __LINE__ << ": prefetch capacity " << capacity << ", " << series->GetNumberOfPlans()
+                << " plans, " << series->GetNumberOfPrefetchHits() << " of " << numberOfFrames
+                << " frames served from the prefetched ones, " << series->GetNumberOfResampledTimePoints()
+                << " resampled" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+
+//----------------------------------------------------------------------------
+/// A 4D series resliced with each interpolation mode, the plane moving and
+/// playback going back and forth, gives the output of vtkSliceImageReslicer
+/// for the time point shown; along a still plane, playback is served from
+/// the prefetched time points.
+int vtkTimeSeriesSliceReslicerTest1( int, char*[] )
+{
+  if ( TestOutputs() != EXIT_SUCCESS || TestPrefetch() != EXIT_SUCCESS )
+  {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,280 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+#include "vtkVolumeResliceDriverTestingUtilities.h"
+
+// VolumeResliceDriver includes
+#include "vtkSlicerVolumeResliceDriverLogic.h"
+
+// MRML includes
+#include <vtkMRMLNode.h>
+#include <vtkMRMLSliceNode.h>
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+
+
+
+namespace
+{
+
+/// Counted by the global operator new below while set.
+bool CountAllocations = false;
+unsigned long NumberOfAllocations = 0;
+
+} // namespace
+
+
+
+void* operator new( size_t size ) throw( std::bad_alloc )
+{
+  if ( CountAllocations )
+  {
+    ++ NumberOfAllocations;
+  }
+  void* p = malloc( size > 0 ? size : 1 );
+  if ( p == NULL )
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+
+void* operator new[]( size_t size ) throw( std::bad_alloc )
+{
+  return operator new( size );
+}
+
+
+void operator delete( void* p ) throw()
+{
+  free( p );
+}
+
+
+void operator delete[]( void* p ) throw()
+{
+  free( p );
+}
+
+
+
+namespace vtkVolumeResliceDriverTestingUtilities
+{
+
+//----------------------------------------------------------------------------
+vtkSmartPointer< vtkImageData > CreateTestVolume( int size )
+{
+  vtkSmartPointer< vtkImageData > volume = vtkSmartPointer< vtkImageData >::New();
+  volume->SetExtent( 0, size - 1, 0, size - 1, 0, size - 1 );
+  volume->SetWholeExtent( 0, size - 1, 0, size - 1, 0, size - 1 );
+  volume->SetScalarTypeToShort();
+  volume->SetNumberOfScalarComponents( 1 );
+  volume->AllocateScalars();
+
+  short* p = static_cast< short* >( volume->GetScalarPointer() );
+  for ( int z = 0; z < size; ++ z )
+  {
+    for ( int y = 0; y < size; ++ y )
+    {
+      for ( int x = 0; x < size; ++ x )
+      {
+        *p ++ = static_cast< short >( ( ( x / 8 + y / 8 + z / 8 ) % 2 ) * 1000 + x + y - z );
+      }
+    }
+  }
+  return volume;
+}
+
+
+//----------------------------------------------------------------------------
+vtkSmartPointer< vtkImageData > CreateRampVolume( int size, double value, const double ramp[3] )
+{
+  vtkSmartPointer< vtkImageData > volume = vtkSmartPointer< vtkImageData >::New();
+  volume->SetExtent( 0, size - 1, 0, size - 1, 0, size - 1 );
+  volume->SetWholeExtent( 0, size - 1, 0, size - 1, 0, size - 1 );
+  volume->SetScalarTypeToFloat();
+  volume->SetNumberOfScalarComponents( 1 );
+  volume->AllocateScalars();
+
+  float* p = static_cast< float* >( volume->GetScalarPointer() );
+  for ( int z = 0; z < size; ++ z )
+  {
+    for ( int y = 0; y < size; ++ y )
+    {
+      for ( int x = 0; x < size; ++ x )
+      {
+        *p ++ = static_cast< float >( value + ramp[0] * x + ramp[1] * y + ramp[2] * z );
+      }
+    }
+  }
+  return volume;
+}
+
+
+//----------------------------------------------------------------------------
+void CreateTimeSeries( int size, int numberOfTimePoints, std::vector< vtkSmartPointer< vtkImageData > >& timePoints,
+                       std::vector< vtkImageData* >& images, std::vector< double >& times )
+{
+  timePoints.clear();
+  images.clear();
+  times.clear();
+  for ( int t = 0; t < numberOfTimePoints; ++ t )
+  {
+    vtkSmartPointer< vtkImageData > volume = CreateTestVolume( size );
+    short* p = static_cast< short* >( volume->GetScalarPointer() );
+    for ( int z = 0; z < size; ++ z )
+    {
+      for ( int y = 0; y < size; ++ y )
+      {
+        for ( int x = 0; x < size; ++ x )
+        {
+          *p ++ = static_cast< short >( ( ( ( x + t ) / 8 + y / 8 + z / 8 ) % 2 ) * 1000 + x + y - z + t );
+        }
+      }
+    }
+    timePoints.push_back( volume );
+    images.push_back( volume );
+    times.push_back( 0.05 * t );
+  }
+}
+
+
+//----------------------------------------------------------------------------
+void CreateRASToIJK( vtkMatrix4x4* rasToIJK, int size )
+{
+  rasToIJK->Identity();
+  for ( int k = 0; k < 3; ++ k )
+  {
+    rasToIJK->SetElement( k, 3, size / 2.0 );
+  }
+}
+
+
+//----------------------------------------------------------------------------
+void SetStreamPose( vtkMatrix4x4* pose, int n )
+{
+  double angle = 0.01 * n;
+  double c = cos( angle );
+  double s = sin( angle );
+  pose->Identity();
+  pose->Element[0][0] = c;
+  pose->Element[0][1] = -s;
+  pose->Element[1][0] = s * c;
+  pose->Element[1][1] = c * c;
+  pose->Element[1][2] = -s;
+  pose->Element[2][0] = s * s;
+  pose->Element[2][1] = s * c;
+  pose->Element[2][2] = c;
+  pose->Element[0][3] = 10.0 * sin( 0.05 * n );
+  pose->Element[1][3] = 0.1 * n;
+  pose->Element[2][3] = -5.0 + 0.01 * n;
+}
+
+
+//----------------------------------------------------------------------------
+void SetPoseXYToRAS( vtkMatrix4x4* xyToRAS, vtkMatrix4x4* pose, int size, double spacing )
+{
+  xyToRAS->Identity();
+  for ( int k = 0; k < 3; ++ k )
+  {
+    for ( int c = 0; c < 3; ++ c )
+    {
+      xyToRAS->Element[ k ][ c ] = pose->Element[ k ][ c ] * spacing;
+    }
+    xyToRAS->Element[ k ][ 3 ] = pose->Element[ k ][ 3 ]
+      - size / 2.0 * ( xyToRAS->Element[ k ][ 0 ] + xyToRAS->Element[ k ][ 1 ] );
+  }
+}
+
+
+//----------------------------------------------------------------------------
+void SetTimestamp( vtkMRMLNode* node, double time )
+{
+  std::ostringstream timestamp;
+  timestamp.precision( 17 );
+  timestamp << time;
+  node->SetAttribute( VOLUMERESLICEDRIVER_TIMESTAMP_ATTRIBUTE, timestamp.str().c_str() );
+}
+
+
+//----------------------------------------------------------------------------
+double GetMaximumDifference( vtkMatrix4x4* a, vtkMatrix4x4* b )
+{
+  double difference = 0.0;
+  for ( int i = 0; i < 4; ++ i )
+  {
+    for ( int j = 0; j < 4; ++ j )
+    {
+      double d = fabs( a->Element[ i ][ j ] - b->Element[ i ][ j ] );
+      difference = ( d > difference ) ? d : difference;
+    }
+  }
+  return difference;
+}
+
+
+//----------------------------------------------------------------------------
+double GetSlicePositionError( vtkMRMLSliceNode* slice, vtkMatrix4x4* pose )
+{
+  vtkMatrix4x4* sliceToRAS = slice->GetSliceToRAS();
+  double distance = 0.0;
+  for ( int k = 0; k < 3; ++ k )
+  {
+    distance += ( pose->GetElement( k, 3 ) - sliceToRAS->GetElement( k, 3 ) ) * sliceToRAS->GetElement( k, 2 );
+  }
+  return fabs( distance );
+}
+
+
+//----------------------------------------------------------------------------
+void SetCountingAllocations( bool counting )
+{
+  CountAllocations = counting;
+}
+
+
+//----------------------------------------------------------------------------
+bool GetCountingAllocations()
+{
+  return CountAllocations;
+}
+
+
+//----------------------------------------------------------------------------
+unsigned long GetNumberOfAllocations()
+{
+  return NumberOfAllocations;
+}
+
+
+//----------------------------------------------------------------------------
+void ResetNumberOfAllocations()
+{
+  NumberOfAllocations = 0;
+}
+
+} // namespace vtkVolumeResliceDriverTestingUtilities
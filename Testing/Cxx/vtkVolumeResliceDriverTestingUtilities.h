@@ -0,0 +1,82 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// Helpers shared by the VolumeResliceDriver tests and benchmarks: synthetic
+// volumes, poses and slice geometries that are the same on every machine.
+
+#ifndef __vtkVolumeResliceDriverTestingUtilities_h
+#define __vtkVolumeResliceDriverTestingUtilities_h
+
+// VTK includes
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <vector>
+
+class vtkImageData;
+class vtkMatrix4x4;
+class vtkMRMLNode;
+class vtkMRMLSliceNode;
+
+
+namespace vtkVolumeResliceDriverTestingUtilities
+{
+
+/// Short volume of size^3 voxels: 8-voxel checkers of 1000 over a ramp,
+/// so that every voxel differs from its neighbors.
+vtkSmartPointer< vtkImageData > CreateTestVolume( int size );
+
+/// Float volume of size^3 voxels holding value + ramp . ijk.
+vtkSmartPointer< vtkImageData > CreateRampVolume( int size, double value, const double ramp[3] );
+
+/// Time points of a synthetic 4D series of short volumes: the test volume
+/// shifted by t voxels along x and offset by t, 0.05 s apart.
+void CreateTimeSeries( int size, int numberOfTimePoints, std::vector< vtkSmartPointer< vtkImageData > >& timePoints,
+                       std::vector< vtkImageData* >& images, std::vector< double >& times );
+
+/// RAS to IJK for a volume of 1 mm voxels centered at the RAS origin.
+void CreateRASToIJK( vtkMatrix4x4* rasToIJK, int size );
+
+/// Tracked pose n of a synthetic stream: rotating about an oblique axis
+/// while translating, so every pose moves a driven slice.
+void SetStreamPose( vtkMatrix4x4* pose, int n );
+
+/// XYToRAS of a size x size slice in the plane of the pose, centered on
+/// its position, with pixels of the given spacing in mm.
+void SetPoseXYToRAS( vtkMatrix4x4* xyToRAS, vtkMatrix4x4* pose, int size, double spacing );
+
+/// Set the VOLUMERESLICEDRIVER_TIMESTAMP_ATTRIBUTE of a node, in seconds.
+void SetTimestamp( vtkMRMLNode* node, double time );
+
+/// Largest absolute difference between the elements of two matrices.
+double GetMaximumDifference( vtkMatrix4x4* a, vtkMatrix4x4* b );
+
+/// Distance from the position of the pose to the plane of the slice.
+double GetSlicePositionError( vtkMRMLSliceNode* slice, vtkMatrix4x4* pose );
+
+/// Allocations through the global operator new, which the utilities
+/// replace, are counted while counting is on. The count is not atomic:
+/// count on one thread only.
+void SetCountingAllocations( bool counting );
+bool GetCountingAllocations();
+unsigned long GetNumberOfAllocations();
+void ResetNumberOfAllocations();
+
+} // namespace vtkVolumeResliceDriverTestingUtilities
+
+#endif
@@ -28,6 +28,7 @@
 #include "vtkMRMLLayoutLogic.h"
 
 #include "vtkSlicerVolumeResliceDriverLogic.h"
+#include "vtkSliceImageReslicer.h"
 
 // VTK includes
 #include <vtkSmartPointer.h>
@@ -61,9 +62,11 @@ public:
   void SetDriverNodeSelection( const char* nodeID );
   void SetMethodSelection( int method );
   void SetOrientationSelection( int orientation );
+  void SetInterpolationSelection( int interpolation );
   
   QButtonGroup methodButtonGroup;
   QButtonGroup orientationButtonGroup;
+  QButtonGroup interpolationButtonGroup;
 
   vtkMRMLScene * scene;
   vtkMRMLSliceNode * sliceNode;
@@ -109,6 +112,11 @@ void qSlicerReslicePropertyWidgetPrivate
   this->orientationButtonGroup.addButton(this->inPlane90RadioButton, vtkSlicerVolumeResliceDriverLogic::ORIENTATION_INPLANE90);
   this->orientationButtonGroup.addButton(this->transverseRadioButton, vtkSlicerVolumeResliceDriverLogic::ORIENTATION_TRANSVERSE);
   this->inPlaneRadioButton->setChecked(true);
+  this->interpolationButtonGroup.addButton(this->nearestRadioButton, vtkSliceImageReslicer::INTERPOLATION_NEAREST);
+  this->interpolationButtonGroup.addButton(this->linearRadioButton, vtkSliceImageReslicer::INTERPOLATION_LINEAR);
+  this->interpolationButtonGroup.addButton(this->cubicRadioButton, vtkSliceImageReslicer::INTERPOLATION_CUBIC);
+  this->interpolationButtonGroup.addButton(this->lanczosRadioButton, vtkSliceImageReslicer::INTERPOLATION_LANCZOS);
+  this->linearRadioButton->setChecked(true);
 }
 
 
@@ -150,6 +158,19 @@ void qSlicerReslicePropertyWidgetPrivate
 
 
 
+void qSlicerReslicePropertyWidgetPrivate
+::SetInterpolationSelection( int interpolation )
+{
+  QAbstractButton* button = this->interpolationButtonGroup.button( interpolation );
+  if ( button == NULL )
+  {
+    button = this->linearRadioButton;
+  }
+  button->setChecked( true );
+}
+
+
+
 qSlicerReslicePropertyWidget
 ::qSlicerReslicePropertyWidget( vtkSlicerVolumeResliceDriverLogic* logic, QWidget *_parent )
   : Superclass( new qSlicerReslicePropertyWidgetPrivate( *this ), _parent )
@@ -210,6 +231,10 @@ void qSlicerReslicePropertyWidget
   QObject::disconnect(d->inPlaneRadioButton, SIGNAL(clicked()), this, SLOT(onOrientationChanged()));
   QObject::disconnect(d->inPlane90RadioButton, SIGNAL(clicked()), this, SLOT(onOrientationChanged()));
   QObject::disconnect(d->transverseRadioButton, SIGNAL(clicked()), this, SLOT(onOrientationChanged()));
+  QObject::disconnect(d->nearestRadioButton, SIGNAL(clicked()), this, SLOT(onInterpolationChanged()));
+  QObject::disconnect(d->linearRadioButton, SIGNAL(clicked()), this, SLOT(onInterpolationChanged()));
+  QObject::disconnect(d->cubicRadioButton, SIGNAL(clicked()), this, SLOT(onInterpolationChanged()));
+  QObject::disconnect(d->lanczosRadioButton, SIGNAL(clicked()), this, SLOT(onInterpolationChanged()));
   
   d->sliceNode = newSliceNode;
   
@@ -224,6 +249,10 @@ void qSlicerReslicePropertyWidget
   QObject::connect(d->inPlaneRadioButton, SIGNAL(clicked()), this, SLOT(onOrientationChanged()));
   QObject::connect(d->inPlane90RadioButton, SIGNAL(clicked()), this, SLOT(onOrientationChanged()));
   QObject::connect(d->transverseRadioButton, SIGNAL(clicked()), this, SLOT(onOrientationChanged()));
+  QObject::connect(d->nearestRadioButton, SIGNAL(clicked()), this, SLOT(onInterpolationChanged()));
+  QObject::connect(d->linearRadioButton, SIGNAL(clicked()), this, SLOT(onInterpolationChanged()));
+  QObject::connect(d->cubicRadioButton, SIGNAL(clicked()), this, SLOT(onInterpolationChanged()));
+  QObject::connect(d->lanczosRadioButton, SIGNAL(clicked()), this, SLOT(onInterpolationChanged()));
 }
 
 
@@ -288,6 +317,16 @@ void qSlicerReslicePropertyWidget
 
 
 
+void qSlicerReslicePropertyWidget
+::onInterpolationChanged()
+{
+  Q_D(qSlicerReslicePropertyWidget);
+  
+  this->Logic->SetInterpolationForSlice( d->interpolationButtonGroup.checkedId(), d->sliceNode );
+}
+
+
+
 void qSlicerReslicePropertyWidget
 ::onLogicModified()
 {
@@ -327,4 +366,17 @@ void qSlicerReslicePropertyWidget
     orientationSS >> orientation;
     d->SetOrientationSelection( orientation );
   }
+  
+  const char* interpolationCC = d->sliceNode->GetAttribute( VOLUMERESLICEDRIVER_INTERPOLATION_ATTRIBUTE );
+  if ( interpolationCC == NULL )
+  {
+    d->SetInterpolationSelection( vtkSliceImageReslicer::INTERPOLATION_LINEAR );
+  }
+  else
+  {
+    std::stringstream interpolationSS( interpolationCC );
+    int interpolation = vtkSliceImageReslicer::INTERPOLATION_LINEAR;
+    interpolationSS >> interpolation;
+    d->SetInterpolationSelection( interpolation );
+  }
 }
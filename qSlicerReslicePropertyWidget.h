@@ -68,6 +68,7 @@ protected slots:
   void setDriverNode(vtkMRMLNode * newNode);
   void onMethodChanged();
   void onOrientationChanged();
+  void onInterpolationChanged();
   void onLogicModified();
   
   
@@ -25,12 +25,16 @@
 #include "qSlicerLayoutManager.h"
 
 #include <QButtonGroup>
+#include <QElapsedTimer>
+#include <QTableWidget>
+#include <QTimer>
 
 #include "vtkSmartPointer.h"
 #include "vtkCollection.h"
 
 #include "vtkMRMLScene.h"
 #include "vtkMRMLNode.h"
+#include "vtkMRMLScalarVolumeNode.h"
 #include "vtkMRMLSliceNode.h"
 #include "vtkMRMLLayoutLogic.h"
 
@@ -38,7 +42,9 @@
 #include "vtkSlicerVolumeResliceDriverLogic.h"
 
 
+#include <cmath>
 #include <map>
+#include <vector>
 
 #include <QDebug>
 
@@ -64,6 +70,29 @@ public:
 
   typedef std::map<vtkSmartPointer<vtkMRMLNode>, qSlicerReslicePropertyWidget* > WidgetMapType;
   WidgetMapType WidgetMap;
+  
+  /// Refreshes the performance panel while it is expanded.
+  QTimer* PerformanceTimer;
+  QElapsedTimer PerformanceClock;
+  /// Pose and update counts at the previous refresh, keyed by driver and slice ID.
+  typedef std::map< std::string, std::pair< unsigned long, unsigned long > > CountMapType;
+  CountMapType PreviousCounts;
+  std::vector< vtkSlicerVolumeResliceDriverLogic::SlicePerformance > PerformanceSnapshot;
+  
+  /// Polls the shared-memory pose channel at render rate while attached.
+  QTimer* PoseChannelTimer;
+  /// Publishes the frames of the slice workers at render rate while
+  /// asynchronous reslicing is on, including the last one after motion stops.
+  QTimer* AsyncResliceTimer;
+  
+  /// Advances the time of the applied series at render rate while playing.
+  QTimer* TimeSeriesTimer;
+  QElapsedTimer TimeSeriesClock;
+  /// Series time when playback started, and the loop length in seconds.
+  double TimeSeriesStartTime;
+  double TimeSeriesDuration;
+  /// Volume whose series is applied; NULL if none.
+  vtkMRMLScalarVolumeNode* TimeSeriesVolume;
 };
 
 
@@ -75,6 +104,13 @@ qSlicerVolumeResliceDriverModuleWidgetPrivate
 ::qSlicerVolumeResliceDriverModuleWidgetPrivate( qSlicerVolumeResliceDriverModuleWidget& object )
  : q_ptr(&object)
 {
+  this->PerformanceTimer = 0;
+  this->PoseChannelTimer = 0;
+  this->AsyncResliceTimer = 0;
+  this->TimeSeriesTimer = 0;
+  this->TimeSeriesStartTime = 0.0;
+  this->TimeSeriesDuration = 0.0;
+  this->TimeSeriesVolume = 0;
 }
 
 
@@ -168,6 +204,35 @@ void qSlicerVolumeResliceDriverModuleWidget::setup()
   Q_D(qSlicerVolumeResliceDriverModuleWidget);
   d->setupUi(this);
   this->Superclass::setup();
+  
+  // A low fixed rate: the panel only reads counters, it never hooks the pose path.
+  d->PerformanceTimer = new QTimer( this );
+  d->PerformanceTimer->setInterval( 500 );
+  connect( d->PerformanceTimer, SIGNAL( timeout() ), this, SLOT( updatePerformancePanel() ) );
+  connect( d->performanceCollapsibleButton, SIGNAL( contentsCollapsed(bool) ),
+           this, SLOT( onPerformanceCollapsed(bool) ) );
+  
+  d->PoseChannelTimer = new QTimer( this );
+  d->PoseChannelTimer->setInterval( 16 );
+  connect( d->PoseChannelTimer, SIGNAL( timeout() ), this, SLOT( pollPoseChannel() ) );
+  
+  d->AsyncResliceTimer = new QTimer( this );
+  d->AsyncResliceTimer->setInterval( 16 );
+  connect( d->AsyncResliceTimer, SIGNAL( timeout() ), this, SLOT( pollAsyncResliceOutputs() ) );
+  
+  d->TimeSeriesTimer = new QTimer( this );
+  d->TimeSeriesTimer->setInterval( 16 );
+  connect( d->TimeSeriesTimer, SIGNAL( timeout() ), this, SLOT( advanceTimeSeries() ) );
+  connect( d->timeSeriesApplyButton, SIGNAL( clicked() ), this, SLOT( applyTimeSeries() ) );
+  connect( d->timeSeriesRemoveButton, SIGNAL( clicked() ), this, SLOT( removeTimeSeries() ) );
+  connect( d->timeSeriesTimeSlider, SIGNAL( valueChanged(double) ),
+           this, SLOT( onTimeSeriesTimeChanged(double) ) );
+  connect( d->timeSeriesPlayButton, SIGNAL( toggled(bool) ), this, SLOT( onTimeSeriesPlayToggled(bool) ) );
+  if ( d->logic() )
+  {
+    this->qvtkConnect( d->logic(), vtkCommand::ModifiedEvent, this, SLOT( onLogicModified() ) );
+    this->onLogicModified();
+  }
 }
 
 
@@ -180,6 +245,10 @@ void qSlicerVolumeResliceDriverModuleWidget::setMRMLScene(vtkMRMLScene *newScene
   vtkMRMLScene* oldScene = this->mrmlScene();
 
   this->Superclass::setMRMLScene(newScene);
+  
+  this->removeTimeSeries();
+  d->timeSeriesVolumeSelector->setMRMLScene(newScene);
+  d->timeSeriesTimePointsSelector->setMRMLScene(newScene);
 
   qSlicerApplication * app = qSlicerApplication::application();
   if (!app)
@@ -335,3 +404,258 @@ void qSlicerVolumeResliceDriverModuleWidget::onLayoutChanged(int)
   visibleViews->Delete();
 }
 
+
+
+// --------------------------------------------------------------------------
+void qSlicerVolumeResliceDriverModuleWidget::onPerformanceCollapsed(bool collapsed)
+{
+  Q_D(qSlicerVolumeResliceDriverModuleWidget);
+
+  if (collapsed)
+  {
+    d->PerformanceTimer->stop();
+    return;
+  }
+  
+  d->PreviousCounts.clear();
+  d->PerformanceClock.start();
+  this->updatePerformancePanel();
+  d->PerformanceTimer->start();
+}
+
+
+
+// --------------------------------------------------------------------------
+void qSlicerVolumeResliceDriverModuleWidget::updatePerformancePanel()
+{
+  Q_D(qSlicerVolumeResliceDriverModuleWidget);
+
+  vtkSlicerVolumeResliceDriverLogic* logic = d->logic();
+  if (!logic)
+  {
+    return;
+  }
+  
+  double seconds = d->PerformanceClock.restart() / 1000.0;
+  logic->GetPerformanceSnapshot( d->PerformanceSnapshot );
+  
+  QTableWidget* table = d->performanceTable;
+  table->setRowCount( static_cast< int >( d->PerformanceSnapshot.size() ) );
+  qSlicerVolumeResliceDriverModuleWidgetPrivate::CountMapType counts;
+  for ( unsigned int row = 0; row < d->PerformanceSnapshot.size(); ++ row )
+  {
+    const vtkSlicerVolumeResliceDriverLogic::SlicePerformance& performance = d->PerformanceSnapshot[ row ];
+    std::string key = performance.DriverID + "/" + performance.SliceID;
+    counts[ key ] = std::make_pair( performance.NumberOfPoseEvents, performance.NumberOfUpdates );
+    
+    // Rates need two samples; show them from the second refresh on.
+    QString poseRate;
+    QString updateRate;
+    qSlicerVolumeResliceDriverModuleWidgetPrivate::CountMapType::iterator previous = d->PreviousCounts.find( key );
+    if ( previous != d->PreviousCounts.end() && seconds > 0.0 )
+    {
+      poseRate = QString::number( ( performance.NumberOfPoseEvents - previous->second.first ) / seconds, 'f', 1 );
+      updateRate = QString::number( ( performance.NumberOfUpdates - previous->second.second ) / seconds, 'f', 1 );
+    }
+    
+    QStringList cells;
+    cells << QString::fromStdString( performance.DriverName )
+          << QString::fromStdString( performance.SliceName )
+          << poseRate
+          << updateRate
+          << QString::number( performance.NumberOfCoalescedPoses )
+          << QString::number( performance.NumberOfDroppedPoses )
+          << QString::number( performance.LatencyPercentiles[0], 'f', 2 )
+          << QString::number( performance.LatencyPercentiles[1], 'f', 2 )
+          << QString::number( performance.LatencyPercentiles[2], 'f', 2 )
+          << ( performance.CacheHitRate >= 0.0 ? QString::number( performance.CacheHitRate, 'f', 1 ) : QString() );
+    for ( int column = 0; column < cells.size(); ++ column )
+    {
+      QTableWidgetItem* item = table->item( row, column );
+      if ( !item )
+      {
+        item = new QTableWidgetItem;
+        table->setItem( row, column, item );
+      }
+      item->setText( cells[ column ] );
+    }
+  }
+  d->PreviousCounts.swap( counts );
+}
+
+
+
+// --------------------------------------------------------------------------
+void qSlicerVolumeResliceDriverModuleWidget::onLogicModified()
+{
+  Q_D(qSlicerVolumeResliceDriverModuleWidget);
+
+  bool attached = d->logic() && d->logic()->IsPoseChannelAttached();
+  if ( attached && ! d->PoseChannelTimer->isActive() )
+  {
+    d->PoseChannelTimer->start();
+  }
+  else if ( ! attached && d->PoseChannelTimer->isActive() )
+  {
+    d->PoseChannelTimer->stop();
+  }
+  
+  bool async = d->logic() && d->logic()->GetAsyncResliceEnabled();
+  if ( async && ! d->AsyncResliceTimer->isActive() )
+  {
+    d->AsyncResliceTimer->start();
+  }
+  else if ( ! async && d->AsyncResliceTimer->isActive() )
+  {
+    d->AsyncResliceTimer->stop();
+  }
+}
+
+
+
+// --------------------------------------------------------------------------
+void qSlicerVolumeResliceDriverModuleWidget::pollPoseChannel()
+{
+  Q_D(qSlicerVolumeResliceDriverModuleWidget);
+
+  if ( d->logic() )
+  {
+    d->logic()->PollPoseChannel();
+  }
+}
+
+
+
+// --------------------------------------------------------------------------
+void qSlicerVolumeResliceDriverModuleWidget::pollAsyncResliceOutputs()
+{
+  Q_D(qSlicerVolumeResliceDriverModuleWidget);
+
+  if ( d->logic() )
+  {
+    d->logic()->PollAsyncResliceOutputs();
+  }
+}
+
+
+
+// --------------------------------------------------------------------------
+void qSlicerVolumeResliceDriverModuleWidget::applyTimeSeries()
+{
+  Q_D(qSlicerVolumeResliceDriverModuleWidget);
+
+  vtkSlicerVolumeResliceDriverLogic* logic = d->logic();
+  vtkMRMLScalarVolumeNode* volumeNode =
+    vtkMRMLScalarVolumeNode::SafeDownCast( d->timeSeriesVolumeSelector->currentNode() );
+  if ( !logic || !volumeNode )
+  {
+    return;
+  }
+  
+  // Time points in the order of the scene, one frame interval apart.
+  QList< vtkMRMLNode* > checkedNodes = d->timeSeriesTimePointsSelector->checkedNodes();
+  double interval = d->timeSeriesIntervalSpinBox->value();
+  std::vector< vtkMRMLScalarVolumeNode* > timePoints;
+  std::vector< double > times;
+  for ( int i = 0; i < checkedNodes.size(); ++ i )
+  {
+    vtkMRMLScalarVolumeNode* timePoint = vtkMRMLScalarVolumeNode::SafeDownCast( checkedNodes[ i ] );
+    if ( timePoint )
+    {
+      times.push_back( timePoints.size() * interval );
+      timePoints.push_back( timePoint );
+    }
+  }
+  
+  if ( d->TimeSeriesVolume && d->TimeSeriesVolume != volumeNode )
+  {
+    this->removeTimeSeries();
+  }
+  if ( timePoints.empty() )
+  {
+    this->removeTimeSeries();
+    return;
+  }
+  if ( !logic->SetTimeSeries( volumeNode, timePoints, times ) )
+  {
+    qWarning() << "qSlicerVolumeResliceDriverModuleWidget::applyTimeSeries - time points do not match the volume";
+    return;
+  }
+  
+  d->TimeSeriesVolume = volumeNode;
+  d->TimeSeriesDuration = timePoints.size() * interval;
+  d->timeSeriesTimeSlider->setMaximum( times.back() );
+  d->timeSeriesTimeSlider->setSingleStep( interval );
+  d->timeSeriesTimeSlider->setEnabled( true );
+  d->timeSeriesPlayButton->setEnabled( true );
+  
+  // Show the series now; the slider may already be at the current time.
+  logic->SetTimeSeriesTime( d->timeSeriesTimeSlider->value() );
+}
+
+
+
+// --------------------------------------------------------------------------
+void qSlicerVolumeResliceDriverModuleWidget::removeTimeSeries()
+{
+  Q_D(qSlicerVolumeResliceDriverModuleWidget);
+
+  d->timeSeriesPlayButton->setChecked( false );
+  d->timeSeriesPlayButton->setEnabled( false );
+  d->timeSeriesTimeSlider->setEnabled( false );
+  d->TimeSeriesDuration = 0.0;
+  if ( d->TimeSeriesVolume && d->logic() )
+  {
+    d->logic()->RemoveTimeSeries( d->TimeSeriesVolume );
+  }
+  d->TimeSeriesVolume = 0;
+}
+
+
+
+// --------------------------------------------------------------------------
+void qSlicerVolumeResliceDriverModuleWidget::onTimeSeriesTimeChanged(double time)
+{
+  Q_D(qSlicerVolumeResliceDriverModuleWidget);
+
+  if ( d->TimeSeriesVolume && d->logic() )
+  {
+    d->logic()->SetTimeSeriesTime( time );
+  }
+}
+
+
+
+// --------------------------------------------------------------------------
+void qSlicerVolumeResliceDriverModuleWidget::onTimeSeriesPlayToggled(bool play)
+{
+  Q_D(qSlicerVolumeResliceDriverModuleWidget);
+
+  if ( ! play )
+  {
+    d->TimeSeriesTimer->stop();
+    return;
+  }
+  
+  d->TimeSeriesStartTime = d->timeSeriesTimeSlider->value();
+  d->TimeSeriesClock.start();
+  d->TimeSeriesTimer->start();
+}
+
+
+
+// --------------------------------------------------------------------------
+void qSlicerVolumeResliceDriverModuleWidget::advanceTimeSeries()
+{
+  Q_D(qSlicerVolumeResliceDriverModuleWidget);
+
+  if ( d->TimeSeriesDuration <= 0.0 )
+  {
+    return;
+  }
+  
+  // Wall-clock time, so playback keeps its rate when renders are slow; the
+  // slider change moves the logic to the new time.
+  double time = d->TimeSeriesStartTime + d->TimeSeriesClock.elapsed() / 1000.0;
+  d->timeSeriesTimeSlider->setValue( std::fmod( time, d->TimeSeriesDuration ) );
+}
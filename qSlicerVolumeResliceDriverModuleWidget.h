@@ -43,6 +43,16 @@ public slots:
   void onNodeAddedEvent(vtkObject* scene, vtkObject* node);
   void onNodeRemovedEvent(vtkObject* scene, vtkObject* node);
   void onLayoutChanged(int);
+  void onPerformanceCollapsed(bool);
+  void updatePerformancePanel();
+  void onLogicModified();
+  void pollPoseChannel();
+  void pollAsyncResliceOutputs();
+  void applyTimeSeries();
+  void removeTimeSeries();
+  void onTimeSeriesTimeChanged(double);
+  void onTimeSeriesPlayToggled(bool);
+  void advanceTimeSeries();
 
 protected:
   QScopedPointer<qSlicerVolumeResliceDriverModuleWidgetPrivate> d_ptr;